@@ -0,0 +1,35 @@
+#ifndef _APP_ACCESS_H_
+#define _APP_ACCESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sdkconfig.h>
+#include <esp_err.h>
+
+#include "app_tag.h"
+
+#define APP_ACCESS_CACHE_ENTRIES                 CONFIG_RFID_ACCESS_CACHE_ENTRIES
+
+/* Resolves a UID missing from the cache, e.g. from the tag index. Runs in the
+   reader task and must not block, an error means the source is busy */
+typedef esp_err_t (*app_access_lookup_cb_t)(const uint8_t *, uint8_t, bool *);
+/* Called from the reader task with the reader index, the UID, its length and
+   whether access is granted, it must not block */
+typedef void (*app_access_cb_t)(uint8_t, const uint8_t *, uint8_t, bool);
+
+typedef struct
+{
+  uint32_t u32Hits;
+  uint32_t u32Misses;
+  uint32_t u32Unavailable;
+  uint32_t u32MaxDecisionUs;
+}app_access_stats_t;
+
+void app_access_init(app_access_lookup_cb_t, app_access_cb_t);
+bool app_access_decide(uint8_t, const uint8_t *, uint8_t);
+void app_access_forget(const uint8_t *, uint8_t);
+void app_access_flush(void);
+void app_access_get_stats(app_access_stats_t *);
+
+#endif /* _APP_ACCESS_H_ */
\ No newline at end of file
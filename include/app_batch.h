@@ -0,0 +1,41 @@
+#ifndef _APP_BATCH_H_
+#define _APP_BATCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sdkconfig.h>
+#include <esp_err.h>
+
+#include "app_doc.h"
+
+#define APP_BATCH_MAX_WRITES                     CONFIG_RFID_BATCH_MAX_WRITES
+#define APP_BATCH_BODY_MAX_SIZE                  CONFIG_RFID_BATCH_BODY_SIZE
+#define APP_BATCH_WINDOW_MS                      CONFIG_RFID_BATCH_WINDOW_MS
+
+/* Body size of count writes of at most write bytes each, commas included */
+#define APP_BATCH_BODY_SIZE(count, write)        (sizeof("{\"writes\":[]}") + (count) * ((write) + 1))
+
+/* One update write, only pcDocumentPath and pfFields are mandatory */
+typedef struct
+{
+  const char *pcDocumentPath;
+  app_doc_fields_cb_t pfFields;
+  const void *pvArg;
+  /* Fields written by pfFields, the other fields of the document are kept.
+     Without a mask the whole document is replaced */
+  const char *const *ppcMask;
+  uint32_t u32MaskCount;
+  /* Field set to the commit time by the server */
+  const char *pcRequestTimeField;
+  /* Field incremented by the number of writes coalesced into this one */
+  const char *pcCounterField;
+  /* Replace a pending write to the same document instead of adding one */
+  bool bCoalesce;
+}app_batch_write_t;
+
+esp_err_t app_batch_add(const char *, app_doc_fields_cb_t, const void *);
+esp_err_t app_batch_add_write(const app_batch_write_t *);
+esp_err_t app_batch_commit(void);
+
+#endif /* _APP_BATCH_H_ */
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef _APP_CONN_H_
+#define _APP_CONN_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_http_client.h>
+
+#define APP_CONN_DATABASE_PATH                   "projects/"FIRESTORE_FIREBASE_PROJECT_ID \
+                                                 "/databases/(default)/documents"
+
+typedef void (*app_conn_data_cb_t)(const char *, uint32_t, void *);
+
+typedef struct
+{
+  uint32_t u32Requests;
+  uint32_t u32Failures;
+  uint32_t u32Handshakes;
+  uint32_t u32Reconnects;
+  uint32_t u32LastLatencyMs;
+  uint32_t u32MaxLatencyMs;
+  uint64_t u64TotalLatencyMs;
+}app_conn_stats_t;
+
+esp_err_t app_conn_init(void);
+esp_err_t app_conn_request(esp_http_client_method_t,
+                           const char *,
+                           const char *,
+                           uint32_t,
+                           app_conn_data_cb_t,
+                           void *,
+                           int *);
+void app_conn_get_stats(app_conn_stats_t *);
+
+#endif /* _APP_CONN_H_ */
\ No newline at end of file
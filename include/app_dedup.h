@@ -0,0 +1,37 @@
+#ifndef _APP_DEDUP_H_
+#define _APP_DEDUP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_tag.h"
+
+#define APP_DEDUP_ENTRIES                        16
+
+typedef struct
+{
+  uint32_t u32Accepted;
+  uint32_t u32Suppressed;
+  uint32_t u32Evicted;
+}app_dedup_stats_t;
+
+typedef struct
+{
+  uint8_t tu08Uid[APP_TAG_UID_MAX_SIZE];
+  uint8_t u08UidLength;
+  int64_t s64LastSeenUs;
+}app_dedup_entry_t;
+
+/* Recently seen UIDs, only ever touched by the reader task so no lock is taken */
+typedef struct
+{
+  int64_t s64HoldOffUs;
+  app_dedup_stats_t stStats;
+  app_dedup_entry_t tstEntries[APP_DEDUP_ENTRIES];
+}app_dedup_t;
+
+void app_dedup_init(app_dedup_t *, uint32_t);
+bool app_dedup_accept(app_dedup_t *, const app_tag_t *);
+void app_dedup_get_stats(app_dedup_t *, app_dedup_stats_t *);
+
+#endif /* _APP_DEDUP_H_ */
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef _APP_DOC_H_
+#define _APP_DOC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+#define APP_DOC_MAX_DEPTH                        8
+
+typedef struct app_doc_s app_doc_t;
+
+typedef esp_err_t (*app_doc_write_cb_t)(const char *, uint32_t, void *);
+typedef void (*app_doc_fields_cb_t)(app_doc_t *, const void *);
+
+/* Serializer state, owned by the caller so no allocation is ever made */
+struct app_doc_s
+{
+  char *pcBuffer;
+  uint32_t u32Size;
+  uint32_t u32Length;
+  uint32_t u32Flushed;
+  uint8_t u08Depth;
+  uint8_t u08Empty;
+  esp_err_t s32Error;
+  app_doc_write_cb_t pfWrite;
+  void *pvArg;
+};
+
+void app_doc_init(app_doc_t *, char *, uint32_t, app_doc_write_cb_t, void *);
+void app_doc_begin_object(app_doc_t *, const char *);
+void app_doc_end_object(app_doc_t *);
+void app_doc_begin_array(app_doc_t *, const char *);
+void app_doc_end_array(app_doc_t *);
+void app_doc_add_name(app_doc_t *, const char *);
+void app_doc_add_string(app_doc_t *, const char *, const char *);
+void app_doc_add_text(app_doc_t *, const char *, const char *);
+void app_doc_add_hex(app_doc_t *, const char *, const uint8_t *, uint32_t);
+void app_doc_add_integer(app_doc_t *, const char *, int64_t);
+void app_doc_add_boolean(app_doc_t *, const char *, bool);
+void app_doc_add_bytes(app_doc_t *, const char *, const uint8_t *, uint32_t);
+void app_doc_add_fields(app_doc_t *, app_doc_fields_cb_t, const void *);
+esp_err_t app_doc_finish(app_doc_t *, uint32_t *);
+
+#endif /* _APP_DOC_H_ */
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _APP_GW_H_
+#define _APP_GW_H_
+
+#include <stdint.h>
+
+#include <sdkconfig.h>
+#include <esp_err.h>
+
+#define APP_GW_MAX_RECORDS                       CONFIG_RFID_BATCH_MAX_WRITES
+#define APP_GW_UID_MAX_SIZE                      10
+
+typedef struct
+{
+  uint32_t u32Frames;
+  uint32_t u32Records;
+  uint32_t u32BytesSent;
+  uint32_t u32Connects;
+  uint32_t u32Failures;
+}app_gw_stats_t;
+
+esp_err_t app_gw_add(uint8_t, const uint8_t *, uint8_t, int64_t);
+esp_err_t app_gw_commit(void);
+void app_gw_get_stats(app_gw_stats_t *);
+
+#endif /* _APP_GW_H_ */
\ No newline at end of file
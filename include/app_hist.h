@@ -0,0 +1,24 @@
+#ifndef _APP_HIST_H_
+#define _APP_HIST_H_
+
+#include <stdint.h>
+
+/* Log-linear buckets: 4 sub-buckets per power of 2 keep every bucket within
+   25% of the values it holds over the whole 32 bit range */
+#define APP_HIST_SUB_BUCKET_BITS                 2
+#define APP_HIST_SUB_BUCKETS                     (1 << APP_HIST_SUB_BUCKET_BITS)
+#define APP_HIST_BUCKETS                         (APP_HIST_SUB_BUCKETS * (32 - APP_HIST_SUB_BUCKET_BITS + 1))
+
+typedef struct
+{
+  uint32_t u32Count;
+  uint32_t u32Max;
+  uint32_t tu32Buckets[APP_HIST_BUCKETS];
+}app_hist_t;
+
+void app_hist_reset(app_hist_t *);
+void app_hist_record(app_hist_t *, uint32_t);
+uint32_t app_hist_percentile(const app_hist_t *, uint32_t);
+uint32_t app_hist_bucket_limit(uint32_t);
+
+#endif /* _APP_HIST_H_ */
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef _APP_INDEX_H_
+#define _APP_INDEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include <esp_err.h>
+
+#define APP_INDEX_UID_MAX_SIZE                   10
+
+esp_err_t app_index_init(void);
+esp_err_t app_index_format(void);
+esp_err_t app_index_lookup(const uint8_t *, uint8_t, uint32_t *, TickType_t);
+esp_err_t app_index_insert(const uint8_t *, uint8_t, uint32_t);
+esp_err_t app_index_remove(const uint8_t *, uint8_t);
+bool app_index_is_valid(void);
+uint32_t app_index_get_count(void);
+
+#endif /* _APP_INDEX_H_ */
\ No newline at end of file
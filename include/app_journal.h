@@ -0,0 +1,38 @@
+#ifndef _APP_JOURNAL_H_
+#define _APP_JOURNAL_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#define APP_JOURNAL_UID_MAX_SIZE                 10
+
+typedef struct
+{
+  uint8_t tu08Uid[APP_JOURNAL_UID_MAX_SIZE];
+  uint8_t u08UidLength;
+  uint8_t u08ReaderId;
+  /* UNIX time in ms, 0 when the scan is only known by its capture time */
+  int64_t s64Timestamp;
+  /* esp_timer_get_time() at capture, 0 when taken during a previous boot */
+  int64_t s64CaptureUs;
+}app_journal_record_t;
+
+typedef esp_err_t (*app_journal_cb_t)(const app_journal_record_t *, void *);
+
+typedef struct
+{
+  uint32_t u32Appended;
+  uint32_t u32Consumed;
+  uint32_t u32Dropped;
+  uint32_t u32Corrupted;
+}app_journal_stats_t;
+
+esp_err_t app_journal_init(void);
+esp_err_t app_journal_append(const app_journal_record_t *);
+uint32_t app_journal_replay(app_journal_cb_t, void *, uint32_t);
+esp_err_t app_journal_consume(void);
+uint32_t app_journal_count(void);
+void app_journal_get_stats(app_journal_stats_t *);
+
+#endif /* _APP_JOURNAL_H_ */
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef _APP_JSON_H_
+#define _APP_JSON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+#define APP_JSON_MAX_DEPTH                       8
+#define APP_JSON_KEY_MAX_SIZE                    32
+
+typedef enum
+{
+  APP_JSON_STRING = 0,
+  APP_JSON_NUMBER,
+  APP_JSON_TRUE,
+  APP_JSON_FALSE,
+  APP_JSON_NULL,
+  APP_JSON_OBJECT_START,
+  APP_JSON_OBJECT_END,
+  APP_JSON_ARRAY_START,
+  APP_JSON_ARRAY_END,
+}app_json_type_t;
+
+typedef struct app_json_s app_json_t;
+
+typedef void (*app_json_cb_t)(const app_json_t *, app_json_type_t, const char *, uint32_t, void *);
+
+/* Incremental scanner state, owned by the caller so no allocation is ever made */
+struct app_json_s
+{
+  uint8_t u08State;
+  uint8_t u08Depth;
+  uint8_t u08Containers;
+  uint8_t u08UnicodeDigits;
+  uint16_t u16Unicode;
+  bool bIsKey;
+  bool bTruncated;
+  uint32_t u32ValueLength;
+  uint32_t u32ValueSize;
+  char *pcValue;
+  app_json_cb_t pfCb;
+  void *pvArg;
+  char tcKeys[APP_JSON_MAX_DEPTH][APP_JSON_KEY_MAX_SIZE];
+};
+
+void app_json_init(app_json_t *, char *, uint32_t, app_json_cb_t, void *);
+esp_err_t app_json_feed(app_json_t *, const char *, uint32_t);
+bool app_json_is_done(const app_json_t *);
+uint8_t app_json_get_depth(const app_json_t *);
+const char *app_json_get_key(const app_json_t *, uint8_t);
+bool app_json_match(const app_json_t *, const char *const *, uint8_t);
+bool app_json_is_truncated(const app_json_t *);
+
+#endif /* _APP_JSON_H_ */
\ No newline at end of file
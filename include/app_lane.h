@@ -0,0 +1,52 @@
+#ifndef _APP_LANE_H_
+#define _APP_LANE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+
+typedef enum
+{
+  APP_LANE_ALERT = 0,
+  APP_LANE_LIVE,
+  APP_LANE_BACKLOG,
+  APP_LANE_TELEMETRY,
+  APP_LANE_COUNT,
+}app_lane_t;
+
+/* Returns the records a lane has waiting and when the oldest one was queued,
+   work stamped in the future isn't ready before then */
+typedef uint32_t (*app_lane_pending_cb_t)(int64_t *);
+/* Uploads at most the given number of records of the lane, returns how many
+   left it whether uploaded, journaled or dropped */
+typedef uint32_t (*app_lane_serve_cb_t)(uint32_t);
+
+/* A lane is ready once it has a full turn waiting or its oldest record has
+   waited for the window. Ready lanes share the uplink by weight, a lane whose
+   oldest record has waited longer than its deadline goes first */
+typedef struct
+{
+  app_lane_pending_cb_t pfPending;
+  app_lane_serve_cb_t pfServe;
+  uint32_t u32Weight;
+  uint32_t u32WindowMs;
+  /* 0 for none */
+  uint32_t u32DeadlineMs;
+  /* Records per turn, bounds how long the other lanes wait for one turn */
+  uint32_t u32TurnRecords;
+}app_lane_config_t;
+
+typedef struct
+{
+  uint32_t u32Turns;
+  /* Turns taken past the deadline of the lane */
+  uint32_t u32LateTurns;
+}app_lane_stats_t;
+
+void app_lane_init(const app_lane_config_t *);
+bool app_lane_serve(void);
+TickType_t app_lane_get_wait_ticks(void);
+void app_lane_get_stats(app_lane_t, app_lane_stats_t *);
+
+#endif /* _APP_LANE_H_ */
\ No newline at end of file
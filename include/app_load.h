@@ -0,0 +1,26 @@
+#ifndef _APP_LOAD_H_
+#define _APP_LOAD_H_
+
+#include <stdint.h>
+
+#include "app_ring.h"
+#include "app_reader.h"
+
+typedef struct
+{
+  uint32_t u32Scans;
+  uint32_t u32Uploaded;
+  uint32_t u32Dropped;
+  uint32_t u32MaxDepth;
+  uint32_t u32P50Us;
+  uint32_t u32P90Us;
+  uint32_t u32P99Us;
+  uint32_t u32MaxUs;
+  uint32_t u32MinFreeHeap;
+}app_load_report_t;
+
+void app_load_start(uint32_t, uint32_t, app_reader_cb_t, app_ring_t *);
+void app_load_record_latency(int64_t);
+void app_load_get_report(app_load_report_t *);
+
+#endif /* _APP_LOAD_H_ */
\ No newline at end of file
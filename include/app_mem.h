@@ -0,0 +1,41 @@
+#ifndef _APP_MEM_H_
+#define _APP_MEM_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef enum
+{
+  APP_MEM_ARENA_CONN = 0,
+  APP_MEM_ARENA_OTA,
+  APP_MEM_ARENA_COUNT,
+}app_mem_arena_t;
+
+typedef struct
+{
+  uint32_t u32Size;
+  uint32_t u32Free;
+  uint32_t u32LargestFreeBlock;
+  uint32_t u32PeakUsed;
+  uint32_t u32Fallbacks;
+}app_mem_arena_stats_t;
+
+typedef struct
+{
+  uint32_t u32HeapFree;
+  uint32_t u32HeapMinFree;
+  uint32_t u32HeapLargestFreeBlock;
+  uint32_t u32HeapMinLargestFreeBlock;
+  /* 1000 * (1 - largest free block / free), now and worst since boot */
+  uint32_t u32FragmentationPermille;
+  uint32_t u32MaxFragmentationPermille;
+  app_mem_arena_stats_t tstArenas[APP_MEM_ARENA_COUNT];
+}app_mem_report_t;
+
+esp_err_t app_mem_init(void);
+void app_mem_bind_task(app_mem_arena_t);
+void app_mem_get_report(app_mem_report_t *);
+void app_mem_log_report(void);
+
+#endif /* _APP_MEM_H_ */
\ No newline at end of file
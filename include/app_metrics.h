@@ -0,0 +1,76 @@
+#ifndef _APP_METRICS_H_
+#define _APP_METRICS_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include "app_ring.h"
+
+/* Counters and histograms are written on the hot path, the other counters and
+   the gauges are read from their modules when a snapshot is taken. Keep in
+   sync with the registry in src/app_metrics.c */
+typedef enum
+{
+  APP_METRICS_SCANS = 0,
+  APP_METRICS_SCANS_SUPPRESSED,
+  APP_METRICS_SCANS_UPLOADED,
+  APP_METRICS_UPLOADS,
+  APP_METRICS_UPLOAD_FAILURES,
+  APP_METRICS_SCANS_DROPPED,
+  APP_METRICS_OTA_CHECKS,
+  APP_METRICS_TLS_HANDSHAKES,
+  APP_METRICS_WIFI_DISCONNECTS,
+  APP_METRICS_LATE_TURNS,
+  APP_METRICS_ACCESS_HITS,
+  APP_METRICS_ACCESS_MISSES,
+  APP_METRICS_ACCESS_BUSY,
+  APP_METRICS_COUNTER_COUNT,
+}app_metrics_counter_t;
+
+typedef enum
+{
+  APP_METRICS_QUEUE_HIGH_WATER = 0,
+  APP_METRICS_JOURNALED,
+  APP_METRICS_HEAP_FREE,
+  APP_METRICS_HEAP_MIN_FREE,
+  APP_METRICS_HEAP_LARGEST_FREE_BLOCK,
+  APP_METRICS_WIFI_RSSI,
+  APP_METRICS_UPTIME,
+  APP_METRICS_ACCESS_MAX_DECISION,
+  APP_METRICS_GAUGE_COUNT,
+}app_metrics_gauge_t;
+
+typedef enum
+{
+  APP_METRICS_UPLOAD_LATENCY = 0,
+  APP_METRICS_ALERT_LATENCY,
+  APP_METRICS_OTA_CHECK,
+  APP_METRICS_HIST_COUNT,
+}app_metrics_hist_t;
+
+/* Fixed upper bounds in ms, the last bucket holds everything above them */
+#define APP_METRICS_BUCKETS                      12
+
+typedef struct
+{
+  uint32_t u32Count;
+  uint64_t u64Sum;
+  uint32_t tu32Buckets[APP_METRICS_BUCKETS];
+}app_metrics_hist_snapshot_t;
+
+typedef struct
+{
+  uint32_t tu32Counters[APP_METRICS_COUNTER_COUNT];
+  int32_t ts32Gauges[APP_METRICS_GAUGE_COUNT];
+  app_metrics_hist_snapshot_t tstHists[APP_METRICS_HIST_COUNT];
+}app_metrics_snapshot_t;
+
+void app_metrics_add(app_metrics_counter_t, uint32_t);
+void app_metrics_record(app_metrics_hist_t, uint32_t);
+void app_metrics_get_snapshot(app_metrics_snapshot_t *);
+int64_t app_metrics_get_due_us(void);
+esp_err_t app_metrics_upload(void);
+void app_metrics_start(app_ring_t *);
+
+#endif /* _APP_METRICS_H_ */
\ No newline at end of file
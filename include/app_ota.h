@@ -1,6 +1,21 @@
 #ifndef _APP_OTA_H_
 #define _APP_OTA_H_
 
-void app_ota_start(void);
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef bool (*app_ota_busy_cb_t)(void);
+
+typedef struct
+{
+  uint32_t u32Checks;
+  uint32_t u32NotModified;
+  uint32_t u32Postponed;
+  uint32_t u32Handshakes;
+  uint32_t u32BytesReceived;
+}app_ota_stats_t;
+
+void app_ota_start(app_ota_busy_cb_t);
+void app_ota_get_stats(app_ota_stats_t *);
 
 #endif /* _APP_OTA_H_ */
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _APP_PATCH_H_
+#define _APP_PATCH_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef struct
+{
+  uint32_t u32BytesIn;
+  uint32_t u32BytesOut;
+  uint32_t u32BytesCopied;
+  uint32_t u32WorkingRam;
+  uint32_t u32DurationMs;
+}app_patch_stats_t;
+
+esp_err_t app_patch_begin(void);
+esp_err_t app_patch_write(const uint8_t *, uint32_t);
+esp_err_t app_patch_end(void);
+void app_patch_abort(void);
+void app_patch_get_stats(app_patch_stats_t *);
+
+#endif /* _APP_PATCH_H_ */
\ No newline at end of file
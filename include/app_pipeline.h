@@ -0,0 +1,21 @@
+#ifndef _APP_PIPELINE_H_
+#define _APP_PIPELINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include "app_ring.h"
+#include "app_reader.h"
+
+void app_pipeline_init(void);
+app_ring_t *app_pipeline_get_ring(void);
+void app_pipeline_start(const app_reader_start_args_t *);
+void app_pipeline_scan(uint8_t, const uint8_t *, uint8_t);
+void app_pipeline_link(bool);
+bool app_pipeline_is_busy(void);
+TickType_t app_pipeline_get_wait_ticks(void);
+void app_pipeline_run(void);
+
+#endif /* _APP_PIPELINE_H_ */
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef _APP_READER_H_
+#define _APP_READER_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#define APP_READER_MAX_COUNT                     4
+#define APP_READER_MAX_WEIGHT                    8
+
+typedef enum
+{
+  APP_READER_ROUND_ROBIN = 0,
+  APP_READER_PRIORITY,
+}app_reader_policy_t;
+
+/* Called from the reader task with the reader index, the UID and its length */
+typedef void (*app_reader_cb_t)(uint8_t, const uint8_t *, uint8_t);
+
+typedef struct
+{
+  int s32CsPin;
+  /* GPIO wired to the reader's IRQ pin, the task then sleeps during an exchange
+     instead of polling the reader. 0 or less polls, GPIO0 is a strapping pin */
+  int s32IrqPin;
+  /* Polling slots per round with APP_READER_PRIORITY, 1 to APP_READER_MAX_WEIGHT */
+  uint32_t u32Weight;
+}app_reader_config_t;
+
+/* Readers share MISO/MOSI/SCK and each has its own CS line. A reader's RF field
+   is only on during its slot, so the duty cycle of one out of N readers is
+   u32SlotMs / (N * u32SlotMs + u32IdleMs) */
+typedef struct
+{
+  int s32MisoPin;
+  int s32MosiPin;
+  int s32SckPin;
+  app_reader_config_t tstReaders[APP_READER_MAX_COUNT];
+  uint32_t u32ReaderCount;
+  app_reader_policy_t ePolicy;
+  uint32_t u32SlotMs;
+  uint32_t u32IdleMs;
+  app_reader_cb_t pfCallback;
+}app_reader_start_args_t;
+
+typedef struct
+{
+  uint32_t u32Polls;
+  uint32_t u32Detections;
+  uint32_t u32Errors;
+  uint32_t u32MaxPollUs;
+}app_reader_stats_t;
+
+esp_err_t app_reader_start(const app_reader_start_args_t *);
+esp_err_t app_reader_get_stats(uint8_t, app_reader_stats_t *);
+
+#endif /* _APP_READER_H_ */
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef _APP_RING_H_
+#define _APP_RING_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include <sdkconfig.h>
+#include <esp_err.h>
+
+#include "app_tag.h"
+
+/* Must be a power of 2, see CONFIG_RFID_TAG_RING_CAPACITY */
+#define APP_RING_CAPACITY                        CONFIG_RFID_TAG_RING_CAPACITY
+
+typedef enum
+{
+  APP_RING_DROP_OLDEST = 0,
+  APP_RING_DROP_NEWEST,
+}app_ring_policy_t;
+
+typedef struct
+{
+  uint32_t u32Pushed;
+  uint32_t u32Popped;
+  uint32_t u32DroppedOldest;
+  uint32_t u32DroppedNewest;
+  uint32_t u32HighWater;
+}app_ring_stats_t;
+
+/* Single-producer/single-consumer ring, only the consumer may pop and only
+   the producer may push, no lock is taken on either side */
+typedef struct
+{
+  atomic_uint u32Head;
+  atomic_uint u32Tail;
+  atomic_uint u32DroppedOldest;
+  atomic_uint u32DroppedNewest;
+  uint32_t u32Pushed;
+  uint32_t u32Popped;
+  uint32_t u32HighWater;
+  app_ring_policy_t ePolicy;
+  app_tag_t tstSlots[APP_RING_CAPACITY];
+}app_ring_t;
+
+void app_ring_init(app_ring_t *, app_ring_policy_t);
+esp_err_t app_ring_push(app_ring_t *, const app_tag_t *);
+esp_err_t app_ring_pop(app_ring_t *, app_tag_t *);
+uint32_t app_ring_count(app_ring_t *);
+void app_ring_get_stats(app_ring_t *, app_ring_stats_t *);
+
+#endif /* _APP_RING_H_ */
\ No newline at end of file
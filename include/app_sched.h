@@ -0,0 +1,35 @@
+#ifndef _APP_SCHED_H_
+#define _APP_SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_err.h>
+
+/* Keep in sync with the plan in src/app_sched.c */
+typedef enum
+{
+  APP_SCHED_TASK_READER = 0,
+  APP_SCHED_TASK_FIRESTORE,
+  APP_SCHED_TASK_OTA,
+  APP_SCHED_TASK_SYNC,
+  APP_SCHED_TASK_TRACE,
+  APP_SCHED_TASK_MONITOR,
+  APP_SCHED_TASK_COUNT,
+}app_sched_task_t;
+
+typedef struct
+{
+  uint32_t u32CpuPercent;
+  uint32_t u32StackHighWaterMark;
+}app_sched_task_stats_t;
+
+esp_err_t app_sched_create(app_sched_task_t, TaskFunction_t, void *);
+void app_sched_set_busy(bool);
+esp_err_t app_sched_get_stats(app_sched_task_t, app_sched_task_stats_t *);
+void app_sched_start(void);
+
+#endif /* _APP_SCHED_H_ */
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef _APP_SYNC_H_
+#define _APP_SYNC_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef struct
+{
+  uint32_t u32Runs;
+  uint32_t u32Documents;
+  uint32_t u32BytesSent;
+  uint32_t u32BytesReceived;
+  uint32_t u32LastDurationMs;
+}app_sync_stats_t;
+
+void app_sync_start(void);
+esp_err_t app_sync_run(void);
+void app_sync_get_stats(app_sync_stats_t *);
+
+#endif /* _APP_SYNC_H_ */
\ No newline at end of file
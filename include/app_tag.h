@@ -0,0 +1,21 @@
+#ifndef _APP_TAG_H_
+#define _APP_TAG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Triple size UID */
+#define APP_TAG_UID_MAX_SIZE                     10
+
+/* Self-contained tag read, copied by value through the upload pipeline */
+typedef struct
+{
+  uint8_t tu08Uid[APP_TAG_UID_MAX_SIZE];
+  uint8_t u08UidLength;
+  uint8_t u08ReaderId;
+  /* Access decision taken when the tag was read */
+  bool bGranted;
+  int64_t s64CaptureUs;
+}app_tag_t;
+
+#endif /* _APP_TAG_H_ */
\ No newline at end of file
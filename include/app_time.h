@@ -1,9 +1,23 @@
 #ifndef _APP_TIME_H_
 #define _APP_TIME_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #include <esp_err.h>
 
-void app_time_init(void);
-esp_err_t app_time_get_timestamp(int64_t *);
+typedef struct
+{
+  uint32_t u32Syncs;
+  int64_t s64OffsetUs;
+  int64_t s64LastSyncUs;
+  int64_t s64LastStepUs;
+  int32_t s32DriftPpb;
+}app_time_stats_t;
+
+void app_time_start(void);
+bool app_time_is_pending(void);
+esp_err_t app_time_to_unix_ms(int64_t, int64_t *);
+void app_time_get_stats(app_time_stats_t *);
 
 #endif /* _APP_TIME_H_ */
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef _APP_TRACE_H_
+#define _APP_TRACE_H_
+
+#include <stdint.h>
+
+/* Keep in sync with POINTS in tools/trace_decoder.py */
+typedef enum
+{
+  APP_TRACE_TAG_HANDLER = 0,
+  APP_TRACE_QUEUE_DWELL,
+  APP_TRACE_FORMAT,
+  APP_TRACE_TIMESTAMP,
+  APP_TRACE_CONNECT,
+  APP_TRACE_SEND,
+  APP_TRACE_WAIT,
+  APP_TRACE_RECEIVE,
+  APP_TRACE_REQUEST,
+  APP_TRACE_POINT_COUNT,
+}app_trace_point_t;
+
+/* Cycle counters are per core, a span that ends on another core is dropped */
+typedef struct
+{
+  uint32_t u32Cycles;
+  uint32_t u32Core;
+}app_trace_span_t;
+
+void app_trace_begin(app_trace_span_t *);
+void app_trace_end(app_trace_span_t *, app_trace_point_t);
+void app_trace_record_us(app_trace_point_t, int64_t);
+void app_trace_dump(void);
+void app_trace_start(void);
+
+#endif /* _APP_TRACE_H_ */
\ No newline at end of file
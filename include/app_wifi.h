@@ -1,7 +1,32 @@
 #ifndef _APP_WIFI_H_
 #define _APP_WIFI_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+#define APP_WIFI_MAX_CALLBACKS                   4
+
+/* Called from the event loop with true once the node has an IP address and
+   false when it loses the AP, it must not block */
+typedef void (*app_wifi_cb_t)(bool);
+
+typedef struct
+{
+  uint32_t u32Connects;
+  uint32_t u32FastConnects;
+  uint32_t u32CacheMisses;
+  uint32_t u32Disconnects;
+  /* From the first attempt, at boot or after losing the AP, to the IP address */
+  uint32_t u32LastConnectMs;
+  uint32_t u32MaxConnectMs;
+}app_wifi_stats_t;
+
 void app_wifi_init(void);
 void app_wifi_wait(void);
+bool app_wifi_is_connected(void);
+esp_err_t app_wifi_register_cb(app_wifi_cb_t);
+void app_wifi_get_stats(app_wifi_stats_t *);
 
 #endif /* _APP_WIFI_H_ */
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef _HOST_GPIO_H_
+#define _HOST_GPIO_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#define GPIO_MODE_INPUT                          1
+#define GPIO_PULLUP_DISABLE                      0
+#define GPIO_PULLUP_ENABLE                       1
+#define GPIO_PULLDOWN_DISABLE                    0
+#define GPIO_INTR_DISABLE                        0
+#define GPIO_INTR_NEGEDGE                        2
+
+typedef void (*gpio_isr_t)(void *);
+
+typedef struct
+{
+  uint64_t pin_bit_mask;
+  int mode;
+  int pull_up_en;
+  int pull_down_en;
+  int intr_type;
+}gpio_config_t;
+
+esp_err_t gpio_config(const gpio_config_t *);
+esp_err_t gpio_install_isr_service(int);
+/* The handler runs on the thread of the simulated reader raising the line */
+esp_err_t gpio_isr_handler_add(int, gpio_isr_t, void *);
+
+#endif /* _HOST_GPIO_H_ */
\ No newline at end of file
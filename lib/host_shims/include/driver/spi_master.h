@@ -0,0 +1,50 @@
+#ifndef _HOST_SPI_MASTER_H_
+#define _HOST_SPI_MASTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+
+#define HSPI_HOST                                1
+#define VSPI_HOST                                2
+#define SPI_TRANS_USE_RXDATA                     (1 << 2)
+#define SPI_TRANS_USE_TXDATA                     (1 << 3)
+
+/* Every device is an MFRC522 simulated by host_rc522.c, told apart by CS */
+typedef struct host_rc522 *spi_device_handle_t;
+
+typedef struct
+{
+  int miso_io_num;
+  int mosi_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+}spi_bus_config_t;
+
+typedef struct
+{
+  int clock_speed_hz;
+  uint8_t mode;
+  int spics_io_num;
+  int queue_size;
+}spi_device_interface_config_t;
+
+typedef struct
+{
+  uint32_t flags;
+  size_t length;
+  const void *tx_buffer;
+  void *rx_buffer;
+  uint8_t tx_data[4];
+  uint8_t rx_data[4];
+}spi_transaction_t;
+
+esp_err_t spi_bus_initialize(int, const spi_bus_config_t *, int);
+esp_err_t spi_bus_add_device(int, const spi_device_interface_config_t *, spi_device_handle_t *);
+esp_err_t spi_bus_remove_device(spi_device_handle_t);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t, spi_transaction_t *);
+
+#endif /* _HOST_SPI_MASTER_H_ */
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef _HOST_ESP32_CLK_H_
+#define _HOST_ESP32_CLK_H_
+
+/* 240 MHz like the board */
+int esp_clk_cpu_freq(void);
+
+#endif /* _HOST_ESP32_CLK_H_ */
\ No newline at end of file
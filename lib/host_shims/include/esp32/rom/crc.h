@@ -0,0 +1,9 @@
+#ifndef _HOST_ROM_CRC_H_
+#define _HOST_ROM_CRC_H_
+
+#include <stdint.h>
+
+/* CRC-32 of the ROM, the seed and the result are inverted */
+uint32_t crc32_le(uint32_t, const uint8_t *, uint32_t);
+
+#endif /* _HOST_ROM_CRC_H_ */
\ No newline at end of file
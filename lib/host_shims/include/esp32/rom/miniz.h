@@ -0,0 +1,33 @@
+#ifndef _HOST_ROM_MINIZ_H_
+#define _HOST_ROM_MINIZ_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <zlib.h>
+
+/* tinfl of the ROM over zlib, the output wraps around a dictionary of
+   TINFL_LZ_DICT_SIZE bytes like in the ROM */
+#define TINFL_LZ_DICT_SIZE                       32768
+#define TINFL_FLAG_PARSE_ZLIB_HEADER             1
+#define TINFL_FLAG_HAS_MORE_INPUT                2
+
+typedef enum
+{
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+}tinfl_status;
+
+typedef struct
+{
+  z_stream stStream;
+  int s32Started;
+}tinfl_decompressor;
+
+#define tinfl_init(r)                            ((r)->s32Started = 0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *, const uint8_t *, size_t *, uint8_t *, uint8_t *, size_t *, uint32_t);
+
+#endif /* _HOST_ROM_MINIZ_H_ */
\ No newline at end of file
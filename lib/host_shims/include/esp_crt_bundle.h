@@ -0,0 +1,8 @@
+#ifndef _HOST_ESP_CRT_BUNDLE_H_
+#define _HOST_ESP_CRT_BUNDLE_H_
+
+#include <esp_err.h>
+
+esp_err_t esp_crt_bundle_attach(void *);
+
+#endif /* _HOST_ESP_CRT_BUNDLE_H_ */
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef _HOST_ESP_ERR_H_
+#define _HOST_ESP_ERR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                                   0
+#define ESP_FAIL                                 -1
+#define ESP_ERR_NO_MEM                           0x101
+#define ESP_ERR_INVALID_ARG                      0x102
+#define ESP_ERR_INVALID_STATE                    0x103
+#define ESP_ERR_INVALID_SIZE                     0x104
+#define ESP_ERR_NOT_FOUND                        0x105
+#define ESP_ERR_NOT_SUPPORTED                    0x106
+#define ESP_ERR_TIMEOUT                          0x107
+#define ESP_ERR_INVALID_RESPONSE                 0x108
+#define ESP_ERR_INVALID_CRC                      0x109
+#define ESP_ERR_INVALID_VERSION                  0x10A
+#define ESP_ERR_INVALID_MAC                      0x10B
+
+const char *esp_err_to_name(esp_err_t);
+
+#define ESP_ERROR_CHECK(x)                       do                                                   \
+                                                 {                                                    \
+                                                   esp_err_t s32Err = (x);                            \
+                                                   if(ESP_OK != s32Err)                               \
+                                                   {                                                  \
+                                                     printf("%s:%d %s\n", __FILE__, __LINE__,         \
+                                                            esp_err_to_name(s32Err));                 \
+                                                     abort();                                         \
+                                                   }                                                  \
+                                                 }while(0)
+
+#endif /* _HOST_ESP_ERR_H_ */
\ No newline at end of file
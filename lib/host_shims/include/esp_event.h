@@ -0,0 +1,19 @@
+#ifndef _HOST_ESP_EVENT_H_
+#define _HOST_ESP_EVENT_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#define ESP_EVENT_DECLARE_BASE(id)               extern esp_event_base_t const id
+#define ESP_EVENT_ANY_ID                         -1
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *, esp_event_base_t, int32_t, void *);
+
+/* The default loop runs the handlers on the thread that posts, the simulated
+   driver of host_shims.h posts from esp_timer */
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t, int32_t, esp_event_handler_t, void *);
+
+#endif /* _HOST_ESP_EVENT_H_ */
\ No newline at end of file
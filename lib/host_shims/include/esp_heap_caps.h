@@ -0,0 +1,18 @@
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <multi_heap.h>
+
+/* A single internal RAM heap, see host_heap_reset() */
+#define MALLOC_CAP_8BIT                          (1 << 2)
+#define MALLOC_CAP_INTERNAL                      (1 << 11)
+
+void *heap_caps_malloc(size_t, uint32_t);
+void *heap_caps_calloc(size_t, size_t, uint32_t);
+void heap_caps_free(void *);
+void heap_caps_get_info(multi_heap_info_t *, uint32_t);
+
+#endif /* _HOST_ESP_HEAP_CAPS_H_ */
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef _HOST_ESP_HTTP_CLIENT_H_
+#define _HOST_ESP_HTTP_CLIENT_H_
+
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+typedef enum
+{
+  HTTP_METHOD_GET = 0,
+  HTTP_METHOD_POST,
+  HTTP_METHOD_PUT,
+  HTTP_METHOD_PATCH,
+  HTTP_METHOD_DELETE,
+}esp_http_client_method_t;
+
+typedef enum
+{
+  HTTP_EVENT_ERROR = 0,
+  HTTP_EVENT_ON_CONNECTED,
+  HTTP_EVENT_HEADERS_SENT,
+  HTTP_EVENT_ON_HEADER,
+  HTTP_EVENT_ON_DATA,
+  HTTP_EVENT_ON_FINISH,
+  HTTP_EVENT_DISCONNECTED,
+}esp_http_client_event_id_t;
+
+typedef struct host_http_client *esp_http_client_handle_t;
+
+typedef struct
+{
+  esp_http_client_event_id_t event_id;
+  esp_http_client_handle_t client;
+  void *data;
+  int data_len;
+  void *user_data;
+  char *header_key;
+  char *header_value;
+}esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *);
+
+/* Only the fields the application sets, requests are answered by the handler
+   given to host_http_set_handler() */
+typedef struct
+{
+  const char *url;
+  const char *cert_pem;
+  esp_http_client_method_t method;
+  int timeout_ms;
+  http_event_handle_cb event_handler;
+  int buffer_size;
+  int buffer_size_tx;
+  void *user_data;
+  esp_err_t (*crt_bundle_attach)(void *);
+}esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t, const char *);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t, esp_http_client_method_t);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t, const char *, int);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t, const char *, const char *);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t, const char *);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t);
+esp_err_t esp_http_client_open(esp_http_client_handle_t, int);
+int esp_http_client_fetch_headers(esp_http_client_handle_t);
+int esp_http_client_read(esp_http_client_handle_t, char *, int);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t);
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t);
+int esp_http_client_get_status_code(esp_http_client_handle_t);
+int esp_http_client_get_content_length(esp_http_client_handle_t);
+esp_err_t esp_http_client_close(esp_http_client_handle_t);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t);
+
+#endif /* _HOST_ESP_HTTP_CLIENT_H_ */
\ No newline at end of file
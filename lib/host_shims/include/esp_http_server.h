@@ -0,0 +1,68 @@
+#ifndef _HOST_ESP_HTTP_SERVER_H_
+#define _HOST_ESP_HTTP_SERVER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_err.h>
+
+#define HTTPD_RESP_USE_STRLEN                    -1
+#define HTTPD_DEFAULT_CONFIG()                   {                                  \
+                                                   .task_priority = 5,              \
+                                                   .stack_size = 4096,              \
+                                                   .core_id = tskNO_AFFINITY,       \
+                                                   .server_port = 80,               \
+                                                   .max_open_sockets = 7,           \
+                                                   .max_uri_handlers = 8,           \
+                                                   .lru_purge_enable = false,       \
+                                                 }
+
+typedef struct host_httpd *httpd_handle_t;
+
+typedef enum
+{
+  HTTP_DELETE = 0,
+  HTTP_GET,
+  HTTP_HEAD,
+  HTTP_POST,
+  HTTP_PUT,
+}httpd_method_t;
+
+typedef struct
+{
+  unsigned task_priority;
+  size_t stack_size;
+  BaseType_t core_id;
+  uint16_t server_port;
+  uint16_t max_open_sockets;
+  uint16_t max_uri_handlers;
+  bool lru_purge_enable;
+}httpd_config_t;
+
+typedef struct httpd_req
+{
+  httpd_handle_t handle;
+  int method;
+  const char *uri;
+  void *user_ctx;
+}httpd_req_t;
+
+typedef struct
+{
+  const char *uri;
+  httpd_method_t method;
+  esp_err_t (*handler)(httpd_req_t *);
+  void *user_ctx;
+}httpd_uri_t;
+
+/* No socket is opened, requests are made with host_httpd_get() of
+   host_shims.h on the thread of the test */
+esp_err_t httpd_start(httpd_handle_t *, const httpd_config_t *);
+esp_err_t httpd_stop(httpd_handle_t);
+esp_err_t httpd_register_uri_handler(httpd_handle_t, const httpd_uri_t *);
+esp_err_t httpd_resp_set_type(httpd_req_t *, const char *);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *, const char *, ssize_t);
+
+#endif /* _HOST_ESP_HTTP_SERVER_H_ */
\ No newline at end of file
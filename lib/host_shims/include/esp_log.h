@@ -0,0 +1,15 @@
+#ifndef _HOST_ESP_LOG_H_
+#define _HOST_ESP_LOG_H_
+
+#include <stdint.h>
+
+/* Errors and warnings are printed, define HOST_LOG_VERBOSE for the rest */
+void host_log(char, const char *, const char *, ...);
+
+#define ESP_LOGE(tag, format, ...)               host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)               host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)               host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)               host_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)               host_log('V', tag, format, ##__VA_ARGS__)
+
+#endif /* _HOST_ESP_LOG_H_ */
\ No newline at end of file
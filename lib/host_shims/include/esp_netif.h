@@ -0,0 +1,77 @@
+#ifndef _HOST_ESP_NETIF_H_
+#define _HOST_ESP_NETIF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+#include <esp_event.h>
+
+#define ESP_IPADDR_TYPE_V4                       0
+#define IPSTR                                    "%d.%d.%d.%d"
+#define esp_ip4_addr_get_byte(ipaddr, idx)       (((const uint8_t *)(&(ipaddr)->addr))[idx])
+#define IP2STR(ipaddr)                           esp_ip4_addr_get_byte(ipaddr, 0), \
+                                                 esp_ip4_addr_get_byte(ipaddr, 1), \
+                                                 esp_ip4_addr_get_byte(ipaddr, 2), \
+                                                 esp_ip4_addr_get_byte(ipaddr, 3)
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum
+{
+  IP_EVENT_STA_GOT_IP,
+  IP_EVENT_STA_LOST_IP,
+}ip_event_t;
+
+typedef enum
+{
+  ESP_NETIF_DNS_MAIN,
+  ESP_NETIF_DNS_BACKUP,
+  ESP_NETIF_DNS_FALLBACK,
+}esp_netif_dns_type_t;
+
+typedef struct host_netif esp_netif_t;
+
+typedef struct
+{
+  uint32_t addr;
+}esp_ip4_addr_t;
+
+typedef struct
+{
+  union
+  {
+    esp_ip4_addr_t ip4;
+  }u_addr;
+  uint8_t type;
+}esp_ip_addr_t;
+
+typedef struct
+{
+  esp_ip4_addr_t ip;
+  esp_ip4_addr_t netmask;
+  esp_ip4_addr_t gw;
+}esp_netif_ip_info_t;
+
+typedef struct
+{
+  esp_ip_addr_t ip;
+}esp_netif_dns_info_t;
+
+typedef struct
+{
+  esp_netif_t *esp_netif;
+  esp_netif_ip_info_t ip_info;
+  bool ip_changed;
+}ip_event_got_ip_t;
+
+/* One station interface, DHCP hands out the lease of the simulated AP */
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *);
+esp_err_t esp_netif_set_ip_info(esp_netif_t *, const esp_netif_ip_info_t *);
+esp_err_t esp_netif_set_dns_info(esp_netif_t *, esp_netif_dns_type_t, esp_netif_dns_info_t *);
+esp_err_t esp_netif_get_dns_info(esp_netif_t *, esp_netif_dns_type_t, esp_netif_dns_info_t *);
+uint32_t esp_ip4addr_aton(const char *);
+
+#endif /* _HOST_ESP_NETIF_H_ */
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _HOST_ESP_OTA_OPS_H_
+#define _HOST_ESP_OTA_OPS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+#include <esp_partition.h>
+
+#define OTA_SIZE_UNKNOWN                         0xFFFFFFFF
+
+typedef uint32_t esp_ota_handle_t;
+
+/* The factory partition runs until another one is set to boot */
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *);
+const esp_partition_t *esp_ota_get_boot_partition(void);
+esp_err_t esp_ota_begin(const esp_partition_t *, size_t, esp_ota_handle_t *);
+esp_err_t esp_ota_write(esp_ota_handle_t, const void *, size_t);
+esp_err_t esp_ota_end(esp_ota_handle_t);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *);
+
+#endif /* _HOST_ESP_OTA_OPS_H_ */
\ No newline at end of file
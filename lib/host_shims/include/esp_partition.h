@@ -0,0 +1,44 @@
+#ifndef _HOST_ESP_PARTITION_H_
+#define _HOST_ESP_PARTITION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+#include <esp_spi_flash.h>
+
+typedef enum
+{
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01,
+}esp_partition_type_t;
+
+typedef enum
+{
+  ESP_PARTITION_SUBTYPE_APP_FACTORY = 0x00,
+  ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+  ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11,
+  ESP_PARTITION_SUBTYPE_ANY = 0xFF,
+}esp_partition_subtype_t;
+
+typedef struct
+{
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+}esp_partition_t;
+
+/* The partitions of partitions.csv are kept in RAM, a write only clears bits
+   like NOR flash does and an erase sets whole sectors back to 0xFF */
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t, esp_partition_subtype_t, const char *);
+esp_err_t esp_partition_read(const esp_partition_t *, size_t, void *, size_t);
+esp_err_t esp_partition_write(const esp_partition_t *, size_t, const void *, size_t);
+esp_err_t esp_partition_erase_range(const esp_partition_t *, size_t, size_t);
+esp_err_t esp_partition_mmap(const esp_partition_t *, size_t, size_t, spi_flash_mmap_memory_t,
+                             const void **, spi_flash_mmap_handle_t *);
+
+#endif /* _HOST_ESP_PARTITION_H_ */
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef _HOST_ESP_SNTP_H_
+#define _HOST_ESP_SNTP_H_
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#define SNTP_OPMODE_POLL                         0
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *);
+
+void sntp_setoperatingmode(uint8_t);
+void sntp_setservername(uint8_t, const char *);
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t);
+void sntp_set_sync_interval(uint32_t);
+void sntp_init(void);
+
+/* The RTC of a node starts unset, host_rtc_set() keeps a time across a
+   simulated reset instead of the clock of the host */
+int host_rtc_get(struct timeval *, void *);
+#define gettimeofday(tv, tz)                     host_rtc_get(tv, tz)
+
+#endif /* _HOST_ESP_SNTP_H_ */
\ No newline at end of file
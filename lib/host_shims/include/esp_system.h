@@ -0,0 +1,21 @@
+#ifndef _HOST_ESP_SYSTEM_H_
+#define _HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef enum
+{
+  ESP_MAC_WIFI_STA = 0,
+}esp_mac_type_t;
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+/* Same sequence on every run */
+uint32_t esp_random(void);
+void esp_restart(void);
+/* 24:0A:C4:A1:B2:C3 for every interface */
+esp_err_t esp_read_mac(uint8_t *, esp_mac_type_t);
+
+#endif /* _HOST_ESP_SYSTEM_H_ */
\ No newline at end of file
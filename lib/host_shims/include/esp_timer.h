@@ -0,0 +1,29 @@
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *);
+
+typedef struct
+{
+  esp_timer_cb_t callback;
+  void *arg;
+  const char *name;
+}esp_timer_create_args_t;
+
+/* Microseconds since the test started, or the manual clock of host_shims.h */
+int64_t esp_timer_get_time(void);
+
+/* Timers only fire on the manual clock, from host_time_advance_us() on the
+   thread that advances it */
+esp_err_t esp_timer_create(const esp_timer_create_args_t *, esp_timer_handle_t *);
+esp_err_t esp_timer_start_once(esp_timer_handle_t, uint64_t);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t);
+esp_err_t esp_timer_stop(esp_timer_handle_t);
+esp_err_t esp_timer_delete(esp_timer_handle_t);
+
+#endif /* _HOST_ESP_TIMER_H_ */
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef _HOST_ESP_WIFI_H_
+#define _HOST_ESP_WIFI_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+#include <esp_event.h>
+
+#define WIFI_INIT_CONFIG_DEFAULT()               {.magic = 0x1F2F3F4F}
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+typedef enum
+{
+  WIFI_EVENT_WIFI_READY,
+  WIFI_EVENT_SCAN_DONE,
+  WIFI_EVENT_STA_START,
+  WIFI_EVENT_STA_STOP,
+  WIFI_EVENT_STA_CONNECTED,
+  WIFI_EVENT_STA_DISCONNECTED,
+}wifi_event_t;
+
+typedef enum
+{
+  WIFI_REASON_BEACON_TIMEOUT = 200,
+  WIFI_REASON_NO_AP_FOUND = 201,
+}wifi_err_reason_t;
+
+typedef enum
+{
+  WIFI_MODE_NULL,
+  WIFI_MODE_STA,
+  WIFI_MODE_AP,
+  WIFI_MODE_APSTA,
+}wifi_mode_t;
+
+typedef enum
+{
+  ESP_IF_WIFI_STA,
+  ESP_IF_WIFI_AP,
+}esp_interface_t;
+
+typedef enum
+{
+  WIFI_AUTH_OPEN,
+  WIFI_AUTH_WEP,
+  WIFI_AUTH_WPA_PSK,
+  WIFI_AUTH_WPA2_PSK,
+}wifi_auth_mode_t;
+
+typedef struct
+{
+  int magic;
+}wifi_init_config_t;
+
+typedef struct
+{
+  int8_t rssi;
+  wifi_auth_mode_t authmode;
+}wifi_scan_threshold_t;
+
+typedef struct
+{
+  bool capable;
+  bool required;
+}wifi_pmf_config_t;
+
+typedef struct
+{
+  uint8_t ssid[32];
+  uint8_t password[64];
+  bool bssid_set;
+  uint8_t bssid[6];
+  uint8_t channel;
+  wifi_scan_threshold_t threshold;
+  wifi_pmf_config_t pmf_cfg;
+}wifi_sta_config_t;
+
+typedef union
+{
+  wifi_sta_config_t sta;
+}wifi_config_t;
+
+typedef struct
+{
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t channel;
+  wifi_auth_mode_t authmode;
+}wifi_event_sta_connected_t;
+
+typedef struct
+{
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+}wifi_event_sta_disconnected_t;
+
+typedef struct
+{
+  uint8_t bssid[6];
+  uint8_t primary;
+  int8_t rssi;
+}wifi_ap_record_t;
+
+/* A station against the simulated AP of host_shims.h, a config with a channel
+   and a BSSID probes that channel only, any other scans them all */
+esp_err_t esp_wifi_init(const wifi_init_config_t *);
+esp_err_t esp_wifi_set_mode(wifi_mode_t);
+esp_err_t esp_wifi_set_config(esp_interface_t, wifi_config_t *);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *);
+
+#endif /* _HOST_ESP_WIFI_H_ */
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include <sdkconfig.h>
+
+#define configTICK_RATE_HZ                       CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS                       (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY                            ((TickType_t)0xFFFFFFFFUL)
+#define portNUM_PROCESSORS                       2
+#define pdMS_TO_TICKS(ms)                        ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTRUE                                   1
+#define pdFALSE                                  0
+#define pdPASS                                   pdTRUE
+#define pdFAIL                                   pdFALSE
+#define tskNO_AFFINITY                           0x7FFFFFFF
+#define IRAM_ATTR
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+/* Spinlocks are busy waits on a flag, tasks are threads of the host */
+typedef struct
+{
+  atomic_flag stFlag;
+}portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED             {ATOMIC_FLAG_INIT}
+
+static inline void host_port_enter(portMUX_TYPE *pstMux)
+{
+  while(atomic_flag_test_and_set_explicit(&pstMux->stFlag, memory_order_acquire))
+  {
+    sched_yield();
+  }
+}
+
+static inline void host_port_exit(portMUX_TYPE *pstMux)
+{
+  atomic_flag_clear_explicit(&pstMux->stFlag, memory_order_release);
+}
+
+static inline void vPortCPUInitializeMutex(portMUX_TYPE *pstMux)
+{
+  atomic_flag_clear(&pstMux->stFlag);
+}
+
+#define portENTER_CRITICAL(mux)                  host_port_enter(mux)
+#define portEXIT_CRITICAL(mux)                   host_port_exit(mux)
+#define portENTER_CRITICAL_ISR(mux)              host_port_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)               host_port_exit(mux)
+#define portYIELD_FROM_ISR()                     sched_yield()
+#define portSET_INTERRUPT_MASK_FROM_ISR()        0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(state) ((void)(state))
+
+/* Core of the calling task, see host_task_set_core() */
+BaseType_t xPortGetCoreID(void);
+
+#endif /* _HOST_FREERTOS_H_ */
\ No newline at end of file
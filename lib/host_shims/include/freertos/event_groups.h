@@ -0,0 +1,19 @@
+#ifndef _HOST_EVENT_GROUPS_H_
+#define _HOST_EVENT_GROUPS_H_
+
+#include <freertos/FreeRTOS.h>
+
+/* From esp_bit_defs.h */
+#define BIT0                                     0x00000001
+#define BIT1                                     0x00000002
+
+typedef struct host_event_group *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t, EventBits_t);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t, EventBits_t);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t, EventBits_t, BaseType_t, BaseType_t, TickType_t);
+
+#endif /* _HOST_EVENT_GROUPS_H_ */
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef _HOST_SEMPHR_H_
+#define _HOST_SEMPHR_H_
+
+#include <freertos/FreeRTOS.h>
+
+typedef struct host_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t);
+void vSemaphoreDelete(SemaphoreHandle_t);
+
+#endif /* _HOST_SEMPHR_H_ */
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef _HOST_TASK_H_
+#define _HOST_TASK_H_
+
+#include <freertos/FreeRTOS.h>
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define taskYIELD()                              sched_yield()
+#define tskIDLE_PRIORITY                         0
+
+typedef struct
+{
+  TaskHandle_t xHandle;
+  UBaseType_t uxCurrentPriority;
+  uint32_t ulRunTimeCounter;
+  uint32_t usStackHighWaterMark;
+}TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t);
+BaseType_t xTaskCreate(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+/* Advances the manual clock instead of sleeping while it is on */
+void vTaskDelay(TickType_t);
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t);
+BaseType_t xTaskNotifyGive(TaskHandle_t);
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *);
+void vTaskPrioritySet(TaskHandle_t, UBaseType_t);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *, UBaseType_t, uint32_t *);
+
+#endif /* _HOST_TASK_H_ */
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef _HOST_SHIMS_H_
+#define _HOST_SHIMS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+#include <esp_partition.h>
+
+#include "app_conn.h"
+
+/* Clock: esp_timer, the tick count and vTaskDelay() follow the manual clock
+   while it is on, a delay then advances it instead of sleeping */
+void host_time_set_manual(int64_t);
+void host_time_advance_us(int64_t);
+void host_time_set_real(void);
+
+/* Moves the calling task to another core, tasks start on the core they are
+   pinned to or on core 0 */
+void host_task_set_core(int);
+
+/* Flash: every partition back to erased */
+void host_flash_reset(void);
+uint32_t host_flash_get_erases(const esp_partition_t *);
+const uint8_t *host_flash_get_data(const esp_partition_t *);
+
+/* Wall clock: host_rtc_set() is what the RTC kept across a reset,
+   host_sntp_sync() runs the callback given to SNTP */
+void host_rtc_set(int64_t);
+void host_sntp_sync(int64_t);
+
+/* NVS: host_nvs_get_writes() counts the values set since the last reset */
+void host_nvs_reset(void);
+uint32_t host_nvs_get_writes(void);
+
+/* Internal RAM: heap_caps_*() serve 192 KB laid out like a multi_heap,
+   host_heap_reset() frees all of it */
+void host_heap_reset(void);
+
+/* Wi-Fi: one AP on a channel, the station spends the times below on the
+   manual clock to scan every channel or probe the cached one, to associate
+   and to get a lease. Its events are posted from esp_timer, so the clock has
+   to be advanced for them. host_wifi_reset() is a reboot, NVS is kept */
+typedef struct
+{
+  uint32_t u32ScanMs;
+  uint32_t u32ProbeMs;
+  uint32_t u32AssocMs;
+  uint32_t u32DhcpMs;
+}host_wifi_timing_t;
+
+void host_wifi_reset(const host_wifi_timing_t *);
+void host_wifi_set_ap(bool, uint8_t, const uint8_t *);
+void host_wifi_drop(void);
+uint32_t host_wifi_get_attempts(void);
+uint32_t host_wifi_get_scans(void);
+
+/* MFRC522 on a CS pin: present or not, the tag in its field (length 0 for
+   none) and a SAK with a broken CRC_A. host_rc522_set_timing() delays the
+   answer of the tag and the timer expiry by microseconds of the clock and
+   has every SPI transaction take its bus time, all are immediate by default.
+   Transfers are the SPI transactions so far */
+void host_rc522_set_present(int, bool);
+void host_rc522_set_tag(int, const uint8_t *, uint8_t);
+void host_rc522_set_bad_crc(int, bool);
+void host_rc522_set_timing(int, uint32_t, uint32_t);
+uint32_t host_rc522_get_transfers(int);
+
+/* Backend: app_conn_request() is answered by this handler with the method,
+   the path, the body and its length, it feeds the answer to the data callback
+   and returns the HTTP status */
+typedef int (*host_conn_handler_t)(esp_http_client_method_t, const char *, const char *, uint32_t,
+                                   app_conn_data_cb_t, void *);
+void host_conn_set_handler(host_conn_handler_t);
+uint32_t host_conn_get_requests(void);
+
+/* HTTP client: esp_http_client requests are answered by this handler with the
+   method, the URL, the headers and the body set by the application, it fills
+   in the response and returns the HTTP status. A negative one is a transport
+   error, HOST_HTTP_RESPONSE_LOST once the request went out and any other one
+   before. Every request after a close or an error opens a new connection */
+#define HOST_HTTP_MAX_HEADERS                    8
+#define HOST_HTTP_CONNECT_FAILED                 (-1)
+#define HOST_HTTP_RESPONSE_LOST                  (-2)
+
+typedef struct
+{
+  const char *pcKey;
+  const char *pcValue;
+}host_http_header_t;
+
+typedef struct
+{
+  esp_http_client_method_t eMethod;
+  const char *pcUrl;
+  host_http_header_t tstHeaders[HOST_HTTP_MAX_HEADERS];
+  uint32_t u32Headers;
+  const char *pcBody;
+  uint32_t u32BodyLength;
+  bool bConnect;
+}host_http_request_t;
+
+typedef struct
+{
+  host_http_header_t tstHeaders[HOST_HTTP_MAX_HEADERS];
+  const char *pcBody;
+  uint32_t u32BodyLength;
+}host_http_response_t;
+
+typedef int (*host_http_handler_t)(const host_http_request_t *, host_http_response_t *);
+void host_http_set_handler(host_http_handler_t);
+const char *host_http_get_header(const host_http_request_t *, const char *);
+
+/* HTTP server: host_httpd_get() runs the GET handler of a URI of the server
+   started on a port, the chunks it sends are gathered in the body. Returns
+   ESP_ERR_NOT_FOUND without a server or handler */
+typedef struct
+{
+  char tcContentType[64];
+  uint32_t u32Length;
+  uint32_t u32Chunks;
+  uint32_t u32MaxChunk;
+  bool bFinished;
+}host_httpd_response_t;
+
+esp_err_t host_httpd_get(uint16_t, const char *, char *, uint32_t, host_httpd_response_t *);
+
+/* esp_restart() only counts */
+uint32_t host_get_restarts(void);
+
+#endif /* _HOST_SHIMS_H_ */
\ No newline at end of file
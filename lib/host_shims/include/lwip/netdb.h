@@ -0,0 +1,6 @@
+#ifndef _HOST_LWIP_NETDB_H_
+#define _HOST_LWIP_NETDB_H_
+
+#include <netdb.h>
+
+#endif /* _HOST_LWIP_NETDB_H_ */
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef _HOST_LWIP_SOCKETS_H_
+#define _HOST_LWIP_SOCKETS_H_
+
+/* The BSD socket API of lwIP is the one of the host */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#endif /* _HOST_LWIP_SOCKETS_H_ */
\ No newline at end of file
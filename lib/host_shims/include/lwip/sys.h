@@ -0,0 +1,6 @@
+#ifndef _HOST_LWIP_SYS_H_
+#define _HOST_LWIP_SYS_H_
+
+#include <lwip/sockets.h>
+
+#endif /* _HOST_LWIP_SYS_H_ */
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef _HOST_MBEDTLS_BASE64_H_
+#define _HOST_MBEDTLS_BASE64_H_
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL      -0x002A
+
+/* Writes the terminating NUL too, *olen excludes it */
+int mbedtls_base64_encode(unsigned char *, size_t, size_t *, const unsigned char *, size_t);
+
+#endif /* _HOST_MBEDTLS_BASE64_H_ */
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef _HOST_MBEDTLS_SHA256_H_
+#define _HOST_MBEDTLS_SHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+  uint32_t tu32State[8];
+  uint64_t u64Length;
+  uint8_t tu08Block[64];
+  uint32_t u32Used;
+}mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *);
+void mbedtls_sha256_free(mbedtls_sha256_context *);
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context *, int);
+int mbedtls_sha256_update_ret(mbedtls_sha256_context *, const unsigned char *, size_t);
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context *, unsigned char *);
+
+#endif /* _HOST_MBEDTLS_SHA256_H_ */
\ No newline at end of file
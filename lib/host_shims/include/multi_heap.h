@@ -0,0 +1,29 @@
+#ifndef _HOST_MULTI_HEAP_H_
+#define _HOST_MULTI_HEAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* First fit over a block list kept inside the region, freed neighbours are
+   merged. The bookkeeping lives in the region like with multi_heap */
+typedef struct host_heap *multi_heap_handle_t;
+
+typedef struct
+{
+  size_t total_free_bytes;
+  size_t total_allocated_bytes;
+  size_t largest_free_block;
+  size_t minimum_free_bytes;
+  size_t allocated_blocks;
+  size_t free_blocks;
+  size_t total_blocks;
+}multi_heap_info_t;
+
+multi_heap_handle_t multi_heap_register(void *, size_t);
+/* Each heap has a lock of its own on the host */
+void multi_heap_set_lock(multi_heap_handle_t, void *);
+void *multi_heap_malloc(multi_heap_handle_t, size_t);
+void multi_heap_free(multi_heap_handle_t, void *);
+void multi_heap_get_info(multi_heap_handle_t, multi_heap_info_t *);
+
+#endif /* _HOST_MULTI_HEAP_H_ */
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef _HOST_NVS_H_
+#define _HOST_NVS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <esp_err.h>
+
+#define ESP_ERR_NVS_BASE                         0x1100
+#define ESP_ERR_NVS_NOT_FOUND                    (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH               (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES                (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_VALUE_TOO_LONG               (ESP_ERR_NVS_BASE + 0x0e)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND            (ESP_ERR_NVS_BASE + 0x10)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum
+{
+  NVS_READONLY,
+  NVS_READWRITE,
+}nvs_open_mode_t;
+
+/* Strings and blobs up to 256 bytes, kept in RAM until host_nvs_reset() */
+esp_err_t nvs_open(const char *, nvs_open_mode_t, nvs_handle_t *);
+esp_err_t nvs_get_str(nvs_handle_t, const char *, char *, size_t *);
+esp_err_t nvs_set_str(nvs_handle_t, const char *, const char *);
+esp_err_t nvs_get_blob(nvs_handle_t, const char *, void *, size_t *);
+esp_err_t nvs_set_blob(nvs_handle_t, const char *, const void *, size_t);
+esp_err_t nvs_erase_key(nvs_handle_t, const char *);
+esp_err_t nvs_commit(nvs_handle_t);
+void nvs_close(nvs_handle_t);
+
+#endif /* _HOST_NVS_H_ */
\ No newline at end of file
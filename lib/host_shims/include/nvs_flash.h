@@ -0,0 +1,10 @@
+#ifndef _HOST_NVS_FLASH_H_
+#define _HOST_NVS_FLASH_H_
+
+#include <nvs.h>
+
+/* The partition is always ready, an erase is host_nvs_reset() */
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* _HOST_NVS_FLASH_H_ */
\ No newline at end of file
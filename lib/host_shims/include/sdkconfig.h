@@ -0,0 +1,105 @@
+#ifndef _HOST_SDKCONFIG_H_
+#define _HOST_SDKCONFIG_H_
+
+/* Defaults of src/Kconfig.projbuild, a profile is picked with
+   -DCONFIG_RFID_PROFILE_<name>=1 like menuconfig does */
+#if !defined(CONFIG_RFID_PROFILE_LOW_LATENCY) && !defined(CONFIG_RFID_PROFILE_HIGH_VOLUME) && \
+    !defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_PROFILE_BALANCED             1
+#endif
+
+#define CONFIG_FREERTOS_HZ                       100
+
+#if defined(CONFIG_RFID_PROFILE_LOW_LATENCY)
+#define CONFIG_RFID_TAG_RING_CAPACITY            16
+#define CONFIG_RFID_READER_SLOT_MS               20
+#define CONFIG_RFID_BATCH_WINDOW_MS              50
+#define CONFIG_RFID_BATCH_MAX_WRITES             4
+#define CONFIG_RFID_BATCH_BODY_SIZE              3072
+#define CONFIG_RFID_LANE_ALERT_DEADLINE_MS       50
+#define CONFIG_RFID_LANE_LIVE_DEADLINE_MS        250
+#define CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS    4
+#elif defined(CONFIG_RFID_PROFILE_HIGH_VOLUME)
+#define CONFIG_RFID_TAG_RING_CAPACITY            64
+#define CONFIG_RFID_READER_SLOT_MS               30
+#define CONFIG_RFID_BATCH_WINDOW_MS              2000
+#define CONFIG_RFID_BATCH_MAX_WRITES             32
+#define CONFIG_RFID_BATCH_BODY_SIZE              20480
+#define CONFIG_RFID_LANE_ALERT_DEADLINE_MS       100
+#define CONFIG_RFID_LANE_LIVE_DEADLINE_MS        5000
+#define CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS    16
+#elif defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_TAG_RING_CAPACITY            8
+#define CONFIG_RFID_READER_SLOT_MS               30
+#define CONFIG_RFID_BATCH_WINDOW_MS              1000
+#define CONFIG_RFID_BATCH_MAX_WRITES             8
+#define CONFIG_RFID_BATCH_BODY_SIZE              5120
+#define CONFIG_RFID_LANE_ALERT_DEADLINE_MS       100
+#define CONFIG_RFID_LANE_LIVE_DEADLINE_MS        2500
+#define CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS    8
+#else
+#define CONFIG_RFID_TAG_RING_CAPACITY            32
+#define CONFIG_RFID_READER_SLOT_MS               30
+#define CONFIG_RFID_BATCH_WINDOW_MS              1000
+#define CONFIG_RFID_BATCH_MAX_WRITES             16
+#define CONFIG_RFID_BATCH_BODY_SIZE              10240
+#define CONFIG_RFID_LANE_ALERT_DEADLINE_MS       100
+#define CONFIG_RFID_LANE_LIVE_DEADLINE_MS        2500
+#define CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS    8
+#endif
+
+#if defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_ACCESS_CACHE_ENTRIES         16
+#else
+#define CONFIG_RFID_ACCESS_CACHE_ENTRIES         32
+#endif
+#define CONFIG_RFID_ACCESS_GRANT_TTL_MS          300000
+#define CONFIG_RFID_ACCESS_DENY_TTL_MS           10000
+
+#if defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_OTA_HTTP_RX_BUFFER_SIZE      512
+#define CONFIG_RFID_OTA_HTTP_TX_BUFFER_SIZE      512
+#else
+#define CONFIG_RFID_OTA_HTTP_RX_BUFFER_SIZE      1024
+#define CONFIG_RFID_OTA_HTTP_TX_BUFFER_SIZE      1024
+#endif
+#define CONFIG_RFID_OTA_CHECK_PERIOD_MS          60000
+
+#if defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_READER_TASK_STACK_SIZE       2560
+#define CONFIG_RFID_UPLOAD_TASK_STACK_SIZE       8192
+#define CONFIG_RFID_OTA_TASK_STACK_SIZE          6144
+#define CONFIG_RFID_SYNC_TASK_STACK_SIZE         4096
+#define CONFIG_RFID_TRACE_TASK_STACK_SIZE        4096
+#else
+#define CONFIG_RFID_READER_TASK_STACK_SIZE       3072
+#if defined(CONFIG_RFID_PROFILE_HIGH_VOLUME)
+#define CONFIG_RFID_UPLOAD_TASK_STACK_SIZE       12288
+#else
+#define CONFIG_RFID_UPLOAD_TASK_STACK_SIZE       10240
+#endif
+#define CONFIG_RFID_OTA_TASK_STACK_SIZE          8192
+#define CONFIG_RFID_SYNC_TASK_STACK_SIZE         6144
+#define CONFIG_RFID_TRACE_TASK_STACK_SIZE        6144
+#endif
+#if defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_TLS_CONN_ARENA_SIZE          40960
+#define CONFIG_RFID_TLS_OTA_ARENA_SIZE           40960
+#else
+#define CONFIG_RFID_TLS_CONN_ARENA_SIZE          45056
+#define CONFIG_RFID_TLS_OTA_ARENA_SIZE           45056
+#endif
+#define CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN        16384
+#define CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN       4096
+
+#define CONFIG_RFID_METRICS_PERIOD_MS            300000
+#if defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define CONFIG_RFID_METRICS_HTTP_PORT            0
+#else
+#define CONFIG_RFID_METRICS_HTTP_PORT            80
+#endif
+
+#define CONFIG_RFID_READER_TASK_PRIORITY         6
+#define CONFIG_RFID_UPLOAD_TASK_PRIORITY         5
+
+#endif /* _HOST_SDKCONFIG_H_ */
\ No newline at end of file
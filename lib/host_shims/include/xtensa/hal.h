@@ -0,0 +1,10 @@
+#ifndef _HOST_XTENSA_HAL_H_
+#define _HOST_XTENSA_HAL_H_
+
+#include <stdint.h>
+
+/* Cycles of the CPU clock since boot, derived from esp_timer so the manual
+   clock drives it too */
+uint32_t xthal_get_ccount(void);
+
+#endif /* _HOST_XTENSA_HAL_H_ */
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "app_conn.h"
+#include "host_shims.h"
+
+/* Stand-ins for the modules built on the network stack. They are weak, test_conn
+   links the real app_conn.c over esp_http_client instead */
+typedef struct
+{
+  pthread_mutex_t stLock;
+  host_conn_handler_t pfHandler;
+  app_conn_stats_t stStats;
+}host_app_ctx_t;
+
+static host_app_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void host_conn_set_handler(host_conn_handler_t pfHandler)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.pfHandler = pfHandler;
+  memset(&stCtx.stStats, 0x00, sizeof(stCtx.stStats));
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+uint32_t host_conn_get_requests(void)
+{
+  return stCtx.stStats.u32Requests;
+}
+
+/* Requests are serialized like on the single connection of the node, a
+   negative status from the handler is a transport error */
+__attribute__((weak))
+esp_err_t app_conn_request(esp_http_client_method_t eMethod,
+                           const char *pcPath,
+                           const char *pcBody,
+                           uint32_t u32BodyLength,
+                           app_conn_data_cb_t pfDataCb,
+                           void *pvDataCbArg,
+                           int *ps32HttpCode)
+{
+  int s32HttpCode;
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.stStats.u32Requests++;
+  s32HttpCode = stCtx.pfHandler?stCtx.pfHandler(eMethod, pcPath, pcBody, u32BodyLength, pfDataCb, pvDataCbArg):-1;
+  if(s32HttpCode < 0)
+  {
+    stCtx.stStats.u32Failures++;
+    s32RetVal = ESP_FAIL;
+  }
+  else
+  {
+    s32RetVal = ESP_OK;
+    if(ps32HttpCode)
+    {
+      *ps32HttpCode = s32HttpCode;
+    }
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+__attribute__((weak))
+void app_conn_get_stats(app_conn_stats_t *pstStats)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  memcpy(pstStats, &stCtx.stStats, sizeof(app_conn_stats_t));
+  pthread_mutex_unlock(&stCtx.stLock);
+}
\ No newline at end of file
@@ -0,0 +1,474 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#include <esp_sntp.h>
+#include <esp32/clk.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <driver/gpio.h>
+
+#include "host_shims.h"
+#include "host_private.h"
+
+#define HOST_NVS_MAX_ENTRIES                     32
+#define HOST_NVS_MAX_KEY_SIZE                    32
+#define HOST_NVS_MAX_VALUE_SIZE                  256
+#define HOST_GPIO_MAX_HANDLERS                   8
+
+typedef struct
+{
+  char tcNamespace[HOST_NVS_MAX_KEY_SIZE];
+  char tcKey[HOST_NVS_MAX_KEY_SIZE];
+  char tcValue[HOST_NVS_MAX_VALUE_SIZE];
+  size_t u32Length;
+  bool bUsed;
+}host_nvs_entry_t;
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  const char *tpcNamespaces[HOST_NVS_MAX_ENTRIES];
+  uint32_t u32Namespaces;
+  host_nvs_entry_t tstNvs[HOST_NVS_MAX_ENTRIES];
+  uint32_t u32NvsWrites;
+  int64_t s64RtcUs;
+  sntp_sync_time_cb_t pfSntp;
+  gpio_isr_t tpfIsr[HOST_GPIO_MAX_HANDLERS];
+  void *tpvIsrArg[HOST_GPIO_MAX_HANDLERS];
+  uint32_t u32Isr;
+  uint32_t u32Random;
+  uint32_t u32Restarts;
+}host_esp_ctx_t;
+
+static host_esp_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+  .u32Random = 0x12345678,
+};
+
+const char *esp_err_to_name(esp_err_t s32Err)
+{
+  const char *pcName;
+
+  switch(s32Err)
+  {
+    case ESP_OK:                   pcName = "ESP_OK"; break;
+    case ESP_FAIL:                 pcName = "ESP_FAIL"; break;
+    case ESP_ERR_NO_MEM:           pcName = "ESP_ERR_NO_MEM"; break;
+    case ESP_ERR_INVALID_ARG:      pcName = "ESP_ERR_INVALID_ARG"; break;
+    case ESP_ERR_INVALID_STATE:    pcName = "ESP_ERR_INVALID_STATE"; break;
+    case ESP_ERR_INVALID_SIZE:     pcName = "ESP_ERR_INVALID_SIZE"; break;
+    case ESP_ERR_NOT_FOUND:        pcName = "ESP_ERR_NOT_FOUND"; break;
+    case ESP_ERR_NOT_SUPPORTED:    pcName = "ESP_ERR_NOT_SUPPORTED"; break;
+    case ESP_ERR_TIMEOUT:          pcName = "ESP_ERR_TIMEOUT"; break;
+    case ESP_ERR_INVALID_RESPONSE: pcName = "ESP_ERR_INVALID_RESPONSE"; break;
+    case ESP_ERR_INVALID_CRC:      pcName = "ESP_ERR_INVALID_CRC"; break;
+    case ESP_ERR_INVALID_VERSION:  pcName = "ESP_ERR_INVALID_VERSION"; break;
+    case ESP_ERR_INVALID_MAC:      pcName = "ESP_ERR_INVALID_MAC"; break;
+    default:                       pcName = "UNKNOWN ERROR"; break;
+  }
+  return pcName;
+}
+
+void host_log(char cLevel, const char *pcTag, const char *pcFormat, ...)
+{
+  va_list stArgs;
+
+#ifndef HOST_LOG_VERBOSE
+  if(('E' == cLevel) || ('W' == cLevel))
+#endif
+  {
+    va_start(stArgs, pcFormat);
+    printf("%c (%lld) %s: ", cLevel, (long long)(esp_timer_get_time() / 1000), pcTag);
+    vprintf(pcFormat, stArgs);
+    printf("\n");
+    va_end(stArgs);
+  }
+}
+
+/* Both follow the internal RAM of host_heap.c */
+uint32_t esp_get_free_heap_size(void)
+{
+  multi_heap_info_t stInfo;
+
+  heap_caps_get_info(&stInfo, MALLOC_CAP_INTERNAL);
+  return stInfo.total_free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+  multi_heap_info_t stInfo;
+
+  heap_caps_get_info(&stInfo, MALLOC_CAP_INTERNAL);
+  return stInfo.minimum_free_bytes;
+}
+
+int esp_clk_cpu_freq(void)
+{
+  return 240000000;
+}
+
+/* xorshift32 */
+uint32_t esp_random(void)
+{
+  uint32_t u32Random;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.u32Random ^= stCtx.u32Random << 13;
+  stCtx.u32Random ^= stCtx.u32Random >> 17;
+  stCtx.u32Random ^= stCtx.u32Random << 5;
+  u32Random = stCtx.u32Random;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return u32Random;
+}
+
+void esp_restart(void)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.u32Restarts++;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+esp_err_t esp_read_mac(uint8_t *pu08Mac, esp_mac_type_t eType)
+{
+  static const uint8_t tu08Mac[6] = {0x24, 0x0A, 0xC4, 0xA1, 0xB2, 0xC3};
+
+  memcpy(pu08Mac, tu08Mac, sizeof(tu08Mac));
+  return ESP_OK;
+}
+
+uint32_t host_get_restarts(void)
+{
+  return stCtx.u32Restarts;
+}
+
+/* RTC and SNTP */
+int host_rtc_get(struct timeval *pstTv, void *pvTz)
+{
+  int64_t s64NowUs;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  s64NowUs = stCtx.s64RtcUs;
+  pthread_mutex_unlock(&stCtx.stLock);
+  pstTv->tv_sec = s64NowUs / 1000000LL;
+  pstTv->tv_usec = s64NowUs % 1000000LL;
+  return 0;
+}
+
+void host_rtc_set(int64_t s64UnixUs)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.s64RtcUs = s64UnixUs;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+void host_sntp_sync(int64_t s64UnixUs)
+{
+  struct timeval stTv;
+
+  host_rtc_set(s64UnixUs);
+  stTv.tv_sec = s64UnixUs / 1000000LL;
+  stTv.tv_usec = s64UnixUs % 1000000LL;
+  if(stCtx.pfSntp)
+  {
+    stCtx.pfSntp(&stTv);
+  }
+}
+
+void sntp_setoperatingmode(uint8_t u08Mode)
+{
+}
+
+void sntp_setservername(uint8_t u08Index, const char *pcServer)
+{
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t pfCallback)
+{
+  stCtx.pfSntp = pfCallback;
+}
+
+void sntp_set_sync_interval(uint32_t u32IntervalMs)
+{
+}
+
+void sntp_init(void)
+{
+}
+
+/* NVS, a handle is the index of its namespace plus one */
+static host_nvs_entry_t *_host_nvs_find(nvs_handle_t u32Handle, const char *pcKey, bool bCreate)
+{
+  uint32_t u32Index;
+  host_nvs_entry_t *pstEntry;
+  host_nvs_entry_t *pstFree;
+
+  pstEntry = NULL;
+  pstFree = NULL;
+  for(u32Index = 0; (u32Index < HOST_NVS_MAX_ENTRIES) && (NULL == pstEntry); u32Index++)
+  {
+    if(!stCtx.tstNvs[u32Index].bUsed)
+    {
+      pstFree = pstFree?pstFree:&stCtx.tstNvs[u32Index];
+    }
+    else if((0 == strcmp(stCtx.tstNvs[u32Index].tcNamespace, stCtx.tpcNamespaces[u32Handle - 1])) &&
+            (0 == strcmp(stCtx.tstNvs[u32Index].tcKey, pcKey)))
+    {
+      pstEntry = &stCtx.tstNvs[u32Index];
+    }
+  }
+  if((NULL == pstEntry) && bCreate && pstFree)
+  {
+    pstEntry = pstFree;
+    memset(pstEntry, 0x00, sizeof(host_nvs_entry_t));
+    snprintf(pstEntry->tcNamespace, sizeof(pstEntry->tcNamespace), "%s", stCtx.tpcNamespaces[u32Handle - 1]);
+    snprintf(pstEntry->tcKey, sizeof(pstEntry->tcKey), "%s", pcKey);
+    pstEntry->bUsed = true;
+  }
+  return pstEntry;
+}
+
+void host_nvs_reset(void)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  memset(stCtx.tstNvs, 0x00, sizeof(stCtx.tstNvs));
+  stCtx.u32NvsWrites = 0;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+esp_err_t nvs_open(const char *pcNamespace, nvs_open_mode_t eMode, nvs_handle_t *pu32Handle)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_ERR_NO_MEM;
+  pthread_mutex_lock(&stCtx.stLock);
+  for(u32Index = 0; (u32Index < stCtx.u32Namespaces) && (ESP_OK != s32RetVal); u32Index++)
+  {
+    if(0 == strcmp(stCtx.tpcNamespaces[u32Index], pcNamespace))
+    {
+      *pu32Handle = u32Index + 1;
+      s32RetVal = ESP_OK;
+    }
+  }
+  if((ESP_OK != s32RetVal) && (stCtx.u32Namespaces < HOST_NVS_MAX_ENTRIES))
+  {
+    stCtx.tpcNamespaces[stCtx.u32Namespaces++] = strdup(pcNamespace);
+    *pu32Handle = stCtx.u32Namespaces;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t u32Handle, const char *pcKey, char *pcValue, size_t *pu32Length)
+{
+  size_t u32Length;
+  esp_err_t s32RetVal;
+  host_nvs_entry_t *pstEntry;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstEntry = _host_nvs_find(u32Handle, pcKey, false);
+  if(NULL == pstEntry)
+  {
+    s32RetVal = ESP_ERR_NVS_NOT_FOUND;
+  }
+  else
+  {
+    u32Length = strlen(pstEntry->tcValue) + 1;
+    if(NULL == pcValue)
+    {
+      s32RetVal = ESP_OK;
+    }
+    else if(*pu32Length < u32Length)
+    {
+      s32RetVal = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+      memcpy(pcValue, pstEntry->tcValue, u32Length);
+      s32RetVal = ESP_OK;
+    }
+    *pu32Length = u32Length;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t u32Handle, const char *pcKey, const char *pcValue)
+{
+  esp_err_t s32RetVal;
+  host_nvs_entry_t *pstEntry;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstEntry = _host_nvs_find(u32Handle, pcKey, true);
+  if(NULL == pstEntry)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    snprintf(pstEntry->tcValue, sizeof(pstEntry->tcValue), "%s", pcValue);
+    pstEntry->u32Length = strlen(pstEntry->tcValue) + 1;
+    stCtx.u32NvsWrites++;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t u32Handle, const char *pcKey, void *pvValue, size_t *pu32Length)
+{
+  esp_err_t s32RetVal;
+  host_nvs_entry_t *pstEntry;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstEntry = _host_nvs_find(u32Handle, pcKey, false);
+  if(NULL == pstEntry)
+  {
+    s32RetVal = ESP_ERR_NVS_NOT_FOUND;
+  }
+  else
+  {
+    if(NULL == pvValue)
+    {
+      s32RetVal = ESP_OK;
+    }
+    else if(*pu32Length < pstEntry->u32Length)
+    {
+      s32RetVal = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+      memcpy(pvValue, pstEntry->tcValue, pstEntry->u32Length);
+      s32RetVal = ESP_OK;
+    }
+    *pu32Length = pstEntry->u32Length;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t u32Handle, const char *pcKey, const void *pvValue, size_t u32Length)
+{
+  esp_err_t s32RetVal;
+  host_nvs_entry_t *pstEntry;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstEntry = (u32Length <= HOST_NVS_MAX_VALUE_SIZE)?_host_nvs_find(u32Handle, pcKey, true):NULL;
+  if(u32Length > HOST_NVS_MAX_VALUE_SIZE)
+  {
+    s32RetVal = ESP_ERR_NVS_VALUE_TOO_LONG;
+  }
+  else if(NULL == pstEntry)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    memcpy(pstEntry->tcValue, pvValue, u32Length);
+    pstEntry->u32Length = u32Length;
+    stCtx.u32NvsWrites++;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+uint32_t host_nvs_get_writes(void)
+{
+  uint32_t u32Writes;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  u32Writes = stCtx.u32NvsWrites;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return u32Writes;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+  return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+  host_nvs_reset();
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t u32Handle, const char *pcKey)
+{
+  esp_err_t s32RetVal;
+  host_nvs_entry_t *pstEntry;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstEntry = _host_nvs_find(u32Handle, pcKey, false);
+  if(NULL == pstEntry)
+  {
+    s32RetVal = ESP_ERR_NVS_NOT_FOUND;
+  }
+  else
+  {
+    pstEntry->bUsed = false;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t nvs_commit(nvs_handle_t u32Handle)
+{
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t u32Handle)
+{
+}
+
+/* GPIO, a raised IRQ line runs every handler */
+esp_err_t gpio_config(const gpio_config_t *pstConfig)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int s32Flags)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(int s32Pin, gpio_isr_t pfIsr, void *pvArg)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  if(stCtx.u32Isr < HOST_GPIO_MAX_HANDLERS)
+  {
+    stCtx.tpfIsr[stCtx.u32Isr] = pfIsr;
+    stCtx.tpvIsrArg[stCtx.u32Isr] = pvArg;
+    stCtx.u32Isr++;
+    s32RetVal = ESP_OK;
+  }
+  else
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+void host_gpio_raise(void)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < stCtx.u32Isr; u32Index++)
+  {
+    stCtx.tpfIsr[u32Index](stCtx.tpvIsrArg[u32Index]);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp_ota_ops.h>
+
+#include "host_shims.h"
+
+/* partitions.csv */
+#define HOST_FLASH_PARTITIONS                    5
+
+typedef struct
+{
+  esp_partition_t stPartition;
+  uint8_t *pu08Data;
+  uint32_t u32Erases;
+}host_partition_t;
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  host_partition_t tstPartitions[HOST_FLASH_PARTITIONS];
+  const esp_partition_t *pstBoot;
+  const esp_partition_t *pstOta;
+  uint32_t u32OtaOffset;
+}host_flash_ctx_t;
+
+static host_flash_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+  .tstPartitions =
+  {
+    {{ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, 0x010000, 0x100000, "factory", false}},
+    {{ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x110000, 0x100000, "ota_0", false}},
+    {{ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x210000, 0x100000, "ota_1", false}},
+    {{ESP_PARTITION_TYPE_DATA, 0x40, 0x310000, 0x80000, "journal", false}},
+    {{ESP_PARTITION_TYPE_DATA, 0x41, 0x390000, 0x70000, "tagindex", false}},
+  },
+};
+
+static host_partition_t *_host_flash_get(const esp_partition_t *pstPartition)
+{
+  host_partition_t *pstHost;
+
+  pstHost = (host_partition_t *)pstPartition;
+  if(NULL == pstHost->pu08Data)
+  {
+    pstHost->pu08Data = malloc(pstPartition->size);
+    memset(pstHost->pu08Data, 0xFF, pstPartition->size);
+  }
+  return pstHost;
+}
+
+static bool _host_flash_in_range(const esp_partition_t *pstPartition, size_t u32Offset, size_t u32Length)
+{
+  return pstPartition && (u32Offset <= pstPartition->size) && (u32Length <= (pstPartition->size - u32Offset));
+}
+
+void host_flash_reset(void)
+{
+  uint32_t u32Index;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  for(u32Index = 0; u32Index < HOST_FLASH_PARTITIONS; u32Index++)
+  {
+    free(stCtx.tstPartitions[u32Index].pu08Data);
+    stCtx.tstPartitions[u32Index].pu08Data = NULL;
+    stCtx.tstPartitions[u32Index].u32Erases = 0;
+  }
+  stCtx.pstBoot = NULL;
+  stCtx.pstOta = NULL;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+/* Sectors erased since the last reset */
+uint32_t host_flash_get_erases(const esp_partition_t *pstPartition)
+{
+  return ((const host_partition_t *)pstPartition)->u32Erases;
+}
+
+const uint8_t *host_flash_get_data(const esp_partition_t *pstPartition)
+{
+  const uint8_t *pu08Data;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pu08Data = _host_flash_get(pstPartition)->pu08Data;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return pu08Data;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t eType,
+                                                esp_partition_subtype_t eSubtype,
+                                                const char *pcLabel)
+{
+  uint32_t u32Index;
+  const esp_partition_t *pstPartition;
+
+  pstPartition = NULL;
+  for(u32Index = 0; (u32Index < HOST_FLASH_PARTITIONS) && (NULL == pstPartition); u32Index++)
+  {
+    if((eType == stCtx.tstPartitions[u32Index].stPartition.type) &&
+       ((ESP_PARTITION_SUBTYPE_ANY == eSubtype) || (eSubtype == stCtx.tstPartitions[u32Index].stPartition.subtype)) &&
+       ((NULL == pcLabel) || (0 == strcmp(pcLabel, stCtx.tstPartitions[u32Index].stPartition.label))))
+    {
+      pstPartition = &stCtx.tstPartitions[u32Index].stPartition;
+    }
+  }
+  return pstPartition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *pstPartition, size_t u32Offset, void *pvData, size_t u32Length)
+{
+  esp_err_t s32RetVal;
+
+  if(!_host_flash_in_range(pstPartition, u32Offset, u32Length) || (NULL == pvData))
+  {
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else
+  {
+    pthread_mutex_lock(&stCtx.stLock);
+    memcpy(pvData, &_host_flash_get(pstPartition)->pu08Data[u32Offset], u32Length);
+    pthread_mutex_unlock(&stCtx.stLock);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* NOR flash: a write can only clear bits */
+esp_err_t esp_partition_write(const esp_partition_t *pstPartition, size_t u32Offset, const void *pvData, size_t u32Length)
+{
+  size_t u32Index;
+  uint8_t *pu08Data;
+  esp_err_t s32RetVal;
+
+  if(!_host_flash_in_range(pstPartition, u32Offset, u32Length) || (NULL == pvData))
+  {
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else
+  {
+    pthread_mutex_lock(&stCtx.stLock);
+    pu08Data = &_host_flash_get(pstPartition)->pu08Data[u32Offset];
+    for(u32Index = 0; u32Index < u32Length; u32Index++)
+    {
+      pu08Data[u32Index] &= ((const uint8_t *)pvData)[u32Index];
+    }
+    pthread_mutex_unlock(&stCtx.stLock);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *pstPartition, size_t u32Offset, size_t u32Length)
+{
+  esp_err_t s32RetVal;
+  host_partition_t *pstHost;
+
+  if(!_host_flash_in_range(pstPartition, u32Offset, u32Length))
+  {
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else if((u32Offset % SPI_FLASH_SEC_SIZE) || (u32Length % SPI_FLASH_SEC_SIZE))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    pthread_mutex_lock(&stCtx.stLock);
+    pstHost = _host_flash_get(pstPartition);
+    memset(&pstHost->pu08Data[u32Offset], 0xFF, u32Length);
+    pstHost->u32Erases += u32Length / SPI_FLASH_SEC_SIZE;
+    pthread_mutex_unlock(&stCtx.stLock);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* The mapping is the RAM copy itself, writes show up in it right away */
+esp_err_t esp_partition_mmap(const esp_partition_t *pstPartition,
+                             size_t u32Offset,
+                             size_t u32Length,
+                             spi_flash_mmap_memory_t eMemory,
+                             const void **ppvOut,
+                             spi_flash_mmap_handle_t *pu32Handle)
+{
+  esp_err_t s32RetVal;
+
+  if(!_host_flash_in_range(pstPartition, u32Offset, u32Length))
+  {
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else
+  {
+    *ppvOut = &host_flash_get_data(pstPartition)[u32Offset];
+    *pu32Handle = 1;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t u32Handle)
+{
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+  return &stCtx.tstPartitions[0].stPartition;
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+  return stCtx.pstBoot?stCtx.pstBoot:esp_ota_get_running_partition();
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *pstStart)
+{
+  pstStart = pstStart?pstStart:esp_ota_get_running_partition();
+  return (&stCtx.tstPartitions[1].stPartition == pstStart)?&stCtx.tstPartitions[2].stPartition:
+                                                           &stCtx.tstPartitions[1].stPartition;
+}
+
+/* A single update at a time, written in order */
+esp_err_t esp_ota_begin(const esp_partition_t *pstPartition, size_t u32Size, esp_ota_handle_t *pu32Handle)
+{
+  esp_err_t s32RetVal;
+
+  if((NULL == pstPartition) || (ESP_PARTITION_TYPE_APP != pstPartition->type) || (NULL == pu32Handle))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    s32RetVal = esp_partition_erase_range(pstPartition, 0, pstPartition->size);
+    stCtx.pstOta = pstPartition;
+    stCtx.u32OtaOffset = 0;
+    *pu32Handle = 1;
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t u32Handle, const void *pvData, size_t u32Length)
+{
+  esp_err_t s32RetVal;
+
+  if(NULL == stCtx.pstOta)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    s32RetVal = esp_partition_write(stCtx.pstOta, stCtx.u32OtaOffset, pvData, u32Length);
+    stCtx.u32OtaOffset += u32Length;
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t u32Handle)
+{
+  esp_err_t s32RetVal;
+
+  s32RetVal = stCtx.pstOta?ESP_OK:ESP_ERR_INVALID_STATE;
+  stCtx.pstOta = NULL;
+  return s32RetVal;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *pstPartition)
+{
+  stCtx.pstBoot = pstPartition;
+  return ESP_OK;
+}
\ No newline at end of file
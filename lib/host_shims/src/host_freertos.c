@@ -0,0 +1,626 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+#include <esp_timer.h>
+#include <esp32/clk.h>
+#include <xtensa/hal.h>
+
+#include "host_shims.h"
+
+struct host_task
+{
+  pthread_t stThread;
+  pthread_mutex_t stLock;
+  pthread_cond_t stCond;
+  uint32_t u32Notify;
+  BaseType_t s32Core;
+  UBaseType_t u32Priority;
+  uint32_t u32StackSize;
+  bool bRunning;
+  TaskFunction_t pfTask;
+  void *pvArg;
+  struct host_task *pstNext;
+};
+
+struct host_mutex
+{
+  pthread_mutex_t stLock;
+};
+
+struct host_event_group
+{
+  pthread_mutex_t stLock;
+  pthread_cond_t stCond;
+  EventBits_t u32Bits;
+};
+
+struct esp_timer
+{
+  esp_timer_cb_t pfCallback;
+  void *pvArg;
+  int64_t s64DueUs;
+  int64_t s64PeriodUs;
+  bool bArmed;
+  struct esp_timer *pstNext;
+};
+
+static __thread struct host_task *pstCurrent;
+
+/* Tasks created so far, for uxTaskGetSystemState() */
+static pthread_mutex_t stTaskLock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *pstTasks;
+
+/* Real clock from the first call, the manual clock replaces it when set */
+static pthread_mutex_t stClockLock = PTHREAD_MUTEX_INITIALIZER;
+static bool bManual;
+static int64_t s64ManualUs;
+static int64_t s64OriginUs = -1;
+static int64_t s64OffsetUs;
+static struct esp_timer *pstTimers;
+
+static int64_t _host_monotonic_us(void)
+{
+  struct timespec stNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &stNow);
+  return ((int64_t)stNow.tv_sec * 1000000LL) + (stNow.tv_nsec / 1000);
+}
+
+static struct timespec _host_deadline(TickType_t u32Ticks)
+{
+  int64_t s64Ns;
+  struct timespec stDeadline;
+
+  clock_gettime(CLOCK_REALTIME, &stDeadline);
+  s64Ns = stDeadline.tv_nsec + ((int64_t)u32Ticks * portTICK_PERIOD_MS * 1000000LL);
+  stDeadline.tv_sec += s64Ns / 1000000000LL;
+  stDeadline.tv_nsec = s64Ns % 1000000000LL;
+  return stDeadline;
+}
+
+/* Called with the clock lock held */
+static int64_t _host_now_us(void)
+{
+  if(s64OriginUs < 0)
+  {
+    s64OriginUs = _host_monotonic_us();
+  }
+  return bManual?s64ManualUs:(_host_monotonic_us() - s64OriginUs + s64OffsetUs);
+}
+
+/* Earliest armed timer due by then, called with the clock lock held */
+static struct esp_timer *_host_timer_next(int64_t s64ThenUs)
+{
+  struct esp_timer *pstTimer;
+  struct esp_timer *pstNext;
+
+  pstNext = NULL;
+  for(pstTimer = pstTimers; pstTimer; pstTimer = pstTimer->pstNext)
+  {
+    if(pstTimer->bArmed && (pstTimer->s64DueUs <= s64ThenUs) &&
+       ((NULL == pstNext) || (pstTimer->s64DueUs < pstNext->s64DueUs)))
+    {
+      pstNext = pstTimer;
+    }
+  }
+  return pstNext;
+}
+
+int64_t esp_timer_get_time(void)
+{
+  int64_t s64NowUs;
+
+  pthread_mutex_lock(&stClockLock);
+  s64NowUs = _host_now_us();
+  pthread_mutex_unlock(&stClockLock);
+  return s64NowUs;
+}
+
+void host_time_set_manual(int64_t s64NowUs)
+{
+  pthread_mutex_lock(&stClockLock);
+  bManual = true;
+  s64ManualUs = s64NowUs;
+  pthread_mutex_unlock(&stClockLock);
+}
+
+/* Timers due on the way fire in order, the clock reads their due time while
+   their callback runs */
+void host_time_advance_us(int64_t s64StepUs)
+{
+  int64_t s64ThenUs;
+  void *pvArg;
+  esp_timer_cb_t pfCallback;
+  struct esp_timer *pstTimer;
+
+  pthread_mutex_lock(&stClockLock);
+  if(bManual)
+  {
+    s64ThenUs = s64ManualUs + s64StepUs;
+    for(pstTimer = _host_timer_next(s64ThenUs); pstTimer; pstTimer = _host_timer_next(s64ThenUs))
+    {
+      s64ManualUs = (pstTimer->s64DueUs > s64ManualUs)?pstTimer->s64DueUs:s64ManualUs;
+      /* A periodic timer is due again a period after this expiry */
+      pstTimer->s64DueUs += pstTimer->s64PeriodUs;
+      pstTimer->bArmed = (0 != pstTimer->s64PeriodUs);
+      pfCallback = pstTimer->pfCallback;
+      pvArg = pstTimer->pvArg;
+      pthread_mutex_unlock(&stClockLock);
+      pfCallback(pvArg);
+      pthread_mutex_lock(&stClockLock);
+    }
+    s64ManualUs = s64ThenUs;
+  }
+  else
+  {
+    s64OffsetUs += s64StepUs;
+  }
+  pthread_mutex_unlock(&stClockLock);
+}
+
+/* Goes on from the manual clock */
+void host_time_set_real(void)
+{
+  int64_t s64NowUs;
+
+  s64NowUs = esp_timer_get_time();
+  pthread_mutex_lock(&stClockLock);
+  bManual = false;
+  s64OffsetUs = s64NowUs - (_host_monotonic_us() - s64OriginUs);
+  pthread_mutex_unlock(&stClockLock);
+}
+
+uint32_t xthal_get_ccount(void)
+{
+  return (uint32_t)(esp_timer_get_time() * (esp_clk_cpu_freq() / 1000000));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+  return (TickType_t)(esp_timer_get_time() / (portTICK_PERIOD_MS * 1000LL));
+}
+
+void vTaskDelay(TickType_t u32Ticks)
+{
+  bool bAdvance;
+  struct timespec stDelay;
+
+  pthread_mutex_lock(&stClockLock);
+  bAdvance = bManual;
+  pthread_mutex_unlock(&stClockLock);
+  if(bAdvance)
+  {
+    host_time_advance_us((int64_t)u32Ticks * portTICK_PERIOD_MS * 1000LL);
+    sched_yield();
+  }
+  else
+  {
+    stDelay.tv_sec = (u32Ticks * portTICK_PERIOD_MS) / 1000;
+    stDelay.tv_nsec = ((u32Ticks * portTICK_PERIOD_MS) % 1000) * 1000000L;
+    nanosleep(&stDelay, NULL);
+  }
+}
+
+static struct host_task *_host_task_new(TaskFunction_t pfTask, void *pvArg)
+{
+  struct host_task *pstTask;
+
+  pstTask = calloc(1, sizeof(struct host_task));
+  pthread_mutex_init(&pstTask->stLock, NULL);
+  pthread_cond_init(&pstTask->stCond, NULL);
+  pstTask->pfTask = pfTask;
+  pstTask->pvArg = pvArg;
+  return pstTask;
+}
+
+static void *_host_task_entry(void *pvArg)
+{
+  pstCurrent = pvArg;
+  pstCurrent->pfTask(pstCurrent->pvArg);
+  pthread_mutex_lock(&stTaskLock);
+  pstCurrent->bRunning = false;
+  pthread_mutex_unlock(&stTaskLock);
+  return NULL;
+}
+
+/* The thread of the test itself becomes a task on first use */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+  if(NULL == pstCurrent)
+  {
+    pstCurrent = _host_task_new(NULL, NULL);
+    pstCurrent->stThread = pthread_self();
+  }
+  return pstCurrent;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+  return xTaskGetCurrentTaskHandle()->s32Core;
+}
+
+void host_task_set_core(int s32Core)
+{
+  xTaskGetCurrentTaskHandle()->s32Core = s32Core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pfTask,
+                                   const char *pcName,
+                                   uint32_t u32StackSize,
+                                   void *pvArg,
+                                   UBaseType_t u32Priority,
+                                   TaskHandle_t *ppstTask,
+                                   BaseType_t s32Core)
+{
+  BaseType_t s32RetVal;
+  struct host_task *pstTask;
+
+  pstTask = _host_task_new(pfTask, pvArg);
+  pstTask->s32Core = ((s32Core >= 0) && (s32Core < portNUM_PROCESSORS))?s32Core:0;
+  pstTask->u32Priority = u32Priority;
+  pstTask->u32StackSize = u32StackSize;
+  pstTask->bRunning = true;
+  /* Like FreeRTOS the handle is set before the task can run */
+  if(ppstTask)
+  {
+    *ppstTask = pstTask;
+  }
+  pthread_mutex_lock(&stTaskLock);
+  if(0 == pthread_create(&pstTask->stThread, NULL, _host_task_entry, pstTask))
+  {
+    pthread_detach(pstTask->stThread);
+    pstTask->pstNext = pstTasks;
+    pstTasks = pstTask;
+    pthread_mutex_unlock(&stTaskLock);
+    s32RetVal = pdPASS;
+  }
+  else
+  {
+    pthread_mutex_unlock(&stTaskLock);
+    free(pstTask);
+    if(ppstTask)
+    {
+      *ppstTask = NULL;
+    }
+    s32RetVal = pdFAIL;
+  }
+  return s32RetVal;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pfTask,
+                       const char *pcName,
+                       uint32_t u32StackSize,
+                       void *pvArg,
+                       UBaseType_t u32Priority,
+                       TaskHandle_t *ppstTask)
+{
+  return xTaskCreatePinnedToCore(pfTask, pcName, u32StackSize, pvArg, u32Priority, ppstTask, tskNO_AFFINITY);
+}
+
+/* Priorities are only kept, the threads of the host all run alike */
+void vTaskPrioritySet(TaskHandle_t pstTask, UBaseType_t u32Priority)
+{
+  pstTask = pstTask?pstTask:xTaskGetCurrentTaskHandle();
+  pthread_mutex_lock(&pstTask->stLock);
+  pstTask->u32Priority = u32Priority;
+  pthread_mutex_unlock(&pstTask->stLock);
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t pstTask)
+{
+  UBaseType_t u32Priority;
+
+  pstTask = pstTask?pstTask:xTaskGetCurrentTaskHandle();
+  pthread_mutex_lock(&pstTask->stLock);
+  u32Priority = pstTask->u32Priority;
+  pthread_mutex_unlock(&pstTask->stLock);
+  return u32Priority;
+}
+
+/* The run time of a task is the CPU time of its thread and the total is
+   esp_timer, both in us. A host thread has a stack of its own so the whole
+   depth asked for reads as free */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *pstStatus, UBaseType_t u32Size, uint32_t *pu32TotalRunTime)
+{
+  clockid_t s32Clock;
+  struct timespec stCpu;
+  UBaseType_t u32Count;
+  struct host_task *pstTask;
+
+  u32Count = 0;
+  pthread_mutex_lock(&stTaskLock);
+  for(pstTask = pstTasks; pstTask && (u32Count < u32Size); pstTask = pstTask->pstNext)
+  {
+    if(pstTask->bRunning && (0 == pthread_getcpuclockid(pstTask->stThread, &s32Clock)))
+    {
+      clock_gettime(s32Clock, &stCpu);
+      pstStatus[u32Count].xHandle = pstTask;
+      pstStatus[u32Count].uxCurrentPriority = uxTaskPriorityGet(pstTask);
+      pstStatus[u32Count].ulRunTimeCounter = (uint32_t)(((int64_t)stCpu.tv_sec * 1000000LL) + (stCpu.tv_nsec / 1000));
+      pstStatus[u32Count].usStackHighWaterMark = pstTask->u32StackSize;
+      u32Count++;
+    }
+  }
+  pthread_mutex_unlock(&stTaskLock);
+  if(pu32TotalRunTime)
+  {
+    *pu32TotalRunTime = (uint32_t)esp_timer_get_time();
+  }
+  return u32Count;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t s32Clear, TickType_t u32Ticks)
+{
+  uint32_t u32Value;
+  struct timespec stDeadline;
+  struct host_task *pstTask;
+
+  pstTask = xTaskGetCurrentTaskHandle();
+  stDeadline = _host_deadline(u32Ticks);
+  pthread_mutex_lock(&pstTask->stLock);
+  while((0 == pstTask->u32Notify) && u32Ticks)
+  {
+    if(portMAX_DELAY == u32Ticks)
+    {
+      pthread_cond_wait(&pstTask->stCond, &pstTask->stLock);
+    }
+    else if(ETIMEDOUT == pthread_cond_timedwait(&pstTask->stCond, &pstTask->stLock, &stDeadline))
+    {
+      u32Ticks = 0;
+    }
+  }
+  u32Value = pstTask->u32Notify;
+  if(u32Value)
+  {
+    pstTask->u32Notify = s32Clear?0:(u32Value - 1);
+  }
+  pthread_mutex_unlock(&pstTask->stLock);
+  return u32Value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t pstTask)
+{
+  pthread_mutex_lock(&pstTask->stLock);
+  pstTask->u32Notify++;
+  pthread_cond_signal(&pstTask->stCond);
+  pthread_mutex_unlock(&pstTask->stLock);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t pstTask, BaseType_t *ps32Woken)
+{
+  xTaskNotifyGive(pstTask);
+  if(ps32Woken)
+  {
+    *ps32Woken = pdTRUE;
+  }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+  struct host_mutex *pstMutex;
+
+  pstMutex = calloc(1, sizeof(struct host_mutex));
+  if(pstMutex)
+  {
+    pthread_mutex_init(&pstMutex->stLock, NULL);
+  }
+  return pstMutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t pstMutex, TickType_t u32Ticks)
+{
+  int s32Result;
+  struct timespec stDeadline;
+
+  if(portMAX_DELAY == u32Ticks)
+  {
+    s32Result = pthread_mutex_lock(&pstMutex->stLock);
+  }
+  else if(0 == u32Ticks)
+  {
+    s32Result = pthread_mutex_trylock(&pstMutex->stLock);
+  }
+  else
+  {
+    stDeadline = _host_deadline(u32Ticks);
+    s32Result = pthread_mutex_timedlock(&pstMutex->stLock, &stDeadline);
+  }
+  return (0 == s32Result)?pdTRUE:pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t pstMutex)
+{
+  return (0 == pthread_mutex_unlock(&pstMutex->stLock))?pdTRUE:pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t pstMutex)
+{
+  pthread_mutex_destroy(&pstMutex->stLock);
+  free(pstMutex);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *pstArgs, esp_timer_handle_t *ppstTimer)
+{
+  esp_err_t s32RetVal;
+  struct esp_timer *pstTimer;
+
+  if((NULL == pstArgs) || (NULL == pstArgs->callback) || (NULL == ppstTimer))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else if(NULL == (pstTimer = calloc(1, sizeof(struct esp_timer))))
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    pstTimer->pfCallback = pstArgs->callback;
+    pstTimer->pvArg = pstArgs->arg;
+    pthread_mutex_lock(&stClockLock);
+    pstTimer->pstNext = pstTimers;
+    pstTimers = pstTimer;
+    pthread_mutex_unlock(&stClockLock);
+    *ppstTimer = pstTimer;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t pstTimer, uint64_t u64TimeoutUs)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stClockLock);
+  if(pstTimer->bArmed)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    pstTimer->s64DueUs = _host_now_us() + (int64_t)u64TimeoutUs;
+    pstTimer->s64PeriodUs = 0;
+    pstTimer->bArmed = true;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stClockLock);
+  return s32RetVal;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t pstTimer, uint64_t u64PeriodUs)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stClockLock);
+  if(pstTimer->bArmed || (0 == u64PeriodUs))
+  {
+    s32RetVal = pstTimer->bArmed?ESP_ERR_INVALID_STATE:ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    pstTimer->s64DueUs = _host_now_us() + (int64_t)u64PeriodUs;
+    pstTimer->s64PeriodUs = (int64_t)u64PeriodUs;
+    pstTimer->bArmed = true;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stClockLock);
+  return s32RetVal;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t pstTimer)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stClockLock);
+  s32RetVal = pstTimer->bArmed?ESP_OK:ESP_ERR_INVALID_STATE;
+  pstTimer->bArmed = false;
+  pthread_mutex_unlock(&stClockLock);
+  return s32RetVal;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t pstTimer)
+{
+  esp_err_t s32RetVal;
+  struct esp_timer **ppstLink;
+
+  s32RetVal = ESP_ERR_INVALID_STATE;
+  pthread_mutex_lock(&stClockLock);
+  if(!pstTimer->bArmed)
+  {
+    for(ppstLink = &pstTimers; *ppstLink != pstTimer; ppstLink = &(*ppstLink)->pstNext);
+    *ppstLink = pstTimer->pstNext;
+    free(pstTimer);
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stClockLock);
+  return s32RetVal;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+  struct host_event_group *pstGroup;
+
+  pstGroup = calloc(1, sizeof(struct host_event_group));
+  if(pstGroup)
+  {
+    pthread_mutex_init(&pstGroup->stLock, NULL);
+    pthread_cond_init(&pstGroup->stCond, NULL);
+  }
+  return pstGroup;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t pstGroup, EventBits_t u32Bits)
+{
+  EventBits_t u32Value;
+
+  pthread_mutex_lock(&pstGroup->stLock);
+  pstGroup->u32Bits |= u32Bits;
+  u32Value = pstGroup->u32Bits;
+  pthread_cond_broadcast(&pstGroup->stCond);
+  pthread_mutex_unlock(&pstGroup->stLock);
+  return u32Value;
+}
+
+/* Returns the bits before they were cleared like FreeRTOS */
+EventBits_t xEventGroupClearBits(EventGroupHandle_t pstGroup, EventBits_t u32Bits)
+{
+  EventBits_t u32Value;
+
+  pthread_mutex_lock(&pstGroup->stLock);
+  u32Value = pstGroup->u32Bits;
+  pstGroup->u32Bits &= ~u32Bits;
+  pthread_mutex_unlock(&pstGroup->stLock);
+  return u32Value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t pstGroup)
+{
+  EventBits_t u32Value;
+
+  pthread_mutex_lock(&pstGroup->stLock);
+  u32Value = pstGroup->u32Bits;
+  pthread_mutex_unlock(&pstGroup->stLock);
+  return u32Value;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t pstGroup,
+                                EventBits_t u32Bits,
+                                BaseType_t s32Clear,
+                                BaseType_t s32All,
+                                TickType_t u32Ticks)
+{
+  bool bDone;
+  EventBits_t u32Value;
+  struct timespec stDeadline;
+
+  stDeadline = _host_deadline(u32Ticks);
+  pthread_mutex_lock(&pstGroup->stLock);
+  bDone = s32All?((pstGroup->u32Bits & u32Bits) == u32Bits):(0 != (pstGroup->u32Bits & u32Bits));
+  while(!bDone && u32Ticks)
+  {
+    if(portMAX_DELAY == u32Ticks)
+    {
+      pthread_cond_wait(&pstGroup->stCond, &pstGroup->stLock);
+    }
+    else if(ETIMEDOUT == pthread_cond_timedwait(&pstGroup->stCond, &pstGroup->stLock, &stDeadline))
+    {
+      u32Ticks = 0;
+    }
+    bDone = s32All?((pstGroup->u32Bits & u32Bits) == u32Bits):(0 != (pstGroup->u32Bits & u32Bits));
+  }
+  u32Value = pstGroup->u32Bits;
+  if(bDone && s32Clear)
+  {
+    pstGroup->u32Bits &= ~u32Bits;
+  }
+  pthread_mutex_unlock(&pstGroup->stLock);
+  return u32Value;
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include <string.h>
+#include <pthread.h>
+
+#include <esp_heap_caps.h>
+#include <multi_heap.h>
+
+#include "host_shims.h"
+
+/* Internal RAM left to the application once Wi-Fi and lwIP are up */
+#define HOST_HEAP_SIZE                           (192 * 1024)
+#define HOST_HEAP_ALIGN                          8
+#define HOST_HEAP_HEADER_SIZE                    sizeof(host_heap_block_t)
+#define HOST_HEAP_MIN_BLOCK_SIZE                 (HOST_HEAP_HEADER_SIZE + HOST_HEAP_ALIGN)
+#define HOST_HEAP_ALIGN_UP(x)                    (((x) + HOST_HEAP_ALIGN - 1) & ~(HOST_HEAP_ALIGN - 1))
+
+/* Blocks follow each other, the size includes the header */
+typedef struct
+{
+  uint32_t u32Size;
+  uint32_t u32Used;
+}host_heap_block_t;
+
+struct host_heap
+{
+  pthread_mutex_t stLock;
+  uint8_t *pu08Blocks;
+  uint32_t u32Length;
+  uint32_t u32Free;
+  uint32_t u32MinFree;
+};
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  multi_heap_handle_t pstHeap;
+  uint8_t tu08Ram[HOST_HEAP_SIZE] __attribute__((aligned(HOST_HEAP_ALIGN)));
+}host_heap_ctx_t;
+
+static host_heap_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static host_heap_block_t *_host_heap_next(multi_heap_handle_t pstHeap, host_heap_block_t *pstBlock)
+{
+  pstBlock = (host_heap_block_t *)((uint8_t *)pstBlock + pstBlock->u32Size);
+  return ((uint8_t *)pstBlock < (pstHeap->pu08Blocks + pstHeap->u32Length))?pstBlock:NULL;
+}
+
+multi_heap_handle_t multi_heap_register(void *pvStart, size_t u32Size)
+{
+  uintptr_t u32Start;
+  uintptr_t u32End;
+  multi_heap_handle_t pstHeap;
+  host_heap_block_t *pstBlock;
+
+  pstHeap = NULL;
+  u32Start = HOST_HEAP_ALIGN_UP((uintptr_t)pvStart);
+  u32End = ((uintptr_t)pvStart + u32Size) & ~(uintptr_t)(HOST_HEAP_ALIGN - 1);
+  if(pvStart && (u32End > u32Start) &&
+     ((u32End - u32Start) >= (HOST_HEAP_ALIGN_UP(sizeof(struct host_heap)) + HOST_HEAP_MIN_BLOCK_SIZE)))
+  {
+    pstHeap = (multi_heap_handle_t)u32Start;
+    pthread_mutex_init(&pstHeap->stLock, NULL);
+    pstHeap->pu08Blocks = (uint8_t *)(u32Start + HOST_HEAP_ALIGN_UP(sizeof(struct host_heap)));
+    pstHeap->u32Length = u32End - (uintptr_t)pstHeap->pu08Blocks;
+    pstBlock = (host_heap_block_t *)pstHeap->pu08Blocks;
+    pstBlock->u32Size = pstHeap->u32Length;
+    pstBlock->u32Used = 0;
+    pstHeap->u32Free = pstHeap->u32Length - HOST_HEAP_HEADER_SIZE;
+    pstHeap->u32MinFree = pstHeap->u32Free;
+  }
+  return pstHeap;
+}
+
+void multi_heap_set_lock(multi_heap_handle_t pstHeap, void *pvLock)
+{
+}
+
+/* The first free block large enough is split, a remainder too small to be a
+   block stays with the allocation */
+void *multi_heap_malloc(multi_heap_handle_t pstHeap, size_t u32Size)
+{
+  uint32_t u32Need;
+  host_heap_block_t *pstBlock;
+  host_heap_block_t *pstRest;
+
+  pstBlock = NULL;
+  if(pstHeap && u32Size && (u32Size < pstHeap->u32Length))
+  {
+    u32Need = HOST_HEAP_ALIGN_UP(u32Size) + HOST_HEAP_HEADER_SIZE;
+    pthread_mutex_lock(&pstHeap->stLock);
+    for(pstBlock = (host_heap_block_t *)pstHeap->pu08Blocks;
+        pstBlock && (pstBlock->u32Used || (pstBlock->u32Size < u32Need));
+        pstBlock = _host_heap_next(pstHeap, pstBlock))
+    {
+    }
+    if(pstBlock && ((pstBlock->u32Size - u32Need) >= HOST_HEAP_MIN_BLOCK_SIZE))
+    {
+      pstRest = (host_heap_block_t *)((uint8_t *)pstBlock + u32Need);
+      pstRest->u32Size = pstBlock->u32Size - u32Need;
+      pstRest->u32Used = 0;
+      pstBlock->u32Size = u32Need;
+      pstHeap->u32Free -= u32Need;
+    }
+    else if(pstBlock)
+    {
+      pstHeap->u32Free -= pstBlock->u32Size - HOST_HEAP_HEADER_SIZE;
+    }
+    if(pstBlock)
+    {
+      pstBlock->u32Used = 1;
+      pstHeap->u32MinFree = (pstHeap->u32Free < pstHeap->u32MinFree)?pstHeap->u32Free:pstHeap->u32MinFree;
+    }
+    pthread_mutex_unlock(&pstHeap->stLock);
+  }
+  return pstBlock?(pstBlock + 1):NULL;
+}
+
+/* Free neighbours are merged over the whole heap */
+void multi_heap_free(multi_heap_handle_t pstHeap, void *pvBlock)
+{
+  host_heap_block_t *pstBlock;
+  host_heap_block_t *pstNext;
+
+  if(pstHeap && pvBlock)
+  {
+    pthread_mutex_lock(&pstHeap->stLock);
+    pstBlock = (host_heap_block_t *)pvBlock - 1;
+    pstBlock->u32Used = 0;
+    pstHeap->u32Free += pstBlock->u32Size - HOST_HEAP_HEADER_SIZE;
+    for(pstBlock = (host_heap_block_t *)pstHeap->pu08Blocks; pstBlock; pstBlock = _host_heap_next(pstHeap, pstBlock))
+    {
+      for(pstNext = _host_heap_next(pstHeap, pstBlock);
+          !pstBlock->u32Used && pstNext && !pstNext->u32Used;
+          pstNext = _host_heap_next(pstHeap, pstBlock))
+      {
+        pstBlock->u32Size += pstNext->u32Size;
+        pstHeap->u32Free += HOST_HEAP_HEADER_SIZE;
+      }
+    }
+    pthread_mutex_unlock(&pstHeap->stLock);
+  }
+}
+
+void multi_heap_get_info(multi_heap_handle_t pstHeap, multi_heap_info_t *pstInfo)
+{
+  uint32_t u32Size;
+  host_heap_block_t *pstBlock;
+
+  memset(pstInfo, 0x00, sizeof(multi_heap_info_t));
+  pthread_mutex_lock(&pstHeap->stLock);
+  for(pstBlock = (host_heap_block_t *)pstHeap->pu08Blocks; pstBlock; pstBlock = _host_heap_next(pstHeap, pstBlock))
+  {
+    u32Size = pstBlock->u32Size - HOST_HEAP_HEADER_SIZE;
+    if(pstBlock->u32Used)
+    {
+      pstInfo->total_allocated_bytes += u32Size;
+      pstInfo->allocated_blocks++;
+    }
+    else
+    {
+      pstInfo->total_free_bytes += u32Size;
+      pstInfo->largest_free_block = (u32Size > pstInfo->largest_free_block)?u32Size:pstInfo->largest_free_block;
+      pstInfo->free_blocks++;
+    }
+    pstInfo->total_blocks++;
+  }
+  pstInfo->minimum_free_bytes = pstHeap->u32MinFree;
+  pthread_mutex_unlock(&pstHeap->stLock);
+}
+
+static multi_heap_handle_t _host_heap_get(void)
+{
+  multi_heap_handle_t pstHeap;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  if(NULL == stCtx.pstHeap)
+  {
+    stCtx.pstHeap = multi_heap_register(stCtx.tu08Ram, sizeof(stCtx.tu08Ram));
+  }
+  pstHeap = stCtx.pstHeap;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return pstHeap;
+}
+
+void host_heap_reset(void)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.pstHeap = multi_heap_register(stCtx.tu08Ram, sizeof(stCtx.tu08Ram));
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+void *heap_caps_malloc(size_t u32Size, uint32_t u32Caps)
+{
+  return multi_heap_malloc(_host_heap_get(), u32Size);
+}
+
+void *heap_caps_calloc(size_t u32Count, size_t u32Size, uint32_t u32Caps)
+{
+  void *pvBlock;
+
+  pvBlock = NULL;
+  if(u32Size && (u32Count <= (SIZE_MAX / u32Size)))
+  {
+    pvBlock = multi_heap_malloc(_host_heap_get(), u32Count * u32Size);
+  }
+  if(pvBlock)
+  {
+    memset(pvBlock, 0x00, u32Count * u32Size);
+  }
+  return pvBlock;
+}
+
+void heap_caps_free(void *pvBlock)
+{
+  multi_heap_free(_host_heap_get(), pvBlock);
+}
+
+void heap_caps_get_info(multi_heap_info_t *pstInfo, uint32_t u32Caps)
+{
+  multi_heap_get_info(_host_heap_get(), pstInfo);
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include <esp_http_client.h>
+#include <esp_crt_bundle.h>
+
+#include "host_shims.h"
+
+#define HOST_HTTP_MAX_URL_SIZE                   512
+#define HOST_HTTP_DEFAULT_BUFFER_SIZE            512
+
+/* A client keeps its headers and its connection from one request to the
+   next, the response is kept until the next one */
+struct host_http_client
+{
+  char tcUrl[HOST_HTTP_MAX_URL_SIZE];
+  http_event_handle_cb pfEvent;
+  void *pvUserData;
+  int s32BufferSize;
+  esp_http_client_method_t eMethod;
+  const char *pcPostField;
+  int s32PostLength;
+  char *tpcKeys[HOST_HTTP_MAX_HEADERS];
+  char *tpcValues[HOST_HTTP_MAX_HEADERS];
+  bool bConnected;
+  int s32Status;
+  host_http_response_t stResponse;
+  uint32_t u32Read;
+};
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  host_http_handler_t pfHandler;
+}host_http_ctx_t;
+
+static host_http_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Certificates embedded by the board build */
+const char tcHostGithubCertPem[] asm("_binary_github_cert_pem_start") = "";
+const char tcHostHerokuCertPem[] asm("_binary_heroku_cert_pem_start") = "";
+
+static void _host_http_event(esp_http_client_handle_t pstClient,
+                             esp_http_client_event_id_t eEvent,
+                             const void *pvData,
+                             int s32Length,
+                             const char *pcKey,
+                             const char *pcValue)
+{
+  esp_http_client_event_t stEvent;
+
+  if(pstClient->pfEvent)
+  {
+    stEvent.event_id = eEvent;
+    stEvent.client = pstClient;
+    stEvent.data = (void *)pvData;
+    stEvent.data_len = s32Length;
+    stEvent.user_data = pstClient->pvUserData;
+    stEvent.header_key = (char *)pcKey;
+    stEvent.header_value = (char *)pcValue;
+    pstClient->pfEvent(&stEvent);
+  }
+}
+
+/* The handler is called without the lock so it can take its time */
+static esp_err_t _host_http_send(esp_http_client_handle_t pstClient)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+  host_http_handler_t pfHandler;
+  host_http_request_t stRequest;
+
+  memset(&stRequest, 0x00, sizeof(stRequest));
+  stRequest.eMethod = pstClient->eMethod;
+  stRequest.pcUrl = pstClient->tcUrl;
+  stRequest.pcBody = pstClient->pcPostField;
+  stRequest.u32BodyLength = pstClient->pcPostField?pstClient->s32PostLength:0;
+  stRequest.bConnect = !pstClient->bConnected;
+  for(u32Index = 0; u32Index < HOST_HTTP_MAX_HEADERS; u32Index++)
+  {
+    if(pstClient->tpcKeys[u32Index])
+    {
+      stRequest.tstHeaders[stRequest.u32Headers].pcKey = pstClient->tpcKeys[u32Index];
+      stRequest.tstHeaders[stRequest.u32Headers].pcValue = pstClient->tpcValues[u32Index];
+      stRequest.u32Headers++;
+    }
+  }
+  memset(&pstClient->stResponse, 0x00, sizeof(pstClient->stResponse));
+  pstClient->u32Read = 0;
+  pthread_mutex_lock(&stCtx.stLock);
+  pfHandler = stCtx.pfHandler;
+  pthread_mutex_unlock(&stCtx.stLock);
+  pstClient->s32Status = pfHandler?pfHandler(&stRequest, &pstClient->stResponse):HOST_HTTP_CONNECT_FAILED;
+  if((pstClient->s32Status < 0) && (HOST_HTTP_RESPONSE_LOST != pstClient->s32Status))
+  {
+    pstClient->bConnected = false;
+    _host_http_event(pstClient, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+    s32RetVal = ESP_FAIL;
+  }
+  else
+  {
+    if(!pstClient->bConnected)
+    {
+      pstClient->bConnected = true;
+      _host_http_event(pstClient, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+    }
+    _host_http_event(pstClient, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+    if(HOST_HTTP_RESPONSE_LOST == pstClient->s32Status)
+    {
+      pstClient->bConnected = false;
+      _host_http_event(pstClient, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+      s32RetVal = ESP_FAIL;
+    }
+    else
+    {
+      for(u32Index = 0; (u32Index < HOST_HTTP_MAX_HEADERS) && pstClient->stResponse.tstHeaders[u32Index].pcKey; u32Index++)
+      {
+        _host_http_event(pstClient,
+                         HTTP_EVENT_ON_HEADER,
+                         "",
+                         0,
+                         pstClient->stResponse.tstHeaders[u32Index].pcKey,
+                         pstClient->stResponse.tstHeaders[u32Index].pcValue);
+      }
+      s32RetVal = ESP_OK;
+    }
+  }
+  return s32RetVal;
+}
+
+void host_http_set_handler(host_http_handler_t pfHandler)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.pfHandler = pfHandler;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+const char *host_http_get_header(const host_http_request_t *pstRequest, const char *pcKey)
+{
+  uint32_t u32Index;
+  const char *pcValue;
+
+  pcValue = NULL;
+  for(u32Index = 0; (u32Index < pstRequest->u32Headers) && (NULL == pcValue); u32Index++)
+  {
+    if(0 == strcasecmp(pstRequest->tstHeaders[u32Index].pcKey, pcKey))
+    {
+      pcValue = pstRequest->tstHeaders[u32Index].pcValue;
+    }
+  }
+  return pcValue;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *pstConfig)
+{
+  esp_http_client_handle_t pstClient;
+
+  pstClient = calloc(1, sizeof(struct host_http_client));
+  if(pstClient)
+  {
+    strncpy(pstClient->tcUrl, pstConfig->url, sizeof(pstClient->tcUrl) - 1);
+    pstClient->pfEvent = pstConfig->event_handler;
+    pstClient->pvUserData = pstConfig->user_data;
+    pstClient->eMethod = pstConfig->method;
+    pstClient->s32BufferSize = pstConfig->buffer_size?pstConfig->buffer_size:HOST_HTTP_DEFAULT_BUFFER_SIZE;
+  }
+  return pstClient;
+}
+
+esp_err_t esp_crt_bundle_attach(void *pvConfig)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t pstClient, const char *pcUrl)
+{
+  strncpy(pstClient->tcUrl, pcUrl, sizeof(pstClient->tcUrl) - 1);
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t pstClient, esp_http_client_method_t eMethod)
+{
+  pstClient->eMethod = eMethod;
+  return ESP_OK;
+}
+
+/* The body isn't copied, like on the board it has to outlive the request */
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t pstClient, const char *pcData, int s32Length)
+{
+  pstClient->pcPostField = pcData;
+  pstClient->s32PostLength = s32Length;
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t pstClient, const char *pcKey, const char *pcValue)
+{
+  uint32_t u32Index;
+  uint32_t u32Free;
+  esp_err_t s32RetVal;
+
+  esp_http_client_delete_header(pstClient, pcKey);
+  u32Free = HOST_HTTP_MAX_HEADERS;
+  for(u32Index = 0; u32Index < HOST_HTTP_MAX_HEADERS; u32Index++)
+  {
+    if((NULL == pstClient->tpcKeys[u32Index]) && (HOST_HTTP_MAX_HEADERS == u32Free))
+    {
+      u32Free = u32Index;
+    }
+  }
+  if(HOST_HTTP_MAX_HEADERS == u32Free)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    pstClient->tpcKeys[u32Free] = strdup(pcKey);
+    pstClient->tpcValues[u32Free] = strdup(pcValue);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t pstClient, const char *pcKey)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < HOST_HTTP_MAX_HEADERS; u32Index++)
+  {
+    if(pstClient->tpcKeys[u32Index] && (0 == strcasecmp(pstClient->tpcKeys[u32Index], pcKey)))
+    {
+      free(pstClient->tpcKeys[u32Index]);
+      free(pstClient->tpcValues[u32Index]);
+      pstClient->tpcKeys[u32Index] = NULL;
+      pstClient->tpcValues[u32Index] = NULL;
+    }
+  }
+  return ESP_OK;
+}
+
+/* The body is handed to the event handler in pieces of the buffer size */
+esp_err_t esp_http_client_perform(esp_http_client_handle_t pstClient)
+{
+  int s32Length;
+  esp_err_t s32RetVal;
+
+  s32RetVal = _host_http_send(pstClient);
+  if(ESP_OK == s32RetVal)
+  {
+    while(pstClient->u32Read < pstClient->stResponse.u32BodyLength)
+    {
+      s32Length = pstClient->stResponse.u32BodyLength - pstClient->u32Read;
+      s32Length = (s32Length < pstClient->s32BufferSize)?s32Length:pstClient->s32BufferSize;
+      _host_http_event(pstClient,
+                       HTTP_EVENT_ON_DATA,
+                       &pstClient->stResponse.pcBody[pstClient->u32Read],
+                       s32Length,
+                       NULL,
+                       NULL);
+      pstClient->u32Read += s32Length;
+    }
+    _host_http_event(pstClient, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+  }
+  return s32RetVal;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t pstClient, int s32WriteLength)
+{
+  return _host_http_send(pstClient);
+}
+
+int esp_http_client_fetch_headers(esp_http_client_handle_t pstClient)
+{
+  return (int)pstClient->stResponse.u32BodyLength;
+}
+
+int esp_http_client_read(esp_http_client_handle_t pstClient, char *pcBuffer, int s32Length)
+{
+  uint32_t u32Left;
+
+  u32Left = pstClient->stResponse.u32BodyLength - pstClient->u32Read;
+  s32Length = ((uint32_t)s32Length < u32Left)?s32Length:(int)u32Left;
+  memcpy(pcBuffer, &pstClient->stResponse.pcBody[pstClient->u32Read], s32Length);
+  pstClient->u32Read += s32Length;
+  return s32Length;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t pstClient)
+{
+  return pstClient->u32Read == pstClient->stResponse.u32BodyLength;
+}
+
+/* Follows the Location header of the last response */
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t pstClient)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_ERR_INVALID_ARG;
+  for(u32Index = 0;
+      (u32Index < HOST_HTTP_MAX_HEADERS) && pstClient->stResponse.tstHeaders[u32Index].pcKey && (ESP_OK != s32RetVal);
+      u32Index++)
+  {
+    if(0 == strcasecmp(pstClient->stResponse.tstHeaders[u32Index].pcKey, "Location"))
+    {
+      strncpy(pstClient->tcUrl, pstClient->stResponse.tstHeaders[u32Index].pcValue, sizeof(pstClient->tcUrl) - 1);
+      s32RetVal = ESP_OK;
+    }
+  }
+  return s32RetVal;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t pstClient)
+{
+  return pstClient->s32Status;
+}
+
+int esp_http_client_get_content_length(esp_http_client_handle_t pstClient)
+{
+  return (int)pstClient->stResponse.u32BodyLength;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t pstClient)
+{
+  if(pstClient->bConnected)
+  {
+    pstClient->bConnected = false;
+    _host_http_event(pstClient, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t pstClient)
+{
+  uint32_t u32Index;
+
+  esp_http_client_close(pstClient);
+  for(u32Index = 0; u32Index < HOST_HTTP_MAX_HEADERS; u32Index++)
+  {
+    free(pstClient->tpcKeys[u32Index]);
+    free(pstClient->tpcValues[u32Index]);
+  }
+  free(pstClient);
+  return ESP_OK;
+}
\ No newline at end of file
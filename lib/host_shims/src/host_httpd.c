@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <esp_err.h>
+#include <esp_http_server.h>
+
+#include "host_shims.h"
+
+#define HOST_HTTPD_MAX_SERVERS                   2
+#define HOST_HTTPD_MAX_HANDLERS                  8
+
+struct host_httpd
+{
+  bool bUsed;
+  httpd_config_t stConfig;
+  httpd_uri_t tstHandlers[HOST_HTTPD_MAX_HANDLERS];
+  uint32_t u32Handlers;
+};
+
+/* Request in progress, one at a time like a server task */
+typedef struct
+{
+  httpd_req_t stReq;
+  char *pcBody;
+  uint32_t u32Size;
+  host_httpd_response_t *pstResponse;
+  esp_err_t s32Error;
+}host_httpd_request_t;
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  struct host_httpd tstServers[HOST_HTTPD_MAX_SERVERS];
+  host_httpd_request_t stRequest;
+}host_httpd_ctx_t;
+
+static host_httpd_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+esp_err_t httpd_start(httpd_handle_t *ppstServer, const httpd_config_t *pstConfig)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_ERR_NO_MEM;
+  for(u32Index = 0; (u32Index < HOST_HTTPD_MAX_SERVERS) && (ESP_OK != s32RetVal); u32Index++)
+  {
+    if(stCtx.tstServers[u32Index].bUsed && (stCtx.tstServers[u32Index].stConfig.server_port == pstConfig->server_port))
+    {
+      /* Port already taken */
+      s32RetVal = ESP_FAIL;
+      break;
+    }
+    else if(!stCtx.tstServers[u32Index].bUsed)
+    {
+      memset(&stCtx.tstServers[u32Index], 0x00, sizeof(struct host_httpd));
+      stCtx.tstServers[u32Index].bUsed = true;
+      stCtx.tstServers[u32Index].stConfig = *pstConfig;
+      *ppstServer = &stCtx.tstServers[u32Index];
+      s32RetVal = ESP_OK;
+    }
+  }
+  return s32RetVal;
+}
+
+esp_err_t httpd_stop(httpd_handle_t pstServer)
+{
+  pstServer->bUsed = false;
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t pstServer, const httpd_uri_t *pstUri)
+{
+  esp_err_t s32RetVal;
+
+  if(pstServer->u32Handlers >= pstServer->stConfig.max_uri_handlers)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    pstServer->tstHandlers[pstServer->u32Handlers++] = *pstUri;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *pstReq, const char *pcType)
+{
+  snprintf(stCtx.stRequest.pstResponse->tcContentType,
+           sizeof(stCtx.stRequest.pstResponse->tcContentType),
+           "%s",
+           pcType);
+  return ESP_OK;
+}
+
+/* An empty chunk ends the response */
+esp_err_t httpd_resp_send_chunk(httpd_req_t *pstReq, const char *pcChunk, ssize_t s32Length)
+{
+  esp_err_t s32RetVal;
+  host_httpd_response_t *pstResponse;
+
+  pstResponse = stCtx.stRequest.pstResponse;
+  s32Length = (HTTPD_RESP_USE_STRLEN == s32Length)?(ssize_t)strlen(pcChunk):s32Length;
+  if(pstResponse->bFinished)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else if((NULL == pcChunk) || (0 == s32Length))
+  {
+    pstResponse->bFinished = true;
+    s32RetVal = ESP_OK;
+  }
+  else if((pstResponse->u32Length + s32Length) >= stCtx.stRequest.u32Size)
+  {
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else
+  {
+    memcpy(&stCtx.stRequest.pcBody[pstResponse->u32Length], pcChunk, s32Length);
+    pstResponse->u32Length += s32Length;
+    stCtx.stRequest.pcBody[pstResponse->u32Length] = '\0';
+    pstResponse->u32Chunks++;
+    pstResponse->u32MaxChunk = ((uint32_t)s32Length > pstResponse->u32MaxChunk)?(uint32_t)s32Length:pstResponse->u32MaxChunk;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+esp_err_t host_httpd_get(uint16_t u16Port,
+                         const char *pcUri,
+                         char *pcBody,
+                         uint32_t u32Size,
+                         host_httpd_response_t *pstResponse)
+{
+  uint32_t u32Index;
+  uint32_t u32Handler;
+  esp_err_t s32RetVal;
+  struct host_httpd *pstServer;
+
+  s32RetVal = ESP_ERR_NOT_FOUND;
+  pthread_mutex_lock(&stCtx.stLock);
+  memset(pstResponse, 0x00, sizeof(host_httpd_response_t));
+  pcBody[0] = '\0';
+  for(u32Index = 0; u32Index < HOST_HTTPD_MAX_SERVERS; u32Index++)
+  {
+    pstServer = &stCtx.tstServers[u32Index];
+    for(u32Handler = 0;
+        pstServer->bUsed && (u16Port == pstServer->stConfig.server_port) && (u32Handler < pstServer->u32Handlers);
+        u32Handler++)
+    {
+      if((HTTP_GET == pstServer->tstHandlers[u32Handler].method) &&
+         (0 == strcmp(pstServer->tstHandlers[u32Handler].uri, pcUri)))
+      {
+        memset(&stCtx.stRequest, 0x00, sizeof(stCtx.stRequest));
+        stCtx.stRequest.stReq.handle = pstServer;
+        stCtx.stRequest.stReq.method = HTTP_GET;
+        stCtx.stRequest.stReq.uri = pcUri;
+        stCtx.stRequest.stReq.user_ctx = pstServer->tstHandlers[u32Handler].user_ctx;
+        stCtx.stRequest.pcBody = pcBody;
+        stCtx.stRequest.u32Size = u32Size;
+        stCtx.stRequest.pstResponse = pstResponse;
+        s32RetVal = pstServer->tstHandlers[u32Handler].handler(&stCtx.stRequest.stReq);
+      }
+    }
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef _HOST_PRIVATE_H_
+#define _HOST_PRIVATE_H_
+
+/* Runs the GPIO interrupt handlers, called by a simulated reader */
+void host_gpio_raise(void);
+
+#endif /* _HOST_PRIVATE_H_ */
\ No newline at end of file
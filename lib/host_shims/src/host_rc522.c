@@ -0,0 +1,441 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <esp_timer.h>
+#include <driver/spi_master.h>
+
+#include "host_shims.h"
+#include "host_private.h"
+
+#define HOST_RC522_MAX_DEVICES                   8
+#define HOST_RC522_VERSION                       0x92
+
+#define HOST_RC522_REG_COMMAND                   0x01
+#define HOST_RC522_REG_COM_IEN                   0x02
+#define HOST_RC522_REG_COM_IRQ                   0x04
+#define HOST_RC522_REG_ERROR                     0x06
+#define HOST_RC522_REG_FIFO_DATA                 0x09
+#define HOST_RC522_REG_FIFO_LEVEL                0x0A
+#define HOST_RC522_REG_BIT_FRAMING               0x0D
+#define HOST_RC522_REG_TX_CONTROL                0x14
+#define HOST_RC522_REG_VERSION                   0x37
+
+#define HOST_RC522_CMD_TRANSCEIVE                0x0C
+#define HOST_RC522_CMD_SOFT_RESET                0x0F
+#define HOST_RC522_IRQ_TIMER                     0x01
+#define HOST_RC522_IRQ_RX_IDLE                   0x30
+
+/* An MFRC522 answering for an ISO 14443-3 tag: REQA, the anticollision and
+   the select of each cascade level */
+struct host_rc522
+{
+  int s32CsPin;
+  bool bUsed;
+  bool bMissing;
+  bool bBadCrc;
+  uint8_t tu08Uid[10];
+  uint8_t u08UidLength;
+  uint8_t tu08Reg[64];
+  uint8_t tu08Fifo[64];
+  uint32_t u32FifoLength;
+  uint32_t u32FifoRead;
+  uint32_t u32Transfers;
+  int s32ClockHz;
+  /* The answer of the tag or the timer expiry comes this long after the
+     frame is sent. Its IRQ bits wait until then */
+  uint32_t u32AnswerUs;
+  uint32_t u32TimerUs;
+  uint8_t u08PendingIrq;
+  int64_t s64ReadyUs;
+  uint32_t u32Exchange;
+};
+
+typedef struct
+{
+  struct host_rc522 *pstDevice;
+  uint32_t u32Exchange;
+}host_rc522_answer_t;
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  struct host_rc522 tstDevices[HOST_RC522_MAX_DEVICES];
+}host_rc522_ctx_t;
+
+static host_rc522_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct host_rc522 *_host_rc522_get(int s32CsPin)
+{
+  uint32_t u32Index;
+  struct host_rc522 *pstDevice;
+
+  pstDevice = NULL;
+  for(u32Index = 0; (u32Index < HOST_RC522_MAX_DEVICES) && (NULL == pstDevice); u32Index++)
+  {
+    if(stCtx.tstDevices[u32Index].bUsed && (s32CsPin == stCtx.tstDevices[u32Index].s32CsPin))
+    {
+      pstDevice = &stCtx.tstDevices[u32Index];
+    }
+  }
+  for(u32Index = 0; (u32Index < HOST_RC522_MAX_DEVICES) && (NULL == pstDevice); u32Index++)
+  {
+    if(!stCtx.tstDevices[u32Index].bUsed)
+    {
+      pstDevice = &stCtx.tstDevices[u32Index];
+      pstDevice->bUsed = true;
+      pstDevice->s32CsPin = s32CsPin;
+    }
+  }
+  return pstDevice;
+}
+
+/* Sets the IRQ bits of an answer that is due, called with the lock held.
+   True when the IRQ line goes low */
+static bool _host_rc522_settle(struct host_rc522 *pstDevice)
+{
+  bool bIrq;
+
+  bIrq = false;
+  if(pstDevice->u08PendingIrq && (esp_timer_get_time() >= pstDevice->s64ReadyUs))
+  {
+    pstDevice->tu08Reg[HOST_RC522_REG_COM_IRQ] |= pstDevice->u08PendingIrq;
+    pstDevice->u08PendingIrq = 0;
+    bIrq = (pstDevice->tu08Reg[HOST_RC522_REG_COM_IEN] & pstDevice->tu08Reg[HOST_RC522_REG_COM_IRQ] & 0x7F) != 0;
+  }
+  return bIrq;
+}
+
+/* Stands in for the IRQ line of a late answer: the task waiting on it
+   sleeps, so the clock moves on to the answer. The exchange may have been
+   aborted by then */
+static void *_host_rc522_answer(void *pvArg)
+{
+  bool bIrq;
+  int64_t s64WaitUs;
+  host_rc522_answer_t *pstAnswer;
+
+  pstAnswer = pvArg;
+  pthread_mutex_lock(&stCtx.stLock);
+  s64WaitUs = pstAnswer->pstDevice->s64ReadyUs - esp_timer_get_time();
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(s64WaitUs > 0)
+  {
+    host_time_advance_us(s64WaitUs);
+  }
+  pthread_mutex_lock(&stCtx.stLock);
+  bIrq = (pstAnswer->u32Exchange == pstAnswer->pstDevice->u32Exchange) && _host_rc522_settle(pstAnswer->pstDevice);
+  pthread_mutex_unlock(&stCtx.stLock);
+  free(pstAnswer);
+  if(bIrq)
+  {
+    host_gpio_raise();
+  }
+  return NULL;
+}
+
+static uint16_t _host_rc522_crc_a(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint8_t u08Bit;
+  uint16_t u16Crc;
+  uint32_t u32Index;
+
+  u16Crc = 0x6363;
+  for(u32Index = 0; u32Index < u32Length; u32Index++)
+  {
+    u16Crc ^= pu08Data[u32Index];
+    for(u08Bit = 0; u08Bit < 8; u08Bit++)
+    {
+      u16Crc = (u16Crc & 0x0001)?((u16Crc >> 1) ^ 0x8408):(u16Crc >> 1);
+    }
+  }
+  return u16Crc;
+}
+
+/* The UID bytes of a cascade level and their BCC */
+static void _host_rc522_part(struct host_rc522 *pstDevice, uint32_t u32Level, uint8_t *pu08Part)
+{
+  uint32_t u32Levels;
+
+  u32Levels = (4 == pstDevice->u08UidLength)?1:((7 == pstDevice->u08UidLength)?2:3);
+  if(u32Level < (u32Levels - 1))
+  {
+    pu08Part[0] = 0x88;
+    memcpy(&pu08Part[1], &pstDevice->tu08Uid[u32Level * 3], 3);
+  }
+  else
+  {
+    memcpy(pu08Part, &pstDevice->tu08Uid[u32Level * 3], 4);
+  }
+  pu08Part[4] = pu08Part[0] ^ pu08Part[1] ^ pu08Part[2] ^ pu08Part[3];
+}
+
+/* Answer the frame in the FIFO, nothing answers without a tag in the field
+   and the timer expires instead. True when the IRQ line goes low */
+static bool _host_rc522_transceive(struct host_rc522 *pstDevice)
+{
+  bool bIrq;
+  pthread_t stThread;
+  pthread_attr_t stAttr;
+  host_rc522_answer_t *pstAnswer;
+  uint8_t tu08In[64];
+  uint8_t tu08Part[5];
+  uint16_t u16Crc;
+  uint32_t u32Level;
+  uint32_t u32Levels;
+  uint32_t u32Length;
+
+  u32Length = pstDevice->u32FifoLength;
+  memcpy(tu08In, pstDevice->tu08Fifo, u32Length);
+  pstDevice->u32FifoLength = 0;
+  pstDevice->u32FifoRead = 0;
+  u32Levels = (4 == pstDevice->u08UidLength)?1:((7 == pstDevice->u08UidLength)?2:3);
+  u32Level = (tu08In[0] - 0x93) / 2;
+  if(!pstDevice->u08UidLength || !(pstDevice->tu08Reg[HOST_RC522_REG_TX_CONTROL] & 0x03))
+  {
+    /* No answer */
+  }
+  else if((1 == u32Length) && (0x26 == tu08In[0]))
+  {
+    pstDevice->tu08Fifo[0] = 0x44;
+    pstDevice->tu08Fifo[1] = 0x00;
+    pstDevice->u32FifoLength = 2;
+  }
+  else if((2 == u32Length) && (0x20 == tu08In[1]) && (u32Level < u32Levels))
+  {
+    _host_rc522_part(pstDevice, u32Level, pstDevice->tu08Fifo);
+    pstDevice->u32FifoLength = 5;
+  }
+  else if((9 == u32Length) && (0x70 == tu08In[1]) && (u32Level < u32Levels))
+  {
+    _host_rc522_part(pstDevice, u32Level, tu08Part);
+    u16Crc = _host_rc522_crc_a(tu08In, 7);
+    if((0 == memcmp(tu08Part, &tu08In[2], 5)) && (tu08In[7] == (u16Crc & 0xFF)) && (tu08In[8] == (u16Crc >> 8)))
+    {
+      pstDevice->tu08Fifo[0] = (u32Level < (u32Levels - 1))?0x04:0x08;
+      u16Crc = _host_rc522_crc_a(pstDevice->tu08Fifo, 1);
+      pstDevice->tu08Fifo[1] = u16Crc & 0xFF;
+      pstDevice->tu08Fifo[2] = (u16Crc >> 8) ^ (pstDevice->bBadCrc?0x01:0x00);
+      pstDevice->u32FifoLength = 3;
+    }
+  }
+  pstDevice->u08PendingIrq = pstDevice->u32FifoLength?HOST_RC522_IRQ_RX_IDLE:HOST_RC522_IRQ_TIMER;
+  pstDevice->s64ReadyUs = esp_timer_get_time() + (pstDevice->u32FifoLength?pstDevice->u32AnswerUs:pstDevice->u32TimerUs);
+  pstDevice->u32Exchange++;
+  bIrq = _host_rc522_settle(pstDevice);
+  /* Polled, the answer shows up as COM_IRQ is read while the bus time adds up */
+  pstAnswer = (pstDevice->u08PendingIrq & pstDevice->tu08Reg[HOST_RC522_REG_COM_IEN])?
+              malloc(sizeof(host_rc522_answer_t)):NULL;
+  if(pstAnswer)
+  {
+    pstAnswer->pstDevice = pstDevice;
+    pstAnswer->u32Exchange = pstDevice->u32Exchange;
+    pthread_attr_init(&stAttr);
+    pthread_attr_setdetachstate(&stAttr, PTHREAD_CREATE_DETACHED);
+    if(pthread_create(&stThread, &stAttr, _host_rc522_answer, pstAnswer))
+    {
+      free(pstAnswer);
+    }
+    pthread_attr_destroy(&stAttr);
+  }
+  return bIrq;
+}
+
+static uint8_t _host_rc522_read(struct host_rc522 *pstDevice, uint8_t u08Reg)
+{
+  uint8_t u08Value;
+
+  switch(u08Reg)
+  {
+    case HOST_RC522_REG_FIFO_DATA:
+      u08Value = (pstDevice->u32FifoRead < pstDevice->u32FifoLength)?pstDevice->tu08Fifo[pstDevice->u32FifoRead++]:0x00;
+      break;
+    case HOST_RC522_REG_FIFO_LEVEL:
+      u08Value = pstDevice->u32FifoLength - pstDevice->u32FifoRead;
+      break;
+    case HOST_RC522_REG_VERSION:
+      u08Value = HOST_RC522_VERSION;
+      break;
+    case HOST_RC522_REG_ERROR:
+      u08Value = 0x00;
+      break;
+    default:
+      u08Value = pstDevice->tu08Reg[u08Reg];
+      break;
+  }
+  return u08Value;
+}
+
+/* True when the IRQ line goes low */
+static bool _host_rc522_write(struct host_rc522 *pstDevice, uint8_t u08Reg, uint8_t u08Value)
+{
+  bool bIrq;
+
+  bIrq = false;
+  switch(u08Reg)
+  {
+    case HOST_RC522_REG_FIFO_DATA:
+      if(pstDevice->u32FifoLength < sizeof(pstDevice->tu08Fifo))
+      {
+        pstDevice->tu08Fifo[pstDevice->u32FifoLength++] = u08Value;
+      }
+      break;
+    case HOST_RC522_REG_FIFO_LEVEL:
+      if(u08Value & 0x80)
+      {
+        pstDevice->u32FifoLength = 0;
+        pstDevice->u32FifoRead = 0;
+      }
+      break;
+    case HOST_RC522_REG_COM_IRQ:
+      pstDevice->tu08Reg[u08Reg] = (u08Value & 0x80)?(pstDevice->tu08Reg[u08Reg] | (u08Value & 0x7F)):
+                                                      (pstDevice->tu08Reg[u08Reg] & ~u08Value);
+      break;
+    case HOST_RC522_REG_COMMAND:
+      /* A new command aborts the exchange in flight */
+      pstDevice->u08PendingIrq = 0;
+      if(HOST_RC522_CMD_SOFT_RESET == u08Value)
+      {
+        memset(pstDevice->tu08Reg, 0x00, sizeof(pstDevice->tu08Reg));
+      }
+      else
+      {
+        pstDevice->tu08Reg[u08Reg] = u08Value;
+      }
+      break;
+    case HOST_RC522_REG_BIT_FRAMING:
+      pstDevice->tu08Reg[u08Reg] = u08Value;
+      if((u08Value & 0x80) && (HOST_RC522_CMD_TRANSCEIVE == pstDevice->tu08Reg[HOST_RC522_REG_COMMAND]))
+      {
+        bIrq = _host_rc522_transceive(pstDevice);
+      }
+      break;
+    default:
+      pstDevice->tu08Reg[u08Reg] = u08Value;
+      break;
+  }
+  return bIrq;
+}
+
+esp_err_t spi_bus_initialize(int s32Host, const spi_bus_config_t *pstConfig, int s32DmaChannel)
+{
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(int s32Host, const spi_device_interface_config_t *pstConfig, spi_device_handle_t *ppstDevice)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  *ppstDevice = _host_rc522_get(pstConfig->spics_io_num);
+  if(*ppstDevice)
+  {
+    (*ppstDevice)->s32ClockHz = pstConfig->clock_speed_hz;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return *ppstDevice?ESP_OK:ESP_ERR_NO_MEM;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t pstDevice)
+{
+  return ESP_OK;
+}
+
+/* A missing reader reads as 0x00 */
+/* With a timing set, the transaction also takes its bus time on the clock,
+   rounded up to the microsecond */
+esp_err_t spi_device_polling_transmit(spi_device_handle_t pstDevice, spi_transaction_t *pstTransaction)
+{
+  bool bIrq;
+  int64_t s64BusUs;
+  uint8_t u08Reg;
+  uint32_t u32Index;
+  uint32_t u32Length;
+  const uint8_t *pu08Tx;
+  uint8_t *pu08Rx;
+
+  bIrq = false;
+  pu08Tx = (pstTransaction->flags & SPI_TRANS_USE_TXDATA)?pstTransaction->tx_data:pstTransaction->tx_buffer;
+  pu08Rx = (pstTransaction->flags & SPI_TRANS_USE_RXDATA)?pstTransaction->rx_data:pstTransaction->rx_buffer;
+  u32Length = pstTransaction->length / 8;
+  pthread_mutex_lock(&stCtx.stLock);
+  s64BusUs = ((pstDevice->u32AnswerUs || pstDevice->u32TimerUs) && (pstDevice->s32ClockHz > 0))?
+             (((int64_t)pstTransaction->length * 1000000LL) + pstDevice->s32ClockHz - 1) / pstDevice->s32ClockHz:0;
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(s64BusUs)
+  {
+    host_time_advance_us(s64BusUs);
+  }
+  pthread_mutex_lock(&stCtx.stLock);
+  pstDevice->u32Transfers++;
+  bIrq = _host_rc522_settle(pstDevice);
+  if(pu08Tx[0] & 0x80)
+  {
+    /* Burst read, the data of an address comes back with the next byte */
+    for(u32Index = 0; (u32Index + 1) < u32Length; u32Index++)
+    {
+      pu08Rx[u32Index + 1] = pstDevice->bMissing?0x00:_host_rc522_read(pstDevice, (pu08Tx[u32Index] >> 1) & 0x3F);
+    }
+  }
+  else if(!pstDevice->bMissing)
+  {
+    u08Reg = (pu08Tx[0] >> 1) & 0x3F;
+    for(u32Index = 1; u32Index < u32Length; u32Index++)
+    {
+      bIrq |= _host_rc522_write(pstDevice, u08Reg, pu08Tx[u32Index]);
+    }
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(bIrq)
+  {
+    host_gpio_raise();
+  }
+  return ESP_OK;
+}
+
+void host_rc522_set_present(int s32CsPin, bool bPresent)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  _host_rc522_get(s32CsPin)->bMissing = !bPresent;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+void host_rc522_set_tag(int s32CsPin, const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  struct host_rc522 *pstDevice;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstDevice = _host_rc522_get(s32CsPin);
+  pstDevice->u08UidLength = ((4 == u08UidLength) || (7 == u08UidLength) || (10 == u08UidLength))?u08UidLength:0;
+  memcpy(pstDevice->tu08Uid, pu08Uid, pstDevice->u08UidLength);
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+void host_rc522_set_bad_crc(int s32CsPin, bool bBadCrc)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  _host_rc522_get(s32CsPin)->bBadCrc = bBadCrc;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+void host_rc522_set_timing(int s32CsPin, uint32_t u32AnswerUs, uint32_t u32TimerUs)
+{
+  struct host_rc522 *pstDevice;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  pstDevice = _host_rc522_get(s32CsPin);
+  pstDevice->u32AnswerUs = u32AnswerUs;
+  pstDevice->u32TimerUs = u32TimerUs;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+uint32_t host_rc522_get_transfers(int s32CsPin)
+{
+  uint32_t u32Transfers;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  u32Transfers = _host_rc522_get(s32CsPin)->u32Transfers;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return u32Transfers;
+}
\ No newline at end of file
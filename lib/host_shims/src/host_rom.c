@@ -0,0 +1,209 @@
+#include <string.h>
+
+#include <zlib.h>
+
+#include <esp32/rom/crc.h>
+#include <esp32/rom/miniz.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/base64.h>
+
+#define HOST_SHA256_ROTR(x, n)                   (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const char tcBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const uint32_t tu32K[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t crc32_le(uint32_t u32Crc, const uint8_t *pu08Data, uint32_t u32Length)
+{
+  return (uint32_t)crc32(u32Crc, pu08Data, u32Length);
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *pstInflator,
+                              const uint8_t *pu08In,
+                              size_t *pu32InLength,
+                              uint8_t *pu08OutStart,
+                              uint8_t *pu08OutNext,
+                              size_t *pu32OutLength,
+                              uint32_t u32Flags)
+{
+  int s32Result;
+  tinfl_status eStatus;
+
+  if(!pstInflator->s32Started)
+  {
+    memset(&pstInflator->stStream, 0x00, sizeof(pstInflator->stStream));
+    inflateInit2(&pstInflator->stStream, (u32Flags & TINFL_FLAG_PARSE_ZLIB_HEADER)?15:-15);
+    pstInflator->s32Started = 1;
+  }
+  pstInflator->stStream.next_in = (uint8_t *)pu08In;
+  pstInflator->stStream.avail_in = *pu32InLength;
+  pstInflator->stStream.next_out = pu08OutNext;
+  pstInflator->stStream.avail_out = *pu32OutLength;
+  s32Result = inflate(&pstInflator->stStream, Z_NO_FLUSH);
+  *pu32InLength -= pstInflator->stStream.avail_in;
+  *pu32OutLength -= pstInflator->stStream.avail_out;
+  if(Z_STREAM_END == s32Result)
+  {
+    eStatus = TINFL_STATUS_DONE;
+  }
+  else if((Z_OK != s32Result) && (Z_BUF_ERROR != s32Result))
+  {
+    eStatus = TINFL_STATUS_FAILED;
+  }
+  else
+  {
+    eStatus = pstInflator->stStream.avail_out?TINFL_STATUS_NEEDS_MORE_INPUT:TINFL_STATUS_HAS_MORE_OUTPUT;
+  }
+  if(eStatus <= TINFL_STATUS_DONE)
+  {
+    inflateEnd(&pstInflator->stStream);
+    pstInflator->s32Started = 0;
+  }
+  return eStatus;
+}
+
+static void _host_sha256_block(mbedtls_sha256_context *pstCtx, const uint8_t *pu08Block)
+{
+  uint32_t u32Index;
+  uint32_t u32T1;
+  uint32_t u32T2;
+  uint32_t tu32W[64];
+  uint32_t tu32V[8];
+
+  for(u32Index = 0; u32Index < 16; u32Index++)
+  {
+    tu32W[u32Index] = ((uint32_t)pu08Block[u32Index * 4] << 24) | ((uint32_t)pu08Block[u32Index * 4 + 1] << 16) |
+                      ((uint32_t)pu08Block[u32Index * 4 + 2] << 8) | pu08Block[u32Index * 4 + 3];
+  }
+  for(u32Index = 16; u32Index < 64; u32Index++)
+  {
+    tu32W[u32Index] = tu32W[u32Index - 16] + tu32W[u32Index - 7] +
+                      (HOST_SHA256_ROTR(tu32W[u32Index - 15], 7) ^ HOST_SHA256_ROTR(tu32W[u32Index - 15], 18) ^
+                       (tu32W[u32Index - 15] >> 3)) +
+                      (HOST_SHA256_ROTR(tu32W[u32Index - 2], 17) ^ HOST_SHA256_ROTR(tu32W[u32Index - 2], 19) ^
+                       (tu32W[u32Index - 2] >> 10));
+  }
+  memcpy(tu32V, pstCtx->tu32State, sizeof(tu32V));
+  for(u32Index = 0; u32Index < 64; u32Index++)
+  {
+    u32T1 = tu32V[7] + (HOST_SHA256_ROTR(tu32V[4], 6) ^ HOST_SHA256_ROTR(tu32V[4], 11) ^ HOST_SHA256_ROTR(tu32V[4], 25)) +
+            ((tu32V[4] & tu32V[5]) ^ (~tu32V[4] & tu32V[6])) + tu32K[u32Index] + tu32W[u32Index];
+    u32T2 = (HOST_SHA256_ROTR(tu32V[0], 2) ^ HOST_SHA256_ROTR(tu32V[0], 13) ^ HOST_SHA256_ROTR(tu32V[0], 22)) +
+            ((tu32V[0] & tu32V[1]) ^ (tu32V[0] & tu32V[2]) ^ (tu32V[1] & tu32V[2]));
+    memmove(&tu32V[1], &tu32V[0], 7 * sizeof(uint32_t));
+    tu32V[4] += u32T1;
+    tu32V[0] = u32T1 + u32T2;
+  }
+  for(u32Index = 0; u32Index < 8; u32Index++)
+  {
+    pstCtx->tu32State[u32Index] += tu32V[u32Index];
+  }
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *pstCtx)
+{
+  memset(pstCtx, 0x00, sizeof(mbedtls_sha256_context));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *pstCtx)
+{
+  memset(pstCtx, 0x00, sizeof(mbedtls_sha256_context));
+}
+
+/* SHA-224 isn't needed */
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context *pstCtx, int s32Is224)
+{
+  static const uint32_t tu32Init[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+  memcpy(pstCtx->tu32State, tu32Init, sizeof(tu32Init));
+  pstCtx->u64Length = 0;
+  pstCtx->u32Used = 0;
+  return s32Is224?-1:0;
+}
+
+int mbedtls_sha256_update_ret(mbedtls_sha256_context *pstCtx, const unsigned char *pu08Data, size_t u32Length)
+{
+  uint32_t u32Chunk;
+
+  pstCtx->u64Length += u32Length;
+  while(u32Length)
+  {
+    u32Chunk = sizeof(pstCtx->tu08Block) - pstCtx->u32Used;
+    u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+    memcpy(&pstCtx->tu08Block[pstCtx->u32Used], pu08Data, u32Chunk);
+    pstCtx->u32Used += u32Chunk;
+    pu08Data += u32Chunk;
+    u32Length -= u32Chunk;
+    if(sizeof(pstCtx->tu08Block) == pstCtx->u32Used)
+    {
+      _host_sha256_block(pstCtx, pstCtx->tu08Block);
+      pstCtx->u32Used = 0;
+    }
+  }
+  return 0;
+}
+
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context *pstCtx, unsigned char *pu08Digest)
+{
+  uint32_t u32Index;
+  uint64_t u64Bits;
+  uint8_t tu08Pad[72];
+
+  u64Bits = pstCtx->u64Length * 8;
+  memset(tu08Pad, 0x00, sizeof(tu08Pad));
+  tu08Pad[0] = 0x80;
+  mbedtls_sha256_update_ret(pstCtx, tu08Pad, ((pstCtx->u32Used < 56)?56:120) - pstCtx->u32Used);
+  for(u32Index = 0; u32Index < 8; u32Index++)
+  {
+    tu08Pad[u32Index] = (uint8_t)(u64Bits >> (56 - u32Index * 8));
+  }
+  mbedtls_sha256_update_ret(pstCtx, tu08Pad, 8);
+  for(u32Index = 0; u32Index < 32; u32Index++)
+  {
+    pu08Digest[u32Index] = (uint8_t)(pstCtx->tu32State[u32Index / 4] >> (24 - (u32Index % 4) * 8));
+  }
+  return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *pu08Dest, size_t u32DestSize, size_t *pu32Length, const unsigned char *pu08Src, size_t u32SrcLength)
+{
+  int s32RetVal;
+  size_t u32Index;
+  uint32_t u32Triple;
+
+  *pu32Length = ((u32SrcLength + 2) / 3) * 4;
+  if((NULL == pu08Dest) || (u32DestSize <= *pu32Length))
+  {
+    *pu32Length += 1;
+    s32RetVal = MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  else
+  {
+    for(u32Index = 0; u32Index < u32SrcLength; u32Index += 3)
+    {
+      u32Triple = (uint32_t)pu08Src[u32Index] << 16;
+      u32Triple |= ((u32Index + 1) < u32SrcLength)?((uint32_t)pu08Src[u32Index + 1] << 8):0;
+      u32Triple |= ((u32Index + 2) < u32SrcLength)?pu08Src[u32Index + 2]:0;
+      *pu08Dest++ = tcBase64[(u32Triple >> 18) & 0x3F];
+      *pu08Dest++ = tcBase64[(u32Triple >> 12) & 0x3F];
+      *pu08Dest++ = ((u32Index + 1) < u32SrcLength)?tcBase64[(u32Triple >> 6) & 0x3F]:'=';
+      *pu08Dest++ = ((u32Index + 2) < u32SrcLength)?tcBase64[u32Triple & 0x3F]:'=';
+    }
+    *pu08Dest = '\0';
+    s32RetVal = 0;
+  }
+  return s32RetVal;
+}
\ No newline at end of file
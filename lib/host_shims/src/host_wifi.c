@@ -0,0 +1,388 @@
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <esp_event.h>
+#include <esp_netif.h>
+#include <esp_wifi.h>
+
+#include "host_shims.h"
+
+#define HOST_WIFI_MAX_HANDLERS                   8
+#define HOST_WIFI_LEASE_IP                       "192.168.1.50"
+#define HOST_WIFI_LEASE_NETMASK                  "255.255.255.0"
+#define HOST_WIFI_LEASE_GATEWAY                  "192.168.1.1"
+
+typedef struct
+{
+  esp_event_base_t pcBase;
+  int32_t s32Id;
+  esp_event_handler_t pfHandler;
+  void *pvArg;
+}host_wifi_handler_t;
+
+struct host_netif
+{
+  bool bDhcpStopped;
+  esp_netif_ip_info_t stIpInfo;
+  esp_ip4_addr_t stDns;
+};
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  host_wifi_timing_t stTiming;
+  bool bLoop;
+  host_wifi_handler_t tstHandlers[HOST_WIFI_MAX_HANDLERS];
+  uint32_t u32Handlers;
+  struct host_netif stNetif;
+  wifi_config_t stConfig;
+  bool bApPresent;
+  uint8_t u08ApChannel;
+  uint8_t tu08ApBssid[6];
+  /* The AP answered the attempt in progress */
+  bool bFound;
+  bool bAssociated;
+  esp_timer_handle_t pstLinkTimer;
+  esp_timer_handle_t pstDhcpTimer;
+  uint32_t u32Attempts;
+  uint32_t u32Scans;
+}host_wifi_ctx_t;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+static host_wifi_ctx_t stCtx =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Runs the handlers without the lock, they call back into the driver */
+static void _host_wifi_post(esp_event_base_t pcBase, int32_t s32Id, void *pvData)
+{
+  uint32_t u32Index;
+  uint32_t u32Handlers;
+  host_wifi_handler_t tstHandlers[HOST_WIFI_MAX_HANDLERS];
+
+  pthread_mutex_lock(&stCtx.stLock);
+  u32Handlers = stCtx.u32Handlers;
+  memcpy(tstHandlers, stCtx.tstHandlers, sizeof(tstHandlers));
+  pthread_mutex_unlock(&stCtx.stLock);
+  for(u32Index = 0; u32Index < u32Handlers; u32Index++)
+  {
+    if((tstHandlers[u32Index].pcBase == pcBase) &&
+       ((ESP_EVENT_ANY_ID == tstHandlers[u32Index].s32Id) || (s32Id == tstHandlers[u32Index].s32Id)))
+    {
+      tstHandlers[u32Index].pfHandler(tstHandlers[u32Index].pvArg, pcBase, s32Id, pvData);
+    }
+  }
+}
+
+static void _host_wifi_got_ip(void)
+{
+  ip_event_got_ip_t stGotIp;
+
+  memset(&stGotIp, 0x00, sizeof(stGotIp));
+  pthread_mutex_lock(&stCtx.stLock);
+  stGotIp.esp_netif = &stCtx.stNetif;
+  stGotIp.ip_info = stCtx.stNetif.stIpInfo;
+  pthread_mutex_unlock(&stCtx.stLock);
+  _host_wifi_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &stGotIp);
+}
+
+/* End of a probe or a scan, with the association when the AP answered */
+static void _host_wifi_link(void *pvArg)
+{
+  bool bFound;
+  bool bDhcp;
+  uint32_t u32DhcpMs;
+  wifi_event_sta_connected_t stConnected;
+  wifi_event_sta_disconnected_t stDisconnected;
+
+  memset(&stConnected, 0x00, sizeof(stConnected));
+  memset(&stDisconnected, 0x00, sizeof(stDisconnected));
+  pthread_mutex_lock(&stCtx.stLock);
+  bFound = stCtx.bFound && stCtx.bApPresent;
+  stCtx.bAssociated = bFound;
+  bDhcp = !stCtx.stNetif.bDhcpStopped;
+  u32DhcpMs = stCtx.stTiming.u32DhcpMs;
+  stConnected.channel = stCtx.u08ApChannel;
+  memcpy(stConnected.bssid, stCtx.tu08ApBssid, sizeof(stConnected.bssid));
+  stConnected.authmode = WIFI_AUTH_WPA2_PSK;
+  stDisconnected.reason = WIFI_REASON_NO_AP_FOUND;
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(!bFound)
+  {
+    _host_wifi_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &stDisconnected);
+  }
+  else
+  {
+    _host_wifi_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &stConnected);
+    if(bDhcp)
+    {
+      esp_timer_start_once(stCtx.pstDhcpTimer, u32DhcpMs * 1000ULL);
+    }
+    else
+    {
+      /* Like ESP-IDF a static address is up as soon as the station associates */
+      _host_wifi_got_ip();
+    }
+  }
+}
+
+static void _host_wifi_dhcp(void *pvArg)
+{
+  bool bAssociated;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  bAssociated = stCtx.bAssociated;
+  if(bAssociated)
+  {
+    stCtx.stNetif.stIpInfo.ip.addr = inet_addr(HOST_WIFI_LEASE_IP);
+    stCtx.stNetif.stIpInfo.netmask.addr = inet_addr(HOST_WIFI_LEASE_NETMASK);
+    stCtx.stNetif.stIpInfo.gw.addr = inet_addr(HOST_WIFI_LEASE_GATEWAY);
+    stCtx.stNetif.stDns.addr = inet_addr(HOST_WIFI_LEASE_GATEWAY);
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(bAssociated)
+  {
+    _host_wifi_got_ip();
+  }
+}
+
+/* Timers of a former boot are stopped and kept */
+void host_wifi_reset(const host_wifi_timing_t *pstTiming)
+{
+  esp_timer_create_args_t stLinkArgs =
+  {
+    .callback = _host_wifi_link,
+    .name = "host_wifi_link",
+  };
+  esp_timer_create_args_t stDhcpArgs =
+  {
+    .callback = _host_wifi_dhcp,
+    .name = "host_wifi_dhcp",
+  };
+
+  if(NULL == stCtx.pstLinkTimer)
+  {
+    esp_timer_create(&stLinkArgs, &stCtx.pstLinkTimer);
+    esp_timer_create(&stDhcpArgs, &stCtx.pstDhcpTimer);
+  }
+  esp_timer_stop(stCtx.pstLinkTimer);
+  esp_timer_stop(stCtx.pstDhcpTimer);
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.stTiming = *pstTiming;
+  stCtx.bLoop = false;
+  stCtx.u32Handlers = 0;
+  memset(&stCtx.stNetif, 0x00, sizeof(stCtx.stNetif));
+  memset(&stCtx.stConfig, 0x00, sizeof(stCtx.stConfig));
+  stCtx.bFound = false;
+  stCtx.bAssociated = false;
+  stCtx.u32Attempts = 0;
+  stCtx.u32Scans = 0;
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+/* Takes effect from the next attempt, host_wifi_drop() ends the current link */
+void host_wifi_set_ap(bool bPresent, uint8_t u08Channel, const uint8_t *pu08Bssid)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.bApPresent = bPresent;
+  stCtx.u08ApChannel = u08Channel;
+  memcpy(stCtx.tu08ApBssid, pu08Bssid, sizeof(stCtx.tu08ApBssid));
+  pthread_mutex_unlock(&stCtx.stLock);
+}
+
+/* The AP stops answering the station, as on a beacon timeout */
+void host_wifi_drop(void)
+{
+  bool bAssociated;
+  wifi_event_sta_disconnected_t stDisconnected;
+
+  memset(&stDisconnected, 0x00, sizeof(stDisconnected));
+  stDisconnected.reason = WIFI_REASON_BEACON_TIMEOUT;
+  esp_timer_stop(stCtx.pstDhcpTimer);
+  pthread_mutex_lock(&stCtx.stLock);
+  bAssociated = stCtx.bAssociated;
+  stCtx.bAssociated = false;
+  pthread_mutex_unlock(&stCtx.stLock);
+  if(bAssociated)
+  {
+    _host_wifi_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &stDisconnected);
+  }
+}
+
+uint32_t host_wifi_get_attempts(void)
+{
+  uint32_t u32Attempts;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  u32Attempts = stCtx.u32Attempts;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return u32Attempts;
+}
+
+uint32_t host_wifi_get_scans(void)
+{
+  uint32_t u32Scans;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  u32Scans = stCtx.u32Scans;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return u32Scans;
+}
+
+/* Event loop */
+esp_err_t esp_event_loop_create_default(void)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  s32RetVal = stCtx.bLoop?ESP_ERR_INVALID_STATE:ESP_OK;
+  stCtx.bLoop = true;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t pcBase,
+                                     int32_t s32Id,
+                                     esp_event_handler_t pfHandler,
+                                     void *pvArg)
+{
+  esp_err_t s32RetVal;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  if(!stCtx.bLoop)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else if(HOST_WIFI_MAX_HANDLERS <= stCtx.u32Handlers)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    stCtx.tstHandlers[stCtx.u32Handlers].pcBase = pcBase;
+    stCtx.tstHandlers[stCtx.u32Handlers].s32Id = s32Id;
+    stCtx.tstHandlers[stCtx.u32Handlers].pfHandler = pfHandler;
+    stCtx.tstHandlers[stCtx.u32Handlers].pvArg = pvArg;
+    stCtx.u32Handlers++;
+    s32RetVal = ESP_OK;
+  }
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
+
+/* Network interface */
+esp_err_t esp_netif_init(void)
+{
+  return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+  return &stCtx.stNetif;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *pstNetif)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  pstNetif->bDhcpStopped = true;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *pstNetif, const esp_netif_ip_info_t *pstIpInfo)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  pstNetif->stIpInfo = *pstIpInfo;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *pstNetif, esp_netif_dns_type_t eType, esp_netif_dns_info_t *pstDns)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  pstNetif->stDns.addr = pstDns->ip.u_addr.ip4.addr;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *pstNetif, esp_netif_dns_type_t eType, esp_netif_dns_info_t *pstDns)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  memset(pstDns, 0x00, sizeof(esp_netif_dns_info_t));
+  pstDns->ip.type = ESP_IPADDR_TYPE_V4;
+  pstDns->ip.u_addr.ip4.addr = pstNetif->stDns.addr;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return ESP_OK;
+}
+
+uint32_t esp_ip4addr_aton(const char *pcAddr)
+{
+  return inet_addr(pcAddr);
+}
+
+/* Station */
+esp_err_t esp_wifi_init(const wifi_init_config_t *pstConfig)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t eMode)
+{
+  return (WIFI_MODE_STA == eMode)?ESP_OK:ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_set_config(esp_interface_t eInterface, wifi_config_t *pstConfig)
+{
+  pthread_mutex_lock(&stCtx.stLock);
+  stCtx.stConfig = *pstConfig;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+  _host_wifi_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL);
+  return ESP_OK;
+}
+
+/* A probe answers only on the channel and BSSID of the AP */
+esp_err_t esp_wifi_connect(void)
+{
+  bool bTargeted;
+  uint32_t u32DelayMs;
+
+  pthread_mutex_lock(&stCtx.stLock);
+  bTargeted = stCtx.stConfig.sta.channel && stCtx.stConfig.sta.bssid_set;
+  stCtx.bFound = stCtx.bApPresent &&
+                 (!bTargeted ||
+                  ((stCtx.stConfig.sta.channel == stCtx.u08ApChannel) &&
+                   (0 == memcmp(stCtx.stConfig.sta.bssid, stCtx.tu08ApBssid, sizeof(stCtx.tu08ApBssid)))));
+  u32DelayMs = bTargeted?stCtx.stTiming.u32ProbeMs:stCtx.stTiming.u32ScanMs;
+  u32DelayMs += stCtx.bFound?stCtx.stTiming.u32AssocMs:0;
+  stCtx.u32Attempts++;
+  stCtx.u32Scans += bTargeted?0:1;
+  pthread_mutex_unlock(&stCtx.stLock);
+  esp_timer_stop(stCtx.pstLinkTimer);
+  esp_timer_start_once(stCtx.pstLinkTimer, u32DelayMs * 1000ULL);
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *pstRecord)
+{
+  esp_err_t s32RetVal;
+
+  memset(pstRecord, 0x00, sizeof(wifi_ap_record_t));
+  pthread_mutex_lock(&stCtx.stLock);
+  s32RetVal = stCtx.bAssociated?ESP_OK:ESP_FAIL;
+  pstRecord->primary = stCtx.u08ApChannel;
+  memcpy(pstRecord->bssid, stCtx.tu08ApBssid, sizeof(pstRecord->bssid));
+  pstRecord->rssi = -55;
+  pthread_mutex_unlock(&stCtx.stLock);
+  return s32RetVal;
+}
\ No newline at end of file
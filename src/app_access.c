@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include <esp_timer.h>
+
+#include "app_access.h"
+
+#define APP_ACCESS_GRANT_TTL_US                  (CONFIG_RFID_ACCESS_GRANT_TTL_MS * 1000LL)
+#define APP_ACCESS_DENY_TTL_US                   (CONFIG_RFID_ACCESS_DENY_TTL_MS * 1000LL)
+
+typedef struct
+{
+  uint8_t tu08Uid[APP_TAG_UID_MAX_SIZE];
+  uint8_t u08UidLength;
+  bool bGranted;
+  int64_t s64ExpiresUs;
+  int64_t s64LastUsedUs;
+}access_entry_t;
+
+/* Decisions are taken in the reader task, the sync task drops the entries of
+   the UIDs it changes. A lookup done while an entry was dropped isn't cached,
+   the generation tells */
+typedef struct
+{
+  portMUX_TYPE stLock;
+  uint32_t u32Generation;
+  app_access_lookup_cb_t pfLookup;
+  app_access_cb_t pfDecision;
+  app_access_stats_t stStats;
+  access_entry_t tstEntries[APP_ACCESS_CACHE_ENTRIES];
+}access_ctx_t;
+
+static access_ctx_t stCtx =
+{
+  .stLock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* The entry of the UID, or NULL and the least recently used entry in
+   *ppstOldest, entries never used have no length and are picked first */
+static access_entry_t *_app_access_find(const uint8_t *pu08Uid, uint8_t u08UidLength, access_entry_t **ppstOldest)
+{
+  uint32_t u32Index;
+  access_entry_t *pstEntry;
+
+  pstEntry = NULL;
+  *ppstOldest = &stCtx.tstEntries[0];
+  for(u32Index = 0; (u32Index < APP_ACCESS_CACHE_ENTRIES) && (NULL == pstEntry); u32Index++)
+  {
+    if((u08UidLength == stCtx.tstEntries[u32Index].u08UidLength) &&
+       (0 == memcmp(pu08Uid, stCtx.tstEntries[u32Index].tu08Uid, u08UidLength)))
+    {
+      pstEntry = &stCtx.tstEntries[u32Index];
+    }
+    else if(stCtx.tstEntries[u32Index].s64LastUsedUs < (*ppstOldest)->s64LastUsedUs)
+    {
+      *ppstOldest = &stCtx.tstEntries[u32Index];
+    }
+  }
+  return pstEntry;
+}
+
+/* pfLookup resolves cache misses, pfDecision may be NULL */
+void app_access_init(app_access_lookup_cb_t pfLookup, app_access_cb_t pfDecision)
+{
+  portENTER_CRITICAL(&stCtx.stLock);
+  memset(stCtx.tstEntries, 0x00, sizeof(stCtx.tstEntries));
+  memset(&stCtx.stStats, 0x00, sizeof(stCtx.stStats));
+  stCtx.pfLookup = pfLookup;
+  stCtx.pfDecision = pfDecision;
+  portEXIT_CRITICAL(&stCtx.stLock);
+}
+
+/* Fast path of a read: a cached decision is used until it expires, denials
+   are cached too but for a shorter time. Only a miss reaches the lookup, the
+   decision hook then runs before the scan is queued for upload. While the
+   lookup is unavailable an expired decision is used as is, without one the
+   read is denied, neither is cached */
+bool app_access_decide(uint8_t u08ReaderId, const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  bool bHit;
+  bool bStale;
+  bool bGranted;
+  bool bUnavailable;
+  int64_t s64NowUs;
+  uint32_t u32ElapsedUs;
+  uint32_t u32Generation;
+  access_entry_t *pstEntry;
+  access_entry_t *pstOldest;
+
+  bHit = false;
+  bStale = false;
+  bGranted = false;
+  bUnavailable = false;
+  s64NowUs = esp_timer_get_time();
+  u08UidLength = (u08UidLength < APP_TAG_UID_MAX_SIZE)?u08UidLength:APP_TAG_UID_MAX_SIZE;
+  portENTER_CRITICAL(&stCtx.stLock);
+  pstEntry = _app_access_find(pu08Uid, u08UidLength, &pstOldest);
+  if(pstEntry && (s64NowUs < pstEntry->s64ExpiresUs))
+  {
+    bHit = true;
+    bGranted = pstEntry->bGranted;
+    pstEntry->s64LastUsedUs = s64NowUs;
+  }
+  else if(pstEntry)
+  {
+    bStale = pstEntry->bGranted;
+  }
+  u32Generation = stCtx.u32Generation;
+  portEXIT_CRITICAL(&stCtx.stLock);
+  if(bHit || (NULL == stCtx.pfLookup))
+  {
+    /* Nothing to look up */
+  }
+  else if(ESP_OK != stCtx.pfLookup(pu08Uid, u08UidLength, &bGranted))
+  {
+    bGranted = bStale;
+    bUnavailable = true;
+  }
+  else
+  {
+    portENTER_CRITICAL(&stCtx.stLock);
+    if(u32Generation == stCtx.u32Generation)
+    {
+      pstEntry = _app_access_find(pu08Uid, u08UidLength, &pstOldest);
+      pstEntry = pstEntry?pstEntry:pstOldest;
+      memcpy(pstEntry->tu08Uid, pu08Uid, u08UidLength);
+      pstEntry->u08UidLength = u08UidLength;
+      pstEntry->bGranted = bGranted;
+      pstEntry->s64ExpiresUs = s64NowUs + (bGranted?APP_ACCESS_GRANT_TTL_US:APP_ACCESS_DENY_TTL_US);
+      pstEntry->s64LastUsedUs = s64NowUs;
+    }
+    portEXIT_CRITICAL(&stCtx.stLock);
+  }
+  if(stCtx.pfDecision)
+  {
+    stCtx.pfDecision(u08ReaderId, pu08Uid, u08UidLength, bGranted);
+  }
+  u32ElapsedUs = (uint32_t)(esp_timer_get_time() - s64NowUs);
+  portENTER_CRITICAL(&stCtx.stLock);
+  if(bHit)
+  {
+    stCtx.stStats.u32Hits++;
+  }
+  else
+  {
+    stCtx.stStats.u32Misses++;
+  }
+  if(bUnavailable)
+  {
+    stCtx.stStats.u32Unavailable++;
+  }
+  stCtx.stStats.u32MaxDecisionUs = (u32ElapsedUs > stCtx.stStats.u32MaxDecisionUs)?
+                                   u32ElapsedUs:stCtx.stStats.u32MaxDecisionUs;
+  portEXIT_CRITICAL(&stCtx.stLock);
+  return bGranted;
+}
+
+/* The UID changed in the tag index, its next read looks it up again */
+void app_access_forget(const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  access_entry_t *pstEntry;
+  access_entry_t *pstOldest;
+
+  u08UidLength = (u08UidLength < APP_TAG_UID_MAX_SIZE)?u08UidLength:APP_TAG_UID_MAX_SIZE;
+  portENTER_CRITICAL(&stCtx.stLock);
+  pstEntry = _app_access_find(pu08Uid, u08UidLength, &pstOldest);
+  if(pstEntry)
+  {
+    memset(pstEntry, 0x00, sizeof(access_entry_t));
+  }
+  stCtx.u32Generation++;
+  portEXIT_CRITICAL(&stCtx.stLock);
+}
+
+/* The whole tag index changed */
+void app_access_flush(void)
+{
+  portENTER_CRITICAL(&stCtx.stLock);
+  memset(stCtx.tstEntries, 0x00, sizeof(stCtx.tstEntries));
+  stCtx.u32Generation++;
+  portEXIT_CRITICAL(&stCtx.stLock);
+}
+
+void app_access_get_stats(app_access_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    portENTER_CRITICAL(&stCtx.stLock);
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_access_stats_t));
+    portEXIT_CRITICAL(&stCtx.stLock);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "app_conn.h"
+#include "app_doc.h"
+#include "app_batch.h"
+
+#define APP_BATCH_TAG                            "APP_BATCH"
+
+#define APP_BATCH_PATH_MAX_SIZE                  64
+
+#define APP_BATCH_COMMIT_PATH                    ":commit"
+#define APP_BATCH_BODY_HEADER                    "{\"writes\":["
+#define APP_BATCH_BODY_FOOTER                    "]}"
+#define APP_BATCH_REQUEST_TIME                   "REQUEST_TIME"
+
+/* Location of a write in the body, the path is only kept for coalescing */
+typedef struct
+{
+  uint32_t u32Offset;
+  uint32_t u32Count;
+  char tcPath[APP_BATCH_PATH_MAX_SIZE];
+}batch_write_t;
+
+typedef struct
+{
+  uint32_t u32Count;
+  uint32_t u32Length;
+  uint32_t u32Coalesced;
+  /* One spare entry for a coalesced write appended before the one it replaces */
+  batch_write_t tstWrites[APP_BATCH_MAX_WRITES + 1];
+  char tcBody[APP_BATCH_BODY_MAX_SIZE];
+}batch_ctx_t;
+
+static batch_ctx_t stCtx =
+{
+  .u32Count = 0,
+  .u32Length = sizeof(APP_BATCH_BODY_HEADER) - 1,
+  .u32Coalesced = 0,
+  .tcBody = APP_BATCH_BODY_HEADER,
+};
+
+static esp_err_t _app_batch_send(void);
+
+static void _app_batch_reset(void)
+{
+  stCtx.u32Count = 0;
+  stCtx.u32Length = sizeof(APP_BATCH_BODY_HEADER) - 1;
+  stCtx.u32Coalesced = 0;
+}
+
+/* Pending write to the same document, APP_BATCH_MAX_WRITES when there's none */
+static uint32_t _app_batch_find(const char *pcDocumentPath)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0;
+      (u32Index < stCtx.u32Count) && strcmp(stCtx.tstWrites[u32Index].tcPath, pcDocumentPath);
+      u32Index++);
+  return (u32Index < stCtx.u32Count)?u32Index:APP_BATCH_MAX_WRITES;
+}
+
+/* Cut a write out of the body along with one of its separators */
+static void _app_batch_remove(uint32_t u32Write)
+{
+  uint32_t u32Index;
+  uint32_t u32Start;
+  uint32_t u32End;
+
+  if((u32Write + 1) < stCtx.u32Count)
+  {
+    u32Start = stCtx.tstWrites[u32Write].u32Offset;
+    u32End = stCtx.tstWrites[u32Write + 1].u32Offset;
+  }
+  else
+  {
+    u32Start = stCtx.tstWrites[u32Write].u32Offset - (u32Write?1:0);
+    u32End = stCtx.u32Length;
+  }
+  memmove(&stCtx.tcBody[u32Start], &stCtx.tcBody[u32End], stCtx.u32Length - u32End);
+  stCtx.u32Length -= u32End - u32Start;
+  for(u32Index = u32Write + 1; u32Index < stCtx.u32Count; u32Index++)
+  {
+    memcpy(&stCtx.tstWrites[u32Index - 1], &stCtx.tstWrites[u32Index], sizeof(batch_write_t));
+    stCtx.tstWrites[u32Index - 1].u32Offset -= u32End - u32Start;
+  }
+  stCtx.u32Count--;
+}
+
+/* Serialize a write at the end of the body, the counter transform adds
+   u32Count which covers the writes it replaces */
+static esp_err_t _app_batch_append(const app_batch_write_t *pstWrite, uint32_t u32Count)
+{
+  esp_err_t s32RetVal;
+  uint32_t u32Index;
+  uint32_t u32Length;
+  uint32_t u32Offset;
+  app_doc_t stDoc;
+
+  /* Keep room for the separator and the closing brackets of the body */
+  u32Offset = stCtx.u32Length + (stCtx.u32Count?1:0);
+  app_doc_init(&stDoc,
+               &stCtx.tcBody[u32Offset],
+               sizeof(stCtx.tcBody) - u32Offset - sizeof(APP_BATCH_BODY_FOOTER),
+               NULL,
+               NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_begin_object(&stDoc, "update");
+  app_doc_add_name(&stDoc, pstWrite->pcDocumentPath);
+  app_doc_add_fields(&stDoc, pstWrite->pfFields, pstWrite->pvArg);
+  app_doc_end_object(&stDoc);
+  if(pstWrite->ppcMask)
+  {
+    app_doc_begin_object(&stDoc, "updateMask");
+    app_doc_begin_array(&stDoc, "fieldPaths");
+    for(u32Index = 0; u32Index < pstWrite->u32MaskCount; u32Index++)
+    {
+      app_doc_add_text(&stDoc, NULL, pstWrite->ppcMask[u32Index]);
+    }
+    app_doc_end_array(&stDoc);
+    app_doc_end_object(&stDoc);
+  }
+  if(pstWrite->pcRequestTimeField || pstWrite->pcCounterField)
+  {
+    app_doc_begin_array(&stDoc, "updateTransforms");
+    if(pstWrite->pcRequestTimeField)
+    {
+      app_doc_begin_object(&stDoc, NULL);
+      app_doc_add_text(&stDoc, "fieldPath", pstWrite->pcRequestTimeField);
+      app_doc_add_text(&stDoc, "setToServerValue", APP_BATCH_REQUEST_TIME);
+      app_doc_end_object(&stDoc);
+    }
+    if(pstWrite->pcCounterField)
+    {
+      app_doc_begin_object(&stDoc, NULL);
+      app_doc_add_text(&stDoc, "fieldPath", pstWrite->pcCounterField);
+      app_doc_add_integer(&stDoc, "increment", u32Count);
+      app_doc_end_object(&stDoc);
+    }
+    app_doc_end_array(&stDoc);
+  }
+  app_doc_end_object(&stDoc);
+  s32RetVal = app_doc_finish(&stDoc, &u32Length);
+  if(ESP_OK == s32RetVal)
+  {
+    if(0 < stCtx.u32Count)
+    {
+      stCtx.tcBody[stCtx.u32Length] = ',';
+    }
+    stCtx.tstWrites[stCtx.u32Count].u32Offset = u32Offset;
+    stCtx.tstWrites[stCtx.u32Count].u32Count = u32Count;
+    /* Paths too long to be kept are never coalesced */
+    stCtx.tstWrites[stCtx.u32Count].tcPath[0] = '\0';
+    if(pstWrite->bCoalesce && (strlen(pstWrite->pcDocumentPath) < APP_BATCH_PATH_MAX_SIZE))
+    {
+      strcpy(stCtx.tstWrites[stCtx.u32Count].tcPath, pstWrite->pcDocumentPath);
+    }
+    stCtx.u32Length = u32Offset + u32Length;
+    stCtx.u32Count++;
+  }
+  else
+  {
+    /* Drop the truncated write, the caller should commit and retry */
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  return s32RetVal;
+}
+
+/* Append one update write whose fields are serialized in place by pfFields,
+   pcDocumentPath is relative to the database root e.g. "devices/rfid-node" */
+esp_err_t app_batch_add(const char *pcDocumentPath, app_doc_fields_cb_t pfFields, const void *pvArg)
+{
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = pcDocumentPath,
+    .pfFields = pfFields,
+    .pvArg = pvArg,
+  };
+
+  return app_batch_add_write(&stWrite);
+}
+
+/* Same as app_batch_add with a field mask and transforms, a coalesced write
+   takes the place of the pending write to the same document. That write is
+   then lost unless its fields are all overwritten, only its count is kept */
+esp_err_t app_batch_add_write(const app_batch_write_t *pstWrite)
+{
+  esp_err_t s32RetVal;
+  uint32_t u32Write;
+
+  if(pstWrite && pstWrite->pcDocumentPath && pstWrite->pfFields)
+  {
+    u32Write = pstWrite->bCoalesce?_app_batch_find(pstWrite->pcDocumentPath):APP_BATCH_MAX_WRITES;
+    if(APP_BATCH_MAX_WRITES != u32Write)
+    {
+      /* The pending write is only cut once its replacement fits */
+      s32RetVal = _app_batch_append(pstWrite, stCtx.tstWrites[u32Write].u32Count + 1);
+      if(ESP_OK == s32RetVal)
+      {
+        _app_batch_remove(u32Write);
+        stCtx.u32Coalesced++;
+      }
+    }
+    else if(APP_BATCH_MAX_WRITES <= stCtx.u32Count)
+    {
+      s32RetVal = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+      s32RetVal = _app_batch_append(pstWrite, 1);
+    }
+  }
+  else
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  return s32RetVal;
+}
+
+/* Send all pending writes as a single atomic Firestore commit request */
+esp_err_t app_batch_commit(void)
+{
+  esp_err_t s32RetVal;
+
+  if(0 == stCtx.u32Count)
+  {
+    ESP_LOGD(APP_BATCH_TAG, "Nothing to commit");
+    s32RetVal = ESP_OK;
+  }
+  else
+  {
+    s32RetVal = _app_batch_send();
+    /* Writes are dropped on failure just like a failed single document update */
+    _app_batch_reset();
+  }
+  return s32RetVal;
+}
+
+static esp_err_t _app_batch_send(void)
+{
+  int s32HttpCode;
+  esp_err_t s32RetVal;
+
+  memcpy(&stCtx.tcBody[stCtx.u32Length], APP_BATCH_BODY_FOOTER, sizeof(APP_BATCH_BODY_FOOTER));
+  ESP_LOGD(APP_BATCH_TAG, "Committing %d writes, body length: %d", stCtx.u32Count, stCtx.u32Length);
+  s32RetVal = app_conn_request(HTTP_METHOD_POST,
+                               APP_BATCH_COMMIT_PATH,
+                               stCtx.tcBody,
+                               stCtx.u32Length + sizeof(APP_BATCH_BODY_FOOTER) - 1,
+                               NULL,
+                               NULL,
+                               &s32HttpCode);
+  if(ESP_OK == s32RetVal)
+  {
+    if(200 == s32HttpCode)
+    {
+      ESP_LOGI(APP_BATCH_TAG,
+               "Committed %d writes successfully, %d coalesced",
+               stCtx.u32Count,
+               stCtx.u32Coalesced);
+    }
+    else
+    {
+      ESP_LOGE(APP_BATCH_TAG, "Commit failed with HTTP code: %d", s32HttpCode);
+      s32RetVal = ESP_FAIL;
+    }
+  }
+  else
+  {
+    ESP_LOGE(APP_BATCH_TAG, "Commit request failed: %s", esp_err_to_name(s32RetVal));
+  }
+  return s32RetVal;
+}
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_http_client.h>
+#include <esp_crt_bundle.h>
+
+#include "app_conn.h"
+#include "app_trace.h"
+
+#define APP_CONN_TAG                             "APP_CONN"
+
+#define APP_CONN_BASE_URL                        "https://firestore.googleapis.com/v1/"
+#define APP_CONN_URL_MAX_SIZE                    256
+#define APP_CONN_HTTP_TIMEOUT_MS                 10000
+#define APP_CONN_IDLE_TIMEOUT_MS                 30000
+#define APP_CONN_MAX_ATTEMPTS                    2
+
+typedef struct
+{
+  SemaphoreHandle_t stMutex;
+  esp_http_client_handle_t pstClient;
+  int64_t s64LastUseUs;
+  app_conn_data_cb_t pfDataCb;
+  void *pvDataCbArg;
+  bool bRequestSent;
+  bool bHeadersReceived;
+  int64_t s64PhaseUs;
+  app_conn_stats_t stStats;
+  char tcUrl[APP_CONN_URL_MAX_SIZE];
+}conn_ctx_t;
+
+static conn_ctx_t stCtx;
+
+/* Phases can last longer than the cycle counter takes to wrap, esp_timer
+   times them instead. The next phase starts where this one ends */
+static void _app_conn_end_phase(app_trace_point_t ePoint)
+{
+  int64_t s64NowUs;
+
+  s64NowUs = esp_timer_get_time();
+  app_trace_record_us(ePoint, s64NowUs - stCtx.s64PhaseUs);
+  stCtx.s64PhaseUs = s64NowUs;
+}
+
+static esp_err_t _app_conn_http_event_handler(esp_http_client_event_t *pstEvent)
+{
+  switch(pstEvent->event_id)
+  {
+  case HTTP_EVENT_ON_CONNECTED:
+    /* Every new connection means a full TCP + TLS handshake */
+    stCtx.stStats.u32Handshakes++;
+    _app_conn_end_phase(APP_TRACE_CONNECT);
+    ESP_LOGD(APP_CONN_TAG, "Connected to server, handshakes: %d", stCtx.stStats.u32Handshakes);
+    break;
+  case HTTP_EVENT_HEADERS_SENT:
+    stCtx.bRequestSent = true;
+    _app_conn_end_phase(APP_TRACE_SEND);
+    break;
+  case HTTP_EVENT_ON_HEADER:
+    /* Time to first byte of the response */
+    if(!stCtx.bHeadersReceived)
+    {
+      stCtx.bHeadersReceived = true;
+      _app_conn_end_phase(APP_TRACE_WAIT);
+    }
+    break;
+  case HTTP_EVENT_ON_DATA:
+    if(stCtx.pfDataCb)
+    {
+      stCtx.pfDataCb((const char *)pstEvent->data, pstEvent->data_len, stCtx.pvDataCbArg);
+    }
+    break;
+  case HTTP_EVENT_ON_FINISH:
+    _app_conn_end_phase(APP_TRACE_RECEIVE);
+    break;
+  case HTTP_EVENT_DISCONNECTED:
+    ESP_LOGD(APP_CONN_TAG, "Connection is closed");
+    break;
+  default:
+    break;
+  }
+  return ESP_OK;
+}
+
+/* Called once from app_main before any task can send a request, the
+   connection itself is only opened by the first request */
+esp_err_t app_conn_init(void)
+{
+  esp_err_t s32RetVal;
+  esp_http_client_config_t stConfig =
+  {
+    .url = APP_CONN_BASE_URL,
+    .timeout_ms = APP_CONN_HTTP_TIMEOUT_MS,
+    .event_handler = _app_conn_http_event_handler,
+    .crt_bundle_attach = esp_crt_bundle_attach,
+  };
+
+  if(stCtx.stMutex)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    stCtx.pstClient = esp_http_client_init(&stConfig);
+    stCtx.stMutex = stCtx.pstClient?xSemaphoreCreateMutex():NULL;
+    if(NULL == stCtx.stMutex)
+    {
+      ESP_LOGE(APP_CONN_TAG, "Failed to create http client");
+      if(stCtx.pstClient)
+      {
+        esp_http_client_cleanup(stCtx.pstClient);
+        stCtx.pstClient = NULL;
+      }
+      s32RetVal = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+      s32RetVal = ESP_OK;
+    }
+  }
+  return s32RetVal;
+}
+
+/* Send a request to the Firestore REST API over the shared keep-alive connection,
+   pcPath is appended to the database root e.g. "/devices/rfid-node" or ":commit".
+   A failed request is sent again on a new connection, unless it was a POST that
+   may have reached the server: a :commit would then apply its writes and
+   increments twice */
+esp_err_t app_conn_request(esp_http_client_method_t eMethod,
+                           const char *pcPath,
+                           const char *pcBody,
+                           uint32_t u32BodyLength,
+                           app_conn_data_cb_t pfDataCb,
+                           void *pvDataCbArg,
+                           int *ps32HttpCode)
+{
+  int64_t s64StartUs;
+  int64_t s64RequestUs;
+  uint32_t u32Attempt;
+  uint32_t u32LatencyMs;
+  esp_err_t s32RetVal;
+
+  if((NULL == pcPath) || (NULL == ps32HttpCode))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else if(NULL == stCtx.stMutex)
+  {
+    ESP_LOGE(APP_CONN_TAG, "Connection is not initialized");
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    xSemaphoreTake(stCtx.stMutex, portMAX_DELAY);
+    snprintf(stCtx.tcUrl,
+             sizeof(stCtx.tcUrl),
+             APP_CONN_BASE_URL APP_CONN_DATABASE_PATH "%s?key=" FIRESTORE_FIREBASE_API_KEY,
+             pcPath);
+    s64StartUs = esp_timer_get_time();
+    /* The server drops idle connections, reconnect now rather than fail on a dead socket */
+    if(stCtx.s64LastUseUs &&
+       ((s64StartUs - stCtx.s64LastUseUs) > (APP_CONN_IDLE_TIMEOUT_MS * 1000LL)))
+    {
+      ESP_LOGD(APP_CONN_TAG, "Connection has been idle for too long --> reconnecting");
+      esp_http_client_close(stCtx.pstClient);
+      stCtx.stStats.u32Reconnects++;
+    }
+    stCtx.pfDataCb = pfDataCb;
+    stCtx.pvDataCbArg = pvDataCbArg;
+    u32Attempt = 0;
+    do
+    {
+      esp_http_client_set_url(stCtx.pstClient, stCtx.tcUrl);
+      esp_http_client_set_method(stCtx.pstClient, eMethod);
+      esp_http_client_set_header(stCtx.pstClient, "Content-Type", "application/json");
+      esp_http_client_set_post_field(stCtx.pstClient, pcBody, pcBody?u32BodyLength:0);
+      stCtx.bRequestSent = false;
+      stCtx.bHeadersReceived = false;
+      s64RequestUs = esp_timer_get_time();
+      stCtx.s64PhaseUs = s64RequestUs;
+      s32RetVal = esp_http_client_perform(stCtx.pstClient);
+      app_trace_record_us(APP_TRACE_REQUEST, esp_timer_get_time() - s64RequestUs);
+      if(ESP_OK != s32RetVal)
+      {
+        /* Socket was closed by the peer, drop it so the next attempt reconnects */
+        ESP_LOGW(APP_CONN_TAG, "Request failed: %s --> reconnecting", esp_err_to_name(s32RetVal));
+        esp_http_client_close(stCtx.pstClient);
+        stCtx.stStats.u32Reconnects++;
+      }
+    }while((ESP_OK != s32RetVal) &&
+           (!stCtx.bRequestSent || (HTTP_METHOD_POST != eMethod)) &&
+           (++u32Attempt < APP_CONN_MAX_ATTEMPTS));
+    stCtx.pfDataCb = NULL;
+    stCtx.pvDataCbArg = NULL;
+    stCtx.s64LastUseUs = esp_timer_get_time();
+    u32LatencyMs = (uint32_t)((stCtx.s64LastUseUs - s64StartUs) / 1000LL);
+    stCtx.stStats.u32Requests++;
+    stCtx.stStats.u32LastLatencyMs = u32LatencyMs;
+    stCtx.stStats.u64TotalLatencyMs += u32LatencyMs;
+    if(u32LatencyMs > stCtx.stStats.u32MaxLatencyMs)
+    {
+      stCtx.stStats.u32MaxLatencyMs = u32LatencyMs;
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      *ps32HttpCode = esp_http_client_get_status_code(stCtx.pstClient);
+    }
+    else
+    {
+      *ps32HttpCode = 0;
+      stCtx.stStats.u32Failures++;
+    }
+    ESP_LOGD(APP_CONN_TAG,
+             "Request took %d ms (requests: %d, handshakes: %d)",
+             u32LatencyMs,
+             stCtx.stStats.u32Requests,
+             stCtx.stStats.u32Handshakes);
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return s32RetVal;
+}
+
+/* Waits for the request in flight, its stats are updated until it ends */
+void app_conn_get_stats(app_conn_stats_t *pstStats)
+{
+  if(pstStats && stCtx.stMutex)
+  {
+    xSemaphoreTake(stCtx.stMutex, portMAX_DELAY);
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_conn_stats_t));
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  else if(pstStats)
+  {
+    memset(pstStats, 0x00, sizeof(app_conn_stats_t));
+  }
+}
\ No newline at end of file
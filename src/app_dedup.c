@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "app_dedup.h"
+
+void app_dedup_init(app_dedup_t *pstDedup, uint32_t u32HoldOffMs)
+{
+  if(pstDedup)
+  {
+    memset(pstDedup, 0x00, sizeof(app_dedup_t));
+    pstDedup->s64HoldOffUs = u32HoldOffMs * 1000LL;
+  }
+}
+
+/* A read is suppressed while the same UID keeps being read less than the
+   hold-off apart, so a badge held on the reader is reported once. The least
+   recently seen entry makes room for a new UID */
+bool app_dedup_accept(app_dedup_t *pstDedup, const app_tag_t *pstTag)
+{
+  bool bAccepted;
+  uint32_t u32Index;
+  app_dedup_entry_t *pstEntry;
+  app_dedup_entry_t *pstOldest;
+
+  pstEntry = NULL;
+  pstOldest = &pstDedup->tstEntries[0];
+  for(u32Index = 0; (u32Index < APP_DEDUP_ENTRIES) && (NULL == pstEntry); u32Index++)
+  {
+    if((pstTag->u08UidLength == pstDedup->tstEntries[u32Index].u08UidLength) &&
+       (0 == memcmp(pstTag->tu08Uid, pstDedup->tstEntries[u32Index].tu08Uid, pstTag->u08UidLength)))
+    {
+      pstEntry = &pstDedup->tstEntries[u32Index];
+    }
+    else if(pstDedup->tstEntries[u32Index].s64LastSeenUs < pstOldest->s64LastSeenUs)
+    {
+      pstOldest = &pstDedup->tstEntries[u32Index];
+    }
+  }
+  if(pstEntry)
+  {
+    bAccepted = ((pstTag->s64CaptureUs - pstEntry->s64LastSeenUs) >= pstDedup->s64HoldOffUs);
+  }
+  else
+  {
+    /* Entries never used have no length and are picked first */
+    bAccepted = true;
+    pstEntry = pstOldest;
+    if(pstEntry->u08UidLength &&
+       ((pstTag->s64CaptureUs - pstEntry->s64LastSeenUs) < pstDedup->s64HoldOffUs))
+    {
+      pstDedup->stStats.u32Evicted++;
+    }
+    memcpy(pstEntry->tu08Uid, pstTag->tu08Uid, pstTag->u08UidLength);
+    pstEntry->u08UidLength = pstTag->u08UidLength;
+  }
+  pstEntry->s64LastSeenUs = pstTag->s64CaptureUs;
+  if(bAccepted)
+  {
+    pstDedup->stStats.u32Accepted++;
+  }
+  else
+  {
+    pstDedup->stStats.u32Suppressed++;
+  }
+  return bAccepted;
+}
+
+void app_dedup_get_stats(app_dedup_t *pstDedup, app_dedup_stats_t *pstStats)
+{
+  if(pstDedup && pstStats)
+  {
+    memcpy(pstStats, &pstDedup->stStats, sizeof(app_dedup_stats_t));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include <string.h>
+
+#include "app_conn.h"
+#include "app_doc.h"
+
+#define APP_DOC_HEX_CHUNK_SIZE                   16
+#define APP_DOC_BASE64_CHUNK_SIZE                48
+#define APP_DOC_INTEGER_MAX_SIZE                 20
+
+#define APP_DOC_STRING_PREFIX                    "{\"stringValue\":\""
+#define APP_DOC_STRING_SUFFIX                    "\"}"
+#define APP_DOC_INTEGER_PREFIX                   "{\"integerValue\":"
+#define APP_DOC_BOOLEAN_TRUE                     "{\"booleanValue\":true}"
+#define APP_DOC_BOOLEAN_FALSE                    "{\"booleanValue\":false}"
+#define APP_DOC_BYTES_PREFIX                     "{\"bytesValue\":\""
+#define APP_DOC_NAME_PREFIX                      "\""APP_CONN_DATABASE_PATH"/"
+
+#define APP_DOC_WRITE_LITERAL(d, s)              _app_doc_write((d), (s), sizeof(s) - 1)
+
+_Static_assert(APP_DOC_MAX_DEPTH <= 8, "Empty containers are kept in a uint8_t bitmask");
+
+static const char tcHexDigits[] = "0123456789ABCDEF";
+static const char tcBase64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void app_doc_init(app_doc_t *pstDoc, char *pcBuffer, uint32_t u32Size, app_doc_write_cb_t pfWrite, void *pvArg)
+{
+  memset(pstDoc, 0x00, sizeof(app_doc_t));
+  pstDoc->pcBuffer = pcBuffer;
+  pstDoc->u32Size = u32Size;
+  pstDoc->pfWrite = pfWrite;
+  pstDoc->pvArg = pvArg;
+  pstDoc->s32Error = (pcBuffer && u32Size)?ESP_OK:ESP_ERR_INVALID_ARG;
+}
+
+/* Hand the buffered bytes to the stream, without one the document is too big */
+static void _app_doc_flush(app_doc_t *pstDoc)
+{
+  if(pstDoc->pfWrite)
+  {
+    pstDoc->s32Error = pstDoc->pfWrite(pstDoc->pcBuffer, pstDoc->u32Length, pstDoc->pvArg);
+    pstDoc->u32Flushed += pstDoc->u32Length;
+    pstDoc->u32Length = 0;
+  }
+  else
+  {
+    pstDoc->s32Error = ESP_ERR_NO_MEM;
+  }
+}
+
+static void _app_doc_write(app_doc_t *pstDoc, const char *pcData, uint32_t u32Length)
+{
+  uint32_t u32Chunk;
+
+  while((ESP_OK == pstDoc->s32Error) && u32Length)
+  {
+    if(pstDoc->u32Length == pstDoc->u32Size)
+    {
+      _app_doc_flush(pstDoc);
+    }
+    else
+    {
+      u32Chunk = pstDoc->u32Size - pstDoc->u32Length;
+      u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+      memcpy(&pstDoc->pcBuffer[pstDoc->u32Length], pcData, u32Chunk);
+      pstDoc->u32Length += u32Chunk;
+      pcData += u32Chunk;
+      u32Length -= u32Chunk;
+    }
+  }
+}
+
+/* Copy runs of plain characters at once and escape the others */
+static void _app_doc_write_escaped(app_doc_t *pstDoc, const char *pcString)
+{
+  uint32_t u32Run;
+  char tcEscape[6];
+
+  while(*pcString)
+  {
+    for(u32Run = 0;
+        ((uint8_t)pcString[u32Run] >= 0x20) && ('"' != pcString[u32Run]) && ('\\' != pcString[u32Run]);
+        u32Run++);
+    _app_doc_write(pstDoc, pcString, u32Run);
+    pcString += u32Run;
+    if(*pcString)
+    {
+      tcEscape[0] = '\\';
+      if(((uint8_t)*pcString) < 0x20)
+      {
+        tcEscape[1] = 'u';
+        tcEscape[2] = '0';
+        tcEscape[3] = '0';
+        tcEscape[4] = tcHexDigits[((uint8_t)*pcString) >> 4];
+        tcEscape[5] = tcHexDigits[((uint8_t)*pcString) & 0x0F];
+        _app_doc_write(pstDoc, tcEscape, 6);
+      }
+      else
+      {
+        tcEscape[1] = *pcString;
+        _app_doc_write(pstDoc, tcEscape, 2);
+      }
+      pcString++;
+    }
+  }
+}
+
+/* Separate from the previous member of the container and write the key if any */
+static void _app_doc_member(app_doc_t *pstDoc, const char *pcName)
+{
+  uint8_t u08Mask;
+
+  if(pstDoc->u08Depth)
+  {
+    u08Mask = 1 << (pstDoc->u08Depth - 1);
+    if(pstDoc->u08Empty & u08Mask)
+    {
+      pstDoc->u08Empty &= ~u08Mask;
+    }
+    else
+    {
+      _app_doc_write(pstDoc, ",", 1);
+    }
+  }
+  if(pcName)
+  {
+    _app_doc_write(pstDoc, "\"", 1);
+    _app_doc_write_escaped(pstDoc, pcName);
+    _app_doc_write(pstDoc, "\":", 2);
+  }
+}
+
+static void _app_doc_open(app_doc_t *pstDoc, const char *pcName, char cBracket)
+{
+  if(APP_DOC_MAX_DEPTH <= pstDoc->u08Depth)
+  {
+    pstDoc->s32Error = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    _app_doc_member(pstDoc, pcName);
+    _app_doc_write(pstDoc, &cBracket, 1);
+    pstDoc->u08Empty |= (1 << pstDoc->u08Depth);
+    pstDoc->u08Depth++;
+  }
+}
+
+static void _app_doc_close(app_doc_t *pstDoc, char cBracket)
+{
+  if(0 == pstDoc->u08Depth)
+  {
+    pstDoc->s32Error = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    pstDoc->u08Depth--;
+    pstDoc->u08Empty &= ~(1 << pstDoc->u08Depth);
+    _app_doc_write(pstDoc, &cBracket, 1);
+  }
+}
+
+void app_doc_begin_object(app_doc_t *pstDoc, const char *pcName)
+{
+  _app_doc_open(pstDoc, pcName, '{');
+}
+
+void app_doc_end_object(app_doc_t *pstDoc)
+{
+  _app_doc_close(pstDoc, '}');
+}
+
+void app_doc_begin_array(app_doc_t *pstDoc, const char *pcName)
+{
+  _app_doc_open(pstDoc, pcName, '[');
+}
+
+void app_doc_end_array(app_doc_t *pstDoc)
+{
+  _app_doc_close(pstDoc, ']');
+}
+
+/* Full resource name of a document, pcPath is relative to the database root */
+void app_doc_add_name(app_doc_t *pstDoc, const char *pcPath)
+{
+  _app_doc_member(pstDoc, "name");
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_NAME_PREFIX);
+  _app_doc_write_escaped(pstDoc, pcPath);
+  _app_doc_write(pstDoc, "\"", 1);
+}
+
+void app_doc_add_string(app_doc_t *pstDoc, const char *pcName, const char *pcValue)
+{
+  _app_doc_member(pstDoc, pcName);
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_STRING_PREFIX);
+  _app_doc_write_escaped(pstDoc, pcValue);
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_STRING_SUFFIX);
+}
+
+/* Plain JSON string for the members of a write that are not field values,
+   e.g. field paths or transforms */
+void app_doc_add_text(app_doc_t *pstDoc, const char *pcName, const char *pcValue)
+{
+  _app_doc_member(pstDoc, pcName);
+  _app_doc_write(pstDoc, "\"", 1);
+  _app_doc_write_escaped(pstDoc, pcValue);
+  _app_doc_write(pstDoc, "\"", 1);
+}
+
+/* String value holding two uppercase digits per byte, leading zeros included */
+void app_doc_add_hex(app_doc_t *pstDoc, const char *pcName, const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Index;
+  uint32_t u32Chunk;
+  char tcHex[2 * APP_DOC_HEX_CHUNK_SIZE];
+
+  _app_doc_member(pstDoc, pcName);
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_STRING_PREFIX);
+  while(u32Length)
+  {
+    u32Chunk = (u32Length < APP_DOC_HEX_CHUNK_SIZE)?u32Length:APP_DOC_HEX_CHUNK_SIZE;
+    for(u32Index = 0; u32Index < u32Chunk; u32Index++)
+    {
+      tcHex[2 * u32Index] = tcHexDigits[pu08Data[u32Index] >> 4];
+      tcHex[2 * u32Index + 1] = tcHexDigits[pu08Data[u32Index] & 0x0F];
+    }
+    _app_doc_write(pstDoc, tcHex, 2 * u32Chunk);
+    pu08Data += u32Chunk;
+    u32Length -= u32Chunk;
+  }
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_STRING_SUFFIX);
+}
+
+/* Digits are produced 9 at a time with 32 bit arithmetic, only the split of
+   values above UINT32_MAX needs the slower 64 bit division */
+void app_doc_add_integer(app_doc_t *pstDoc, const char *pcName, int64_t s64Value)
+{
+  uint32_t u32Part;
+  uint32_t u32Digits;
+  uint32_t u32Start;
+  uint64_t u64Value;
+  char tcDigits[APP_DOC_INTEGER_MAX_SIZE];
+
+  u32Start = sizeof(tcDigits);
+  u64Value = (s64Value < 0)?(0 - (uint64_t)s64Value):(uint64_t)s64Value;
+  while(u64Value > UINT32_MAX)
+  {
+    u32Part = (uint32_t)(u64Value % 1000000000ULL);
+    u64Value /= 1000000000ULL;
+    for(u32Digits = 0; u32Digits < 9; u32Digits++)
+    {
+      tcDigits[--u32Start] = '0' + (u32Part % 10);
+      u32Part /= 10;
+    }
+  }
+  u32Part = (uint32_t)u64Value;
+  do
+  {
+    tcDigits[--u32Start] = '0' + (u32Part % 10);
+    u32Part /= 10;
+  }while(u32Part);
+  if(s64Value < 0)
+  {
+    tcDigits[--u32Start] = '-';
+  }
+  _app_doc_member(pstDoc, pcName);
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_INTEGER_PREFIX);
+  _app_doc_write(pstDoc, &tcDigits[u32Start], sizeof(tcDigits) - u32Start);
+  _app_doc_write(pstDoc, "}", 1);
+}
+
+void app_doc_add_boolean(app_doc_t *pstDoc, const char *pcName, bool bValue)
+{
+  _app_doc_member(pstDoc, pcName);
+  if(bValue)
+  {
+    APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_BOOLEAN_TRUE);
+  }
+  else
+  {
+    APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_BOOLEAN_FALSE);
+  }
+}
+
+/* Bytes value, base64 encoded as Firestore expects */
+void app_doc_add_bytes(app_doc_t *pstDoc, const char *pcName, const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Index;
+  uint32_t u32Chunk;
+  uint32_t u32Group;
+  uint32_t u32Digits;
+  char tcBase64[4 * APP_DOC_BASE64_CHUNK_SIZE / 3];
+
+  _app_doc_member(pstDoc, pcName);
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_BYTES_PREFIX);
+  while(u32Length)
+  {
+    u32Chunk = (u32Length < APP_DOC_BASE64_CHUNK_SIZE)?u32Length:APP_DOC_BASE64_CHUNK_SIZE;
+    u32Digits = 0;
+    for(u32Index = 0; u32Index < u32Chunk; u32Index += 3)
+    {
+      u32Group = pu08Data[u32Index] << 16;
+      u32Group |= ((u32Index + 1) < u32Chunk)?(pu08Data[u32Index + 1] << 8):0;
+      u32Group |= ((u32Index + 2) < u32Chunk)?pu08Data[u32Index + 2]:0;
+      tcBase64[u32Digits++] = tcBase64Digits[(u32Group >> 18) & 0x3F];
+      tcBase64[u32Digits++] = tcBase64Digits[(u32Group >> 12) & 0x3F];
+      tcBase64[u32Digits++] = ((u32Index + 1) < u32Chunk)?tcBase64Digits[(u32Group >> 6) & 0x3F]:'=';
+      tcBase64[u32Digits++] = ((u32Index + 2) < u32Chunk)?tcBase64Digits[u32Group & 0x3F]:'=';
+    }
+    _app_doc_write(pstDoc, tcBase64, u32Digits);
+    pu08Data += u32Chunk;
+    u32Length -= u32Chunk;
+  }
+  APP_DOC_WRITE_LITERAL(pstDoc, APP_DOC_STRING_SUFFIX);
+}
+
+/* "fields" map of a document, filled in by the caller through pfFields */
+void app_doc_add_fields(app_doc_t *pstDoc, app_doc_fields_cb_t pfFields, const void *pvArg)
+{
+  app_doc_begin_object(pstDoc, "fields");
+  pfFields(pstDoc, pvArg);
+  app_doc_end_object(pstDoc);
+}
+
+/* Flush what's left to the stream, pu32Length receives the total document
+   length and the first error met while serializing is returned */
+esp_err_t app_doc_finish(app_doc_t *pstDoc, uint32_t *pu32Length)
+{
+  if((ESP_OK == pstDoc->s32Error) && pstDoc->u08Depth)
+  {
+    pstDoc->s32Error = ESP_ERR_INVALID_STATE;
+  }
+  if((ESP_OK == pstDoc->s32Error) && pstDoc->pfWrite && pstDoc->u32Length)
+  {
+    _app_doc_flush(pstDoc);
+  }
+  if(pu32Length)
+  {
+    *pu32Length = (ESP_OK == pstDoc->s32Error)?(pstDoc->u32Flushed + pstDoc->u32Length):0;
+  }
+  return pstDoc->s32Error;
+}
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+
+#include "app_trace.h"
+#include "app_gw.h"
+
+#define APP_GW_TAG                               "APP_GW"
+
+#ifndef APP_GW_HOST
+#define APP_GW_HOST                              "rfid-gateway.local"
+#endif
+#ifndef APP_GW_PORT
+#define APP_GW_PORT                              7030
+#endif
+#define APP_GW_TIMEOUT_MS                        5000
+
+/* Frames start with type, count and a little endian sequence number, see
+   tools/rfid_gateway.py for the other end */
+#define APP_GW_VERSION                           1
+#define APP_GW_FRAME_HELLO                       0x01
+#define APP_GW_FRAME_SCANS                       0x02
+#define APP_GW_FRAME_ACK                         0x82
+#define APP_GW_HEADER_SIZE                       4
+#define APP_GW_HELLO_SIZE                        (APP_GW_HEADER_SIZE + 7)
+#define APP_GW_ACK_SIZE                          (APP_GW_HEADER_SIZE + 1)
+/* UNIX time in ms, reader, UID length and the UID padded with zeros */
+#define APP_GW_RECORD_SIZE                       (8 + 1 + 1 + APP_GW_UID_MAX_SIZE)
+#define APP_GW_FRAME_MAX_SIZE                    (APP_GW_HEADER_SIZE + APP_GW_MAX_RECORDS * APP_GW_RECORD_SIZE)
+
+_Static_assert(APP_GW_MAX_RECORDS <= UINT8_MAX, "Record count is sent in one byte");
+
+typedef struct
+{
+  int s32Socket;
+  uint32_t u32Count;
+  uint16_t u16Sequence;
+  app_gw_stats_t stStats;
+  uint8_t tu08Frame[APP_GW_FRAME_MAX_SIZE];
+}gw_ctx_t;
+
+static gw_ctx_t stCtx =
+{
+  .s32Socket = -1,
+};
+
+static void _app_gw_put_header(uint8_t *pu08Buffer, uint8_t u08Type, uint8_t u08Count, uint16_t u16Sequence)
+{
+  pu08Buffer[0] = u08Type;
+  pu08Buffer[1] = u08Count;
+  pu08Buffer[2] = (uint8_t)u16Sequence;
+  pu08Buffer[3] = (uint8_t)(u16Sequence >> 8);
+}
+
+static esp_err_t _app_gw_send_all(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  int s32Sent;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_OK;
+  while((ESP_OK == s32RetVal) && u32Length)
+  {
+    s32Sent = send(stCtx.s32Socket, pu08Data, u32Length, 0);
+    if(s32Sent > 0)
+    {
+      pu08Data += s32Sent;
+      u32Length -= s32Sent;
+      stCtx.stStats.u32BytesSent += s32Sent;
+    }
+    else
+    {
+      ESP_LOGW(APP_GW_TAG, "Send failed, errno: %d", errno);
+      s32RetVal = ESP_FAIL;
+    }
+  }
+  return s32RetVal;
+}
+
+static esp_err_t _app_gw_receive_all(uint8_t *pu08Data, uint32_t u32Length)
+{
+  int s32Received;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_OK;
+  while((ESP_OK == s32RetVal) && u32Length)
+  {
+    s32Received = recv(stCtx.s32Socket, pu08Data, u32Length, 0);
+    if(s32Received > 0)
+    {
+      pu08Data += s32Received;
+      u32Length -= s32Received;
+    }
+    else
+    {
+      ESP_LOGW(APP_GW_TAG, "Receive failed, errno: %d", s32Received?errno:0);
+      s32RetVal = (0 == s32Received)?ESP_ERR_INVALID_STATE:ESP_ERR_TIMEOUT;
+    }
+  }
+  return s32RetVal;
+}
+
+static void _app_gw_close(void)
+{
+  if(stCtx.s32Socket >= 0)
+  {
+    close(stCtx.s32Socket);
+    stCtx.s32Socket = -1;
+  }
+}
+
+/* Non blocking connect so an unreachable gateway only costs APP_GW_TIMEOUT_MS */
+static esp_err_t _app_gw_connect_socket(const struct addrinfo *pstAddress)
+{
+  int s32Error;
+  int s32Enable;
+  socklen_t u32Size;
+  fd_set stWriteSet;
+  esp_err_t s32RetVal;
+  struct timeval stTimeout;
+
+  s32RetVal = ESP_FAIL;
+  stTimeout.tv_sec = APP_GW_TIMEOUT_MS / 1000;
+  stTimeout.tv_usec = (APP_GW_TIMEOUT_MS % 1000) * 1000;
+  stCtx.s32Socket = socket(pstAddress->ai_family, pstAddress->ai_socktype, pstAddress->ai_protocol);
+  if(stCtx.s32Socket >= 0)
+  {
+    fcntl(stCtx.s32Socket, F_SETFL, O_NONBLOCK);
+    if((0 == connect(stCtx.s32Socket, pstAddress->ai_addr, pstAddress->ai_addrlen)) || (EINPROGRESS == errno))
+    {
+      FD_ZERO(&stWriteSet);
+      FD_SET(stCtx.s32Socket, &stWriteSet);
+      s32Error = -1;
+      u32Size = sizeof(s32Error);
+      if((select(stCtx.s32Socket + 1, NULL, &stWriteSet, NULL, &stTimeout) > 0) &&
+         (0 == getsockopt(stCtx.s32Socket, SOL_SOCKET, SO_ERROR, &s32Error, &u32Size)) &&
+         (0 == s32Error))
+      {
+        s32RetVal = ESP_OK;
+      }
+    }
+    fcntl(stCtx.s32Socket, F_SETFL, 0);
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    /* Frames are small and acknowledged one at a time, don't let Nagle hold them */
+    s32Enable = 1;
+    setsockopt(stCtx.s32Socket, IPPROTO_TCP, TCP_NODELAY, &s32Enable, sizeof(s32Enable));
+    setsockopt(stCtx.s32Socket, SOL_SOCKET, SO_KEEPALIVE, &s32Enable, sizeof(s32Enable));
+    setsockopt(stCtx.s32Socket, SOL_SOCKET, SO_RCVTIMEO, &stTimeout, sizeof(stTimeout));
+    setsockopt(stCtx.s32Socket, SOL_SOCKET, SO_SNDTIMEO, &stTimeout, sizeof(stTimeout));
+  }
+  else
+  {
+    _app_gw_close();
+  }
+  return s32RetVal;
+}
+
+/* Open the connection and introduce the node by its station MAC address */
+static esp_err_t _app_gw_connect(void)
+{
+  esp_err_t s32RetVal;
+  char tcPort[6];
+  uint8_t tu08Hello[APP_GW_HELLO_SIZE];
+  struct addrinfo *pstResult;
+  struct addrinfo stHints =
+  {
+    .ai_family = AF_INET,
+    .ai_socktype = SOCK_STREAM,
+  };
+
+  snprintf(tcPort, sizeof(tcPort), "%d", APP_GW_PORT);
+  if((0 != getaddrinfo(APP_GW_HOST, tcPort, &stHints, &pstResult)) || (NULL == pstResult))
+  {
+    ESP_LOGW(APP_GW_TAG, "Failed to resolve %s", APP_GW_HOST);
+    s32RetVal = ESP_ERR_NOT_FOUND;
+  }
+  else
+  {
+    s32RetVal = _app_gw_connect_socket(pstResult);
+    freeaddrinfo(pstResult);
+    if(ESP_OK == s32RetVal)
+    {
+      _app_gw_put_header(tu08Hello, APP_GW_FRAME_HELLO, 0, 0);
+      tu08Hello[APP_GW_HEADER_SIZE] = APP_GW_VERSION;
+      esp_read_mac(&tu08Hello[APP_GW_HEADER_SIZE + 1], ESP_MAC_WIFI_STA);
+      s32RetVal = _app_gw_send_all(tu08Hello, sizeof(tu08Hello));
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      stCtx.stStats.u32Connects++;
+      ESP_LOGI(APP_GW_TAG, "Connected to gateway %s:%d", APP_GW_HOST, APP_GW_PORT);
+    }
+    else
+    {
+      ESP_LOGW(APP_GW_TAG, "Failed to connect to gateway %s:%d", APP_GW_HOST, APP_GW_PORT);
+      _app_gw_close();
+    }
+  }
+  return s32RetVal;
+}
+
+/* Append one scan to the pending frame, s64TimestampMs is 0 when unknown and
+   the gateway then stamps the scan with its reception time */
+esp_err_t app_gw_add(uint8_t u08ReaderId, const uint8_t *pu08Uid, uint8_t u08UidLength, int64_t s64TimestampMs)
+{
+  uint32_t u32Byte;
+  esp_err_t s32RetVal;
+  uint8_t *pu08Record;
+
+  if((NULL == pu08Uid) || (u08UidLength > APP_GW_UID_MAX_SIZE))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else if(APP_GW_MAX_RECORDS <= stCtx.u32Count)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    pu08Record = &stCtx.tu08Frame[APP_GW_HEADER_SIZE + stCtx.u32Count * APP_GW_RECORD_SIZE];
+    for(u32Byte = 0; u32Byte < 8; u32Byte++)
+    {
+      pu08Record[u32Byte] = (uint8_t)((uint64_t)s64TimestampMs >> (8 * u32Byte));
+    }
+    pu08Record[8] = u08ReaderId;
+    pu08Record[9] = u08UidLength;
+    memset(&pu08Record[10], 0x00, APP_GW_UID_MAX_SIZE);
+    memcpy(&pu08Record[10], pu08Uid, u08UidLength);
+    stCtx.u32Count++;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* Network phases are timed with esp_timer, the cycle counter wraps after a few
+   seconds. The next phase starts where this one ends */
+static void _app_gw_end_phase(int64_t *ps64PhaseUs, app_trace_point_t ePoint)
+{
+  int64_t s64NowUs;
+
+  s64NowUs = esp_timer_get_time();
+  app_trace_record_us(ePoint, s64NowUs - *ps64PhaseUs);
+  *ps64PhaseUs = s64NowUs;
+}
+
+/* Send the pending frame and wait until the gateway acknowledges that it
+   stored the scans, they are dropped either way like a failed batch commit */
+esp_err_t app_gw_commit(void)
+{
+  int64_t s64PhaseUs;
+  int64_t s64RequestUs;
+  esp_err_t s32RetVal;
+  uint8_t tu08Ack[APP_GW_ACK_SIZE];
+  uint16_t u16Sequence;
+
+  if(0 == stCtx.u32Count)
+  {
+    s32RetVal = ESP_OK;
+  }
+  else
+  {
+    s64RequestUs = esp_timer_get_time();
+    s64PhaseUs = s64RequestUs;
+    s32RetVal = ESP_OK;
+    if(stCtx.s32Socket < 0)
+    {
+      s32RetVal = _app_gw_connect();
+      _app_gw_end_phase(&s64PhaseUs, APP_TRACE_CONNECT);
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      u16Sequence = ++stCtx.u16Sequence;
+      _app_gw_put_header(stCtx.tu08Frame, APP_GW_FRAME_SCANS, stCtx.u32Count, u16Sequence);
+      s32RetVal = _app_gw_send_all(stCtx.tu08Frame, APP_GW_HEADER_SIZE + stCtx.u32Count * APP_GW_RECORD_SIZE);
+      _app_gw_end_phase(&s64PhaseUs, APP_TRACE_SEND);
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = _app_gw_receive_all(tu08Ack, sizeof(tu08Ack));
+      _app_gw_end_phase(&s64PhaseUs, APP_TRACE_WAIT);
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      if((APP_GW_FRAME_ACK != tu08Ack[0]) ||
+         (u16Sequence != (tu08Ack[2] | (tu08Ack[3] << 8))))
+      {
+        ESP_LOGE(APP_GW_TAG, "Unexpected answer from the gateway");
+        s32RetVal = ESP_ERR_INVALID_RESPONSE;
+      }
+      else if(0 != tu08Ack[APP_GW_HEADER_SIZE])
+      {
+        /* Gateway is fine but couldn't store the scans, keep the connection */
+        ESP_LOGE(APP_GW_TAG, "Gateway failed to store scans, status: %d", tu08Ack[APP_GW_HEADER_SIZE]);
+        s32RetVal = ESP_FAIL;
+      }
+      else
+      {
+        ESP_LOGI(APP_GW_TAG,
+                 "Sent %d scans in %d bytes",
+                 stCtx.u32Count,
+                 APP_GW_HEADER_SIZE + stCtx.u32Count * APP_GW_RECORD_SIZE);
+        stCtx.stStats.u32Frames++;
+        stCtx.stStats.u32Records += stCtx.u32Count;
+      }
+    }
+    app_trace_record_us(APP_TRACE_REQUEST, esp_timer_get_time() - s64RequestUs);
+    if(ESP_OK != s32RetVal)
+    {
+      stCtx.stStats.u32Failures++;
+      if(ESP_FAIL != s32RetVal)
+      {
+        _app_gw_close();
+      }
+    }
+    stCtx.u32Count = 0;
+  }
+  return s32RetVal;
+}
+
+void app_gw_get_stats(app_gw_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_gw_stats_t));
+  }
+}
\ No newline at end of file
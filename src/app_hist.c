@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "app_hist.h"
+
+static uint32_t _app_hist_bucket(uint32_t u32Value)
+{
+  uint32_t u32Msb;
+  uint32_t u32Bucket;
+
+  if(u32Value < APP_HIST_SUB_BUCKETS)
+  {
+    u32Bucket = u32Value;
+  }
+  else
+  {
+    u32Msb = 31 - __builtin_clz(u32Value);
+    u32Bucket = APP_HIST_SUB_BUCKETS * (u32Msb - APP_HIST_SUB_BUCKET_BITS + 1) +
+                ((u32Value >> (u32Msb - APP_HIST_SUB_BUCKET_BITS)) & (APP_HIST_SUB_BUCKETS - 1));
+  }
+  return u32Bucket;
+}
+
+void app_hist_reset(app_hist_t *pstHist)
+{
+  memset(pstHist, 0x00, sizeof(app_hist_t));
+}
+
+void app_hist_record(app_hist_t *pstHist, uint32_t u32Value)
+{
+  pstHist->tu32Buckets[_app_hist_bucket(u32Value)]++;
+  pstHist->u32Max = (u32Value > pstHist->u32Max)?u32Value:pstHist->u32Max;
+  pstHist->u32Count++;
+}
+
+/* Upper limit of the bucket holding the given percentile, 0 when empty */
+uint32_t app_hist_percentile(const app_hist_t *pstHist, uint32_t u32Percent)
+{
+  uint32_t u32Bucket;
+  uint32_t u32Count;
+  uint32_t u32Rank;
+
+  u32Count = 0;
+  u32Rank = ((pstHist->u32Count * u32Percent) + 99) / 100;
+  for(u32Bucket = 0; (u32Bucket < APP_HIST_BUCKETS) && (u32Count < u32Rank); u32Bucket++)
+  {
+    u32Count += pstHist->tu32Buckets[u32Bucket];
+  }
+  return u32Count?app_hist_bucket_limit(u32Bucket - 1):0;
+}
+
+/* Largest value that falls in a bucket */
+uint32_t app_hist_bucket_limit(uint32_t u32Bucket)
+{
+  uint32_t u32Shift;
+  uint32_t u32Limit;
+
+  if(u32Bucket < APP_HIST_SUB_BUCKETS)
+  {
+    u32Limit = u32Bucket;
+  }
+  else
+  {
+    u32Shift = (u32Bucket / APP_HIST_SUB_BUCKETS) - 1;
+    u32Limit = ((APP_HIST_SUB_BUCKETS + (u32Bucket % APP_HIST_SUB_BUCKETS) + 1) << u32Shift) - 1;
+  }
+  return u32Limit;
+}
\ No newline at end of file
@@ -0,0 +1,425 @@
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+
+#include "app_index.h"
+
+#define APP_INDEX_TAG                            "APP_INDEX"
+
+#define APP_INDEX_PARTITION_SUBTYPE              0x41
+#define APP_INDEX_PARTITION_LABEL                "tagindex"
+#define APP_INDEX_MAGIC                          0x58444954 /* "TIDX" */
+#define APP_INDEX_VERSION                        1
+
+/* Slot states only ever clear bits so slots can be filled or deleted in place */
+#define APP_INDEX_STATE_EMPTY                    0xFF
+#define APP_INDEX_STATE_VALID                    0xFE
+#define APP_INDEX_STATE_DELETED                  0x00
+
+#define APP_INDEX_FNV_OFFSET_BASIS               2166136261UL
+#define APP_INDEX_FNV_PRIME                      16777619UL
+
+/* Layout shared with tools/tag_index_builder.py */
+typedef struct __attribute__((packed))
+{
+  uint32_t u32Magic;
+  uint16_t u16Version;
+  uint16_t u16SlotSize;
+  uint32_t u32SlotCount;
+  uint32_t u32EntryCount;
+  uint32_t u32Seed;
+  uint8_t tu08Reserved[12];
+}index_header_t;
+
+typedef struct __attribute__((packed))
+{
+  uint8_t u08State;
+  uint8_t u08UidLength;
+  uint8_t tu08Uid[APP_INDEX_UID_MAX_SIZE];
+  uint32_t u32Flags;
+}index_slot_t;
+
+_Static_assert(sizeof(index_header_t) == 32, "index_header_t must stay 32 bytes");
+_Static_assert(sizeof(index_slot_t) == 16, "index_slot_t must stay 16 bytes");
+
+/* Looked up from other tasks while the sync task updates the index in place,
+   every access to the mapping goes through the mutex */
+typedef struct
+{
+  SemaphoreHandle_t stMutex;
+  const esp_partition_t *pstPartition;
+  spi_flash_mmap_handle_t u32MmapHandle;
+  const void *pvMap;
+  const index_header_t *pstHeader;
+  const index_slot_t *pstSlots;
+  uint32_t u32Mask;
+  uint32_t u32Count;
+}index_ctx_t;
+
+static index_ctx_t stCtx;
+
+static uint32_t _app_index_hash(const uint8_t *pu08Uid, uint8_t u08UidLength, uint32_t u32Seed)
+{
+  uint8_t u08Index;
+  uint32_t u32Hash;
+
+  u32Hash = APP_INDEX_FNV_OFFSET_BASIS ^ u32Seed;
+  for(u08Index = 0; u08Index < u08UidLength; u08Index++)
+  {
+    u32Hash ^= pu08Uid[u08Index];
+    u32Hash *= APP_INDEX_FNV_PRIME;
+  }
+  return u32Hash;
+}
+
+/* ESP_ERR_TIMEOUT while the sync task holds the index past the wait */
+static esp_err_t _app_index_lock(TickType_t u32WaitTicks)
+{
+  esp_err_t s32RetVal;
+
+  if(NULL == stCtx.stMutex)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    s32RetVal = (pdTRUE == xSemaphoreTake(stCtx.stMutex, u32WaitTicks))?ESP_OK:ESP_ERR_TIMEOUT;
+  }
+  return s32RetVal;
+}
+
+/* Validate the mapped header and count the live entries */
+static esp_err_t _app_index_attach(void)
+{
+  uint32_t u32Slot;
+  esp_err_t s32RetVal;
+  const index_header_t *pstHeader;
+
+  pstHeader = (const index_header_t *)stCtx.pvMap;
+  stCtx.pstHeader = NULL;
+  if((APP_INDEX_MAGIC != pstHeader->u32Magic) ||
+     (APP_INDEX_VERSION != pstHeader->u16Version) ||
+     (sizeof(index_slot_t) != pstHeader->u16SlotSize) ||
+     (0 == pstHeader->u32SlotCount) ||
+     (pstHeader->u32SlotCount & (pstHeader->u32SlotCount - 1)) ||
+     ((sizeof(index_header_t) + pstHeader->u32SlotCount * sizeof(index_slot_t)) > stCtx.pstPartition->size))
+  {
+    ESP_LOGW(APP_INDEX_TAG, "Tag index partition doesn't hold a valid index");
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    stCtx.pstHeader = pstHeader;
+    stCtx.pstSlots = (const index_slot_t *)((const uint8_t *)stCtx.pvMap + sizeof(index_header_t));
+    stCtx.u32Mask = pstHeader->u32SlotCount - 1;
+    /* The header count is fixed at build time, entries are updated in place since */
+    stCtx.u32Count = 0;
+    for(u32Slot = 0; u32Slot < pstHeader->u32SlotCount; u32Slot++)
+    {
+      if(APP_INDEX_STATE_VALID == stCtx.pstSlots[u32Slot].u08State)
+      {
+        stCtx.u32Count++;
+      }
+    }
+    ESP_LOGI(APP_INDEX_TAG,
+             "Tag index ready: %d entries in %d slots",
+             stCtx.u32Count,
+             pstHeader->u32SlotCount);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* Map the index through the flash cache, nothing but the mapping is kept in RAM */
+esp_err_t app_index_init(void)
+{
+  esp_err_t s32RetVal;
+
+  memset(&stCtx, 0x00, sizeof(stCtx));
+  stCtx.stMutex = xSemaphoreCreateMutex();
+  stCtx.pstPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                APP_INDEX_PARTITION_SUBTYPE,
+                                                APP_INDEX_PARTITION_LABEL);
+  if(NULL == stCtx.stMutex)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else if(NULL == stCtx.pstPartition)
+  {
+    ESP_LOGE(APP_INDEX_TAG, "Tag index partition not found");
+    s32RetVal = ESP_ERR_NOT_FOUND;
+  }
+  else if(ESP_OK != (s32RetVal = esp_partition_mmap(stCtx.pstPartition,
+                                                    0,
+                                                    stCtx.pstPartition->size,
+                                                    SPI_FLASH_MMAP_DATA,
+                                                    &stCtx.pvMap,
+                                                    &stCtx.u32MmapHandle)))
+  {
+    ESP_LOGE(APP_INDEX_TAG, "Failed to map tag index: %s", esp_err_to_name(s32RetVal));
+  }
+  else
+  {
+    s32RetVal = _app_index_attach();
+  }
+  return s32RetVal;
+}
+
+/* Erase the partition and lay out an empty index using as many slots as fit */
+esp_err_t app_index_format(void)
+{
+  esp_err_t s32RetVal;
+  index_header_t stHeader;
+
+  if(ESP_OK != (s32RetVal = _app_index_lock(portMAX_DELAY)))
+  {
+    ESP_LOGE(APP_INDEX_TAG, "Tag index is not initialized");
+  }
+  else if(NULL == stCtx.pvMap)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  else
+  {
+    memset(&stHeader, 0x00, sizeof(stHeader));
+    stHeader.u32Magic = APP_INDEX_MAGIC;
+    stHeader.u16Version = APP_INDEX_VERSION;
+    stHeader.u16SlotSize = sizeof(index_slot_t);
+    stHeader.u32SlotCount = 1;
+    while((sizeof(index_header_t) + 2 * stHeader.u32SlotCount * sizeof(index_slot_t)) <= stCtx.pstPartition->size)
+    {
+      stHeader.u32SlotCount *= 2;
+    }
+    stCtx.pstHeader = NULL;
+    s32RetVal = esp_partition_erase_range(stCtx.pstPartition, 0, stCtx.pstPartition->size);
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = esp_partition_write(stCtx.pstPartition, 0, &stHeader, sizeof(stHeader));
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = _app_index_attach();
+    }
+    else
+    {
+      ESP_LOGE(APP_INDEX_TAG, "Failed to format tag index: %s", esp_err_to_name(s32RetVal));
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return s32RetVal;
+}
+
+/* Open addressing with linear probing, an empty slot ends the probe sequence
+   and deleted slots are skipped */
+static const index_slot_t *_app_index_find(const uint8_t *pu08Uid, uint8_t u08UidLength, uint32_t *pu32Empty)
+{
+  uint32_t u32Slot;
+  uint32_t u32Probes;
+  const index_slot_t *pstSlot;
+  const index_slot_t *pstFound;
+
+  pstFound = NULL;
+  *pu32Empty = UINT32_MAX;
+  u32Slot = _app_index_hash(pu08Uid, u08UidLength, stCtx.pstHeader->u32Seed) & stCtx.u32Mask;
+  for(u32Probes = 0; u32Probes <= stCtx.u32Mask; u32Probes++)
+  {
+    pstSlot = &stCtx.pstSlots[u32Slot];
+    if(APP_INDEX_STATE_EMPTY == pstSlot->u08State)
+    {
+      *pu32Empty = u32Slot;
+      break;
+    }
+    if((APP_INDEX_STATE_VALID == pstSlot->u08State) &&
+       (u08UidLength == pstSlot->u08UidLength) &&
+       (0 == memcmp(pu08Uid, pstSlot->tu08Uid, u08UidLength)))
+    {
+      pstFound = pstSlot;
+      break;
+    }
+    u32Slot = (u32Slot + 1) & stCtx.u32Mask;
+  }
+  return pstFound;
+}
+
+static esp_err_t _app_index_check_args(const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  esp_err_t s32RetVal;
+
+  if((NULL == pu08Uid) || (0 == u08UidLength) || (u08UidLength > APP_INDEX_UID_MAX_SIZE))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else if(NULL == stCtx.pstHeader)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+static esp_err_t _app_index_write_state(const index_slot_t *pstSlot, uint8_t u08State)
+{
+  return esp_partition_write(stCtx.pstPartition,
+                             (const uint8_t *)pstSlot - (const uint8_t *)stCtx.pvMap,
+                             &u08State,
+                             sizeof(u08State));
+}
+
+/* A format holds the index for seconds, callers that can't wait that long
+   give a shorter wait and get ESP_ERR_TIMEOUT */
+esp_err_t app_index_lookup(const uint8_t *pu08Uid, uint8_t u08UidLength, uint32_t *pu32Flags, TickType_t u32WaitTicks)
+{
+  uint32_t u32Empty;
+  esp_err_t s32RetVal;
+  const index_slot_t *pstSlot;
+
+  if(ESP_OK == (s32RetVal = _app_index_lock(u32WaitTicks)))
+  {
+    if(ESP_OK == (s32RetVal = _app_index_check_args(pu08Uid, u08UidLength)))
+    {
+      pstSlot = _app_index_find(pu08Uid, u08UidLength, &u32Empty);
+      if(pstSlot)
+      {
+        if(pu32Flags)
+        {
+          *pu32Flags = pstSlot->u32Flags;
+        }
+      }
+      else
+      {
+        s32RetVal = ESP_ERR_NOT_FOUND;
+      }
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return s32RetVal;
+}
+
+static bool _app_index_is_blank(const index_slot_t *pstSlot)
+{
+  uint8_t u08Index;
+  bool bBlank;
+
+  bBlank = true;
+  for(u08Index = 0; bBlank && (u08Index < sizeof(index_slot_t)); u08Index++)
+  {
+    bBlank = (0xFF == ((const uint8_t *)pstSlot)[u08Index]);
+  }
+  return bBlank;
+}
+
+/* Fill an empty slot in place: the body is written first and the state byte
+   last so a torn write never shows up as a valid entry */
+esp_err_t app_index_insert(const uint8_t *pu08Uid, uint8_t u08UidLength, uint32_t u32Flags)
+{
+  uint32_t u32Empty;
+  esp_err_t s32RetVal;
+  index_slot_t stSlot;
+  const index_slot_t *pstSlot;
+
+  if(ESP_OK == (s32RetVal = _app_index_lock(portMAX_DELAY)))
+  {
+    if(ESP_OK == (s32RetVal = _app_index_check_args(pu08Uid, u08UidLength)))
+    {
+      pstSlot = _app_index_find(pu08Uid, u08UidLength, &u32Empty);
+      if(pstSlot && (u32Flags == pstSlot->u32Flags))
+      {
+        ESP_LOGD(APP_INDEX_TAG, "Tag is already in the index");
+      }
+      else
+      {
+        /* Flags can't be rewritten without an erase, retire the old entry */
+        if(pstSlot && (ESP_OK == _app_index_write_state(pstSlot, APP_INDEX_STATE_DELETED)))
+        {
+          stCtx.u32Count--;
+          _app_index_find(pu08Uid, u08UidLength, &u32Empty);
+        }
+        memset(&stSlot, 0xFF, sizeof(stSlot));
+        stSlot.u08UidLength = u08UidLength;
+        memcpy(stSlot.tu08Uid, pu08Uid, u08UidLength);
+        stSlot.u32Flags = u32Flags;
+        s32RetVal = ESP_ERR_NO_MEM;
+        while((ESP_ERR_NO_MEM == s32RetVal) && (UINT32_MAX != u32Empty))
+        {
+          pstSlot = &stCtx.pstSlots[u32Empty];
+          if(!_app_index_is_blank(pstSlot))
+          {
+            /* Left over from a torn write, retire it and keep probing */
+            _app_index_write_state(pstSlot, APP_INDEX_STATE_DELETED);
+            _app_index_find(pu08Uid, u08UidLength, &u32Empty);
+          }
+          else if(ESP_OK == (s32RetVal = esp_partition_write(stCtx.pstPartition,
+                                                             (const uint8_t *)pstSlot - (const uint8_t *)stCtx.pvMap + 1,
+                                                             (const uint8_t *)&stSlot + 1,
+                                                             sizeof(index_slot_t) - 1)))
+          {
+            s32RetVal = _app_index_write_state(pstSlot, APP_INDEX_STATE_VALID);
+            stCtx.u32Count += (ESP_OK == s32RetVal)?1:0;
+          }
+        }
+        if(ESP_ERR_NO_MEM == s32RetVal)
+        {
+          ESP_LOGE(APP_INDEX_TAG, "Tag index is full");
+        }
+      }
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return s32RetVal;
+}
+
+esp_err_t app_index_remove(const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  uint32_t u32Empty;
+  esp_err_t s32RetVal;
+  const index_slot_t *pstSlot;
+
+  if(ESP_OK == (s32RetVal = _app_index_lock(portMAX_DELAY)))
+  {
+    if(ESP_OK == (s32RetVal = _app_index_check_args(pu08Uid, u08UidLength)))
+    {
+      pstSlot = _app_index_find(pu08Uid, u08UidLength, &u32Empty);
+      if(pstSlot && (ESP_OK == (s32RetVal = _app_index_write_state(pstSlot, APP_INDEX_STATE_DELETED))))
+      {
+        stCtx.u32Count--;
+      }
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return s32RetVal;
+}
+
+bool app_index_is_valid(void)
+{
+  bool bValid;
+
+  bValid = false;
+  if(ESP_OK == _app_index_lock(portMAX_DELAY))
+  {
+    bValid = (NULL != stCtx.pstHeader);
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return bValid;
+}
+
+uint32_t app_index_get_count(void)
+{
+  uint32_t u32Count;
+
+  u32Count = 0;
+  if(ESP_OK == _app_index_lock(portMAX_DELAY))
+  {
+    u32Count = stCtx.u32Count;
+    xSemaphoreGive(stCtx.stMutex);
+  }
+  return u32Count;
+}
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp32/rom/crc.h>
+
+#include "app_journal.h"
+
+#define APP_JOURNAL_TAG                          "APP_JOURNAL"
+
+#define APP_JOURNAL_PARTITION_SUBTYPE            0x40
+#define APP_JOURNAL_PARTITION_LABEL              "journal"
+#define APP_JOURNAL_SLOTS_PER_SECTOR             (SPI_FLASH_SEC_SIZE / sizeof(journal_slot_t))
+#define APP_JOURNAL_READ_CHUNK_SLOTS             8
+
+/* Slot states only ever clear bits so they can be updated without an erase */
+#define APP_JOURNAL_STATE_ERASED                 0xFF
+#define APP_JOURNAL_STATE_VALID                  0xFE
+#define APP_JOURNAL_STATE_REPLAYED               0xFC
+
+#define APP_JOURNAL_NO_CAPTURE                   UINT32_MAX
+/* The reader index lives in the high nibble of the UID length byte, records
+   written before readers were numbered read back as reader 0 */
+#define APP_JOURNAL_LENGTH_MASK                  0x0F
+#define APP_JOURNAL_READER_SHIFT                 4
+
+/* On-flash record, the state byte and the crc are excluded from the crc */
+typedef struct __attribute__((packed))
+{
+  uint8_t u08State;
+  uint8_t u08ReaderUidLength;
+  uint8_t tu08Uid[APP_JOURNAL_UID_MAX_SIZE];
+  uint32_t u32Sequence;
+  int64_t s64Timestamp;
+  /* Low 32 bits of the capture time in ms, only valid during the same boot */
+  uint32_t u32CaptureMs;
+  uint32_t u32Crc;
+}journal_slot_t;
+
+_Static_assert(sizeof(journal_slot_t) == 32, "journal_slot_t must stay 32 bytes");
+_Static_assert(APP_JOURNAL_UID_MAX_SIZE <= APP_JOURNAL_LENGTH_MASK, "UID length doesn't fit in its nibble");
+
+typedef struct
+{
+  const esp_partition_t *pstPartition;
+  uint32_t u32SlotCount;
+  uint32_t u32Head;
+  uint32_t u32Tail;
+  uint32_t u32Count;
+  uint32_t u32ReplayCursor;
+  uint32_t u32NextSequence;
+  uint32_t u32BootSequence;
+  app_journal_stats_t stStats;
+}journal_ctx_t;
+
+static journal_ctx_t stCtx;
+
+static uint32_t _app_journal_crc(const journal_slot_t *pstSlot)
+{
+  return crc32_le(0,
+                  (const uint8_t *)pstSlot + 1,
+                  sizeof(journal_slot_t) - 1 - sizeof(pstSlot->u32Crc));
+}
+
+static bool _app_journal_is_valid(const journal_slot_t *pstSlot)
+{
+  return ((APP_JOURNAL_STATE_VALID == pstSlot->u08State) ||
+          (APP_JOURNAL_STATE_REPLAYED == pstSlot->u08State)) &&
+         (pstSlot->u32Crc == _app_journal_crc(pstSlot));
+}
+
+/* Capture times are only meaningful for records appended since boot, the
+   stored 32 bits are extended against the current time */
+static int64_t _app_journal_capture_us(const journal_slot_t *pstSlot)
+{
+  int64_t s64NowMs;
+  int64_t s64CaptureUs;
+
+  if((APP_JOURNAL_NO_CAPTURE != pstSlot->u32CaptureMs) &&
+     ((pstSlot->u32Sequence - stCtx.u32BootSequence) < (stCtx.u32NextSequence - stCtx.u32BootSequence)))
+  {
+    s64NowMs = esp_timer_get_time() / 1000LL;
+    s64CaptureUs = (s64NowMs - (uint32_t)((uint32_t)s64NowMs - pstSlot->u32CaptureMs)) * 1000LL;
+  }
+  else
+  {
+    s64CaptureUs = 0;
+  }
+  return s64CaptureUs;
+}
+
+static esp_err_t _app_journal_read(uint32_t u32Slot, journal_slot_t *pstSlots, uint32_t u32Count)
+{
+  return esp_partition_read(stCtx.pstPartition,
+                            u32Slot * sizeof(journal_slot_t),
+                            pstSlots,
+                            u32Count * sizeof(journal_slot_t));
+}
+
+/* Sequence number of the first intact record of a sector, false if the sector is empty */
+static bool _app_journal_sector_sequence(uint32_t u32Sector, uint32_t *pu32Sequence)
+{
+  bool bFound;
+  uint32_t u32Index;
+  journal_slot_t stSlot;
+
+  bFound = false;
+  for(u32Index = 0; (u32Index < APP_JOURNAL_SLOTS_PER_SECTOR) && !bFound; u32Index++)
+  {
+    if(ESP_OK != _app_journal_read(u32Sector * APP_JOURNAL_SLOTS_PER_SECTOR + u32Index, &stSlot, 1))
+    {
+      break;
+    }
+    if(APP_JOURNAL_STATE_ERASED == stSlot.u08State)
+    {
+      break;
+    }
+    if(_app_journal_is_valid(&stSlot))
+    {
+      *pu32Sequence = stSlot.u32Sequence;
+      bFound = true;
+    }
+  }
+  return bFound;
+}
+
+/* Make the sector starting at the head writable: unread records still living in
+   it are dropped so the head sector never holds anything but new records */
+static esp_err_t _app_journal_prepare_sector(void)
+{
+  uint32_t u32SectorEnd;
+  esp_err_t s32RetVal;
+  journal_slot_t stSlot;
+
+  u32SectorEnd = stCtx.u32Head + APP_JOURNAL_SLOTS_PER_SECTOR;
+  if(stCtx.u32Count &&
+     ((stCtx.u32Tail / APP_JOURNAL_SLOTS_PER_SECTOR) == (stCtx.u32Head / APP_JOURNAL_SLOTS_PER_SECTOR)))
+  {
+    ESP_LOGW(APP_JOURNAL_TAG, "Journal is full --> dropping %d oldest records", u32SectorEnd - stCtx.u32Tail);
+    stCtx.stStats.u32Dropped += u32SectorEnd - stCtx.u32Tail;
+    stCtx.u32Count -= u32SectorEnd - stCtx.u32Tail;
+    stCtx.u32Tail = u32SectorEnd % stCtx.u32SlotCount;
+    stCtx.u32ReplayCursor = stCtx.u32Tail;
+  }
+  s32RetVal = _app_journal_read(stCtx.u32Head, &stSlot, 1);
+  if((ESP_OK == s32RetVal) && (APP_JOURNAL_STATE_ERASED != stSlot.u08State))
+  {
+    s32RetVal = esp_partition_erase_range(stCtx.pstPartition,
+                                          stCtx.u32Head * sizeof(journal_slot_t),
+                                          SPI_FLASH_SEC_SIZE);
+  }
+  return s32RetVal;
+}
+
+/* Rebuild head and tail from flash: the head follows the newest record and the
+   tail follows the newest record marked as replayed */
+static void _app_journal_recover(void)
+{
+  uint32_t u32Slot;
+  uint32_t u32Sector;
+  uint32_t u32Sequence;
+  uint32_t u32HeadSector;
+  uint32_t u32SectorCount;
+  uint32_t u32OldestSector;
+  uint32_t u32OldestSequence;
+  uint32_t u32NewestSequence;
+  journal_slot_t stSlot;
+
+  stCtx.u32Head = 0;
+  stCtx.u32Tail = 0;
+  stCtx.u32NextSequence = 0;
+  u32HeadSector = 0;
+  u32NewestSequence = 0;
+  u32SectorCount = stCtx.u32SlotCount / APP_JOURNAL_SLOTS_PER_SECTOR;
+  for(u32Sector = 0; u32Sector < u32SectorCount; u32Sector++)
+  {
+    if(_app_journal_sector_sequence(u32Sector, &u32Sequence) && (u32Sequence >= u32NewestSequence))
+    {
+      u32NewestSequence = u32Sequence;
+      u32HeadSector = u32Sector;
+      stCtx.u32NextSequence = u32Sequence + 1;
+    }
+  }
+  if(stCtx.u32NextSequence)
+  {
+    /* Head is right after the last written slot of the newest sector, torn
+       writes are skipped since they can't be rewritten without an erase */
+    stCtx.u32Head = u32HeadSector * APP_JOURNAL_SLOTS_PER_SECTOR;
+    for(u32Slot = stCtx.u32Head; u32Slot < (u32HeadSector + 1) * APP_JOURNAL_SLOTS_PER_SECTOR; u32Slot++)
+    {
+      _app_journal_read(u32Slot, &stSlot, 1);
+      if(APP_JOURNAL_STATE_ERASED != stSlot.u08State)
+      {
+        stCtx.u32Head = (u32Slot + 1) % stCtx.u32SlotCount;
+        if(_app_journal_is_valid(&stSlot))
+        {
+          stCtx.u32NextSequence = stSlot.u32Sequence + 1;
+        }
+      }
+    }
+    /* Oldest sector, ignoring a stale sector the head just moved onto */
+    u32OldestSector = u32HeadSector;
+    u32OldestSequence = UINT32_MAX;
+    for(u32Sector = 0; u32Sector < u32SectorCount; u32Sector++)
+    {
+      if(((stCtx.u32Head != u32Sector * APP_JOURNAL_SLOTS_PER_SECTOR) || (u32Sector == u32HeadSector)) &&
+         _app_journal_sector_sequence(u32Sector, &u32Sequence) &&
+         (u32Sequence < u32OldestSequence))
+      {
+        u32OldestSequence = u32Sequence;
+        u32OldestSector = u32Sector;
+      }
+    }
+    /* Walk from the oldest record up to the head looking for replay marks */
+    stCtx.u32Tail = u32OldestSector * APP_JOURNAL_SLOTS_PER_SECTOR;
+    for(u32Slot = stCtx.u32Tail; u32Slot != stCtx.u32Head; u32Slot = (u32Slot + 1) % stCtx.u32SlotCount)
+    {
+      _app_journal_read(u32Slot, &stSlot, 1);
+      if(APP_JOURNAL_STATE_REPLAYED == stSlot.u08State)
+      {
+        stCtx.u32Tail = (u32Slot + 1) % stCtx.u32SlotCount;
+      }
+    }
+  }
+  stCtx.u32Count = (stCtx.u32Head + stCtx.u32SlotCount - stCtx.u32Tail) % stCtx.u32SlotCount;
+  stCtx.u32ReplayCursor = stCtx.u32Tail;
+}
+
+esp_err_t app_journal_init(void)
+{
+  esp_err_t s32RetVal;
+
+  memset(&stCtx, 0x00, sizeof(stCtx));
+  stCtx.pstPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                APP_JOURNAL_PARTITION_SUBTYPE,
+                                                APP_JOURNAL_PARTITION_LABEL);
+  if(NULL == stCtx.pstPartition)
+  {
+    ESP_LOGE(APP_JOURNAL_TAG, "Journal partition not found");
+    s32RetVal = ESP_ERR_NOT_FOUND;
+  }
+  else
+  {
+    stCtx.u32SlotCount = (stCtx.pstPartition->size / SPI_FLASH_SEC_SIZE) * APP_JOURNAL_SLOTS_PER_SECTOR;
+    _app_journal_recover();
+    stCtx.u32BootSequence = stCtx.u32NextSequence;
+    if(0 == (stCtx.u32Head % APP_JOURNAL_SLOTS_PER_SECTOR))
+    {
+      _app_journal_prepare_sector();
+    }
+    ESP_LOGI(APP_JOURNAL_TAG,
+             "Journal ready: %d pending records (head: %d, tail: %d)",
+             app_journal_count(),
+             stCtx.u32Head,
+             stCtx.u32Tail);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* Append a record, the next sector is reclaimed as soon as the head reaches it */
+esp_err_t app_journal_append(const app_journal_record_t *pstRecord)
+{
+  esp_err_t s32RetVal;
+  journal_slot_t stSlot;
+
+  if((NULL == pstRecord) ||
+     (pstRecord->u08UidLength > APP_JOURNAL_UID_MAX_SIZE) ||
+     (pstRecord->u08ReaderId > (0xFF >> APP_JOURNAL_READER_SHIFT)))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else if(NULL == stCtx.pstPartition)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else
+  {
+    memset(&stSlot, 0xFF, sizeof(stSlot));
+    stSlot.u08State = APP_JOURNAL_STATE_VALID;
+    stSlot.u08ReaderUidLength = (pstRecord->u08ReaderId << APP_JOURNAL_READER_SHIFT) | pstRecord->u08UidLength;
+    memcpy(stSlot.tu08Uid, pstRecord->tu08Uid, pstRecord->u08UidLength);
+    stSlot.u32Sequence = stCtx.u32NextSequence++;
+    stSlot.s64Timestamp = pstRecord->s64Timestamp;
+    stSlot.u32CaptureMs = pstRecord->s64CaptureUs?(uint32_t)(pstRecord->s64CaptureUs / 1000LL):APP_JOURNAL_NO_CAPTURE;
+    stSlot.u32Crc = _app_journal_crc(&stSlot);
+    s32RetVal = esp_partition_write(stCtx.pstPartition,
+                                    stCtx.u32Head * sizeof(journal_slot_t),
+                                    &stSlot,
+                                    sizeof(stSlot));
+    /* A failed write still burns the slot, recovery skips it on next boot */
+    stCtx.u32Head = (stCtx.u32Head + 1) % stCtx.u32SlotCount;
+    stCtx.u32Count++;
+    if(ESP_OK == s32RetVal)
+    {
+      stCtx.stStats.u32Appended++;
+    }
+    else
+    {
+      ESP_LOGE(APP_JOURNAL_TAG, "Failed to append record: %s", esp_err_to_name(s32RetVal));
+    }
+    if(0 == (stCtx.u32Head % APP_JOURNAL_SLOTS_PER_SECTOR))
+    {
+      _app_journal_prepare_sector();
+    }
+  }
+  return s32RetVal;
+}
+
+/* Stream up to u32MaxRecords unread records to the callback without loading the
+   journal in RAM, nothing is consumed until app_journal_consume() is called */
+uint32_t app_journal_replay(app_journal_cb_t pfCb, void *pvArg, uint32_t u32MaxRecords)
+{
+  uint32_t u32Slot;
+  uint32_t u32Index;
+  uint32_t u32Count;
+  uint32_t u32Delivered;
+  journal_slot_t tstSlots[APP_JOURNAL_READ_CHUNK_SLOTS];
+  app_journal_record_t stRecord;
+
+  u32Delivered = 0;
+  u32Slot = stCtx.u32Tail;
+  stCtx.u32ReplayCursor = stCtx.u32Tail;
+  while(pfCb && stCtx.pstPartition && (u32Slot != stCtx.u32Head) && (u32Delivered < u32MaxRecords))
+  {
+    /* Read a chunk that neither crosses the end of the partition nor the head */
+    u32Count = APP_JOURNAL_READ_CHUNK_SLOTS;
+    if((u32Slot + u32Count) > stCtx.u32SlotCount)
+    {
+      u32Count = stCtx.u32SlotCount - u32Slot;
+    }
+    if((u32Slot < stCtx.u32Head) && ((u32Slot + u32Count) > stCtx.u32Head))
+    {
+      u32Count = stCtx.u32Head - u32Slot;
+    }
+    if(ESP_OK != _app_journal_read(u32Slot, tstSlots, u32Count))
+    {
+      ESP_LOGE(APP_JOURNAL_TAG, "Failed to read journal at slot %d", u32Slot);
+      break;
+    }
+    for(u32Index = 0; (u32Index < u32Count) && (u32Delivered < u32MaxRecords); u32Index++)
+    {
+      if(_app_journal_is_valid(&tstSlots[u32Index]) &&
+         ((tstSlots[u32Index].u08ReaderUidLength & APP_JOURNAL_LENGTH_MASK) <= APP_JOURNAL_UID_MAX_SIZE))
+      {
+        memcpy(stRecord.tu08Uid, tstSlots[u32Index].tu08Uid, APP_JOURNAL_UID_MAX_SIZE);
+        stRecord.u08UidLength = tstSlots[u32Index].u08ReaderUidLength & APP_JOURNAL_LENGTH_MASK;
+        stRecord.u08ReaderId = tstSlots[u32Index].u08ReaderUidLength >> APP_JOURNAL_READER_SHIFT;
+        stRecord.s64Timestamp = tstSlots[u32Index].s64Timestamp;
+        stRecord.s64CaptureUs = _app_journal_capture_us(&tstSlots[u32Index]);
+        if(ESP_OK != pfCb(&stRecord, pvArg))
+        {
+          /* The callback is full, stop right before this record */
+          u32MaxRecords = u32Delivered;
+          break;
+        }
+        u32Delivered++;
+      }
+      else
+      {
+        stCtx.stStats.u32Corrupted++;
+      }
+      u32Slot = (u32Slot + 1) % stCtx.u32SlotCount;
+      stCtx.u32ReplayCursor = u32Slot;
+    }
+  }
+  return u32Delivered;
+}
+
+/* Consume every record handed out by the last replay, only the last one is
+   marked on flash since recovery treats all older records as consumed */
+esp_err_t app_journal_consume(void)
+{
+  uint8_t u08State;
+  uint32_t u32Last;
+  uint32_t u32Consumed;
+  esp_err_t s32RetVal;
+
+  if(NULL == stCtx.pstPartition)
+  {
+    s32RetVal = ESP_ERR_INVALID_STATE;
+  }
+  else if(stCtx.u32ReplayCursor == stCtx.u32Tail)
+  {
+    s32RetVal = ESP_OK;
+  }
+  else
+  {
+    u08State = APP_JOURNAL_STATE_REPLAYED;
+    u32Last = (stCtx.u32ReplayCursor + stCtx.u32SlotCount - 1) % stCtx.u32SlotCount;
+    s32RetVal = esp_partition_write(stCtx.pstPartition,
+                                    u32Last * sizeof(journal_slot_t),
+                                    &u08State,
+                                    sizeof(u08State));
+    if(ESP_OK == s32RetVal)
+    {
+      u32Consumed = (stCtx.u32ReplayCursor + stCtx.u32SlotCount - stCtx.u32Tail) % stCtx.u32SlotCount;
+      stCtx.stStats.u32Consumed += u32Consumed;
+      stCtx.u32Count -= u32Consumed;
+      stCtx.u32Tail = stCtx.u32ReplayCursor;
+    }
+    else
+    {
+      ESP_LOGE(APP_JOURNAL_TAG, "Failed to mark records as replayed: %s", esp_err_to_name(s32RetVal));
+    }
+  }
+  return s32RetVal;
+}
+
+/* Number of unread slots, torn records included */
+uint32_t app_journal_count(void)
+{
+  return stCtx.u32Count;
+}
+
+void app_journal_get_stats(app_journal_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_journal_stats_t));
+  }
+}
\ No newline at end of file
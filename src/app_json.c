@@ -0,0 +1,411 @@
+#include <string.h>
+
+#include "app_json.h"
+
+#define APP_JSON_STATE_VALUE                     0
+#define APP_JSON_STATE_KEY_OR_END                1
+#define APP_JSON_STATE_KEY                       2
+#define APP_JSON_STATE_COLON                     3
+#define APP_JSON_STATE_COMMA_OR_END              4
+#define APP_JSON_STATE_STRING                    5
+#define APP_JSON_STATE_ESCAPE                    6
+#define APP_JSON_STATE_UNICODE                   7
+#define APP_JSON_STATE_LITERAL                   8
+#define APP_JSON_STATE_DONE                      9
+#define APP_JSON_STATE_ERROR                     10
+
+#define APP_JSON_IS_SPACE(c)                     (((c) == ' ') || ((c) == '\t') || ((c) == '\r') || ((c) == '\n'))
+#define APP_JSON_IN_OBJECT(p)                    ((p)->u08Depth && ((p)->u08Containers & (1 << ((p)->u08Depth - 1))))
+
+_Static_assert(APP_JSON_MAX_DEPTH <= 8, "Container types are kept in a uint8_t bitmask");
+
+void app_json_init(app_json_t *pstJson, char *pcValue, uint32_t u32ValueSize, app_json_cb_t pfCb, void *pvArg)
+{
+  memset(pstJson, 0x00, sizeof(app_json_t));
+  pstJson->u08State = APP_JSON_STATE_VALUE;
+  pstJson->pcValue = pcValue;
+  pstJson->u32ValueSize = u32ValueSize;
+  pstJson->pfCb = pfCb;
+  pstJson->pvArg = pvArg;
+}
+
+static void _app_json_append(app_json_t *pstJson, char cChar)
+{
+  if(pstJson->bIsKey)
+  {
+    /* Keys are silently truncated, they are only used for matching */
+    if((pstJson->u32ValueLength + 1) < APP_JSON_KEY_MAX_SIZE)
+    {
+      pstJson->tcKeys[pstJson->u08Depth - 1][pstJson->u32ValueLength++] = cChar;
+    }
+  }
+  else if((pstJson->u32ValueLength + 1) < pstJson->u32ValueSize)
+  {
+    pstJson->pcValue[pstJson->u32ValueLength++] = cChar;
+  }
+  else
+  {
+    pstJson->bTruncated = true;
+  }
+}
+
+static void _app_json_append_unicode(app_json_t *pstJson, uint16_t u16Code)
+{
+  /* Encode as UTF-8, surrogate pairs are not combined */
+  if(u16Code < 0x80)
+  {
+    _app_json_append(pstJson, (char)u16Code);
+  }
+  else if(u16Code < 0x800)
+  {
+    _app_json_append(pstJson, (char)(0xC0 | (u16Code >> 6)));
+    _app_json_append(pstJson, (char)(0x80 | (u16Code & 0x3F)));
+  }
+  else
+  {
+    _app_json_append(pstJson, (char)(0xE0 | (u16Code >> 12)));
+    _app_json_append(pstJson, (char)(0x80 | ((u16Code >> 6) & 0x3F)));
+    _app_json_append(pstJson, (char)(0x80 | (u16Code & 0x3F)));
+  }
+}
+
+static void _app_json_emit(app_json_t *pstJson, app_json_type_t eType)
+{
+  if(pstJson->pcValue && pstJson->u32ValueSize)
+  {
+    pstJson->pcValue[pstJson->u32ValueLength] = '\0';
+  }
+  if(pstJson->pfCb)
+  {
+    pstJson->pfCb(pstJson, eType, pstJson->pcValue, pstJson->u32ValueLength, pstJson->pvArg);
+  }
+  pstJson->u32ValueLength = 0;
+  pstJson->bTruncated = false;
+}
+
+/* A value just ended, figure out what may follow it */
+static void _app_json_value_done(app_json_t *pstJson)
+{
+  pstJson->u08State = pstJson->u08Depth?APP_JSON_STATE_COMMA_OR_END:APP_JSON_STATE_DONE;
+}
+
+static bool _app_json_push(app_json_t *pstJson, bool bObject)
+{
+  bool bRetVal;
+
+  bRetVal = (pstJson->u08Depth < APP_JSON_MAX_DEPTH);
+  if(bRetVal)
+  {
+    _app_json_emit(pstJson, bObject?APP_JSON_OBJECT_START:APP_JSON_ARRAY_START);
+    if(bObject)
+    {
+      pstJson->u08Containers |= (1 << pstJson->u08Depth);
+    }
+    else
+    {
+      pstJson->u08Containers &= ~(1 << pstJson->u08Depth);
+    }
+    pstJson->tcKeys[pstJson->u08Depth][0] = '\0';
+    pstJson->u08Depth++;
+    pstJson->u08State = bObject?APP_JSON_STATE_KEY_OR_END:APP_JSON_STATE_VALUE;
+  }
+  return bRetVal;
+}
+
+static bool _app_json_pop(app_json_t *pstJson, bool bObject)
+{
+  bool bRetVal;
+
+  bRetVal = pstJson->u08Depth && (bObject == APP_JSON_IN_OBJECT(pstJson));
+  if(bRetVal)
+  {
+    pstJson->u08Depth--;
+    _app_json_emit(pstJson, bObject?APP_JSON_OBJECT_END:APP_JSON_ARRAY_END);
+    _app_json_value_done(pstJson);
+  }
+  return bRetVal;
+}
+
+static bool _app_json_literal_done(app_json_t *pstJson)
+{
+  bool bRetVal;
+  app_json_type_t eType;
+
+  bRetVal = true;
+  if((4 == pstJson->u32ValueLength) && (0 == memcmp(pstJson->pcValue, "true", 4)))
+  {
+    eType = APP_JSON_TRUE;
+  }
+  else if((5 == pstJson->u32ValueLength) && (0 == memcmp(pstJson->pcValue, "false", 5)))
+  {
+    eType = APP_JSON_FALSE;
+  }
+  else if((4 == pstJson->u32ValueLength) && (0 == memcmp(pstJson->pcValue, "null", 4)))
+  {
+    eType = APP_JSON_NULL;
+  }
+  else
+  {
+    /* Anything else made of literal characters is taken as a number */
+    eType = APP_JSON_NUMBER;
+    bRetVal = (pstJson->u32ValueLength > 0) || pstJson->bTruncated;
+  }
+  _app_json_emit(pstJson, eType);
+  _app_json_value_done(pstJson);
+  return bRetVal;
+}
+
+static bool _app_json_scan_value(app_json_t *pstJson, char cChar)
+{
+  bool bRetVal;
+
+  bRetVal = true;
+  if('{' == cChar)
+  {
+    bRetVal = _app_json_push(pstJson, true);
+  }
+  else if('[' == cChar)
+  {
+    bRetVal = _app_json_push(pstJson, false);
+  }
+  else if(']' == cChar)
+  {
+    /* Only valid right after '[' */
+    bRetVal = _app_json_pop(pstJson, false);
+  }
+  else if('"' == cChar)
+  {
+    pstJson->bIsKey = false;
+    pstJson->u08State = APP_JSON_STATE_STRING;
+  }
+  else if((('0' <= cChar) && (cChar <= '9')) || ('-' == cChar) || (('a' <= cChar) && (cChar <= 'z')))
+  {
+    pstJson->bIsKey = false;
+    _app_json_append(pstJson, cChar);
+    pstJson->u08State = APP_JSON_STATE_LITERAL;
+  }
+  else
+  {
+    bRetVal = false;
+  }
+  return bRetVal;
+}
+
+static bool _app_json_scan(app_json_t *pstJson, char cChar)
+{
+  bool bRetVal;
+  uint8_t u08Digit;
+
+  bRetVal = true;
+  switch(pstJson->u08State)
+  {
+  case APP_JSON_STATE_VALUE:
+    if(!APP_JSON_IS_SPACE(cChar))
+    {
+      bRetVal = _app_json_scan_value(pstJson, cChar);
+    }
+    break;
+  case APP_JSON_STATE_KEY_OR_END:
+  case APP_JSON_STATE_KEY:
+    if('"' == cChar)
+    {
+      pstJson->bIsKey = true;
+      pstJson->u32ValueLength = 0;
+      pstJson->u08State = APP_JSON_STATE_STRING;
+    }
+    else if(('}' == cChar) && (APP_JSON_STATE_KEY_OR_END == pstJson->u08State))
+    {
+      bRetVal = _app_json_pop(pstJson, true);
+    }
+    else if(!APP_JSON_IS_SPACE(cChar))
+    {
+      bRetVal = false;
+    }
+    break;
+  case APP_JSON_STATE_COLON:
+    if(':' == cChar)
+    {
+      pstJson->u08State = APP_JSON_STATE_VALUE;
+    }
+    else if(!APP_JSON_IS_SPACE(cChar))
+    {
+      bRetVal = false;
+    }
+    break;
+  case APP_JSON_STATE_COMMA_OR_END:
+    if(',' == cChar)
+    {
+      pstJson->u08State = APP_JSON_IN_OBJECT(pstJson)?APP_JSON_STATE_KEY:APP_JSON_STATE_VALUE;
+    }
+    else if(('}' == cChar) || (']' == cChar))
+    {
+      bRetVal = _app_json_pop(pstJson, '}' == cChar);
+    }
+    else if(!APP_JSON_IS_SPACE(cChar))
+    {
+      bRetVal = false;
+    }
+    break;
+  case APP_JSON_STATE_STRING:
+    if('"' == cChar)
+    {
+      if(pstJson->bIsKey)
+      {
+        pstJson->tcKeys[pstJson->u08Depth - 1][pstJson->u32ValueLength] = '\0';
+        pstJson->u32ValueLength = 0;
+        pstJson->bIsKey = false;
+        pstJson->u08State = APP_JSON_STATE_COLON;
+      }
+      else
+      {
+        _app_json_emit(pstJson, APP_JSON_STRING);
+        _app_json_value_done(pstJson);
+      }
+    }
+    else if('\\' == cChar)
+    {
+      pstJson->u08State = APP_JSON_STATE_ESCAPE;
+    }
+    else
+    {
+      _app_json_append(pstJson, cChar);
+    }
+    break;
+  case APP_JSON_STATE_ESCAPE:
+    pstJson->u08State = APP_JSON_STATE_STRING;
+    switch(cChar)
+    {
+    case 'b':
+      _app_json_append(pstJson, '\b');
+      break;
+    case 'f':
+      _app_json_append(pstJson, '\f');
+      break;
+    case 'n':
+      _app_json_append(pstJson, '\n');
+      break;
+    case 'r':
+      _app_json_append(pstJson, '\r');
+      break;
+    case 't':
+      _app_json_append(pstJson, '\t');
+      break;
+    case 'u':
+      pstJson->u16Unicode = 0;
+      pstJson->u08UnicodeDigits = 0;
+      pstJson->u08State = APP_JSON_STATE_UNICODE;
+      break;
+    default:
+      /* '"', '\\' and '/' stand for themselves */
+      _app_json_append(pstJson, cChar);
+      break;
+    }
+    break;
+  case APP_JSON_STATE_UNICODE:
+    if(('0' <= cChar) && (cChar <= '9'))
+    {
+      u08Digit = cChar - '0';
+    }
+    else if(('a' <= (cChar | 0x20)) && ((cChar | 0x20) <= 'f'))
+    {
+      u08Digit = (cChar | 0x20) - 'a' + 10;
+    }
+    else
+    {
+      bRetVal = false;
+      break;
+    }
+    pstJson->u16Unicode = (pstJson->u16Unicode << 4) | u08Digit;
+    if(4 == ++pstJson->u08UnicodeDigits)
+    {
+      _app_json_append_unicode(pstJson, pstJson->u16Unicode);
+      pstJson->u08State = APP_JSON_STATE_STRING;
+    }
+    break;
+  case APP_JSON_STATE_LITERAL:
+    if((('0' <= cChar) && (cChar <= '9')) || (('a' <= cChar) && (cChar <= 'z')) ||
+       ('.' == cChar) || ('+' == cChar) || ('-' == cChar) || ('E' == cChar))
+    {
+      _app_json_append(pstJson, cChar);
+    }
+    else
+    {
+      /* The terminating character belongs to the enclosing container */
+      bRetVal = _app_json_literal_done(pstJson) && _app_json_scan(pstJson, cChar);
+    }
+    break;
+  case APP_JSON_STATE_DONE:
+    bRetVal = APP_JSON_IS_SPACE(cChar);
+    break;
+  default:
+    bRetVal = false;
+    break;
+  }
+  return bRetVal;
+}
+
+/* Feed the next chunk of the document, chunks may be split anywhere */
+esp_err_t app_json_feed(app_json_t *pstJson, const char *pcData, uint32_t u32Length)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+
+  s32RetVal = ESP_OK;
+  if((NULL == pstJson) || (NULL == pcData))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    for(u32Index = 0; (u32Index < u32Length) && (APP_JSON_STATE_ERROR != pstJson->u08State); u32Index++)
+    {
+      if(!_app_json_scan(pstJson, pcData[u32Index]))
+      {
+        pstJson->u08State = APP_JSON_STATE_ERROR;
+      }
+    }
+    if(APP_JSON_STATE_ERROR == pstJson->u08State)
+    {
+      s32RetVal = ESP_ERR_INVALID_STATE;
+    }
+  }
+  return s32RetVal;
+}
+
+/* True once a complete top-level value has been scanned, a bare top-level
+   number is only complete once followed by a separator */
+bool app_json_is_done(const app_json_t *pstJson)
+{
+  return (APP_JSON_STATE_DONE == pstJson->u08State);
+}
+
+/* Number of containers enclosing the value being reported */
+uint8_t app_json_get_depth(const app_json_t *pstJson)
+{
+  return pstJson->u08Depth;
+}
+
+/* Member name of the value within the container at u08Level, empty in arrays */
+const char *app_json_get_key(const app_json_t *pstJson, uint8_t u08Level)
+{
+  return (u08Level < pstJson->u08Depth)?pstJson->tcKeys[u08Level]:"";
+}
+
+/* Compare the path of the value being reported, NULL entries match anything */
+bool app_json_match(const app_json_t *pstJson, const char *const *ppcPath, uint8_t u08Length)
+{
+  bool bMatch;
+  uint8_t u08Level;
+
+  bMatch = (u08Length == pstJson->u08Depth);
+  for(u08Level = 0; bMatch && (u08Level < u08Length); u08Level++)
+  {
+    bMatch = (NULL == ppcPath[u08Level]) || (0 == strcmp(ppcPath[u08Level], pstJson->tcKeys[u08Level]));
+  }
+  return bMatch;
+}
+
+bool app_json_is_truncated(const app_json_t *pstJson)
+{
+  return pstJson->bTruncated;
+}
\ No newline at end of file
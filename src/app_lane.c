@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include <esp_timer.h>
+
+#include "app_lane.h"
+
+typedef struct
+{
+  const app_lane_config_t *pstConfig;
+  int32_t ts32Current[APP_LANE_COUNT];
+  app_lane_stats_t tstStats[APP_LANE_COUNT];
+}lane_ctx_t;
+
+static lane_ctx_t stCtx;
+
+/* pstConfig holds APP_LANE_COUNT lanes and has to outlive the scheduler */
+void app_lane_init(const app_lane_config_t *pstConfig)
+{
+  memset(&stCtx, 0x00, sizeof(stCtx));
+  stCtx.pstConfig = pstConfig;
+}
+
+/* Serve one turn: the most overdue lane if any, otherwise the ready lane picked
+   by smooth weighted round-robin. Returns false when no lane is ready or the
+   served one made no progress, the caller then waits instead of retrying */
+bool app_lane_serve(void)
+{
+  bool bProgress;
+  int32_t s32Best;
+  int32_t s32Late;
+  uint32_t u32Total;
+  uint32_t u32Index;
+  uint32_t u32Count;
+  int64_t s64NowUs;
+  int64_t s64AgeUs;
+  int64_t s64LateUs;
+  int64_t s64OldestUs;
+  int64_t ts64AgeUs[APP_LANE_COUNT];
+  const app_lane_config_t *pstLane;
+
+  bProgress = false;
+  s32Best = -1;
+  s32Late = -1;
+  s64LateUs = -1;
+  u32Total = 0;
+  s64NowUs = esp_timer_get_time();
+  for(u32Index = 0; stCtx.pstConfig && (u32Index < APP_LANE_COUNT); u32Index++)
+  {
+    pstLane = &stCtx.pstConfig[u32Index];
+    ts64AgeUs[u32Index] = -1;
+    u32Count = pstLane->pfPending(&s64OldestUs);
+    s64AgeUs = s64NowUs - s64OldestUs;
+    if(u32Count &&
+       (s64AgeUs >= 0) &&
+       ((u32Count >= pstLane->u32TurnRecords) || (s64AgeUs >= (pstLane->u32WindowMs * 1000LL))))
+    {
+      ts64AgeUs[u32Index] = s64AgeUs;
+      u32Total += pstLane->u32Weight;
+      if(pstLane->u32DeadlineMs &&
+         (s64AgeUs - (pstLane->u32DeadlineMs * 1000LL) > s64LateUs))
+      {
+        s32Late = u32Index;
+        s64LateUs = s64AgeUs - (pstLane->u32DeadlineMs * 1000LL);
+      }
+    }
+  }
+  for(u32Index = 0; stCtx.pstConfig && (u32Index < APP_LANE_COUNT); u32Index++)
+  {
+    if(ts64AgeUs[u32Index] >= 0)
+    {
+      stCtx.ts32Current[u32Index] += stCtx.pstConfig[u32Index].u32Weight;
+      if((s32Best < 0) || (stCtx.ts32Current[u32Index] > stCtx.ts32Current[s32Best]))
+      {
+        s32Best = u32Index;
+      }
+    }
+  }
+  /* An overdue lane still pays for its turn so it can't starve the others */
+  s32Best = (s32Late >= 0)?s32Late:s32Best;
+  if(s32Best >= 0)
+  {
+    stCtx.ts32Current[s32Best] -= (int32_t)u32Total;
+    stCtx.tstStats[s32Best].u32Turns++;
+    stCtx.tstStats[s32Best].u32LateTurns += (s32Late >= 0)?1:0;
+    bProgress = (0 < stCtx.pstConfig[s32Best].pfServe(stCtx.pstConfig[s32Best].u32TurnRecords));
+  }
+  return bProgress;
+}
+
+/* Until the next lane becomes ready, portMAX_DELAY when nothing is waiting */
+TickType_t app_lane_get_wait_ticks(void)
+{
+  uint32_t u32Index;
+  uint32_t u32Count;
+  int64_t s64NowUs;
+  int64_t s64WaitUs;
+  int64_t s64ReadyUs;
+  int64_t s64OldestUs;
+  TickType_t u32WaitTicks;
+  const app_lane_config_t *pstLane;
+
+  s64WaitUs = -1;
+  s64NowUs = esp_timer_get_time();
+  for(u32Index = 0; stCtx.pstConfig && (u32Index < APP_LANE_COUNT); u32Index++)
+  {
+    pstLane = &stCtx.pstConfig[u32Index];
+    u32Count = pstLane->pfPending(&s64OldestUs);
+    if(u32Count)
+    {
+      s64ReadyUs = (u32Count >= pstLane->u32TurnRecords)?s64OldestUs:(s64OldestUs + (pstLane->u32WindowMs * 1000LL));
+      s64ReadyUs = (s64ReadyUs > s64NowUs)?(s64ReadyUs - s64NowUs):0;
+      s64WaitUs = ((s64WaitUs < 0) || (s64ReadyUs < s64WaitUs))?s64ReadyUs:s64WaitUs;
+    }
+  }
+  if(s64WaitUs < 0)
+  {
+    u32WaitTicks = portMAX_DELAY;
+  }
+  else
+  {
+    /* Rounded up so the lane is ready when the task wakes up */
+    u32WaitTicks = (s64WaitUs + (portTICK_PERIOD_MS * 1000LL) - 1) / (portTICK_PERIOD_MS * 1000LL);
+  }
+  return u32WaitTicks;
+}
+
+void app_lane_get_stats(app_lane_t eLane, app_lane_stats_t *pstStats)
+{
+  if(pstStats && (eLane < APP_LANE_COUNT))
+  {
+    memcpy(pstStats, &stCtx.tstStats[eLane], sizeof(app_lane_stats_t));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+
+#include "app_hist.h"
+#include "app_load.h"
+
+#define APP_LOAD_TAG                             "APP_LOAD"
+
+#define APP_LOAD_DISTINCT_TAGS                   64
+#define APP_LOAD_UID_MARKER                      0xB0
+#define APP_LOAD_REPORT_PERIOD_US                (10 * 1000 * 1000)
+
+typedef struct
+{
+  app_reader_cb_t pfScan;
+  app_ring_t *pstRing;
+  uint32_t u32Readers;
+  esp_timer_handle_t pstScanTimer;
+  esp_timer_handle_t pstReportTimer;
+  uint32_t u32Scans;
+  uint32_t u32MaxDepth;
+  app_hist_t stLatency;
+}load_ctx_t;
+
+static load_ctx_t stCtx;
+
+/* Synthetic reads cycle through a fixed set of UIDs tagged with a marker byte,
+   spread over the simulated readers */
+static void _app_load_scan_cb(void *pvArg)
+{
+  uint32_t u32Depth;
+  uint32_t u32Id;
+  uint8_t tu08Uid[APP_TAG_UID_MAX_SIZE];
+
+  u32Id = (stCtx.u32Scans % APP_LOAD_DISTINCT_TAGS) * 2654435761u;
+  tu08Uid[0] = APP_LOAD_UID_MARKER;
+  memcpy(&tu08Uid[1], &u32Id, sizeof(u32Id));
+  stCtx.pfScan(stCtx.u32Scans++ % stCtx.u32Readers, tu08Uid, 1 + sizeof(u32Id));
+  u32Depth = app_ring_count(stCtx.pstRing);
+  stCtx.u32MaxDepth = (u32Depth > stCtx.u32MaxDepth)?u32Depth:stCtx.u32MaxDepth;
+}
+
+static void _app_load_report_cb(void *pvArg)
+{
+  app_load_report_t stReport;
+
+  app_load_get_report(&stReport);
+  ESP_LOGI(APP_LOAD_TAG,
+           "scans: %d, uploaded: %d, dropped: %d, max depth: %d, "
+           "latency p50: %d us, p90: %d us, p99: %d us, max: %d us, min free heap: %d",
+           stReport.u32Scans,
+           stReport.u32Uploaded,
+           stReport.u32Dropped,
+           stReport.u32MaxDepth,
+           stReport.u32P50Us,
+           stReport.u32P90Us,
+           stReport.u32P99Us,
+           stReport.u32MaxUs,
+           stReport.u32MinFreeHeap);
+}
+
+/* Inject u32ScansPerSecond synthetic reads from u32Readers simulated readers
+   through pfScan in place of the real ones, pstRing is the ring they end up in */
+void app_load_start(uint32_t u32ScansPerSecond,
+                    uint32_t u32Readers,
+                    app_reader_cb_t pfScan,
+                    app_ring_t *pstRing)
+{
+  esp_timer_create_args_t stScanArgs =
+  {
+    .callback = _app_load_scan_cb,
+    .name = "load_scan",
+  };
+  esp_timer_create_args_t stReportArgs =
+  {
+    .callback = _app_load_report_cb,
+    .name = "load_report",
+  };
+
+  stCtx.pfScan = pfScan;
+  stCtx.pstRing = pstRing;
+  stCtx.u32Readers = u32Readers?u32Readers:1;
+  ESP_ERROR_CHECK(esp_timer_create(&stScanArgs, &stCtx.pstScanTimer));
+  ESP_ERROR_CHECK(esp_timer_create(&stReportArgs, &stCtx.pstReportTimer));
+  ESP_ERROR_CHECK(esp_timer_start_periodic(stCtx.pstScanTimer, 1000000 / u32ScansPerSecond));
+  ESP_ERROR_CHECK(esp_timer_start_periodic(stCtx.pstReportTimer, APP_LOAD_REPORT_PERIOD_US));
+  ESP_LOGW(APP_LOAD_TAG,
+           "Injecting %d synthetic scans per second from %d readers",
+           u32ScansPerSecond,
+           stCtx.u32Readers);
+}
+
+/* Called once a scan is acknowledged by Firestore */
+void app_load_record_latency(int64_t s64CaptureUs)
+{
+  uint32_t u32Latency;
+
+  u32Latency = (uint32_t)(esp_timer_get_time() - s64CaptureUs);
+  app_hist_record(&stCtx.stLatency, u32Latency);
+}
+
+void app_load_get_report(app_load_report_t *pstReport)
+{
+  app_ring_stats_t stRingStats;
+
+  memset(pstReport, 0x00, sizeof(app_load_report_t));
+  if(stCtx.pstRing)
+  {
+    app_ring_get_stats(stCtx.pstRing, &stRingStats);
+    pstReport->u32Dropped = stRingStats.u32DroppedOldest + stRingStats.u32DroppedNewest;
+  }
+  pstReport->u32Scans = stCtx.u32Scans;
+  pstReport->u32Uploaded = stCtx.stLatency.u32Count;
+  pstReport->u32MaxDepth = stCtx.u32MaxDepth;
+  pstReport->u32P50Us = app_hist_percentile(&stCtx.stLatency, 50);
+  pstReport->u32P90Us = app_hist_percentile(&stCtx.stLatency, 90);
+  pstReport->u32P99Us = app_hist_percentile(&stCtx.stLatency, 99);
+  pstReport->u32MaxUs = stCtx.stLatency.u32Max;
+  pstReport->u32MinFreeHeap = esp_get_minimum_free_heap_size();
+}
\ No newline at end of file
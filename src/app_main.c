@@ -1,20 +1,23 @@
-#include <string.h>
+#include <sdkconfig.h>
 #include <esp_log.h>
+#include <esp_system.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/queue.h>
 
-#include "rc522.h"
-#include "firestore.h"
 
+#include "app_mem.h"
 #include "app_wifi.h"
 #include "app_time.h"
 #include "app_ota.h"
-
-static void _app_main_send_data(uint8_t *);
-static void _app_main_tag_handler(uint8_t *);
-static void _app_main_firestore_task(void *);
+#include "app_conn.h"
+#include "app_index.h"
+#include "app_sync.h"
+#include "app_reader.h"
+#include "app_trace.h"
+#include "app_metrics.h"
+#include "app_sched.h"
+#include "app_pipeline.h"
 
 #define APP_MAIN_TAG                             "APP_MAIN"
 
@@ -22,178 +25,53 @@ static void _app_main_firestore_task(void *);
 #define APP_MAIN_SPI_MOSI_PIN                    23
 #define APP_MAIN_SPI_SCK_PIN                     18
 #define APP_MAIN_SPI_SDA_PIN                     21
-
-#define APP_MAIN_SERIAL_NUMBER_MAX_SIZE          5
-
-#define APP_MAIN_FIRESTORE_QUEUE_SIZE            10
-#define APP_MAIN_FIRESTORE_TASK_STACK_SIZE       10240
-#define APP_MAIN_FIRESTORE_TASK_PRIORITY         4
-#define APP_MAIN_RC522_TASK_PRIORITY             5
-#define APP_MAIN_FIRESTORE_PERIOD_MS             2500
-
-#define APP_MAIN_FIRESTORE_DOC_MAX_SIZE          128
-#define APP_MAIN_FIRESTORE_COLLECTION_ID         "devices"
-#define APP_MAIN_FIRESTORE_DOCUMENT_ID           "rfid-node"
-#define APP_MAIN_FIRESTORE_DOCUMENT_EXAMPLE      "{"                                     \
-                                                   "\"fields\": {"                       \
-                                                     "\"sn\": {"                         \
-                                                       "\"stringValue\": ABCDEF1234"     \
-                                                     "},"                                \
-                                                     "\"timestamp\": {"                  \
-                                                       "\"integerValue\": 1621010203262" \
-                                                     "}"                                 \
-                                                   "}"                                   \
-                                                 "}"
-
-typedef enum
-{
-  TAG_DETECTED_EVENT = 0,
-  TAG_INVALID_EVENT,
-}rc522_event_t;
-
-static QueueHandle_t stQueue;
-static uint32_t u32DocLength;
-static char tcDoc[APP_MAIN_FIRESTORE_DOC_MAX_SIZE];
-static uint8_t tcu08SerialNumber[APP_MAIN_SERIAL_NUMBER_MAX_SIZE];
-
-static const rc522_start_args_t stStartArgs =
+/* GPIO wired to the IRQ pin of the reader, e.g. 22, or -1 to poll it */
+#ifndef APP_MAIN_SPI_IRQ_PIN
+#define APP_MAIN_SPI_IRQ_PIN                     -1
+#endif
+/* Every reader is polled for one slot, all fields are then off for the idle time */
+#define APP_MAIN_READER_POLICY                   APP_READER_ROUND_ROBIN
+#define APP_MAIN_READER_SLOT_MS                  CONFIG_RFID_READER_SLOT_MS
+#define APP_MAIN_READER_IDLE_MS                  0
+
+/* Further antennas share MISO/MOSI/SCK and only need their own CS line, e.g.
+   {.s32CsPin = 5, .s32IrqPin = -1, .u32Weight = 1} */
+static const app_reader_start_args_t stStartArgs =
 {
-  .miso_io  = APP_MAIN_SPI_MISO_PIN,
-  .mosi_io  = APP_MAIN_SPI_MOSI_PIN,
-  .sck_io   = APP_MAIN_SPI_SCK_PIN,
-  .sda_io   = APP_MAIN_SPI_SDA_PIN,
-  .callback = &_app_main_tag_handler,
-  .task_priority = APP_MAIN_RC522_TASK_PRIORITY
-};
-
-static const uint8_t ttu08KnownSerialNumbers[3][5] =
-{
-  {0x72, 0xEA, 0x5F, 0x06, 0xC1},
-  {0x29, 0x57, 0x8C, 0xBB, 0x49},
-  {0x76, 0x9E, 0x25, 0xF8, 0x35},
+  .s32MisoPin = APP_MAIN_SPI_MISO_PIN,
+  .s32MosiPin = APP_MAIN_SPI_MOSI_PIN,
+  .s32SckPin = APP_MAIN_SPI_SCK_PIN,
+  .tstReaders =
+  {
+    {.s32CsPin = APP_MAIN_SPI_SDA_PIN, .s32IrqPin = APP_MAIN_SPI_IRQ_PIN, .u32Weight = 1},
+  },
+  .u32ReaderCount = 1,
+  .ePolicy = APP_MAIN_READER_POLICY,
+  .u32SlotMs = APP_MAIN_READER_SLOT_MS,
+  .u32IdleMs = APP_MAIN_READER_IDLE_MS,
+  .pfCallback = &app_pipeline_scan,
 };
 
 void app_main(void)
 {
+  if(ESP_OK != app_mem_init())
+  {
+    ESP_LOGE(APP_MAIN_TAG, "TLS arenas unavailable --> TLS allocations go to the shared heap");
+  }
+  ESP_ERROR_CHECK(app_conn_init());
   app_wifi_init();
+  app_wifi_register_cb(app_pipeline_link);
   app_wifi_wait();
+  app_time_start();
 
-  app_ota_start();
-
-  stQueue = xQueueCreate(APP_MAIN_FIRESTORE_QUEUE_SIZE, sizeof(rc522_event_t));
-  xTaskCreate(_app_main_firestore_task,
-              "firestore",
-              APP_MAIN_FIRESTORE_TASK_STACK_SIZE,
-              NULL,
-              APP_MAIN_FIRESTORE_TASK_PRIORITY,
-              NULL);
-}
-
-static void _app_main_tag_handler(uint8_t *pu08SN)
-{
-  rc522_event_t eEvent;
-
-  memcpy(tcu08SerialNumber, pu08SN, sizeof(tcu08SerialNumber));
-  eEvent = TAG_DETECTED_EVENT;
-  xQueueSend(stQueue, &eEvent, portMAX_DELAY);
-}
-
-static void _app_main_firestore_task(void *pvParameter)
-{
-  rc522_event_t eEvent;
+  app_ota_start(app_pipeline_is_busy);
 
-  app_time_init();
-  firestore_init();
-  rc522_start(stStartArgs);
-  while(1)
-  {
-    if(pdPASS == xQueueReceive(stQueue, &eEvent, portMAX_DELAY))
-    {
-      switch(eEvent)
-      {
-      case TAG_DETECTED_EVENT:
-        ESP_LOGI(APP_MAIN_TAG,
-                 "Detected Tag with serial-number: %X%X%X%X%X",
-                 tcu08SerialNumber[0],
-                 tcu08SerialNumber[1],
-                 tcu08SerialNumber[2],
-                 tcu08SerialNumber[3],
-                 tcu08SerialNumber[4]);
-        if((0 == memcmp(tcu08SerialNumber, ttu08KnownSerialNumbers[0], sizeof(tcu08SerialNumber))) ||
-           (0 == memcmp(tcu08SerialNumber, ttu08KnownSerialNumbers[1], sizeof(tcu08SerialNumber))) ||
-           (0 == memcmp(tcu08SerialNumber, ttu08KnownSerialNumbers[2], sizeof(tcu08SerialNumber))))
-        {
-          ESP_LOGI(APP_MAIN_TAG, "Tag is recognized");
-        }
-        else
-        {
-          ESP_LOGW(APP_MAIN_TAG, "Tag is not recognized");
-        }
-        /* Sending data anyway */
-        _app_main_send_data(tcu08SerialNumber);
-        break;
-      default:
-        ESP_LOGW(APP_MAIN_TAG, "Unknow event");
-        break;
-      }
-    }
-    else
-    {
-      ESP_LOGE(APP_MAIN_TAG, "Couldn't receive item from queue");
-    }
-  }
-}
-
-static void _app_main_send_data(uint8_t *pu08SN)
-{
-  int64_t s64Timestamp;
+  app_index_init();
+  app_sync_start();
+  app_trace_start();
+  app_sched_start();
 
-  /* Format json document */
-  if(ESP_OK == app_time_get_timestamp(&s64Timestamp))
-  {
-    u32DocLength = snprintf(tcDoc,
-                            sizeof(tcDoc),
-                            "{\"fields\":{\"sn\":{\"stringValue\":\"%X%X%X%X%X\"},\"timestamp\":{\"integerValue\":%lld}}}",
-                            pu08SN[0],
-                            pu08SN[1],
-                            pu08SN[2],
-                            pu08SN[3],
-                            pu08SN[4],
-                            s64Timestamp);
-  }
-  else
-  {
-    ESP_LOGW(APP_MAIN_TAG, "Failed to get timestamp --> formatting data without timestamp");
-    u32DocLength = snprintf(tcDoc,
-                            sizeof(tcDoc),
-                            "{\"fields\":{\"sn\":{\"stringValue\":\"%X%X%X%X%X\"}}}",
-                            pu08SN[0],
-                            pu08SN[1],
-                            pu08SN[2],
-                            pu08SN[3],
-                            pu08SN[4]);
-  }
-  ESP_LOGD(APP_MAIN_TAG, "Document length after formatting: %d", u32DocLength);
-  ESP_LOGD(APP_MAIN_TAG, "Document content after formatting:\r\n%.*s", u32DocLength, tcDoc);
-  if(u32DocLength > 0)
-  {
-    /* Update document in firestore or create it if it doesn't already exists */
-    if(FIRESTORE_OK == firestore_update_document(APP_MAIN_FIRESTORE_COLLECTION_ID,
-                                                 APP_MAIN_FIRESTORE_DOCUMENT_ID,
-                                                 tcDoc,
-                                                 &u32DocLength))
-    {
-      ESP_LOGI(APP_MAIN_TAG, "Document updated successfully");
-      ESP_LOGD(APP_MAIN_TAG, "Document length: %d", u32DocLength);
-      ESP_LOGD(APP_MAIN_TAG, "Document content:\r\n%.*s", u32DocLength, tcDoc);
-    }
-    else
-    {
-      ESP_LOGE(APP_MAIN_TAG, "Couldn't update document");
-    }
-  }
-  else
-  {
-    ESP_LOGE(APP_MAIN_TAG, "Couldn't format document");
-  }
-}
+  app_pipeline_init();
+  app_metrics_start(app_pipeline_get_ring());
+  app_pipeline_start(&stStartArgs);
+}
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <multi_heap.h>
+
+#include "app_mem.h"
+
+#define APP_MEM_TAG                              "APP_MEM"
+
+/* One TLS session with 16 KB in / 4 KB out records peaks at ~38 KB during the
+   handshake, the peak of each arena is logged to keep these sizes honest */
+#define APP_MEM_CONN_ARENA_SIZE                  CONFIG_RFID_TLS_CONN_ARENA_SIZE
+#define APP_MEM_OTA_ARENA_SIZE                   CONFIG_RFID_TLS_OTA_ARENA_SIZE
+#define APP_MEM_ARENA_MIN_SIZE                   (CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN + \
+                                                  CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN + 16 * 1024)
+#define APP_MEM_MAX_BOUND_TASKS                  4
+#define APP_MEM_HEAP_CAPS                        (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+/* Record buffers plus the handshake, below that every session falls back to the heap */
+_Static_assert(APP_MEM_CONN_ARENA_SIZE >= APP_MEM_ARENA_MIN_SIZE, "TLS arena of the connection is too small");
+_Static_assert(APP_MEM_OTA_ARENA_SIZE >= APP_MEM_ARENA_MIN_SIZE, "TLS arena of the OTA task is too small");
+
+typedef struct
+{
+  uint8_t *pu08Start;
+  uint32_t u32Size;
+  multi_heap_handle_t pstHeap;
+  portMUX_TYPE stLock;
+  uint32_t u32Fallbacks;
+}mem_arena_t;
+
+typedef struct
+{
+  mem_arena_t tstArenas[APP_MEM_ARENA_COUNT];
+  TaskHandle_t tpstTasks[APP_MEM_MAX_BOUND_TASKS];
+  app_mem_arena_t teTaskArenas[APP_MEM_MAX_BOUND_TASKS];
+  uint32_t u32BoundTasks;
+  /* Reports are taken from the upload task and the metrics server */
+  portMUX_TYPE stLock;
+  uint32_t u32HeapMinLargestFreeBlock;
+  uint32_t u32MaxFragmentationPermille;
+}mem_ctx_t;
+
+static const uint32_t tu32ArenaSizes[APP_MEM_ARENA_COUNT] =
+{
+  [APP_MEM_ARENA_CONN] = APP_MEM_CONN_ARENA_SIZE,
+  [APP_MEM_ARENA_OTA]  = APP_MEM_OTA_ARENA_SIZE,
+};
+
+static const char *tpcArenaNames[APP_MEM_ARENA_COUNT] =
+{
+  [APP_MEM_ARENA_CONN] = "conn",
+  [APP_MEM_ARENA_OTA]  = "ota",
+};
+
+static mem_ctx_t stCtx =
+{
+  .stLock = portMUX_INITIALIZER_UNLOCKED,
+  .u32HeapMinLargestFreeBlock = UINT32_MAX,
+};
+
+/* Carve the arenas out of the heap at boot, before it had a chance to fragment */
+esp_err_t app_mem_init(void)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+  mem_arena_t *pstArena;
+
+  s32RetVal = ESP_OK;
+  for(u32Index = 0; (u32Index < APP_MEM_ARENA_COUNT) && (ESP_OK == s32RetVal); u32Index++)
+  {
+    pstArena = &stCtx.tstArenas[u32Index];
+    vPortCPUInitializeMutex(&pstArena->stLock);
+    pstArena->u32Size = tu32ArenaSizes[u32Index];
+    pstArena->pu08Start = heap_caps_malloc(pstArena->u32Size, APP_MEM_HEAP_CAPS);
+    if(pstArena->pu08Start)
+    {
+      pstArena->pstHeap = multi_heap_register(pstArena->pu08Start, pstArena->u32Size);
+    }
+    if(NULL == pstArena->pstHeap)
+    {
+      ESP_LOGE(APP_MEM_TAG, "Failed to allocate the %s arena", tpcArenaNames[u32Index]);
+      s32RetVal = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+      multi_heap_set_lock(pstArena->pstHeap, &pstArena->stLock);
+    }
+  }
+  return s32RetVal;
+}
+
+/* TLS allocations of the calling task go to eArena, unbound tasks use the
+   connection arena */
+void app_mem_bind_task(app_mem_arena_t eArena)
+{
+  if((eArena < APP_MEM_ARENA_COUNT) && (stCtx.u32BoundTasks < APP_MEM_MAX_BOUND_TASKS))
+  {
+    stCtx.teTaskArenas[stCtx.u32BoundTasks] = eArena;
+    stCtx.tpstTasks[stCtx.u32BoundTasks++] = xTaskGetCurrentTaskHandle();
+  }
+}
+
+static mem_arena_t *_app_mem_get_task_arena(void)
+{
+  uint32_t u32Index;
+  TaskHandle_t pstTask;
+  app_mem_arena_t eArena;
+
+  eArena = APP_MEM_ARENA_CONN;
+  pstTask = xTaskGetCurrentTaskHandle();
+  for(u32Index = 0; u32Index < stCtx.u32BoundTasks; u32Index++)
+  {
+    if(stCtx.tpstTasks[u32Index] == pstTask)
+    {
+      eArena = stCtx.teTaskArenas[u32Index];
+    }
+  }
+  return stCtx.tstArenas[eArena].pstHeap?&stCtx.tstArenas[eArena]:NULL;
+}
+
+/* mbedTLS allocator (CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC), the general heap is only
+   used before the arenas exist or when an arena is exhausted */
+void *esp_mbedtls_mem_calloc(size_t u32Count, size_t u32Size)
+{
+  void *pvBlock;
+  mem_arena_t *pstArena;
+
+  pvBlock = NULL;
+  pstArena = _app_mem_get_task_arena();
+  if(pstArena && u32Size && (u32Count <= (SIZE_MAX / u32Size)))
+  {
+    pvBlock = multi_heap_malloc(pstArena->pstHeap, u32Count * u32Size);
+    if(pvBlock)
+    {
+      memset(pvBlock, 0x00, u32Count * u32Size);
+    }
+    else
+    {
+      /* TLS tasks of both cores can fall back at once */
+      portENTER_CRITICAL(&pstArena->stLock);
+      pstArena->u32Fallbacks++;
+      portEXIT_CRITICAL(&pstArena->stLock);
+    }
+  }
+  if(NULL == pvBlock)
+  {
+    pvBlock = heap_caps_calloc(u32Count, u32Size, APP_MEM_HEAP_CAPS);
+  }
+  return pvBlock;
+}
+
+void esp_mbedtls_mem_free(void *pvBlock)
+{
+  uint32_t u32Index;
+  mem_arena_t *pstArena;
+
+  for(u32Index = 0; (u32Index < APP_MEM_ARENA_COUNT) && pvBlock; u32Index++)
+  {
+    pstArena = &stCtx.tstArenas[u32Index];
+    if(((uint8_t *)pvBlock >= pstArena->pu08Start) &&
+       ((uint8_t *)pvBlock < (pstArena->pu08Start + pstArena->u32Size)))
+    {
+      multi_heap_free(pstArena->pstHeap, pvBlock);
+      pvBlock = NULL;
+    }
+  }
+  if(pvBlock)
+  {
+    heap_caps_free(pvBlock);
+  }
+}
+
+void app_mem_get_report(app_mem_report_t *pstReport)
+{
+  uint32_t u32Index;
+  multi_heap_info_t stInfo;
+
+  if(pstReport)
+  {
+    memset(pstReport, 0x00, sizeof(app_mem_report_t));
+    heap_caps_get_info(&stInfo, APP_MEM_HEAP_CAPS);
+    pstReport->u32HeapFree = stInfo.total_free_bytes;
+    pstReport->u32HeapMinFree = stInfo.minimum_free_bytes;
+    pstReport->u32HeapLargestFreeBlock = stInfo.largest_free_block;
+    pstReport->u32FragmentationPermille = stInfo.total_free_bytes?
+      (1000 - (uint32_t)(((uint64_t)stInfo.largest_free_block * 1000) / stInfo.total_free_bytes)):0;
+    /* Lifetime marks only move when a report is taken */
+    portENTER_CRITICAL(&stCtx.stLock);
+    if(stInfo.largest_free_block < stCtx.u32HeapMinLargestFreeBlock)
+    {
+      stCtx.u32HeapMinLargestFreeBlock = stInfo.largest_free_block;
+    }
+    if(pstReport->u32FragmentationPermille > stCtx.u32MaxFragmentationPermille)
+    {
+      stCtx.u32MaxFragmentationPermille = pstReport->u32FragmentationPermille;
+    }
+    pstReport->u32HeapMinLargestFreeBlock = stCtx.u32HeapMinLargestFreeBlock;
+    pstReport->u32MaxFragmentationPermille = stCtx.u32MaxFragmentationPermille;
+    portEXIT_CRITICAL(&stCtx.stLock);
+    for(u32Index = 0; u32Index < APP_MEM_ARENA_COUNT; u32Index++)
+    {
+      if(stCtx.tstArenas[u32Index].pstHeap)
+      {
+        multi_heap_get_info(stCtx.tstArenas[u32Index].pstHeap, &stInfo);
+        pstReport->tstArenas[u32Index].u32Size = stCtx.tstArenas[u32Index].u32Size;
+        pstReport->tstArenas[u32Index].u32Free = stInfo.total_free_bytes;
+        pstReport->tstArenas[u32Index].u32LargestFreeBlock = stInfo.largest_free_block;
+        pstReport->tstArenas[u32Index].u32PeakUsed = stCtx.tstArenas[u32Index].u32Size - stInfo.minimum_free_bytes;
+        portENTER_CRITICAL(&stCtx.tstArenas[u32Index].stLock);
+        pstReport->tstArenas[u32Index].u32Fallbacks = stCtx.tstArenas[u32Index].u32Fallbacks;
+        portEXIT_CRITICAL(&stCtx.tstArenas[u32Index].stLock);
+      }
+    }
+  }
+}
+
+void app_mem_log_report(void)
+{
+  uint32_t u32Index;
+  app_mem_report_t stReport;
+
+  app_mem_get_report(&stReport);
+  ESP_LOGI(APP_MEM_TAG,
+           "heap free: %d (min: %d), largest block: %d (min: %d), fragmentation: %d.%d%% (max: %d.%d%%)",
+           stReport.u32HeapFree,
+           stReport.u32HeapMinFree,
+           stReport.u32HeapLargestFreeBlock,
+           stReport.u32HeapMinLargestFreeBlock,
+           stReport.u32FragmentationPermille / 10,
+           stReport.u32FragmentationPermille % 10,
+           stReport.u32MaxFragmentationPermille / 10,
+           stReport.u32MaxFragmentationPermille % 10);
+  for(u32Index = 0; u32Index < APP_MEM_ARENA_COUNT; u32Index++)
+  {
+    ESP_LOGI(APP_MEM_TAG,
+             "%s arena: %d free of %d, largest block: %d, peak: %d, fallbacks: %d",
+             tpcArenaNames[u32Index],
+             stReport.tstArenas[u32Index].u32Free,
+             stReport.tstArenas[u32Index].u32Size,
+             stReport.tstArenas[u32Index].u32LargestFreeBlock,
+             stReport.tstArenas[u32Index].u32PeakUsed,
+             stReport.tstArenas[u32Index].u32Fallbacks);
+  }
+}
\ No newline at end of file
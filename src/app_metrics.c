@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_wifi.h>
+#include <esp_http_server.h>
+
+#include "app_conn.h"
+#include "app_doc.h"
+#include "app_mem.h"
+#include "app_ota.h"
+#include "app_wifi.h"
+#include "app_journal.h"
+#include "app_lane.h"
+#include "app_access.h"
+#include "app_metrics.h"
+
+#define APP_METRICS_TAG                          "APP_METRICS"
+
+#define APP_METRICS_DOCUMENT_PREFIX              "/telemetry/rfid-node"
+#define APP_METRICS_PATH_MAX_SIZE                (sizeof(APP_METRICS_DOCUMENT_PREFIX) + 7)
+#define APP_METRICS_BODY_MAX_SIZE                1344
+#define APP_METRICS_UPLOAD_PERIOD_MS             CONFIG_RFID_METRICS_PERIOD_MS
+
+#define APP_METRICS_HTTP_PORT                    CONFIG_RFID_METRICS_HTTP_PORT
+#define APP_METRICS_HTTP_URI                     "/metrics"
+#define APP_METRICS_HTTP_CONTENT_TYPE            "text/plain; version=0.0.4"
+#define APP_METRICS_HTTP_CORE                    0
+#define APP_METRICS_HTTP_PRIORITY                2
+#define APP_METRICS_HTTP_STACK_SIZE              4096
+#define APP_METRICS_HTTP_MAX_SOCKETS             2
+/* Lines are gathered and sent in chunks of this size */
+#define APP_METRICS_PAGE_MAX_SIZE                512
+#define APP_METRICS_LINE_MAX_SIZE                160
+
+#define APP_METRICS_P90                          90
+
+_Static_assert(APP_METRICS_LINE_MAX_SIZE <= APP_METRICS_PAGE_MAX_SIZE, "A line has to fit in a page");
+
+typedef struct
+{
+  /* Prometheus name, field of the telemetry document and help text */
+  const char *pcName;
+  const char *pcField;
+  const char *pcHelp;
+}metrics_desc_t;
+
+/* Written only with interrupts masked on its own core, so there's never more
+   than one writer and no lock between cores */
+typedef struct
+{
+  uint32_t tu32Counters[APP_METRICS_COUNTER_COUNT];
+  uint32_t ttu32Buckets[APP_METRICS_HIST_COUNT][APP_METRICS_BUCKETS];
+  uint64_t tu64Sums[APP_METRICS_HIST_COUNT];
+}metrics_shard_t;
+
+typedef struct
+{
+  metrics_shard_t tstShards[portNUM_PROCESSORS];
+  app_ring_t *pstRing;
+  httpd_handle_t pstServer;
+  esp_err_t s32PageError;
+  uint32_t u32PageLength;
+  char tcPage[APP_METRICS_PAGE_MAX_SIZE];
+  int64_t s64LastUploadUs;
+  int64_t s64NextUploadUs;
+  app_metrics_snapshot_t stLastUpload;
+  char tcPath[APP_METRICS_PATH_MAX_SIZE];
+  char tcBody[APP_METRICS_BODY_MAX_SIZE];
+}metrics_ctx_t;
+
+static const metrics_desc_t tstCounters[APP_METRICS_COUNTER_COUNT] =
+{
+  [APP_METRICS_SCANS]            = {"rfid_scans_total", "scans", "Reads accepted by the tag handler"},
+  [APP_METRICS_SCANS_SUPPRESSED] = {"rfid_scans_suppressed_total", "suppressed", "Reads of a badge still in front of a reader"},
+  [APP_METRICS_SCANS_UPLOADED]   = {"rfid_scans_uploaded_total", "uploaded", "Scans acknowledged by Firestore or the gateway"},
+  [APP_METRICS_UPLOADS]          = {"rfid_uploads_total", "uploads", "Successful document updates, commits and gateway frames"},
+  [APP_METRICS_UPLOAD_FAILURES]  = {"rfid_upload_failures_total", "uploadFailures", "Failed uploads, their scans were journaled"},
+  [APP_METRICS_SCANS_DROPPED]    = {"rfid_scans_dropped_total", "dropped", "Reads lost to a full tag ring"},
+  [APP_METRICS_OTA_CHECKS]       = {"rfid_ota_checks_total", "otaChecks", "Firmware update checks"},
+  [APP_METRICS_TLS_HANDSHAKES]   = {"rfid_tls_handshakes_total", "handshakes", "TLS handshakes of the Firestore connection"},
+  [APP_METRICS_WIFI_DISCONNECTS] = {"rfid_wifi_disconnects_total", "disconnects", "Lost Wi-Fi connections"},
+  [APP_METRICS_LATE_TURNS]       = {"rfid_late_upload_turns_total", "lateTurns", "Upload turns taken past the deadline of their lane"},
+  [APP_METRICS_ACCESS_HITS]      = {"rfid_access_cache_hits_total", "accessHits", "Access decisions taken from the cache"},
+  [APP_METRICS_ACCESS_MISSES]    = {"rfid_access_cache_misses_total", "accessMisses", "Access decisions that looked the tag up"},
+  [APP_METRICS_ACCESS_BUSY]      = {"rfid_access_index_busy_total", "accessIndexBusy", "Cache misses decided while the tag index was busy"},
+};
+
+static const metrics_desc_t tstGauges[APP_METRICS_GAUGE_COUNT] =
+{
+  [APP_METRICS_QUEUE_HIGH_WATER]        = {"rfid_queue_high_water", "queueHighWater", "Most reads waiting in the tag ring since boot"},
+  [APP_METRICS_JOURNALED]               = {"rfid_journaled_scans", "journaled", "Scans waiting in the journal"},
+  [APP_METRICS_HEAP_FREE]               = {"rfid_heap_free_bytes", "heapFree", "Free internal heap"},
+  [APP_METRICS_HEAP_MIN_FREE]           = {"rfid_heap_min_free_bytes", "heapMinFree", "Lowest free internal heap since boot"},
+  [APP_METRICS_HEAP_LARGEST_FREE_BLOCK] = {"rfid_heap_largest_free_block_bytes", "heapLargestBlock", "Largest free block of the internal heap"},
+  [APP_METRICS_WIFI_RSSI]               = {"rfid_wifi_rssi_dbm", "rssi", "Signal strength of the AP, 0 while disconnected"},
+  [APP_METRICS_UPTIME]                  = {"rfid_uptime_seconds", "uptime", "Time since boot"},
+  [APP_METRICS_ACCESS_MAX_DECISION]     = {"rfid_access_max_decision_us", "accessMaxDecisionUs", "Longest time from a read to its access decision"},
+};
+
+/* The document only holds the 90th percentile of each histogram since the
+   previous document */
+static const metrics_desc_t tstHists[APP_METRICS_HIST_COUNT] =
+{
+  [APP_METRICS_UPLOAD_LATENCY] = {"rfid_upload_latency_ms", "uploadLatencyP90Ms", "Time from the read to the acknowledgment of its upload"},
+  [APP_METRICS_ALERT_LATENCY]  = {"rfid_alert_latency_ms", "alertLatencyP90Ms", "Same for the reads of unknown tags"},
+  [APP_METRICS_OTA_CHECK]      = {"rfid_ota_check_ms", "otaCheckP90Ms", "Duration of a firmware update check"},
+};
+
+static const uint32_t ttu32Bounds[APP_METRICS_HIST_COUNT][APP_METRICS_BUCKETS - 1] =
+{
+  [APP_METRICS_UPLOAD_LATENCY] = {25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000},
+  [APP_METRICS_ALERT_LATENCY]  = {25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000},
+  [APP_METRICS_OTA_CHECK]      = {100, 250, 500, 1000, 2000, 3000, 5000, 10000, 20000, 30000, 60000},
+};
+
+static metrics_ctx_t stCtx;
+
+/* Hot path: a masked increment on the calling core */
+void app_metrics_add(app_metrics_counter_t eCounter, uint32_t u32Value)
+{
+  uint32_t u32State;
+
+  if(eCounter < APP_METRICS_COUNTER_COUNT)
+  {
+    u32State = portSET_INTERRUPT_MASK_FROM_ISR();
+    stCtx.tstShards[xPortGetCoreID()].tu32Counters[eCounter] += u32Value;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(u32State);
+  }
+}
+
+/* Hot path: the bucket is found before masking, at most one compare per bound */
+void app_metrics_record(app_metrics_hist_t eHist, uint32_t u32Value)
+{
+  uint32_t u32State;
+  uint32_t u32Bucket;
+  metrics_shard_t *pstShard;
+
+  if(eHist < APP_METRICS_HIST_COUNT)
+  {
+    for(u32Bucket = 0;
+        (u32Bucket < (APP_METRICS_BUCKETS - 1)) && (u32Value > ttu32Bounds[eHist][u32Bucket]);
+        u32Bucket++);
+    u32State = portSET_INTERRUPT_MASK_FROM_ISR();
+    pstShard = &stCtx.tstShards[xPortGetCoreID()];
+    pstShard->ttu32Buckets[eHist][u32Bucket]++;
+    pstShard->tu64Sums[eHist] += u32Value;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(u32State);
+  }
+}
+
+/* Sum the shards and read the rest from the modules that own it, a shard
+   written meanwhile is at most one sample off */
+void app_metrics_get_snapshot(app_metrics_snapshot_t *pstSnapshot)
+{
+  uint32_t u32Core;
+  uint32_t u32Index;
+  uint32_t u32Bucket;
+  app_ring_stats_t stRingStats;
+  app_conn_stats_t stConnStats;
+  app_wifi_stats_t stWifiStats;
+  app_ota_stats_t stOtaStats;
+  app_mem_report_t stMemReport;
+  app_lane_stats_t stLaneStats;
+  app_access_stats_t stAccessStats;
+  wifi_ap_record_t stApInfo;
+  app_metrics_hist_snapshot_t *pstHist;
+
+  if(pstSnapshot)
+  {
+    memset(pstSnapshot, 0x00, sizeof(app_metrics_snapshot_t));
+    for(u32Core = 0; u32Core < portNUM_PROCESSORS; u32Core++)
+    {
+      for(u32Index = 0; u32Index < APP_METRICS_COUNTER_COUNT; u32Index++)
+      {
+        pstSnapshot->tu32Counters[u32Index] += stCtx.tstShards[u32Core].tu32Counters[u32Index];
+      }
+      for(u32Index = 0; u32Index < APP_METRICS_HIST_COUNT; u32Index++)
+      {
+        pstHist = &pstSnapshot->tstHists[u32Index];
+        for(u32Bucket = 0; u32Bucket < APP_METRICS_BUCKETS; u32Bucket++)
+        {
+          pstHist->tu32Buckets[u32Bucket] += stCtx.tstShards[u32Core].ttu32Buckets[u32Index][u32Bucket];
+          pstHist->u32Count += stCtx.tstShards[u32Core].ttu32Buckets[u32Index][u32Bucket];
+        }
+        pstHist->u64Sum += stCtx.tstShards[u32Core].tu64Sums[u32Index];
+      }
+    }
+    if(stCtx.pstRing)
+    {
+      app_ring_get_stats(stCtx.pstRing, &stRingStats);
+      pstSnapshot->tu32Counters[APP_METRICS_SCANS_DROPPED] = stRingStats.u32DroppedOldest + stRingStats.u32DroppedNewest;
+      pstSnapshot->ts32Gauges[APP_METRICS_QUEUE_HIGH_WATER] = stRingStats.u32HighWater;
+    }
+    app_ota_get_stats(&stOtaStats);
+    pstSnapshot->tu32Counters[APP_METRICS_OTA_CHECKS] = stOtaStats.u32Checks;
+    app_conn_get_stats(&stConnStats);
+    pstSnapshot->tu32Counters[APP_METRICS_TLS_HANDSHAKES] = stConnStats.u32Handshakes;
+    app_wifi_get_stats(&stWifiStats);
+    pstSnapshot->tu32Counters[APP_METRICS_WIFI_DISCONNECTS] = stWifiStats.u32Disconnects;
+    for(u32Index = 0; u32Index < APP_LANE_COUNT; u32Index++)
+    {
+      app_lane_get_stats(u32Index, &stLaneStats);
+      pstSnapshot->tu32Counters[APP_METRICS_LATE_TURNS] += stLaneStats.u32LateTurns;
+    }
+    app_access_get_stats(&stAccessStats);
+    pstSnapshot->tu32Counters[APP_METRICS_ACCESS_HITS] = stAccessStats.u32Hits;
+    pstSnapshot->tu32Counters[APP_METRICS_ACCESS_MISSES] = stAccessStats.u32Misses;
+    pstSnapshot->tu32Counters[APP_METRICS_ACCESS_BUSY]      = stAccessStats.u32Unavailable;
+    pstSnapshot->ts32Gauges[APP_METRICS_ACCESS_MAX_DECISION] = stAccessStats.u32MaxDecisionUs;
+    pstSnapshot->ts32Gauges[APP_METRICS_JOURNALED] = app_journal_count();
+    app_mem_get_report(&stMemReport);
+    pstSnapshot->ts32Gauges[APP_METRICS_HEAP_FREE] = stMemReport.u32HeapFree;
+    pstSnapshot->ts32Gauges[APP_METRICS_HEAP_MIN_FREE] = stMemReport.u32HeapMinFree;
+    pstSnapshot->ts32Gauges[APP_METRICS_HEAP_LARGEST_FREE_BLOCK] = stMemReport.u32HeapLargestFreeBlock;
+    if(app_wifi_is_connected() && (ESP_OK == esp_wifi_sta_get_ap_info(&stApInfo)))
+    {
+      pstSnapshot->ts32Gauges[APP_METRICS_WIFI_RSSI] = stApInfo.rssi;
+    }
+    pstSnapshot->ts32Gauges[APP_METRICS_UPTIME] = esp_timer_get_time() / 1000000LL;
+  }
+}
+
+/* Upper bound of the bucket holding the percentile of the samples recorded
+   between two snapshots, the last bound for the overflow bucket */
+static uint32_t _app_metrics_percentile(app_metrics_hist_t eHist,
+                                        const app_metrics_hist_snapshot_t *pstNow,
+                                        const app_metrics_hist_snapshot_t *pstBefore,
+                                        uint32_t u32Percent)
+{
+  uint32_t u32Rank;
+  uint32_t u32Count;
+  uint32_t u32Bucket;
+
+  u32Count = 0;
+  u32Rank = (((pstNow->u32Count - pstBefore->u32Count) * u32Percent) + 99) / 100;
+  for(u32Bucket = 0; u32Bucket < (APP_METRICS_BUCKETS - 2); u32Bucket++)
+  {
+    u32Count += pstNow->tu32Buckets[u32Bucket] - pstBefore->tu32Buckets[u32Bucket];
+    if(u32Count >= u32Rank)
+    {
+      break;
+    }
+  }
+  return u32Rank?ttu32Bounds[eHist][u32Bucket]:0;
+}
+
+static void _app_metrics_write_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  uint32_t u32Index;
+  int64_t s64ElapsedMs;
+  const app_metrics_snapshot_t *pstSnapshot;
+
+  pstSnapshot = (const app_metrics_snapshot_t *)pvArg;
+  for(u32Index = 0; u32Index < APP_METRICS_COUNTER_COUNT; u32Index++)
+  {
+    app_doc_add_integer(pstDoc, tstCounters[u32Index].pcField, pstSnapshot->tu32Counters[u32Index]);
+  }
+  for(u32Index = 0; u32Index < APP_METRICS_GAUGE_COUNT; u32Index++)
+  {
+    app_doc_add_integer(pstDoc, tstGauges[u32Index].pcField, pstSnapshot->ts32Gauges[u32Index]);
+  }
+  for(u32Index = 0; u32Index < APP_METRICS_HIST_COUNT; u32Index++)
+  {
+    app_doc_add_integer(pstDoc,
+                        tstHists[u32Index].pcField,
+                        _app_metrics_percentile(u32Index,
+                                                &pstSnapshot->tstHists[u32Index],
+                                                &stCtx.stLastUpload.tstHists[u32Index],
+                                                APP_METRICS_P90));
+  }
+  s64ElapsedMs = (esp_timer_get_time() - stCtx.s64LastUploadUs) / 1000;
+  app_doc_add_integer(pstDoc,
+                      "scansPerMinute",
+                      s64ElapsedMs?(((int64_t)(pstSnapshot->tu32Counters[APP_METRICS_SCANS] -
+                                               stCtx.stLastUpload.tu32Counters[APP_METRICS_SCANS]) * 60000) /
+                                    s64ElapsedMs):0);
+}
+
+/* When the telemetry document is due, in esp_timer time */
+int64_t app_metrics_get_due_us(void)
+{
+  return stCtx.s64NextUploadUs;
+}
+
+/* Update the telemetry document of the node, rates and percentiles cover the
+   time since the last successful update. Called from the upload task when its
+   telemetry lane gets a turn, a failed update waits for the next period */
+esp_err_t app_metrics_upload(void)
+{
+  int s32HttpCode;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+  app_doc_t stDoc;
+  app_metrics_snapshot_t stSnapshot;
+
+  app_metrics_get_snapshot(&stSnapshot);
+  app_doc_init(&stDoc, stCtx.tcBody, sizeof(stCtx.tcBody), NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, _app_metrics_write_fields, &stSnapshot);
+  app_doc_end_object(&stDoc);
+  s32RetVal = app_doc_finish(&stDoc, &u32Length);
+  if(ESP_OK == s32RetVal)
+  {
+    s32RetVal = app_conn_request(HTTP_METHOD_PATCH,
+                                 stCtx.tcPath,
+                                 stCtx.tcBody,
+                                 u32Length,
+                                 NULL,
+                                 NULL,
+                                 &s32HttpCode);
+    s32RetVal = ((ESP_OK == s32RetVal) && (200 != s32HttpCode))?ESP_FAIL:s32RetVal;
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    memcpy(&stCtx.stLastUpload, &stSnapshot, sizeof(app_metrics_snapshot_t));
+    stCtx.s64LastUploadUs = esp_timer_get_time();
+  }
+  else
+  {
+    ESP_LOGW(APP_METRICS_TAG, "Couldn't update telemetry document");
+  }
+  stCtx.s64NextUploadUs = esp_timer_get_time() + (APP_METRICS_UPLOAD_PERIOD_MS * 1000LL);
+  return s32RetVal;
+}
+
+static void _app_metrics_flush(httpd_req_t *pstReq)
+{
+  if((ESP_OK == stCtx.s32PageError) && stCtx.u32PageLength)
+  {
+    stCtx.s32PageError = httpd_resp_send_chunk(pstReq, stCtx.tcPage, stCtx.u32PageLength);
+  }
+  stCtx.u32PageLength = 0;
+}
+
+/* Lines longer than APP_METRICS_LINE_MAX_SIZE are cut */
+static void _app_metrics_print(httpd_req_t *pstReq, const char *pcFormat, ...)
+{
+  int s32Length;
+  va_list stArgs;
+
+  if((sizeof(stCtx.tcPage) - stCtx.u32PageLength) < APP_METRICS_LINE_MAX_SIZE)
+  {
+    _app_metrics_flush(pstReq);
+  }
+  va_start(stArgs, pcFormat);
+  s32Length = vsnprintf(&stCtx.tcPage[stCtx.u32PageLength], APP_METRICS_LINE_MAX_SIZE, pcFormat, stArgs);
+  va_end(stArgs);
+  if(s32Length > 0)
+  {
+    stCtx.u32PageLength += (s32Length < APP_METRICS_LINE_MAX_SIZE)?s32Length:(APP_METRICS_LINE_MAX_SIZE - 1);
+  }
+}
+
+static void _app_metrics_print_header(httpd_req_t *pstReq, const metrics_desc_t *pstDesc, const char *pcType)
+{
+  _app_metrics_print(pstReq, "# HELP %s %s\n", pstDesc->pcName, pstDesc->pcHelp);
+  _app_metrics_print(pstReq, "# TYPE %s %s\n", pstDesc->pcName, pcType);
+}
+
+/* Runs in the server task, one request at a time */
+static esp_err_t _app_metrics_http_handler(httpd_req_t *pstReq)
+{
+  uint32_t u32Index;
+  uint32_t u32Bucket;
+  uint32_t u32Count;
+  app_metrics_snapshot_t stSnapshot;
+
+  app_metrics_get_snapshot(&stSnapshot);
+  stCtx.s32PageError = httpd_resp_set_type(pstReq, APP_METRICS_HTTP_CONTENT_TYPE);
+  stCtx.u32PageLength = 0;
+  for(u32Index = 0; u32Index < APP_METRICS_COUNTER_COUNT; u32Index++)
+  {
+    _app_metrics_print_header(pstReq, &tstCounters[u32Index], "counter");
+    _app_metrics_print(pstReq, "%s %u\n", tstCounters[u32Index].pcName, stSnapshot.tu32Counters[u32Index]);
+  }
+  for(u32Index = 0; u32Index < APP_METRICS_GAUGE_COUNT; u32Index++)
+  {
+    _app_metrics_print_header(pstReq, &tstGauges[u32Index], "gauge");
+    _app_metrics_print(pstReq, "%s %d\n", tstGauges[u32Index].pcName, stSnapshot.ts32Gauges[u32Index]);
+  }
+  for(u32Index = 0; u32Index < APP_METRICS_HIST_COUNT; u32Index++)
+  {
+    _app_metrics_print_header(pstReq, &tstHists[u32Index], "histogram");
+    u32Count = 0;
+    for(u32Bucket = 0; u32Bucket < (APP_METRICS_BUCKETS - 1); u32Bucket++)
+    {
+      u32Count += stSnapshot.tstHists[u32Index].tu32Buckets[u32Bucket];
+      _app_metrics_print(pstReq,
+                         "%s_bucket{le=\"%u\"} %u\n",
+                         tstHists[u32Index].pcName,
+                         ttu32Bounds[u32Index][u32Bucket],
+                         u32Count);
+    }
+    _app_metrics_print(pstReq,
+                       "%s_bucket{le=\"+Inf\"} %u\n",
+                       tstHists[u32Index].pcName,
+                       stSnapshot.tstHists[u32Index].u32Count);
+    _app_metrics_print(pstReq, "%s_sum %llu\n", tstHists[u32Index].pcName, stSnapshot.tstHists[u32Index].u64Sum);
+    _app_metrics_print(pstReq, "%s_count %u\n", tstHists[u32Index].pcName, stSnapshot.tstHists[u32Index].u32Count);
+  }
+  _app_metrics_flush(pstReq);
+  if(ESP_OK == stCtx.s32PageError)
+  {
+    stCtx.s32PageError = httpd_resp_send_chunk(pstReq, NULL, 0);
+  }
+  return stCtx.s32PageError;
+}
+
+static void _app_metrics_start_server(void)
+{
+  httpd_config_t stConfig = HTTPD_DEFAULT_CONFIG();
+  httpd_uri_t stUri =
+  {
+    .uri = APP_METRICS_HTTP_URI,
+    .method = HTTP_GET,
+    .handler = _app_metrics_http_handler,
+    .user_ctx = NULL,
+  };
+
+  /* Scrapes are served next to the network stack and below the uploads */
+  stConfig.server_port = APP_METRICS_HTTP_PORT;
+  stConfig.core_id = APP_METRICS_HTTP_CORE;
+  stConfig.task_priority = APP_METRICS_HTTP_PRIORITY;
+  stConfig.stack_size = APP_METRICS_HTTP_STACK_SIZE;
+  stConfig.max_open_sockets = APP_METRICS_HTTP_MAX_SOCKETS;
+  stConfig.max_uri_handlers = 1;
+  stConfig.lru_purge_enable = true;
+  if(ESP_OK == httpd_start(&stCtx.pstServer, &stConfig))
+  {
+    httpd_register_uri_handler(stCtx.pstServer, &stUri);
+    ESP_LOGI(APP_METRICS_TAG, "Serving metrics on port %d", APP_METRICS_HTTP_PORT);
+  }
+  else
+  {
+    ESP_LOGE(APP_METRICS_TAG, "Couldn't start the metrics server");
+  }
+}
+
+/* pstRing is the tag ring whose high-water mark and drops are reported */
+void app_metrics_start(app_ring_t *pstRing)
+{
+  uint8_t tu08Mac[6];
+
+  stCtx.pstRing = pstRing;
+  esp_read_mac(tu08Mac, ESP_MAC_WIFI_STA);
+  snprintf(stCtx.tcPath,
+           sizeof(stCtx.tcPath),
+           APP_METRICS_DOCUMENT_PREFIX"-%02X%02X%02X",
+           tu08Mac[3],
+           tu08Mac[4],
+           tu08Mac[5]);
+  stCtx.s64LastUploadUs = esp_timer_get_time();
+  stCtx.s64NextUploadUs = stCtx.s64LastUploadUs + (APP_METRICS_UPLOAD_PERIOD_MS * 1000LL);
+#if APP_METRICS_HTTP_PORT
+  _app_metrics_start_server();
+#endif
+}
\ No newline at end of file
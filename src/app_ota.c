@@ -1,16 +1,25 @@
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include <sdkconfig.h>
 #include <esp_system.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_http_client.h>
-#include <esp_https_ota.h>
-
-#include <cJSON.h>
+#include <esp_ota_ops.h>
+#include <nvs.h>
 
 #include "app_wifi.h"
+#include "app_json.h"
+#include "app_patch.h"
+#include "app_mem.h"
+#include "app_metrics.h"
+#include "app_sched.h"
+#include "app_ota.h"
 
 #define APP_OTA_TAG                              "APP_OTA"
 
@@ -20,13 +29,28 @@
 #define APP_OTA_GITHUB_REPOSITORY                "firestore-rfid-node"
 #define APP_OTA_DEVICE_CURRENT_FW_VERSION        APP_VERSION
 
-#define APP_OTA_HTTP_INTERNAL_TX_BUFFER_SIZE     1024
-#define APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE     1024
-#define APP_OTA_HTTP_APP_RX_BUFFER_SIZE          1024
+#define APP_OTA_HTTP_INTERNAL_TX_BUFFER_SIZE     CONFIG_RFID_OTA_HTTP_TX_BUFFER_SIZE
+#define APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE     CONFIG_RFID_OTA_HTTP_RX_BUFFER_SIZE
+
+#define APP_OTA_URL_MAX_SIZE                     256
+#define APP_OTA_MAX_REDIRECTS                    3
+#define APP_OTA_VERSION_MAX_SIZE                 32
+#define APP_OTA_ETAG_MAX_SIZE                    80
+#define APP_OTA_DATE_MAX_SIZE                    40
+
+/* esp_http_client builds the request line in the TX buffer and fails when it's longer */
+_Static_assert(APP_OTA_HTTP_INTERNAL_TX_BUFFER_SIZE >= APP_OTA_URL_MAX_SIZE + sizeof("HEAD  HTTP/1.1\r\n"),
+               "OTA HTTP TX buffer can't hold the request line of the longest URL");
 
-#define APP_OTA_TASK_STACK_SIZE                  8192
-#define APP_OTA_TASK_PRIORITY                    6
-#define APP_OTA_TASK_PERIOD_MS                   60*1000
+#define APP_OTA_TASK_PERIOD_MS                   CONFIG_RFID_OTA_CHECK_PERIOD_MS
+#define APP_OTA_TASK_MAX_PERIOD_MS               (6 * 60 * 60 * 1000)
+#define APP_OTA_POSTPONE_MS                      5000
+#define APP_OTA_POSTPONE_MAX_COUNT               12
+
+#define APP_OTA_NVS_NAMESPACE                    "app_ota"
+#define APP_OTA_NVS_VERSION_KEY                  "version"
+#define APP_OTA_NVS_ETAG_KEY                     "etag"
+#define APP_OTA_NVS_MODIFIED_KEY                 "modified"
 
 static const char *pcApiUrl = APP_OTA_BASE_URL APP_OTA_ENDPOINT
                               "?github_username="APP_OTA_GITHUB_USERNAME
@@ -41,8 +65,141 @@ extern const char tcGithubReleaseCertPemEnd[] asm("_binary_github_cert_pem_end")
 extern const char tcHerokuCertPemStart[] asm("_binary_heroku_cert_pem_start");
 extern const char tcHerokuCertPemEnd[] asm("_binary_heroku_cert_pem_end");
 
-/* HTTP receive buffer */
-char tcHttpRcvBuffer[APP_OTA_HTTP_APP_RX_BUFFER_SIZE];
+typedef struct
+{
+  char tcETag[APP_OTA_ETAG_MAX_SIZE];
+  char tcLastModified[APP_OTA_DATE_MAX_SIZE];
+}ota_validators_t;
+
+typedef struct
+{
+  app_json_t stJson;
+  uint32_t u32Size;
+  char tcValue[APP_OTA_URL_MAX_SIZE];
+  char tcDownloadUrl[APP_OTA_URL_MAX_SIZE];
+  char tcDeltaUrl[APP_OTA_URL_MAX_SIZE];
+  char tcVersion[APP_OTA_VERSION_MAX_SIZE];
+  ota_validators_t stReceived;
+}ota_response_t;
+
+typedef struct
+{
+  ota_response_t stResponse;
+  ota_validators_t stCached;
+  uint32_t u32PeriodMs;
+  app_ota_busy_cb_t pfBusy;
+  app_ota_stats_t stStats;
+  esp_http_client_handle_t pstCheckClient;
+  uint8_t tu08Buffer[APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE];
+}ota_ctx_t;
+
+static ota_ctx_t stCtx;
+
+static const char *const tpcDownloadUrlPath[] = {"download_url"};
+static const char *const tpcVersionPath[] = {"version"};
+static const char *const tpcDeltaUrlPath[] = {"delta_url"};
+static const char *const tpcSizePath[] = {"size"};
+
+/* Pick the fields of interest as they stream by, anything else is skipped */
+static void _app_ota_json_cb(const app_json_t *pstJson,
+                             app_json_type_t eType,
+                             const char *pcValue,
+                             uint32_t u32Length,
+                             void *pvArg)
+{
+  if(app_json_match(pstJson, tpcDownloadUrlPath, 1) && (APP_JSON_STRING == eType))
+  {
+    /* A truncated url is left empty so the update is skipped */
+    if(app_json_is_truncated(pstJson))
+    {
+      ESP_LOGW(APP_OTA_TAG, "download_url is longer than %d bytes", APP_OTA_URL_MAX_SIZE - 1);
+    }
+    else
+    {
+      memcpy(stCtx.stResponse.tcDownloadUrl, pcValue, u32Length + 1);
+    }
+  }
+  else if(app_json_match(pstJson, tpcDeltaUrlPath, 1) &&
+          (APP_JSON_STRING == eType) &&
+          !app_json_is_truncated(pstJson))
+  {
+    /* Optional patch against the running version, see tools/ota_patch.py */
+    memcpy(stCtx.stResponse.tcDeltaUrl, pcValue, u32Length + 1);
+  }
+  else if(app_json_match(pstJson, tpcVersionPath, 1) &&
+          (APP_JSON_STRING == eType) &&
+          (u32Length < sizeof(stCtx.stResponse.tcVersion)))
+  {
+    memcpy(stCtx.stResponse.tcVersion, pcValue, u32Length + 1);
+  }
+  else if(app_json_match(pstJson, tpcSizePath, 1) && (APP_JSON_NUMBER == eType))
+  {
+    stCtx.stResponse.u32Size = strtoul(pcValue, NULL, 10);
+  }
+}
+
+/* Keep the validators of the response, oversized ones are not cached */
+static void _app_ota_store_header(const char *pcKey, const char *pcValue)
+{
+  if((0 == strcasecmp(pcKey, "ETag")) &&
+     (strlen(pcValue) < sizeof(stCtx.stResponse.stReceived.tcETag)))
+  {
+    strcpy(stCtx.stResponse.stReceived.tcETag, pcValue);
+  }
+  else if((0 == strcasecmp(pcKey, "Last-Modified")) &&
+          (strlen(pcValue) < sizeof(stCtx.stResponse.stReceived.tcLastModified)))
+  {
+    strcpy(stCtx.stResponse.stReceived.tcLastModified, pcValue);
+  }
+}
+
+/* Validators are only valid for the firmware version they were received with
+   since that version is part of the query */
+static void _app_ota_load_validators(void)
+{
+  size_t u32Size;
+  nvs_handle_t u32Handle;
+  char tcVersion[APP_OTA_VERSION_MAX_SIZE];
+
+  memset(&stCtx.stCached, 0x00, sizeof(stCtx.stCached));
+  if(ESP_OK == nvs_open(APP_OTA_NVS_NAMESPACE, NVS_READONLY, &u32Handle))
+  {
+    u32Size = sizeof(tcVersion);
+    if((ESP_OK == nvs_get_str(u32Handle, APP_OTA_NVS_VERSION_KEY, tcVersion, &u32Size)) &&
+       (0 == strcmp(tcVersion, APP_OTA_DEVICE_CURRENT_FW_VERSION)))
+    {
+      u32Size = sizeof(stCtx.stCached.tcETag);
+      if(ESP_OK != nvs_get_str(u32Handle, APP_OTA_NVS_ETAG_KEY, stCtx.stCached.tcETag, &u32Size))
+      {
+        stCtx.stCached.tcETag[0] = '\0';
+      }
+      u32Size = sizeof(stCtx.stCached.tcLastModified);
+      if(ESP_OK != nvs_get_str(u32Handle, APP_OTA_NVS_MODIFIED_KEY, stCtx.stCached.tcLastModified, &u32Size))
+      {
+        stCtx.stCached.tcLastModified[0] = '\0';
+      }
+    }
+    nvs_close(u32Handle);
+  }
+}
+
+static void _app_ota_save_validators(const ota_validators_t *pstValidators)
+{
+  nvs_handle_t u32Handle;
+
+  if(memcmp(&stCtx.stCached, pstValidators, sizeof(ota_validators_t)))
+  {
+    memcpy(&stCtx.stCached, pstValidators, sizeof(ota_validators_t));
+    if(ESP_OK == nvs_open(APP_OTA_NVS_NAMESPACE, NVS_READWRITE, &u32Handle))
+    {
+      nvs_set_str(u32Handle, APP_OTA_NVS_VERSION_KEY, APP_OTA_DEVICE_CURRENT_FW_VERSION);
+      nvs_set_str(u32Handle, APP_OTA_NVS_ETAG_KEY, pstValidators->tcETag);
+      nvs_set_str(u32Handle, APP_OTA_NVS_MODIFIED_KEY, pstValidators->tcLastModified);
+      nvs_commit(u32Handle);
+      nvs_close(u32Handle);
+    }
+  }
+}
 
 static esp_err_t _app_ota_http_event_handler(esp_http_client_event_t *pstEvent)
 {
@@ -53,6 +210,7 @@ static esp_err_t _app_ota_http_event_handler(esp_http_client_event_t *pstEvent)
     break;
   case HTTP_EVENT_ON_CONNECTED:
     ESP_LOGD(APP_OTA_TAG, "HTTP connected to server");
+    stCtx.stStats.u32Handshakes++;
     break;
   case HTTP_EVENT_HEADERS_SENT:
     ESP_LOGD(APP_OTA_TAG, "All HTTP headers are sent to server");
@@ -60,13 +218,14 @@ static esp_err_t _app_ota_http_event_handler(esp_http_client_event_t *pstEvent)
   case HTTP_EVENT_ON_HEADER:
     ESP_LOGD(APP_OTA_TAG, "Received HTTP header from server");
     printf("%.*s", pstEvent->data_len, (char*)pstEvent->data);
+    stCtx.stStats.u32BytesReceived += strlen(pstEvent->header_key) + strlen(pstEvent->header_value);
+    _app_ota_store_header(pstEvent->header_key, pstEvent->header_value);
     break;
   case HTTP_EVENT_ON_DATA:
     ESP_LOGD(APP_OTA_TAG, "Received data from server, len=%d", pstEvent->data_len);
-    if(!esp_http_client_is_chunked_response(pstEvent->client))
-    {
-      strncpy(tcHttpRcvBuffer, (char*)pstEvent->data, pstEvent->data_len);
-    }
+    /* Chunked bodies are already decoded by the client, every piece is fed */
+    app_json_feed(&stCtx.stResponse.stJson, (const char *)pstEvent->data, pstEvent->data_len);
+    stCtx.stStats.u32BytesReceived += pstEvent->data_len;
     break;
   case HTTP_EVENT_ON_FINISH:
     ESP_LOGD(APP_OTA_TAG, "HTTP session is finished");
@@ -78,24 +237,52 @@ static esp_err_t _app_ota_http_event_handler(esp_http_client_event_t *pstEvent)
   return ESP_OK;
 }
 
-static char* _app_ota_get_download_url(void)
+/* Query the latest release, on success the download url is in stCtx */
+static esp_err_t _app_ota_get_download_url(void)
 {
   int s32HttpCode;
   esp_err_t s32RetVal;
-  char* pcDownloadUrl;
-  cJSON *pstJsonObject;
-  cJSON *pstJsonDownloadUrl;
+  const esp_partition_t *pstPartition;
   esp_http_client_handle_t pstClient;
 
-  pcDownloadUrl = NULL;
-  esp_http_client_config_t config =
+  memset(&stCtx.stResponse, 0x00, sizeof(stCtx.stResponse));
+  app_json_init(&stCtx.stResponse.stJson,
+                stCtx.stResponse.tcValue,
+                sizeof(stCtx.stResponse.tcValue),
+                _app_ota_json_cb,
+                NULL);
+  /* The client lives as long as the task so its buffers are not reallocated
+     on every check, only the connection is closed in between */
+  if(NULL == stCtx.pstCheckClient)
   {
-    .url = pcApiUrl,
-    .buffer_size = APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE,
-    .event_handler = _app_ota_http_event_handler,
-    .cert_pem = tcHerokuCertPemStart,
-  };
-  pstClient = esp_http_client_init(&config);
+    esp_http_client_config_t config =
+    {
+      .url = pcApiUrl,
+      .buffer_size = APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE,
+      .event_handler = _app_ota_http_event_handler,
+      .cert_pem = tcHerokuCertPemStart,
+    };
+    stCtx.pstCheckClient = esp_http_client_init(&config);
+  }
+  pstClient = stCtx.pstCheckClient;
+  /* Let the server answer 304 when nothing changed since the last check */
+  if(stCtx.stCached.tcETag[0])
+  {
+    esp_http_client_set_header(pstClient, "If-None-Match", stCtx.stCached.tcETag);
+  }
+  else
+  {
+    esp_http_client_delete_header(pstClient, "If-None-Match");
+  }
+  if(stCtx.stCached.tcLastModified[0])
+  {
+    esp_http_client_set_header(pstClient, "If-Modified-Since", stCtx.stCached.tcLastModified);
+  }
+  else
+  {
+    esp_http_client_delete_header(pstClient, "If-Modified-Since");
+  }
+  stCtx.stStats.u32Checks++;
   s32RetVal = esp_http_client_perform(pstClient);
   if(ESP_OK == s32RetVal)
   {
@@ -107,59 +294,195 @@ static char* _app_ota_get_download_url(void)
     if(204 == s32HttpCode)
     {
       ESP_LOGI(APP_OTA_TAG, "Device is already running the latest firmware");
+      _app_ota_save_validators(&stCtx.stResponse.stReceived);
+      s32RetVal = ESP_ERR_NOT_FOUND;
+    }
+    else if(304 == s32HttpCode)
+    {
+      ESP_LOGI(APP_OTA_TAG, "Latest firmware info is unchanged");
+      stCtx.stStats.u32NotModified++;
+      s32RetVal = ESP_ERR_NOT_FOUND;
     }
     else if(200 == s32HttpCode)
     {
-      ESP_LOGD(APP_OTA_TAG, "tcHttpRcvBuffer: %s\n", tcHttpRcvBuffer);
-      /* parse the http json respose */
-      pstJsonObject = cJSON_Parse(tcHttpRcvBuffer);
-      if(pstJsonObject == NULL)
+      /* Never answer 304 to a pending update in case installing it fails */
+      memset(&stCtx.stResponse.stReceived, 0x00, sizeof(ota_validators_t));
+      _app_ota_save_validators(&stCtx.stResponse.stReceived);
+      pstPartition = esp_ota_get_next_update_partition(NULL);
+      if(!app_json_is_done(&stCtx.stResponse.stJson))
       {
         ESP_LOGW(APP_OTA_TAG, "Response does not contain valid json, aborting...");
+        s32RetVal = ESP_ERR_INVALID_RESPONSE;
+      }
+      else if('\0' == stCtx.stResponse.tcDownloadUrl[0])
+      {
+        ESP_LOGW(APP_OTA_TAG, "Unable to read the download_url, aborting...");
+        s32RetVal = ESP_ERR_INVALID_RESPONSE;
+      }
+      else if(pstPartition && (stCtx.stResponse.u32Size > pstPartition->size))
+      {
+        ESP_LOGW(APP_OTA_TAG,
+                 "Firmware of %d bytes doesn't fit in %d bytes partition, aborting...",
+                 stCtx.stResponse.u32Size,
+                 pstPartition->size);
+        s32RetVal = ESP_ERR_INVALID_SIZE;
       }
       else
       {
-        pstJsonDownloadUrl = cJSON_GetObjectItemCaseSensitive(pstJsonObject, "download_url");
-        if(cJSON_IsString(pstJsonDownloadUrl) && (pstJsonDownloadUrl->valuestring != NULL))
-        {
-          pcDownloadUrl = pstJsonDownloadUrl->valuestring;
-          ESP_LOGD(APP_OTA_TAG, "download_url length: %d", strlen(pcDownloadUrl));
-        }
-        else
-        {
-          ESP_LOGW(APP_OTA_TAG, "Unable to read the download_url, aborting...");
-        }
+        ESP_LOGI(APP_OTA_TAG,
+                 "Firmware %s available, size: %d bytes",
+                 stCtx.stResponse.tcVersion[0]?stCtx.stResponse.tcVersion:"(unknown)",
+                 stCtx.stResponse.u32Size);
+        ESP_LOGD(APP_OTA_TAG, "download_url length: %d", strlen(stCtx.stResponse.tcDownloadUrl));
       }
     }
     else
     {
       ESP_LOGW(APP_OTA_TAG, "Failed to get URL with HTTP code: %d", s32HttpCode);
+      s32RetVal = ESP_FAIL;
+    }
+  }
+  esp_http_client_close(pstClient);
+  return s32RetVal;
+}
+
+/* Stream an image or a patch container into the inactive OTA slot, it is
+   decompressed and patched on the fly by app_patch */
+static esp_err_t _app_ota_download(const char *pcUrl)
+{
+  int s32Read;
+  int s32HttpCode;
+  bool bRedirected;
+  uint32_t u32Redirects;
+  esp_err_t s32RetVal;
+  esp_http_client_handle_t pstClient;
+
+  esp_http_client_config_t config =
+  {
+    .url = pcUrl,
+    .cert_pem = tcGithubReleaseCertPemStart,
+    .buffer_size = APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE,
+    .buffer_size_tx = APP_OTA_HTTP_INTERNAL_TX_BUFFER_SIZE,
+  };
+  s32HttpCode = 0;
+  u32Redirects = 0;
+  pstClient = esp_http_client_init(&config);
+  do
+  {
+    bRedirected = false;
+    s32RetVal = esp_http_client_open(pstClient, 0);
+    if(ESP_OK == s32RetVal)
+    {
+      esp_http_client_fetch_headers(pstClient);
+      s32HttpCode = esp_http_client_get_status_code(pstClient);
+      /* Release assets are served through a redirection */
+      if((s32HttpCode >= 301) && (s32HttpCode <= 308) && (u32Redirects++ < APP_OTA_MAX_REDIRECTS))
+      {
+        esp_http_client_set_redirection(pstClient);
+        esp_http_client_close(pstClient);
+        bRedirected = true;
+      }
+    }
+  }while(bRedirected);
+  if((ESP_OK == s32RetVal) && (200 != s32HttpCode))
+  {
+    ESP_LOGE(APP_OTA_TAG, "Download failed with HTTP code: %d", s32HttpCode);
+    s32RetVal = ESP_FAIL;
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    s32RetVal = app_patch_begin();
+    s32Read = 0;
+    while((ESP_OK == s32RetVal) &&
+          ((s32Read = esp_http_client_read(pstClient, (char *)stCtx.tu08Buffer, sizeof(stCtx.tu08Buffer))) > 0))
+    {
+      s32RetVal = app_patch_write(stCtx.tu08Buffer, s32Read);
+    }
+    if((ESP_OK == s32RetVal) && ((s32Read < 0) || !esp_http_client_is_complete_data_received(pstClient)))
+    {
+      ESP_LOGE(APP_OTA_TAG, "Download was interrupted");
+      s32RetVal = ESP_FAIL;
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = app_patch_end();
+    }
+    else
+    {
+      app_patch_abort();
     }
   }
+  esp_http_client_close(pstClient);
   esp_http_client_cleanup(pstClient);
-  return pcDownloadUrl;
+  return s32RetVal;
+}
+
+/* Wait while scans are queued, up to a bound so updates can't be starved */
+static void _app_ota_postpone(void)
+{
+  uint32_t u32Count;
+
+  for(u32Count = 0;
+      stCtx.pfBusy && stCtx.pfBusy() && (u32Count < APP_OTA_POSTPONE_MAX_COUNT);
+      u32Count++)
+  {
+    stCtx.stStats.u32Postponed++;
+    vTaskDelay(pdMS_TO_TICKS(APP_OTA_POSTPONE_MS));
+  }
+}
+
+/* The period doubles every time there's no update up to a maximum, the delay
+   is spread by +/-25% so nodes powered up together don't poll together */
+static TickType_t _app_ota_get_delay(esp_err_t s32Status)
+{
+  uint32_t u32DelayMs;
+
+  if(ESP_ERR_NOT_FOUND == s32Status)
+  {
+    stCtx.u32PeriodMs = (stCtx.u32PeriodMs < (APP_OTA_TASK_MAX_PERIOD_MS / 2))?
+                        (2 * stCtx.u32PeriodMs):APP_OTA_TASK_MAX_PERIOD_MS;
+  }
+  else
+  {
+    stCtx.u32PeriodMs = APP_OTA_TASK_PERIOD_MS;
+  }
+  u32DelayMs = stCtx.u32PeriodMs - (stCtx.u32PeriodMs / 4) + (esp_random() % (stCtx.u32PeriodMs / 2));
+  ESP_LOGD(APP_OTA_TAG, "Next check in %d s", u32DelayMs / 1000);
+  return pdMS_TO_TICKS(u32DelayMs);
 }
 
 static void _app_ota_check_update_task(void *pvParameter)
 {
-  char* pcDownloadUrl;
+  int64_t s64StartUs;
+  esp_err_t s32RetVal;
 
+  app_mem_bind_task(APP_MEM_ARENA_OTA);
+  stCtx.u32PeriodMs = APP_OTA_TASK_PERIOD_MS;
+  _app_ota_load_validators();
   while(1)
   {
-    pcDownloadUrl = _app_ota_get_download_url();
-    if(pcDownloadUrl != NULL)
+    _app_ota_postpone();
+    s64StartUs = esp_timer_get_time();
+    s32RetVal = _app_ota_get_download_url();
+    app_metrics_record(APP_METRICS_OTA_CHECK, (uint32_t)((esp_timer_get_time() - s64StartUs) / 1000));
+    if(ESP_OK == s32RetVal)
     {
-      ESP_LOGD(APP_OTA_TAG, "download_url: %s", pcDownloadUrl);
+      ESP_LOGD(APP_OTA_TAG, "download_url: %s", stCtx.stResponse.tcDownloadUrl);
       ESP_LOGD(APP_OTA_TAG, "Downloading and installing new firmware");
-      esp_http_client_config_t ota_client_config =
+      s32RetVal = ESP_FAIL;
+      if(stCtx.stResponse.tcDeltaUrl[0])
       {
-        .url = pcDownloadUrl,
-        .cert_pem = tcGithubReleaseCertPemStart,
-        .buffer_size = APP_OTA_HTTP_INTERNAL_RX_BUFFER_SIZE,
-        .buffer_size_tx = APP_OTA_HTTP_INTERNAL_TX_BUFFER_SIZE,
-      };
-      esp_err_t ret = esp_https_ota(&ota_client_config);
-      if (ret == ESP_OK)
+        s32RetVal = _app_ota_download(stCtx.stResponse.tcDeltaUrl);
+        if(ESP_OK != s32RetVal)
+        {
+          ESP_LOGW(APP_OTA_TAG, "Delta update failed, falling back to the full image");
+        }
+      }
+      if(ESP_OK != s32RetVal)
+      {
+        s32RetVal = _app_ota_download(stCtx.stResponse.tcDownloadUrl);
+      }
+      if(ESP_OK == s32RetVal)
       {
         ESP_LOGI(APP_OTA_TAG, "OTA OK, restarting...");
         esp_restart();
@@ -169,21 +492,27 @@ static void _app_ota_check_update_task(void *pvParameter)
         ESP_LOGE(APP_OTA_TAG, "OTA failed...");
       }
     }
-    else
+    else if(ESP_ERR_NOT_FOUND != s32RetVal)
     {
       ESP_LOGW(APP_OTA_TAG, "Could not get download url");
     }
     ESP_LOGI(APP_OTA_TAG, "Device is running App version: %s", APP_OTA_DEVICE_CURRENT_FW_VERSION);
-    vTaskDelay(APP_OTA_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+    vTaskDelay(_app_ota_get_delay(s32RetVal));
   }
 }
 
-void app_ota_start(void)
+/* pfBusy tells whether scans are waiting to be uploaded, checks are postponed
+   while it returns true */
+void app_ota_start(app_ota_busy_cb_t pfBusy)
+{
+  stCtx.pfBusy = pfBusy;
+  app_sched_create(APP_SCHED_TASK_OTA, _app_ota_check_update_task, NULL);
+}
+
+void app_ota_get_stats(app_ota_stats_t *pstStats)
 {
-  xTaskCreate(&_app_ota_check_update_task,
-              "check_update",
-              APP_OTA_TASK_STACK_SIZE,
-              NULL,
-              APP_OTA_TASK_PRIORITY,
-              NULL);
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_ota_stats_t));
+  }
 }
\ No newline at end of file
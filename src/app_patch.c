@@ -0,0 +1,513 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <esp32/rom/miniz.h>
+
+#include "app_patch.h"
+
+#define APP_PATCH_TAG                            "APP_PATCH"
+
+/* "OTAP" */
+#define APP_PATCH_MAGIC                          0x5041544F
+#define APP_PATCH_VERSION                        1
+#define APP_PATCH_HASH_SIZE                      32
+#define APP_PATCH_WRITE_BUFFER_SIZE              4096
+
+#define APP_PATCH_TYPE_FULL                      0
+#define APP_PATCH_TYPE_DELTA                     1
+
+#define APP_PATCH_COMPRESSION_NONE               0
+#define APP_PATCH_COMPRESSION_DEFLATE            1
+
+#define APP_PATCH_OP_END                         0x00
+#define APP_PATCH_OP_COPY                        0x01
+#define APP_PATCH_OP_ADD                         0x02
+#define APP_PATCH_OP_NONE                        0xFF
+
+#define APP_PATCH_STATE_IDLE                     0
+#define APP_PATCH_STATE_HEADER                   1
+#define APP_PATCH_STATE_PAYLOAD                  2
+#define APP_PATCH_STATE_RAW                      3
+#define APP_PATCH_STATE_DONE                     4
+
+/* Container prepended by tools/ota_patch.py, a plain application image (which
+   starts with 0xE9) is written as is */
+typedef struct __attribute__((packed))
+{
+  uint32_t u32Magic;
+  uint8_t u08Version;
+  uint8_t u08Type;
+  uint8_t u08Compression;
+  uint8_t u08Reserved;
+  uint32_t u32TargetSize;
+  uint8_t tu08TargetHash[APP_PATCH_HASH_SIZE];
+  uint32_t u32SourceSize;
+  uint8_t tu08SourceHash[APP_PATCH_HASH_SIZE];
+}patch_header_t;
+
+/* Only allocated for the duration of a compressed update */
+typedef struct
+{
+  tinfl_decompressor stInflator;
+  uint8_t tu08Dict[TINFL_LZ_DICT_SIZE];
+}patch_inflate_t;
+
+typedef struct
+{
+  uint8_t u08State;
+  uint8_t u08Op;
+  uint8_t tu08OpArgs[8];
+  uint32_t u32OpArgsLength;
+  uint32_t u32Literal;
+  uint32_t u32HeaderLength;
+  patch_header_t stHeader;
+  patch_inflate_t *pstInflate;
+  uint32_t u32DictOffset;
+  bool bInflated;
+  const esp_partition_t *pstSource;
+  const esp_partition_t *pstTarget;
+  esp_ota_handle_t u32Handle;
+  mbedtls_sha256_context stSha;
+  int64_t s64StartUs;
+  esp_err_t s32Error;
+  uint32_t u32BufferLength;
+  uint8_t tu08Buffer[APP_PATCH_WRITE_BUFFER_SIZE];
+  app_patch_stats_t stStats;
+}patch_ctx_t;
+
+static patch_ctx_t stCtx;
+
+static void _app_patch_flush(void)
+{
+  if((ESP_OK == stCtx.s32Error) && stCtx.u32BufferLength)
+  {
+    if((APP_PATCH_STATE_RAW != stCtx.u08State) &&
+       ((stCtx.stStats.u32BytesOut + stCtx.u32BufferLength) > stCtx.stHeader.u32TargetSize))
+    {
+      ESP_LOGE(APP_PATCH_TAG, "Output is larger than the announced %d bytes", stCtx.stHeader.u32TargetSize);
+      stCtx.s32Error = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+      stCtx.s32Error = esp_ota_write(stCtx.u32Handle, stCtx.tu08Buffer, stCtx.u32BufferLength);
+      mbedtls_sha256_update_ret(&stCtx.stSha, stCtx.tu08Buffer, stCtx.u32BufferLength);
+      stCtx.stStats.u32BytesOut += stCtx.u32BufferLength;
+      stCtx.u32BufferLength = 0;
+    }
+  }
+}
+
+/* Writes are gathered into whole buffers to keep the flash writes large */
+static void _app_patch_output(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Chunk;
+
+  while((ESP_OK == stCtx.s32Error) && u32Length)
+  {
+    u32Chunk = sizeof(stCtx.tu08Buffer) - stCtx.u32BufferLength;
+    u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+    memcpy(&stCtx.tu08Buffer[stCtx.u32BufferLength], pu08Data, u32Chunk);
+    stCtx.u32BufferLength += u32Chunk;
+    pu08Data += u32Chunk;
+    u32Length -= u32Chunk;
+    if(sizeof(stCtx.tu08Buffer) == stCtx.u32BufferLength)
+    {
+      _app_patch_flush();
+    }
+  }
+}
+
+/* Copied ranges are read from the running partition straight into the write buffer */
+static void _app_patch_copy(uint32_t u32Offset, uint32_t u32Length)
+{
+  uint32_t u32Chunk;
+
+  if((u32Offset > stCtx.stHeader.u32SourceSize) || (u32Length > (stCtx.stHeader.u32SourceSize - u32Offset)))
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Copy of %d bytes at 0x%x is out of the source image", u32Length, u32Offset);
+    stCtx.s32Error = ESP_ERR_INVALID_RESPONSE;
+  }
+  while((ESP_OK == stCtx.s32Error) && u32Length)
+  {
+    u32Chunk = sizeof(stCtx.tu08Buffer) - stCtx.u32BufferLength;
+    u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+    stCtx.s32Error = esp_partition_read(stCtx.pstSource, u32Offset, &stCtx.tu08Buffer[stCtx.u32BufferLength], u32Chunk);
+    stCtx.u32BufferLength += u32Chunk;
+    stCtx.stStats.u32BytesCopied += u32Chunk;
+    u32Offset += u32Chunk;
+    u32Length -= u32Chunk;
+    if(sizeof(stCtx.tu08Buffer) == stCtx.u32BufferLength)
+    {
+      _app_patch_flush();
+    }
+  }
+}
+
+/* Delta payload: a sequence of COPY(offset, length) from the running image,
+   ADD(length) followed by literal bytes, terminated by END */
+static void _app_patch_ops(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Chunk;
+  uint32_t u32Needed;
+  uint32_t tu32Args[2];
+
+  while((ESP_OK == stCtx.s32Error) && u32Length)
+  {
+    if(APP_PATCH_STATE_DONE == stCtx.u08State)
+    {
+      ESP_LOGE(APP_PATCH_TAG, "Unexpected data after the end of the patch");
+      stCtx.s32Error = ESP_ERR_INVALID_RESPONSE;
+    }
+    else if(stCtx.u32Literal)
+    {
+      u32Chunk = (u32Length < stCtx.u32Literal)?u32Length:stCtx.u32Literal;
+      _app_patch_output(pu08Data, u32Chunk);
+      stCtx.u32Literal -= u32Chunk;
+      pu08Data += u32Chunk;
+      u32Length -= u32Chunk;
+    }
+    else if(APP_PATCH_OP_NONE == stCtx.u08Op)
+    {
+      stCtx.u08Op = *pu08Data++;
+      stCtx.u32OpArgsLength = 0;
+      u32Length--;
+      if(APP_PATCH_OP_END == stCtx.u08Op)
+      {
+        stCtx.u08State = APP_PATCH_STATE_DONE;
+        stCtx.u08Op = APP_PATCH_OP_NONE;
+      }
+      else if((APP_PATCH_OP_COPY != stCtx.u08Op) && (APP_PATCH_OP_ADD != stCtx.u08Op))
+      {
+        ESP_LOGE(APP_PATCH_TAG, "Unknown patch operation: 0x%02x", stCtx.u08Op);
+        stCtx.s32Error = ESP_ERR_INVALID_RESPONSE;
+      }
+    }
+    else
+    {
+      u32Needed = (APP_PATCH_OP_COPY == stCtx.u08Op)?8:4;
+      u32Chunk = u32Needed - stCtx.u32OpArgsLength;
+      u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+      memcpy(&stCtx.tu08OpArgs[stCtx.u32OpArgsLength], pu08Data, u32Chunk);
+      stCtx.u32OpArgsLength += u32Chunk;
+      pu08Data += u32Chunk;
+      u32Length -= u32Chunk;
+      if(u32Needed == stCtx.u32OpArgsLength)
+      {
+        /* Arguments are little endian like the target */
+        memcpy(tu32Args, stCtx.tu08OpArgs, u32Needed);
+        if(APP_PATCH_OP_COPY == stCtx.u08Op)
+        {
+          _app_patch_copy(tu32Args[0], tu32Args[1]);
+        }
+        else
+        {
+          stCtx.u32Literal = tu32Args[0];
+        }
+        stCtx.u08Op = APP_PATCH_OP_NONE;
+      }
+    }
+  }
+}
+
+static void _app_patch_payload(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  if(APP_PATCH_TYPE_DELTA == stCtx.stHeader.u08Type)
+  {
+    _app_patch_ops(pu08Data, u32Length);
+  }
+  else
+  {
+    _app_patch_output(pu08Data, u32Length);
+  }
+}
+
+/* Inflate into the 32 KB dictionary which doubles as the output window */
+static void _app_patch_inflate(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  size_t u32In;
+  size_t u32Out;
+  tinfl_status eStatus;
+
+  eStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  if(stCtx.bInflated && u32Length)
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Unexpected data after the compressed stream");
+    stCtx.s32Error = ESP_ERR_INVALID_RESPONSE;
+  }
+  while((ESP_OK == stCtx.s32Error) &&
+        !stCtx.bInflated &&
+        (u32Length || (TINFL_STATUS_HAS_MORE_OUTPUT == eStatus)))
+  {
+    u32In = u32Length;
+    u32Out = TINFL_LZ_DICT_SIZE - stCtx.u32DictOffset;
+    eStatus = tinfl_decompress(&stCtx.pstInflate->stInflator,
+                               pu08Data,
+                               &u32In,
+                               stCtx.pstInflate->tu08Dict,
+                               &stCtx.pstInflate->tu08Dict[stCtx.u32DictOffset],
+                               &u32Out,
+                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+    pu08Data += u32In;
+    u32Length -= u32In;
+    _app_patch_payload(&stCtx.pstInflate->tu08Dict[stCtx.u32DictOffset], u32Out);
+    stCtx.u32DictOffset = (stCtx.u32DictOffset + u32Out) & (TINFL_LZ_DICT_SIZE - 1);
+    if(eStatus < TINFL_STATUS_DONE)
+    {
+      ESP_LOGE(APP_PATCH_TAG, "Corrupted compressed stream: %d", eStatus);
+      stCtx.s32Error = ESP_ERR_INVALID_RESPONSE;
+    }
+    else if(TINFL_STATUS_DONE == eStatus)
+    {
+      stCtx.bInflated = true;
+      stCtx.s32Error = u32Length?ESP_ERR_INVALID_RESPONSE:stCtx.s32Error;
+    }
+  }
+}
+
+/* A delta only applies to the exact image it was computed against */
+static esp_err_t _app_patch_check_source(void)
+{
+  esp_err_t s32RetVal;
+  uint32_t u32Offset;
+  uint32_t u32Chunk;
+  mbedtls_sha256_context stSha;
+  uint8_t tu08Hash[APP_PATCH_HASH_SIZE];
+
+  s32RetVal = (stCtx.stHeader.u32SourceSize <= stCtx.pstSource->size)?ESP_OK:ESP_ERR_INVALID_SIZE;
+  mbedtls_sha256_init(&stSha);
+  mbedtls_sha256_starts_ret(&stSha, 0);
+  for(u32Offset = 0; (ESP_OK == s32RetVal) && (u32Offset < stCtx.stHeader.u32SourceSize); u32Offset += u32Chunk)
+  {
+    u32Chunk = stCtx.stHeader.u32SourceSize - u32Offset;
+    u32Chunk = (u32Chunk < sizeof(stCtx.tu08Buffer))?u32Chunk:sizeof(stCtx.tu08Buffer);
+    s32RetVal = esp_partition_read(stCtx.pstSource, u32Offset, stCtx.tu08Buffer, u32Chunk);
+    mbedtls_sha256_update_ret(&stSha, stCtx.tu08Buffer, u32Chunk);
+  }
+  mbedtls_sha256_finish_ret(&stSha, tu08Hash);
+  mbedtls_sha256_free(&stSha);
+  if((ESP_OK == s32RetVal) && memcmp(tu08Hash, stCtx.stHeader.tu08SourceHash, sizeof(tu08Hash)))
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Patch was not made for the running firmware");
+    s32RetVal = ESP_ERR_INVALID_VERSION;
+  }
+  return s32RetVal;
+}
+
+static void _app_patch_start_payload(void)
+{
+  if((APP_PATCH_VERSION != stCtx.stHeader.u08Version) ||
+     (APP_PATCH_TYPE_DELTA < stCtx.stHeader.u08Type) ||
+     (APP_PATCH_COMPRESSION_DEFLATE < stCtx.stHeader.u08Compression))
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Unsupported patch version %d", stCtx.stHeader.u08Version);
+    stCtx.s32Error = ESP_ERR_NOT_SUPPORTED;
+  }
+  else if(stCtx.stHeader.u32TargetSize > stCtx.pstTarget->size)
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Image of %d bytes doesn't fit in the OTA partition", stCtx.stHeader.u32TargetSize);
+    stCtx.s32Error = ESP_ERR_INVALID_SIZE;
+  }
+  else if(APP_PATCH_TYPE_DELTA == stCtx.stHeader.u08Type)
+  {
+    stCtx.s32Error = _app_patch_check_source();
+  }
+  if((ESP_OK == stCtx.s32Error) && (APP_PATCH_COMPRESSION_DEFLATE == stCtx.stHeader.u08Compression))
+  {
+    stCtx.pstInflate = malloc(sizeof(patch_inflate_t));
+    if(stCtx.pstInflate)
+    {
+      tinfl_init(&stCtx.pstInflate->stInflator);
+      stCtx.stStats.u32WorkingRam += sizeof(patch_inflate_t);
+    }
+    else
+    {
+      stCtx.s32Error = ESP_ERR_NO_MEM;
+    }
+  }
+  stCtx.u08State = APP_PATCH_STATE_PAYLOAD;
+  ESP_LOGI(APP_PATCH_TAG,
+           "Applying %s%s image of %d bytes",
+           (APP_PATCH_TYPE_DELTA == stCtx.stHeader.u08Type)?"delta":"full",
+           (APP_PATCH_COMPRESSION_DEFLATE == stCtx.stHeader.u08Compression)?" compressed":"",
+           stCtx.stHeader.u32TargetSize);
+}
+
+/* Collect the container header, anything without the magic is a plain image */
+static uint32_t _app_patch_header(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Chunk;
+
+  u32Chunk = sizeof(stCtx.stHeader) - stCtx.u32HeaderLength;
+  u32Chunk = (u32Length < u32Chunk)?u32Length:u32Chunk;
+  memcpy((uint8_t *)&stCtx.stHeader + stCtx.u32HeaderLength, pu08Data, u32Chunk);
+  stCtx.u32HeaderLength += u32Chunk;
+  if((stCtx.u32HeaderLength >= sizeof(stCtx.stHeader.u32Magic)) && (APP_PATCH_MAGIC != stCtx.stHeader.u32Magic))
+  {
+    ESP_LOGI(APP_PATCH_TAG, "Applying plain image");
+    stCtx.u08State = APP_PATCH_STATE_RAW;
+    _app_patch_output((const uint8_t *)&stCtx.stHeader, stCtx.u32HeaderLength);
+  }
+  else if(sizeof(stCtx.stHeader) == stCtx.u32HeaderLength)
+  {
+    _app_patch_start_payload();
+  }
+  return u32Chunk;
+}
+
+static void _app_patch_release(void)
+{
+  free(stCtx.pstInflate);
+  stCtx.pstInflate = NULL;
+  mbedtls_sha256_free(&stCtx.stSha);
+  stCtx.stStats.u32DurationMs = (uint32_t)((esp_timer_get_time() - stCtx.s64StartUs) / 1000LL);
+  stCtx.u08State = APP_PATCH_STATE_IDLE;
+}
+
+/* Start writing the inactive OTA slot */
+esp_err_t app_patch_begin(void)
+{
+  esp_err_t s32RetVal;
+
+  if(APP_PATCH_STATE_IDLE != stCtx.u08State)
+  {
+    app_patch_abort();
+  }
+  memset(&stCtx, 0x00, sizeof(stCtx));
+  stCtx.u08Op = APP_PATCH_OP_NONE;
+  stCtx.s64StartUs = esp_timer_get_time();
+  stCtx.stStats.u32WorkingRam = sizeof(stCtx.tu08Buffer);
+  stCtx.pstSource = esp_ota_get_running_partition();
+  stCtx.pstTarget = esp_ota_get_next_update_partition(NULL);
+  if(stCtx.pstSource && stCtx.pstTarget)
+  {
+    s32RetVal = esp_ota_begin(stCtx.pstTarget, OTA_SIZE_UNKNOWN, &stCtx.u32Handle);
+    if(ESP_OK == s32RetVal)
+    {
+      mbedtls_sha256_init(&stCtx.stSha);
+      mbedtls_sha256_starts_ret(&stCtx.stSha, 0);
+      stCtx.u08State = APP_PATCH_STATE_HEADER;
+    }
+  }
+  else
+  {
+    s32RetVal = ESP_ERR_NOT_FOUND;
+  }
+  return s32RetVal;
+}
+
+/* Feed the next piece of the download, it can be split anywhere */
+esp_err_t app_patch_write(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Consumed;
+
+  if(APP_PATCH_STATE_IDLE == stCtx.u08State)
+  {
+    stCtx.s32Error = ESP_ERR_INVALID_STATE;
+  }
+  stCtx.stStats.u32BytesIn += u32Length;
+  while((ESP_OK == stCtx.s32Error) && u32Length)
+  {
+    if(APP_PATCH_STATE_HEADER == stCtx.u08State)
+    {
+      u32Consumed = _app_patch_header(pu08Data, u32Length);
+    }
+    else if(APP_PATCH_STATE_RAW == stCtx.u08State)
+    {
+      _app_patch_output(pu08Data, u32Length);
+      u32Consumed = u32Length;
+    }
+    else if(stCtx.pstInflate)
+    {
+      _app_patch_inflate(pu08Data, u32Length);
+      u32Consumed = u32Length;
+    }
+    else
+    {
+      _app_patch_payload(pu08Data, u32Length);
+      u32Consumed = u32Length;
+    }
+    pu08Data += u32Consumed;
+    u32Length -= u32Consumed;
+  }
+  return stCtx.s32Error;
+}
+
+/* Verify the image and make it the next boot partition */
+esp_err_t app_patch_end(void)
+{
+  esp_err_t s32RetVal;
+  uint8_t tu08Hash[APP_PATCH_HASH_SIZE];
+
+  _app_patch_flush();
+  s32RetVal = stCtx.s32Error;
+  if(ESP_OK != s32RetVal)
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Update failed: %s", esp_err_to_name(s32RetVal));
+  }
+  else if((APP_PATCH_STATE_HEADER == stCtx.u08State) ||
+          (APP_PATCH_STATE_IDLE == stCtx.u08State) ||
+          (stCtx.pstInflate && !stCtx.bInflated) ||
+          ((APP_PATCH_TYPE_DELTA == stCtx.stHeader.u08Type) && (APP_PATCH_STATE_DONE != stCtx.u08State)))
+  {
+    ESP_LOGE(APP_PATCH_TAG, "Update is incomplete");
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else if(APP_PATCH_STATE_RAW != stCtx.u08State)
+  {
+    mbedtls_sha256_finish_ret(&stCtx.stSha, tu08Hash);
+    if((stCtx.stStats.u32BytesOut != stCtx.stHeader.u32TargetSize) ||
+       memcmp(tu08Hash, stCtx.stHeader.tu08TargetHash, sizeof(tu08Hash)))
+    {
+      ESP_LOGE(APP_PATCH_TAG, "Image hash mismatch");
+      s32RetVal = ESP_ERR_INVALID_CRC;
+    }
+  }
+  if(APP_PATCH_STATE_IDLE != stCtx.u08State)
+  {
+    /* Always end the OTA operation so its resources are released, the image
+       is checked once more by the bootloader format validation */
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = esp_ota_end(stCtx.u32Handle);
+    }
+    else
+    {
+      esp_ota_end(stCtx.u32Handle);
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = esp_ota_set_boot_partition(stCtx.pstTarget);
+    }
+    _app_patch_release();
+    ESP_LOGI(APP_PATCH_TAG,
+             "%d bytes downloaded, %d bytes written (%d copied) in %d ms",
+             stCtx.stStats.u32BytesIn,
+             stCtx.stStats.u32BytesOut,
+             stCtx.stStats.u32BytesCopied,
+             stCtx.stStats.u32DurationMs);
+  }
+  return s32RetVal;
+}
+
+void app_patch_abort(void)
+{
+  if(APP_PATCH_STATE_IDLE != stCtx.u08State)
+  {
+    esp_ota_end(stCtx.u32Handle);
+    _app_patch_release();
+  }
+}
+
+void app_patch_get_stats(app_patch_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_patch_stats_t));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,751 @@
+#include <string.h>
+#include <stdio.h>
+#include <sdkconfig.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "app_wifi.h"
+#include "app_time.h"
+#include "app_conn.h"
+#include "app_doc.h"
+#include "app_batch.h"
+#include "app_gw.h"
+#include "app_ring.h"
+#include "app_dedup.h"
+#include "app_journal.h"
+#include "app_index.h"
+#include "app_load.h"
+#include "app_reader.h"
+#include "app_trace.h"
+#include "app_metrics.h"
+#include "app_lane.h"
+#include "app_access.h"
+#include "app_sched.h"
+#include "app_pipeline.h"
+
+static void _app_pipeline_send_data(const app_journal_record_t *, app_metrics_hist_t);
+static uint32_t _app_pipeline_get_alerts(int64_t *);
+static uint32_t _app_pipeline_get_live(int64_t *);
+static uint32_t _app_pipeline_get_backlog(int64_t *);
+static uint32_t _app_pipeline_get_telemetry(int64_t *);
+static uint32_t _app_pipeline_serve_alerts(uint32_t);
+static uint32_t _app_pipeline_serve_live(uint32_t);
+static uint32_t _app_pipeline_serve_backlog(uint32_t);
+static uint32_t _app_pipeline_serve_telemetry(uint32_t);
+static esp_err_t _app_pipeline_is_known_tag(const uint8_t *, uint8_t, bool *);
+static void _app_pipeline_access_handler(uint8_t, const uint8_t *, uint8_t, bool);
+static void _app_pipeline_firestore_task(void *);
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+static void _app_pipeline_init_node_id(void);
+#endif
+
+#define APP_PIPELINE_TAG                         "APP_PIPELINE"
+
+/* Built-in serial numbers are single size UIDs followed by their BCC */
+#define APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE    5
+
+#define APP_PIPELINE_TAG_RING_POLICY             APP_RING_DROP_OLDEST
+/* A badge read again within this time of its previous read is not uploaded */
+#define APP_PIPELINE_DEDUP_HOLD_OFF_MS           3000
+#define APP_PIPELINE_FIRESTORE_PERIOD_MS         2500
+
+#define APP_PIPELINE_FIRESTORE_BATCH_ENABLED     1
+#define APP_PIPELINE_JOURNAL_RETRY_MS            30000
+/* Scans waiting in the live and alert lanes */
+#define APP_PIPELINE_PENDING_MAX_RECORDS         (2 * APP_BATCH_MAX_WRITES)
+#define APP_PIPELINE_ALERT_MAX_RECORDS           8
+
+/* Upload lanes, see app_lane.h: scans of unknown badges go out right away,
+   the other live scans are batched for the window and the journal is replayed
+   a few scans per turn so a live scan never waits long behind it */
+#define APP_PIPELINE_ALERT_WEIGHT                8
+#define APP_PIPELINE_LIVE_WEIGHT                 4
+#define APP_PIPELINE_BACKLOG_WEIGHT              1
+#define APP_PIPELINE_TELEMETRY_WEIGHT            1
+#define APP_PIPELINE_ALERT_DEADLINE_MS           CONFIG_RFID_LANE_ALERT_DEADLINE_MS
+#define APP_PIPELINE_LIVE_DEADLINE_MS            CONFIG_RFID_LANE_LIVE_DEADLINE_MS
+#define APP_PIPELINE_BACKLOG_TURN_RECORDS        CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS
+
+/* APP_PIPELINE_UPLOAD_GATEWAY sends packed scan records to the on-site gateway
+   of tools/rfid_gateway.py which writes them to Firestore */
+#ifdef APP_PIPELINE_UPLOAD_GATEWAY
+#define APP_PIPELINE_UPLOAD_MAX_RECORDS          APP_GW_MAX_RECORDS
+#else
+#define APP_PIPELINE_UPLOAD_MAX_RECORDS          APP_BATCH_MAX_WRITES
+#endif
+
+/* SINGLE updates the devices/rfid-node document shared by all nodes with
+   every scan. NODE and TAG write to devices/rfid-node-<mac> or tags/<sn>
+   instead, the scans of a batch hitting the same document are coalesced into
+   one write that counts them and stores the commit time */
+#define APP_PIPELINE_WRITE_MODEL_SINGLE          0
+#define APP_PIPELINE_WRITE_MODEL_NODE            1
+#define APP_PIPELINE_WRITE_MODEL_TAG             2
+#ifndef APP_PIPELINE_FIRESTORE_WRITE_MODEL
+#define APP_PIPELINE_FIRESTORE_WRITE_MODEL       APP_PIPELINE_WRITE_MODEL_SINGLE
+#endif
+
+#define APP_PIPELINE_FIRESTORE_DOC_MAX_SIZE      192
+#define APP_PIPELINE_FIRESTORE_COLLECTION_ID     "devices"
+#define APP_PIPELINE_FIRESTORE_DOCUMENT_ID       "rfid-node"
+#define APP_PIPELINE_FIRESTORE_TAG_COLLECTION_ID "tags"
+#define APP_PIPELINE_FIRESTORE_LAST_SEEN_FIELD   "lastSeen"
+#define APP_PIPELINE_FIRESTORE_SCANS_FIELD       "scans"
+#define APP_PIPELINE_FIRESTORE_PATH_MAX_SIZE     48
+#define APP_PIPELINE_NODE_ID_MAX_SIZE            (sizeof(APP_PIPELINE_FIRESTORE_DOCUMENT_ID) + 7)
+#define APP_PIPELINE_FIRESTORE_DOCUMENT_EXAMPLE  "{"                                     \
+                                                   "\"fields\": {"                       \
+                                                     "\"sn\": {"                         \
+                                                       "\"stringValue\": ABCDEF1234"     \
+                                                     "},"                                \
+                                                     "\"reader\": {"                     \
+                                                       "\"integerValue\": 0"             \
+                                                     "},"                                \
+                                                     "\"timestamp\": {"                  \
+                                                       "\"integerValue\": 1621010203262" \
+                                                     "}"                                 \
+                                                   "}"                                   \
+                                                 "}"
+
+/* Longest documents _app_pipeline_write_fields builds: the longest UID,
+   reader and node ID with a timestamp in ms, the mask and transforms have to
+   match tpcShardedMask and _app_pipeline_add_to_batch */
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+#define APP_PIPELINE_NODE_FIELD_MAX_SIZE         (sizeof(",\"node\":{\"stringValue\":\"\"}") - 1 +                         \
+                                                  APP_PIPELINE_NODE_ID_MAX_SIZE - 1)
+#define APP_PIPELINE_TRANSFORMS_MAX_SIZE         (sizeof(",\"updateMask\":{\"fieldPaths\":"                                \
+                                                           "[\"sn\",\"reader\",\"timestamp\",\"node\"]},"                  \
+                                                         "\"updateTransforms\":["                                          \
+                                                           "{\"fieldPath\":\""APP_PIPELINE_FIRESTORE_LAST_SEEN_FIELD"\","  \
+                                                            "\"setToServerValue\":\"REQUEST_TIME\"},"                      \
+                                                           "{\"fieldPath\":\""APP_PIPELINE_FIRESTORE_SCANS_FIELD"\","      \
+                                                            "\"increment\":{\"integerValue\":4294967295}}]") - 1)
+#else
+#define APP_PIPELINE_NODE_FIELD_MAX_SIZE         0
+#define APP_PIPELINE_TRANSFORMS_MAX_SIZE         0
+#endif
+#define APP_PIPELINE_LONGEST_FIELDS_SIZE         (sizeof("\"fields\":{\"sn\":{\"stringValue\":\"\"},"                      \
+                                                                  "\"reader\":{\"integerValue\":255},"                     \
+                                                                  "\"timestamp\":{\"integerValue\":1700000000000}}") - 1 + \
+                                                  2 * APP_JOURNAL_UID_MAX_SIZE + APP_PIPELINE_NODE_FIELD_MAX_SIZE)
+#define APP_PIPELINE_LONGEST_DOC_SIZE            (sizeof("{}") + APP_PIPELINE_LONGEST_FIELDS_SIZE)
+#define APP_PIPELINE_LONGEST_WRITE_SIZE          (sizeof("{\"update\":{\"name\":\""APP_CONN_DATABASE_PATH"/\",}}") - 1 +   \
+                                                  APP_PIPELINE_FIRESTORE_PATH_MAX_SIZE - 1 +                               \
+                                                  APP_PIPELINE_LONGEST_FIELDS_SIZE + APP_PIPELINE_TRANSFORMS_MAX_SIZE)
+
+_Static_assert(APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE <= APP_TAG_UID_MAX_SIZE, "Serial number doesn't fit in app_tag_t");
+_Static_assert(APP_TAG_UID_MAX_SIZE <= APP_JOURNAL_UID_MAX_SIZE, "UIDs don't fit in journal records");
+_Static_assert(sizeof(APP_PIPELINE_FIRESTORE_TAG_COLLECTION_ID) + 2 * APP_TAG_UID_MAX_SIZE <
+               APP_PIPELINE_FIRESTORE_PATH_MAX_SIZE,
+               "Tag document path doesn't fit");
+#if (APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE) && !APP_PIPELINE_FIRESTORE_BATCH_ENABLED
+#error "Field transforms of the sharded write models need batched commits"
+#endif
+#if defined(APP_PIPELINE_UPLOAD_GATEWAY) && \
+    ((APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE) || !APP_PIPELINE_FIRESTORE_BATCH_ENABLED)
+#error "The gateway batches scans itself and picks the write model with its --model option"
+#endif
+_Static_assert(APP_PIPELINE_UPLOAD_MAX_RECORDS <= APP_PIPELINE_PENDING_MAX_RECORDS, "Pending scans don't fit");
+_Static_assert(APP_PIPELINE_BACKLOG_TURN_RECORDS <= APP_PIPELINE_UPLOAD_MAX_RECORDS,
+               "A backlog turn doesn't fit in a batch, lower CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS");
+_Static_assert(APP_JOURNAL_UID_MAX_SIZE <= APP_GW_UID_MAX_SIZE, "Journaled UIDs don't fit in gateway records");
+_Static_assert(APP_PIPELINE_LONGEST_DOC_SIZE <= APP_PIPELINE_FIRESTORE_DOC_MAX_SIZE, "Longest document doesn't fit");
+_Static_assert(APP_BATCH_BODY_SIZE(APP_BATCH_MAX_WRITES, APP_PIPELINE_LONGEST_WRITE_SIZE) <= APP_BATCH_BODY_MAX_SIZE,
+               "A batch of the longest writes doesn't fit, raise CONFIG_RFID_BATCH_BODY_SIZE");
+
+static app_ring_t stTagRing;
+static app_dedup_t stDedup;
+static TaskHandle_t pstFirestoreTask;
+static uint32_t u32DocLength;
+static char tcDoc[APP_PIPELINE_FIRESTORE_DOC_MAX_SIZE];
+static bool bUploadOk;
+static int64_t s64LastFailureUs;
+/* A journal that couldn't be replayed waits until then */
+static int64_t s64BacklogRetryUs;
+/* Scans waiting for a turn of their lane, oldest first */
+static uint32_t u32AlertCount;
+static app_journal_record_t tstAlertRecords[APP_PIPELINE_ALERT_MAX_RECORDS];
+static uint32_t u32LiveCount;
+static app_journal_record_t tstLiveRecords[APP_PIPELINE_PENDING_MAX_RECORDS];
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+static char tcNodeId[APP_PIPELINE_NODE_ID_MAX_SIZE];
+
+/* Fields of the scan written by _app_pipeline_write_fields, the transformed ones
+   are left alone so the counter keeps adding up */
+static const char *const tpcShardedMask[] = {"sn", "reader", "timestamp", "node"};
+#endif
+
+static const app_lane_config_t tstLanes[APP_LANE_COUNT] =
+{
+  [APP_LANE_ALERT]     = {_app_pipeline_get_alerts,    _app_pipeline_serve_alerts,    APP_PIPELINE_ALERT_WEIGHT,
+                          0,                   APP_PIPELINE_ALERT_DEADLINE_MS, APP_PIPELINE_UPLOAD_MAX_RECORDS},
+  [APP_LANE_LIVE]      = {_app_pipeline_get_live,      _app_pipeline_serve_live,      APP_PIPELINE_LIVE_WEIGHT,
+                          APP_BATCH_WINDOW_MS, APP_PIPELINE_LIVE_DEADLINE_MS,  APP_PIPELINE_UPLOAD_MAX_RECORDS},
+  [APP_LANE_BACKLOG]   = {_app_pipeline_get_backlog,   _app_pipeline_serve_backlog,   APP_PIPELINE_BACKLOG_WEIGHT,
+                          0,                   0,                              APP_PIPELINE_BACKLOG_TURN_RECORDS},
+  [APP_LANE_TELEMETRY] = {_app_pipeline_get_telemetry, _app_pipeline_serve_telemetry, APP_PIPELINE_TELEMETRY_WEIGHT,
+                          0,                   0,                              1},
+};
+
+static const uint8_t ttu08KnownSerialNumbers[3][APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE] =
+{
+  {0x72, 0xEA, 0x5F, 0x06, 0xC1},
+  {0x29, 0x57, 0x8C, 0xBB, 0x49},
+  {0x76, 0x9E, 0x25, 0xF8, 0x35},
+};
+
+/* Scans are waiting to be uploaded */
+bool app_pipeline_is_busy(void)
+{
+  return (0 != app_ring_count(&stTagRing)) || (0 != u32AlertCount) || (0 != u32LiveCount);
+}
+
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+/* Nodes are told apart by the end of their station MAC address */
+static void _app_pipeline_init_node_id(void)
+{
+  uint8_t tu08Mac[6];
+
+  esp_read_mac(tu08Mac, ESP_MAC_WIFI_STA);
+  snprintf(tcNodeId,
+           sizeof(tcNodeId),
+           APP_PIPELINE_FIRESTORE_DOCUMENT_ID"-%02X%02X%02X",
+           tu08Mac[3],
+           tu08Mac[4],
+           tu08Mac[5]);
+}
+
+/* Document of the scan relative to the database root */
+static void _app_pipeline_get_document_path(const app_journal_record_t *pstRecord, char *pcPath)
+{
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL == APP_PIPELINE_WRITE_MODEL_NODE
+  snprintf(pcPath, APP_PIPELINE_FIRESTORE_PATH_MAX_SIZE, APP_PIPELINE_FIRESTORE_COLLECTION_ID"/%s", tcNodeId);
+#else
+  uint32_t u32Index;
+  uint32_t u32Length;
+
+  u32Length = sizeof(APP_PIPELINE_FIRESTORE_TAG_COLLECTION_ID);
+  memcpy(pcPath, APP_PIPELINE_FIRESTORE_TAG_COLLECTION_ID"/", u32Length);
+  for(u32Index = 0; u32Index < pstRecord->u08UidLength; u32Index++)
+  {
+    u32Length += sprintf(&pcPath[u32Length], "%02X", pstRecord->tu08Uid[u32Index]);
+  }
+#endif
+}
+#endif
+
+/* Called once before the upload task starts, the ring exists from then on */
+void app_pipeline_init(void)
+{
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+  _app_pipeline_init_node_id();
+#endif
+  app_ring_init(&stTagRing, APP_PIPELINE_TAG_RING_POLICY);
+  app_dedup_init(&stDedup, APP_PIPELINE_DEDUP_HOLD_OFF_MS);
+  app_lane_init(tstLanes);
+  app_access_init(_app_pipeline_is_known_tag, _app_pipeline_access_handler);
+}
+
+/* Reads wait there for the upload task */
+app_ring_t *app_pipeline_get_ring(void)
+{
+  return &stTagRing;
+}
+
+/* The upload task reads from the readers of pstArgs, or from the load
+   generator when it is built in */
+void app_pipeline_start(const app_reader_start_args_t *pstArgs)
+{
+  app_sched_create(APP_SCHED_TASK_FIRESTORE, _app_pipeline_firestore_task, (void *)pstArgs);
+}
+
+/* Runs in the reader task: capture the read by value and never block */
+void app_pipeline_scan(uint8_t u08ReaderId, const uint8_t *pu08Uid, uint8_t u08UidLength)
+{
+  app_tag_t stTag;
+  app_trace_span_t stSpan;
+
+  app_trace_begin(&stSpan);
+  stTag.s64CaptureUs = esp_timer_get_time();
+  stTag.u08ReaderId = u08ReaderId;
+  stTag.u08UidLength = (u08UidLength < APP_TAG_UID_MAX_SIZE)?u08UidLength:APP_TAG_UID_MAX_SIZE;
+  memcpy(stTag.tu08Uid, pu08Uid, stTag.u08UidLength);
+  if(!app_dedup_accept(&stDedup, &stTag))
+  {
+    app_metrics_add(APP_METRICS_SCANS_SUPPRESSED, 1);
+    ESP_LOGD(APP_PIPELINE_TAG, "Tag is still in front of reader %d --> suppressing read", u08ReaderId);
+  }
+  else
+  {
+    app_metrics_add(APP_METRICS_SCANS, 1);
+    /* Decided before the scan is queued, the upload only carries the audit */
+    stTag.bGranted = app_access_decide(u08ReaderId, stTag.tu08Uid, stTag.u08UidLength);
+    if(ESP_OK != app_ring_push(&stTagRing, &stTag))
+    {
+      ESP_LOGW(APP_PIPELINE_TAG, "Tag ring is full --> dropping read");
+    }
+    if(pstFirestoreTask)
+    {
+      xTaskNotifyGive(pstFirestoreTask);
+    }
+  }
+  app_trace_end(&stSpan, APP_TRACE_TAG_HANDLER);
+}
+
+/* Runs in the reader task right after the read: drive the door from here,
+   without blocking, the scan is uploaded afterwards */
+static void _app_pipeline_access_handler(uint8_t u08ReaderId, const uint8_t *pu08Uid, uint8_t u08UidLength, bool bGranted)
+{
+  ESP_LOGD(APP_PIPELINE_TAG, "Reader %d %s access", u08ReaderId, bGranted?"grants":"denies");
+}
+
+/* Runs in the event loop: replay the journal as soon as the link is back */
+void app_pipeline_link(bool bUp)
+{
+  if(bUp)
+  {
+    bUploadOk = true;
+    if(pstFirestoreTask)
+    {
+      xTaskNotifyGive(pstFirestoreTask);
+    }
+  }
+}
+
+/* Move scans from the tag ring to their lane, or to the journal while they
+   can't be uploaded. A full lane leaves the rest in the ring until it has
+   been served */
+static void _app_pipeline_drain_ring(void)
+{
+  app_tag_t stTag;
+  uint32_t u32Index;
+  app_journal_record_t stRecord;
+  char tcSerialNumber[2 * APP_TAG_UID_MAX_SIZE + 1];
+
+  while((u32AlertCount < APP_PIPELINE_ALERT_MAX_RECORDS) &&
+        (u32LiveCount < APP_PIPELINE_PENDING_MAX_RECORDS) &&
+        (ESP_OK == app_ring_pop(&stTagRing, &stTag)))
+  {
+    app_trace_record_us(APP_TRACE_QUEUE_DWELL, esp_timer_get_time() - stTag.s64CaptureUs);
+    for(u32Index = 0; u32Index < stTag.u08UidLength; u32Index++)
+    {
+      sprintf(&tcSerialNumber[2 * u32Index], "%02X", stTag.tu08Uid[u32Index]);
+    }
+    tcSerialNumber[2 * stTag.u08UidLength] = '\0';
+    ESP_LOGI(APP_PIPELINE_TAG, "Reader %d detected Tag with serial-number: %s", stTag.u08ReaderId, tcSerialNumber);
+    if(stTag.bGranted)
+    {
+      ESP_LOGI(APP_PIPELINE_TAG, "Tag is recognized");
+    }
+    else
+    {
+      ESP_LOGW(APP_PIPELINE_TAG, "Tag is not recognized");
+    }
+    memset(&stRecord, 0x00, sizeof(stRecord));
+    memcpy(stRecord.tu08Uid, stTag.tu08Uid, stTag.u08UidLength);
+    stRecord.u08UidLength = stTag.u08UidLength;
+    stRecord.u08ReaderId = stTag.u08ReaderId;
+    /* Stamped with the capture time, turned into wall clock time when formatted */
+    stRecord.s64CaptureUs = stTag.s64CaptureUs;
+    if(app_time_is_pending())
+    {
+      ESP_LOGW(APP_PIPELINE_TAG, "Time is not synced yet --> journaling scan until it is");
+      app_journal_append(&stRecord);
+    }
+    else if(!app_wifi_is_connected())
+    {
+      ESP_LOGW(APP_PIPELINE_TAG, "Wifi is down --> journaling scan until it is back");
+      app_journal_append(&stRecord);
+    }
+    else if(stTag.bGranted)
+    {
+      memcpy(&tstLiveRecords[u32LiveCount++], &stRecord, sizeof(app_journal_record_t));
+    }
+    else
+    {
+      memcpy(&tstAlertRecords[u32AlertCount++], &stRecord, sizeof(app_journal_record_t));
+    }
+  }
+}
+
+static void _app_pipeline_firestore_task(void *pvParameter)
+{
+  const app_reader_start_args_t *pstArgs;
+
+  pstArgs = (const app_reader_start_args_t *)pvParameter;
+  pstFirestoreTask = xTaskGetCurrentTaskHandle();
+  app_journal_init();
+#ifdef APP_LOAD_SCANS_PER_SECOND
+  /* Synthetic reads replace the reader, the ring only takes one producer */
+  app_load_start(APP_LOAD_SCANS_PER_SECOND, pstArgs->u32ReaderCount, app_pipeline_scan, &stTagRing);
+#else
+  app_reader_start(pstArgs);
+#endif
+  while(1)
+  {
+    ulTaskNotifyTake(pdTRUE, app_pipeline_get_wait_ticks());
+    app_pipeline_run();
+  }
+}
+
+/* The upload task wakes up on a new tag, when a lane becomes ready or
+   periodically to retry replaying the journal */
+TickType_t app_pipeline_get_wait_ticks(void)
+{
+  TickType_t u32WaitTicks;
+
+  u32WaitTicks = app_lane_get_wait_ticks();
+  if((portMAX_DELAY == u32WaitTicks) && app_journal_count())
+  {
+    u32WaitTicks = pdMS_TO_TICKS(APP_PIPELINE_JOURNAL_RETRY_MS);
+  }
+  return u32WaitTicks;
+}
+
+/* One turn of the upload task, scans read during a turn are sorted into their
+   lane before the next one */
+void app_pipeline_run(void)
+{
+  do
+  {
+    app_sched_set_busy(app_pipeline_is_busy());
+    _app_pipeline_drain_ring();
+  }while(app_lane_serve());
+  app_sched_set_busy(app_pipeline_is_busy());
+}
+
+/* Look the tag up in the flashed index, the built-in list is only used when
+   no index has been flashed yet. Runs in the reader task on access cache
+   misses, so it doesn't wait for the sync task to release the index */
+static esp_err_t _app_pipeline_is_known_tag(const uint8_t *pu08Uid, uint8_t u08UidLength, bool *pbKnown)
+{
+  esp_err_t s32RetVal;
+
+  s32RetVal = app_index_lookup(pu08Uid, u08UidLength, NULL, 0);
+  if(ESP_ERR_INVALID_STATE == s32RetVal)
+  {
+    *pbKnown = (APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE == u08UidLength) &&
+               ((0 == memcmp(pu08Uid, ttu08KnownSerialNumbers[0], APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE)) ||
+                (0 == memcmp(pu08Uid, ttu08KnownSerialNumbers[1], APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE)) ||
+                (0 == memcmp(pu08Uid, ttu08KnownSerialNumbers[2], APP_PIPELINE_KNOWN_SERIAL_NUMBER_SIZE)));
+    s32RetVal = ESP_OK;
+  }
+  else if(ESP_ERR_NOT_FOUND == s32RetVal)
+  {
+    *pbKnown = false;
+    s32RetVal = ESP_OK;
+  }
+  else
+  {
+    *pbKnown = (ESP_OK == s32RetVal);
+  }
+  return s32RetVal;
+}
+
+/* UNIX time of the scan in ms, 0 when it is unknown */
+static int64_t _app_pipeline_get_timestamp(const app_journal_record_t *pstRecord)
+{
+  int64_t s64Timestamp;
+  app_trace_span_t stSpan;
+
+  s64Timestamp = pstRecord->s64Timestamp;
+  app_trace_begin(&stSpan);
+  if((0 == s64Timestamp) &&
+     pstRecord->s64CaptureUs &&
+     (ESP_OK != app_time_to_unix_ms(pstRecord->s64CaptureUs, &s64Timestamp)))
+  {
+    ESP_LOGW(APP_PIPELINE_TAG, "Time is not set --> formatting data without timestamp");
+    s64Timestamp = 0;
+  }
+  app_trace_end(&stSpan, APP_TRACE_TIMESTAMP);
+  return s64Timestamp;
+}
+
+/* Fields of the scan document, the timestamp is left out when unknown */
+static void _app_pipeline_write_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  int64_t s64Timestamp;
+  const app_journal_record_t *pstRecord;
+
+  pstRecord = (const app_journal_record_t *)pvArg;
+  app_doc_add_hex(pstDoc, "sn", pstRecord->tu08Uid, pstRecord->u08UidLength);
+  app_doc_add_integer(pstDoc, "reader", pstRecord->u08ReaderId);
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+  app_doc_add_string(pstDoc, "node", tcNodeId);
+#endif
+  s64Timestamp = _app_pipeline_get_timestamp(pstRecord);
+  if(s64Timestamp)
+  {
+    app_doc_add_integer(pstDoc, "timestamp", s64Timestamp);
+  }
+}
+
+static esp_err_t _app_pipeline_add_to_batch(const app_journal_record_t *pstRecord)
+{
+  esp_err_t s32RetVal;
+  app_trace_span_t stSpan;
+#if APP_PIPELINE_FIRESTORE_WRITE_MODEL != APP_PIPELINE_WRITE_MODEL_SINGLE
+  char tcPath[APP_PIPELINE_FIRESTORE_PATH_MAX_SIZE];
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = tcPath,
+    .pfFields = _app_pipeline_write_fields,
+    .pvArg = pstRecord,
+    .ppcMask = tpcShardedMask,
+    .u32MaskCount = sizeof(tpcShardedMask) / sizeof(tpcShardedMask[0]),
+    .pcRequestTimeField = APP_PIPELINE_FIRESTORE_LAST_SEEN_FIELD,
+    .pcCounterField = APP_PIPELINE_FIRESTORE_SCANS_FIELD,
+    .bCoalesce = true,
+  };
+#endif
+
+  app_trace_begin(&stSpan);
+#if defined(APP_PIPELINE_UPLOAD_GATEWAY)
+  s32RetVal = app_gw_add(pstRecord->u08ReaderId,
+                         pstRecord->tu08Uid,
+                         pstRecord->u08UidLength,
+                         _app_pipeline_get_timestamp(pstRecord));
+#elif APP_PIPELINE_FIRESTORE_WRITE_MODEL == APP_PIPELINE_WRITE_MODEL_SINGLE
+  s32RetVal = app_batch_add(APP_PIPELINE_FIRESTORE_COLLECTION_ID"/"APP_PIPELINE_FIRESTORE_DOCUMENT_ID,
+                            _app_pipeline_write_fields,
+                            pstRecord);
+#else
+  _app_pipeline_get_document_path(pstRecord, tcPath);
+  s32RetVal = app_batch_add_write(&stWrite);
+#endif
+  app_trace_end(&stSpan, APP_TRACE_FORMAT);
+  return s32RetVal;
+}
+
+static esp_err_t _app_pipeline_upload(void)
+{
+#ifdef APP_PIPELINE_UPLOAD_GATEWAY
+  return app_gw_commit();
+#else
+  return app_batch_commit();
+#endif
+}
+
+static void _app_pipeline_upload_done(esp_err_t s32Status, uint32_t u32Scans)
+{
+  bUploadOk = (ESP_OK == s32Status);
+  if(bUploadOk)
+  {
+    app_metrics_add(APP_METRICS_UPLOADS, 1);
+    app_metrics_add(APP_METRICS_SCANS_UPLOADED, u32Scans);
+  }
+  else
+  {
+    app_metrics_add(APP_METRICS_UPLOAD_FAILURES, 1);
+    s64LastFailureUs = esp_timer_get_time();
+  }
+}
+
+/* Called once a scan is acknowledged */
+static void _app_pipeline_record_latency(app_metrics_hist_t eLatency, int64_t s64CaptureUs)
+{
+  app_load_record_latency(s64CaptureUs);
+  app_metrics_record(eLatency, (uint32_t)((esp_timer_get_time() - s64CaptureUs) / 1000));
+}
+
+#if APP_PIPELINE_FIRESTORE_BATCH_ENABLED
+static void _app_pipeline_commit(const app_journal_record_t *pstRecords, uint32_t u32Count, app_metrics_hist_t eLatency)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+
+  s32RetVal = _app_pipeline_upload();
+  if(ESP_OK != s32RetVal)
+  {
+    ESP_LOGW(APP_PIPELINE_TAG, "Upload failed --> journaling %d scans", u32Count);
+    for(u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+      app_journal_append(&pstRecords[u32Index]);
+    }
+  }
+  else
+  {
+    for(u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+      _app_pipeline_record_latency(eLatency, pstRecords[u32Index].s64CaptureUs);
+    }
+  }
+  _app_pipeline_upload_done(s32RetVal, u32Count);
+}
+#endif
+
+/* Upload the oldest scans of a lane in one batch, or one by one without
+   batches. A turn ends early when the batch is full. Returns the scans taken
+   off the lane */
+static uint32_t _app_pipeline_serve_scans(app_journal_record_t *pstRecords,
+                                          uint32_t *pu32Count,
+                                          uint32_t u32MaxRecords,
+                                          app_metrics_hist_t eLatency)
+{
+  uint32_t u32Count;
+
+  u32MaxRecords = (u32MaxRecords < *pu32Count)?u32MaxRecords:*pu32Count;
+#if APP_PIPELINE_FIRESTORE_BATCH_ENABLED
+  for(u32Count = 0;
+      (u32Count < u32MaxRecords) && (ESP_OK == _app_pipeline_add_to_batch(&pstRecords[u32Count]));
+      u32Count++);
+  if(u32Count)
+  {
+    _app_pipeline_commit(pstRecords, u32Count, eLatency);
+  }
+  else
+  {
+    /* Only a scan that can't be formatted doesn't fit in an empty batch */
+    ESP_LOGE(APP_PIPELINE_TAG, "Couldn't batch scan --> dropping it");
+    u32Count = 1;
+  }
+#else
+  for(u32Count = 0; u32Count < u32MaxRecords; u32Count++)
+  {
+    _app_pipeline_send_data(&pstRecords[u32Count], eLatency);
+  }
+#endif
+  *pu32Count -= u32Count;
+  memmove(pstRecords, &pstRecords[u32Count], *pu32Count * sizeof(app_journal_record_t));
+  return u32Count;
+}
+
+static uint32_t _app_pipeline_get_alerts(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = u32AlertCount?tstAlertRecords[0].s64CaptureUs:0;
+  return u32AlertCount;
+}
+
+static uint32_t _app_pipeline_serve_alerts(uint32_t u32MaxRecords)
+{
+  return _app_pipeline_serve_scans(tstAlertRecords, &u32AlertCount, u32MaxRecords, APP_METRICS_ALERT_LATENCY);
+}
+
+static uint32_t _app_pipeline_get_live(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = u32LiveCount?tstLiveRecords[0].s64CaptureUs:0;
+  return u32LiveCount;
+}
+
+static uint32_t _app_pipeline_serve_live(uint32_t u32MaxRecords)
+{
+  return _app_pipeline_serve_scans(tstLiveRecords, &u32LiveCount, u32MaxRecords, APP_METRICS_UPLOAD_LATENCY);
+}
+
+/* The journal is replayed while the uplink is healthy, after a failure or a
+   replay that went nowhere only once the retry time has passed. Its age isn't
+   kept, it's always ready */
+static uint32_t _app_pipeline_get_backlog(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = 0;
+  return (!app_time_is_pending() &&
+          app_wifi_is_connected() &&
+          (esp_timer_get_time() >= s64BacklogRetryUs) &&
+          (bUploadOk ||
+           ((esp_timer_get_time() - s64LastFailureUs) > (APP_PIPELINE_JOURNAL_RETRY_MS * 1000LL))))?app_journal_count():0;
+}
+
+static esp_err_t _app_pipeline_replay_record(const app_journal_record_t *pstRecord, void *pvArg)
+{
+  return _app_pipeline_add_to_batch(pstRecord);
+}
+
+/* A failed turn stays in the journal for the next attempt */
+static uint32_t _app_pipeline_serve_backlog(uint32_t u32MaxRecords)
+{
+  uint32_t u32Count;
+  uint32_t u32Journaled;
+  esp_err_t s32RetVal;
+
+  u32Journaled = app_journal_count();
+  u32Count = app_journal_replay(_app_pipeline_replay_record, NULL, u32MaxRecords);
+  if(0 == u32Count)
+  {
+    /* Corrupted records skipped by the replay are consumed, a record that
+       can't be batched or a failed read leaves the journal as it was */
+    app_journal_consume();
+    if(u32Journaled == app_journal_count())
+    {
+      ESP_LOGW(APP_PIPELINE_TAG, "Couldn't replay the journal --> retrying later");
+      s64BacklogRetryUs = esp_timer_get_time() + (APP_PIPELINE_JOURNAL_RETRY_MS * 1000LL);
+    }
+    u32Count = u32Journaled - app_journal_count();
+  }
+  else
+  {
+    s32RetVal = _app_pipeline_upload();
+    if(ESP_OK == s32RetVal)
+    {
+      ESP_LOGI(APP_PIPELINE_TAG, "Replayed %d journaled scans", u32Count);
+      s32RetVal = app_journal_consume();
+    }
+    _app_pipeline_upload_done(s32RetVal, u32Count);
+    u32Count = (ESP_OK == s32RetVal)?u32Count:0;
+  }
+  return u32Count;
+}
+
+/* Due at the end of each telemetry period, skipped while offline */
+static uint32_t _app_pipeline_get_telemetry(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = app_metrics_get_due_us();
+  return app_wifi_is_connected()?1:0;
+}
+
+/* The next document is due a period later even when this one failed */
+static uint32_t _app_pipeline_serve_telemetry(uint32_t u32MaxRecords)
+{
+  app_metrics_upload();
+  return 1;
+}
+
+static void _app_pipeline_send_data(const app_journal_record_t *pstRecord, app_metrics_hist_t eLatency)
+{
+  int s32HttpCode;
+  esp_err_t s32RetVal;
+  app_doc_t stDoc;
+  app_trace_span_t stSpan;
+
+  /* Format json document */
+  app_trace_begin(&stSpan);
+  app_doc_init(&stDoc, tcDoc, sizeof(tcDoc), NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, _app_pipeline_write_fields, pstRecord);
+  app_doc_end_object(&stDoc);
+  app_doc_finish(&stDoc, &u32DocLength);
+  app_trace_end(&stSpan, APP_TRACE_FORMAT);
+  ESP_LOGD(APP_PIPELINE_TAG, "Document length after formatting: %d", u32DocLength);
+  ESP_LOGD(APP_PIPELINE_TAG, "Document content after formatting:\r\n%.*s", u32DocLength, tcDoc);
+  if(u32DocLength > 0)
+  {
+    /* Update document in firestore or create it if it doesn't already exists,
+       the connection is kept open across documents to skip the TLS handshake */
+    s32RetVal = app_conn_request(HTTP_METHOD_PATCH,
+                                 "/"APP_PIPELINE_FIRESTORE_COLLECTION_ID"/"APP_PIPELINE_FIRESTORE_DOCUMENT_ID,
+                                 tcDoc,
+                                 u32DocLength,
+                                 NULL,
+                                 NULL,
+                                 &s32HttpCode);
+    if((ESP_OK == s32RetVal) && (200 == s32HttpCode))
+    {
+      ESP_LOGI(APP_PIPELINE_TAG, "Document updated successfully");
+      _app_pipeline_record_latency(eLatency, pstRecord->s64CaptureUs);
+    }
+    else
+    {
+      ESP_LOGE(APP_PIPELINE_TAG, "Couldn't update document, HTTP code: %d --> journaling scan", s32HttpCode);
+      app_journal_append(pstRecord);
+      s32RetVal = ESP_FAIL;
+    }
+    _app_pipeline_upload_done(s32RetVal, 1);
+  }
+  else
+  {
+    ESP_LOGE(APP_PIPELINE_TAG, "Couldn't format document");
+  }
+}
\ No newline at end of file
@@ -0,0 +1,630 @@
+#include <string.h>
+#include <stdbool.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <driver/spi_master.h>
+
+#include "app_reader.h"
+#include "app_sched.h"
+
+#define APP_READER_TAG                           "APP_READER"
+
+#define APP_READER_SPI_HOST                      VSPI_HOST
+#define APP_READER_SPI_CLOCK_HZ                  5000000
+#define APP_READER_SPI_MAX_WRITE_SIZE            16
+#define APP_READER_SPI_MAX_READ_SIZE             16
+#define APP_READER_RESET_DELAY_MS                50
+/* Timer ticks are 0.5 ms with the prescaler below, a tag answers in ~100 us */
+#define APP_READER_TIMER_RELOAD                  4
+#define APP_READER_TRANSCEIVE_TIMEOUT_US         5000
+/* Longest sleep on the IRQ line, the timer interrupt normally ends it first */
+#define APP_READER_IRQ_WAIT_TICKS                (pdMS_TO_TICKS(APP_READER_TRANSCEIVE_TIMEOUT_US / 1000) + 1)
+
+/* MFRC522 registers */
+#define APP_READER_REG_COMMAND                   0x01
+#define APP_READER_REG_COM_IEN                   0x02
+#define APP_READER_REG_DIV_IEN                   0x03
+#define APP_READER_REG_COM_IRQ                   0x04
+#define APP_READER_REG_ERROR                     0x06
+#define APP_READER_REG_FIFO_DATA                 0x09
+#define APP_READER_REG_FIFO_LEVEL                0x0A
+#define APP_READER_REG_BIT_FRAMING               0x0D
+#define APP_READER_REG_COLL                      0x0E
+#define APP_READER_REG_MODE                      0x11
+#define APP_READER_REG_TX_CONTROL                0x14
+#define APP_READER_REG_TX_ASK                    0x15
+#define APP_READER_REG_T_MODE                    0x2A
+#define APP_READER_REG_T_PRESCALER               0x2B
+#define APP_READER_REG_T_RELOAD_H                0x2C
+#define APP_READER_REG_T_RELOAD_L                0x2D
+#define APP_READER_REG_VERSION                   0x37
+
+#define APP_READER_CMD_IDLE                      0x00
+#define APP_READER_CMD_TRANSCEIVE                0x0C
+#define APP_READER_CMD_SOFT_RESET                0x0F
+
+#define APP_READER_IRQ_TIMER                     0x01
+#define APP_READER_IRQ_RX_IDLE                   0x30
+#define APP_READER_IRQ_ALL                       0x7F
+/* Active low IRQ pin driven by the end of reception and the timer */
+#define APP_READER_IRQ_PIN_INVERTED              0x80
+#define APP_READER_IRQ_PIN_PUSH_PULL             0x80
+#define APP_READER_ERROR_MASK                    0x1B
+#define APP_READER_POWER_DOWN                    0x10
+#define APP_READER_START_SEND                    0x80
+#define APP_READER_VALUES_AFTER_COLL             0x80
+#define APP_READER_FIFO_FLUSH                    0x80
+#define APP_READER_ANTENNA_ON                    0x03
+
+/* ISO 14443-3 commands */
+#define APP_READER_PICC_REQA                     0x26
+#define APP_READER_PICC_REQA_BITS                0x07
+#define APP_READER_PICC_SEL_CL1                  0x93
+#define APP_READER_PICC_SEL_STEP                 0x02
+#define APP_READER_PICC_NVB_NONE                 0x20
+#define APP_READER_PICC_NVB_ALL                  0x70
+#define APP_READER_PICC_CASCADE_TAG              0x88
+#define APP_READER_SAK_UID_INCOMPLETE            0x04
+#define APP_READER_CASCADE_LEVELS                3
+#define APP_READER_CRC_A_PRESET                  0x6363
+#define APP_READER_ATQA_SIZE                     2
+/* Four UID bytes or the cascade tag and three UID bytes, then their BCC */
+#define APP_READER_UID_PART_SIZE                 5
+/* SAK followed by its CRC_A */
+#define APP_READER_SAK_SIZE                      3
+/* A single size UID keeps its BCC, reported as is like the previous driver,
+   double and triple size UIDs have 7 and 10 bytes */
+#define APP_READER_UID_MAX_SIZE                  10
+
+typedef struct
+{
+  spi_device_handle_t pstDevice;
+  int s32IrqPin;
+  app_reader_stats_t stStats;
+}reader_t;
+
+typedef struct
+{
+  app_reader_start_args_t stArgs;
+  TaskHandle_t pstTask;
+  reader_t tstReaders[APP_READER_MAX_COUNT];
+  uint8_t tu08Schedule[APP_READER_MAX_COUNT * APP_READER_MAX_WEIGHT];
+  uint32_t u32ScheduleLength;
+}reader_ctx_t;
+
+static reader_ctx_t stCtx;
+
+/* Consecutive bytes are all written to the same register, e.g. the FIFO */
+static esp_err_t _app_reader_write(reader_t *pstReader, uint8_t u08Reg, const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint8_t tu08Tx[1 + APP_READER_SPI_MAX_WRITE_SIZE];
+  spi_transaction_t stTransaction;
+
+  tu08Tx[0] = (u08Reg << 1) & 0x7E;
+  memcpy(&tu08Tx[1], pu08Data, u32Length);
+  memset(&stTransaction, 0x00, sizeof(stTransaction));
+  stTransaction.length = (1 + u32Length) * 8;
+  stTransaction.tx_buffer = tu08Tx;
+  return spi_device_polling_transmit(pstReader->pstDevice, &stTransaction);
+}
+
+/* Burst read of the same register: its address is sent once per byte and the
+   data comes back one byte later, so a FIFO takes a single transaction */
+static esp_err_t _app_reader_read(reader_t *pstReader, uint8_t u08Reg, uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint8_t tu08Tx[1 + APP_READER_SPI_MAX_READ_SIZE];
+  uint8_t tu08Rx[1 + APP_READER_SPI_MAX_READ_SIZE];
+  spi_transaction_t stTransaction;
+  esp_err_t s32RetVal;
+
+  memset(tu08Tx, ((u08Reg << 1) & 0x7E) | 0x80, u32Length);
+  tu08Tx[u32Length] = 0x00;
+  memset(&stTransaction, 0x00, sizeof(stTransaction));
+  stTransaction.length = (1 + u32Length) * 8;
+  stTransaction.tx_buffer = tu08Tx;
+  stTransaction.rx_buffer = tu08Rx;
+  s32RetVal = spi_device_polling_transmit(pstReader->pstDevice, &stTransaction);
+  if(ESP_OK == s32RetVal)
+  {
+    memcpy(pu08Data, &tu08Rx[1], u32Length);
+  }
+  return s32RetVal;
+}
+
+static esp_err_t _app_reader_write_reg(reader_t *pstReader, uint8_t u08Reg, uint8_t u08Value)
+{
+  return _app_reader_write(pstReader, u08Reg, &u08Value, 1);
+}
+
+/* A failed transfer reads as 0x00 */
+static uint8_t _app_reader_read_reg(reader_t *pstReader, uint8_t u08Reg)
+{
+  spi_transaction_t stTransaction;
+
+  memset(&stTransaction, 0x00, sizeof(stTransaction));
+  stTransaction.flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+  stTransaction.length = 16;
+  stTransaction.tx_data[0] = ((u08Reg << 1) & 0x7E) | 0x80;
+  if(ESP_OK != spi_device_polling_transmit(pstReader->pstDevice, &stTransaction))
+  {
+    stTransaction.rx_data[1] = 0x00;
+  }
+  return stTransaction.rx_data[1];
+}
+
+static void _app_reader_update_reg(reader_t *pstReader, uint8_t u08Reg, uint8_t u08Set, uint8_t u08Clear)
+{
+  uint8_t u08Value;
+
+  u08Value = _app_reader_read_reg(pstReader, u08Reg);
+  _app_reader_write_reg(pstReader, u08Reg, (u08Value | u08Set) & ~u08Clear);
+}
+
+static void _app_reader_set_field(reader_t *pstReader, bool bOn)
+{
+  _app_reader_update_reg(pstReader,
+                         APP_READER_REG_TX_CONTROL,
+                         bOn?APP_READER_ANTENNA_ON:0,
+                         bOn?0:APP_READER_ANTENNA_ON);
+}
+
+/* Wakes the reader task up from its transceive wait, readers take turns so at
+   most one of them has an exchange in flight */
+static void IRAM_ATTR _app_reader_isr(void *pvArg)
+{
+  BaseType_t s32Woken;
+
+  s32Woken = pdFALSE;
+  if(stCtx.pstTask)
+  {
+    vTaskNotifyGiveFromISR(stCtx.pstTask, &s32Woken);
+  }
+  if(s32Woken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/* Send a frame and collect the answer, ESP_ERR_NOT_FOUND means no tag answered
+   before the reader timer expired. With an IRQ line the task sleeps until the
+   reader raises it instead of polling COM_IRQ over the bus */
+static esp_err_t _app_reader_transceive(reader_t *pstReader,
+                                        const uint8_t *pu08Tx,
+                                        uint32_t u32TxLength,
+                                        uint8_t u08TxLastBits,
+                                        uint8_t *pu08Rx,
+                                        uint32_t *pu32RxLength)
+{
+  int64_t s64DeadlineUs;
+  uint8_t u08Irq;
+  uint32_t u32Level;
+  esp_err_t s32RetVal;
+
+  _app_reader_write_reg(pstReader, APP_READER_REG_COMMAND, APP_READER_CMD_IDLE);
+  _app_reader_write_reg(pstReader, APP_READER_REG_COM_IRQ, APP_READER_IRQ_ALL);
+  if(pstReader->s32IrqPin > 0)
+  {
+    /* Drop a wake up left over by the previous exchange */
+    ulTaskNotifyTake(pdTRUE, 0);
+  }
+  _app_reader_write_reg(pstReader, APP_READER_REG_FIFO_LEVEL, APP_READER_FIFO_FLUSH);
+  _app_reader_write(pstReader, APP_READER_REG_FIFO_DATA, pu08Tx, u32TxLength);
+  _app_reader_write_reg(pstReader, APP_READER_REG_BIT_FRAMING, u08TxLastBits);
+  _app_reader_write_reg(pstReader, APP_READER_REG_COMMAND, APP_READER_CMD_TRANSCEIVE);
+  _app_reader_update_reg(pstReader, APP_READER_REG_BIT_FRAMING, APP_READER_START_SEND, 0);
+  /* The reader timer starts once the frame is sent and bounds the wait */
+  s32RetVal = ESP_ERR_TIMEOUT;
+  s64DeadlineUs = esp_timer_get_time() + APP_READER_TRANSCEIVE_TIMEOUT_US;
+  do
+  {
+    if(pstReader->s32IrqPin > 0)
+    {
+      ulTaskNotifyTake(pdTRUE, APP_READER_IRQ_WAIT_TICKS);
+    }
+    u08Irq = _app_reader_read_reg(pstReader, APP_READER_REG_COM_IRQ);
+    if(u08Irq & APP_READER_IRQ_RX_IDLE)
+    {
+      s32RetVal = ESP_OK;
+    }
+    else if(u08Irq & APP_READER_IRQ_TIMER)
+    {
+      s32RetVal = ESP_ERR_NOT_FOUND;
+    }
+  }while((ESP_ERR_TIMEOUT == s32RetVal) && (esp_timer_get_time() < s64DeadlineUs));
+  _app_reader_update_reg(pstReader, APP_READER_REG_BIT_FRAMING, 0, APP_READER_START_SEND);
+  if(ESP_OK == s32RetVal)
+  {
+    u32Level = _app_reader_read_reg(pstReader, APP_READER_REG_FIFO_LEVEL);
+    if(_app_reader_read_reg(pstReader, APP_READER_REG_ERROR) & APP_READER_ERROR_MASK)
+    {
+      /* Collision, parity, protocol error or overflow */
+      s32RetVal = ESP_FAIL;
+    }
+    else if((u32Level != *pu32RxLength) || (u32Level > APP_READER_SPI_MAX_READ_SIZE))
+    {
+      s32RetVal = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+      s32RetVal = _app_reader_read(pstReader, APP_READER_REG_FIFO_DATA, pu08Rx, u32Level);
+    }
+  }
+  return s32RetVal;
+}
+
+/* ISO 14443-3 CRC_A, sent LSB first */
+static uint16_t _app_reader_crc_a(const uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint8_t u08Bit;
+  uint16_t u16Crc;
+  uint32_t u32Index;
+
+  u16Crc = APP_READER_CRC_A_PRESET;
+  for(u32Index = 0; u32Index < u32Length; u32Index++)
+  {
+    u16Crc ^= pu08Data[u32Index];
+    for(u08Bit = 0; u08Bit < 8; u08Bit++)
+    {
+      u16Crc = (u16Crc & 0x0001)?((u16Crc >> 1) ^ 0x8408):(u16Crc >> 1);
+    }
+  }
+  return u16Crc;
+}
+
+/* Select the part of the UID read at a cascade level, the SAK tells whether
+   another level follows */
+static esp_err_t _app_reader_select(reader_t *pstReader, uint8_t u08Sel, const uint8_t *pu08Part, uint8_t *pu08Sak)
+{
+  uint16_t u16Crc;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+  uint8_t tu08Tx[2 + APP_READER_UID_PART_SIZE + 2];
+  uint8_t tu08Rx[APP_READER_SAK_SIZE];
+
+  tu08Tx[0] = u08Sel;
+  tu08Tx[1] = APP_READER_PICC_NVB_ALL;
+  memcpy(&tu08Tx[2], pu08Part, APP_READER_UID_PART_SIZE);
+  u16Crc = _app_reader_crc_a(tu08Tx, 2 + APP_READER_UID_PART_SIZE);
+  tu08Tx[2 + APP_READER_UID_PART_SIZE] = u16Crc & 0xFF;
+  tu08Tx[3 + APP_READER_UID_PART_SIZE] = u16Crc >> 8;
+  u32Length = sizeof(tu08Rx);
+  s32RetVal = _app_reader_transceive(pstReader, tu08Tx, sizeof(tu08Tx), 0, tu08Rx, &u32Length);
+  if(ESP_OK == s32RetVal)
+  {
+    u16Crc = _app_reader_crc_a(tu08Rx, 1);
+    s32RetVal = ((tu08Rx[1] == (u16Crc & 0xFF)) && (tu08Rx[2] == (u16Crc >> 8)))?ESP_OK:ESP_ERR_INVALID_CRC;
+    *pu08Sak = tu08Rx[0];
+  }
+  return s32RetVal;
+}
+
+/* Wake up an idle tag then walk its cascade levels. A level starting with the
+   cascade tag is selected to reach the next one, the last level isn't as its
+   UID bytes are all that's needed */
+static esp_err_t _app_reader_read_uid(reader_t *pstReader, uint8_t *pu08Uid, uint8_t *pu08Length)
+{
+  bool bComplete;
+  uint8_t u08Sak;
+  uint8_t u08Bcc;
+  uint8_t u08Level;
+  uint8_t tu08Tx[2];
+  uint8_t tu08Atqa[APP_READER_ATQA_SIZE];
+  uint8_t tu08Part[APP_READER_UID_PART_SIZE];
+  uint32_t u32Index;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+
+  *pu08Length = 0;
+  bComplete = false;
+  tu08Tx[0] = APP_READER_PICC_REQA;
+  u32Length = sizeof(tu08Atqa);
+  s32RetVal = _app_reader_transceive(pstReader, tu08Tx, 1, APP_READER_PICC_REQA_BITS, tu08Atqa, &u32Length);
+  if(ESP_OK == s32RetVal)
+  {
+    _app_reader_update_reg(pstReader, APP_READER_REG_COLL, 0, APP_READER_VALUES_AFTER_COLL);
+  }
+  for(u08Level = 0; (ESP_OK == s32RetVal) && !bComplete && (u08Level < APP_READER_CASCADE_LEVELS); u08Level++)
+  {
+    tu08Tx[0] = APP_READER_PICC_SEL_CL1 + u08Level * APP_READER_PICC_SEL_STEP;
+    tu08Tx[1] = APP_READER_PICC_NVB_NONE;
+    u32Length = sizeof(tu08Part);
+    s32RetVal = _app_reader_transceive(pstReader, tu08Tx, 2, 0, tu08Part, &u32Length);
+    if(ESP_OK == s32RetVal)
+    {
+      u08Bcc = 0;
+      for(u32Index = 0; u32Index < (APP_READER_UID_PART_SIZE - 1); u32Index++)
+      {
+        u08Bcc ^= tu08Part[u32Index];
+      }
+      s32RetVal = (u08Bcc == tu08Part[APP_READER_UID_PART_SIZE - 1])?ESP_OK:ESP_ERR_INVALID_CRC;
+    }
+    if(ESP_OK != s32RetVal)
+    {
+      /* Nothing more to read */
+    }
+    else if(APP_READER_PICC_CASCADE_TAG == tu08Part[0])
+    {
+      s32RetVal = _app_reader_select(pstReader, tu08Tx[0], tu08Part, &u08Sak);
+      if((ESP_OK == s32RetVal) && !(u08Sak & APP_READER_SAK_UID_INCOMPLETE))
+      {
+        s32RetVal = ESP_ERR_INVALID_RESPONSE;
+      }
+      memcpy(&pu08Uid[*pu08Length], &tu08Part[1], APP_READER_UID_PART_SIZE - 2);
+      *pu08Length += APP_READER_UID_PART_SIZE - 2;
+    }
+    else
+    {
+      u32Length = u08Level?(APP_READER_UID_PART_SIZE - 1):APP_READER_UID_PART_SIZE;
+      memcpy(&pu08Uid[*pu08Length], tu08Part, u32Length);
+      *pu08Length += u32Length;
+      bComplete = true;
+    }
+  }
+  if((ESP_OK == s32RetVal) && !bComplete)
+  {
+    s32RetVal = ESP_ERR_INVALID_RESPONSE;
+  }
+  return s32RetVal;
+}
+
+/* A reader whose IRQ line can't be set up falls back to polling */
+static void _app_reader_init_irq(reader_t *pstReader, int s32IrqPin)
+{
+  esp_err_t s32RetVal;
+  gpio_config_t stIoConfig =
+  {
+    .pin_bit_mask = 1ULL << s32IrqPin,
+    .mode = GPIO_MODE_INPUT,
+    .pull_up_en = GPIO_PULLUP_ENABLE,
+    .intr_type = GPIO_INTR_NEGEDGE,
+  };
+
+  s32RetVal = gpio_config(&stIoConfig);
+  if(ESP_OK == s32RetVal)
+  {
+    /* Already installed by another module is fine */
+    s32RetVal = gpio_install_isr_service(0);
+    s32RetVal = (ESP_ERR_INVALID_STATE == s32RetVal)?ESP_OK:s32RetVal;
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    s32RetVal = gpio_isr_handler_add(s32IrqPin, _app_reader_isr, NULL);
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    _app_reader_write_reg(pstReader, APP_READER_REG_DIV_IEN, APP_READER_IRQ_PIN_PUSH_PULL);
+    _app_reader_write_reg(pstReader,
+                          APP_READER_REG_COM_IEN,
+                          APP_READER_IRQ_PIN_INVERTED | APP_READER_IRQ_RX_IDLE | APP_READER_IRQ_TIMER);
+    pstReader->s32IrqPin = s32IrqPin;
+  }
+  else
+  {
+    ESP_LOGW(APP_READER_TAG, "IRQ on GPIO %d unavailable, polling: %s", s32IrqPin, esp_err_to_name(s32RetVal));
+  }
+}
+
+static esp_err_t _app_reader_init(reader_t *pstReader, int s32CsPin, int s32IrqPin)
+{
+  uint8_t u08Version;
+  esp_err_t s32RetVal;
+  spi_device_interface_config_t stDeviceConfig =
+  {
+    .clock_speed_hz = APP_READER_SPI_CLOCK_HZ,
+    .mode = 0,
+    .spics_io_num = s32CsPin,
+    .queue_size = 1,
+  };
+
+  s32RetVal = spi_bus_add_device(APP_READER_SPI_HOST, &stDeviceConfig, &pstReader->pstDevice);
+  if(ESP_OK == s32RetVal)
+  {
+    _app_reader_write_reg(pstReader, APP_READER_REG_COMMAND, APP_READER_CMD_SOFT_RESET);
+    vTaskDelay(pdMS_TO_TICKS(APP_READER_RESET_DELAY_MS));
+    u08Version = _app_reader_read_reg(pstReader, APP_READER_REG_VERSION);
+    if((0x00 == u08Version) ||
+       (0xFF == u08Version) ||
+       (_app_reader_read_reg(pstReader, APP_READER_REG_COMMAND) & APP_READER_POWER_DOWN))
+    {
+      s32RetVal = ESP_ERR_NOT_FOUND;
+      spi_bus_remove_device(pstReader->pstDevice);
+      pstReader->pstDevice = NULL;
+    }
+    else
+    {
+      /* Timer auto start with 0.5 ms ticks, 100% ASK, CRC preset 0x6363 */
+      _app_reader_write_reg(pstReader, APP_READER_REG_T_MODE, 0x8D);
+      _app_reader_write_reg(pstReader, APP_READER_REG_T_PRESCALER, 0x3E);
+      _app_reader_write_reg(pstReader, APP_READER_REG_T_RELOAD_H, 0x00);
+      _app_reader_write_reg(pstReader, APP_READER_REG_T_RELOAD_L, APP_READER_TIMER_RELOAD);
+      _app_reader_write_reg(pstReader, APP_READER_REG_TX_ASK, 0x40);
+      _app_reader_write_reg(pstReader, APP_READER_REG_MODE, 0x3D);
+      _app_reader_set_field(pstReader, false);
+      if(s32IrqPin > 0)
+      {
+        _app_reader_init_irq(pstReader, s32IrqPin);
+      }
+      ESP_LOGI(APP_READER_TAG,
+               "Reader on CS %d ready, version: 0x%02X, %s",
+               s32CsPin,
+               u08Version,
+               (pstReader->s32IrqPin > 0)?"IRQ driven":"polled");
+    }
+  }
+  return s32RetVal;
+}
+
+/* Spread the slots of every reader over the round so a reader with weight w is
+   polled w times per round at regular intervals (smooth weighted round-robin) */
+static void _app_reader_build_schedule(void)
+{
+  int32_t s32Best;
+  uint32_t u32Total;
+  uint32_t u32Index;
+  uint32_t u32Weight;
+  int32_t ts32Current[APP_READER_MAX_COUNT];
+
+  u32Total = 0;
+  memset(ts32Current, 0x00, sizeof(ts32Current));
+  for(u32Index = 0; u32Index < stCtx.stArgs.u32ReaderCount; u32Index++)
+  {
+    if(stCtx.tstReaders[u32Index].pstDevice)
+    {
+      u32Weight = (APP_READER_PRIORITY == stCtx.stArgs.ePolicy)?stCtx.stArgs.tstReaders[u32Index].u32Weight:1;
+      stCtx.stArgs.tstReaders[u32Index].u32Weight = u32Weight;
+      u32Total += u32Weight;
+    }
+  }
+  for(stCtx.u32ScheduleLength = 0; stCtx.u32ScheduleLength < u32Total; stCtx.u32ScheduleLength++)
+  {
+    s32Best = -1;
+    for(u32Index = 0; u32Index < stCtx.stArgs.u32ReaderCount; u32Index++)
+    {
+      if(stCtx.tstReaders[u32Index].pstDevice)
+      {
+        ts32Current[u32Index] += stCtx.stArgs.tstReaders[u32Index].u32Weight;
+        if((s32Best < 0) || (ts32Current[u32Index] > ts32Current[s32Best]))
+        {
+          s32Best = u32Index;
+        }
+      }
+    }
+    ts32Current[s32Best] -= (int32_t)u32Total;
+    stCtx.tu08Schedule[stCtx.u32ScheduleLength] = s32Best;
+  }
+}
+
+static void _app_reader_poll(uint8_t u08Index)
+{
+  int64_t s64StartUs;
+  uint32_t u32ElapsedUs;
+  esp_err_t s32RetVal;
+  reader_t *pstReader;
+  uint8_t u08UidLength;
+  uint8_t tu08Uid[APP_READER_UID_MAX_SIZE];
+
+  pstReader = &stCtx.tstReaders[u08Index];
+  s64StartUs = esp_timer_get_time();
+  s32RetVal = _app_reader_read_uid(pstReader, tu08Uid, &u08UidLength);
+  u32ElapsedUs = (uint32_t)(esp_timer_get_time() - s64StartUs);
+  pstReader->stStats.u32Polls++;
+  pstReader->stStats.u32MaxPollUs = (u32ElapsedUs > pstReader->stStats.u32MaxPollUs)?
+                                    u32ElapsedUs:pstReader->stStats.u32MaxPollUs;
+  if(ESP_OK == s32RetVal)
+  {
+    pstReader->stStats.u32Detections++;
+    stCtx.stArgs.pfCallback(u08Index, tu08Uid, u08UidLength);
+  }
+  else if(ESP_ERR_NOT_FOUND != s32RetVal)
+  {
+    pstReader->stStats.u32Errors++;
+    ESP_LOGD(APP_READER_TAG, "Reader %d: %s", u08Index, esp_err_to_name(s32RetVal));
+  }
+}
+
+/* Only one field is on at a time: the next reader is powered for a whole slot
+   before it is polled so the tag has time to wake up, then turned off again
+   which also resets a tag left in front of it */
+static void _app_reader_task(void *pvParameter)
+{
+  uint32_t u32Slot;
+  TickType_t u32SlotTicks;
+
+  u32Slot = 0;
+  stCtx.pstTask = xTaskGetCurrentTaskHandle();
+  u32SlotTicks = pdMS_TO_TICKS(stCtx.stArgs.u32SlotMs);
+  u32SlotTicks = u32SlotTicks?u32SlotTicks:1;
+  _app_reader_set_field(&stCtx.tstReaders[stCtx.tu08Schedule[0]], true);
+  while(1)
+  {
+    vTaskDelay(u32SlotTicks);
+    _app_reader_poll(stCtx.tu08Schedule[u32Slot]);
+    _app_reader_set_field(&stCtx.tstReaders[stCtx.tu08Schedule[u32Slot]], false);
+    u32Slot = (u32Slot + 1) % stCtx.u32ScheduleLength;
+    if((0 == u32Slot) && stCtx.stArgs.u32IdleMs)
+    {
+      vTaskDelay(pdMS_TO_TICKS(stCtx.stArgs.u32IdleMs));
+    }
+    _app_reader_set_field(&stCtx.tstReaders[stCtx.tu08Schedule[u32Slot]], true);
+  }
+}
+
+esp_err_t app_reader_start(const app_reader_start_args_t *pstArgs)
+{
+  uint32_t u32Index;
+  esp_err_t s32RetVal;
+  spi_bus_config_t stBusConfig;
+
+  if((NULL == pstArgs) ||
+     (NULL == pstArgs->pfCallback) ||
+     (0 == pstArgs->u32ReaderCount) ||
+     (pstArgs->u32ReaderCount > APP_READER_MAX_COUNT))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    memset(&stCtx, 0x00, sizeof(stCtx));
+    memcpy(&stCtx.stArgs, pstArgs, sizeof(app_reader_start_args_t));
+    for(u32Index = 0; u32Index < pstArgs->u32ReaderCount; u32Index++)
+    {
+      if((0 == stCtx.stArgs.tstReaders[u32Index].u32Weight) ||
+         (stCtx.stArgs.tstReaders[u32Index].u32Weight > APP_READER_MAX_WEIGHT))
+      {
+        stCtx.stArgs.tstReaders[u32Index].u32Weight = 1;
+      }
+    }
+    memset(&stBusConfig, 0x00, sizeof(stBusConfig));
+    stBusConfig.miso_io_num = pstArgs->s32MisoPin;
+    stBusConfig.mosi_io_num = pstArgs->s32MosiPin;
+    stBusConfig.sclk_io_num = pstArgs->s32SckPin;
+    stBusConfig.quadwp_io_num = -1;
+    stBusConfig.quadhd_io_num = -1;
+    s32RetVal = spi_bus_initialize(APP_READER_SPI_HOST, &stBusConfig, 0);
+    if(ESP_OK == s32RetVal)
+    {
+      /* A missing reader is left out of the schedule, the others keep working */
+      for(u32Index = 0; u32Index < pstArgs->u32ReaderCount; u32Index++)
+      {
+        if(ESP_OK != _app_reader_init(&stCtx.tstReaders[u32Index],
+                                      pstArgs->tstReaders[u32Index].s32CsPin,
+                                      pstArgs->tstReaders[u32Index].s32IrqPin))
+        {
+          ESP_LOGE(APP_READER_TAG, "Reader %d on CS %d not found", u32Index, pstArgs->tstReaders[u32Index].s32CsPin);
+        }
+      }
+      _app_reader_build_schedule();
+      s32RetVal = stCtx.u32ScheduleLength?ESP_OK:ESP_ERR_NOT_FOUND;
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = app_sched_create(APP_SCHED_TASK_READER, _app_reader_task, NULL);
+    }
+    else
+    {
+      ESP_LOGE(APP_READER_TAG, "Failed to start readers: %s", esp_err_to_name(s32RetVal));
+    }
+  }
+  return s32RetVal;
+}
+
+esp_err_t app_reader_get_stats(uint8_t u08Index, app_reader_stats_t *pstStats)
+{
+  esp_err_t s32RetVal;
+
+  if((NULL == pstStats) || (u08Index >= stCtx.stArgs.u32ReaderCount))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    memcpy(pstStats, &stCtx.tstReaders[u08Index].stStats, sizeof(app_reader_stats_t));
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <string.h>
+#include <stdatomic.h>
+
+#include "app_ring.h"
+
+#define APP_RING_MASK                            (APP_RING_CAPACITY - 1)
+
+_Static_assert((APP_RING_CAPACITY & APP_RING_MASK) == 0, "APP_RING_CAPACITY must be a power of 2");
+
+void app_ring_init(app_ring_t *pstRing, app_ring_policy_t ePolicy)
+{
+  if(pstRing)
+  {
+    memset(pstRing, 0x00, sizeof(app_ring_t));
+    atomic_init(&pstRing->u32Head, 0);
+    atomic_init(&pstRing->u32Tail, 0);
+    atomic_init(&pstRing->u32DroppedOldest, 0);
+    atomic_init(&pstRing->u32DroppedNewest, 0);
+    pstRing->ePolicy = ePolicy;
+  }
+}
+
+/* Producer side: never blocks, on overflow either the oldest unread event is
+   discarded to make room or the new one is rejected depending on the policy */
+esp_err_t app_ring_push(app_ring_t *pstRing, const app_tag_t *pstTag)
+{
+  uint32_t u32Head;
+  uint32_t u32Tail;
+  uint32_t u32Depth;
+  esp_err_t s32RetVal;
+
+  if(pstRing && pstTag)
+  {
+    s32RetVal = ESP_OK;
+    u32Head = atomic_load_explicit(&pstRing->u32Head, memory_order_relaxed);
+    u32Tail = atomic_load_explicit(&pstRing->u32Tail, memory_order_acquire);
+    if((u32Head - u32Tail) >= APP_RING_CAPACITY)
+    {
+      if(APP_RING_DROP_OLDEST == pstRing->ePolicy)
+      {
+        /* Steal the oldest slot from the consumer, if the CAS fails the consumer
+           just popped it and there is room now */
+        if(atomic_compare_exchange_strong(&pstRing->u32Tail, &u32Tail, u32Tail + 1))
+        {
+          atomic_fetch_add_explicit(&pstRing->u32DroppedOldest, 1, memory_order_relaxed);
+        }
+      }
+      else
+      {
+        atomic_fetch_add_explicit(&pstRing->u32DroppedNewest, 1, memory_order_relaxed);
+        s32RetVal = ESP_ERR_NO_MEM;
+      }
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      memcpy(&pstRing->tstSlots[u32Head & APP_RING_MASK], pstTag, sizeof(app_tag_t));
+      atomic_store_explicit(&pstRing->u32Head, u32Head + 1, memory_order_release);
+      pstRing->u32Pushed++;
+      u32Depth = u32Head + 1 - atomic_load_explicit(&pstRing->u32Tail, memory_order_relaxed);
+      pstRing->u32HighWater = (u32Depth > pstRing->u32HighWater)?u32Depth:pstRing->u32HighWater;
+    }
+  }
+  else
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  return s32RetVal;
+}
+
+/* Consumer side: the slot is copied out first and only claimed afterwards so a
+   copy torn by a concurrent drop-oldest overwrite is detected and retried */
+esp_err_t app_ring_pop(app_ring_t *pstRing, app_tag_t *pstTag)
+{
+  uint32_t u32Head;
+  uint32_t u32Tail;
+  esp_err_t s32RetVal;
+
+  if(pstRing && pstTag)
+  {
+    s32RetVal = ESP_ERR_NOT_FOUND;
+    u32Tail = atomic_load_explicit(&pstRing->u32Tail, memory_order_acquire);
+    do
+    {
+      u32Head = atomic_load_explicit(&pstRing->u32Head, memory_order_acquire);
+      if(u32Head == u32Tail)
+      {
+        break;
+      }
+      memcpy(pstTag, &pstRing->tstSlots[u32Tail & APP_RING_MASK], sizeof(app_tag_t));
+      if(atomic_compare_exchange_strong(&pstRing->u32Tail, &u32Tail, u32Tail + 1))
+      {
+        pstRing->u32Popped++;
+        s32RetVal = ESP_OK;
+      }
+    }while(ESP_OK != s32RetVal);
+  }
+  else
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  return s32RetVal;
+}
+
+uint32_t app_ring_count(app_ring_t *pstRing)
+{
+  uint32_t u32Tail;
+
+  u32Tail = atomic_load_explicit(&pstRing->u32Tail, memory_order_acquire);
+  return atomic_load_explicit(&pstRing->u32Head, memory_order_acquire) - u32Tail;
+}
+
+void app_ring_get_stats(app_ring_t *pstRing, app_ring_stats_t *pstStats)
+{
+  if(pstRing && pstStats)
+  {
+    pstStats->u32Pushed = pstRing->u32Pushed;
+    pstStats->u32Popped = pstRing->u32Popped;
+    pstStats->u32DroppedOldest = atomic_load(&pstRing->u32DroppedOldest);
+    pstStats->u32DroppedNewest = atomic_load(&pstRing->u32DroppedNewest);
+    pstStats->u32HighWater = pstRing->u32HighWater;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <sdkconfig.h>
+#include <esp_log.h>
+
+#include "app_mem.h"
+#include "app_sched.h"
+
+#define APP_SCHED_TAG                            "APP_SCHED"
+
+/* Scans are captured on the APP CPU, Wi-Fi, lwIP and everything that talks to
+   the network runs on the PRO CPU next to them */
+#define APP_SCHED_SCAN_CORE                      1
+#define APP_SCHED_NETWORK_CORE                   0
+/* Background work drops to this priority while scans are waiting */
+#define APP_SCHED_DEMOTED_PRIORITY               (tskIDLE_PRIORITY + 1)
+#ifndef APP_SCHED_MONITOR_PERIOD_MS
+#define APP_SCHED_MONITOR_PERIOD_MS              60000
+#endif
+#define APP_SCHED_MAX_SYSTEM_TASKS               32
+
+typedef struct
+{
+  const char *pcName;
+  uint32_t u32StackSize;
+  UBaseType_t u32Priority;
+  BaseType_t s32Core;
+  bool bBackground;
+  /* Priority used when built with APP_SCHED_NO_PLAN, as before the plan */
+  UBaseType_t u32UnpinnedPriority;
+}sched_plan_t;
+
+typedef struct
+{
+  TaskHandle_t pstHandle;
+  uint32_t u32LastRunTime;
+  app_sched_task_stats_t stStats;
+}sched_task_t;
+
+typedef struct
+{
+  portMUX_TYPE stLock;
+  bool bBusy;
+  uint32_t u32LastTotalRunTime;
+  sched_task_t tstTasks[APP_SCHED_TASK_COUNT];
+  TaskStatus_t tstStatus[APP_SCHED_MAX_SYSTEM_TASKS];
+}sched_ctx_t;
+
+static const sched_plan_t tstPlan[APP_SCHED_TASK_COUNT] =
+{
+  [APP_SCHED_TASK_READER]    = {"reader",
+                                CONFIG_RFID_READER_TASK_STACK_SIZE,
+                                CONFIG_RFID_READER_TASK_PRIORITY,
+                                APP_SCHED_SCAN_CORE,    false, 5},
+  [APP_SCHED_TASK_FIRESTORE] = {"firestore",
+                                CONFIG_RFID_UPLOAD_TASK_STACK_SIZE,
+                                CONFIG_RFID_UPLOAD_TASK_PRIORITY,
+                                APP_SCHED_NETWORK_CORE, false, 4},
+  [APP_SCHED_TASK_OTA]       = {"check_update", CONFIG_RFID_OTA_TASK_STACK_SIZE,   3, APP_SCHED_NETWORK_CORE, true,  6},
+  [APP_SCHED_TASK_SYNC]      = {"sync",         CONFIG_RFID_SYNC_TASK_STACK_SIZE,  3, APP_SCHED_NETWORK_CORE, true,  3},
+  [APP_SCHED_TASK_TRACE]     = {"trace",        CONFIG_RFID_TRACE_TASK_STACK_SIZE, 2, APP_SCHED_NETWORK_CORE, true,  2},
+  [APP_SCHED_TASK_MONITOR]   = {"sched",        3072,                              1, APP_SCHED_SCAN_CORE,    false, 1},
+};
+
+static sched_ctx_t stCtx =
+{
+  .stLock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Create one of the tasks of the plan with its stack, priority and core */
+esp_err_t app_sched_create(app_sched_task_t eTask, TaskFunction_t pfTask, void *pvArg)
+{
+  BaseType_t s32Created;
+  esp_err_t s32RetVal;
+
+  if((eTask >= APP_SCHED_TASK_COUNT) || (NULL == pfTask))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+#ifdef APP_SCHED_NO_PLAN
+    s32Created = xTaskCreate(pfTask,
+                             tstPlan[eTask].pcName,
+                             tstPlan[eTask].u32StackSize,
+                             pvArg,
+                             tstPlan[eTask].u32UnpinnedPriority,
+                             &stCtx.tstTasks[eTask].pstHandle);
+#else
+    s32Created = xTaskCreatePinnedToCore(pfTask,
+                                         tstPlan[eTask].pcName,
+                                         tstPlan[eTask].u32StackSize,
+                                         pvArg,
+                                         tstPlan[eTask].u32Priority,
+                                         &stCtx.tstTasks[eTask].pstHandle,
+                                         tstPlan[eTask].s32Core);
+#endif
+    s32RetVal = (pdPASS == s32Created)?ESP_OK:ESP_ERR_NO_MEM;
+    if(ESP_OK != s32RetVal)
+    {
+      ESP_LOGE(APP_SCHED_TAG, "Failed to create task %s", tstPlan[eTask].pcName);
+    }
+  }
+  return s32RetVal;
+}
+
+/* Demote background tasks while scans are waiting to be uploaded and restore
+   them afterwards, only a change of state touches the priorities */
+void app_sched_set_busy(bool bBusy)
+{
+#ifndef APP_SCHED_NO_PLAN
+  uint32_t u32Index;
+
+  if(bBusy != stCtx.bBusy)
+  {
+    stCtx.bBusy = bBusy;
+    for(u32Index = 0; u32Index < APP_SCHED_TASK_COUNT; u32Index++)
+    {
+      if(tstPlan[u32Index].bBackground && stCtx.tstTasks[u32Index].pstHandle)
+      {
+        vTaskPrioritySet(stCtx.tstTasks[u32Index].pstHandle,
+                         bBusy?APP_SCHED_DEMOTED_PRIORITY:tstPlan[u32Index].u32Priority);
+      }
+    }
+  }
+#endif
+}
+
+/* CPU usage is a share of one core since the previous update */
+static void _app_sched_update_stats(void)
+{
+  uint32_t u32Task;
+  uint32_t u32Index;
+  uint32_t u32Count;
+  uint32_t u32Elapsed;
+  uint32_t u32TotalRunTime;
+  sched_task_t *pstTask;
+
+  u32Count = uxTaskGetSystemState(stCtx.tstStatus, APP_SCHED_MAX_SYSTEM_TASKS, &u32TotalRunTime);
+  u32Elapsed = u32TotalRunTime - stCtx.u32LastTotalRunTime;
+  stCtx.u32LastTotalRunTime = u32TotalRunTime;
+  for(u32Task = 0; u32Task < APP_SCHED_TASK_COUNT; u32Task++)
+  {
+    pstTask = &stCtx.tstTasks[u32Task];
+    for(u32Index = 0; (u32Index < u32Count) && pstTask->pstHandle; u32Index++)
+    {
+      if(stCtx.tstStatus[u32Index].xHandle == pstTask->pstHandle)
+      {
+        /* Read by app_sched_get_stats() from other tasks */
+        portENTER_CRITICAL(&stCtx.stLock);
+        pstTask->stStats.u32CpuPercent = u32Elapsed?
+          (uint32_t)(((uint64_t)(stCtx.tstStatus[u32Index].ulRunTimeCounter - pstTask->u32LastRunTime) * 100) / u32Elapsed):0;
+        pstTask->stStats.u32StackHighWaterMark = stCtx.tstStatus[u32Index].usStackHighWaterMark;
+        portEXIT_CRITICAL(&stCtx.stLock);
+        pstTask->u32LastRunTime = stCtx.tstStatus[u32Index].ulRunTimeCounter;
+      }
+    }
+  }
+}
+
+static void _app_sched_monitor_task(void *pvParameter)
+{
+  uint32_t u32Task;
+
+  while(1)
+  {
+    vTaskDelay(pdMS_TO_TICKS(APP_SCHED_MONITOR_PERIOD_MS));
+    _app_sched_update_stats();
+    for(u32Task = 0; u32Task < APP_SCHED_TASK_COUNT; u32Task++)
+    {
+      if(stCtx.tstTasks[u32Task].pstHandle)
+      {
+        ESP_LOGI(APP_SCHED_TAG,
+                 "%-12s cpu: %3d%%, free stack: %5d of %5d bytes",
+                 tstPlan[u32Task].pcName,
+                 stCtx.tstTasks[u32Task].stStats.u32CpuPercent,
+                 stCtx.tstTasks[u32Task].stStats.u32StackHighWaterMark,
+                 tstPlan[u32Task].u32StackSize);
+      }
+    }
+    app_mem_log_report();
+  }
+}
+
+esp_err_t app_sched_get_stats(app_sched_task_t eTask, app_sched_task_stats_t *pstStats)
+{
+  esp_err_t s32RetVal;
+
+  if((eTask >= APP_SCHED_TASK_COUNT) || (NULL == pstStats))
+  {
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    portENTER_CRITICAL(&stCtx.stLock);
+    memcpy(pstStats, &stCtx.tstTasks[eTask].stStats, sizeof(app_sched_task_stats_t));
+    portEXIT_CRITICAL(&stCtx.stLock);
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+/* Log the CPU usage and stack high-water mark of every planned task periodically */
+void app_sched_start(void)
+{
+  app_sched_create(APP_SCHED_TASK_MONITOR, _app_sched_monitor_task, NULL);
+}
\ No newline at end of file
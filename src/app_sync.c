@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include "app_conn.h"
+#include "app_json.h"
+#include "app_index.h"
+#include "app_access.h"
+#include "app_sched.h"
+#include "app_sync.h"
+
+#define APP_SYNC_TAG                             "APP_SYNC"
+
+#define APP_SYNC_COLLECTION_ID                   "authorized_tags"
+#define APP_SYNC_QUERY_PATH                      ":runQuery"
+#define APP_SYNC_PAGE_SIZE                       100
+#define APP_SYNC_BODY_MAX_SIZE                   768
+#define APP_SYNC_VALUE_MAX_SIZE                  256
+#define APP_SYNC_TIMESTAMP_MAX_SIZE              40
+
+#define APP_SYNC_NVS_NAMESPACE                   "app_sync"
+#define APP_SYNC_NVS_TIMESTAMP_KEY               "ts"
+#define APP_SYNC_NVS_NAME_KEY                    "name"
+
+#define APP_SYNC_TASK_PERIOD_MS                  (15 * 60 * 1000)
+
+/* Documents are ordered by updatedAt then by name so the last document of a
+   page is a stable cursor even when several share the same timestamp */
+#define APP_SYNC_QUERY_FORMAT                    "{\"structuredQuery\":{"                                          \
+                                                   "\"from\":[{\"collectionId\":\""APP_SYNC_COLLECTION_ID"\"}],"    \
+                                                   "\"orderBy\":["                                                 \
+                                                     "{\"field\":{\"fieldPath\":\"updatedAt\"},"                   \
+                                                      "\"direction\":\"ASCENDING\"},"                              \
+                                                     "{\"field\":{\"fieldPath\":\"__name__\"},"                    \
+                                                      "\"direction\":\"ASCENDING\"}"                               \
+                                                   "],"                                                            \
+                                                   "%s"                                                            \
+                                                   "\"limit\":%d"                                                  \
+                                                 "}}"
+#define APP_SYNC_CURSOR_FORMAT                   "\"startAt\":{\"values\":["                                       \
+                                                   "{\"timestampValue\":\"%s\"},"                                  \
+                                                   "{\"referenceValue\":\"%s\"}"                                   \
+                                                 "],\"before\":false},"
+
+typedef struct
+{
+  bool bHasUid;
+  bool bRevoked;
+  uint8_t u08UidLength;
+  uint8_t tu08Uid[APP_INDEX_UID_MAX_SIZE];
+  uint32_t u32Flags;
+}sync_doc_t;
+
+typedef struct
+{
+  app_json_t stJson;
+  sync_doc_t stDoc;
+  uint32_t u32PageDocuments;
+  bool bFull;
+  char tcValue[APP_SYNC_VALUE_MAX_SIZE];
+  char tcName[APP_SYNC_VALUE_MAX_SIZE];
+  char tcTimestamp[APP_SYNC_TIMESTAMP_MAX_SIZE];
+  char tcCursorName[APP_SYNC_VALUE_MAX_SIZE];
+  char tcCursorTimestamp[APP_SYNC_TIMESTAMP_MAX_SIZE];
+  char tcBody[APP_SYNC_BODY_MAX_SIZE];
+  app_sync_stats_t stStats;
+}sync_ctx_t;
+
+static sync_ctx_t stCtx;
+
+static const char *const tpcDocPath[] = {"", "document"};
+static const char *const tpcNamePath[] = {"", "document", "name"};
+static const char *const tpcFieldPath[] = {"", "document", "fields", NULL, NULL};
+
+static bool _app_sync_parse_uid(const char *pcHex, uint32_t u32Length, sync_doc_t *pstDoc)
+{
+  bool bRetVal;
+  uint32_t u32Index;
+  uint8_t u08Nibble;
+
+  bRetVal = (u32Length > 0) && (0 == (u32Length % 2)) && ((u32Length / 2) <= APP_INDEX_UID_MAX_SIZE);
+  for(u32Index = 0; bRetVal && (u32Index < u32Length); u32Index++)
+  {
+    if(('0' <= pcHex[u32Index]) && (pcHex[u32Index] <= '9'))
+    {
+      u08Nibble = pcHex[u32Index] - '0';
+    }
+    else if(('a' <= (pcHex[u32Index] | 0x20)) && ((pcHex[u32Index] | 0x20) <= 'f'))
+    {
+      u08Nibble = (pcHex[u32Index] | 0x20) - 'a' + 10;
+    }
+    else
+    {
+      bRetVal = false;
+      break;
+    }
+    pstDoc->tu08Uid[u32Index / 2] = (u32Index % 2)?(pstDoc->tu08Uid[u32Index / 2] | u08Nibble):(u08Nibble << 4);
+  }
+  pstDoc->u08UidLength = bRetVal?(u32Length / 2):0;
+  return bRetVal;
+}
+
+static void _app_sync_apply(void)
+{
+  esp_err_t s32RetVal;
+
+  if(stCtx.stDoc.bHasUid)
+  {
+    if(stCtx.stDoc.bRevoked)
+    {
+      s32RetVal = app_index_remove(stCtx.stDoc.tu08Uid, stCtx.stDoc.u08UidLength);
+      s32RetVal = (ESP_ERR_NOT_FOUND == s32RetVal)?ESP_OK:s32RetVal;
+    }
+    else
+    {
+      s32RetVal = app_index_insert(stCtx.stDoc.tu08Uid, stCtx.stDoc.u08UidLength, stCtx.stDoc.u32Flags);
+    }
+    stCtx.bFull |= (ESP_ERR_NO_MEM == s32RetVal);
+    if(ESP_OK == s32RetVal)
+    {
+      /* The next read of the tag is decided from the index again */
+      app_access_forget(stCtx.stDoc.tu08Uid, stCtx.stDoc.u08UidLength);
+      stCtx.stStats.u32Documents++;
+    }
+  }
+  else
+  {
+    ESP_LOGW(APP_SYNC_TAG, "Ignoring document without a valid uid: %s", stCtx.tcName);
+  }
+  /* Move the cursor past this document unless it couldn't be stored */
+  if(!stCtx.bFull && stCtx.tcName[0] && stCtx.tcTimestamp[0])
+  {
+    strcpy(stCtx.tcCursorName, stCtx.tcName);
+    strcpy(stCtx.tcCursorTimestamp, stCtx.tcTimestamp);
+  }
+  stCtx.u32PageDocuments++;
+}
+
+static void _app_sync_json_cb(const app_json_t *pstJson,
+                              app_json_type_t eType,
+                              const char *pcValue,
+                              uint32_t u32Length,
+                              void *pvArg)
+{
+  const char *pcField;
+  const char *pcType;
+
+  if(app_json_match(pstJson, tpcDocPath, 2))
+  {
+    if(APP_JSON_OBJECT_START == eType)
+    {
+      memset(&stCtx.stDoc, 0x00, sizeof(stCtx.stDoc));
+      stCtx.tcName[0] = '\0';
+      stCtx.tcTimestamp[0] = '\0';
+    }
+    else if(APP_JSON_OBJECT_END == eType)
+    {
+      _app_sync_apply();
+    }
+  }
+  else if(app_json_match(pstJson, tpcNamePath, 3) && (APP_JSON_STRING == eType))
+  {
+    /* A truncated name can't be used as a cursor */
+    if(!app_json_is_truncated(pstJson))
+    {
+      strcpy(stCtx.tcName, pcValue);
+    }
+  }
+  else if(app_json_match(pstJson, tpcFieldPath, 5))
+  {
+    pcField = app_json_get_key(pstJson, 3);
+    pcType = app_json_get_key(pstJson, 4);
+    if((0 == strcmp(pcField, "uid")) && (APP_JSON_STRING == eType))
+    {
+      stCtx.stDoc.bHasUid = _app_sync_parse_uid(pcValue, u32Length, &stCtx.stDoc);
+    }
+    else if(0 == strcmp(pcField, "revoked"))
+    {
+      stCtx.stDoc.bRevoked = (APP_JSON_TRUE == eType);
+    }
+    else if((0 == strcmp(pcField, "flags")) && (0 == strcmp(pcType, "integerValue")))
+    {
+      /* integerValue is sent as a string */
+      stCtx.stDoc.u32Flags = strtoul(pcValue, NULL, 10);
+    }
+    else if((0 == strcmp(pcField, "updatedAt")) &&
+            (APP_JSON_STRING == eType) &&
+            (u32Length < sizeof(stCtx.tcTimestamp)))
+    {
+      strcpy(stCtx.tcTimestamp, pcValue);
+    }
+  }
+}
+
+static void _app_sync_data_cb(const char *pcData, uint32_t u32Length, void *pvArg)
+{
+  stCtx.stStats.u32BytesReceived += u32Length;
+  app_json_feed(&stCtx.stJson, pcData, u32Length);
+}
+
+static void _app_sync_load_cursor(void)
+{
+  size_t u32Size;
+  nvs_handle_t u32Handle;
+
+  stCtx.tcCursorName[0] = '\0';
+  stCtx.tcCursorTimestamp[0] = '\0';
+  if(ESP_OK == nvs_open(APP_SYNC_NVS_NAMESPACE, NVS_READONLY, &u32Handle))
+  {
+    u32Size = sizeof(stCtx.tcCursorTimestamp);
+    if(ESP_OK == nvs_get_str(u32Handle, APP_SYNC_NVS_TIMESTAMP_KEY, stCtx.tcCursorTimestamp, &u32Size))
+    {
+      u32Size = sizeof(stCtx.tcCursorName);
+      if(ESP_OK != nvs_get_str(u32Handle, APP_SYNC_NVS_NAME_KEY, stCtx.tcCursorName, &u32Size))
+      {
+        stCtx.tcCursorTimestamp[0] = '\0';
+      }
+    }
+    nvs_close(u32Handle);
+  }
+}
+
+static esp_err_t _app_sync_save_cursor(void)
+{
+  esp_err_t s32RetVal;
+  nvs_handle_t u32Handle;
+
+  s32RetVal = nvs_open(APP_SYNC_NVS_NAMESPACE, NVS_READWRITE, &u32Handle);
+  if(ESP_OK == s32RetVal)
+  {
+    if(stCtx.tcCursorName[0])
+    {
+      s32RetVal = nvs_set_str(u32Handle, APP_SYNC_NVS_TIMESTAMP_KEY, stCtx.tcCursorTimestamp);
+      if(ESP_OK == s32RetVal)
+      {
+        s32RetVal = nvs_set_str(u32Handle, APP_SYNC_NVS_NAME_KEY, stCtx.tcCursorName);
+      }
+    }
+    else
+    {
+      nvs_erase_key(u32Handle, APP_SYNC_NVS_TIMESTAMP_KEY);
+      nvs_erase_key(u32Handle, APP_SYNC_NVS_NAME_KEY);
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = nvs_commit(u32Handle);
+    }
+    nvs_close(u32Handle);
+  }
+  return s32RetVal;
+}
+
+/* Fetch one page of changes past the cursor and apply it to the index */
+static esp_err_t _app_sync_page(void)
+{
+  int s32Length;
+  int s32HttpCode;
+  esp_err_t s32RetVal;
+  char tcCursor[sizeof(APP_SYNC_CURSOR_FORMAT) + APP_SYNC_TIMESTAMP_MAX_SIZE + APP_SYNC_VALUE_MAX_SIZE];
+
+  tcCursor[0] = '\0';
+  if(stCtx.tcCursorName[0])
+  {
+    snprintf(tcCursor, sizeof(tcCursor), APP_SYNC_CURSOR_FORMAT, stCtx.tcCursorTimestamp, stCtx.tcCursorName);
+  }
+  s32Length = snprintf(stCtx.tcBody, sizeof(stCtx.tcBody), APP_SYNC_QUERY_FORMAT, tcCursor, APP_SYNC_PAGE_SIZE);
+  if((s32Length <= 0) || ((uint32_t)s32Length >= sizeof(stCtx.tcBody)))
+  {
+    ESP_LOGE(APP_SYNC_TAG, "Couldn't format query");
+    s32RetVal = ESP_ERR_INVALID_SIZE;
+  }
+  else
+  {
+    stCtx.u32PageDocuments = 0;
+    stCtx.stStats.u32BytesSent += s32Length;
+    app_json_init(&stCtx.stJson, stCtx.tcValue, sizeof(stCtx.tcValue), _app_sync_json_cb, NULL);
+    s32RetVal = app_conn_request(HTTP_METHOD_POST,
+                                 APP_SYNC_QUERY_PATH,
+                                 stCtx.tcBody,
+                                 s32Length,
+                                 _app_sync_data_cb,
+                                 NULL,
+                                 &s32HttpCode);
+    if((ESP_OK != s32RetVal) || (200 != s32HttpCode))
+    {
+      ESP_LOGE(APP_SYNC_TAG, "Query failed with HTTP code: %d", s32HttpCode);
+      s32RetVal = ESP_FAIL;
+    }
+    else if(!app_json_is_done(&stCtx.stJson))
+    {
+      ESP_LOGE(APP_SYNC_TAG, "Query response is not valid json");
+      s32RetVal = ESP_ERR_INVALID_RESPONSE;
+    }
+  }
+  return s32RetVal;
+}
+
+/* Incremental sync: only documents updated since the last stored cursor are
+   downloaded, the cursor is persisted after every page */
+esp_err_t app_sync_run(void)
+{
+  bool bRebuilt;
+  int64_t s64StartUs;
+  esp_err_t s32RetVal;
+
+  bRebuilt = false;
+  s64StartUs = esp_timer_get_time();
+  stCtx.stStats.u32Runs++;
+  stCtx.bFull = false;
+  _app_sync_load_cursor();
+  if(!app_index_is_valid())
+  {
+    /* No usable index on flash, start over with a full download */
+    ESP_LOGW(APP_SYNC_TAG, "No tag index --> formatting and running a full sync");
+    stCtx.tcCursorName[0] = '\0';
+    app_index_format();
+    app_access_flush();
+  }
+  do
+  {
+    s32RetVal = _app_sync_page();
+    if(stCtx.bFull && bRebuilt)
+    {
+      ESP_LOGE(APP_SYNC_TAG, "Authorized tags don't fit in the tag index");
+      s32RetVal = ESP_ERR_NO_MEM;
+    }
+    else if(stCtx.bFull)
+    {
+      /* Deleted slots can't be reused in place, rebuild from scratch */
+      ESP_LOGW(APP_SYNC_TAG, "Tag index is full --> rebuilding it");
+      bRebuilt = true;
+      stCtx.bFull = false;
+      stCtx.tcCursorName[0] = '\0';
+      s32RetVal = app_index_format();
+      app_access_flush();
+      stCtx.u32PageDocuments = APP_SYNC_PAGE_SIZE;
+    }
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = _app_sync_save_cursor();
+    }
+  }while((ESP_OK == s32RetVal) && (APP_SYNC_PAGE_SIZE <= stCtx.u32PageDocuments));
+  stCtx.stStats.u32LastDurationMs = (uint32_t)((esp_timer_get_time() - s64StartUs) / 1000LL);
+  ESP_LOGI(APP_SYNC_TAG,
+           "Sync %s in %d ms, %d tags in index (sent: %d bytes, received: %d bytes)",
+           (ESP_OK == s32RetVal)?"done":"failed",
+           stCtx.stStats.u32LastDurationMs,
+           app_index_get_count(),
+           stCtx.stStats.u32BytesSent,
+           stCtx.stStats.u32BytesReceived);
+  return s32RetVal;
+}
+
+static void _app_sync_task(void *pvParameter)
+{
+  while(1)
+  {
+    app_sync_run();
+    vTaskDelay(APP_SYNC_TASK_PERIOD_MS / portTICK_PERIOD_MS);
+  }
+}
+
+void app_sync_start(void)
+{
+  app_sched_create(APP_SCHED_TASK_SYNC, _app_sync_task, NULL);
+}
+
+void app_sync_get_stats(app_sync_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_sync_stats_t));
+  }
+}
\ No newline at end of file
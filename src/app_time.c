@@ -1,100 +1,137 @@
 #include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
+#include <freertos/FreeRTOS.h>
+
 #include <esp_log.h>
 #include <esp_sntp.h>
+#include <esp_timer.h>
 
-#include "app_wifi.h"
+#include "app_time.h"
 
 #define APP_TIME_TAG                             "TIME_APP"
-#define APP_TIME_RETRIES_COUNT                   16
-#define APP_TIME_BUFF_MAX_SIZE                   128
+#define APP_TIME_NTP_SERVER                      "pool.ntp.org"
+#define APP_TIME_RESYNC_PERIOD_MS                3600000
+/* Scans are held back this long after boot waiting for the first sync */
+#define APP_TIME_FIRST_SYNC_GRACE_MS             120000
+/* 2020-01-01, anything earlier means the system clock was never set */
+#define APP_TIME_MIN_VALID_S                     1577836800LL
 
-static time_t stNow;
-static uint8_t u08Retries;
-static struct tm stTimeInfo;
-static char tcTimeFormatBuff[APP_TIME_BUFF_MAX_SIZE];
+/* Wall clock is derived from esp_timer plus the offset measured by the last
+   sync, so stamping a scan never touches SNTP, the TZ or the system clock */
+typedef struct
+{
+  portMUX_TYPE stLock;
+  bool bValid;
+  app_time_stats_t stStats;
+}time_ctx_t;
 
-static esp_err_t _app_time_init(void)
+static time_ctx_t stCtx =
 {
-  esp_err_t s32RetVal;
-  sntp_sync_status_t eStatus;
+  .stLock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Runs in the lwIP task once the system clock has been set by SNTP */
+static void _app_time_sync_cb(struct timeval *pstTv)
+{
+  int64_t s64NowUs;
+  int64_t s64StepUs;
+  int64_t s64OffsetUs;
+  int64_t s64ElapsedUs;
 
-  time(&stNow);
-  localtime_r(&stNow, &stTimeInfo);
-  /* Is time set? If not, tm_year will be (1970 - 1900) */
-  if((1970 - 1900) == stTimeInfo.tm_year)
+  s64NowUs = esp_timer_get_time();
+  s64OffsetUs = ((int64_t)pstTv->tv_sec * 1000000LL) + pstTv->tv_usec - s64NowUs;
+  portENTER_CRITICAL(&stCtx.stLock);
+  s64StepUs = stCtx.bValid?(s64OffsetUs - stCtx.stStats.s64OffsetUs):0;
+  s64ElapsedUs = s64NowUs - stCtx.stStats.s64LastSyncUs;
+  /* Drift of esp_timer against NTP, only meaningful between two syncs */
+  if(stCtx.stStats.u32Syncs && (s64ElapsedUs > 0))
   {
-    ESP_LOGW(APP_TIME_TAG, "Time is not set yet --> Getting time over NTP");
-    /* Initialize sntp */
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    sntp_setservername(0, "pool.ntp.org");
-    sntp_set_time_sync_notification_cb(NULL);
-    sntp_init();
-    /* Try to get new time from sntp */
-    u08Retries = 0;
-    while((SNTP_SYNC_STATUS_COMPLETED != (eStatus = sntp_get_sync_status())) &&
-          (++u08Retries < APP_TIME_RETRIES_COUNT))
-    {
-      ESP_LOGI(APP_TIME_TAG,
-               "Waiting for system time to be set... (%d/%d)",
-               u08Retries,
-               APP_TIME_RETRIES_COUNT);
-      vTaskDelay(2000 / portTICK_PERIOD_MS);
-    }
-    if(SNTP_SYNC_STATUS_COMPLETED == eStatus)
-    {
-      s32RetVal = ESP_OK;
-      /* Update with new time value */
-      time(&stNow);
-      localtime_r(&stNow, &stTimeInfo);
-      setenv("TZ", "UTC", 1);
-      tzset();
-      strftime(tcTimeFormatBuff, sizeof(tcTimeFormatBuff), "%c", &stTimeInfo);
-      ESP_LOGI(APP_TIME_TAG, "Time is set successfully");
-      ESP_LOGI(APP_TIME_TAG, "The current date/time in UTC is: %s", tcTimeFormatBuff);
-    }
-    else
-    {
-      s32RetVal = ESP_FAIL;
-      ESP_LOGE(APP_TIME_TAG, "Failed to get time from SNTP server");
-    }
+    stCtx.stStats.s32DriftPpb = (int32_t)((s64StepUs * 1000000000LL) / s64ElapsedUs);
   }
-  else
+  stCtx.stStats.s64OffsetUs = s64OffsetUs;
+  stCtx.stStats.s64LastSyncUs = s64NowUs;
+  stCtx.stStats.s64LastStepUs = s64StepUs;
+  stCtx.stStats.u32Syncs++;
+  stCtx.bValid = true;
+  portEXIT_CRITICAL(&stCtx.stLock);
+  ESP_LOGI(APP_TIME_TAG,
+           "Time synced: %ld s, step: %lld us, drift: %d ppb",
+           pstTv->tv_sec,
+           s64StepUs,
+           stCtx.stStats.s32DriftPpb);
+}
+
+/* Start SNTP in the background, it resyncs by itself every hour */
+void app_time_start(void)
+{
+  struct timeval stTvNow;
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  /* The RTC keeps the system clock across a software reset, use it until
+     the first sync corrects it */
+  gettimeofday(&stTvNow, NULL);
+  if(stTvNow.tv_sec > APP_TIME_MIN_VALID_S)
   {
-    s32RetVal = ESP_OK;
-    ESP_LOGD(APP_TIME_TAG, "Time is already set");
+    portENTER_CRITICAL(&stCtx.stLock);
+    stCtx.stStats.s64OffsetUs = ((int64_t)stTvNow.tv_sec * 1000000LL) + stTvNow.tv_usec - esp_timer_get_time();
+    stCtx.bValid = true;
+    portEXIT_CRITICAL(&stCtx.stLock);
+    ESP_LOGI(APP_TIME_TAG, "Time was kept across reset --> using it until the first sync");
   }
-  return s32RetVal;
+  sntp_setoperatingmode(SNTP_OPMODE_POLL);
+  sntp_setservername(0, APP_TIME_NTP_SERVER);
+  sntp_set_time_sync_notification_cb(_app_time_sync_cb);
+  sntp_set_sync_interval(APP_TIME_RESYNC_PERIOD_MS);
+  sntp_init();
 }
 
-void app_time_init(void)
+/* No wall clock yet but the first sync may still come, uploads should wait */
+bool app_time_is_pending(void)
 {
-  _app_time_init();
+  return !stCtx.bValid && (esp_timer_get_time() < (APP_TIME_FIRST_SYNC_GRACE_MS * 1000LL));
 }
 
-esp_err_t app_time_get_timestamp(int64_t *ps64Timestamp)
+/* Convert an esp_timer_get_time() value of this boot to UNIX time in ms,
+   valid for instants taken before the clock was synced as well */
+esp_err_t app_time_to_unix_ms(int64_t s64MonotonicUs, int64_t *ps64Timestamp)
 {
+  bool bValid;
+  int64_t s64OffsetUs;
   esp_err_t s32RetVal;
-  struct timeval stTvNow;
 
-  if(ps64Timestamp)
+  if(NULL == ps64Timestamp)
   {
-    if(ESP_OK == _app_time_init())
+    s32RetVal = ESP_ERR_INVALID_ARG;
+  }
+  else
+  {
+    portENTER_CRITICAL(&stCtx.stLock);
+    bValid = stCtx.bValid;
+    s64OffsetUs = stCtx.stStats.s64OffsetUs;
+    portEXIT_CRITICAL(&stCtx.stLock);
+    if(bValid)
     {
-      s32RetVal = (0 == gettimeofday(&stTvNow, NULL))?ESP_OK:ESP_FAIL;
-      *ps64Timestamp = (int64_t)stTvNow.tv_sec * 1000LL + (int64_t)stTvNow.tv_usec / 1000LL;
-      ESP_LOGD(APP_TIME_TAG, "UNIX time in ms: %lld", *ps64Timestamp);
+      *ps64Timestamp = (s64MonotonicUs + s64OffsetUs) / 1000LL;
+      s32RetVal = ESP_OK;
     }
     else
     {
-      ESP_LOGE(APP_TIME_TAG, "Failed to get timestamp: Time is not set");
-      s32RetVal = ESP_FAIL;
+      s32RetVal = ESP_ERR_INVALID_STATE;
     }
   }
-  else
-  {
-    s32RetVal = ESP_ERR_INVALID_ARG;
-  }
   return s32RetVal;
 }
+
+void app_time_get_stats(app_time_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    portENTER_CRITICAL(&stCtx.stLock);
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_time_stats_t));
+    portEXIT_CRITICAL(&stCtx.stLock);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include <string.h>
+#include <stdatomic.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp32/clk.h>
+#include <xtensa/hal.h>
+#include <mbedtls/base64.h>
+
+#include "app_conn.h"
+#include "app_doc.h"
+#include "app_hist.h"
+#include "app_sched.h"
+#include "app_trace.h"
+
+#define APP_TRACE_TAG                            "APP_TRACE"
+
+/* "TRC1" */
+#define APP_TRACE_MAGIC                          0x31435254
+#define APP_TRACE_VERSION                        1
+#define APP_TRACE_HEADER_SIZE                    17
+#define APP_TRACE_POINT_HEADER_SIZE              10
+#define APP_TRACE_BUCKET_SIZE                    5
+
+/* Must be a power of 2 */
+#define APP_TRACE_RING_SIZE                      128
+#define APP_TRACE_BLOB_MAX_SIZE                  1536
+#define APP_TRACE_BODY_MAX_SIZE                  2304
+
+#define APP_TRACE_DOCUMENT_PATH                  "/traces/rfid-node"
+
+#define APP_TRACE_DRAIN_PERIOD_MS                1000
+#define APP_TRACE_UPLOAD_PERIOD_MS               (15 * 60 * 1000)
+
+typedef struct
+{
+  uint32_t u32Value;
+  uint32_t u32Point;
+}trace_event_t;
+
+/* One ring per core, written with interrupts masked on that core so a single
+   producer is ever active, drained by the trace task */
+typedef struct
+{
+  atomic_uint u32Head;
+  atomic_uint u32Tail;
+  trace_event_t tstEvents[APP_TRACE_RING_SIZE];
+}trace_ring_t;
+
+typedef struct
+{
+  trace_ring_t tstRings[portNUM_PROCESSORS];
+  atomic_uint u32Dropped;
+  atomic_uint u32Migrated;
+  uint32_t u32CpuMhz;
+  SemaphoreHandle_t stMutex;
+  app_hist_t tstHists[APP_TRACE_POINT_COUNT];
+  uint32_t u32BlobLength;
+  uint8_t tu08Blob[APP_TRACE_BLOB_MAX_SIZE];
+  char tcBody[APP_TRACE_BODY_MAX_SIZE];
+}trace_ctx_t;
+
+static trace_ctx_t stCtx;
+
+static void _app_trace_push(app_trace_point_t ePoint, uint32_t u32Value)
+{
+  uint32_t u32Head;
+  uint32_t u32State;
+  trace_ring_t *pstRing;
+
+  u32State = portSET_INTERRUPT_MASK_FROM_ISR();
+  pstRing = &stCtx.tstRings[xPortGetCoreID()];
+  u32Head = atomic_load_explicit(&pstRing->u32Head, memory_order_relaxed);
+  if((u32Head - atomic_load_explicit(&pstRing->u32Tail, memory_order_acquire)) < APP_TRACE_RING_SIZE)
+  {
+    pstRing->tstEvents[u32Head & (APP_TRACE_RING_SIZE - 1)].u32Value = u32Value;
+    pstRing->tstEvents[u32Head & (APP_TRACE_RING_SIZE - 1)].u32Point = ePoint;
+    atomic_store_explicit(&pstRing->u32Head, u32Head + 1, memory_order_release);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(&stCtx.u32Dropped, 1, memory_order_relaxed);
+  }
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(u32State);
+}
+
+void app_trace_begin(app_trace_span_t *pstSpan)
+{
+  uint32_t u32State;
+
+  u32State = portSET_INTERRUPT_MASK_FROM_ISR();
+  pstSpan->u32Core = xPortGetCoreID();
+  pstSpan->u32Cycles = xthal_get_ccount();
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(u32State);
+}
+
+/* Record the cycles elapsed since the span began, the span then restarts so
+   consecutive phases can be chained */
+void app_trace_end(app_trace_span_t *pstSpan, app_trace_point_t ePoint)
+{
+  uint32_t u32Core;
+  uint32_t u32State;
+  uint32_t u32Cycles;
+
+  u32State = portSET_INTERRUPT_MASK_FROM_ISR();
+  u32Core = xPortGetCoreID();
+  u32Cycles = xthal_get_ccount();
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(u32State);
+  if(u32Core == pstSpan->u32Core)
+  {
+    _app_trace_push(ePoint, u32Cycles - pstSpan->u32Cycles);
+  }
+  else
+  {
+    atomic_fetch_add_explicit(&stCtx.u32Migrated, 1, memory_order_relaxed);
+  }
+  pstSpan->u32Core = u32Core;
+  pstSpan->u32Cycles = u32Cycles;
+}
+
+/* Durations spanning tasks or longer than the cycle counter takes to wrap are
+   measured with esp_timer and stored in cycles, saturated rather than wrapped */
+void app_trace_record_us(app_trace_point_t ePoint, int64_t s64DurationUs)
+{
+  uint64_t u64Cycles;
+
+  if(0 == stCtx.u32CpuMhz)
+  {
+    stCtx.u32CpuMhz = esp_clk_cpu_freq() / 1000000;
+  }
+  u64Cycles = (s64DurationUs > 0)?((uint64_t)s64DurationUs * stCtx.u32CpuMhz):0;
+  _app_trace_push(ePoint, (u64Cycles > UINT32_MAX)?UINT32_MAX:(uint32_t)u64Cycles);
+}
+
+static void _app_trace_drain(void)
+{
+  uint32_t u32Core;
+  uint32_t u32Head;
+  uint32_t u32Tail;
+  trace_event_t *pstEvent;
+
+  for(u32Core = 0; u32Core < portNUM_PROCESSORS; u32Core++)
+  {
+    u32Tail = atomic_load_explicit(&stCtx.tstRings[u32Core].u32Tail, memory_order_relaxed);
+    u32Head = atomic_load_explicit(&stCtx.tstRings[u32Core].u32Head, memory_order_acquire);
+    for(; u32Tail != u32Head; u32Tail++)
+    {
+      pstEvent = &stCtx.tstRings[u32Core].tstEvents[u32Tail & (APP_TRACE_RING_SIZE - 1)];
+      if(pstEvent->u32Point < APP_TRACE_POINT_COUNT)
+      {
+        app_hist_record(&stCtx.tstHists[pstEvent->u32Point], pstEvent->u32Value);
+      }
+    }
+    atomic_store_explicit(&stCtx.tstRings[u32Core].u32Tail, u32Tail, memory_order_release);
+  }
+}
+
+static void _app_trace_put(uint32_t u32Value, uint32_t u32Size)
+{
+  memcpy(&stCtx.tu08Blob[stCtx.u32BlobLength], &u32Value, u32Size);
+  stCtx.u32BlobLength += u32Size;
+}
+
+/* Little endian blob decoded by tools/trace_decoder.py: a header then, for
+   every point with samples, its count, max and non-empty buckets */
+static void _app_trace_encode(void)
+{
+  uint32_t u32Point;
+  uint32_t u32Bucket;
+  uint32_t u32Buckets;
+  app_hist_t *pstHist;
+
+  stCtx.u32BlobLength = 0;
+  _app_trace_put(APP_TRACE_MAGIC, 4);
+  _app_trace_put(APP_TRACE_VERSION, 1);
+  _app_trace_put(APP_HIST_SUB_BUCKET_BITS, 1);
+  _app_trace_put(stCtx.u32CpuMhz, 2);
+  _app_trace_put((uint32_t)(esp_timer_get_time() / 1000000LL), 4);
+  _app_trace_put(atomic_load(&stCtx.u32Dropped) + atomic_load(&stCtx.u32Migrated), 4);
+  _app_trace_put(APP_TRACE_POINT_COUNT, 1);
+  for(u32Point = 0; u32Point < APP_TRACE_POINT_COUNT; u32Point++)
+  {
+    pstHist = &stCtx.tstHists[u32Point];
+    u32Buckets = 0;
+    for(u32Bucket = 0; u32Bucket < APP_HIST_BUCKETS; u32Bucket++)
+    {
+      u32Buckets += pstHist->tu32Buckets[u32Bucket]?1:0;
+    }
+    if((APP_TRACE_POINT_HEADER_SIZE + (u32Buckets * APP_TRACE_BUCKET_SIZE)) >
+       (sizeof(stCtx.tu08Blob) - stCtx.u32BlobLength))
+    {
+      ESP_LOGW(APP_TRACE_TAG, "No room left for point %d", u32Point);
+    }
+    else if(pstHist->u32Count)
+    {
+      _app_trace_put(u32Point, 1);
+      _app_trace_put(pstHist->u32Count, 4);
+      _app_trace_put(pstHist->u32Max, 4);
+      _app_trace_put(u32Buckets, 1);
+      for(u32Bucket = 0; u32Bucket < APP_HIST_BUCKETS; u32Bucket++)
+      {
+        if(pstHist->tu32Buckets[u32Bucket])
+        {
+          _app_trace_put(u32Bucket, 1);
+          _app_trace_put(pstHist->tu32Buckets[u32Bucket], 4);
+        }
+      }
+    }
+  }
+}
+
+static void _app_trace_write_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  app_doc_add_bytes(pstDoc, "histograms", stCtx.tu08Blob, stCtx.u32BlobLength);
+  app_doc_add_integer(pstDoc, "uptime", esp_timer_get_time() / 1000000LL);
+}
+
+/* Upload the histograms of the current window and start a new one */
+static void _app_trace_upload(void)
+{
+  int s32HttpCode;
+  uint32_t u32Point;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+  app_doc_t stDoc;
+
+  _app_trace_encode();
+  app_doc_init(&stDoc, stCtx.tcBody, sizeof(stCtx.tcBody), NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, _app_trace_write_fields, NULL);
+  app_doc_end_object(&stDoc);
+  s32RetVal = app_doc_finish(&stDoc, &u32Length);
+  if(ESP_OK == s32RetVal)
+  {
+    s32RetVal = app_conn_request(HTTP_METHOD_PATCH,
+                                 APP_TRACE_DOCUMENT_PATH,
+                                 stCtx.tcBody,
+                                 u32Length,
+                                 NULL,
+                                 NULL,
+                                 &s32HttpCode);
+    s32RetVal = ((ESP_OK == s32RetVal) && (200 != s32HttpCode))?ESP_FAIL:s32RetVal;
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    for(u32Point = 0; u32Point < APP_TRACE_POINT_COUNT; u32Point++)
+    {
+      app_hist_reset(&stCtx.tstHists[u32Point]);
+    }
+  }
+  else
+  {
+    ESP_LOGW(APP_TRACE_TAG, "Couldn't upload histograms, keeping them for the next window");
+  }
+}
+
+/* Log the histograms as a base64 line for tools/trace_decoder.py */
+void app_trace_dump(void)
+{
+  size_t u32Length;
+
+  if(stCtx.stMutex)
+  {
+    xSemaphoreTake(stCtx.stMutex, portMAX_DELAY);
+    _app_trace_drain();
+    _app_trace_encode();
+    if(0 == mbedtls_base64_encode((unsigned char *)stCtx.tcBody,
+                                  sizeof(stCtx.tcBody),
+                                  &u32Length,
+                                  stCtx.tu08Blob,
+                                  stCtx.u32BlobLength))
+    {
+      ESP_LOGI(APP_TRACE_TAG, "TRACE:%s", stCtx.tcBody);
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+}
+
+static void _app_trace_task(void *pvParameter)
+{
+  TickType_t u32LastUpload;
+
+  u32LastUpload = xTaskGetTickCount();
+  while(1)
+  {
+    vTaskDelay(pdMS_TO_TICKS(APP_TRACE_DRAIN_PERIOD_MS));
+    xSemaphoreTake(stCtx.stMutex, portMAX_DELAY);
+    _app_trace_drain();
+    if((xTaskGetTickCount() - u32LastUpload) >= pdMS_TO_TICKS(APP_TRACE_UPLOAD_PERIOD_MS))
+    {
+      u32LastUpload = xTaskGetTickCount();
+      _app_trace_upload();
+    }
+    xSemaphoreGive(stCtx.stMutex);
+  }
+}
+
+void app_trace_start(void)
+{
+  stCtx.u32CpuMhz = esp_clk_cpu_freq() / 1000000;
+  stCtx.stMutex = xSemaphoreCreateMutex();
+  app_sched_create(APP_SCHED_TASK_TRACE, _app_trace_task, NULL);
+}
\ No newline at end of file
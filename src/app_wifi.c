@@ -7,63 +7,257 @@
 #include <esp_system.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
+#include <esp_netif.h>
+#include <esp_timer.h>
 #include <esp_log.h>
 
 #include <nvs_flash.h>
+#include <nvs.h>
 
 #include <lwip/err.h>
 #include <lwip/sys.h>
 
+#include "app_wifi.h"
+
 #define APP_WIFI_TAG                            "APP_WIFI"
-#define APP_WIFI_MAXIMUM_RETRY                   0xFFFFFFFF
 #define APP_WIFI_CONNECTED_BIT                   BIT0
-#define APP_WIFI_FAIL_BIT                        BIT1
+
+/* The first retry is immediate, the next ones back off up to the maximum */
+#define APP_WIFI_RETRY_MIN_MS                    250
+#define APP_WIFI_RETRY_MAX_MS                    8000
+
+#define APP_WIFI_NVS_NAMESPACE                   "app_wifi"
+#define APP_WIFI_NVS_CACHE_KEY                   "cache"
+#define APP_WIFI_CACHE_VERSION                   1
+
+/* Last AP and lease, the channel and BSSID skip the full scan on the next
+   boot and the lease is reused as a static address with APP_WIFI_REUSE_LEASE */
+typedef struct
+{
+  uint8_t u08Version;
+  uint8_t u08Channel;
+  uint8_t tu08Bssid[6];
+  esp_netif_ip_info_t stIpInfo;
+  esp_ip4_addr_t stDns;
+}wifi_cache_t;
 
 typedef struct
 {
   EventGroupHandle_t stWifiEventGroup;
-  int8_t u08RetryCount;
-  ip_event_got_ip_t* pstIpEvent;
-  EventBits_t u32EventBits;
+  esp_netif_t *pstNetif;
+  esp_timer_handle_t pstRetryTimer;
+  wifi_config_t stConfig;
+  wifi_cache_t stCache;
+  wifi_cache_t stCurrent;
+  bool bUsingCache;
+  bool bAssociated;
+  volatile bool bConnected;
+  uint32_t u32RetryCount;
+  int64_t s64ConnectStartUs;
+  uint32_t u32CallbackCount;
+  app_wifi_cb_t tpfCallbacks[APP_WIFI_MAX_CALLBACKS];
+  app_wifi_stats_t stStats;
 }wifi_ctx_t;
 
 static wifi_ctx_t stCtx;
 
+static void _app_wifi_load_cache(void)
+{
+  size_t u32Size;
+  nvs_handle_t u32Handle;
+
+  memset(&stCtx.stCache, 0x00, sizeof(stCtx.stCache));
+  if(ESP_OK == nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READONLY, &u32Handle))
+  {
+    u32Size = sizeof(stCtx.stCache);
+    if((ESP_OK != nvs_get_blob(u32Handle, APP_WIFI_NVS_CACHE_KEY, &stCtx.stCache, &u32Size)) ||
+       (sizeof(stCtx.stCache) != u32Size) ||
+       (APP_WIFI_CACHE_VERSION != stCtx.stCache.u08Version))
+    {
+      memset(&stCtx.stCache, 0x00, sizeof(stCtx.stCache));
+    }
+    nvs_close(u32Handle);
+  }
+}
+
+/* Only written when the AP or the lease changed to spare the flash */
+static void _app_wifi_save_cache(void)
+{
+  nvs_handle_t u32Handle;
+
+  stCtx.stCurrent.u08Version = APP_WIFI_CACHE_VERSION;
+  if(memcmp(&stCtx.stCache, &stCtx.stCurrent, sizeof(wifi_cache_t)))
+  {
+    memcpy(&stCtx.stCache, &stCtx.stCurrent, sizeof(wifi_cache_t));
+    if(ESP_OK == nvs_open(APP_WIFI_NVS_NAMESPACE, NVS_READWRITE, &u32Handle))
+    {
+      nvs_set_blob(u32Handle, APP_WIFI_NVS_CACHE_KEY, &stCtx.stCache, sizeof(stCtx.stCache));
+      nvs_commit(u32Handle);
+      nvs_close(u32Handle);
+    }
+  }
+}
+
+#if defined(APP_WIFI_STATIC_IP) || defined(APP_WIFI_REUSE_LEASE)
+/* Skip DHCP, the address is set as soon as the station associates */
+static void _app_wifi_set_static_ip(const esp_netif_ip_info_t *pstIpInfo, esp_ip4_addr_t stDns)
+{
+  esp_netif_dns_info_t stDnsInfo;
+
+  esp_netif_dhcpc_stop(stCtx.pstNetif);
+  esp_netif_set_ip_info(stCtx.pstNetif, pstIpInfo);
+  if(stDns.addr)
+  {
+    memset(&stDnsInfo, 0x00, sizeof(stDnsInfo));
+    stDnsInfo.ip.type = ESP_IPADDR_TYPE_V4;
+    stDnsInfo.ip.u_addr.ip4.addr = stDns.addr;
+    esp_netif_set_dns_info(stCtx.pstNetif, ESP_NETIF_DNS_MAIN, &stDnsInfo);
+  }
+  ESP_LOGI(APP_WIFI_TAG, "Using static IP:" IPSTR, IP2STR(&pstIpInfo->ip));
+}
+#endif
+
+static void _app_wifi_notify(bool bUp)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < stCtx.u32CallbackCount; u32Index++)
+  {
+    stCtx.tpfCallbacks[u32Index](bUp);
+  }
+}
+
+static void _app_wifi_connect(void *pvArg)
+{
+  esp_wifi_connect();
+}
+
+static void _app_wifi_schedule_retry(void)
+{
+  uint32_t u32DelayMs;
+
+  if(0 == stCtx.u32RetryCount)
+  {
+    esp_wifi_connect();
+  }
+  else
+  {
+    u32DelayMs = APP_WIFI_RETRY_MIN_MS << ((stCtx.u32RetryCount < 6)?(stCtx.u32RetryCount - 1):5);
+    u32DelayMs = (u32DelayMs < APP_WIFI_RETRY_MAX_MS)?u32DelayMs:APP_WIFI_RETRY_MAX_MS;
+    ESP_LOGD(APP_WIFI_TAG, "Retrying to connect to the AP in %d ms", u32DelayMs);
+    esp_timer_start_once(stCtx.pstRetryTimer, u32DelayMs * 1000ULL);
+  }
+  stCtx.u32RetryCount++;
+}
+
 static void _app_wifi_event_handler(void* pvArg,
                                     esp_event_base_t pcEventBase,
                                     int32_t s32EventId,
                                     void* pvEventData)
 {
+  uint32_t u32ConnectMs;
+  esp_netif_dns_info_t stDnsInfo;
+  wifi_event_sta_connected_t *pstConnected;
+  wifi_event_sta_disconnected_t *pstDisconnected;
+  ip_event_got_ip_t *pstIpEvent;
+
   if((WIFI_EVENT == pcEventBase) && (WIFI_EVENT_STA_START == s32EventId))
   {
+    stCtx.s64ConnectStartUs = esp_timer_get_time();
     esp_wifi_connect();
   }
+  else if((WIFI_EVENT == pcEventBase) && (WIFI_EVENT_STA_CONNECTED == s32EventId))
+  {
+    pstConnected = (wifi_event_sta_connected_t *)pvEventData;
+    stCtx.bAssociated = true;
+    stCtx.stCurrent.u08Channel = pstConnected->channel;
+    memcpy(stCtx.stCurrent.tu08Bssid, pstConnected->bssid, sizeof(stCtx.stCurrent.tu08Bssid));
+  }
   else if((WIFI_EVENT == pcEventBase) && (WIFI_EVENT_STA_DISCONNECTED == s32EventId))
   {
-    if(stCtx.u08RetryCount < APP_WIFI_MAXIMUM_RETRY)
+    pstDisconnected = (wifi_event_sta_disconnected_t *)pvEventData;
+    ESP_LOGD(APP_WIFI_TAG, "Connection to the AP failed, reason: %d", pstDisconnected->reason);
+    if(stCtx.bConnected)
     {
-      esp_wifi_connect();
-      stCtx.u08RetryCount++;
-      ESP_LOGD(APP_WIFI_TAG, "Retrying to connect to the AP");
+      ESP_LOGW(APP_WIFI_TAG, "Lost the AP, reason: %d", pstDisconnected->reason);
+      stCtx.bConnected = false;
+      stCtx.s64ConnectStartUs = esp_timer_get_time();
+      stCtx.stStats.u32Disconnects++;
+      xEventGroupClearBits(stCtx.stWifiEventGroup, APP_WIFI_CONNECTED_BIT);
+      _app_wifi_notify(false);
     }
-    else
+    else if(stCtx.bUsingCache && !stCtx.bAssociated)
     {
-      xEventGroupSetBits(stCtx.stWifiEventGroup, APP_WIFI_FAIL_BIT);
+      /* The cached AP is gone or moved to another channel, scan them all */
+      ESP_LOGW(APP_WIFI_TAG, "Cached AP not found --> scanning all channels");
+      stCtx.bUsingCache = false;
+      stCtx.stStats.u32CacheMisses++;
+      stCtx.stConfig.sta.channel = 0;
+      stCtx.stConfig.sta.bssid_set = false;
+      esp_wifi_set_config(ESP_IF_WIFI_STA, &stCtx.stConfig);
+      stCtx.u32RetryCount = 0;
     }
-    ESP_LOGD(APP_WIFI_TAG,"Connection to the AP fail");
+    stCtx.bAssociated = false;
+    _app_wifi_schedule_retry();
   }
   else if((IP_EVENT == pcEventBase) && (IP_EVENT_STA_GOT_IP == s32EventId))
   {
-    stCtx.pstIpEvent = (ip_event_got_ip_t*) pvEventData;
-    ESP_LOGD(APP_WIFI_TAG, "Got IP:" IPSTR, IP2STR(&stCtx.pstIpEvent->ip_info.ip));
-    stCtx.u08RetryCount = 0;
+    pstIpEvent = (ip_event_got_ip_t *)pvEventData;
+    u32ConnectMs = (uint32_t)((esp_timer_get_time() - stCtx.s64ConnectStartUs) / 1000LL);
+    ESP_LOGI(APP_WIFI_TAG,
+             "Got IP:" IPSTR " on channel %d after %d ms",
+             IP2STR(&pstIpEvent->ip_info.ip),
+             stCtx.stCurrent.u08Channel,
+             u32ConnectMs);
+    stCtx.stStats.u32Connects++;
+    stCtx.stStats.u32FastConnects += stCtx.bUsingCache?1:0;
+    stCtx.stStats.u32LastConnectMs = u32ConnectMs;
+    if(u32ConnectMs > stCtx.stStats.u32MaxConnectMs)
+    {
+      stCtx.stStats.u32MaxConnectMs = u32ConnectMs;
+    }
+    memcpy(&stCtx.stCurrent.stIpInfo, &pstIpEvent->ip_info, sizeof(esp_netif_ip_info_t));
+    stCtx.stCurrent.stDns.addr = 0;
+    if(ESP_OK == esp_netif_get_dns_info(stCtx.pstNetif, ESP_NETIF_DNS_MAIN, &stDnsInfo))
+    {
+      stCtx.stCurrent.stDns.addr = stDnsInfo.ip.u_addr.ip4.addr;
+    }
+    _app_wifi_save_cache();
+    stCtx.u32RetryCount = 0;
+    stCtx.bConnected = true;
     xEventGroupSetBits(stCtx.stWifiEventGroup, APP_WIFI_CONNECTED_BIT);
+    _app_wifi_notify(true);
   }
 }
 
+/* The event handlers stay registered for good, disconnects are retried with
+   a backoff and the listeners are told when the link goes up or down */
 void app_wifi_init(void)
 {
   esp_err_t s32RetVal;
+#if defined(APP_WIFI_STATIC_IP)
+  esp_ip4_addr_t stDns;
+  esp_netif_ip_info_t stIpInfo;
+#endif
+  esp_timer_create_args_t stTimerArgs =
+  {
+    .callback = _app_wifi_connect,
+    .name = "wifi_retry",
+  };
+  wifi_config_t stConfig =
+  {
+    .sta =
+    {
+      .ssid = WIFI_SSID,
+      .password = WIFI_PASS,
+      .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+      .pmf_cfg =
+      {
+        .capable = true,
+        .required = false
+      },
+    },
+  };
 
   memset(&stCtx, 0x00, sizeof(stCtx));
   s32RetVal = nvs_flash_init();
@@ -73,10 +267,25 @@ void app_wifi_init(void)
     s32RetVal = nvs_flash_init();
   }
   ESP_ERROR_CHECK(s32RetVal);
+  _app_wifi_load_cache();
   stCtx.stWifiEventGroup = xEventGroupCreate();
+  ESP_ERROR_CHECK(esp_timer_create(&stTimerArgs, &stCtx.pstRetryTimer));
   ESP_ERROR_CHECK(esp_netif_init());
   ESP_ERROR_CHECK(esp_event_loop_create_default());
-  esp_netif_create_default_wifi_sta();
+  stCtx.pstNetif = esp_netif_create_default_wifi_sta();
+#if defined(APP_WIFI_STATIC_IP)
+  memset(&stIpInfo, 0x00, sizeof(stIpInfo));
+  stIpInfo.ip.addr = esp_ip4addr_aton(APP_WIFI_STATIC_IP);
+  stIpInfo.netmask.addr = esp_ip4addr_aton(APP_WIFI_STATIC_NETMASK);
+  stIpInfo.gw.addr = esp_ip4addr_aton(APP_WIFI_STATIC_GATEWAY);
+  stDns.addr = esp_ip4addr_aton(APP_WIFI_STATIC_DNS);
+  _app_wifi_set_static_ip(&stIpInfo, stDns);
+#elif defined(APP_WIFI_REUSE_LEASE)
+  if(stCtx.stCache.stIpInfo.ip.addr)
+  {
+    _app_wifi_set_static_ip(&stCtx.stCache.stIpInfo, stCtx.stCache.stDns);
+  }
+#endif
   wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
   ESP_ERROR_CHECK(esp_wifi_init(&cfg));
   ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT,
@@ -87,22 +296,17 @@ void app_wifi_init(void)
                                              IP_EVENT_STA_GOT_IP,
                                              &_app_wifi_event_handler,
                                              NULL));
-  wifi_config_t wifi_config =
+  memcpy(&stCtx.stConfig, &stConfig, sizeof(wifi_config_t));
+  if(stCtx.stCache.u08Channel)
   {
-    .sta =
-    {
-      .ssid = WIFI_SSID,
-      .password = WIFI_PASS,
-      .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-      .pmf_cfg =
-      {
-        .capable = true,
-        .required = false
-      },
-    },
-  };
+    /* Go straight to the last AP instead of scanning every channel */
+    stCtx.bUsingCache = true;
+    stCtx.stConfig.sta.channel = stCtx.stCache.u08Channel;
+    stCtx.stConfig.sta.bssid_set = true;
+    memcpy(stCtx.stConfig.sta.bssid, stCtx.stCache.tu08Bssid, sizeof(stCtx.stConfig.sta.bssid));
+  }
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config) );
+  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &stCtx.stConfig) );
   ESP_ERROR_CHECK(esp_wifi_start() );
   ESP_LOGD(APP_WIFI_TAG, "Finished wifi initialization");
 }
@@ -110,34 +314,44 @@ void app_wifi_init(void)
 void app_wifi_wait(void)
 {
   ESP_LOGD(APP_WIFI_TAG, "Waiting for wifi connection");
-  stCtx.u32EventBits = xEventGroupWaitBits(stCtx.stWifiEventGroup,
-                                           APP_WIFI_CONNECTED_BIT | APP_WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-  if(stCtx.u32EventBits & APP_WIFI_CONNECTED_BIT)
+  xEventGroupWaitBits(stCtx.stWifiEventGroup,
+                      APP_WIFI_CONNECTED_BIT,
+                      pdFALSE,
+                      pdFALSE,
+                      portMAX_DELAY);
+  ESP_LOGD(APP_WIFI_TAG, "Connected to AP, SSID: %s", WIFI_SSID);
+}
+
+bool app_wifi_is_connected(void)
+{
+  return stCtx.bConnected;
+}
+
+/* Listeners are registered once at startup and never removed */
+esp_err_t app_wifi_register_cb(app_wifi_cb_t pfCallback)
+{
+  esp_err_t s32RetVal;
+
+  if(NULL == pfCallback)
   {
-    ESP_LOGD(APP_WIFI_TAG,
-             "Connected to AP, SSID: %s password: %s",
-             WIFI_SSID,
-             WIFI_PASS);
+    s32RetVal = ESP_ERR_INVALID_ARG;
   }
-  else if(stCtx.u32EventBits & APP_WIFI_FAIL_BIT)
+  else if(APP_WIFI_MAX_CALLBACKS <= stCtx.u32CallbackCount)
   {
-    ESP_LOGD(APP_WIFI_TAG,
-             "Failed to connect to SSID:%s, password:%s",
-             WIFI_SSID,
-             WIFI_PASS);
+    s32RetVal = ESP_ERR_NO_MEM;
   }
   else
   {
-    ESP_LOGE(APP_WIFI_TAG, "Wifi Timeout");
+    stCtx.tpfCallbacks[stCtx.u32CallbackCount++] = pfCallback;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+void app_wifi_get_stats(app_wifi_stats_t *pstStats)
+{
+  if(pstStats)
+  {
+    memcpy(pstStats, &stCtx.stStats, sizeof(app_wifi_stats_t));
   }
-  ESP_ERROR_CHECK(esp_event_handler_unregister(IP_EVENT,
-                                               IP_EVENT_STA_GOT_IP,
-                                               &_app_wifi_event_handler));
-  ESP_ERROR_CHECK(esp_event_handler_unregister(WIFI_EVENT,
-                                               ESP_EVENT_ANY_ID,
-                                               &_app_wifi_event_handler));
-  vEventGroupDelete(stCtx.stWifiEventGroup);
 }
\ No newline at end of file
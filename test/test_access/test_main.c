@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include "app_access.h"
+#include "app_conn.h"
+#include "host_shims.h"
+
+#define TEST_ACCESS_SCANS_PER_SECOND             100
+#define TEST_ACCESS_BENCH_SCANS                  300
+#define TEST_ACCESS_MAX_DECISION_US              1000
+
+typedef struct
+{
+  uint32_t u32Lookups;
+  esp_err_t s32Result;
+  bool bGranted;
+  /* Called from inside the lookup, e.g. to race a sync */
+  void (*pfDuring)(void);
+}access_lookup_t;
+
+typedef struct
+{
+  uint32_t u32Decisions;
+  bool bLastGranted;
+  uint8_t u08LastReaderId;
+}access_decision_t;
+
+static access_lookup_t stLookup;
+static access_decision_t stDecision;
+static atomic_bool bUploadStalled;
+static atomic_bool bUploadStarted;
+
+static const uint8_t tu08Known[] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+static const uint8_t tu08Unknown[] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+/* Stands in for the tag index, known UIDs start with 0x04 */
+static esp_err_t _test_access_lookup(const uint8_t *pu08Uid, uint8_t u08UidLength, bool *pbGranted)
+{
+  stLookup.u32Lookups++;
+  if(stLookup.pfDuring)
+  {
+    stLookup.pfDuring();
+  }
+  *pbGranted = stLookup.bGranted || ((u08UidLength > 0) && (0x04 == pu08Uid[0]));
+  return stLookup.s32Result;
+}
+
+static void _test_access_decision(uint8_t u08ReaderId, const uint8_t *pu08Uid, uint8_t u08UidLength, bool bGranted)
+{
+  stDecision.u32Decisions++;
+  stDecision.bLastGranted = bGranted;
+  stDecision.u08LastReaderId = u08ReaderId;
+}
+
+static void _test_access_forget_known(void)
+{
+  app_access_forget(tu08Known, sizeof(tu08Known));
+}
+
+/* The backend holds every request until the test releases it, like a stalled
+   uplink */
+static int _test_access_stalled_backend(esp_http_client_method_t eMethod,
+                                        const char *pcPath,
+                                        const char *pcBody,
+                                        uint32_t u32BodyLength,
+                                        app_conn_data_cb_t pfDataCb,
+                                        void *pvArg)
+{
+  atomic_store(&bUploadStarted, true);
+  while(atomic_load(&bUploadStalled))
+  {
+    vTaskDelay(1);
+  }
+  return 200;
+}
+
+static void _test_access_upload_task(void *pvArg)
+{
+  int s32HttpCode;
+
+  app_conn_request(HTTP_METHOD_POST, ":commit", "{}", 2, NULL, NULL, &s32HttpCode);
+}
+
+void setUp(void)
+{
+  memset(&stLookup, 0x00, sizeof(stLookup));
+  memset(&stDecision, 0x00, sizeof(stDecision));
+  stLookup.s32Result = ESP_OK;
+  host_time_set_manual(1000000);
+  app_access_init(_test_access_lookup, _test_access_decision);
+  app_access_flush();
+}
+
+void tearDown(void)
+{
+  host_time_set_real();
+  host_conn_set_handler(NULL);
+}
+
+/* Only the first read of a badge reaches the lookup, denials are cached too */
+static void test_access_cache_hits(void)
+{
+  app_access_stats_t stStats;
+
+  TEST_ASSERT_TRUE(app_access_decide(1, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_TRUE(app_access_decide(2, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_FALSE(app_access_decide(1, tu08Unknown, sizeof(tu08Unknown)));
+  TEST_ASSERT_FALSE(app_access_decide(1, tu08Unknown, sizeof(tu08Unknown)));
+  TEST_ASSERT_EQUAL_UINT32(2, stLookup.u32Lookups);
+  TEST_ASSERT_EQUAL_UINT32(4, stDecision.u32Decisions);
+  TEST_ASSERT_EQUAL_UINT8(1, stDecision.u08LastReaderId);
+  app_access_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Hits);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Misses);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Unavailable);
+}
+
+static void test_access_entries_expire(void)
+{
+  TEST_ASSERT_FALSE(app_access_decide(0, tu08Unknown, sizeof(tu08Unknown)));
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  host_time_advance_us(CONFIG_RFID_ACCESS_DENY_TTL_MS * 1000LL);
+  TEST_ASSERT_FALSE(app_access_decide(0, tu08Unknown, sizeof(tu08Unknown)));
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(3, stLookup.u32Lookups);
+  host_time_advance_us(CONFIG_RFID_ACCESS_GRANT_TTL_MS * 1000LL);
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(4, stLookup.u32Lookups);
+}
+
+/* A sync that changes the badge drops its entry, the next read looks it up */
+static void test_access_forget_and_flush(void)
+{
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  app_access_forget(tu08Known, sizeof(tu08Known));
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(2, stLookup.u32Lookups);
+  app_access_flush();
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(3, stLookup.u32Lookups);
+}
+
+/* A lookup that raced a change of the same badge isn't cached */
+static void test_access_lookup_races_forget(void)
+{
+  stLookup.pfDuring = _test_access_forget_known;
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  stLookup.pfDuring = NULL;
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(2, stLookup.u32Lookups);
+}
+
+/* While the index is busy an expired grant still opens the door, an unknown
+   badge is denied, neither is cached */
+static void test_access_lookup_unavailable(void)
+{
+  app_access_stats_t stStats;
+
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  host_time_advance_us(CONFIG_RFID_ACCESS_GRANT_TTL_MS * 1000LL);
+  stLookup.s32Result = ESP_ERR_TIMEOUT;
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_FALSE(app_access_decide(0, tu08Unknown, sizeof(tu08Unknown)));
+  stLookup.bGranted = true;
+  TEST_ASSERT_FALSE(app_access_decide(0, tu08Unknown, sizeof(tu08Unknown)));
+  app_access_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32Unavailable);
+  stLookup.s32Result = ESP_OK;
+  stLookup.bGranted = false;
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  TEST_ASSERT_EQUAL_UINT32(5, stLookup.u32Lookups);
+}
+
+/* Least recently used entries make room, a badge used all along stays */
+static void test_access_eviction(void)
+{
+  uint8_t tu08Uid[4];
+  uint32_t u32Index;
+
+  TEST_ASSERT_TRUE(app_access_decide(0, tu08Known, sizeof(tu08Known)));
+  for(u32Index = 0; u32Index < (2 * APP_ACCESS_CACHE_ENTRIES); u32Index++)
+  {
+    host_time_advance_us(1000);
+    tu08Uid[0] = 0x80;
+    tu08Uid[1] = (uint8_t)u32Index;
+    tu08Uid[2] = (uint8_t)(u32Index >> 8);
+    tu08Uid[3] = 0x00;
+    app_access_decide(0, tu08Uid, sizeof(tu08Uid));
+    app_access_decide(0, tu08Known, sizeof(tu08Known));
+  }
+  TEST_ASSERT_EQUAL_UINT32(1 + 2 * APP_ACCESS_CACHE_ENTRIES, stLookup.u32Lookups);
+}
+
+/* 100 scans/s on the real clock, a third of them misses, while an upload
+   task is stuck in a request: no decision takes more than 1 ms */
+static void test_access_decision_time_with_stalled_upload(void)
+{
+  uint8_t tu08Uid[7];
+  uint32_t u32Index;
+  uint32_t u32ElapsedUs;
+  uint32_t u32MaxUs;
+  int64_t s64StartUs;
+  char tcLine[96];
+  app_access_stats_t stStats;
+
+  host_time_set_real();
+  atomic_store(&bUploadStalled, true);
+  atomic_store(&bUploadStarted, false);
+  host_conn_set_handler(_test_access_stalled_backend);
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(_test_access_upload_task, "upload", 4096, NULL, 5, NULL));
+  while(!atomic_load(&bUploadStarted))
+  {
+    vTaskDelay(1);
+  }
+  u32MaxUs = 0;
+  memcpy(tu08Uid, tu08Known, sizeof(tu08Uid));
+  for(u32Index = 0; u32Index < TEST_ACCESS_BENCH_SCANS; u32Index++)
+  {
+    tu08Uid[1] = (uint8_t)(u32Index / 3);
+    s64StartUs = esp_timer_get_time();
+    app_access_decide(0, tu08Uid, sizeof(tu08Uid));
+    u32ElapsedUs = (uint32_t)(esp_timer_get_time() - s64StartUs);
+    u32MaxUs = (u32ElapsedUs > u32MaxUs)?u32ElapsedUs:u32MaxUs;
+    vTaskDelay(pdMS_TO_TICKS(1000 / TEST_ACCESS_SCANS_PER_SECOND));
+  }
+  TEST_ASSERT_TRUE(atomic_load(&bUploadStalled));
+  atomic_store(&bUploadStalled, false);
+  app_access_get_stats(&stStats);
+  snprintf(tcLine, sizeof(tcLine), "%u decisions, %u misses, max %u us", TEST_ACCESS_BENCH_SCANS, stStats.u32Misses, u32MaxUs);
+  TEST_MESSAGE(tcLine);
+  TEST_ASSERT_EQUAL_UINT32(TEST_ACCESS_BENCH_SCANS, stDecision.u32Decisions);
+  TEST_ASSERT_EQUAL_UINT32(TEST_ACCESS_BENCH_SCANS / 3, stStats.u32Misses);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_ACCESS_MAX_DECISION_US, u32MaxUs);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_ACCESS_MAX_DECISION_US, stStats.u32MaxDecisionUs);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_access_cache_hits);
+  RUN_TEST(test_access_entries_expire);
+  RUN_TEST(test_access_forget_and_flush);
+  RUN_TEST(test_access_lookup_races_forget);
+  RUN_TEST(test_access_lookup_unavailable);
+  RUN_TEST(test_access_eviction);
+  RUN_TEST(test_access_decision_time_with_stalled_upload);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,628 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+#include <esp_system.h>
+
+#include "app_batch.h"
+#include "app_hist.h"
+#include "host_shims.h"
+
+/* Batched against per-tag uploads on the manual clock: reads arrive at a fixed
+   rate and every request costs a round trip plus a little per write */
+#define TEST_BATCH_BENCH_READS                   2000
+#define TEST_BATCH_BENCH_READS_PER_SECOND        100
+#define TEST_BATCH_BENCH_RTT_US                  30000
+#define TEST_BATCH_BENCH_WRITE_US                200
+#define TEST_BATCH_DOCUMENT_PATH                 "devices/rfid-node"
+#define TEST_BATCH_DOCUMENTS_PATH                "/documents/"
+/* Write models against the emulator: scans of a pool of tags from several
+   nodes, the emulator takes one commit per second on a document */
+#define TEST_BATCH_MODEL_SCANS                   600
+#define TEST_BATCH_MODEL_SCANS_PER_SECOND        20
+#define TEST_BATCH_MODEL_TAGS                    40
+#define TEST_BATCH_MODEL_OTHER_NODES             3
+#define TEST_BATCH_MODEL_DOCUMENT_PERIOD_US      1000000LL
+#define TEST_BATCH_MODEL_NODE_PATH               "devices/rfid-node-A1B2C3"
+#define TEST_BATCH_MODEL_MAX_DOCUMENTS           64
+#define TEST_BATCH_PATH_MAX_SIZE                 48
+
+typedef enum
+{
+  TEST_BATCH_MODEL_SINGLE = 0,
+  TEST_BATCH_MODEL_NODE,
+  TEST_BATCH_MODEL_TAG,
+  TEST_BATCH_MODEL_COUNT,
+}batch_model_t;
+
+/* Document of the emulator and when it takes its next commit */
+typedef struct
+{
+  char tcPath[TEST_BATCH_PATH_MAX_SIZE];
+  int64_t s64FreeUs;
+}batch_document_t;
+
+typedef struct
+{
+  uint32_t u32Tag;
+  uint32_t u32Reader;
+  int64_t s64ArrivalUs;
+}batch_scan_t;
+
+typedef struct
+{
+  int s32HttpCode;
+  esp_http_client_method_t eMethod;
+  uint32_t u32Writes;
+  char tcPath[32];
+  char tcBody[APP_BATCH_BODY_MAX_SIZE];
+  /* Emulator: scans counted by the last commit and the documents written */
+  bool bEmulator;
+  uint32_t u32Scans;
+  uint32_t u32Documents;
+  batch_document_t tstDocuments[TEST_BATCH_MODEL_MAX_DOCUMENTS];
+}batch_backend_t;
+
+typedef struct
+{
+  uint32_t u32Acked;
+  uint32_t u32Commits;
+  uint32_t u32Writes;
+  int64_t s64ElapsedUs;
+  app_hist_t stLatency;
+}batch_report_t;
+
+static batch_backend_t stBackend;
+static batch_scan_t tstScans[TEST_BATCH_MODEL_SCANS];
+static char tcNote[APP_BATCH_BODY_MAX_SIZE / 2];
+static const char *const tpcMask[] = {"sn", "reader", "timestamp"};
+static const char *const tpcModelNames[TEST_BATCH_MODEL_COUNT] = {"single", "node", "tag"};
+
+/* Firestore takes about one commit per second on a document. The emulator
+   holds a commit until all its documents are free, the shared document of
+   the single model is also written by the other nodes in between */
+static int64_t _test_batch_emulate(const char *pcBody)
+{
+  int64_t s64StartUs;
+  uint32_t u32Index;
+  uint32_t u32Write;
+  uint32_t u32Length;
+  uint32_t u32WriteCount;
+  const char *pcWrite;
+  const char *pcNext;
+  const char *pcName;
+  const char *pcIncrement;
+  batch_document_t *tpstWritten[APP_BATCH_MAX_WRITES];
+
+  s64StartUs = esp_timer_get_time();
+  stBackend.u32Scans = 0;
+  u32WriteCount = 0;
+  for(pcWrite = strstr(pcBody, "{\"update\""); pcWrite && (u32WriteCount < APP_BATCH_MAX_WRITES); pcWrite = pcNext)
+  {
+    pcNext = strstr(pcWrite + 1, "{\"update\"");
+    pcName = strstr(pcWrite, TEST_BATCH_DOCUMENTS_PATH) + sizeof(TEST_BATCH_DOCUMENTS_PATH) - 1;
+    u32Length = strchr(pcName, '"') - pcName;
+    for(u32Index = 0;
+        (u32Index < stBackend.u32Documents) &&
+        ((strlen(stBackend.tstDocuments[u32Index].tcPath) != u32Length) ||
+         strncmp(stBackend.tstDocuments[u32Index].tcPath, pcName, u32Length));
+        u32Index++);
+    if(u32Index == stBackend.u32Documents)
+    {
+      TEST_ASSERT_LESS_THAN_UINT32(TEST_BATCH_MODEL_MAX_DOCUMENTS, u32Index);
+      memcpy(stBackend.tstDocuments[u32Index].tcPath, pcName, u32Length);
+      stBackend.tstDocuments[u32Index].tcPath[u32Length] = '\0';
+      stBackend.u32Documents++;
+    }
+    tpstWritten[u32WriteCount++] = &stBackend.tstDocuments[u32Index];
+    if(stBackend.tstDocuments[u32Index].s64FreeUs > s64StartUs)
+    {
+      s64StartUs = stBackend.tstDocuments[u32Index].s64FreeUs;
+    }
+    pcIncrement = strstr(pcWrite, "\"increment\":{\"integerValue\":");
+    stBackend.u32Scans += (pcIncrement && (!pcNext || (pcIncrement < pcNext)))?
+                          strtoul(pcIncrement + sizeof("\"increment\":{\"integerValue\":") - 1, NULL, 10):1;
+  }
+  for(u32Write = 0; u32Write < u32WriteCount; u32Write++)
+  {
+    tpstWritten[u32Write]->s64FreeUs = s64StartUs + TEST_BATCH_MODEL_DOCUMENT_PERIOD_US *
+                                       (strcmp(tpstWritten[u32Write]->tcPath, TEST_BATCH_DOCUMENT_PATH)?
+                                        1:(1 + TEST_BATCH_MODEL_OTHER_NODES));
+  }
+  return s64StartUs - esp_timer_get_time();
+}
+
+/* Answers with the status set by the test, keeps the last request and takes
+   the time of a round trip when the manual clock is on */
+static int _test_batch_backend(esp_http_client_method_t eMethod,
+                               const char *pcPath,
+                               const char *pcBody,
+                               uint32_t u32BodyLength,
+                               app_conn_data_cb_t pfDataCb,
+                               void *pvArg)
+{
+  const char *pcWrite;
+
+  stBackend.eMethod = eMethod;
+  snprintf(stBackend.tcPath, sizeof(stBackend.tcPath), "%s", pcPath);
+  memcpy(stBackend.tcBody, pcBody, u32BodyLength);
+  stBackend.tcBody[u32BodyLength] = '\0';
+  stBackend.u32Writes = 0;
+  for(pcWrite = strstr(pcBody, "\"update\""); pcWrite; pcWrite = strstr(pcWrite + 1, "\"update\""))
+  {
+    stBackend.u32Writes++;
+  }
+  if(stBackend.bEmulator)
+  {
+    host_time_advance_us(_test_batch_emulate(stBackend.tcBody));
+  }
+  host_time_advance_us(TEST_BATCH_BENCH_RTT_US + stBackend.u32Writes * TEST_BATCH_BENCH_WRITE_US);
+  return stBackend.s32HttpCode;
+}
+
+static void _test_batch_write_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  app_doc_add_integer(pstDoc, "reader", *(const uint32_t *)pvArg);
+}
+
+static void _test_batch_note_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  app_doc_add_string(pstDoc, "note", pvArg);
+}
+
+/* Same fields as the scan documents of app_pipeline.c */
+static void _test_batch_scan_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  const batch_scan_t *pstScan;
+
+  pstScan = pvArg;
+  app_doc_add_hex(pstDoc, "sn", (const uint8_t *)&pstScan->u32Tag, sizeof(pstScan->u32Tag));
+  app_doc_add_integer(pstDoc, "reader", pstScan->u32Reader);
+  app_doc_add_integer(pstDoc, "timestamp", pstScan->s64ArrivalUs / 1000);
+}
+
+/* A scan written the way app_pipeline.c does it with the given write model */
+static esp_err_t _test_batch_add_scan(batch_model_t eModel, const batch_scan_t *pstScan)
+{
+  char tcPath[TEST_BATCH_PATH_MAX_SIZE];
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = tcPath,
+    .pfFields = _test_batch_scan_fields,
+    .pvArg = pstScan,
+    .ppcMask = tpcMask,
+    .u32MaskCount = sizeof(tpcMask) / sizeof(tpcMask[0]),
+    .pcRequestTimeField = "lastSeen",
+    .pcCounterField = "scans",
+    .bCoalesce = true,
+  };
+
+  if(TEST_BATCH_MODEL_SINGLE == eModel)
+  {
+    snprintf(tcPath, sizeof(tcPath), TEST_BATCH_DOCUMENT_PATH);
+    stWrite.ppcMask = NULL;
+    stWrite.pcRequestTimeField = NULL;
+    stWrite.pcCounterField = NULL;
+    stWrite.bCoalesce = false;
+  }
+  else if(TEST_BATCH_MODEL_NODE == eModel)
+  {
+    snprintf(tcPath, sizeof(tcPath), TEST_BATCH_MODEL_NODE_PATH);
+  }
+  else
+  {
+    snprintf(tcPath, sizeof(tcPath), "tags/%08X", (unsigned int)pstScan->u32Tag);
+  }
+  return app_batch_add_write(&stWrite);
+}
+
+/* Reads are taken as they arrived, up to u32MaxWrites per request, and
+   acknowledged when the request returns */
+static void _test_batch_bench(uint32_t u32MaxWrites, batch_report_t *pstReport)
+{
+  uint32_t u32Read;
+  uint32_t u32Count;
+  uint32_t u32Index;
+  int64_t s64StartUs;
+  int64_t s64NowUs;
+  int64_t ts64ArrivalUs[APP_BATCH_MAX_WRITES];
+
+  memset(pstReport, 0x00, sizeof(batch_report_t));
+  app_hist_reset(&pstReport->stLatency);
+  s64StartUs = esp_timer_get_time();
+  u32Read = 0;
+  while(u32Read < TEST_BATCH_BENCH_READS)
+  {
+    u32Count = 0;
+    s64NowUs = esp_timer_get_time();
+    while((u32Count < u32MaxWrites) &&
+          (u32Read < TEST_BATCH_BENCH_READS) &&
+          ((s64StartUs + (u32Read * 1000000LL) / TEST_BATCH_BENCH_READS_PER_SECOND) <= s64NowUs))
+    {
+      ts64ArrivalUs[u32Count] = s64StartUs + (u32Read * 1000000LL) / TEST_BATCH_BENCH_READS_PER_SECOND;
+      TEST_ASSERT_EQUAL(ESP_OK, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Read));
+      u32Count++;
+      u32Read++;
+    }
+    if(u32Count)
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+      TEST_ASSERT_EQUAL_UINT32(u32Count, stBackend.u32Writes);
+      s64NowUs = esp_timer_get_time();
+      for(u32Index = 0; u32Index < u32Count; u32Index++)
+      {
+        app_hist_record(&pstReport->stLatency, (uint32_t)(s64NowUs - ts64ArrivalUs[u32Index]));
+      }
+      pstReport->u32Acked += u32Count;
+    }
+    else
+    {
+      host_time_advance_us(1000);
+    }
+  }
+  pstReport->s64ElapsedUs = esp_timer_get_time() - s64StartUs;
+}
+
+/* Scans go to the batch as they arrive until it is full, every commit waits
+   for the emulator and acknowledges all the scans it carried */
+static void _test_batch_model_bench(batch_model_t eModel, batch_report_t *pstReport)
+{
+  esp_err_t s32RetVal;
+  uint32_t u32Added;
+  uint32_t u32Index;
+  int64_t s64StartUs;
+  int64_t s64NowUs;
+
+  memset(pstReport, 0x00, sizeof(batch_report_t));
+  app_hist_reset(&pstReport->stLatency);
+  stBackend.u32Documents = 0;
+  stBackend.bEmulator = true;
+  s64StartUs = esp_timer_get_time();
+  u32Added = 0;
+  while(pstReport->u32Acked < TEST_BATCH_MODEL_SCANS)
+  {
+    s32RetVal = ESP_OK;
+    s64NowUs = esp_timer_get_time();
+    while((ESP_OK == s32RetVal) &&
+          (u32Added < TEST_BATCH_MODEL_SCANS) &&
+          ((s64StartUs + tstScans[u32Added].s64ArrivalUs) <= s64NowUs))
+    {
+      s32RetVal = _test_batch_add_scan(eModel, &tstScans[u32Added]);
+      u32Added += (ESP_OK == s32RetVal)?1:0;
+    }
+    if(u32Added > pstReport->u32Acked)
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+      TEST_ASSERT_EQUAL_UINT32(u32Added - pstReport->u32Acked, stBackend.u32Scans);
+      s64NowUs = esp_timer_get_time();
+      for(u32Index = pstReport->u32Acked; u32Index < u32Added; u32Index++)
+      {
+        app_hist_record(&pstReport->stLatency, (uint32_t)(s64NowUs - s64StartUs - tstScans[u32Index].s64ArrivalUs));
+      }
+      pstReport->u32Acked = u32Added;
+      pstReport->u32Commits++;
+      pstReport->u32Writes += stBackend.u32Writes;
+    }
+    else
+    {
+      host_time_advance_us(1000);
+    }
+  }
+  pstReport->s64ElapsedUs = esp_timer_get_time() - s64StartUs;
+  stBackend.bEmulator = false;
+}
+
+static uint32_t _test_batch_model_print(batch_model_t eModel, const batch_report_t *pstReport)
+{
+  uint32_t u32ScansPerSecond;
+  char tcLine[128];
+
+  u32ScansPerSecond = (uint32_t)((pstReport->u32Acked * 1000000LL) / pstReport->s64ElapsedUs);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-6s %2u scans/s acknowledged, %3u commits, %3u writes, scan to ack p50/p99 %u/%u us",
+           tpcModelNames[eModel],
+           u32ScansPerSecond,
+           pstReport->u32Commits,
+           pstReport->u32Writes,
+           app_hist_percentile(&pstReport->stLatency, 50),
+           app_hist_percentile(&pstReport->stLatency, 99));
+  TEST_MESSAGE(tcLine);
+  return u32ScansPerSecond;
+}
+
+static uint32_t _test_batch_print(const char *pcName, const batch_report_t *pstReport)
+{
+  uint32_t u32ReadsPerSecond;
+  char tcLine[128];
+
+  u32ReadsPerSecond = (uint32_t)((pstReport->u32Acked * 1000000LL) / pstReport->s64ElapsedUs);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%s: %u reads/s acknowledged, scan to ack p50/p99 %u/%u us",
+           pcName,
+           u32ReadsPerSecond,
+           app_hist_percentile(&pstReport->stLatency, 50),
+           app_hist_percentile(&pstReport->stLatency, 99));
+  TEST_MESSAGE(tcLine);
+  return u32ReadsPerSecond;
+}
+
+void setUp(void)
+{
+  memset(&stBackend, 0x00, sizeof(stBackend));
+  host_time_set_manual(1000000);
+  /* Leftovers of a failed test are dropped with a failed commit, setting the
+     handler again clears the request count */
+  stBackend.s32HttpCode = 500;
+  host_conn_set_handler(_test_batch_backend);
+  app_batch_commit();
+  stBackend.s32HttpCode = 200;
+  host_conn_set_handler(_test_batch_backend);
+}
+
+void tearDown(void)
+{
+  host_conn_set_handler(NULL);
+  host_time_set_real();
+}
+
+static void test_batch_commit_body(void)
+{
+  uint32_t u32Reader;
+
+  u32Reader = 1;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add("scans/a", _test_batch_write_fields, &u32Reader));
+  u32Reader = 2;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add("scans/b", _test_batch_write_fields, &u32Reader));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(1, host_conn_get_requests());
+  TEST_ASSERT_EQUAL(HTTP_METHOD_POST, stBackend.eMethod);
+  TEST_ASSERT_EQUAL_STRING(":commit", stBackend.tcPath);
+  TEST_ASSERT_EQUAL_STRING("{\"writes\":["
+                           "{\"update\":{\"name\":\"projects/rfid-test/databases/(default)/documents/scans/a\","
+                           "\"fields\":{\"reader\":{\"integerValue\":1}}}},"
+                           "{\"update\":{\"name\":\"projects/rfid-test/databases/(default)/documents/scans/b\","
+                           "\"fields\":{\"reader\":{\"integerValue\":2}}}}"
+                           "]}",
+                           stBackend.tcBody);
+}
+
+static void test_batch_empty_commit(void)
+{
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(0, host_conn_get_requests());
+}
+
+/* A full batch refuses writes until it is committed */
+static void test_batch_full(void)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < APP_BATCH_MAX_WRITES; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Index));
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Index));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(APP_BATCH_MAX_WRITES, stBackend.u32Writes);
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Index));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Writes);
+}
+
+/* HTTP and transport errors fail the commit, its writes are dropped */
+static void test_batch_commit_errors(void)
+{
+  uint32_t u32Reader;
+
+  u32Reader = 1;
+  stBackend.s32HttpCode = 503;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Reader));
+  TEST_ASSERT_EQUAL(ESP_FAIL, app_batch_commit());
+  stBackend.s32HttpCode = -1;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add(TEST_BATCH_DOCUMENT_PATH, _test_batch_write_fields, &u32Reader));
+  TEST_ASSERT_EQUAL(ESP_FAIL, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(2, host_conn_get_requests());
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(2, host_conn_get_requests());
+}
+
+static void test_batch_invalid_args(void)
+{
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_batch_add(NULL, _test_batch_write_fields, NULL));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_batch_add(TEST_BATCH_DOCUMENT_PATH, NULL, NULL));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_batch_add_write(NULL));
+}
+
+/* Mask and transforms follow the fields of the update */
+static void test_batch_write_mask_and_transforms(void)
+{
+  uint32_t u32Reader;
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = "tags/04A1",
+    .pfFields = _test_batch_write_fields,
+    .pvArg = &u32Reader,
+    .ppcMask = tpcMask,
+    .u32MaskCount = 2,
+    .pcRequestTimeField = "lastSeen",
+    .pcCounterField = "scans",
+  };
+
+  u32Reader = 1;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_STRING("{\"writes\":["
+                           "{\"update\":{\"name\":\"projects/rfid-test/databases/(default)/documents/tags/04A1\","
+                           "\"fields\":{\"reader\":{\"integerValue\":1}}},"
+                           "\"updateMask\":{\"fieldPaths\":[\"sn\",\"reader\"]},"
+                           "\"updateTransforms\":["
+                           "{\"fieldPath\":\"lastSeen\",\"setToServerValue\":\"REQUEST_TIME\"},"
+                           "{\"fieldPath\":\"scans\",\"increment\":{\"integerValue\":1}}]}"
+                           "]}",
+                           stBackend.tcBody);
+}
+
+/* A coalesced write goes to the end of the batch in place of the pending one
+   and counts both, other writes to the same document are kept */
+static void test_batch_coalesce(void)
+{
+  uint32_t tu32Readers[3] = {1, 2, 3};
+  app_batch_write_t stWrite =
+  {
+    .pfFields = _test_batch_write_fields,
+    .pcCounterField = "scans",
+    .bCoalesce = true,
+  };
+
+  stWrite.pcDocumentPath = "tags/A";
+  stWrite.pvArg = &tu32Readers[0];
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  stWrite.pcDocumentPath = "tags/B";
+  stWrite.pvArg = &tu32Readers[1];
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  stWrite.pcDocumentPath = "tags/A";
+  stWrite.pvArg = &tu32Readers[2];
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_STRING("{\"writes\":["
+                           "{\"update\":{\"name\":\"projects/rfid-test/databases/(default)/documents/tags/B\","
+                           "\"fields\":{\"reader\":{\"integerValue\":2}}},"
+                           "\"updateTransforms\":[{\"fieldPath\":\"scans\",\"increment\":{\"integerValue\":1}}]},"
+                           "{\"update\":{\"name\":\"projects/rfid-test/databases/(default)/documents/tags/A\","
+                           "\"fields\":{\"reader\":{\"integerValue\":3}}},"
+                           "\"updateTransforms\":[{\"fieldPath\":\"scans\",\"increment\":{\"integerValue\":2}}]}"
+                           "]}",
+                           stBackend.tcBody);
+  stWrite.bCoalesce = false;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Writes);
+}
+
+/* A full batch still takes writes to its documents */
+static void test_batch_coalesce_full(void)
+{
+  uint32_t u32Index;
+  char ttcPaths[APP_BATCH_MAX_WRITES + 1][TEST_BATCH_PATH_MAX_SIZE];
+  app_batch_write_t stWrite =
+  {
+    .pfFields = _test_batch_write_fields,
+    .pvArg = &u32Index,
+    .pcCounterField = "scans",
+    .bCoalesce = true,
+  };
+
+  for(u32Index = 0; u32Index <= APP_BATCH_MAX_WRITES; u32Index++)
+  {
+    snprintf(ttcPaths[u32Index], sizeof(ttcPaths[u32Index]), "tags/%u", u32Index);
+    stWrite.pcDocumentPath = ttcPaths[u32Index];
+    TEST_ASSERT_EQUAL((APP_BATCH_MAX_WRITES == u32Index)?ESP_ERR_NO_MEM:ESP_OK, app_batch_add_write(&stWrite));
+  }
+  stWrite.pcDocumentPath = ttcPaths[0];
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  stBackend.bEmulator = true;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  stBackend.bEmulator = false;
+  TEST_ASSERT_EQUAL_UINT32(APP_BATCH_MAX_WRITES, stBackend.u32Writes);
+  TEST_ASSERT_EQUAL_UINT32(APP_BATCH_MAX_WRITES + 1, stBackend.u32Scans);
+}
+
+/* A replacement that doesn't fit leaves the pending write alone */
+static void test_batch_coalesce_no_room(void)
+{
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = "tags/A",
+    .pfFields = _test_batch_note_fields,
+    .pvArg = "short",
+    .pcCounterField = "scans",
+    .bCoalesce = true,
+  };
+
+  memset(tcNote, 'n', sizeof(tcNote) - 64);
+  tcNote[sizeof(tcNote) - 64] = '\0';
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add("tags/B", _test_batch_note_fields, tcNote));
+  stWrite.pvArg = tcNote;
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_batch_add_write(&stWrite));
+  stBackend.bEmulator = true;
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  stBackend.bEmulator = false;
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Writes);
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Scans);
+  TEST_ASSERT_NOT_NULL(strstr(stBackend.tcBody, "{\"stringValue\":\"short\"}"));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_add_write(&stWrite));
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+}
+
+/* Past one read per round trip the per-tag mode falls behind and its latency
+   grows with the run, batches keep up with the reads */
+static void test_batch_bench_batched_vs_per_tag(void)
+{
+  batch_report_t stBatched;
+  batch_report_t stPerTag;
+
+  _test_batch_bench(APP_BATCH_MAX_WRITES, &stBatched);
+  _test_batch_bench(1, &stPerTag);
+  TEST_ASSERT_EQUAL_UINT32(TEST_BATCH_BENCH_READS, stBatched.u32Acked);
+  TEST_ASSERT_EQUAL_UINT32(TEST_BATCH_BENCH_READS, stPerTag.u32Acked);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32((TEST_BATCH_BENCH_READS_PER_SECOND * 9) / 10, _test_batch_print("batched", &stBatched));
+  TEST_ASSERT_LESS_THAN_UINT32(1000000 / TEST_BATCH_BENCH_RTT_US + 1, _test_batch_print("per-tag", &stPerTag));
+  TEST_ASSERT_LESS_THAN_UINT32(4 * TEST_BATCH_BENCH_RTT_US, app_hist_percentile(&stBatched.stLatency, 99));
+  TEST_ASSERT_GREATER_THAN_UINT32(app_hist_percentile(&stBatched.stLatency, 99),
+                                  app_hist_percentile(&stPerTag.stLatency, 99));
+}
+
+/* The single document takes a batch every time the other nodes are done
+   with it. The node model keeps up with the scans with one write per batch.
+   Per tag documents keep up as long as a batch holds the tags scanned within
+   a second, smaller batches wait on a tag written by the previous commit */
+static void test_batch_bench_write_models(void)
+{
+  uint32_t u32Index;
+  uint32_t tu32Rates[TEST_BATCH_MODEL_COUNT];
+  batch_report_t tstReports[TEST_BATCH_MODEL_COUNT];
+
+  for(u32Index = 0; u32Index < TEST_BATCH_MODEL_SCANS; u32Index++)
+  {
+    tstScans[u32Index].u32Tag = 0x04000000 | (esp_random() % TEST_BATCH_MODEL_TAGS);
+    tstScans[u32Index].u32Reader = esp_random() % 4;
+    tstScans[u32Index].s64ArrivalUs = (u32Index * 1000000LL) / TEST_BATCH_MODEL_SCANS_PER_SECOND;
+  }
+  for(u32Index = 0; u32Index < TEST_BATCH_MODEL_COUNT; u32Index++)
+  {
+    _test_batch_model_bench(u32Index, &tstReports[u32Index]);
+    TEST_ASSERT_EQUAL_UINT32(TEST_BATCH_MODEL_SCANS, tstReports[u32Index].u32Acked);
+    tu32Rates[u32Index] = _test_batch_model_print(u32Index, &tstReports[u32Index]);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32((APP_BATCH_MAX_WRITES * 1000000LL) /
+                                   ((1 + TEST_BATCH_MODEL_OTHER_NODES) * TEST_BATCH_MODEL_DOCUMENT_PERIOD_US),
+                                   tu32Rates[TEST_BATCH_MODEL_SINGLE]);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32((TEST_BATCH_MODEL_SCANS_PER_SECOND * 9) / 10, tu32Rates[TEST_BATCH_MODEL_NODE]);
+  TEST_ASSERT_GREATER_THAN_UINT32(2 * tu32Rates[TEST_BATCH_MODEL_SINGLE], tu32Rates[TEST_BATCH_MODEL_TAG]);
+  TEST_ASSERT_EQUAL_UINT32(tstReports[TEST_BATCH_MODEL_NODE].u32Commits, tstReports[TEST_BATCH_MODEL_NODE].u32Writes);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_BATCH_MODEL_SCANS, tstReports[TEST_BATCH_MODEL_TAG].u32Writes);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_commit_body);
+  RUN_TEST(test_batch_empty_commit);
+  RUN_TEST(test_batch_full);
+  RUN_TEST(test_batch_commit_errors);
+  RUN_TEST(test_batch_invalid_args);
+  RUN_TEST(test_batch_write_mask_and_transforms);
+  RUN_TEST(test_batch_coalesce);
+  RUN_TEST(test_batch_coalesce_full);
+  RUN_TEST(test_batch_coalesce_no_room);
+  RUN_TEST(test_batch_bench_batched_vs_per_tag);
+  RUN_TEST(test_batch_bench_write_models);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+#include <esp_http_client.h>
+
+#include "app_conn.h"
+#include "host_shims.h"
+
+/* Built with the real app_conn.c in [env:native_conn]. The backend spends the
+   times below on the manual clock, a TCP + TLS handshake on top of the request
+   when it comes on a new connection */
+#define TEST_CONN_HANDSHAKE_MS                   300
+#define TEST_CONN_REQUEST_MS                     60
+#define TEST_CONN_DOCUMENTS                      100
+#define TEST_CONN_KEEP_ALIVE_GAP_MS              1000
+#define TEST_CONN_IDLE_GAP_MS                    31000
+#define TEST_CONN_MAX_SCRIPT                     4
+#define TEST_CONN_URL                            "https://firestore.googleapis.com/v1/projects/rfid-test/" \
+                                                 "databases/(default)/documents"
+
+typedef struct
+{
+  /* Statuses of the next requests, a 200 after them */
+  int ts32Script[TEST_CONN_MAX_SCRIPT];
+  uint32_t u32ScriptLength;
+  uint32_t u32Calls;
+  /* Requests that reached the server */
+  uint32_t u32Received;
+  esp_http_client_method_t eMethod;
+  char tcUrl[256];
+  char tcBody[128];
+  char tcContentType[64];
+  char tcData[64];
+}conn_backend_t;
+
+static conn_backend_t stBackend;
+static const char tcDocument[] = "{\"fields\":{\"sn\":{\"stringValue\":\"DEADBEEF\"}}}";
+
+static int _test_conn_backend(const host_http_request_t *pstRequest, host_http_response_t *pstResponse)
+{
+  int s32Status;
+  const char *pcValue;
+
+  s32Status = (stBackend.u32Calls < stBackend.u32ScriptLength)?stBackend.ts32Script[stBackend.u32Calls]:200;
+  stBackend.u32Calls++;
+  if(HOST_HTTP_CONNECT_FAILED != s32Status)
+  {
+    stBackend.u32Received++;
+    stBackend.eMethod = pstRequest->eMethod;
+    snprintf(stBackend.tcUrl, sizeof(stBackend.tcUrl), "%s", pstRequest->pcUrl);
+    snprintf(stBackend.tcBody, sizeof(stBackend.tcBody), "%.*s", (int)pstRequest->u32BodyLength, pstRequest->pcBody);
+    pcValue = host_http_get_header(pstRequest, "Content-Type");
+    snprintf(stBackend.tcContentType, sizeof(stBackend.tcContentType), "%s", pcValue?pcValue:"");
+    host_time_advance_us(((pstRequest->bConnect?TEST_CONN_HANDSHAKE_MS:0) + TEST_CONN_REQUEST_MS) * 1000LL);
+  }
+  pstResponse->pcBody = "{\"name\":\"ok\"}";
+  pstResponse->u32BodyLength = strlen(pstResponse->pcBody);
+  return s32Status;
+}
+
+static void _test_conn_data(const char *pcData, uint32_t u32Length, void *pvArg)
+{
+  strncat((char *)pvArg, pcData, u32Length);
+}
+
+static void _test_conn_script(const int *ps32Script, uint32_t u32Length)
+{
+  memset(&stBackend, 0x00, sizeof(stBackend));
+  memcpy(stBackend.ts32Script, ps32Script, u32Length * sizeof(int));
+  stBackend.u32ScriptLength = u32Length;
+}
+
+static esp_err_t _test_conn_send(esp_http_client_method_t eMethod, const char *pcPath, int *ps32HttpCode)
+{
+  return app_conn_request(eMethod, pcPath, tcDocument, strlen(tcDocument), NULL, NULL, ps32HttpCode);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* The path goes under the database root with the API key, the body and the
+   response go through untouched */
+static void test_conn_request(void)
+{
+  int s32HttpCode;
+  app_conn_stats_t stStats;
+
+  host_time_set_manual(1000000);
+  host_http_set_handler(_test_conn_backend);
+  _test_conn_script(NULL, 0);
+  TEST_ASSERT_EQUAL(ESP_OK, app_conn_init());
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_conn_init());
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_conn_request(HTTP_METHOD_GET, NULL, NULL, 0, NULL, NULL, &s32HttpCode));
+  TEST_ASSERT_EQUAL(ESP_OK,
+                    app_conn_request(HTTP_METHOD_PATCH,
+                                     "/devices/node-1",
+                                     tcDocument,
+                                     strlen(tcDocument),
+                                     _test_conn_data,
+                                     stBackend.tcData,
+                                     &s32HttpCode));
+  TEST_ASSERT_EQUAL(200, s32HttpCode);
+  TEST_ASSERT_EQUAL(HTTP_METHOD_PATCH, stBackend.eMethod);
+  TEST_ASSERT_EQUAL_STRING(TEST_CONN_URL "/devices/node-1?key=test", stBackend.tcUrl);
+  TEST_ASSERT_EQUAL_STRING(tcDocument, stBackend.tcBody);
+  TEST_ASSERT_EQUAL_STRING("application/json", stBackend.tcContentType);
+  TEST_ASSERT_EQUAL_STRING("{\"name\":\"ok\"}", stBackend.tcData);
+  app_conn_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Requests);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Handshakes);
+  TEST_ASSERT_EQUAL_UINT32(TEST_CONN_HANDSHAKE_MS + TEST_CONN_REQUEST_MS, stStats.u32LastLatencyMs);
+}
+
+/* Documents a second apart share one connection. Once the connection idled
+   out every document pays for a handshake again */
+static void test_conn_keep_alive(void)
+{
+  int s32HttpCode;
+  uint32_t u32Run;
+  uint32_t u32Index;
+  uint64_t u64LatencyMs;
+  char tcLine[128];
+  app_conn_stats_t stBefore;
+  app_conn_stats_t stAfter;
+  static const uint32_t tu32GapsMs[2] = {TEST_CONN_KEEP_ALIVE_GAP_MS, TEST_CONN_IDLE_GAP_MS};
+
+  for(u32Run = 0; u32Run < 2; u32Run++)
+  {
+    app_conn_get_stats(&stBefore);
+    for(u32Index = 0; u32Index < TEST_CONN_DOCUMENTS; u32Index++)
+    {
+      host_time_advance_us(tu32GapsMs[u32Run] * 1000LL);
+      TEST_ASSERT_EQUAL(ESP_OK, _test_conn_send(HTTP_METHOD_PATCH, "/devices/node-1", &s32HttpCode));
+      TEST_ASSERT_EQUAL(200, s32HttpCode);
+    }
+    app_conn_get_stats(&stAfter);
+    u64LatencyMs = stAfter.u64TotalLatencyMs - stBefore.u64TotalLatencyMs;
+    TEST_ASSERT_EQUAL_UINT32(TEST_CONN_DOCUMENTS, stAfter.u32Requests - stBefore.u32Requests);
+    TEST_ASSERT_EQUAL_UINT32(u32Run?TEST_CONN_DOCUMENTS:0, stAfter.u32Handshakes - stBefore.u32Handshakes);
+    TEST_ASSERT_EQUAL_UINT32(u32Run?TEST_CONN_DOCUMENTS:0, stAfter.u32Reconnects - stBefore.u32Reconnects);
+    TEST_ASSERT_EQUAL_UINT64(TEST_CONN_DOCUMENTS * (TEST_CONN_REQUEST_MS + (u32Run?TEST_CONN_HANDSHAKE_MS:0)),
+                             u64LatencyMs);
+    snprintf(tcLine,
+             sizeof(tcLine),
+             "%u documents %5u ms apart: %3u handshakes, %3u ms per request",
+             TEST_CONN_DOCUMENTS,
+             tu32GapsMs[u32Run],
+             stAfter.u32Handshakes - stBefore.u32Handshakes,
+             (uint32_t)(u64LatencyMs / TEST_CONN_DOCUMENTS));
+    TEST_MESSAGE(tcLine);
+  }
+}
+
+/* A request that never left is sent again on a new connection. So is one that
+   got no answer, unless it is a POST: the server may have applied it */
+static void test_conn_retry(void)
+{
+  int s32HttpCode;
+  app_conn_stats_t stBefore;
+  app_conn_stats_t stAfter;
+  static const int ts32ConnectFailed[1] = {HOST_HTTP_CONNECT_FAILED};
+  static const int ts32ResponseLost[1] = {HOST_HTTP_RESPONSE_LOST};
+  static const int ts32BothFailed[2] = {HOST_HTTP_CONNECT_FAILED, HOST_HTTP_RESPONSE_LOST};
+
+  _test_conn_script(ts32ConnectFailed, 1);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_conn_send(HTTP_METHOD_POST, ":commit", &s32HttpCode));
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Calls);
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Received);
+  _test_conn_script(ts32ResponseLost, 1);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_conn_send(HTTP_METHOD_PATCH, "/devices/node-1", &s32HttpCode));
+  TEST_ASSERT_EQUAL(200, s32HttpCode);
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Received);
+  app_conn_get_stats(&stBefore);
+  _test_conn_script(ts32ResponseLost, 1);
+  TEST_ASSERT_EQUAL(ESP_FAIL, _test_conn_send(HTTP_METHOD_POST, ":commit", &s32HttpCode));
+  TEST_ASSERT_EQUAL(0, s32HttpCode);
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Received);
+  app_conn_get_stats(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(1, stAfter.u32Failures - stBefore.u32Failures);
+  /* The next request opens a new connection */
+  _test_conn_script(NULL, 0);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_conn_send(HTTP_METHOD_POST, ":commit", &s32HttpCode));
+  app_conn_get_stats(&stBefore);
+  TEST_ASSERT_EQUAL_UINT32(1, stBefore.u32Handshakes - stAfter.u32Handshakes);
+  _test_conn_script(ts32BothFailed, 2);
+  TEST_ASSERT_EQUAL(ESP_FAIL, _test_conn_send(HTTP_METHOD_GET, "/devices/node-1", &s32HttpCode));
+  TEST_ASSERT_EQUAL_UINT32(2, stBackend.u32Calls);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_conn_request);
+  RUN_TEST(test_conn_keep_alive);
+  RUN_TEST(test_conn_retry);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_system.h>
+
+#include "app_dedup.h"
+#include "host_shims.h"
+
+/* The RC522 reports a badge held on the reader 8 times a second */
+#define TEST_DEDUP_HOLD_OFF_MS                   3000
+#define TEST_DEDUP_HOLD_OFF_US                   (TEST_DEDUP_HOLD_OFF_MS * 1000LL)
+#define TEST_DEDUP_READ_PERIOD_US                125000LL
+#define TEST_DEDUP_TRACE_MAX_BADGES              200
+#define TEST_DEDUP_TRACE_PRESENTATIONS           2000
+
+static app_dedup_t stDedup;
+
+static void _test_dedup_tag(app_tag_t *pstTag, uint32_t u32Badge, uint8_t u08UidLength, int64_t s64CaptureUs)
+{
+  memset(pstTag, 0x00, sizeof(app_tag_t));
+  memset(pstTag->tu08Uid, 0xA5, u08UidLength);
+  memcpy(pstTag->tu08Uid, &u32Badge, sizeof(u32Badge));
+  pstTag->u08UidLength = u08UidLength;
+  pstTag->s64CaptureUs = s64CaptureUs;
+}
+
+/* A badge held for u32Reads reads, returns how many got through */
+static uint32_t _test_dedup_hold(uint32_t u32Badge, int64_t s64StartUs, uint32_t u32Reads)
+{
+  uint32_t u32Index;
+  uint32_t u32Accepted;
+  app_tag_t stTag;
+
+  u32Accepted = 0;
+  for(u32Index = 0; u32Index < u32Reads; u32Index++)
+  {
+    _test_dedup_tag(&stTag, u32Badge, 4, s64StartUs + u32Index * TEST_DEDUP_READ_PERIOD_US);
+    u32Accepted += app_dedup_accept(&stDedup, &stTag)?1:0;
+  }
+  return u32Accepted;
+}
+
+void setUp(void)
+{
+  app_dedup_init(&stDedup, TEST_DEDUP_HOLD_OFF_MS);
+}
+
+void tearDown(void)
+{
+}
+
+/* 10 s on the reader is 80 reads and a single upload */
+static void test_dedup_held_badge(void)
+{
+  char tcLine[96];
+  app_dedup_stats_t stStats;
+
+  TEST_ASSERT_EQUAL_UINT32(1, _test_dedup_hold(1, 1000000, 80));
+  app_dedup_get_stats(&stDedup, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Accepted);
+  TEST_ASSERT_EQUAL_UINT32(79, stStats.u32Suppressed);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Evicted);
+  snprintf(tcLine, sizeof(tcLine), "badge held 10 s: 80 reads, %u upload", stStats.u32Accepted);
+  TEST_MESSAGE(tcLine);
+}
+
+/* The window slides with every read: the badge is uploaded again once it was
+   away for the whole hold-off, not while it is still held */
+static void test_dedup_window(void)
+{
+  int64_t s64LastUs;
+  app_tag_t stTag;
+
+  TEST_ASSERT_EQUAL_UINT32(1, _test_dedup_hold(1, 1000, 40));
+  s64LastUs = 1000 + 39 * TEST_DEDUP_READ_PERIOD_US;
+  _test_dedup_tag(&stTag, 1, 4, s64LastUs + TEST_DEDUP_HOLD_OFF_US - 1);
+  TEST_ASSERT_FALSE(app_dedup_accept(&stDedup, &stTag));
+  s64LastUs = stTag.s64CaptureUs;
+  _test_dedup_tag(&stTag, 1, 4, s64LastUs + TEST_DEDUP_HOLD_OFF_US);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  /* Without a hold-off every read goes through */
+  app_dedup_init(&stDedup, 0);
+  TEST_ASSERT_EQUAL_UINT32(80, _test_dedup_hold(1, 1000, 80));
+}
+
+/* A double size UID starting with the bytes of a single size one is another
+   badge */
+static void test_dedup_uid_lengths(void)
+{
+  app_tag_t stTag;
+
+  _test_dedup_tag(&stTag, 7, 4, 1000);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, 7, 7, 1000);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, 7, 10, 1000);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, 7, 7, 2000);
+  TEST_ASSERT_FALSE(app_dedup_accept(&stDedup, &stTag));
+}
+
+/* A new UID takes the least recently seen entry, an entry replaced inside its
+   hold-off counts as an eviction and that badge is uploaded again */
+static void test_dedup_eviction(void)
+{
+  uint32_t u32Badge;
+  app_tag_t stTag;
+  app_dedup_stats_t stStats;
+
+  for(u32Badge = 0; u32Badge < APP_DEDUP_ENTRIES; u32Badge++)
+  {
+    _test_dedup_tag(&stTag, u32Badge, 4, 1000 + u32Badge);
+    TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  }
+  /* Badge 0 seen again so badge 1 is now the oldest */
+  _test_dedup_tag(&stTag, 0, 4, 2000);
+  TEST_ASSERT_FALSE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, APP_DEDUP_ENTRIES, 4, 3000);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, 0, 4, 4000);
+  TEST_ASSERT_FALSE(app_dedup_accept(&stDedup, &stTag));
+  _test_dedup_tag(&stTag, 1, 4, 5000);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  app_dedup_get_stats(&stDedup, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Evicted);
+  TEST_ASSERT_EQUAL_UINT32(APP_DEDUP_ENTRIES + 2, stStats.u32Accepted);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Suppressed);
+  /* Past the hold-off replacing an entry costs nothing */
+  _test_dedup_tag(&stTag, APP_DEDUP_ENTRIES + 1, 4, 5000 + TEST_DEDUP_HOLD_OFF_US);
+  TEST_ASSERT_TRUE(app_dedup_accept(&stDedup, &stTag));
+  app_dedup_get_stats(&stDedup, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Evicted);
+}
+
+/* Badges presented in turn, each held for 1 to u32MaxReads reads with u32MinGapMs to
+   u32MaxGapMs between presentations. The uploads are checked against a cache
+   without any size limit, an eviction may cost one more */
+static void _test_dedup_trace(const char *pcName,
+                              uint32_t u32Badges,
+                              uint32_t u32MaxReads,
+                              uint32_t u32MinGapMs,
+                              uint32_t u32MaxGapMs,
+                              bool bEvictions)
+{
+  int64_t s64NowUs;
+  uint32_t u32Badge;
+  uint32_t u32Reads;
+  uint32_t u32Index;
+  uint32_t u32Uploads;
+  uint32_t u32Expected;
+  char tcLine[128];
+  app_dedup_stats_t stStats;
+  int64_t ts64LastUs[TEST_DEDUP_TRACE_MAX_BADGES];
+
+  u32Uploads = 0;
+  u32Expected = 0;
+  s64NowUs = 0;
+  memset(ts64LastUs, 0x00, sizeof(ts64LastUs));
+  for(u32Index = 0; u32Index < TEST_DEDUP_TRACE_PRESENTATIONS; u32Index++)
+  {
+    u32Badge = esp_random() % u32Badges;
+    u32Reads = 1 + esp_random() % u32MaxReads;
+    s64NowUs += (u32MinGapMs + esp_random() % (u32MaxGapMs - u32MinGapMs)) * 1000LL;
+    if(!ts64LastUs[u32Badge] || ((s64NowUs - ts64LastUs[u32Badge]) >= TEST_DEDUP_HOLD_OFF_US))
+    {
+      u32Expected++;
+    }
+    u32Uploads += _test_dedup_hold(u32Badge + 1, s64NowUs, u32Reads);
+    s64NowUs += (u32Reads - 1) * TEST_DEDUP_READ_PERIOD_US;
+    ts64LastUs[u32Badge] = s64NowUs;
+  }
+  app_dedup_get_stats(&stDedup, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(u32Uploads, stStats.u32Accepted);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(u32Expected, u32Uploads);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(u32Expected + stStats.u32Evicted, u32Uploads);
+  TEST_ASSERT_EQUAL(bEvictions, stStats.u32Evicted > 0);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-6s %6u reads, %4u uploads (%2u%% fewer), %3u evictions",
+           pcName,
+           stStats.u32Accepted + stStats.u32Suppressed,
+           u32Uploads,
+           (100 * stStats.u32Suppressed) / (stStats.u32Accepted + stStats.u32Suppressed),
+           stStats.u32Evicted);
+  TEST_MESSAGE(tcLine);
+}
+
+/* A shift at the turnstile: 40 badges held from one read up to 10 s, 0.5 to
+   20 s apart */
+static void test_dedup_shift_trace(void)
+{
+  _test_dedup_trace("shift", 40, 80, 500, 20000, false);
+}
+
+/* A rush on a bank of readers: 200 badges tapped in passing, 7 to 20 a
+   second, more of them within the hold-off than the cache has entries */
+static void test_dedup_rush_trace(void)
+{
+  _test_dedup_trace("rush", TEST_DEDUP_TRACE_MAX_BADGES, 2, 50, 150, true);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_dedup_held_badge);
+  RUN_TEST(test_dedup_window);
+  RUN_TEST(test_dedup_uid_lengths);
+  RUN_TEST(test_dedup_eviction);
+  RUN_TEST(test_dedup_shift_trace);
+  RUN_TEST(test_dedup_rush_trace);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+
+#include "app_doc.h"
+#include "app_json.h"
+#include "host_shims.h"
+
+#define TEST_DOC_BUFFER_SIZE                     512
+#define TEST_DOC_VALUES_MAX                      16
+#define TEST_DOC_BENCH_DOCUMENTS                 200000
+
+typedef struct
+{
+  char tcField[APP_JSON_KEY_MAX_SIZE];
+  char tcType[APP_JSON_KEY_MAX_SIZE];
+  char tcValue[64];
+}doc_value_t;
+
+/* Values of a fields document read back with the JSON scanner */
+typedef struct
+{
+  uint32_t u32Count;
+  doc_value_t tstValues[TEST_DOC_VALUES_MAX];
+}doc_parsed_t;
+
+typedef struct
+{
+  uint32_t u32Length;
+  uint32_t u32Writes;
+  char tcBody[TEST_DOC_BUFFER_SIZE];
+}doc_stream_t;
+
+typedef struct
+{
+  uint8_t tu08Uid[5];
+  int64_t s64Timestamp;
+}doc_scan_t;
+
+static void _test_doc_parsed_cb(const app_json_t *pstJson, app_json_type_t eType, const char *pcValue, uint32_t u32Length, void *pvArg)
+{
+  doc_value_t *pstValue;
+  doc_parsed_t *pstParsed;
+
+  pstParsed = (doc_parsed_t *)pvArg;
+  if((eType < APP_JSON_OBJECT_START) && (3 == app_json_get_depth(pstJson)) && (pstParsed->u32Count < TEST_DOC_VALUES_MAX))
+  {
+    pstValue = &pstParsed->tstValues[pstParsed->u32Count++];
+    snprintf(pstValue->tcField, sizeof(pstValue->tcField), "%s", app_json_get_key(pstJson, 1));
+    snprintf(pstValue->tcType, sizeof(pstValue->tcType), "%s", app_json_get_key(pstJson, 2));
+    snprintf(pstValue->tcValue, sizeof(pstValue->tcValue), "%.*s", (int)u32Length, pcValue);
+  }
+}
+
+static void _test_doc_parse(const char *pcBody, uint32_t u32Length, doc_parsed_t *pstParsed)
+{
+  char tcValue[64];
+  app_json_t stJson;
+
+  memset(pstParsed, 0x00, sizeof(doc_parsed_t));
+  app_json_init(&stJson, tcValue, sizeof(tcValue), _test_doc_parsed_cb, pstParsed);
+  TEST_ASSERT_EQUAL(ESP_OK, app_json_feed(&stJson, pcBody, u32Length));
+  TEST_ASSERT_TRUE(app_json_is_done(&stJson));
+}
+
+static void _test_doc_expect(const doc_parsed_t *pstParsed, uint32_t u32Index, const char *pcField, const char *pcType, const char *pcValue)
+{
+  TEST_ASSERT_LESS_THAN_UINT32(pstParsed->u32Count, u32Index);
+  TEST_ASSERT_EQUAL_STRING(pcField, pstParsed->tstValues[u32Index].tcField);
+  TEST_ASSERT_EQUAL_STRING(pcType, pstParsed->tstValues[u32Index].tcType);
+  TEST_ASSERT_EQUAL_STRING(pcValue, pstParsed->tstValues[u32Index].tcValue);
+}
+
+static esp_err_t _test_doc_stream_cb(const char *pcData, uint32_t u32Length, void *pvArg)
+{
+  doc_stream_t *pstStream;
+
+  pstStream = (doc_stream_t *)pvArg;
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(sizeof(pstStream->tcBody), pstStream->u32Length + u32Length);
+  memcpy(&pstStream->tcBody[pstStream->u32Length], pcData, u32Length);
+  pstStream->u32Length += u32Length;
+  pstStream->u32Writes++;
+  return ESP_OK;
+}
+
+static void _test_doc_all_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  const uint8_t tu08Uid[] = {0x04, 0x0A, 0x00, 0xF0, 0x01};
+  const uint8_t tu08Bytes[] = {0xFB, 0xFF, 0x00, 0x41};
+
+  app_doc_add_string(pstDoc, "text", "say \"hi\"\\\n\x01");
+  app_doc_add_hex(pstDoc, "sn", tu08Uid, sizeof(tu08Uid));
+  app_doc_add_integer(pstDoc, "zero", 0);
+  app_doc_add_integer(pstDoc, "negative", -42);
+  app_doc_add_integer(pstDoc, "large", 1700000000123LL);
+  app_doc_add_integer(pstDoc, "max", INT64_MAX);
+  app_doc_add_integer(pstDoc, "min", INT64_MIN);
+  app_doc_add_boolean(pstDoc, "on", true);
+  app_doc_add_boolean(pstDoc, "off", false);
+  app_doc_add_bytes(pstDoc, "one", tu08Bytes, 1);
+  app_doc_add_bytes(pstDoc, "two", tu08Bytes, 2);
+  app_doc_add_bytes(pstDoc, "four", tu08Bytes, 4);
+}
+
+static void _test_doc_scan_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  const doc_scan_t *pstScan;
+
+  pstScan = (const doc_scan_t *)pvArg;
+  app_doc_add_hex(pstDoc, "sn", pstScan->tu08Uid, sizeof(pstScan->tu08Uid));
+  app_doc_add_integer(pstDoc, "timestamp", pstScan->s64Timestamp);
+}
+
+static uint32_t _test_doc_serialize(char *pcBuffer, uint32_t u32Size, app_doc_fields_cb_t pfFields, const void *pvArg)
+{
+  uint32_t u32Length;
+  app_doc_t stDoc;
+
+  app_doc_init(&stDoc, pcBuffer, u32Size, NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, pfFields, pvArg);
+  app_doc_end_object(&stDoc);
+  TEST_ASSERT_EQUAL(ESP_OK, app_doc_finish(&stDoc, &u32Length));
+  return u32Length;
+}
+
+/* The former snprintf path of app_main.c, with %02X so that both agree */
+static uint32_t _test_doc_snprintf(char *pcBuffer, uint32_t u32Size, const doc_scan_t *pstScan)
+{
+  return snprintf(pcBuffer,
+                  u32Size,
+                  "{\"fields\":{\"sn\":{\"stringValue\":\"%02X%02X%02X%02X%02X\"},\"timestamp\":{\"integerValue\":%lld}}}",
+                  pstScan->tu08Uid[0],
+                  pstScan->tu08Uid[1],
+                  pstScan->tu08Uid[2],
+                  pstScan->tu08Uid[3],
+                  pstScan->tu08Uid[4],
+                  (long long)pstScan->s64Timestamp);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Every value type is read back as written */
+static void test_doc_round_trip(void)
+{
+  uint32_t u32Length;
+  doc_parsed_t stParsed;
+  char tcBuffer[TEST_DOC_BUFFER_SIZE];
+
+  u32Length = _test_doc_serialize(tcBuffer, sizeof(tcBuffer), _test_doc_all_fields, NULL);
+  _test_doc_parse(tcBuffer, u32Length, &stParsed);
+  TEST_ASSERT_EQUAL_UINT32(12, stParsed.u32Count);
+  _test_doc_expect(&stParsed, 0, "text", "stringValue", "say \"hi\"\\\n\x01");
+  _test_doc_expect(&stParsed, 1, "sn", "stringValue", "040A00F001");
+  _test_doc_expect(&stParsed, 2, "zero", "integerValue", "0");
+  _test_doc_expect(&stParsed, 3, "negative", "integerValue", "-42");
+  _test_doc_expect(&stParsed, 4, "large", "integerValue", "1700000000123");
+  _test_doc_expect(&stParsed, 5, "max", "integerValue", "9223372036854775807");
+  _test_doc_expect(&stParsed, 6, "min", "integerValue", "-9223372036854775808");
+  _test_doc_expect(&stParsed, 7, "on", "booleanValue", "true");
+  _test_doc_expect(&stParsed, 8, "off", "booleanValue", "false");
+  _test_doc_expect(&stParsed, 9, "one", "bytesValue", "+w==");
+  _test_doc_expect(&stParsed, 10, "two", "bytesValue", "+/8=");
+  _test_doc_expect(&stParsed, 11, "four", "bytesValue", "+/8AQQ==");
+}
+
+/* UIDs that %X printed the same way get an sn of their own */
+static void test_doc_hex_keeps_leading_zeros(void)
+{
+  doc_scan_t stFirst = {{0x01, 0x23, 0x04, 0x05, 0x06}, 0};
+  doc_scan_t stSecond = {{0x12, 0x03, 0x04, 0x05, 0x06}, 0};
+  char tcFirst[TEST_DOC_BUFFER_SIZE];
+  char tcSecond[TEST_DOC_BUFFER_SIZE];
+
+  _test_doc_serialize(tcFirst, sizeof(tcFirst), _test_doc_scan_fields, &stFirst);
+  _test_doc_serialize(tcSecond, sizeof(tcSecond), _test_doc_scan_fields, &stSecond);
+  TEST_ASSERT_NOT_EQUAL(0, strcmp(tcFirst, tcSecond));
+}
+
+/* A buffer smaller than the document hands it to the stream in pieces */
+static void test_doc_stream(void)
+{
+  uint32_t u32Length;
+  uint32_t u32StreamLength;
+  char tcSmall[7];
+  char tcBuffer[TEST_DOC_BUFFER_SIZE];
+  app_doc_t stDoc;
+  doc_stream_t stStream;
+
+  u32Length = _test_doc_serialize(tcBuffer, sizeof(tcBuffer), _test_doc_all_fields, NULL);
+  memset(&stStream, 0x00, sizeof(stStream));
+  app_doc_init(&stDoc, tcSmall, sizeof(tcSmall), _test_doc_stream_cb, &stStream);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, _test_doc_all_fields, NULL);
+  app_doc_end_object(&stDoc);
+  TEST_ASSERT_EQUAL(ESP_OK, app_doc_finish(&stDoc, &u32StreamLength));
+  TEST_ASSERT_EQUAL_UINT32(u32Length, u32StreamLength);
+  TEST_ASSERT_EQUAL_UINT32(u32Length, stStream.u32Length);
+  TEST_ASSERT_EQUAL_MEMORY(tcBuffer, stStream.tcBody, u32Length);
+  TEST_ASSERT_GREATER_THAN_UINT32(u32Length / sizeof(tcSmall), stStream.u32Writes);
+}
+
+static void test_doc_errors(void)
+{
+  uint32_t u32Length;
+  uint32_t u32Depth;
+  char tcSmall[16];
+  app_doc_t stDoc;
+
+  /* Too big without a stream */
+  app_doc_init(&stDoc, tcSmall, sizeof(tcSmall), NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  app_doc_add_fields(&stDoc, _test_doc_all_fields, NULL);
+  app_doc_end_object(&stDoc);
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_doc_finish(&stDoc, &u32Length));
+  TEST_ASSERT_EQUAL_UINT32(0, u32Length);
+  /* Left open */
+  app_doc_init(&stDoc, tcSmall, sizeof(tcSmall), NULL, NULL);
+  app_doc_begin_object(&stDoc, NULL);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_doc_finish(&stDoc, NULL));
+  /* Closed once too often */
+  app_doc_init(&stDoc, tcSmall, sizeof(tcSmall), NULL, NULL);
+  app_doc_end_object(&stDoc);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_doc_finish(&stDoc, NULL));
+  /* Nested too deep */
+  app_doc_init(&stDoc, tcSmall, sizeof(tcSmall), NULL, NULL);
+  for(u32Depth = 0; u32Depth <= APP_DOC_MAX_DEPTH; u32Depth++)
+  {
+    app_doc_begin_array(&stDoc, NULL);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_doc_finish(&stDoc, NULL));
+  app_doc_init(&stDoc, NULL, 0, NULL, NULL);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_doc_finish(&stDoc, NULL));
+}
+
+/* The scan document of app_pipeline.c through both paths, same bytes out */
+static void test_doc_bench_against_snprintf(void)
+{
+  uint32_t u32Index;
+  uint32_t u32Length;
+  int64_t s64StartUs;
+  int64_t s64DocUs;
+  int64_t s64SnprintfUs;
+  doc_scan_t stScan = {{0x72, 0xEA, 0x5F, 0x06, 0xC1}, 1700000000123LL};
+  char tcDoc[TEST_DOC_BUFFER_SIZE];
+  char tcSnprintf[TEST_DOC_BUFFER_SIZE];
+  char tcLine[128];
+
+  u32Length = _test_doc_serialize(tcDoc, sizeof(tcDoc), _test_doc_scan_fields, &stScan);
+  TEST_ASSERT_EQUAL_UINT32(u32Length, _test_doc_snprintf(tcSnprintf, sizeof(tcSnprintf), &stScan));
+  TEST_ASSERT_EQUAL_MEMORY(tcSnprintf, tcDoc, u32Length);
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < TEST_DOC_BENCH_DOCUMENTS; u32Index++)
+  {
+    stScan.s64Timestamp++;
+    _test_doc_serialize(tcDoc, sizeof(tcDoc), _test_doc_scan_fields, &stScan);
+  }
+  s64DocUs = esp_timer_get_time() - s64StartUs;
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < TEST_DOC_BENCH_DOCUMENTS; u32Index++)
+  {
+    stScan.s64Timestamp++;
+    _test_doc_snprintf(tcSnprintf, sizeof(tcSnprintf), &stScan);
+  }
+  s64SnprintfUs = esp_timer_get_time() - s64StartUs;
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "scan document: app_doc %lld ns, snprintf %lld ns",
+           (s64DocUs * 1000LL) / TEST_DOC_BENCH_DOCUMENTS,
+           (s64SnprintfUs * 1000LL) / TEST_DOC_BENCH_DOCUMENTS);
+  TEST_MESSAGE(tcLine);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_doc_round_trip);
+  RUN_TEST(test_doc_hex_keeps_leading_zeros);
+  RUN_TEST(test_doc_stream);
+  RUN_TEST(test_doc_errors);
+  RUN_TEST(test_doc_bench_against_snprintf);
+  return UNITY_END();
+}
\ No newline at end of file
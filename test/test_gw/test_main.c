@@ -0,0 +1,497 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+
+#include "app_gw.h"
+#include "app_batch.h"
+#include "host_shims.h"
+
+/* app_gw talks to a stand-in gateway on APP_GW_PORT of the loopback, then
+   to tools/rfid_gateway.py when python3 is around */
+#define TEST_GW_PORT                             APP_GW_PORT
+#define TEST_GW_HELLO_SIZE                       11
+#define TEST_GW_RECORD_SIZE                      20
+#define TEST_GW_MAX_RECORDS                      64
+#define TEST_GW_BENCH_SCANS                      4096
+#define TEST_GW_LINE_MAX_SIZE                    1024
+
+typedef enum
+{
+  TEST_GW_ANSWER_OK = 0,
+  TEST_GW_ANSWER_FAILED,
+  TEST_GW_ANSWER_WRONG_SEQUENCE,
+  TEST_GW_ANSWER_CLOSE,
+}gw_answer_t;
+
+typedef struct
+{
+  int64_t s64TimestampMs;
+  uint8_t u08ReaderId;
+  uint8_t u08UidLength;
+  uint8_t tu08Uid[APP_GW_UID_MAX_SIZE];
+}gw_record_t;
+
+/* What the stand-in gateway got, under stLock */
+typedef struct
+{
+  pthread_mutex_t stLock;
+  pthread_t stThread;
+  int s32Listener;
+  gw_answer_t eAnswer;
+  uint32_t u32Connections;
+  uint32_t u32Frames;
+  uint32_t u32Records;
+  uint16_t u16LastSequence;
+  uint8_t tu08Hello[TEST_GW_HELLO_SIZE];
+  gw_record_t tstRecords[TEST_GW_MAX_RECORDS];
+}gw_server_t;
+
+typedef struct
+{
+  uint32_t u32Scans;
+  uint32_t u32Bytes;
+  int64_t s64CpuNs;
+  int64_t s64ElapsedUs;
+}gw_report_t;
+
+typedef struct
+{
+  uint8_t u08ReaderId;
+  uint8_t tu08Uid[4];
+  int64_t s64TimestampMs;
+}gw_scan_t;
+
+static gw_server_t stServer =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+  .s32Listener = -1,
+};
+static uint32_t u32RestBytes;
+
+static bool _test_gw_read(int s32Socket, uint8_t *pu08Data, uint32_t u32Length)
+{
+  int s32Received;
+
+  s32Received = 1;
+  while(u32Length && (s32Received > 0))
+  {
+    s32Received = recv(s32Socket, pu08Data, u32Length, 0);
+    pu08Data += (s32Received > 0)?s32Received:0;
+    u32Length -= (s32Received > 0)?s32Received:0;
+  }
+  return 0 == u32Length;
+}
+
+/* One node connection: the hello, then scans frames answered as asked */
+static void _test_gw_serve(int s32Socket)
+{
+  bool bOpen;
+  uint32_t u32Index;
+  uint16_t u16Sequence;
+  gw_answer_t eAnswer;
+  gw_record_t *pstRecord;
+  uint8_t tu08Header[4];
+  uint8_t tu08Ack[5];
+  uint8_t tu08Record[TEST_GW_RECORD_SIZE];
+  uint8_t tu08Hello[TEST_GW_HELLO_SIZE - 4];
+
+  bOpen = _test_gw_read(s32Socket, tu08Header, sizeof(tu08Header)) &&
+          (0x01 == tu08Header[0]) &&
+          _test_gw_read(s32Socket, tu08Hello, sizeof(tu08Hello));
+  pthread_mutex_lock(&stServer.stLock);
+  stServer.u32Connections++;
+  memcpy(stServer.tu08Hello, tu08Header, sizeof(tu08Header));
+  memcpy(&stServer.tu08Hello[sizeof(tu08Header)], tu08Hello, sizeof(tu08Hello));
+  pthread_mutex_unlock(&stServer.stLock);
+  while(bOpen && _test_gw_read(s32Socket, tu08Header, sizeof(tu08Header)) && (0x02 == tu08Header[0]))
+  {
+    u16Sequence = tu08Header[2] | (tu08Header[3] << 8);
+    for(u32Index = 0; bOpen && (u32Index < tu08Header[1]); u32Index++)
+    {
+      bOpen = _test_gw_read(s32Socket, tu08Record, sizeof(tu08Record));
+      pthread_mutex_lock(&stServer.stLock);
+      if(bOpen && (stServer.u32Records < TEST_GW_MAX_RECORDS))
+      {
+        pstRecord = &stServer.tstRecords[stServer.u32Records++];
+        memcpy(&pstRecord->s64TimestampMs, tu08Record, sizeof(pstRecord->s64TimestampMs));
+        pstRecord->u08ReaderId = tu08Record[8];
+        pstRecord->u08UidLength = tu08Record[9];
+        memcpy(pstRecord->tu08Uid, &tu08Record[10], APP_GW_UID_MAX_SIZE);
+      }
+      pthread_mutex_unlock(&stServer.stLock);
+    }
+    pthread_mutex_lock(&stServer.stLock);
+    stServer.u32Frames++;
+    stServer.u16LastSequence = u16Sequence;
+    eAnswer = stServer.eAnswer;
+    pthread_mutex_unlock(&stServer.stLock);
+    tu08Ack[0] = 0x82;
+    tu08Ack[1] = 0;
+    tu08Ack[2] = (uint8_t)(u16Sequence + ((TEST_GW_ANSWER_WRONG_SEQUENCE == eAnswer)?1:0));
+    tu08Ack[3] = (uint8_t)(u16Sequence >> 8);
+    tu08Ack[4] = (TEST_GW_ANSWER_FAILED == eAnswer)?1:0;
+    bOpen = bOpen && (TEST_GW_ANSWER_CLOSE != eAnswer) && (sizeof(tu08Ack) == send(s32Socket, tu08Ack, sizeof(tu08Ack), 0));
+  }
+  close(s32Socket);
+}
+
+/* Serves one connection at a time until the listener is shut down */
+static void *_test_gw_server_thread(void *pvArg)
+{
+  int s32Socket;
+  int s32Enable;
+
+  s32Socket = 0;
+  while(s32Socket >= 0)
+  {
+    s32Socket = accept(stServer.s32Listener, NULL, NULL);
+    if(s32Socket >= 0)
+    {
+      s32Enable = 1;
+      setsockopt(s32Socket, IPPROTO_TCP, TCP_NODELAY, &s32Enable, sizeof(s32Enable));
+      _test_gw_serve(s32Socket);
+    }
+  }
+  return NULL;
+}
+
+static void _test_gw_server_start(void)
+{
+  int s32Enable;
+  struct sockaddr_in stAddress =
+  {
+    .sin_family = AF_INET,
+    .sin_port = htons(TEST_GW_PORT),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+
+  s32Enable = 1;
+  stServer.s32Listener = socket(AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT(0, stServer.s32Listener);
+  setsockopt(stServer.s32Listener, SOL_SOCKET, SO_REUSEADDR, &s32Enable, sizeof(s32Enable));
+  TEST_ASSERT_EQUAL_INT(0, bind(stServer.s32Listener, (struct sockaddr *)&stAddress, sizeof(stAddress)));
+  TEST_ASSERT_EQUAL_INT(0, listen(stServer.s32Listener, 1));
+  TEST_ASSERT_EQUAL_INT(0, pthread_create(&stServer.stThread, NULL, _test_gw_server_thread, NULL));
+}
+
+static void _test_gw_set_answer(gw_answer_t eAnswer)
+{
+  pthread_mutex_lock(&stServer.stLock);
+  stServer.eAnswer = eAnswer;
+  stServer.u32Records = 0;
+  pthread_mutex_unlock(&stServer.stLock);
+}
+
+static void _test_gw_add(uint8_t u08ReaderId, uint32_t u32Uid, int64_t s64TimestampMs)
+{
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_add(u08ReaderId, (const uint8_t *)&u32Uid, sizeof(u32Uid), s64TimestampMs));
+}
+
+/* The node connection ends with a frame the gateway doesn't answer */
+static void _test_gw_server_stop(void)
+{
+  _test_gw_set_answer(TEST_GW_ANSWER_CLOSE);
+  _test_gw_add(0, 1, 1);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_gw_commit());
+  shutdown(stServer.s32Listener, SHUT_RDWR);
+  pthread_join(stServer.stThread, NULL);
+  close(stServer.s32Listener);
+  stServer.s32Listener = -1;
+}
+
+static int _test_gw_rest_backend(esp_http_client_method_t eMethod,
+                                 const char *pcPath,
+                                 const char *pcBody,
+                                 uint32_t u32BodyLength,
+                                 app_conn_data_cb_t pfDataCb,
+                                 void *pvArg)
+{
+  u32RestBytes += u32BodyLength;
+  return 200;
+}
+
+/* Same fields as the scan documents of app_pipeline.c */
+static void _test_gw_scan_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  const gw_scan_t *pstScan;
+
+  pstScan = pvArg;
+  app_doc_add_hex(pstDoc, "sn", pstScan->tu08Uid, sizeof(pstScan->tu08Uid));
+  app_doc_add_integer(pstDoc, "reader", pstScan->u08ReaderId);
+  app_doc_add_integer(pstDoc, "timestamp", pstScan->s64TimestampMs);
+}
+
+static int64_t _test_gw_cpu_ns(void)
+{
+  struct timespec stTime;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stTime);
+  return stTime.tv_sec * 1000000000LL + stTime.tv_nsec;
+}
+
+/* The same scans in full batches over either path, the CPU time is the one of
+   the calling task: serializing and the socket calls, not TLS or HTTP */
+static void _test_gw_bench(bool bGateway, gw_report_t *pstReport)
+{
+  uint32_t u32Scan;
+  int64_t s64StartCpuNs;
+  int64_t s64StartUs;
+  gw_scan_t stScan;
+  app_gw_stats_t stBefore;
+  app_gw_stats_t stAfter;
+
+  u32RestBytes = 0;
+  app_gw_get_stats(&stBefore);
+  s64StartUs = esp_timer_get_time();
+  s64StartCpuNs = _test_gw_cpu_ns();
+  for(u32Scan = 0; u32Scan < TEST_GW_BENCH_SCANS; u32Scan++)
+  {
+    stScan.u08ReaderId = u32Scan % 4;
+    memcpy(stScan.tu08Uid, &u32Scan, sizeof(stScan.tu08Uid));
+    stScan.s64TimestampMs = 1700000000000LL + u32Scan * 50;
+    if(bGateway)
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, app_gw_add(stScan.u08ReaderId, stScan.tu08Uid, sizeof(stScan.tu08Uid), stScan.s64TimestampMs));
+    }
+    else
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, app_batch_add("devices/rfid-node", _test_gw_scan_fields, &stScan));
+    }
+    if(0 == ((u32Scan + 1) % APP_GW_MAX_RECORDS))
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, bGateway?app_gw_commit():app_batch_commit());
+    }
+  }
+  pstReport->s64CpuNs = _test_gw_cpu_ns() - s64StartCpuNs;
+  pstReport->s64ElapsedUs = esp_timer_get_time() - s64StartUs;
+  app_gw_get_stats(&stAfter);
+  pstReport->u32Scans = TEST_GW_BENCH_SCANS;
+  pstReport->u32Bytes = bGateway?(stAfter.u32BytesSent - stBefore.u32BytesSent):u32RestBytes;
+}
+
+static void _test_gw_print(const char *pcName, const gw_report_t *pstReport)
+{
+  char tcLine[128];
+
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-7s %3u bytes per scan, %5lld ns of CPU per scan, %7lld scans/s",
+           pcName,
+           pstReport->u32Bytes / pstReport->u32Scans,
+           (long long)(pstReport->s64CpuNs / pstReport->u32Scans),
+           (long long)((pstReport->u32Scans * 1000000LL) / (pstReport->s64ElapsedUs?pstReport->s64ElapsedUs:1)));
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_gw_invalid_args(void)
+{
+  uint8_t tu08Uid[APP_GW_UID_MAX_SIZE + 1];
+
+  memset(tu08Uid, 0x00, sizeof(tu08Uid));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_gw_add(0, NULL, 4, 0));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_gw_add(0, tu08Uid, sizeof(tu08Uid), 0));
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+}
+
+/* Nobody listening: the frame fails at once and is dropped */
+static void test_gw_absent(void)
+{
+  app_gw_stats_t stStats;
+
+  _test_gw_add(0, 0x01020304, 1);
+  TEST_ASSERT_NOT_EQUAL(ESP_OK, app_gw_commit());
+  app_gw_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Failures);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32BytesSent);
+}
+
+/* Hello with the MAC, then the records as packed and one connection for
+   every frame with a new sequence number each */
+static void test_gw_records(void)
+{
+  uint32_t u32Uid;
+  uint8_t tu08Long[APP_GW_UID_MAX_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  app_gw_stats_t stStats;
+  static const uint8_t tu08Hello[TEST_GW_HELLO_SIZE] = {0x01, 0, 0, 0, 1, 0x24, 0x0A, 0xC4, 0xA1, 0xB2, 0xC3};
+
+  _test_gw_server_start();
+  _test_gw_set_answer(TEST_GW_ANSWER_OK);
+  _test_gw_add(3, 0xC3B2A104, 1700000000123LL);
+  _test_gw_add(1, 0x01020304, 0);
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_add(2, tu08Long, sizeof(tu08Long), 42));
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+  pthread_mutex_lock(&stServer.stLock);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(tu08Hello, stServer.tu08Hello, sizeof(tu08Hello));
+  TEST_ASSERT_EQUAL_UINT32(3, stServer.u32Records);
+  TEST_ASSERT_EQUAL_INT64(1700000000123LL, stServer.tstRecords[0].s64TimestampMs);
+  TEST_ASSERT_EQUAL_UINT8(3, stServer.tstRecords[0].u08ReaderId);
+  TEST_ASSERT_EQUAL_UINT8(4, stServer.tstRecords[0].u08UidLength);
+  memcpy(&u32Uid, stServer.tstRecords[0].tu08Uid, sizeof(u32Uid));
+  TEST_ASSERT_EQUAL_HEX32(0xC3B2A104, u32Uid);
+  TEST_ASSERT_EACH_EQUAL_UINT8(0, &stServer.tstRecords[0].tu08Uid[4], APP_GW_UID_MAX_SIZE - 4);
+  TEST_ASSERT_EQUAL_INT64(0, stServer.tstRecords[1].s64TimestampMs);
+  TEST_ASSERT_EQUAL_UINT8(APP_GW_UID_MAX_SIZE, stServer.tstRecords[2].u08UidLength);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(tu08Long, stServer.tstRecords[2].tu08Uid, APP_GW_UID_MAX_SIZE);
+  TEST_ASSERT_EQUAL_UINT16(1, stServer.u16LastSequence);
+  pthread_mutex_unlock(&stServer.stLock);
+  _test_gw_add(0, 0x05060708, 1);
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+  pthread_mutex_lock(&stServer.stLock);
+  TEST_ASSERT_EQUAL_UINT16(2, stServer.u16LastSequence);
+  TEST_ASSERT_EQUAL_UINT32(1, stServer.u32Connections);
+  pthread_mutex_unlock(&stServer.stLock);
+  app_gw_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Frames);
+  TEST_ASSERT_EQUAL_UINT32(4, stStats.u32Records);
+  TEST_ASSERT_EQUAL_UINT32(TEST_GW_HELLO_SIZE + 2 * 4 + 4 * TEST_GW_RECORD_SIZE, stStats.u32BytesSent);
+}
+
+/* A full frame refuses scans until it is sent */
+static void test_gw_full(void)
+{
+  uint32_t u32Index;
+
+  _test_gw_set_answer(TEST_GW_ANSWER_OK);
+  for(u32Index = 0; u32Index < APP_GW_MAX_RECORDS; u32Index++)
+  {
+    _test_gw_add(0, u32Index, 1);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_gw_add(0, (const uint8_t *)&u32Index, 4, 1));
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+  pthread_mutex_lock(&stServer.stLock);
+  TEST_ASSERT_EQUAL_UINT32(APP_GW_MAX_RECORDS, stServer.u32Records);
+  pthread_mutex_unlock(&stServer.stLock);
+}
+
+/* A gateway that couldn't store keeps the connection, a wrong ack or a
+   closed connection drop it and the next frame connects again */
+static void test_gw_failures(void)
+{
+  app_gw_stats_t stBefore;
+  app_gw_stats_t stAfter;
+
+  app_gw_get_stats(&stBefore);
+  _test_gw_set_answer(TEST_GW_ANSWER_FAILED);
+  _test_gw_add(0, 1, 1);
+  TEST_ASSERT_EQUAL(ESP_FAIL, app_gw_commit());
+  _test_gw_set_answer(TEST_GW_ANSWER_WRONG_SEQUENCE);
+  _test_gw_add(0, 1, 1);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, app_gw_commit());
+  _test_gw_set_answer(TEST_GW_ANSWER_OK);
+  _test_gw_add(0, 1, 1);
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+  _test_gw_set_answer(TEST_GW_ANSWER_CLOSE);
+  _test_gw_add(0, 1, 1);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_gw_commit());
+  app_gw_get_stats(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(3, stAfter.u32Failures - stBefore.u32Failures);
+  TEST_ASSERT_EQUAL_UINT32(1, stAfter.u32Connects - stBefore.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(1, stAfter.u32Frames - stBefore.u32Frames);
+}
+
+/* Full batches of scans from the same node over the gateway and as REST
+   bodies. The REST bytes leave out the HTTP headers and TLS records, both
+   backends answer at once so the rates are what the node can put out */
+static void test_gw_bench_against_rest(void)
+{
+  gw_report_t stGateway;
+  gw_report_t stRest;
+
+  _test_gw_set_answer(TEST_GW_ANSWER_OK);
+  host_conn_set_handler(_test_gw_rest_backend);
+  _test_gw_bench(true, &stGateway);
+  _test_gw_bench(false, &stRest);
+  host_conn_set_handler(NULL);
+  _test_gw_server_stop();
+  _test_gw_print("gateway", &stGateway);
+  _test_gw_print("rest", &stRest);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_GW_RECORD_SIZE + 1, stGateway.u32Bytes / stGateway.u32Scans);
+  TEST_ASSERT_GREATER_THAN_UINT32(5 * (stGateway.u32Bytes / stGateway.u32Scans), stRest.u32Bytes / stRest.u32Scans);
+}
+
+/* The real gateway in dry run: the frame is acknowledged and logged as the
+   commit the node would have sent */
+static void test_gw_python_gateway(void)
+{
+  int s32Pipe[2];
+  int s32Status;
+  pid_t s32Pid;
+  FILE *pstOutput;
+  bool bListening;
+  bool bCommitted;
+  char tcPort[6];
+  char tcLine[TEST_GW_LINE_MAX_SIZE];
+
+  if(0 != system("python3 -c '' 2> /dev/null"))
+  {
+    TEST_IGNORE_MESSAGE("python3 not found");
+  }
+  snprintf(tcPort, sizeof(tcPort), "%d", TEST_GW_PORT);
+  TEST_ASSERT_EQUAL_INT(0, pipe(s32Pipe));
+  s32Pid = fork();
+  if(0 == s32Pid)
+  {
+    dup2(s32Pipe[1], STDERR_FILENO);
+    close(s32Pipe[0]);
+    execlp("python3", "python3", "tools/rfid_gateway.py", "--host", "127.0.0.1", "--port", tcPort,
+           "--model", "tag", "--dry-run", (char *)NULL);
+    _exit(127);
+  }
+  close(s32Pipe[1]);
+  pstOutput = fdopen(s32Pipe[0], "r");
+  bListening = false;
+  while(!bListening && fgets(tcLine, sizeof(tcLine), pstOutput))
+  {
+    bListening = (NULL != strstr(tcLine, "Listening on"));
+  }
+  TEST_ASSERT_TRUE(bListening);
+  _test_gw_add(2, 0xC3B2A104, 1700000000123LL);
+  _test_gw_add(1, 0xC3B2A104, 1700000000456LL);
+  TEST_ASSERT_EQUAL(ESP_OK, app_gw_commit());
+  bCommitted = false;
+  while(!bCommitted && fgets(tcLine, sizeof(tcLine), pstOutput))
+  {
+    bCommitted = (NULL != strstr(tcLine, "commit of"));
+  }
+  kill(s32Pid, SIGTERM);
+  waitpid(s32Pid, &s32Status, 0);
+  fclose(pstOutput);
+  TEST_ASSERT_TRUE(bCommitted);
+  TEST_ASSERT_NOT_NULL(strstr(tcLine, "rfid-node-A1B2C3: commit of"));
+  TEST_ASSERT_NOT_NULL(strstr(tcLine, "/documents/tags/04A1B2C3\""));
+  TEST_ASSERT_NOT_NULL(strstr(tcLine, "\"reader\":{\"integerValue\":1}"));
+  TEST_ASSERT_NOT_NULL(strstr(tcLine, "\"timestamp\":{\"integerValue\":1700000000456}"));
+  TEST_ASSERT_NOT_NULL(strstr(tcLine, "\"increment\":{\"integerValue\":2}"));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_gw_invalid_args);
+  RUN_TEST(test_gw_absent);
+  RUN_TEST(test_gw_records);
+  RUN_TEST(test_gw_full);
+  RUN_TEST(test_gw_failures);
+  RUN_TEST(test_gw_bench_against_rest);
+  RUN_TEST(test_gw_python_gateway);
+  return UNITY_END();
+}
\ No newline at end of file
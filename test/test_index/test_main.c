@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <esp_partition.h>
+
+#include "app_index.h"
+#include "host_shims.h"
+
+#define TEST_INDEX_HEADER_SIZE                   32
+#define TEST_INDEX_SLOT_SIZE                     16
+#define TEST_INDEX_BENCH_LOOKUPS                 200000
+
+/* tools/tag_index_builder.py run on:
+     72EA5F06C1
+     29578CBB49 1
+     0411223344556677 0x80 */
+static const uint8_t tu08BuilderImage[] =
+{
+  0x54, 0x49, 0x44, 0x58, 0x01, 0x00, 0x10, 0x00, 0x08, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFE, 0x08, 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0xFF, 0xFF, 0x80, 0x00, 0x00, 0x00,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFE, 0x05, 0x72, 0xEA, 0x5F, 0x06, 0xC1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFE, 0x05, 0x29, 0x57, 0x8C, 0xBB, 0x49, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0x00, 0x00, 0x00,
+};
+
+static const esp_partition_t *pstPartition;
+
+/* Distinct 7 byte UIDs from a counter run through an LCG */
+static void _test_index_make_uid(uint32_t u32Number, uint8_t *pu08Uid)
+{
+  uint32_t u32Value;
+
+  u32Value = u32Number * 1664525UL + 1013904223UL;
+  pu08Uid[0] = 0x04;
+  memcpy(&pu08Uid[1], &u32Value, sizeof(u32Value));
+  pu08Uid[5] = (uint8_t)(u32Number >> 24);
+  pu08Uid[6] = 0x5A;
+}
+
+static uint32_t _test_index_get_slot_count(void)
+{
+  uint32_t u32SlotCount;
+
+  memcpy(&u32SlotCount, &host_flash_get_data(pstPartition)[8], sizeof(u32SlotCount));
+  return u32SlotCount;
+}
+
+void setUp(void)
+{
+  host_flash_reset();
+  pstPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, 0x41, "tagindex");
+}
+
+void tearDown(void)
+{
+}
+
+/* An erased partition holds no index until it is formatted */
+static void test_index_format(void)
+{
+  uint8_t tu08Uid[7];
+
+  _test_index_make_uid(0, tu08Uid);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_index_init());
+  TEST_ASSERT_FALSE(app_index_is_valid());
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_index_lookup(tu08Uid, sizeof(tu08Uid), NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  TEST_ASSERT_TRUE(app_index_is_valid());
+  TEST_ASSERT_EQUAL_UINT32(0, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_index_lookup(tu08Uid, sizeof(tu08Uid), NULL, 0));
+}
+
+/* Entries are updated in place, new flags retire the old entry */
+static void test_index_insert_update_remove(void)
+{
+  uint8_t tu08Uid[7];
+  uint32_t u32Flags;
+
+  _test_index_make_uid(1, tu08Uid);
+  app_index_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 3));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 3));
+  TEST_ASSERT_EQUAL_UINT32(1, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Uid, sizeof(tu08Uid), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(3, u32Flags);
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 5));
+  TEST_ASSERT_EQUAL_UINT32(1, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Uid, sizeof(tu08Uid), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(5, u32Flags);
+  /* A prefix of the UID is another UID */
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_index_lookup(tu08Uid, 4, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_remove(tu08Uid, sizeof(tu08Uid)));
+  TEST_ASSERT_EQUAL_UINT32(0, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_index_lookup(tu08Uid, sizeof(tu08Uid), NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 7));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Uid, sizeof(tu08Uid), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(7, u32Flags);
+}
+
+static void test_index_survives_reboot(void)
+{
+  uint8_t tu08Uid[7];
+  uint32_t u32Flags;
+
+  _test_index_make_uid(2, tu08Uid);
+  app_index_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 9));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_init());
+  TEST_ASSERT_EQUAL_UINT32(1, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Uid, sizeof(tu08Uid), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(9, u32Flags);
+}
+
+/* The image of the builder is read as is */
+static void test_index_builder_image(void)
+{
+  uint32_t u32Flags;
+  const uint8_t tu08First[] = {0x72, 0xEA, 0x5F, 0x06, 0xC1};
+  const uint8_t tu08Second[] = {0x29, 0x57, 0x8C, 0xBB, 0x49};
+  const uint8_t tu08Third[] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(pstPartition, 0, tu08BuilderImage, sizeof(tu08BuilderImage)));
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_init());
+  TEST_ASSERT_EQUAL_UINT32(3, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08First, sizeof(tu08First), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, u32Flags);
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Second, sizeof(tu08Second), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(1, u32Flags);
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Third, sizeof(tu08Third), &u32Flags, 0));
+  TEST_ASSERT_EQUAL_UINT32(0x80, u32Flags);
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_index_lookup(tu08First, 4, NULL, 0));
+}
+
+static void test_index_invalid_args(void)
+{
+  uint8_t tu08Uid[APP_INDEX_UID_MAX_SIZE + 1];
+
+  memset(tu08Uid, 0x04, sizeof(tu08Uid));
+  app_index_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_index_lookup(NULL, 4, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_index_lookup(tu08Uid, 0, NULL, 0));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_index_insert(tu08Uid, sizeof(tu08Uid), 0));
+}
+
+/* Every slot of the partition can be filled, the next insert is refused */
+static void test_index_full(void)
+{
+  uint8_t tu08Uid[7];
+  uint32_t u32Number;
+  uint32_t u32SlotCount;
+
+  app_index_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  u32SlotCount = _test_index_get_slot_count();
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(pstPartition->size, TEST_INDEX_HEADER_SIZE + u32SlotCount * TEST_INDEX_SLOT_SIZE);
+  for(u32Number = 0; u32Number < u32SlotCount; u32Number++)
+  {
+    _test_index_make_uid(u32Number, tu08Uid);
+    TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), u32Number));
+  }
+  _test_index_make_uid(u32Number, tu08Uid);
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_index_insert(tu08Uid, sizeof(tu08Uid), u32Number));
+  TEST_ASSERT_EQUAL_UINT32(u32SlotCount, app_index_get_count());
+}
+
+/* Lookup time of hits and misses with u32Count UIDs in the index, RAM use
+   doesn't depend on the count since the slots are only mapped */
+static void _test_index_bench(uint32_t u32Count)
+{
+  uint8_t tu08Uid[7];
+  uint32_t u32Number;
+  uint32_t u32Flags;
+  int64_t s64StartUs;
+  int64_t s64HitUs;
+  int64_t s64MissUs;
+  char tcLine[160];
+
+  app_index_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  for(u32Number = 0; u32Number < u32Count; u32Number++)
+  {
+    _test_index_make_uid(u32Number, tu08Uid);
+    TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), u32Number));
+  }
+  s64StartUs = esp_timer_get_time();
+  for(u32Number = 0; u32Number < TEST_INDEX_BENCH_LOOKUPS; u32Number++)
+  {
+    _test_index_make_uid(u32Number % u32Count, tu08Uid);
+    TEST_ASSERT_EQUAL(ESP_OK, app_index_lookup(tu08Uid, sizeof(tu08Uid), &u32Flags, 0));
+  }
+  s64HitUs = esp_timer_get_time() - s64StartUs;
+  TEST_ASSERT_EQUAL_UINT32((TEST_INDEX_BENCH_LOOKUPS - 1) % u32Count, u32Flags);
+  s64StartUs = esp_timer_get_time();
+  for(u32Number = 0; u32Number < TEST_INDEX_BENCH_LOOKUPS; u32Number++)
+  {
+    _test_index_make_uid(u32Count + u32Number, tu08Uid);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_index_lookup(tu08Uid, sizeof(tu08Uid), NULL, 0));
+  }
+  s64MissUs = esp_timer_get_time() - s64StartUs;
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%u UIDs in %u slots: hit %lld ns, miss %lld ns, %u bytes of flash",
+           u32Count,
+           _test_index_get_slot_count(),
+           (s64HitUs * 1000LL) / TEST_INDEX_BENCH_LOOKUPS,
+           (s64MissUs * 1000LL) / TEST_INDEX_BENCH_LOOKUPS,
+           TEST_INDEX_HEADER_SIZE + _test_index_get_slot_count() * TEST_INDEX_SLOT_SIZE);
+  TEST_MESSAGE(tcLine);
+}
+
+/* 100k UIDs take 1.6 MB of slots at the least, the 448 kB partition holds
+   16384 slots so the largest run is 10k */
+static void test_index_bench(void)
+{
+  _test_index_bench(1000);
+  _test_index_bench(10000);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_index_format);
+  RUN_TEST(test_index_insert_update_remove);
+  RUN_TEST(test_index_survives_reboot);
+  RUN_TEST(test_index_builder_image);
+  RUN_TEST(test_index_invalid_args);
+  RUN_TEST(test_index_full);
+  RUN_TEST(test_index_bench);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+
+#include "app_journal.h"
+#include "host_shims.h"
+
+#define TEST_JOURNAL_SLOT_SIZE                   32
+#define TEST_JOURNAL_SLOTS_PER_SECTOR            (SPI_FLASH_SEC_SIZE / TEST_JOURNAL_SLOT_SIZE)
+#define TEST_JOURNAL_BENCH_RECORDS               100000
+#define TEST_JOURNAL_RECORDS_MAX                 16
+
+typedef struct
+{
+  uint32_t u32Count;
+  uint32_t u32Limit;
+  uint32_t u32Next;
+  bool bInOrder;
+  app_journal_record_t tstRecords[TEST_JOURNAL_RECORDS_MAX];
+}journal_sink_t;
+
+static const esp_partition_t *pstPartition;
+static uint32_t u32SlotCount;
+
+/* The UID carries the sequence number of the record */
+static void _test_journal_make_record(uint32_t u32Sequence, app_journal_record_t *pstRecord)
+{
+  memset(pstRecord, 0x00, sizeof(app_journal_record_t));
+  pstRecord->u08UidLength = 7;
+  pstRecord->tu08Uid[0] = 0x04;
+  memcpy(&pstRecord->tu08Uid[1], &u32Sequence, sizeof(u32Sequence));
+  pstRecord->u08ReaderId = u32Sequence % 4;
+  pstRecord->s64Timestamp = 1700000000000LL + u32Sequence;
+  pstRecord->s64CaptureUs = esp_timer_get_time();
+}
+
+static uint32_t _test_journal_get_sequence(const app_journal_record_t *pstRecord)
+{
+  uint32_t u32Sequence;
+
+  memcpy(&u32Sequence, &pstRecord->tu08Uid[1], sizeof(u32Sequence));
+  return u32Sequence;
+}
+
+static void _test_journal_append(uint32_t u32First, uint32_t u32Count)
+{
+  uint32_t u32Index;
+  app_journal_record_t stRecord;
+
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    _test_journal_make_record(u32First + u32Index, &stRecord);
+    TEST_ASSERT_EQUAL(ESP_OK, app_journal_append(&stRecord));
+  }
+}
+
+/* Keeps the first records and checks that sequence numbers follow each other,
+   refuses records past its limit like a full batch */
+static esp_err_t _test_journal_sink(const app_journal_record_t *pstRecord, void *pvArg)
+{
+  esp_err_t s32RetVal;
+  journal_sink_t *pstSink;
+
+  pstSink = (journal_sink_t *)pvArg;
+  if(pstSink->u32Count >= pstSink->u32Limit)
+  {
+    s32RetVal = ESP_ERR_NO_MEM;
+  }
+  else
+  {
+    if(pstSink->u32Count < TEST_JOURNAL_RECORDS_MAX)
+    {
+      memcpy(&pstSink->tstRecords[pstSink->u32Count], pstRecord, sizeof(app_journal_record_t));
+    }
+    pstSink->bInOrder = pstSink->bInOrder && (pstSink->u32Next == _test_journal_get_sequence(pstRecord));
+    pstSink->u32Next = _test_journal_get_sequence(pstRecord) + 1;
+    pstSink->u32Count++;
+    s32RetVal = ESP_OK;
+  }
+  return s32RetVal;
+}
+
+static void _test_journal_sink_init(journal_sink_t *pstSink, uint32_t u32First, uint32_t u32Limit)
+{
+  memset(pstSink, 0x00, sizeof(journal_sink_t));
+  pstSink->u32Limit = u32Limit;
+  pstSink->u32Next = u32First;
+  pstSink->bInOrder = true;
+}
+
+void setUp(void)
+{
+  host_time_set_manual(1000000);
+  host_flash_reset();
+  pstPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, 0x40, "journal");
+  u32SlotCount = (pstPartition->size / SPI_FLASH_SEC_SIZE) * TEST_JOURNAL_SLOTS_PER_SECTOR;
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_init());
+}
+
+void tearDown(void)
+{
+  host_time_set_real();
+}
+
+static void test_journal_round_trip(void)
+{
+  journal_sink_t stSink;
+  app_journal_record_t stRecord;
+  app_journal_stats_t stStats;
+
+  _test_journal_append(0, 3);
+  TEST_ASSERT_EQUAL_UINT32(3, app_journal_count());
+  _test_journal_sink_init(&stSink, 0, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(3, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+  _test_journal_make_record(2, &stRecord);
+  TEST_ASSERT_EQUAL_UINT8(stRecord.u08UidLength, stSink.tstRecords[2].u08UidLength);
+  TEST_ASSERT_EQUAL_MEMORY(stRecord.tu08Uid, stSink.tstRecords[2].tu08Uid, stRecord.u08UidLength);
+  TEST_ASSERT_EQUAL_UINT8(stRecord.u08ReaderId, stSink.tstRecords[2].u08ReaderId);
+  TEST_ASSERT_EQUAL_INT64(stRecord.s64Timestamp, stSink.tstRecords[2].s64Timestamp);
+  TEST_ASSERT_EQUAL_INT64(stRecord.s64CaptureUs, stSink.tstRecords[2].s64CaptureUs);
+  /* Nothing is consumed by a replay alone */
+  TEST_ASSERT_EQUAL_UINT32(3, app_journal_count());
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+  TEST_ASSERT_EQUAL_UINT32(0, app_journal_count());
+  TEST_ASSERT_EQUAL_UINT32(0, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  app_journal_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32Appended);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32Consumed);
+}
+
+/* A replay stops at its limit or at the first record the callback refuses,
+   the next one starts right after what was consumed */
+static void test_journal_partial_replay(void)
+{
+  journal_sink_t stSink;
+
+  _test_journal_append(0, 10);
+  _test_journal_sink_init(&stSink, 0, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(4, app_journal_replay(_test_journal_sink, &stSink, 4));
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+  TEST_ASSERT_EQUAL_UINT32(6, app_journal_count());
+  _test_journal_sink_init(&stSink, 4, 3);
+  TEST_ASSERT_EQUAL_UINT32(3, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+  _test_journal_sink_init(&stSink, 7, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(3, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+}
+
+/* After a reboot the records consumed before stay consumed, the others keep
+   their timestamp but lose their capture time */
+static void test_journal_resumes_after_reboot(void)
+{
+  journal_sink_t stSink;
+
+  _test_journal_append(0, 10);
+  _test_journal_sink_init(&stSink, 0, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(4, app_journal_replay(_test_journal_sink, &stSink, 4));
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_init());
+  TEST_ASSERT_EQUAL_UINT32(6, app_journal_count());
+  _test_journal_append(10, 2);
+  _test_journal_sink_init(&stSink, 4, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(8, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+  TEST_ASSERT_EQUAL_INT64(1700000000000LL + 4, stSink.tstRecords[0].s64Timestamp);
+  TEST_ASSERT_EQUAL_INT64(0, stSink.tstRecords[0].s64CaptureUs);
+  TEST_ASSERT_NOT_EQUAL(0, stSink.tstRecords[7].s64CaptureUs);
+}
+
+/* A record with a broken crc is skipped and counted, the others come out */
+static void test_journal_skips_torn_record(void)
+{
+  uint8_t u08Torn;
+  journal_sink_t stSink;
+  app_journal_stats_t stStats;
+
+  _test_journal_append(0, 3);
+  u08Torn = 0x00;
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(pstPartition, TEST_JOURNAL_SLOT_SIZE + 2, &u08Torn, 1));
+  _test_journal_sink_init(&stSink, 0, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(2, app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_EQUAL_UINT32(0, _test_journal_get_sequence(&stSink.tstRecords[0]));
+  TEST_ASSERT_EQUAL_UINT32(2, _test_journal_get_sequence(&stSink.tstRecords[1]));
+  app_journal_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Corrupted);
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+  TEST_ASSERT_EQUAL_UINT32(0, app_journal_count());
+}
+
+/* A full journal drops its oldest sector to make room */
+static void test_journal_full_drops_oldest(void)
+{
+  journal_sink_t stSink;
+  app_journal_stats_t stStats;
+
+  _test_journal_append(0, u32SlotCount);
+  app_journal_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(TEST_JOURNAL_SLOTS_PER_SECTOR, stStats.u32Dropped);
+  TEST_ASSERT_EQUAL_UINT32(u32SlotCount - TEST_JOURNAL_SLOTS_PER_SECTOR, app_journal_count());
+  _test_journal_sink_init(&stSink, TEST_JOURNAL_SLOTS_PER_SECTOR, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(u32SlotCount - TEST_JOURNAL_SLOTS_PER_SECTOR,
+                           app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX));
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+}
+
+static void test_journal_invalid_args(void)
+{
+  app_journal_record_t stRecord;
+
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_journal_append(NULL));
+  _test_journal_make_record(0, &stRecord);
+  stRecord.u08UidLength = APP_JOURNAL_UID_MAX_SIZE + 1;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_journal_append(&stRecord));
+  _test_journal_make_record(0, &stRecord);
+  stRecord.u08ReaderId = 16;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_journal_append(&stRecord));
+}
+
+/* 100k records through the RAM backed flash of the shims, in outages that
+   nearly fill the journal each followed by a full replay. Every sector is
+   erased once per lap around the partition */
+static void test_journal_bench_100k(void)
+{
+  uint32_t u32Appended;
+  uint32_t u32Count;
+  int64_t s64StartUs;
+  int64_t s64AppendUs;
+  int64_t s64ReplayUs;
+  journal_sink_t stSink;
+  app_journal_stats_t stStats;
+  char tcLine[160];
+
+  host_time_set_real();
+  s64AppendUs = 0;
+  s64ReplayUs = 0;
+  u32Appended = 0;
+  _test_journal_sink_init(&stSink, 0, UINT32_MAX);
+  while(u32Appended < TEST_JOURNAL_BENCH_RECORDS)
+  {
+    u32Count = u32SlotCount - 2 * TEST_JOURNAL_SLOTS_PER_SECTOR;
+    u32Count = (u32Count < (TEST_JOURNAL_BENCH_RECORDS - u32Appended))?u32Count:(TEST_JOURNAL_BENCH_RECORDS - u32Appended);
+    s64StartUs = esp_timer_get_time();
+    _test_journal_append(u32Appended, u32Count);
+    s64AppendUs += esp_timer_get_time() - s64StartUs;
+    u32Appended += u32Count;
+    s64StartUs = esp_timer_get_time();
+    app_journal_replay(_test_journal_sink, &stSink, UINT32_MAX);
+    TEST_ASSERT_EQUAL(ESP_OK, app_journal_consume());
+    s64ReplayUs += esp_timer_get_time() - s64StartUs;
+  }
+  app_journal_get_stats(&stStats);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%u records: append %lld records/s, replay %lld records/s, %u sector erases",
+           TEST_JOURNAL_BENCH_RECORDS,
+           (TEST_JOURNAL_BENCH_RECORDS * 1000000LL) / (s64AppendUs + 1),
+           (TEST_JOURNAL_BENCH_RECORDS * 1000000LL) / (s64ReplayUs + 1),
+           host_flash_get_erases(pstPartition));
+  TEST_MESSAGE(tcLine);
+  TEST_ASSERT_EQUAL_UINT32(TEST_JOURNAL_BENCH_RECORDS, stSink.u32Count);
+  TEST_ASSERT_TRUE(stSink.bInOrder);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Dropped);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Corrupted);
+  TEST_ASSERT_EQUAL_UINT32(0, app_journal_count());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_JOURNAL_BENCH_RECORDS / TEST_JOURNAL_SLOTS_PER_SECTOR + 1,
+                                   host_flash_get_erases(pstPartition));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_journal_round_trip);
+  RUN_TEST(test_journal_partial_replay);
+  RUN_TEST(test_journal_resumes_after_reboot);
+  RUN_TEST(test_journal_skips_torn_record);
+  RUN_TEST(test_journal_full_drops_oldest);
+  RUN_TEST(test_journal_invalid_args);
+  RUN_TEST(test_journal_bench_100k);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+
+#include "app_json.h"
+#include "host_shims.h"
+
+#define TEST_JSON_VALUE_SIZE                     128
+#define TEST_JSON_BENCH_DOCUMENTS                50000
+
+/* Fields picked from the OTA metadata the way app_ota.c does */
+typedef struct
+{
+  uint32_t u32Size;
+  uint32_t u32Values;
+  bool bUrlTruncated;
+  char tcDownloadUrl[TEST_JSON_VALUE_SIZE];
+  char tcVersion[16];
+}json_metadata_t;
+
+typedef struct
+{
+  app_json_t stJson;
+  char tcValue[TEST_JSON_VALUE_SIZE];
+  json_metadata_t stMetadata;
+}json_scan_t;
+
+static const char tcMetadata[] =
+  "{\r\n"
+  "  \"version\": \"0.2.8\",\n"
+  "  \"notes\": {\"download_url\": \"nested\", \"size\": 1},\n"
+  "  \"assets\": [{\"size\": 2}, \"download_url\", 3.5e2, true, false, null],\n"
+  "  \"download_url\": \"https:\\/\\/github.com\\/owner\\/repo\\/releases\\/download\\/v0.2.8\\/firmware.bin\",\n"
+  "  \"size\": 912345\n"
+  "}";
+
+static const char *const tpcDownloadUrlPath[] = {"download_url"};
+static const char *const tpcVersionPath[] = {"version"};
+static const char *const tpcSizePath[] = {"size"};
+
+static void _test_json_metadata_cb(const app_json_t *pstJson,
+                                   app_json_type_t eType,
+                                   const char *pcValue,
+                                   uint32_t u32Length,
+                                   void *pvArg)
+{
+  json_metadata_t *pstMetadata;
+
+  pstMetadata = (json_metadata_t *)pvArg;
+  pstMetadata->u32Values++;
+  if(app_json_match(pstJson, tpcDownloadUrlPath, 1) && (APP_JSON_STRING == eType))
+  {
+    pstMetadata->bUrlTruncated = app_json_is_truncated(pstJson);
+    memcpy(pstMetadata->tcDownloadUrl, pcValue, u32Length + 1);
+  }
+  else if(app_json_match(pstJson, tpcVersionPath, 1) &&
+          (APP_JSON_STRING == eType) &&
+          (u32Length < sizeof(pstMetadata->tcVersion)))
+  {
+    memcpy(pstMetadata->tcVersion, pcValue, u32Length + 1);
+  }
+  else if(app_json_match(pstJson, tpcSizePath, 1) && (APP_JSON_NUMBER == eType))
+  {
+    pstMetadata->u32Size = strtoul(pcValue, NULL, 10);
+  }
+}
+
+static void _test_json_scan_init(json_scan_t *pstScan, uint32_t u32ValueSize)
+{
+  memset(pstScan, 0x00, sizeof(json_scan_t));
+  app_json_init(&pstScan->stJson, pstScan->tcValue, u32ValueSize, _test_json_metadata_cb, &pstScan->stMetadata);
+}
+
+/* Feed the document in pieces of u32Chunk bytes, 0 for a single split at u32Split */
+static esp_err_t _test_json_feed(json_scan_t *pstScan, const char *pcDocument, uint32_t u32Split, uint32_t u32Chunk)
+{
+  uint32_t u32Offset;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+
+  u32Length = strlen(pcDocument);
+  if(0 == u32Chunk)
+  {
+    s32RetVal = app_json_feed(&pstScan->stJson, pcDocument, u32Split);
+    if(ESP_OK == s32RetVal)
+    {
+      s32RetVal = app_json_feed(&pstScan->stJson, &pcDocument[u32Split], u32Length - u32Split);
+    }
+  }
+  else
+  {
+    s32RetVal = ESP_OK;
+    for(u32Offset = 0; (u32Offset < u32Length) && (ESP_OK == s32RetVal); u32Offset += u32Chunk)
+    {
+      s32RetVal = app_json_feed(&pstScan->stJson,
+                                &pcDocument[u32Offset],
+                                ((u32Length - u32Offset) < u32Chunk)?(u32Length - u32Offset):u32Chunk);
+    }
+  }
+  return s32RetVal;
+}
+
+static void _test_json_expect_metadata(const json_scan_t *pstScan)
+{
+  TEST_ASSERT_TRUE(app_json_is_done(&pstScan->stJson));
+  TEST_ASSERT_FALSE(pstScan->stMetadata.bUrlTruncated);
+  TEST_ASSERT_EQUAL_STRING("https://github.com/owner/repo/releases/download/v0.2.8/firmware.bin",
+                           pstScan->stMetadata.tcDownloadUrl);
+  TEST_ASSERT_EQUAL_STRING("0.2.8", pstScan->stMetadata.tcVersion);
+  TEST_ASSERT_EQUAL_UINT32(912345, pstScan->stMetadata.u32Size);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Only top level members are picked, the same names deeper down are not */
+static void test_json_metadata(void)
+{
+  json_scan_t stScan;
+
+  _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_json_feed(&stScan, tcMetadata, strlen(tcMetadata), 0));
+  _test_json_expect_metadata(&stScan);
+}
+
+/* The same fields come out wherever the HTTP chunks split the body */
+static void test_json_split_everywhere(void)
+{
+  uint32_t u32Split;
+  json_scan_t stScan;
+
+  for(u32Split = 0; u32Split <= strlen(tcMetadata); u32Split++)
+  {
+    _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, _test_json_feed(&stScan, tcMetadata, u32Split, 0));
+    _test_json_expect_metadata(&stScan);
+  }
+}
+
+static void test_json_small_chunks(void)
+{
+  uint32_t u32Chunk;
+  json_scan_t stScan;
+
+  for(u32Chunk = 1; u32Chunk <= 17; u32Chunk++)
+  {
+    _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, _test_json_feed(&stScan, tcMetadata, 0, u32Chunk));
+    _test_json_expect_metadata(&stScan);
+  }
+}
+
+/* A value longer than the buffer is cut and flagged, the scan goes on */
+static void test_json_truncated_value(void)
+{
+  json_scan_t stScan;
+
+  _test_json_scan_init(&stScan, 16);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_json_feed(&stScan, tcMetadata, 0, 5));
+  TEST_ASSERT_TRUE(app_json_is_done(&stScan.stJson));
+  TEST_ASSERT_TRUE(stScan.stMetadata.bUrlTruncated);
+  TEST_ASSERT_EQUAL_STRING("https://github.", stScan.stMetadata.tcDownloadUrl);
+  TEST_ASSERT_EQUAL_UINT32(912345, stScan.stMetadata.u32Size);
+}
+
+static void test_json_escapes(void)
+{
+  json_scan_t stScan;
+
+  _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_json_feed(&stScan, "{\"download_url\":\"a\\\"b\\\\c\\/d\\n\\u00e9\\u20ac\"}", 10, 0));
+  TEST_ASSERT_TRUE(app_json_is_done(&stScan.stJson));
+  TEST_ASSERT_EQUAL_STRING("a\"b\\c/d\n\xC3\xA9\xE2\x82\xAC", stScan.stMetadata.tcDownloadUrl);
+}
+
+static void test_json_invalid_documents(void)
+{
+  uint32_t u32Index;
+  json_scan_t stScan;
+  const char *const tpcInvalid[] =
+  {
+    "{\"size\":}",
+    "{\"size\" 1}",
+    "[1,,2]",
+    "{\"a\":1]",
+    "}",
+    "{\"a\":1,}",
+    "{\"a\"}",
+    "[[[[[[[[[1]]]]]]]]]",
+    "{} {}",
+  };
+
+  for(u32Index = 0; u32Index < (sizeof(tpcInvalid) / sizeof(tpcInvalid[0])); u32Index++)
+  {
+    _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, _test_json_feed(&stScan, tpcInvalid[u32Index], 0, 3));
+    TEST_ASSERT_FALSE(app_json_is_done(&stScan.stJson));
+  }
+  /* Cut short, nothing wrong yet but not done either */
+  _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+  TEST_ASSERT_EQUAL(ESP_OK, app_json_feed(&stScan.stJson, tcMetadata, sizeof(tcMetadata) - 3));
+  TEST_ASSERT_FALSE(app_json_is_done(&stScan.stJson));
+}
+
+/* The scanner allocates nothing, all it needs is its state and the value
+   buffer of the caller */
+static void test_json_bench(void)
+{
+  uint32_t u32Index;
+  int64_t s64StartUs;
+  int64_t s64ElapsedUs;
+  json_scan_t stScan;
+  char tcLine[160];
+
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < TEST_JSON_BENCH_DOCUMENTS; u32Index++)
+  {
+    _test_json_scan_init(&stScan, TEST_JSON_VALUE_SIZE);
+    _test_json_feed(&stScan, tcMetadata, 0, 512);
+  }
+  s64ElapsedUs = esp_timer_get_time() - s64StartUs;
+  _test_json_expect_metadata(&stScan);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "OTA metadata (%u bytes): %lld ns per document, %lld MB/s, %u bytes of state, no heap",
+           (uint32_t)strlen(tcMetadata),
+           (s64ElapsedUs * 1000LL) / TEST_JSON_BENCH_DOCUMENTS,
+           (long long)((TEST_JSON_BENCH_DOCUMENTS * (int64_t)strlen(tcMetadata)) / (s64ElapsedUs + 1)),
+           (uint32_t)(sizeof(app_json_t) + TEST_JSON_VALUE_SIZE));
+  TEST_MESSAGE(tcLine);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_json_metadata);
+  RUN_TEST(test_json_split_everywhere);
+  RUN_TEST(test_json_small_chunks);
+  RUN_TEST(test_json_truncated_value);
+  RUN_TEST(test_json_escapes);
+  RUN_TEST(test_json_invalid_documents);
+  RUN_TEST(test_json_bench);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+
+#include "app_lane.h"
+#include "app_hist.h"
+#include "host_shims.h"
+
+/* A simulated uplink: each lane is a queue of enqueue times, a turn costs a
+   request plus a little per record and moves the manual clock accordingly */
+#define TEST_LANE_QUEUE_SIZE                     4096
+#define TEST_LANE_REQUEST_US                     200000
+#define TEST_LANE_RECORD_US                      5000
+#define TEST_LANE_TURN_RECORDS                   16
+#define TEST_LANE_BACKLOG_TURN_RECORDS           8
+#define TEST_LANE_WINDOW_MS                      1000
+#define TEST_LANE_ALERT_DEADLINE_MS              100
+#define TEST_LANE_LIVE_DEADLINE_MS               2500
+#define TEST_LANE_TELEMETRY_PERIOD_US            (30 * 1000000LL)
+#define TEST_LANE_SATURATION_US                  (120 * 1000000LL)
+#define TEST_LANE_LONGEST_TURN_US                (TEST_LANE_REQUEST_US + TEST_LANE_TURN_RECORDS * TEST_LANE_RECORD_US)
+
+typedef struct
+{
+  uint32_t u32Head;
+  uint32_t u32Count;
+  uint32_t u32Served;
+  bool bStuck;
+  int64_t ts64EnqueuedUs[TEST_LANE_QUEUE_SIZE];
+  app_hist_t stWaitMs;
+}lane_queue_t;
+
+static lane_queue_t tstQueues[APP_LANE_COUNT];
+static int64_t s64TelemetryDueUs;
+
+static void _test_lane_enqueue(app_lane_t eLane, int64_t s64NowUs)
+{
+  lane_queue_t *pstQueue;
+
+  pstQueue = &tstQueues[eLane];
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_LANE_QUEUE_SIZE, pstQueue->u32Count);
+  pstQueue->ts64EnqueuedUs[(pstQueue->u32Head + pstQueue->u32Count) % TEST_LANE_QUEUE_SIZE] = s64NowUs;
+  pstQueue->u32Count++;
+}
+
+static uint32_t _test_lane_pending(app_lane_t eLane, int64_t *ps64OldestUs)
+{
+  lane_queue_t *pstQueue;
+
+  pstQueue = &tstQueues[eLane];
+  *ps64OldestUs = pstQueue->u32Count?pstQueue->ts64EnqueuedUs[pstQueue->u32Head]:0;
+  return pstQueue->u32Count;
+}
+
+static uint32_t _test_lane_serve(app_lane_t eLane, uint32_t u32MaxRecords)
+{
+  int64_t s64NowUs;
+  uint32_t u32Index;
+  uint32_t u32Count;
+  lane_queue_t *pstQueue;
+
+  pstQueue = &tstQueues[eLane];
+  u32Count = pstQueue->bStuck?0:((u32MaxRecords < pstQueue->u32Count)?u32MaxRecords:pstQueue->u32Count);
+  host_time_advance_us(TEST_LANE_REQUEST_US + u32Count * TEST_LANE_RECORD_US);
+  s64NowUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    app_hist_record(&pstQueue->stWaitMs, (uint32_t)((s64NowUs - pstQueue->ts64EnqueuedUs[pstQueue->u32Head]) / 1000));
+    pstQueue->u32Head = (pstQueue->u32Head + 1) % TEST_LANE_QUEUE_SIZE;
+  }
+  pstQueue->u32Count -= u32Count;
+  pstQueue->u32Served += u32Count;
+  return u32Count;
+}
+
+static uint32_t _test_lane_get_alerts(int64_t *ps64OldestUs)
+{
+  return _test_lane_pending(APP_LANE_ALERT, ps64OldestUs);
+}
+
+static uint32_t _test_lane_serve_alerts(uint32_t u32MaxRecords)
+{
+  return _test_lane_serve(APP_LANE_ALERT, u32MaxRecords);
+}
+
+static uint32_t _test_lane_get_live(int64_t *ps64OldestUs)
+{
+  return _test_lane_pending(APP_LANE_LIVE, ps64OldestUs);
+}
+
+static uint32_t _test_lane_serve_live(uint32_t u32MaxRecords)
+{
+  return _test_lane_serve(APP_LANE_LIVE, u32MaxRecords);
+}
+
+/* The journal has no age and is always ready while it holds records */
+static uint32_t _test_lane_get_backlog(int64_t *ps64OldestUs)
+{
+  _test_lane_pending(APP_LANE_BACKLOG, ps64OldestUs);
+  *ps64OldestUs = 0;
+  return tstQueues[APP_LANE_BACKLOG].u32Count;
+}
+
+static uint32_t _test_lane_serve_backlog(uint32_t u32MaxRecords)
+{
+  return _test_lane_serve(APP_LANE_BACKLOG, u32MaxRecords);
+}
+
+static uint32_t _test_lane_get_telemetry(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = s64TelemetryDueUs;
+  return 1;
+}
+
+static uint32_t _test_lane_serve_telemetry(uint32_t u32MaxRecords)
+{
+  host_time_advance_us(TEST_LANE_REQUEST_US);
+  tstQueues[APP_LANE_TELEMETRY].u32Served++;
+  s64TelemetryDueUs = esp_timer_get_time() + TEST_LANE_TELEMETRY_PERIOD_US;
+  return 1;
+}
+
+/* Same weights, windows and deadlines as app_pipeline */
+static const app_lane_config_t tstLanes[APP_LANE_COUNT] =
+{
+  [APP_LANE_ALERT]     = {_test_lane_get_alerts,    _test_lane_serve_alerts,    8,
+                          0,                   TEST_LANE_ALERT_DEADLINE_MS, TEST_LANE_TURN_RECORDS},
+  [APP_LANE_LIVE]      = {_test_lane_get_live,      _test_lane_serve_live,      4,
+                          TEST_LANE_WINDOW_MS, TEST_LANE_LIVE_DEADLINE_MS,  TEST_LANE_TURN_RECORDS},
+  [APP_LANE_BACKLOG]   = {_test_lane_get_backlog,   _test_lane_serve_backlog,   1,
+                          0,                   0,                           TEST_LANE_BACKLOG_TURN_RECORDS},
+  [APP_LANE_TELEMETRY] = {_test_lane_get_telemetry, _test_lane_serve_telemetry, 1,
+                          0,                   0,                           1},
+};
+
+static void _test_lane_print(const char *pcName, app_lane_t eLane)
+{
+  char tcLine[128];
+  app_lane_stats_t stStats;
+
+  app_lane_get_stats(eLane, &stStats);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%s: %u served in %u turns (%u late), wait p50/p99/max %u/%u/%u ms",
+           pcName,
+           tstQueues[eLane].u32Served,
+           stStats.u32Turns,
+           stStats.u32LateTurns,
+           app_hist_percentile(&tstQueues[eLane].stWaitMs, 50),
+           app_hist_percentile(&tstQueues[eLane].stWaitMs, 99),
+           tstQueues[eLane].stWaitMs.u32Max);
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+  uint32_t u32Lane;
+
+  host_time_set_manual(1000000);
+  memset(tstQueues, 0x00, sizeof(tstQueues));
+  for(u32Lane = 0; u32Lane < APP_LANE_COUNT; u32Lane++)
+  {
+    app_hist_reset(&tstQueues[u32Lane].stWaitMs);
+  }
+  s64TelemetryDueUs = esp_timer_get_time() + TEST_LANE_TELEMETRY_PERIOD_US;
+  app_lane_init(tstLanes);
+}
+
+void tearDown(void)
+{
+  host_time_set_real();
+}
+
+static void test_lane_idle(void)
+{
+  s64TelemetryDueUs = INT64_MAX;
+  TEST_ASSERT_FALSE(app_lane_serve());
+  TEST_ASSERT_EQUAL_UINT32(0, tstQueues[APP_LANE_TELEMETRY].u32Served);
+}
+
+/* A single live scan waits for the batching window, the wait is rounded up
+   to whole ticks so the lane is ready when the task wakes up */
+static void test_lane_window(void)
+{
+  TickType_t u32WaitTicks;
+
+  s64TelemetryDueUs = INT64_MAX;
+  _test_lane_enqueue(APP_LANE_LIVE, esp_timer_get_time());
+  host_time_advance_us(1500);
+  TEST_ASSERT_FALSE(app_lane_serve());
+  u32WaitTicks = app_lane_get_wait_ticks();
+  TEST_ASSERT_EQUAL_UINT32(pdMS_TO_TICKS(TEST_LANE_WINDOW_MS), u32WaitTicks);
+  host_time_advance_us(u32WaitTicks * portTICK_PERIOD_MS * 1000LL);
+  TEST_ASSERT_TRUE(app_lane_serve());
+  TEST_ASSERT_EQUAL_UINT32(1, tstQueues[APP_LANE_LIVE].u32Served);
+}
+
+/* A full turn is ready right away */
+static void test_lane_full_turn(void)
+{
+  uint32_t u32Index;
+
+  s64TelemetryDueUs = INT64_MAX;
+  for(u32Index = 0; u32Index < TEST_LANE_TURN_RECORDS; u32Index++)
+  {
+    _test_lane_enqueue(APP_LANE_LIVE, esp_timer_get_time());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, app_lane_get_wait_ticks());
+  TEST_ASSERT_TRUE(app_lane_serve());
+  TEST_ASSERT_EQUAL_UINT32(TEST_LANE_TURN_RECORDS, tstQueues[APP_LANE_LIVE].u32Served);
+}
+
+/* A lane that is ready but can't make progress ends the loop of the caller */
+static void test_lane_no_progress(void)
+{
+  s64TelemetryDueUs = INT64_MAX;
+  _test_lane_enqueue(APP_LANE_BACKLOG, 0);
+  tstQueues[APP_LANE_BACKLOG].bStuck = true;
+  TEST_ASSERT_FALSE(app_lane_serve());
+  tstQueues[APP_LANE_BACKLOG].bStuck = false;
+  TEST_ASSERT_TRUE(app_lane_serve());
+  TEST_ASSERT_FALSE(app_lane_serve());
+}
+
+/* Two minutes of a saturated uplink: a deep journal is always ready, live
+   scans arrive at most of the rate the uplink can take and unknown tags show
+   up now and then. An alert waits for at most its deadline, the turn started
+   just before it passed and its own turn, live scans keep to their deadline, the journal and the telemetry still
+   get their share. The upload task is woken by every read, so an idle loop
+   only moves the clock by a tick */
+static void test_lane_saturated_uplink(void)
+{
+  int64_t s64StartUs;
+  int64_t s64NowUs;
+  int64_t s64NextAlertUs;
+  int64_t s64NextLiveUs;
+  uint32_t u32Index;
+
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < (TEST_LANE_QUEUE_SIZE - 1); u32Index++)
+  {
+    _test_lane_enqueue(APP_LANE_BACKLOG, s64StartUs);
+  }
+  s64NextAlertUs = s64StartUs;
+  s64NextLiveUs = s64StartUs;
+  for(s64NowUs = s64StartUs; (s64NowUs - s64StartUs) < TEST_LANE_SATURATION_US; s64NowUs = esp_timer_get_time())
+  {
+    /* 40 live scans/s and an unknown tag every 3 s */
+    for(; s64NextLiveUs <= s64NowUs; s64NextLiveUs += 25000)
+    {
+      _test_lane_enqueue(APP_LANE_LIVE, s64NextLiveUs);
+    }
+    for(; s64NextAlertUs <= s64NowUs; s64NextAlertUs += 3000000)
+    {
+      _test_lane_enqueue(APP_LANE_ALERT, s64NextAlertUs);
+    }
+    if(!app_lane_serve())
+    {
+      host_time_advance_us(portTICK_PERIOD_MS * 1000LL);
+    }
+  }
+  _test_lane_print("alert", APP_LANE_ALERT);
+  _test_lane_print("live", APP_LANE_LIVE);
+  _test_lane_print("backlog", APP_LANE_BACKLOG);
+  _test_lane_print("telemetry", APP_LANE_TELEMETRY);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_LANE_ALERT_DEADLINE_MS + portTICK_PERIOD_MS +
+                                   (TEST_LANE_LONGEST_TURN_US + TEST_LANE_REQUEST_US + TEST_LANE_RECORD_US) / 1000,
+                                   tstQueues[APP_LANE_ALERT].stWaitMs.u32Max);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_LANE_LIVE_DEADLINE_MS, tstQueues[APP_LANE_LIVE].stWaitMs.u32Max);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_LANE_TURN_RECORDS * 2, tstQueues[APP_LANE_LIVE].u32Count);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, tstQueues[APP_LANE_BACKLOG].u32Served);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, tstQueues[APP_LANE_BACKLOG].u32Count);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_LANE_SATURATION_US / TEST_LANE_TELEMETRY_PERIOD_US - 1,
+                                      tstQueues[APP_LANE_TELEMETRY].u32Served);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_lane_idle);
+  RUN_TEST(test_lane_window);
+  RUN_TEST(test_lane_full_turn);
+  RUN_TEST(test_lane_no_progress);
+  RUN_TEST(test_lane_saturated_uplink);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+
+#include "app_mem.h"
+#include "host_shims.h"
+
+/* mbedTLS allocates through these with CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC */
+void *esp_mbedtls_mem_calloc(size_t, size_t);
+void esp_mbedtls_mem_free(void *);
+
+/* The soak runs the same uploads on the heap alone, then with the arenas: a
+   TLS session per upload, the request and its body on the heap, and now and
+   then a long lived allocation taken while the session is up */
+#ifndef TEST_MEM_UPLOADS
+#define TEST_MEM_UPLOADS                         1000000
+#endif
+#define TEST_MEM_SAMPLE_PERIOD                   10000
+#define TEST_MEM_OTA_PERIOD                      50
+#define TEST_MEM_LONG_LIVED                      48
+#define TEST_MEM_LONG_LIVED_PERIOD               8
+#define TEST_MEM_HANDSHAKE_BLOCKS                12
+#define TEST_MEM_SESSION_BLOCKS                  6
+#define TEST_MEM_CLIENT_SIZE                     1400
+#define TEST_MEM_RESPONSE_SIZE                   512
+/* Flat: never more than this above the first sample */
+#define TEST_MEM_MAX_DRIFT_PERMILLE              30
+
+typedef struct
+{
+  uint32_t u32Seed;
+  void *tpvLongLived[TEST_MEM_LONG_LIVED];
+}mem_workload_t;
+
+typedef struct
+{
+  void *tpvSession[TEST_MEM_SESSION_BLOCKS];
+  void *tpvHandshake[TEST_MEM_HANDSHAKE_BLOCKS];
+}mem_session_t;
+
+typedef struct
+{
+  uint32_t u32FirstPermille;
+  uint32_t u32LastPermille;
+  uint32_t u32MaxPermille;
+  uint32_t u32MinLargestBlock;
+  uint32_t u32Failures;
+}mem_soak_t;
+
+static TaskHandle_t pstMain;
+static TaskHandle_t pstOta;
+static atomic_bool bOtaBound;
+static uint32_t u32OtaSeed;
+
+/* Same sequence for both runs */
+static uint32_t _test_mem_random(uint32_t *pu32Seed)
+{
+  *pu32Seed ^= *pu32Seed << 13;
+  *pu32Seed ^= *pu32Seed >> 17;
+  *pu32Seed ^= *pu32Seed << 5;
+  return *pu32Seed;
+}
+
+/* Context, config, 16 KB in and 4 KB out records, transform and session stay
+   until the close. The handshake state and the certificate chain, 12 KB at
+   most, are freed once it is done */
+static uint32_t _test_mem_session_open(mem_session_t *pstSession, uint32_t *pu32Seed)
+{
+  uint32_t u32Index;
+  uint32_t u32Failures;
+  static const uint32_t tu32Sizes[TEST_MEM_SESSION_BLOCKS] =
+  {
+    488, 400, CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN + 333, CONFIG_MBEDTLS_SSL_OUT_CONTENT_LEN + 333, 1200, 250
+  };
+
+  u32Failures = 0;
+  for(u32Index = 0; u32Index < TEST_MEM_SESSION_BLOCKS; u32Index++)
+  {
+    pstSession->tpvSession[u32Index] = esp_mbedtls_mem_calloc(1, tu32Sizes[u32Index]);
+    u32Failures += pstSession->tpvSession[u32Index]?0:1;
+  }
+  for(u32Index = 0; u32Index < TEST_MEM_HANDSHAKE_BLOCKS; u32Index++)
+  {
+    pstSession->tpvHandshake[u32Index] = esp_mbedtls_mem_calloc(1, 200 + _test_mem_random(pu32Seed) % 800);
+    u32Failures += pstSession->tpvHandshake[u32Index]?0:1;
+  }
+  for(u32Index = 0; u32Index < TEST_MEM_HANDSHAKE_BLOCKS; u32Index++)
+  {
+    esp_mbedtls_mem_free(pstSession->tpvHandshake[u32Index]);
+  }
+  return u32Failures;
+}
+
+static void _test_mem_session_close(mem_session_t *pstSession)
+{
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < TEST_MEM_SESSION_BLOCKS; u32Index++)
+  {
+    esp_mbedtls_mem_free(pstSession->tpvSession[u32Index]);
+  }
+}
+
+/* Bound to the OTA arena, runs a check whenever it is woken up. Its client is
+   kept for the life of the task like in app_ota.c */
+static void _test_mem_ota_task(void *pvParameter)
+{
+  void *pvMetadata;
+  mem_session_t stSession;
+
+  app_mem_bind_task(APP_MEM_ARENA_OTA);
+  atomic_store(&bOtaBound, true);
+  while(1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    _test_mem_session_open(&stSession, &u32OtaSeed);
+    pvMetadata = heap_caps_malloc(1024, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    _test_mem_session_close(&stSession);
+    heap_caps_free(pvMetadata);
+    xTaskNotifyGive(pstMain);
+  }
+}
+
+static void _test_mem_ota_check(void)
+{
+  xTaskNotifyGive(pstOta);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+/* One upload from an unbound task, the connection arena serves it */
+static uint32_t _test_mem_upload(mem_workload_t *pstWorkload, uint32_t u32Upload)
+{
+  void *pvClient;
+  void *pvBody;
+  void *pvResponse;
+  uint32_t u32Index;
+  uint32_t u32Failures;
+  mem_session_t stSession;
+
+  pvClient = heap_caps_malloc(TEST_MEM_CLIENT_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  u32Failures = _test_mem_session_open(&stSession, &pstWorkload->u32Seed);
+  pvBody = heap_caps_malloc(200 + _test_mem_random(&pstWorkload->u32Seed) % 4000, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if(0 == (u32Upload % TEST_MEM_LONG_LIVED_PERIOD))
+  {
+    u32Index = _test_mem_random(&pstWorkload->u32Seed) % TEST_MEM_LONG_LIVED;
+    heap_caps_free(pstWorkload->tpvLongLived[u32Index]);
+    pstWorkload->tpvLongLived[u32Index] = heap_caps_malloc(32 + _test_mem_random(&pstWorkload->u32Seed) % 480,
+                                                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  pvResponse = heap_caps_malloc(TEST_MEM_RESPONSE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  u32Failures += (pvClient && pvBody && pvResponse)?0:1;
+  heap_caps_free(pvBody);
+  heap_caps_free(pvResponse);
+  _test_mem_session_close(&stSession);
+  heap_caps_free(pvClient);
+  if(0 == (u32Upload % TEST_MEM_OTA_PERIOD))
+  {
+    _test_mem_ota_check();
+  }
+  return u32Failures;
+}
+
+/* The heap is sampled between uploads, with no session up */
+static void _test_mem_soak(const char *pcName, mem_soak_t *pstSoak)
+{
+  uint32_t u32Index;
+  uint32_t u32Upload;
+  char tcLine[160];
+  mem_workload_t stWorkload;
+  app_mem_report_t stReport;
+
+  memset(&stWorkload, 0x00, sizeof(stWorkload));
+  memset(pstSoak, 0x00, sizeof(mem_soak_t));
+  stWorkload.u32Seed = 0x2545F491;
+  u32OtaSeed = 0x9E3779B9;
+  pstSoak->u32MinLargestBlock = UINT32_MAX;
+  for(u32Upload = 1; u32Upload <= TEST_MEM_UPLOADS; u32Upload++)
+  {
+    pstSoak->u32Failures += _test_mem_upload(&stWorkload, u32Upload);
+    if(0 == (u32Upload % TEST_MEM_SAMPLE_PERIOD))
+    {
+      app_mem_get_report(&stReport);
+      pstSoak->u32FirstPermille = (TEST_MEM_SAMPLE_PERIOD == u32Upload)?stReport.u32FragmentationPermille:
+                                                                        pstSoak->u32FirstPermille;
+      pstSoak->u32LastPermille = stReport.u32FragmentationPermille;
+      pstSoak->u32MaxPermille = (stReport.u32FragmentationPermille > pstSoak->u32MaxPermille)?
+                                stReport.u32FragmentationPermille:pstSoak->u32MaxPermille;
+      pstSoak->u32MinLargestBlock = (stReport.u32HeapLargestFreeBlock < pstSoak->u32MinLargestBlock)?
+                                    stReport.u32HeapLargestFreeBlock:pstSoak->u32MinLargestBlock;
+    }
+  }
+  for(u32Index = 0; u32Index < TEST_MEM_LONG_LIVED; u32Index++)
+  {
+    heap_caps_free(stWorkload.tpvLongLived[u32Index]);
+  }
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-9s fragmentation %2u.%u%% after 10k uploads, %2u.%u%% at the end (max %2u.%u%%), "
+           "smallest largest block %6u, failures %u",
+           pcName,
+           pstSoak->u32FirstPermille / 10,
+           pstSoak->u32FirstPermille % 10,
+           pstSoak->u32LastPermille / 10,
+           pstSoak->u32LastPermille % 10,
+           pstSoak->u32MaxPermille / 10,
+           pstSoak->u32MaxPermille % 10,
+           pstSoak->u32MinLargestBlock,
+           pstSoak->u32Failures);
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Before app_mem_init() TLS goes to the heap like it used to */
+static void test_mem_soak_without_arenas(void)
+{
+  mem_soak_t stSoak;
+
+  pstMain = xTaskGetCurrentTaskHandle();
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(_test_mem_ota_task, "ota", 4096, NULL, 3, &pstOta));
+  while(!atomic_load(&bOtaBound))
+  {
+    vTaskDelay(1);
+  }
+  host_heap_reset();
+  _test_mem_soak("heap only", &stSoak);
+}
+
+/* The arenas come out of the heap at boot, one block each */
+static void test_mem_init(void)
+{
+  multi_heap_info_t stBefore;
+  app_mem_report_t stReport;
+
+  host_heap_reset();
+  heap_caps_get_info(&stBefore, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  TEST_ASSERT_EQUAL(ESP_OK, app_mem_init());
+  app_mem_get_report(&stReport);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(stBefore.total_free_bytes - CONFIG_RFID_TLS_CONN_ARENA_SIZE - CONFIG_RFID_TLS_OTA_ARENA_SIZE,
+                                   stReport.u32HeapFree);
+  TEST_ASSERT_EQUAL_UINT32(0, stReport.u32FragmentationPermille);
+  TEST_ASSERT_EQUAL_UINT32(CONFIG_RFID_TLS_CONN_ARENA_SIZE, stReport.tstArenas[APP_MEM_ARENA_CONN].u32Size);
+  TEST_ASSERT_EQUAL_UINT32(CONFIG_RFID_TLS_OTA_ARENA_SIZE, stReport.tstArenas[APP_MEM_ARENA_OTA].u32Size);
+  TEST_ASSERT_EQUAL_UINT32(stReport.tstArenas[APP_MEM_ARENA_CONN].u32Free,
+                           stReport.tstArenas[APP_MEM_ARENA_CONN].u32LargestFreeBlock);
+  TEST_ASSERT_EQUAL_UINT32(0, stReport.tstArenas[APP_MEM_ARENA_CONN].u32Fallbacks);
+}
+
+/* The calling task picks the arena, a full arena falls back to the heap and
+   a free goes back where the block came from */
+static void test_mem_routing(void)
+{
+  void *pvBlock;
+  void *pvLarge;
+  app_mem_report_t stBefore;
+  app_mem_report_t stDuring;
+  app_mem_report_t stAfter;
+
+  app_mem_get_report(&stBefore);
+  pvBlock = esp_mbedtls_mem_calloc(4, 256);
+  TEST_ASSERT_NOT_NULL(pvBlock);
+  TEST_ASSERT_EACH_EQUAL_UINT8(0, pvBlock, 1024);
+  pvLarge = esp_mbedtls_mem_calloc(1, CONFIG_RFID_TLS_CONN_ARENA_SIZE);
+  TEST_ASSERT_NOT_NULL(pvLarge);
+  TEST_ASSERT_NULL(esp_mbedtls_mem_calloc(SIZE_MAX / 2, 4));
+  app_mem_get_report(&stDuring);
+  TEST_ASSERT_LESS_THAN_UINT32(stBefore.tstArenas[APP_MEM_ARENA_CONN].u32Free,
+                               stDuring.tstArenas[APP_MEM_ARENA_CONN].u32Free);
+  TEST_ASSERT_EQUAL_UINT32(stBefore.tstArenas[APP_MEM_ARENA_OTA].u32Free,
+                           stDuring.tstArenas[APP_MEM_ARENA_OTA].u32Free);
+  TEST_ASSERT_EQUAL_UINT32(1, stDuring.tstArenas[APP_MEM_ARENA_CONN].u32Fallbacks);
+  TEST_ASSERT_LESS_THAN_UINT32(stBefore.u32HeapFree - CONFIG_RFID_TLS_CONN_ARENA_SIZE + 1, stDuring.u32HeapFree);
+  esp_mbedtls_mem_free(pvBlock);
+  esp_mbedtls_mem_free(pvLarge);
+  esp_mbedtls_mem_free(NULL);
+  _test_mem_ota_check();
+  app_mem_get_report(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(stBefore.u32HeapFree, stAfter.u32HeapFree);
+  TEST_ASSERT_EQUAL_UINT32(stBefore.tstArenas[APP_MEM_ARENA_CONN].u32Free, stAfter.tstArenas[APP_MEM_ARENA_CONN].u32Free);
+  TEST_ASSERT_EQUAL_UINT32(stBefore.tstArenas[APP_MEM_ARENA_OTA].u32Free, stAfter.tstArenas[APP_MEM_ARENA_OTA].u32Free);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, stAfter.tstArenas[APP_MEM_ARENA_OTA].u32PeakUsed);
+}
+
+/* With the arenas the heap only sees the requests: its fragmentation stays
+   where it was after the first samples, the arenas never run out and are
+   whole again between sessions */
+static void test_mem_soak_with_arenas(void)
+{
+  uint32_t u32Index;
+  mem_soak_t stSoak;
+  app_mem_report_t stBefore;
+  app_mem_report_t stReport;
+
+  app_mem_get_report(&stBefore);
+  _test_mem_soak("arenas", &stSoak);
+  TEST_ASSERT_EQUAL_UINT32(0, stSoak.u32Failures);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(stSoak.u32FirstPermille + TEST_MEM_MAX_DRIFT_PERMILLE, stSoak.u32MaxPermille);
+  app_mem_get_report(&stReport);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stSoak.u32MaxPermille, stReport.u32MaxFragmentationPermille);
+  for(u32Index = 0; u32Index < APP_MEM_ARENA_COUNT; u32Index++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(stBefore.tstArenas[u32Index].u32Fallbacks, stReport.tstArenas[u32Index].u32Fallbacks);
+    TEST_ASSERT_EQUAL_UINT32(stReport.tstArenas[u32Index].u32Free, stReport.tstArenas[u32Index].u32LargestFreeBlock);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(stReport.tstArenas[u32Index].u32Size, stReport.tstArenas[u32Index].u32PeakUsed);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mem_soak_without_arenas);
+  RUN_TEST(test_mem_init);
+  RUN_TEST(test_mem_routing);
+  RUN_TEST(test_mem_soak_with_arenas);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include "app_ring.h"
+#include "app_wifi.h"
+#include "app_metrics.h"
+#include "host_shims.h"
+
+/* The registry is started once for the whole file, the tests run in order and
+   check what the previous ones recorded */
+#define TEST_METRICS_PAGE_SIZE                   8192
+#define TEST_METRICS_CORE_SAMPLES                100000
+#define TEST_METRICS_BENCH_SCANS                 1000000
+/* A few hundred cycles of the 240 MHz ESP32, on a host that runs no slower */
+#define TEST_METRICS_MAX_SCAN_NS                 1250
+#define TEST_METRICS_PERIOD_US                   (CONFIG_RFID_METRICS_PERIOD_MS * 1000LL)
+
+static app_ring_t stRing;
+static atomic_uint u32TasksDone;
+static char tcPage[TEST_METRICS_PAGE_SIZE];
+static char tcPath[64];
+static char tcBody[2048];
+static int s32HttpCode;
+
+static int _test_metrics_backend(esp_http_client_method_t eMethod,
+                                 const char *pcPath,
+                                 const char *pcBody,
+                                 uint32_t u32Length,
+                                 app_conn_data_cb_t pfDataCb,
+                                 void *pvArg)
+{
+  TEST_ASSERT_EQUAL(HTTP_METHOD_PATCH, eMethod);
+  TEST_ASSERT_LESS_THAN_UINT32(sizeof(tcBody), u32Length);
+  snprintf(tcPath, sizeof(tcPath), "%s", pcPath);
+  memcpy(tcBody, pcBody, u32Length);
+  tcBody[u32Length] = '\0';
+  return s32HttpCode;
+}
+
+/* Integer field of the telemetry document */
+static int64_t _test_metrics_field(const char *pcName)
+{
+  char tcKey[64];
+  const char *pcValue;
+
+  snprintf(tcKey, sizeof(tcKey), "\"%s\":{\"integerValue\":", pcName);
+  pcValue = strstr(tcBody, tcKey);
+  TEST_ASSERT_TRUE_MESSAGE(pcValue != NULL, pcName);
+  return strtoll(pcValue + strlen(tcKey), NULL, 10);
+}
+
+/* The upload side of app_pipeline: the scan, its upload and its latency */
+static void _test_metrics_scan(uint32_t u32LatencyMs)
+{
+  app_metrics_add(APP_METRICS_SCANS, 1);
+  app_metrics_add(APP_METRICS_SCANS_UPLOADED, 1);
+  app_metrics_record(APP_METRICS_UPLOAD_LATENCY, u32LatencyMs);
+}
+
+static void _test_metrics_core_task(void *pvArg)
+{
+  uint32_t u32Index;
+
+  host_task_set_core((int)(intptr_t)pvArg);
+  for(u32Index = 0; u32Index < TEST_METRICS_CORE_SAMPLES; u32Index++)
+  {
+    _test_metrics_scan(u32Index % 100);
+  }
+  atomic_fetch_add(&u32TasksDone, 1);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Bucket bounds are inclusive, anything past the last one is counted too */
+static void test_metrics_counters_and_buckets(void)
+{
+  app_metrics_snapshot_t stSnapshot;
+  const app_metrics_hist_snapshot_t *pstHist;
+
+  host_time_set_manual(0);
+  app_ring_init(&stRing, APP_RING_DROP_OLDEST);
+  app_metrics_start(&stRing);
+  app_metrics_add(APP_METRICS_SCANS, 3);
+  app_metrics_add(APP_METRICS_COUNTER_COUNT, 1);
+  app_metrics_record(APP_METRICS_UPLOAD_LATENCY, 25);
+  app_metrics_record(APP_METRICS_UPLOAD_LATENCY, 26);
+  app_metrics_record(APP_METRICS_UPLOAD_LATENCY, 70000);
+  app_metrics_record(APP_METRICS_HIST_COUNT, 1);
+  app_metrics_get_snapshot(&stSnapshot);
+  TEST_ASSERT_EQUAL_UINT32(3, stSnapshot.tu32Counters[APP_METRICS_SCANS]);
+  pstHist = &stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY];
+  TEST_ASSERT_EQUAL_UINT32(3, pstHist->u32Count);
+  TEST_ASSERT_EQUAL_UINT64(25 + 26 + 70000, pstHist->u64Sum);
+  TEST_ASSERT_EQUAL_UINT32(1, pstHist->tu32Buckets[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, pstHist->tu32Buckets[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, pstHist->tu32Buckets[APP_METRICS_BUCKETS - 1]);
+  TEST_ASSERT_EQUAL_UINT32(0, stSnapshot.tstHists[APP_METRICS_OTA_CHECK].u32Count);
+  TEST_ASSERT_EQUAL_INT32(0, stSnapshot.ts32Gauges[APP_METRICS_WIFI_RSSI]);
+}
+
+/* Each core has a shard of its own, none of the samples of two cores
+   recording at once is lost */
+static void test_metrics_cores(void)
+{
+  app_metrics_snapshot_t stBefore;
+  app_metrics_snapshot_t stAfter;
+
+  app_metrics_get_snapshot(&stBefore);
+  atomic_store(&u32TasksDone, 0);
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(_test_metrics_core_task, "core0", 4096, (void *)0, 5, NULL, 0));
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(_test_metrics_core_task, "core1", 4096, (void *)1, 5, NULL, 1));
+  while(atomic_load(&u32TasksDone) < 2)
+  {
+    taskYIELD();
+  }
+  app_metrics_get_snapshot(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(2 * TEST_METRICS_CORE_SAMPLES,
+                           stAfter.tu32Counters[APP_METRICS_SCANS] - stBefore.tu32Counters[APP_METRICS_SCANS]);
+  TEST_ASSERT_EQUAL_UINT32(2 * TEST_METRICS_CORE_SAMPLES,
+                           stAfter.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count -
+                           stBefore.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count);
+  TEST_ASSERT_EQUAL_UINT64(2 * (TEST_METRICS_CORE_SAMPLES / 100) * 4950ULL,
+                           stAfter.tstHists[APP_METRICS_UPLOAD_LATENCY].u64Sum -
+                           stBefore.tstHists[APP_METRICS_UPLOAD_LATENCY].u64Sum);
+}
+
+/* The document covers the period since the last one that went through, a
+   failed update keeps that period open */
+static void test_metrics_telemetry_document(void)
+{
+  uint32_t u32Index;
+  app_metrics_snapshot_t stSnapshot;
+
+  host_time_set_manual(TEST_METRICS_PERIOD_US);
+  TEST_ASSERT_EQUAL_INT64(TEST_METRICS_PERIOD_US, app_metrics_get_due_us());
+  app_metrics_get_snapshot(&stSnapshot);
+  host_conn_set_handler(_test_metrics_backend);
+  s32HttpCode = 200;
+  TEST_ASSERT_EQUAL(ESP_OK, app_metrics_upload());
+  TEST_ASSERT_EQUAL_STRING("/telemetry/rfid-node-A1B2C3", tcPath);
+  TEST_ASSERT_EQUAL_INT64(stSnapshot.tu32Counters[APP_METRICS_SCANS], _test_metrics_field("scans"));
+  TEST_ASSERT_EQUAL_INT64((stSnapshot.tu32Counters[APP_METRICS_SCANS] * 60000LL) / (TEST_METRICS_PERIOD_US / 1000),
+                          _test_metrics_field("scansPerMinute"));
+  /* 90% of the latencies recorded so far are at most 100 ms */
+  TEST_ASSERT_EQUAL_INT64(100, _test_metrics_field("uploadLatencyP90Ms"));
+  TEST_ASSERT_EQUAL_INT64(0, _test_metrics_field("otaCheckP90Ms"));
+  TEST_ASSERT_EQUAL_INT64(2 * TEST_METRICS_PERIOD_US, app_metrics_get_due_us());
+  /* 600 slow scans in the next period, the first attempt fails */
+  for(u32Index = 0; u32Index < 600; u32Index++)
+  {
+    _test_metrics_scan(3000);
+  }
+  host_time_set_manual(2 * TEST_METRICS_PERIOD_US);
+  s32HttpCode = 503;
+  TEST_ASSERT_EQUAL(ESP_FAIL, app_metrics_upload());
+  host_time_set_manual(3 * TEST_METRICS_PERIOD_US);
+  s32HttpCode = 200;
+  TEST_ASSERT_EQUAL(ESP_OK, app_metrics_upload());
+  TEST_ASSERT_EQUAL_INT64((600 * 60000LL) / (2 * TEST_METRICS_PERIOD_US / 1000), _test_metrics_field("scansPerMinute"));
+  TEST_ASSERT_EQUAL_INT64(5000, _test_metrics_field("uploadLatencyP90Ms"));
+  host_conn_set_handler(NULL);
+}
+
+/* Every family has its help, type and samples, histogram buckets add up and
+   the page goes out in chunks no longer than the page of app_metrics */
+static void test_metrics_prometheus(void)
+{
+  host_httpd_response_t stResponse;
+#if CONFIG_RFID_METRICS_HTTP_PORT
+  uint32_t u32Ticks;
+  char tcLine[160];
+  app_metrics_snapshot_t stSnapshot;
+  static const host_wifi_timing_t stTiming = {.u32ScanMs = 100, .u32ProbeMs = 10, .u32AssocMs = 10, .u32DhcpMs = 10};
+  static const uint8_t tu08Bssid[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+
+  host_nvs_reset();
+  host_wifi_set_ap(true, 1, tu08Bssid);
+  host_wifi_reset(&stTiming);
+  app_wifi_init();
+  for(u32Ticks = 0; (u32Ticks < 100) && !app_wifi_is_connected(); u32Ticks++)
+  {
+    host_time_advance_us(10000);
+  }
+  TEST_ASSERT_TRUE(app_wifi_is_connected());
+  app_metrics_get_snapshot(&stSnapshot);
+  TEST_ASSERT_EQUAL(ESP_OK, host_httpd_get(CONFIG_RFID_METRICS_HTTP_PORT, "/metrics", tcPage, sizeof(tcPage), &stResponse));
+  TEST_ASSERT_TRUE(stResponse.bFinished);
+  TEST_ASSERT_EQUAL_STRING("text/plain; version=0.0.4", stResponse.tcContentType);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(512, stResponse.u32MaxChunk);
+  TEST_ASSERT_EQUAL('\n', tcPage[stResponse.u32Length - 1]);
+  snprintf(tcLine, sizeof(tcLine), "\nrfid_scans_total %u\n", stSnapshot.tu32Counters[APP_METRICS_SCANS]);
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, tcLine));
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, "# TYPE rfid_scans_total counter\n"));
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, "# TYPE rfid_wifi_rssi_dbm gauge\nrfid_wifi_rssi_dbm -55\n"));
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, "# TYPE rfid_upload_latency_ms histogram\n"));
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "rfid_upload_latency_ms_bucket{le=\"2500\"} %u\nrfid_upload_latency_ms_bucket{le=\"5000\"} %u\n",
+           stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count - 600 - 1,
+           stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count - 1);
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, tcLine));
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "rfid_upload_latency_ms_bucket{le=\"+Inf\"} %u\nrfid_upload_latency_ms_sum %llu\n"
+           "rfid_upload_latency_ms_count %u\n",
+           stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count,
+           (unsigned long long)stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY].u64Sum,
+           stSnapshot.tstHists[APP_METRICS_UPLOAD_LATENCY].u32Count);
+  TEST_ASSERT_NOT_NULL(strstr(tcPage, tcLine));
+  snprintf(tcLine, sizeof(tcLine), "/metrics: %u bytes in %u chunks", stResponse.u32Length, stResponse.u32Chunks);
+  TEST_MESSAGE(tcLine);
+#else
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, host_httpd_get(80, "/metrics", tcPage, sizeof(tcPage), &stResponse));
+#endif
+}
+
+/* What a scan costs on the hot path, on the real clock */
+static void test_metrics_bench(void)
+{
+  uint32_t u32Index;
+  int64_t s64StartUs;
+  uint32_t u32ScanNs;
+  char tcLine[128];
+
+  host_time_set_real();
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < TEST_METRICS_BENCH_SCANS; u32Index++)
+  {
+    _test_metrics_scan(u32Index & 0x3FFF);
+  }
+  u32ScanNs = (uint32_t)(((esp_timer_get_time() - s64StartUs) * 1000LL) / TEST_METRICS_BENCH_SCANS);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "scan path (2 counters and 1 histogram sample) %u ns on the host",
+           u32ScanNs);
+  TEST_MESSAGE(tcLine);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_METRICS_MAX_SCAN_NS, u32ScanNs);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_metrics_counters_and_buckets);
+  RUN_TEST(test_metrics_cores);
+  RUN_TEST(test_metrics_telemetry_document);
+  RUN_TEST(test_metrics_prometheus);
+  RUN_TEST(test_metrics_bench);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include "app_ota.h"
+#include "host_shims.h"
+
+/* The OTA task runs once for the whole file on the manual clock, every test
+   appends the answers of the next checks and waits until they were taken */
+#define TEST_OTA_MAX_STEPS                       64
+#define TEST_OTA_PERIOD_US                       (60 * 1000000LL)
+#define TEST_OTA_MAX_PERIOD_US                   (6 * 60 * 60 * 1000000LL)
+#define TEST_OTA_POSTPONE_US                     (5 * 1000000LL)
+#define TEST_OTA_POSTPONE_MAX_COUNT              12
+#define TEST_OTA_WAIT_MAX_MS                     10000
+#define TEST_OTA_ETAG                            "\"5f2b-1\""
+#define TEST_OTA_MODIFIED                        "Mon, 01 Jan 2024 00:00:00 GMT"
+
+typedef struct
+{
+  int s32Status;
+  const char *pcETag;
+  const char *pcLastModified;
+  const char *pcBody;
+}ota_step_t;
+
+typedef struct
+{
+  int64_t s64TimeUs;
+  char tcIfNoneMatch[80];
+  char tcIfModifiedSince[40];
+}ota_request_t;
+
+typedef struct
+{
+  ota_step_t tstSteps[TEST_OTA_MAX_STEPS];
+  ota_request_t tstRequests[TEST_OTA_MAX_STEPS];
+  atomic_uint u32Steps;
+  atomic_uint u32Requests;
+  atomic_bool bWaiting;
+  atomic_uint u32Busy;
+}ota_backend_t;
+
+static ota_backend_t stBackend;
+
+static void _test_ota_copy_header(char *pcDest, uint32_t u32Size, const host_http_request_t *pstRequest, const char *pcKey)
+{
+  const char *pcValue;
+
+  pcValue = host_http_get_header(pstRequest, pcKey);
+  snprintf(pcDest, u32Size, "%s", pcValue?pcValue:"");
+}
+
+/* Runs in the OTA task, holds it in the request until the test gives the
+   answer */
+static int _test_ota_backend(const host_http_request_t *pstRequest, host_http_response_t *pstResponse)
+{
+  uint32_t u32Index;
+  uint32_t u32Header;
+  const ota_step_t *pstStep;
+
+  u32Index = atomic_load(&stBackend.u32Requests);
+  while(u32Index >= atomic_load(&stBackend.u32Steps))
+  {
+    atomic_store(&stBackend.bWaiting, true);
+    usleep(100);
+  }
+  atomic_store(&stBackend.bWaiting, false);
+  stBackend.tstRequests[u32Index].s64TimeUs = esp_timer_get_time();
+  _test_ota_copy_header(stBackend.tstRequests[u32Index].tcIfNoneMatch,
+                        sizeof(stBackend.tstRequests[u32Index].tcIfNoneMatch),
+                        pstRequest,
+                        "If-None-Match");
+  _test_ota_copy_header(stBackend.tstRequests[u32Index].tcIfModifiedSince,
+                        sizeof(stBackend.tstRequests[u32Index].tcIfModifiedSince),
+                        pstRequest,
+                        "If-Modified-Since");
+  pstStep = &stBackend.tstSteps[u32Index];
+  u32Header = 0;
+  if(pstStep->pcETag)
+  {
+    pstResponse->tstHeaders[u32Header].pcKey = "ETag";
+    pstResponse->tstHeaders[u32Header++].pcValue = pstStep->pcETag;
+  }
+  if(pstStep->pcLastModified)
+  {
+    pstResponse->tstHeaders[u32Header].pcKey = "Last-Modified";
+    pstResponse->tstHeaders[u32Header++].pcValue = pstStep->pcLastModified;
+  }
+  pstResponse->pcBody = pstStep->pcBody;
+  pstResponse->u32BodyLength = pstStep->pcBody?strlen(pstStep->pcBody):0;
+  atomic_store(&stBackend.u32Requests, u32Index + 1);
+  return pstStep->s32Status;
+}
+
+static bool _test_ota_busy(void)
+{
+  uint32_t u32Busy;
+
+  u32Busy = atomic_load(&stBackend.u32Busy);
+  while(u32Busy && !atomic_compare_exchange_weak(&stBackend.u32Busy, &u32Busy, u32Busy - 1))
+  {
+  }
+  return u32Busy > 0;
+}
+
+/* Queue the answers and wait until the task is back in the next request, the
+   checks they answer are done by then. Returns the index of the first one */
+static uint32_t _test_ota_run(const ota_step_t *pstSteps, uint32_t u32Count)
+{
+  uint32_t u32First;
+  uint32_t u32WaitMs;
+
+  u32First = atomic_load(&stBackend.u32Steps);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_OTA_MAX_STEPS, u32First + u32Count);
+  memcpy(&stBackend.tstSteps[u32First], pstSteps, u32Count * sizeof(ota_step_t));
+  atomic_store(&stBackend.u32Steps, u32First + u32Count);
+  for(u32WaitMs = 0;
+      ((atomic_load(&stBackend.u32Requests) < (u32First + u32Count)) || !atomic_load(&stBackend.bWaiting)) &&
+      (u32WaitMs < TEST_OTA_WAIT_MAX_MS);
+      u32WaitMs++)
+  {
+    usleep(1000);
+  }
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_OTA_WAIT_MAX_MS, u32WaitMs);
+  return u32First;
+}
+
+/* Time from the check of step u32Index to the next one */
+static int64_t _test_ota_interval_us(uint32_t u32Index)
+{
+  return stBackend.tstRequests[u32Index + 1].s64TimeUs - stBackend.tstRequests[u32Index].s64TimeUs;
+}
+
+/* The period spread by +/-25%, plus the time spent postponed */
+static void _test_ota_expect_interval(uint32_t u32Index, int64_t s64PeriodUs, int64_t s64PostponedUs)
+{
+  TEST_ASSERT_GREATER_OR_EQUAL_INT64(s64PeriodUs - (s64PeriodUs / 4) + s64PostponedUs, _test_ota_interval_us(u32Index));
+  TEST_ASSERT_LESS_THAN_INT64(s64PeriodUs + (s64PeriodUs / 4) + s64PostponedUs, _test_ota_interval_us(u32Index));
+}
+
+static void _test_ota_get_nvs(const char *pcKey, char *pcValue, size_t u32Size)
+{
+  nvs_handle_t u32Handle;
+
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_open("app_ota", NVS_READONLY, &u32Handle));
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_get_str(u32Handle, pcKey, pcValue, &u32Size));
+  nvs_close(u32Handle);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+  atomic_store(&stBackend.u32Busy, 0);
+}
+
+/* Validators kept by the previous boot go out with the very first check */
+static void test_ota_validators_from_nvs(void)
+{
+  nvs_handle_t u32Handle;
+  app_ota_stats_t stStats;
+  const ota_step_t stStep = {.s32Status = 304};
+
+  host_nvs_reset();
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_open("app_ota", NVS_READWRITE, &u32Handle));
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_set_str(u32Handle, "version", APP_VERSION));
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_set_str(u32Handle, "etag", TEST_OTA_ETAG));
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_set_str(u32Handle, "modified", TEST_OTA_MODIFIED));
+  nvs_close(u32Handle);
+  host_time_set_manual(1000000);
+  host_http_set_handler(_test_ota_backend);
+  app_ota_start(_test_ota_busy);
+  _test_ota_run(&stStep, 1);
+  TEST_ASSERT_EQUAL_STRING(TEST_OTA_ETAG, stBackend.tstRequests[0].tcIfNoneMatch);
+  TEST_ASSERT_EQUAL_STRING(TEST_OTA_MODIFIED, stBackend.tstRequests[0].tcIfModifiedSince);
+  /* A check is counted when it starts, the task is in the next one */
+  app_ota_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Checks);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32NotModified);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Handshakes);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32BytesReceived);
+}
+
+/* The validators of a 204 are saved and sent with the next check */
+static void test_ota_validators_saved(void)
+{
+  uint32_t u32First;
+  char tcValue[80];
+  const ota_step_t tstSteps[] =
+  {
+    {.s32Status = 204, .pcETag = "\"5f2c-2\"", .pcLastModified = "Tue, 02 Jan 2024 00:00:00 GMT"},
+    {.s32Status = 304},
+  };
+
+  u32First = _test_ota_run(tstSteps, 2);
+  TEST_ASSERT_EQUAL_STRING("\"5f2c-2\"", stBackend.tstRequests[u32First + 1].tcIfNoneMatch);
+  TEST_ASSERT_EQUAL_STRING("Tue, 02 Jan 2024 00:00:00 GMT", stBackend.tstRequests[u32First + 1].tcIfModifiedSince);
+  _test_ota_get_nvs("etag", tcValue, sizeof(tcValue));
+  TEST_ASSERT_EQUAL_STRING("\"5f2c-2\"", tcValue);
+  _test_ota_get_nvs("modified", tcValue, sizeof(tcValue));
+  TEST_ASSERT_EQUAL_STRING("Tue, 02 Jan 2024 00:00:00 GMT", tcValue);
+  _test_ota_get_nvs("version", tcValue, sizeof(tcValue));
+  TEST_ASSERT_EQUAL_STRING(APP_VERSION, tcValue);
+}
+
+/* The period doubles with every 204/304 up to 6 h, spread by +/-25%, and
+   starts over after an error */
+static void test_ota_backoff(void)
+{
+  uint32_t u32Index;
+  uint32_t u32First;
+  uint32_t u32Exact;
+  int64_t s64PeriodUs;
+  ota_step_t tstSteps[15];
+
+  tstSteps[0] = (ota_step_t){.s32Status = 503};
+  for(u32Index = 1; u32Index <= 12; u32Index++)
+  {
+    tstSteps[u32Index] = (ota_step_t){.s32Status = 304};
+  }
+  tstSteps[13] = (ota_step_t){.s32Status = 500};
+  tstSteps[14] = (ota_step_t){.s32Status = 304};
+  u32First = _test_ota_run(tstSteps, 15);
+  _test_ota_expect_interval(u32First, TEST_OTA_PERIOD_US, 0);
+  u32Exact = 0;
+  s64PeriodUs = TEST_OTA_PERIOD_US;
+  for(u32Index = 1; u32Index <= 12; u32Index++)
+  {
+    s64PeriodUs = (s64PeriodUs < (TEST_OTA_MAX_PERIOD_US / 2))?(2 * s64PeriodUs):TEST_OTA_MAX_PERIOD_US;
+    _test_ota_expect_interval(u32First + u32Index, s64PeriodUs, 0);
+    u32Exact += (_test_ota_interval_us(u32First + u32Index) == s64PeriodUs);
+  }
+  TEST_ASSERT_EQUAL_INT64(TEST_OTA_MAX_PERIOD_US, s64PeriodUs);
+  TEST_ASSERT_LESS_THAN_UINT32(2, u32Exact);
+  _test_ota_expect_interval(u32First + 13, TEST_OTA_PERIOD_US, 0);
+}
+
+/* Checks wait while scans are queued, for a bounded time */
+static void test_ota_postponed_while_busy(void)
+{
+  uint32_t u32First;
+  app_ota_stats_t stBefore;
+  app_ota_stats_t stAfter;
+  const ota_step_t tstSteps[] = {{.s32Status = 503}, {.s32Status = 503}};
+
+  app_ota_get_stats(&stBefore);
+  atomic_store(&stBackend.u32Busy, 3);
+  u32First = _test_ota_run(tstSteps, 1);
+  app_ota_get_stats(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(3, stAfter.u32Postponed - stBefore.u32Postponed);
+  /* The test before ended on a 304 */
+  _test_ota_expect_interval(u32First - 1, 2 * TEST_OTA_PERIOD_US, 3 * TEST_OTA_POSTPONE_US);
+  /* A node that is never idle still checks */
+  atomic_store(&stBackend.u32Busy, 1000);
+  _test_ota_run(&tstSteps[1], 1);
+  app_ota_get_stats(&stBefore);
+  TEST_ASSERT_EQUAL_UINT32(TEST_OTA_POSTPONE_MAX_COUNT, stBefore.u32Postponed - stAfter.u32Postponed);
+  TEST_ASSERT_EQUAL_UINT32(1000 - TEST_OTA_POSTPONE_MAX_COUNT - 1, atomic_load(&stBackend.u32Busy));
+}
+
+/* Every check after a close is a new handshake, bytes are headers and body.
+   A 200 drops the validators so a failed install can't be answered by 304 */
+static void test_ota_bytes_and_handshakes(void)
+{
+  uint32_t u32First;
+  uint32_t u32Bytes;
+  char tcValue[80];
+  char tcLine[128];
+  app_ota_stats_t stBefore;
+  app_ota_stats_t stAfter;
+  const ota_step_t tstSteps[] =
+  {
+    {.s32Status = 204, .pcETag = TEST_OTA_ETAG},
+    {.s32Status = -1},
+    {.s32Status = 200, .pcETag = TEST_OTA_ETAG, .pcBody = "{\"version\":\"0.2.8\"}"},
+    {.s32Status = 304},
+  };
+
+  app_ota_get_stats(&stBefore);
+  u32First = _test_ota_run(tstSteps, 4);
+  app_ota_get_stats(&stAfter);
+  u32Bytes = 2 * (strlen("ETag") + strlen(TEST_OTA_ETAG)) + strlen(tstSteps[2].pcBody);
+  TEST_ASSERT_EQUAL_UINT32(4, stAfter.u32Checks - stBefore.u32Checks);
+  TEST_ASSERT_EQUAL_UINT32(3, stAfter.u32Handshakes - stBefore.u32Handshakes);
+  TEST_ASSERT_EQUAL_UINT32(1, stAfter.u32NotModified - stBefore.u32NotModified);
+  TEST_ASSERT_EQUAL_UINT32(u32Bytes, stAfter.u32BytesReceived - stBefore.u32BytesReceived);
+  TEST_ASSERT_EQUAL_STRING(TEST_OTA_ETAG, stBackend.tstRequests[u32First + 1].tcIfNoneMatch);
+  TEST_ASSERT_EQUAL_STRING(TEST_OTA_ETAG, stBackend.tstRequests[u32First + 2].tcIfNoneMatch);
+  TEST_ASSERT_EQUAL_STRING("", stBackend.tstRequests[u32First + 3].tcIfNoneMatch);
+  TEST_ASSERT_EQUAL_STRING("", stBackend.tstRequests[u32First + 3].tcIfModifiedSince);
+  _test_ota_get_nvs("etag", tcValue, sizeof(tcValue));
+  TEST_ASSERT_EQUAL_STRING("", tcValue);
+  TEST_ASSERT_EQUAL_UINT32(0, host_get_restarts());
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%u checks: %u handshakes, %u not modified, %u bytes received",
+           stAfter.u32Checks,
+           stAfter.u32Handshakes,
+           stAfter.u32NotModified,
+           stAfter.u32BytesReceived);
+  TEST_MESSAGE(tcLine);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_ota_validators_from_nvs);
+  RUN_TEST(test_ota_validators_saved);
+  RUN_TEST(test_ota_backoff);
+  RUN_TEST(test_ota_postponed_while_busy);
+  RUN_TEST(test_ota_bytes_and_handshakes);
+  return UNITY_END();
+}
\ No newline at end of file
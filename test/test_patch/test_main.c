@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+#include <unity.h>
+
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+
+#include "app_patch.h"
+#include "host_shims.h"
+
+/* A release of a typical size: the running image and the next one, built
+   from the previous one by inserting new code and dropping some */
+#define TEST_PATCH_IMAGE_SIZE                    (900 * 1024)
+#define TEST_PATCH_VOCABULARY                    512
+#define TEST_PATCH_EDITS                         40
+#define TEST_PATCH_DOWNLOAD_CHUNK                1024
+#define TEST_PATCH_HEADER_SIZE                   80
+#define TEST_PATCH_OP_END                        0x00
+#define TEST_PATCH_OP_COPY                       0x01
+#define TEST_PATCH_OP_ADD                        0x02
+
+typedef struct
+{
+  uint8_t *pu08Data;
+  uint32_t u32Length;
+}patch_buffer_t;
+
+typedef struct
+{
+  patch_buffer_t stOld;
+  patch_buffer_t stNew;
+  patch_buffer_t stOps;
+}patch_release_t;
+
+static patch_release_t stRelease;
+static uint32_t u32Seed;
+
+static uint32_t _test_patch_random(void)
+{
+  u32Seed = (u32Seed * 1103515245) + 12345;
+  return u32Seed >> 8;
+}
+
+static void _test_patch_append(patch_buffer_t *pstBuffer, const void *pvData, uint32_t u32Length)
+{
+  pstBuffer->pu08Data = realloc(pstBuffer->pu08Data, pstBuffer->u32Length + u32Length);
+  memcpy(&pstBuffer->pu08Data[pstBuffer->u32Length], pvData, u32Length);
+  pstBuffer->u32Length += u32Length;
+}
+
+/* Words from a small vocabulary with some noise, it compresses about as well
+   as machine code */
+static void _test_patch_fill(uint8_t *pu08Data, uint32_t u32Length)
+{
+  uint32_t u32Index;
+  uint32_t u32Word;
+  static uint32_t tu32Vocabulary[TEST_PATCH_VOCABULARY];
+
+  if(0 == tu32Vocabulary[0])
+  {
+    for(u32Index = 0; u32Index < TEST_PATCH_VOCABULARY; u32Index++)
+    {
+      tu32Vocabulary[u32Index] = _test_patch_random() | 1;
+    }
+  }
+  for(u32Index = 0; u32Index < u32Length; u32Index += sizeof(u32Word))
+  {
+    u32Word = (_test_patch_random() & 3)?tu32Vocabulary[_test_patch_random() % TEST_PATCH_VOCABULARY]:_test_patch_random();
+    memcpy(&pu08Data[u32Index], &u32Word, ((u32Length - u32Index) < sizeof(u32Word))?(u32Length - u32Index):sizeof(u32Word));
+  }
+}
+
+static void _test_patch_add_op(uint8_t u08Op, uint32_t u32Arg0, uint32_t u32Arg1)
+{
+  _test_patch_append(&stRelease.stOps, &u08Op, 1);
+  if(TEST_PATCH_OP_END != u08Op)
+  {
+    _test_patch_append(&stRelease.stOps, &u32Arg0, sizeof(u32Arg0));
+  }
+  if(TEST_PATCH_OP_COPY == u08Op)
+  {
+    _test_patch_append(&stRelease.stOps, &u32Arg1, sizeof(u32Arg1));
+  }
+}
+
+/* The new image and its delta are built together so the delta is known to be
+   right, the same ops tools/ota_patch.py emits */
+static void _test_patch_make_release(void)
+{
+  uint32_t u32Edit;
+  uint32_t u32Offset;
+  uint32_t u32Length;
+  uint8_t tu08Literal[1024];
+
+  u32Seed = 1;
+  stRelease.stOld.u32Length = TEST_PATCH_IMAGE_SIZE;
+  stRelease.stOld.pu08Data = malloc(TEST_PATCH_IMAGE_SIZE);
+  _test_patch_fill(stRelease.stOld.pu08Data, TEST_PATCH_IMAGE_SIZE);
+  stRelease.stOld.pu08Data[0] = 0xE9;
+  u32Offset = 0;
+  for(u32Edit = 0; u32Edit < TEST_PATCH_EDITS; u32Edit++)
+  {
+    u32Length = (TEST_PATCH_IMAGE_SIZE / TEST_PATCH_EDITS) - 64 - (_test_patch_random() % 4096);
+    _test_patch_add_op(TEST_PATCH_OP_COPY, u32Offset, u32Length);
+    _test_patch_append(&stRelease.stNew, &stRelease.stOld.pu08Data[u32Offset], u32Length);
+    u32Offset += u32Length + (_test_patch_random() % 64);
+    u32Length = 16 + (_test_patch_random() % (sizeof(tu08Literal) - 16));
+    _test_patch_fill(tu08Literal, u32Length);
+    _test_patch_add_op(TEST_PATCH_OP_ADD, u32Length, 0);
+    _test_patch_append(&stRelease.stOps, tu08Literal, u32Length);
+    _test_patch_append(&stRelease.stNew, tu08Literal, u32Length);
+  }
+  _test_patch_add_op(TEST_PATCH_OP_END, 0, 0);
+}
+
+static void _test_patch_hash(const patch_buffer_t *pstBuffer, uint8_t *pu08Hash)
+{
+  mbedtls_sha256_context stSha;
+
+  mbedtls_sha256_init(&stSha);
+  mbedtls_sha256_starts_ret(&stSha, 0);
+  mbedtls_sha256_update_ret(&stSha, pstBuffer->pu08Data, pstBuffer->u32Length);
+  mbedtls_sha256_finish_ret(&stSha, pu08Hash);
+  mbedtls_sha256_free(&stSha);
+}
+
+/* Same layout as HEADER_FORMAT in tools/ota_patch.py */
+static patch_buffer_t _test_patch_container(bool bDelta, bool bCompressed)
+{
+  uLongf u32Compressed;
+  uint8_t tu08Header[TEST_PATCH_HEADER_SIZE];
+  const uint32_t u32Magic = 0x5041544F;
+  const patch_buffer_t *pstPayload;
+  patch_buffer_t stContainer;
+
+  pstPayload = bDelta?&stRelease.stOps:&stRelease.stNew;
+  memset(tu08Header, 0x00, sizeof(tu08Header));
+  memcpy(&tu08Header[0], &u32Magic, sizeof(u32Magic));
+  tu08Header[4] = 1;
+  tu08Header[5] = bDelta?1:0;
+  tu08Header[6] = bCompressed?1:0;
+  memcpy(&tu08Header[8], &stRelease.stNew.u32Length, sizeof(uint32_t));
+  _test_patch_hash(&stRelease.stNew, &tu08Header[12]);
+  memcpy(&tu08Header[44], &stRelease.stOld.u32Length, sizeof(uint32_t));
+  _test_patch_hash(&stRelease.stOld, &tu08Header[48]);
+  memset(&stContainer, 0x00, sizeof(stContainer));
+  _test_patch_append(&stContainer, tu08Header, sizeof(tu08Header));
+  if(bCompressed)
+  {
+    u32Compressed = compressBound(pstPayload->u32Length);
+    stContainer.pu08Data = realloc(stContainer.pu08Data, sizeof(tu08Header) + u32Compressed);
+    TEST_ASSERT_EQUAL(Z_OK, compress2(&stContainer.pu08Data[sizeof(tu08Header)],
+                                      &u32Compressed,
+                                      pstPayload->pu08Data,
+                                      pstPayload->u32Length,
+                                      9));
+    stContainer.u32Length += u32Compressed;
+  }
+  else
+  {
+    _test_patch_append(&stContainer, pstPayload->pu08Data, pstPayload->u32Length);
+  }
+  return stContainer;
+}
+
+/* Fed in pieces like the HTTP client hands them over */
+static esp_err_t _test_patch_apply(const patch_buffer_t *pstDownload, uint32_t u32Chunk)
+{
+  uint32_t u32Offset;
+  uint32_t u32Length;
+  esp_err_t s32RetVal;
+
+  s32RetVal = app_patch_begin();
+  for(u32Offset = 0; (ESP_OK == s32RetVal) && (u32Offset < pstDownload->u32Length); u32Offset += u32Length)
+  {
+    u32Length = pstDownload->u32Length - u32Offset;
+    u32Length = (u32Length < u32Chunk)?u32Length:u32Chunk;
+    s32RetVal = app_patch_write(&pstDownload->pu08Data[u32Offset], u32Length);
+  }
+  if(ESP_OK == s32RetVal)
+  {
+    s32RetVal = app_patch_end();
+  }
+  else
+  {
+    app_patch_abort();
+  }
+  return s32RetVal;
+}
+
+static void _test_patch_expect_installed(void)
+{
+  const esp_partition_t *pstTarget;
+
+  pstTarget = esp_ota_get_next_update_partition(NULL);
+  TEST_ASSERT_TRUE(pstTarget == esp_ota_get_boot_partition());
+  TEST_ASSERT_EQUAL_MEMORY(stRelease.stNew.pu08Data, host_flash_get_data(pstTarget), stRelease.stNew.u32Length);
+}
+
+static void _test_patch_expect_not_installed(void)
+{
+  TEST_ASSERT_TRUE(esp_ota_get_running_partition() == esp_ota_get_boot_partition());
+}
+
+void setUp(void)
+{
+  const esp_partition_t *pstRunning;
+
+  if(NULL == stRelease.stOld.pu08Data)
+  {
+    _test_patch_make_release();
+  }
+  host_flash_reset();
+  pstRunning = esp_ota_get_running_partition();
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(pstRunning, 0, stRelease.stOld.pu08Data, stRelease.stOld.u32Length));
+}
+
+void tearDown(void)
+{
+}
+
+/* A plain application image is written as is */
+static void test_patch_plain_image(void)
+{
+  TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(&stRelease.stNew, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_installed();
+}
+
+static void test_patch_full_containers(void)
+{
+  patch_buffer_t stContainer;
+
+  stContainer = _test_patch_container(false, false);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_installed();
+  free(stContainer.pu08Data);
+  host_flash_reset();
+  stContainer = _test_patch_container(false, true);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_installed();
+  free(stContainer.pu08Data);
+}
+
+/* Downloads split anywhere, inside the header, an op or its arguments */
+static void test_patch_delta_any_split(void)
+{
+  uint32_t u32Chunk;
+  patch_buffer_t stPlain;
+  patch_buffer_t stCompressed;
+  const esp_partition_t *pstRunning;
+
+  stPlain = _test_patch_container(true, false);
+  stCompressed = _test_patch_container(true, true);
+  pstRunning = esp_ota_get_running_partition();
+  for(u32Chunk = 1; u32Chunk <= 4099; u32Chunk = (u32Chunk * 3) + 2)
+  {
+    host_flash_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(pstRunning, 0, stRelease.stOld.pu08Data, stRelease.stOld.u32Length));
+    TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(&stPlain, u32Chunk));
+    _test_patch_expect_installed();
+    TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(&stCompressed, u32Chunk));
+    _test_patch_expect_installed();
+  }
+  free(stPlain.pu08Data);
+  free(stCompressed.pu08Data);
+}
+
+/* A delta is refused on any other firmware than the one it was made for */
+static void test_patch_delta_wrong_source(void)
+{
+  uint8_t u08Byte;
+  patch_buffer_t stContainer;
+
+  u08Byte = stRelease.stOld.pu08Data[1000] ^ 0xFF;
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(esp_ota_get_running_partition(), 1000, &u08Byte, 1));
+  stContainer = _test_patch_container(true, true);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_not_installed();
+  free(stContainer.pu08Data);
+}
+
+/* The image must match the hash of the header and the download must be whole */
+static void test_patch_corrupted_downloads(void)
+{
+  patch_buffer_t stContainer;
+
+  stContainer = _test_patch_container(false, false);
+  stContainer.pu08Data[stContainer.u32Length / 2] ^= 0x01;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_not_installed();
+  free(stContainer.pu08Data);
+  stContainer = _test_patch_container(false, true);
+  stContainer.pu08Data[TEST_PATCH_HEADER_SIZE + 100] ^= 0x5A;
+  TEST_ASSERT_NOT_EQUAL(ESP_OK, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_not_installed();
+  stContainer.pu08Data[TEST_PATCH_HEADER_SIZE + 100] ^= 0x5A;
+  stContainer.u32Length -= 100;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_not_installed();
+  free(stContainer.pu08Data);
+  stContainer = _test_patch_container(true, false);
+  stContainer.u32Length -= 1;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, _test_patch_apply(&stContainer, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_not_installed();
+  free(stContainer.pu08Data);
+}
+
+static void _test_patch_bench(const char *pcName, const patch_buffer_t *pstDownload)
+{
+  char tcLine[160];
+  app_patch_stats_t stStats;
+
+  host_flash_reset();
+  TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(esp_ota_get_running_partition(),
+                                                0,
+                                                stRelease.stOld.pu08Data,
+                                                stRelease.stOld.u32Length));
+  TEST_ASSERT_EQUAL(ESP_OK, _test_patch_apply(pstDownload, TEST_PATCH_DOWNLOAD_CHUNK));
+  _test_patch_expect_installed();
+  app_patch_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(pstDownload->u32Length, stStats.u32BytesIn);
+  TEST_ASSERT_EQUAL_UINT32(stRelease.stNew.u32Length, stStats.u32BytesOut);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-16s %7u bytes downloaded (%3u%%), %6u bytes of RAM, %4u ms",
+           pcName,
+           stStats.u32BytesIn,
+           (uint32_t)((stStats.u32BytesIn * 100ULL) / stRelease.stNew.u32Length),
+           stStats.u32WorkingRam,
+           stStats.u32DurationMs);
+  TEST_MESSAGE(tcLine);
+}
+
+/* Bytes downloaded, working RAM and apply time of each form of the release */
+static void test_patch_bench(void)
+{
+  uint32_t u32Index;
+  patch_buffer_t tstContainers[4];
+  const char *const tpcNames[] = {"full", "full compressed", "delta", "delta compressed"};
+
+  _test_patch_bench("plain image", &stRelease.stNew);
+  for(u32Index = 0; u32Index < 4; u32Index++)
+  {
+    tstContainers[u32Index] = _test_patch_container(u32Index >= 2, u32Index & 1);
+    _test_patch_bench(tpcNames[u32Index], &tstContainers[u32Index]);
+  }
+  /* A typical release comes down to a few percent of the image */
+  TEST_ASSERT_LESS_THAN_UINT32(stRelease.stNew.u32Length / 10, tstContainers[3].u32Length);
+  TEST_ASSERT_LESS_THAN_UINT32(stRelease.stNew.u32Length, tstContainers[1].u32Length);
+  for(u32Index = 0; u32Index < 4; u32Index++)
+  {
+    free(tstContainers[u32Index].pu08Data);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_patch_plain_image);
+  RUN_TEST(test_patch_full_containers);
+  RUN_TEST(test_patch_delta_any_split);
+  RUN_TEST(test_patch_delta_wrong_source);
+  RUN_TEST(test_patch_corrupted_downloads);
+  RUN_TEST(test_patch_bench);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+
+#include "app_ring.h"
+#include "app_hist.h"
+#include "app_index.h"
+#include "app_journal.h"
+#include "app_mem.h"
+#include "app_time.h"
+#include "app_wifi.h"
+#include "app_pipeline.h"
+#include "host_shims.h"
+
+/* Scan load benchmark of the upload pipeline of the firmware on the manual
+   clock: a simulated reader calls app_pipeline_scan() at a fixed rate, like
+   the reader task does, so reads go through the dedup, the access decision,
+   the tag ring, the lanes and the journal. The test plays the upload task,
+   it sleeps until a read comes in or the pipeline is due and runs a turn. The
+   backend takes a fixed time per request, reads keep coming in meanwhile */
+#define TEST_PIPELINE_STEP_US                    1000
+#define TEST_PIPELINE_MAX_SCANS                  512
+#define TEST_PIPELINE_MAX_RUN_US                 (120 * 1000000LL)
+#define TEST_PIPELINE_UID_SIZE                   7
+/* Every 16th badge isn't in the index, its scans go to the alert lane */
+#define TEST_PIPELINE_UNKNOWN_EVERY              16
+#define TEST_PIPELINE_SN_KEY                     "\"sn\":{\"stringValue\":\""
+#define TEST_PIPELINE_UNIX_US                    1700000000000000LL
+
+typedef struct
+{
+  uint32_t u32ScansPerSecond;
+  uint32_t u32Scans;
+  uint32_t u32RequestUs;
+  /* Commits answered with 503 before the backend recovers */
+  uint32_t u32Failures;
+  uint32_t u32Produced;
+  uint32_t u32Uploaded;
+  uint32_t u32Duplicates;
+  uint32_t u32Commits;
+  uint32_t u32Telemetry;
+  int64_t ts64CaptureUs[TEST_PIPELINE_MAX_SCANS];
+  uint8_t tu08Uploads[TEST_PIPELINE_MAX_SCANS];
+  app_hist_t stLatency;
+  app_mem_report_t stHeapBefore;
+  app_mem_report_t stHeapAfter;
+}pipeline_run_t;
+
+static pipeline_run_t stRun;
+
+static const host_wifi_timing_t stWifiTiming =
+{
+  .u32ScanMs = 2000,
+  .u32ProbeMs = 100,
+  .u32AssocMs = 200,
+  .u32DhcpMs = 500,
+};
+static const uint8_t tu08Ap[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+
+/* Every read gets a badge of its own so none is suppressed, its sequence
+   number and a check byte make up the UID */
+static void _test_pipeline_make_uid(uint32_t u32Sequence, uint8_t *pu08Uid)
+{
+  pu08Uid[0] = 0x04;
+  pu08Uid[1] = (uint8_t)u32Sequence;
+  pu08Uid[2] = (uint8_t)(u32Sequence >> 8);
+  pu08Uid[3] = 0xA5;
+  pu08Uid[4] = 0x5A;
+  pu08Uid[5] = 0x00;
+  pu08Uid[6] = pu08Uid[1] ^ pu08Uid[2];
+}
+
+static void _test_pipeline_read_cb(void *pvArg)
+{
+  uint8_t tu08Uid[TEST_PIPELINE_UID_SIZE];
+
+  if(stRun.u32Produced < stRun.u32Scans)
+  {
+    _test_pipeline_make_uid(stRun.u32Produced, tu08Uid);
+    stRun.ts64CaptureUs[stRun.u32Produced] = esp_timer_get_time();
+    app_pipeline_scan(stRun.u32Produced % 2, tu08Uid, sizeof(tu08Uid));
+    stRun.u32Produced++;
+  }
+}
+
+/* A commit is acknowledged once it has taken its time, the scans it carries
+   are looked up by the sequence number in their serial number */
+static int _test_pipeline_backend(esp_http_client_method_t eMethod,
+                                  const char *pcPath,
+                                  const char *pcBody,
+                                  uint32_t u32BodyLength,
+                                  app_conn_data_cb_t pfDataCb,
+                                  void *pvArg)
+{
+  int s32Status;
+  unsigned int u32Low;
+  unsigned int u32High;
+  uint32_t u32Sequence;
+  const char *pcSn;
+
+  host_time_advance_us(stRun.u32RequestUs);
+  s32Status = 200;
+  if(HTTP_METHOD_PATCH == eMethod)
+  {
+    stRun.u32Telemetry++;
+  }
+  else if(stRun.u32Failures)
+  {
+    stRun.u32Failures--;
+    s32Status = 503;
+  }
+  else
+  {
+    stRun.u32Commits++;
+    for(pcSn = strstr(pcBody, TEST_PIPELINE_SN_KEY); pcSn; pcSn = strstr(pcSn + 1, TEST_PIPELINE_SN_KEY))
+    {
+      TEST_ASSERT_EQUAL(2, sscanf(pcSn + strlen(TEST_PIPELINE_SN_KEY), "04%2x%2x", &u32Low, &u32High));
+      u32Sequence = u32Low | (u32High << 8);
+      TEST_ASSERT_LESS_THAN_UINT32(stRun.u32Produced, u32Sequence);
+      stRun.u32Duplicates += stRun.tu08Uploads[u32Sequence]?1:0;
+      stRun.tu08Uploads[u32Sequence]++;
+      stRun.u32Uploaded++;
+      app_hist_record(&stRun.stLatency, (uint32_t)(esp_timer_get_time() - stRun.ts64CaptureUs[u32Sequence]));
+    }
+  }
+  return s32Status;
+}
+
+/* Reads at a fixed rate until all are produced, the test sleeps like the
+   upload task does in ulTaskNotifyTake() and runs a turn when it wakes up,
+   until every read is uploaded, dropped or journaled for good */
+static void _test_pipeline_run(uint32_t u32ScansPerSecond,
+                               uint32_t u32Scans,
+                               uint32_t u32RequestUs,
+                               uint32_t u32Failures)
+{
+  TickType_t u32WaitTicks;
+  int64_t s64WakeUs;
+  int64_t s64EndUs;
+  app_ring_t *pstRing;
+  esp_timer_handle_t pstReader;
+  esp_timer_create_args_t stReaderArgs =
+  {
+    .callback = _test_pipeline_read_cb,
+    .name = "reader",
+  };
+
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_PIPELINE_MAX_SCANS, u32Scans);
+  memset(&stRun, 0x00, sizeof(stRun));
+  app_hist_reset(&stRun.stLatency);
+  stRun.u32ScansPerSecond = u32ScansPerSecond;
+  stRun.u32Scans = u32Scans;
+  stRun.u32RequestUs = u32RequestUs;
+  stRun.u32Failures = u32Failures;
+  app_pipeline_init();
+  pstRing = app_pipeline_get_ring();
+  host_conn_set_handler(_test_pipeline_backend);
+  app_mem_get_report(&stRun.stHeapBefore);
+  TEST_ASSERT_EQUAL(ESP_OK, esp_timer_create(&stReaderArgs, &pstReader));
+  TEST_ASSERT_EQUAL(ESP_OK, esp_timer_start_periodic(pstReader, 1000000 / u32ScansPerSecond));
+  s64EndUs = esp_timer_get_time() + TEST_PIPELINE_MAX_RUN_US;
+  while(((stRun.u32Produced < stRun.u32Scans) || app_pipeline_is_busy() || app_journal_count()) &&
+        (esp_timer_get_time() < s64EndUs))
+  {
+    app_pipeline_run();
+    u32WaitTicks = app_pipeline_get_wait_ticks();
+    s64WakeUs = (portMAX_DELAY == u32WaitTicks)?s64EndUs:
+                                                (esp_timer_get_time() + u32WaitTicks * portTICK_PERIOD_MS * 1000LL);
+    while((0 == app_ring_count(pstRing)) && (esp_timer_get_time() < s64WakeUs))
+    {
+      host_time_advance_us(TEST_PIPELINE_STEP_US);
+    }
+  }
+  esp_timer_stop(pstReader);
+  esp_timer_delete(pstReader);
+  app_mem_get_report(&stRun.stHeapAfter);
+  TEST_ASSERT_EQUAL_UINT32(stRun.u32Scans, stRun.u32Produced);
+  TEST_ASSERT_FALSE(app_pipeline_is_busy());
+  TEST_ASSERT_EQUAL_UINT32(0, app_journal_count());
+}
+
+static void _test_pipeline_print(const char *pcName)
+{
+  char tcLine[256];
+  app_ring_stats_t stStats;
+
+  app_ring_get_stats(app_pipeline_get_ring(), &stStats);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%s: %u scans/s, %u uploaded in %u commits, latency p50/p90/p99/max %u/%u/%u/%u ms, "
+           "depth max %u, dropped %u, heap free %u, min free %u before and %u after",
+           pcName,
+           stRun.u32ScansPerSecond,
+           stRun.u32Uploaded,
+           stRun.u32Commits,
+           app_hist_percentile(&stRun.stLatency, 50) / 1000,
+           app_hist_percentile(&stRun.stLatency, 90) / 1000,
+           app_hist_percentile(&stRun.stLatency, 99) / 1000,
+           stRun.stLatency.u32Max / 1000,
+           stStats.u32HighWater,
+           stStats.u32DroppedOldest + stStats.u32DroppedNewest,
+           stRun.stHeapAfter.u32HeapFree,
+           stRun.stHeapBefore.u32HeapMinFree,
+           stRun.stHeapAfter.u32HeapMinFree);
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* What app_main brings up before the pipeline: the TLS arenas, Wi-Fi, the
+   clock, the tag index with every badge but the unknown ones and the journal */
+static void test_pipeline_boot(void)
+{
+  uint32_t u32Sequence;
+  int64_t s64StartUs;
+  uint8_t tu08Uid[TEST_PIPELINE_UID_SIZE];
+
+  host_flash_reset();
+  host_nvs_reset();
+  host_heap_reset();
+  host_time_set_manual(0);
+  TEST_ASSERT_EQUAL(ESP_OK, app_mem_init());
+  host_wifi_reset(&stWifiTiming);
+  host_wifi_set_ap(true, 6, tu08Ap);
+  app_wifi_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_wifi_register_cb(app_pipeline_link));
+  s64StartUs = esp_timer_get_time();
+  while(!app_wifi_is_connected() && ((esp_timer_get_time() - s64StartUs) < 10000000LL))
+  {
+    host_time_advance_us(TEST_PIPELINE_STEP_US);
+  }
+  TEST_ASSERT_TRUE(app_wifi_is_connected());
+  host_rtc_set(TEST_PIPELINE_UNIX_US);
+  app_time_start();
+  TEST_ASSERT_FALSE(app_time_is_pending());
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_index_init());
+  TEST_ASSERT_EQUAL(ESP_OK, app_index_format());
+  for(u32Sequence = 0; u32Sequence < TEST_PIPELINE_MAX_SCANS; u32Sequence++)
+  {
+    if(0 != (u32Sequence % TEST_PIPELINE_UNKNOWN_EVERY))
+    {
+      _test_pipeline_make_uid(u32Sequence, tu08Uid);
+      TEST_ASSERT_EQUAL(ESP_OK, app_index_insert(tu08Uid, sizeof(tu08Uid), 0));
+    }
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, app_journal_init());
+}
+
+/* Well inside the capacity of the uplink every read is uploaded once, within
+   the live deadline and the request it waited for, and the scan path leaves
+   the heap alone */
+static void test_pipeline_nominal_load(void)
+{
+  uint32_t u32Sequence;
+  app_ring_stats_t stStats;
+
+  _test_pipeline_run(20, 100, 100000, 0);
+  _test_pipeline_print("nominal");
+  app_ring_get_stats(app_pipeline_get_ring(), &stStats);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32DroppedOldest + stStats.u32DroppedNewest);
+  TEST_ASSERT_EQUAL_UINT32(stRun.u32Produced, stRun.u32Uploaded);
+  TEST_ASSERT_EQUAL_UINT32(0, stRun.u32Duplicates);
+  for(u32Sequence = 0; u32Sequence < stRun.u32Produced; u32Sequence++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(1, stRun.tu08Uploads[u32Sequence]);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32((CONFIG_RFID_LANE_LIVE_DEADLINE_MS * 1000) + (2 * stRun.u32RequestUs),
+                                   stRun.stLatency.u32Max);
+  TEST_ASSERT_EQUAL_UINT32(stRun.stHeapBefore.u32HeapMinFree, stRun.stHeapAfter.u32HeapMinFree);
+}
+
+/* Past the capacity of the uplink the ring overflows, every read is either
+   uploaded once or counted as dropped */
+static void test_pipeline_saturated_uplink(void)
+{
+  app_ring_stats_t stStats;
+
+  _test_pipeline_run(50, 250, 2000000, 0);
+  _test_pipeline_print("saturated");
+  app_ring_get_stats(app_pipeline_get_ring(), &stStats);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(stRun.u32Produced, stRun.u32Uploaded + stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(0, stRun.u32Duplicates);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY, stStats.u32HighWater);
+}
+
+/* Commits that fail send their scans to the journal, which is replayed once
+   a commit goes through again. Every read still makes it exactly once */
+static void test_pipeline_failed_uploads(void)
+{
+  uint32_t u32Sequence;
+
+  _test_pipeline_run(20, 100, 100000, 3);
+  _test_pipeline_print("failed uploads");
+  TEST_ASSERT_EQUAL_UINT32(0, stRun.u32Failures);
+  TEST_ASSERT_EQUAL_UINT32(stRun.u32Produced, stRun.u32Uploaded);
+  for(u32Sequence = 0; u32Sequence < stRun.u32Produced; u32Sequence++)
+  {
+    TEST_ASSERT_EQUAL_UINT8(1, stRun.tu08Uploads[u32Sequence]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pipeline_boot);
+  RUN_TEST(test_pipeline_nominal_load);
+  RUN_TEST(test_pipeline_saturated_uplink);
+  RUN_TEST(test_pipeline_failed_uploads);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <sdkconfig.h>
+#include <esp_timer.h>
+
+#include "app_ring.h"
+#include "app_lane.h"
+#include "app_batch.h"
+#include "app_conn.h"
+#include "app_hist.h"
+#include "app_journal.h"
+#include "host_shims.h"
+
+/* Scan load of one performance profile on the manual clock, the profile is
+   picked at build time so the matrix is one run per native_* environment.
+   Tags are read at the end of the reader slot they arrive in, the upload side
+   sorts them into the live lane and commits them in batches like
+   app_pipeline, to a backend that takes a fixed time per request plus a little
+   per write */
+#define TEST_PROFILE_REQUEST_US                  150000
+#define TEST_PROFILE_WRITE_US                    1000
+#define TEST_PROFILE_STEP_US                     1000
+#define TEST_PROFILE_DURATION_MS                 20000
+#define TEST_PROFILE_PENDING_MAX_RECORDS         (2 * APP_BATCH_MAX_WRITES)
+/* Longest scan write of app_pipeline, see APP_PIPELINE_LONGEST_WRITE_SIZE */
+#define TEST_PROFILE_NODE_ID                     "rfid-node-A1B2C3"
+#define TEST_PROFILE_TIMESTAMP_MS                1700000000000LL
+
+#if defined(CONFIG_RFID_PROFILE_LOW_LATENCY)
+#define TEST_PROFILE_NAME                        "low latency"
+#elif defined(CONFIG_RFID_PROFILE_HIGH_VOLUME)
+#define TEST_PROFILE_NAME                        "high volume"
+#elif defined(CONFIG_RFID_PROFILE_LOW_RAM)
+#define TEST_PROFILE_NAME                        "low RAM"
+#else
+#define TEST_PROFILE_NAME                        "balanced"
+#endif
+
+typedef struct
+{
+  uint32_t u32Produced;
+  uint32_t u32Uploaded;
+  uint32_t u32Commits;
+  app_hist_t stLatencyMs;
+}profile_report_t;
+
+static app_ring_t stRing;
+static uint32_t u32PendingCount;
+static app_tag_t tstPending[TEST_PROFILE_PENDING_MAX_RECORDS];
+static profile_report_t stReport;
+static uint32_t u32BodyLength;
+static const char *const tpcMask[] = {"sn", "reader", "timestamp", "node"};
+
+static int _test_profile_backend(esp_http_client_method_t eMethod,
+                                 const char *pcPath,
+                                 const char *pcBody,
+                                 uint32_t u32Length,
+                                 app_conn_data_cb_t pfDataCb,
+                                 void *pvArg)
+{
+  uint32_t u32Writes;
+  const char *pcWrite;
+
+  u32Writes = 0;
+  for(pcWrite = strstr(pcBody, "\"update\""); pcWrite; pcWrite = strstr(pcWrite + 1, "\"update\""))
+  {
+    u32Writes++;
+  }
+  u32BodyLength = u32Length;
+  host_time_advance_us(TEST_PROFILE_REQUEST_US + u32Writes * TEST_PROFILE_WRITE_US);
+  return 200;
+}
+
+static void _test_profile_write_fields(app_doc_t *pstDoc, const void *pvArg)
+{
+  const app_tag_t *pstTag;
+
+  pstTag = (const app_tag_t *)pvArg;
+  app_doc_add_hex(pstDoc, "sn", pstTag->tu08Uid, pstTag->u08UidLength);
+  app_doc_add_integer(pstDoc, "reader", pstTag->u08ReaderId);
+  app_doc_add_integer(pstDoc, "timestamp", TEST_PROFILE_TIMESTAMP_MS);
+  app_doc_add_string(pstDoc, "node", TEST_PROFILE_NODE_ID);
+}
+
+/* Per tag write of the tag model, the longest app_pipeline builds */
+static esp_err_t _test_profile_add(const app_tag_t *pstTag)
+{
+  uint32_t u32Index;
+  char tcPath[48];
+  app_batch_write_t stWrite =
+  {
+    .pcDocumentPath = tcPath,
+    .pfFields = _test_profile_write_fields,
+    .pvArg = pstTag,
+    .ppcMask = tpcMask,
+    .u32MaskCount = sizeof(tpcMask) / sizeof(tpcMask[0]),
+    .pcRequestTimeField = "lastSeen",
+    .pcCounterField = "scans",
+  };
+
+  snprintf(tcPath, sizeof(tcPath), "tags/");
+  for(u32Index = 0; u32Index < pstTag->u08UidLength; u32Index++)
+  {
+    snprintf(&tcPath[5 + 2 * u32Index], sizeof(tcPath) - 5 - 2 * u32Index, "%02X", pstTag->tu08Uid[u32Index]);
+  }
+  return app_batch_add_write(&stWrite);
+}
+
+static void _test_profile_make_tag(uint32_t u32Sequence, int64_t s64ArrivalUs, app_tag_t *pstTag)
+{
+  memset(pstTag, 0x00, sizeof(app_tag_t));
+  pstTag->u08UidLength = APP_TAG_UID_MAX_SIZE;
+  memset(pstTag->tu08Uid, 0xFF, APP_TAG_UID_MAX_SIZE);
+  memcpy(pstTag->tu08Uid, &u32Sequence, sizeof(u32Sequence));
+  pstTag->u08ReaderId = 255;
+  pstTag->s64CaptureUs = s64ArrivalUs;
+}
+
+static uint32_t _test_profile_get_live(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = u32PendingCount?tstPending[0].s64CaptureUs:0;
+  return u32PendingCount;
+}
+
+static uint32_t _test_profile_serve_live(uint32_t u32MaxRecords)
+{
+  int64_t s64NowUs;
+  uint32_t u32Index;
+  uint32_t u32Count;
+
+  u32Count = (u32MaxRecords < u32PendingCount)?u32MaxRecords:u32PendingCount;
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, _test_profile_add(&tstPending[u32Index]));
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  s64NowUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    app_hist_record(&stReport.stLatencyMs, (uint32_t)((s64NowUs - tstPending[u32Index].s64CaptureUs) / 1000LL));
+  }
+  memmove(tstPending, &tstPending[u32Count], (u32PendingCount - u32Count) * sizeof(app_tag_t));
+  u32PendingCount -= u32Count;
+  stReport.u32Uploaded += u32Count;
+  stReport.u32Commits++;
+  return u32Count;
+}
+
+static uint32_t _test_profile_get_none(int64_t *ps64OldestUs)
+{
+  *ps64OldestUs = 0;
+  return 0;
+}
+
+static uint32_t _test_profile_serve_none(uint32_t u32MaxRecords)
+{
+  return 0;
+}
+
+/* Weights and deadlines of app_pipeline, only the live lane gets scans */
+static const app_lane_config_t tstLanes[APP_LANE_COUNT] =
+{
+  [APP_LANE_ALERT]     = {_test_profile_get_none, _test_profile_serve_none, 8,
+                          0,                   CONFIG_RFID_LANE_ALERT_DEADLINE_MS, APP_BATCH_MAX_WRITES},
+  [APP_LANE_LIVE]      = {_test_profile_get_live, _test_profile_serve_live, 4,
+                          APP_BATCH_WINDOW_MS, CONFIG_RFID_LANE_LIVE_DEADLINE_MS,  APP_BATCH_MAX_WRITES},
+  [APP_LANE_BACKLOG]   = {_test_profile_get_none, _test_profile_serve_none, 1,
+                          0,                   0,                                  CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS},
+  [APP_LANE_TELEMETRY] = {_test_profile_get_none, _test_profile_serve_none, 1,
+                          0,                   0,                                  1},
+};
+
+/* Scans arrive evenly, the ring takes what the upload side hasn't drained
+   yet, also while a commit is in flight */
+static void _test_profile_run(uint32_t u32ScansPerSecond, app_ring_stats_t *pstStats)
+{
+  app_tag_t stTag;
+  int64_t s64NowUs;
+  int64_t s64SlotUs;
+  int64_t s64ArrivalUs;
+  int64_t s64EndUs;
+
+  memset(&stReport, 0x00, sizeof(stReport));
+  app_hist_reset(&stReport.stLatencyMs);
+  app_ring_init(&stRing, APP_RING_DROP_OLDEST);
+  app_lane_init(tstLanes);
+  u32PendingCount = 0;
+  host_time_set_manual(0);
+  host_conn_set_handler(_test_profile_backend);
+  s64EndUs = TEST_PROFILE_DURATION_MS * 1000LL;
+  s64SlotUs = 0;
+  while((esp_timer_get_time() < s64EndUs) || app_ring_count(&stRing) || u32PendingCount)
+  {
+    s64NowUs = esp_timer_get_time();
+    while((s64SlotUs + CONFIG_RFID_READER_SLOT_MS * 1000LL <= s64NowUs) && (s64SlotUs < s64EndUs))
+    {
+      s64SlotUs += CONFIG_RFID_READER_SLOT_MS * 1000LL;
+      s64ArrivalUs = (stReport.u32Produced * 1000000LL) / u32ScansPerSecond;
+      while((s64ArrivalUs < s64SlotUs) && (s64ArrivalUs < s64EndUs))
+      {
+        _test_profile_make_tag(stReport.u32Produced++, s64ArrivalUs, &stTag);
+        app_ring_push(&stRing, &stTag);
+        s64ArrivalUs = (stReport.u32Produced * 1000000LL) / u32ScansPerSecond;
+      }
+    }
+    while((u32PendingCount < TEST_PROFILE_PENDING_MAX_RECORDS) && (ESP_OK == app_ring_pop(&stRing, &tstPending[u32PendingCount])))
+    {
+      u32PendingCount++;
+    }
+    if(!app_lane_serve())
+    {
+      host_time_advance_us(TEST_PROFILE_STEP_US);
+    }
+  }
+  host_conn_set_handler(NULL);
+  app_ring_get_stats(&stRing, pstStats);
+}
+
+static void _test_profile_print(const char *pcLoad, uint32_t u32ScansPerSecond, const app_ring_stats_t *pstStats)
+{
+  char tcLine[192];
+
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-11s %-5s %3u scans/s: latency p50/p99/max %u/%u/%u ms, %u uploaded in %u commits, "
+           "ring max %u, dropped %u",
+           TEST_PROFILE_NAME,
+           pcLoad,
+           u32ScansPerSecond,
+           app_hist_percentile(&stReport.stLatencyMs, 50),
+           app_hist_percentile(&stReport.stLatencyMs, 99),
+           stReport.stLatencyMs.u32Max,
+           stReport.u32Uploaded,
+           stReport.u32Commits,
+           pstStats->u32HighWater,
+           pstStats->u32DroppedOldest);
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* The runtime side of the static assertions of app_pipeline: a full batch of
+   the longest writes fits the body of the profile */
+static void test_profile_longest_batch(void)
+{
+  uint32_t u32Index;
+  app_tag_t stTag;
+  char tcLine[128];
+
+  host_time_set_manual(0);
+  host_conn_set_handler(_test_profile_backend);
+  for(u32Index = 0; u32Index < APP_BATCH_MAX_WRITES; u32Index++)
+  {
+    _test_profile_make_tag(u32Index, 0, &stTag);
+    TEST_ASSERT_EQUAL(ESP_OK, _test_profile_add(&stTag));
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, app_batch_commit());
+  host_conn_set_handler(NULL);
+  TEST_ASSERT_LESS_THAN_UINT32(APP_BATCH_BODY_MAX_SIZE, u32BodyLength);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-11s batch of %u longest writes: %u of %u bytes",
+           TEST_PROFILE_NAME,
+           APP_BATCH_MAX_WRITES,
+           u32BodyLength,
+           APP_BATCH_BODY_MAX_SIZE);
+  TEST_MESSAGE(tcLine);
+}
+
+/* What the profile sets aside: the tag ring, the pending scans of
+   app_pipeline, the batch body, the OTA HTTP buffers, the task stacks and the
+   TLS arenas */
+static void test_profile_ram(void)
+{
+  uint32_t u32Ring;
+  uint32_t u32Pending;
+  uint32_t u32Stacks;
+  uint32_t u32Ota;
+  uint32_t u32Arenas;
+  char tcLine[192];
+
+  u32Ring = sizeof(app_ring_t);
+  u32Pending = (TEST_PROFILE_PENDING_MAX_RECORDS + 8) * sizeof(app_journal_record_t);
+  u32Ota = CONFIG_RFID_OTA_HTTP_RX_BUFFER_SIZE + CONFIG_RFID_OTA_HTTP_TX_BUFFER_SIZE;
+  u32Stacks = CONFIG_RFID_READER_TASK_STACK_SIZE + CONFIG_RFID_UPLOAD_TASK_STACK_SIZE +
+              CONFIG_RFID_OTA_TASK_STACK_SIZE + CONFIG_RFID_SYNC_TASK_STACK_SIZE + CONFIG_RFID_TRACE_TASK_STACK_SIZE;
+  u32Arenas = CONFIG_RFID_TLS_CONN_ARENA_SIZE + CONFIG_RFID_TLS_OTA_ARENA_SIZE;
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-11s RAM %u bytes: ring %u, pending %u, body %u, OTA %u, stacks %u, TLS arenas %u",
+           TEST_PROFILE_NAME,
+           u32Ring + u32Pending + APP_BATCH_BODY_MAX_SIZE + u32Ota + u32Stacks + u32Arenas,
+           u32Ring,
+           u32Pending,
+           APP_BATCH_BODY_MAX_SIZE,
+           u32Ota,
+           u32Stacks,
+           u32Arenas);
+  TEST_MESSAGE(tcLine);
+  /* The checks app_pipeline makes at build time on the lanes of the profile */
+  TEST_ASSERT_EQUAL_UINT32(0, APP_RING_CAPACITY & (APP_RING_CAPACITY - 1));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(APP_BATCH_MAX_WRITES, CONFIG_RFID_LANE_BACKLOG_TURN_RECORDS);
+}
+
+/* A gate: a badge now and then is uploaded within a slot, the window and one
+   request, nothing is dropped */
+static void test_profile_gate(void)
+{
+  app_ring_stats_t stStats;
+
+  _test_profile_run(2, &stStats);
+  _test_profile_print("gate", 2, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(stReport.u32Produced, stReport.u32Uploaded);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(CONFIG_RFID_READER_SLOT_MS + APP_BATCH_WINDOW_MS +
+                                   (TEST_PROFILE_REQUEST_US + APP_BATCH_MAX_WRITES * TEST_PROFILE_WRITE_US) / 1000,
+                                   stReport.stLatencyMs.u32Max);
+}
+
+/* A busy entrance and a rush past the uplink, every scan is either uploaded
+   or counted as dropped by the ring */
+static void test_profile_busy_and_rush(void)
+{
+  app_ring_stats_t stStats;
+
+  _test_profile_run(20, &stStats);
+  _test_profile_print("busy", 20, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(stReport.u32Produced, stReport.u32Uploaded + stStats.u32DroppedOldest);
+  _test_profile_run(200, &stStats);
+  _test_profile_print("rush", 200, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(stReport.u32Produced, stReport.u32Uploaded + stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY, stStats.u32HighWater);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_profile_longest_batch);
+  RUN_TEST(test_profile_ram);
+  RUN_TEST(test_profile_gate);
+  RUN_TEST(test_profile_busy_and_rush);
+  return UNITY_END();
+}
\ No newline at end of file
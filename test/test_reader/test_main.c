@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <unity.h>
+
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include "app_reader.h"
+#include "host_shims.h"
+
+/* The reader task has no stop, every configuration starts a new one and the
+   task of the previous one is parked in its callback for good. The task is
+   the only one moving the manual clock so the times below are exact */
+#define TEST_READER_SLOT_MS                      10
+#define TEST_READER_SLOT_US                      (TEST_READER_SLOT_MS * 1000LL)
+/* A whole number of rounds for 1 to 4 readers and for the weights */
+#define TEST_READER_DETECTIONS                   840
+#define TEST_READER_SAMPLES                      400
+/* A single size UID is reported with its BCC */
+#define TEST_READER_UID_LENGTH                   5
+/* Readers with a timing: a tag answers in 100 us, an empty field times out
+   after the 2 ms of the reader timer and the bus runs at 5 MHz */
+#define TEST_READER_TIMED_DETECTIONS              50
+#define TEST_READER_ANSWER_US                    100
+#define TEST_READER_TIMER_US                     2000
+#define TEST_READER_IRQ_PIN                      34
+/* A register read, two bytes at 5 MHz rounded up */
+#define TEST_READER_READ_REG_US                  4
+
+typedef struct
+{
+  pthread_mutex_t stLock;
+  pthread_cond_t stCond;
+  bool bMoving;
+  bool bParked;
+  uint32_t u32Target;
+  uint32_t u32Readers;
+  uint32_t u32Detections;
+  uint32_t u32Wrong;
+  /* The UID every detection has to report */
+  uint8_t tu08Expected[10];
+  uint8_t u08ExpectedLength;
+  int64_t s64FirstUs;
+  int64_t s64LastUs;
+  /* The badge moved from reader to reader */
+  uint8_t u08Holder;
+  int64_t s64PlacedUs;
+  uint32_t tu32Samples[APP_READER_MAX_COUNT];
+  int64_t ts64SumUs[APP_READER_MAX_COUNT];
+  int64_t ts64MaxUs[APP_READER_MAX_COUNT];
+}reader_test_t;
+
+static reader_test_t stTest =
+{
+  .stLock = PTHREAD_MUTEX_INITIALIZER,
+  .stCond = PTHREAD_COND_INITIALIZER,
+};
+
+static const int ts32CsPins[APP_READER_MAX_COUNT] = {5, 17, 16, 4};
+static const uint8_t tu08Uid[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+
+/* Runs in the reader task. A moving badge is taken off the reader that saw it
+   and put in front of a random one, the time until that one reports it is
+   its detection latency. The first sample also covers the start up and is
+   left out */
+static void _test_reader_callback(uint8_t u08Reader, const uint8_t *pu08Uid, uint8_t u08Length)
+{
+  int64_t s64NowUs;
+
+  s64NowUs = esp_timer_get_time();
+  pthread_mutex_lock(&stTest.stLock);
+  if(stTest.bMoving)
+  {
+    if(u08Reader != stTest.u08Holder)
+    {
+      stTest.u32Wrong++;
+    }
+    else if(stTest.u32Detections)
+    {
+      stTest.tu32Samples[u08Reader]++;
+      stTest.ts64SumUs[u08Reader] += s64NowUs - stTest.s64PlacedUs;
+      stTest.ts64MaxUs[u08Reader] = (s64NowUs - stTest.s64PlacedUs > stTest.ts64MaxUs[u08Reader])?
+                                    (s64NowUs - stTest.s64PlacedUs):stTest.ts64MaxUs[u08Reader];
+    }
+    host_rc522_set_tag(ts32CsPins[stTest.u08Holder], tu08Uid, 0);
+    stTest.u08Holder = esp_random() % stTest.u32Readers;
+    host_rc522_set_tag(ts32CsPins[stTest.u08Holder], tu08Uid, sizeof(tu08Uid));
+    stTest.s64PlacedUs = s64NowUs;
+  }
+  if((stTest.u08ExpectedLength != u08Length) || memcmp(pu08Uid, stTest.tu08Expected, u08Length))
+  {
+    stTest.u32Wrong++;
+  }
+  stTest.s64FirstUs = stTest.u32Detections?stTest.s64FirstUs:s64NowUs;
+  stTest.s64LastUs = s64NowUs;
+  stTest.u32Detections++;
+  if(stTest.u32Detections == stTest.u32Target)
+  {
+    stTest.bParked = true;
+    pthread_cond_broadcast(&stTest.stCond);
+    while(1)
+    {
+      pthread_cond_wait(&stTest.stCond, &stTest.stLock);
+    }
+  }
+  pthread_mutex_unlock(&stTest.stLock);
+}
+
+/* Every reader present, a badge in front of each one or a single moving one */
+static void _test_reader_prepare(app_reader_start_args_t *pstArgs,
+                                 uint32_t u32Readers,
+                                 app_reader_policy_t ePolicy,
+                                 bool bMoving,
+                                 uint32_t u32Target)
+{
+  uint32_t u32Index;
+
+  memset(pstArgs, 0x00, sizeof(app_reader_start_args_t));
+  pstArgs->s32MisoPin = 19;
+  pstArgs->s32MosiPin = 23;
+  pstArgs->s32SckPin = 18;
+  pstArgs->u32ReaderCount = u32Readers;
+  pstArgs->ePolicy = ePolicy;
+  pstArgs->u32SlotMs = TEST_READER_SLOT_MS;
+  pstArgs->pfCallback = _test_reader_callback;
+  for(u32Index = 0; u32Index < APP_READER_MAX_COUNT; u32Index++)
+  {
+    pstArgs->tstReaders[u32Index].s32CsPin = ts32CsPins[u32Index];
+    pstArgs->tstReaders[u32Index].s32IrqPin = -1;
+    host_rc522_set_present(ts32CsPins[u32Index], true);
+    host_rc522_set_tag(ts32CsPins[u32Index], tu08Uid, (bMoving && u32Index)?0:sizeof(tu08Uid));
+    host_rc522_set_bad_crc(ts32CsPins[u32Index], false);
+    host_rc522_set_timing(ts32CsPins[u32Index], 0, 0);
+  }
+  memcpy(stTest.tu08Expected, tu08Uid, sizeof(tu08Uid));
+  stTest.tu08Expected[sizeof(tu08Uid)] = tu08Uid[0] ^ tu08Uid[1] ^ tu08Uid[2] ^ tu08Uid[3];
+  stTest.u08ExpectedLength = TEST_READER_UID_LENGTH;
+  stTest.u32Detections = 0;
+  stTest.u32Wrong = 0;
+  stTest.u08Holder = 0;
+  memset(stTest.tu32Samples, 0x00, sizeof(stTest.tu32Samples));
+  memset(stTest.ts64SumUs, 0x00, sizeof(stTest.ts64SumUs));
+  memset(stTest.ts64MaxUs, 0x00, sizeof(stTest.ts64MaxUs));
+  stTest.bMoving = bMoving;
+  stTest.bParked = false;
+  stTest.u32Target = u32Target;
+  stTest.u32Readers = u32Readers;
+  host_time_set_manual(0);
+}
+
+/* Start the readers and wait until the callback parked the task */
+static void _test_reader_run(const app_reader_start_args_t *pstArgs)
+{
+  TEST_ASSERT_EQUAL(ESP_OK, app_reader_start(pstArgs));
+  pthread_mutex_lock(&stTest.stLock);
+  while(!stTest.bParked)
+  {
+    pthread_cond_wait(&stTest.stCond, &stTest.stLock);
+  }
+  pthread_mutex_unlock(&stTest.stLock);
+  TEST_ASSERT_EQUAL_UINT32(0, stTest.u32Wrong);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_reader_invalid_args(void)
+{
+  app_reader_start_args_t stArgs;
+
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_reader_start(NULL));
+  _test_reader_prepare(&stArgs, 0, APP_READER_ROUND_ROBIN, false, 0);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_reader_start(&stArgs));
+  _test_reader_prepare(&stArgs, APP_READER_MAX_COUNT + 1, APP_READER_ROUND_ROBIN, false, 0);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_reader_start(&stArgs));
+  _test_reader_prepare(&stArgs, 1, APP_READER_ROUND_ROBIN, false, 0);
+  stArgs.pfCallback = NULL;
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_reader_start(&stArgs));
+}
+
+/* One slot per detection whatever the number of readers, each reader gets its
+   share of the slots and the idle time comes on top of the round */
+static void test_reader_throughput(void)
+{
+  uint32_t u32Readers;
+  uint32_t u32Index;
+  uint32_t u32IdleMs;
+  int64_t s64RoundUs;
+  char tcLine[128];
+  app_reader_stats_t stStats;
+  app_reader_start_args_t stArgs;
+
+  for(u32Readers = 1; u32Readers <= (APP_READER_MAX_COUNT + 1); u32Readers++)
+  {
+    /* The last run is four readers with the fields off for two slots a round */
+    u32IdleMs = (u32Readers > APP_READER_MAX_COUNT)?(2 * TEST_READER_SLOT_MS):0;
+    _test_reader_prepare(&stArgs,
+                         (u32Readers > APP_READER_MAX_COUNT)?APP_READER_MAX_COUNT:u32Readers,
+                         APP_READER_ROUND_ROBIN,
+                         false,
+                         TEST_READER_DETECTIONS);
+    stArgs.u32IdleMs = u32IdleMs;
+    _test_reader_run(&stArgs);
+    s64RoundUs = stArgs.u32ReaderCount * TEST_READER_SLOT_US + u32IdleMs * 1000LL;
+    TEST_ASSERT_EQUAL_INT64((TEST_READER_DETECTIONS / stArgs.u32ReaderCount - 1) * s64RoundUs +
+                            (stArgs.u32ReaderCount - 1) * TEST_READER_SLOT_US,
+                            stTest.s64LastUs - stTest.s64FirstUs);
+    for(u32Index = 0; u32Index < stArgs.u32ReaderCount; u32Index++)
+    {
+      TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(u32Index, &stStats));
+      TEST_ASSERT_EQUAL_UINT32(TEST_READER_DETECTIONS / stArgs.u32ReaderCount, stStats.u32Polls);
+      TEST_ASSERT_EQUAL_UINT32(stStats.u32Polls, stStats.u32Detections);
+      TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Errors);
+    }
+    snprintf(tcLine,
+             sizeof(tcLine),
+             "%u readers, idle %2u ms: %3d reads/s in total, %3d reads/s per reader",
+             stArgs.u32ReaderCount,
+             u32IdleMs,
+             (int)((stArgs.u32ReaderCount * 1000000LL) / s64RoundUs),
+             (int)(1000000LL / s64RoundUs));
+    TEST_MESSAGE(tcLine);
+  }
+}
+
+/* A badge put in front of a reader is seen within one round, on average about
+   half of one */
+static void test_reader_latency_round_robin(void)
+{
+  uint32_t u32Readers;
+  uint32_t u32Index;
+  char tcLine[128];
+  app_reader_start_args_t stArgs;
+
+  for(u32Readers = 1; u32Readers <= APP_READER_MAX_COUNT; u32Readers++)
+  {
+    _test_reader_prepare(&stArgs, u32Readers, APP_READER_ROUND_ROBIN, true, TEST_READER_SAMPLES + 1);
+    _test_reader_run(&stArgs);
+    for(u32Index = 0; u32Index < u32Readers; u32Index++)
+    {
+      TEST_ASSERT_GREATER_THAN_UINT32(0, stTest.tu32Samples[u32Index]);
+      TEST_ASSERT_EQUAL_INT64(u32Readers * TEST_READER_SLOT_US, stTest.ts64MaxUs[u32Index]);
+      snprintf(tcLine,
+               sizeof(tcLine),
+               "%u readers, reader %u: latency %5.1f ms on average, %3d ms max",
+               u32Readers,
+               u32Index,
+               stTest.ts64SumUs[u32Index] / (1000.0 * stTest.tu32Samples[u32Index]),
+               (int)(stTest.ts64MaxUs[u32Index] / 1000));
+      TEST_MESSAGE(tcLine);
+    }
+  }
+}
+
+/* Weights 4, 2, 1 and 1 give the schedule 0 1 0 2 3 0 1 0: the slots follow
+   the weights and the longest wait of a reader is its longest gap */
+static void test_reader_priority(void)
+{
+  uint32_t u32Index;
+  char tcLine[128];
+  app_reader_stats_t stStats;
+  app_reader_start_args_t stArgs;
+  static const uint32_t tu32Weights[APP_READER_MAX_COUNT] = {4, 2, 1, 1};
+  static const uint32_t tu32MaxGaps[APP_READER_MAX_COUNT] = {3, 5, 8, 8};
+
+  _test_reader_prepare(&stArgs, APP_READER_MAX_COUNT, APP_READER_PRIORITY, false, TEST_READER_DETECTIONS);
+  for(u32Index = 0; u32Index < APP_READER_MAX_COUNT; u32Index++)
+  {
+    stArgs.tstReaders[u32Index].u32Weight = tu32Weights[u32Index];
+  }
+  _test_reader_run(&stArgs);
+  for(u32Index = 0; u32Index < APP_READER_MAX_COUNT; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(u32Index, &stStats));
+    TEST_ASSERT_EQUAL_UINT32((TEST_READER_DETECTIONS * tu32Weights[u32Index]) / 8, stStats.u32Polls);
+  }
+  _test_reader_prepare(&stArgs, APP_READER_MAX_COUNT, APP_READER_PRIORITY, true, TEST_READER_SAMPLES + 1);
+  for(u32Index = 0; u32Index < APP_READER_MAX_COUNT; u32Index++)
+  {
+    stArgs.tstReaders[u32Index].u32Weight = tu32Weights[u32Index];
+  }
+  _test_reader_run(&stArgs);
+  for(u32Index = 0; u32Index < APP_READER_MAX_COUNT; u32Index++)
+  {
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stTest.tu32Samples[u32Index]);
+    TEST_ASSERT_LESS_OR_EQUAL_INT64(tu32MaxGaps[u32Index] * TEST_READER_SLOT_US, stTest.ts64MaxUs[u32Index]);
+    snprintf(tcLine,
+             sizeof(tcLine),
+             "weight %u: latency %5.1f ms on average, %3d ms max",
+             tu32Weights[u32Index],
+             stTest.ts64SumUs[u32Index] / (1000.0 * stTest.tu32Samples[u32Index]),
+             (int)(stTest.ts64MaxUs[u32Index] / 1000));
+    TEST_MESSAGE(tcLine);
+  }
+}
+
+/* A module that doesn't answer is left out of the schedule, the others keep
+   their slots. Without any module nothing starts */
+static void test_reader_missing(void)
+{
+  uint32_t u32Index;
+  app_reader_stats_t stStats;
+  app_reader_start_args_t stArgs;
+
+  _test_reader_prepare(&stArgs, 3, APP_READER_ROUND_ROBIN, false, 0);
+  for(u32Index = 0; u32Index < stArgs.u32ReaderCount; u32Index++)
+  {
+    host_rc522_set_present(ts32CsPins[u32Index], false);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_reader_start(&stArgs));
+  _test_reader_prepare(&stArgs, 3, APP_READER_ROUND_ROBIN, false, TEST_READER_DETECTIONS);
+  host_rc522_set_present(ts32CsPins[1], false);
+  _test_reader_run(&stArgs);
+  TEST_ASSERT_EQUAL_INT64((TEST_READER_DETECTIONS - 1) * TEST_READER_SLOT_US, stTest.s64LastUs - stTest.s64FirstUs);
+  for(u32Index = 0; u32Index < stArgs.u32ReaderCount; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(u32Index, &stStats));
+    TEST_ASSERT_EQUAL_UINT32((1 == u32Index)?0:(TEST_READER_DETECTIONS / 2), stStats.u32Polls);
+    TEST_ASSERT_EQUAL_UINT32(stStats.u32Polls, stStats.u32Detections);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_reader_get_stats(3, &stStats));
+}
+
+/* Double and triple size UIDs are reported whole. Each cascade level costs
+   the same transactions whatever its length as the FIFO is read in one burst */
+static void test_reader_uid_sizes(void)
+{
+  uint32_t u32Index;
+  uint32_t tu32Transfers[3];
+  char tcLine[128];
+  app_reader_stats_t stStats;
+  app_reader_start_args_t stArgs;
+  static const uint8_t tu08Long[10] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99};
+  static const uint8_t tu08Lengths[3] = {4, 7, 10};
+
+  for(u32Index = 0; u32Index < 3; u32Index++)
+  {
+    _test_reader_prepare(&stArgs, 1, APP_READER_ROUND_ROBIN, false, TEST_READER_SAMPLES);
+    host_rc522_set_tag(ts32CsPins[0], tu08Long, tu08Lengths[u32Index]);
+    memcpy(stTest.tu08Expected, tu08Long, tu08Lengths[u32Index]);
+    stTest.tu08Expected[4] = (4 == tu08Lengths[u32Index])?(tu08Long[0] ^ tu08Long[1] ^ tu08Long[2] ^ tu08Long[3]):
+                                                           tu08Long[4];
+    stTest.u08ExpectedLength = (4 == tu08Lengths[u32Index])?TEST_READER_UID_LENGTH:tu08Lengths[u32Index];
+    tu32Transfers[u32Index] = host_rc522_get_transfers(ts32CsPins[0]);
+    _test_reader_run(&stArgs);
+    TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(0, &stStats));
+    TEST_ASSERT_EQUAL_UINT32(TEST_READER_SAMPLES, stStats.u32Detections);
+    TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Errors);
+    tu32Transfers[u32Index] = host_rc522_get_transfers(ts32CsPins[0]) - tu32Transfers[u32Index];
+    snprintf(tcLine,
+             sizeof(tcLine),
+             "%2u byte UID: %3.1f SPI transactions per read",
+             tu08Lengths[u32Index],
+             (double)tu32Transfers[u32Index] / TEST_READER_SAMPLES);
+    TEST_MESSAGE(tcLine);
+  }
+  TEST_ASSERT_EQUAL_UINT32(tu32Transfers[1] - tu32Transfers[0], tu32Transfers[2] - tu32Transfers[1]);
+}
+
+/* A SAK with a broken CRC_A is an error and nothing is reported, the reader
+   next to it keeps working */
+static void test_reader_bad_crc(void)
+{
+  app_reader_stats_t stStats;
+  app_reader_start_args_t stArgs;
+  static const uint8_t tu08Double[7] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+  _test_reader_prepare(&stArgs, 2, APP_READER_ROUND_ROBIN, false, TEST_READER_SAMPLES);
+  host_rc522_set_tag(ts32CsPins[0], tu08Double, sizeof(tu08Double));
+  host_rc522_set_bad_crc(ts32CsPins[0], true);
+  _test_reader_run(&stArgs);
+  TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(0, &stStats));
+  TEST_ASSERT_EQUAL_UINT32(TEST_READER_SAMPLES, stStats.u32Polls);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Detections);
+  TEST_ASSERT_EQUAL_UINT32(TEST_READER_SAMPLES, stStats.u32Errors);
+  TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(1, &stStats));
+  TEST_ASSERT_EQUAL_UINT32(TEST_READER_SAMPLES, stStats.u32Detections);
+  host_rc522_set_bad_crc(ts32CsPins[0], false);
+}
+
+/* An empty reader next to one with a badge, with a tag and a timer that take
+   their time. Polled, the task spins on COM_IRQ over the bus while it waits.
+   With the IRQ line it sleeps and reads COM_IRQ once per exchange. The
+   longest poll of the busy reader is its detect to callback time */
+static void test_reader_irq(void)
+{
+  uint32_t u32Mode;
+  uint32_t u32Index;
+  uint32_t tu32IdleTransfers[2];
+  char tcLine[128];
+  app_reader_stats_t stIdle;
+  app_reader_stats_t stBusy;
+  app_reader_start_args_t stArgs;
+
+  for(u32Mode = 0; u32Mode < 2; u32Mode++)
+  {
+    _test_reader_prepare(&stArgs, 2, APP_READER_ROUND_ROBIN, false, TEST_READER_TIMED_DETECTIONS);
+    host_rc522_set_tag(ts32CsPins[0], tu08Uid, 0);
+    for(u32Index = 0; u32Index < stArgs.u32ReaderCount; u32Index++)
+    {
+      stArgs.tstReaders[u32Index].s32IrqPin = u32Mode?(TEST_READER_IRQ_PIN + u32Index):-1;
+      host_rc522_set_timing(ts32CsPins[u32Index], TEST_READER_ANSWER_US, TEST_READER_TIMER_US);
+    }
+    tu32IdleTransfers[u32Mode] = host_rc522_get_transfers(ts32CsPins[0]);
+    _test_reader_run(&stArgs);
+    TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(0, &stIdle));
+    TEST_ASSERT_EQUAL(ESP_OK, app_reader_get_stats(1, &stBusy));
+    TEST_ASSERT_EQUAL_UINT32(TEST_READER_TIMED_DETECTIONS, stIdle.u32Polls);
+    TEST_ASSERT_EQUAL_UINT32(0, stIdle.u32Detections + stIdle.u32Errors);
+    TEST_ASSERT_EQUAL_UINT32(TEST_READER_TIMED_DETECTIONS, stBusy.u32Detections);
+    TEST_ASSERT_EQUAL_UINT32(0, stBusy.u32Errors);
+    /* REQA and the anticollision both wait for the tag */
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2 * TEST_READER_ANSWER_US, stBusy.u32MaxPollUs);
+    TEST_ASSERT_LESS_THAN_UINT32(TEST_READER_SLOT_US, stBusy.u32MaxPollUs);
+    tu32IdleTransfers[u32Mode] = (host_rc522_get_transfers(ts32CsPins[0]) - tu32IdleTransfers[u32Mode]) /
+                                 TEST_READER_TIMED_DETECTIONS;
+    snprintf(tcLine,
+             sizeof(tcLine),
+             "%s: %4u SPI transactions per empty slot, detect to callback %4u us max",
+             u32Mode?"IRQ   ":"polled",
+             tu32IdleTransfers[u32Mode],
+             stBusy.u32MaxPollUs);
+    TEST_MESSAGE(tcLine);
+  }
+  /* Polled, the bus is busy for the whole wait on the timer */
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_READER_TIMER_US / TEST_READER_READ_REG_US, tu32IdleTransfers[0]);
+  TEST_ASSERT_LESS_THAN_UINT32(tu32IdleTransfers[0] / 10, tu32IdleTransfers[1]);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_reader_invalid_args);
+  RUN_TEST(test_reader_throughput);
+  RUN_TEST(test_reader_latency_round_robin);
+  RUN_TEST(test_reader_priority);
+  RUN_TEST(test_reader_missing);
+  RUN_TEST(test_reader_uid_sizes);
+  RUN_TEST(test_reader_bad_crc);
+  RUN_TEST(test_reader_irq);
+  return UNITY_END();
+}
\ No newline at end of file
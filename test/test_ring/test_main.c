@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+#include "app_ring.h"
+#include "host_shims.h"
+
+#define TEST_RING_STRESS_EVENTS                  200000
+/* Longer than the ring so every burst overflows it, the consumer gets the CPU
+   in between even on a single core host */
+#define TEST_RING_STRESS_BURST                   (APP_RING_CAPACITY + 5)
+
+typedef struct
+{
+  app_ring_t stRing;
+  atomic_bool bDone;
+  uint32_t u32Accepted;
+  uint64_t u64AcceptedSum;
+}ring_stress_t;
+
+static ring_stress_t stStress;
+
+/* The UID carries the sequence number twice, a copy torn between two events
+   doesn't match itself */
+static void _test_ring_make_tag(uint32_t u32Sequence, app_tag_t *pstTag)
+{
+  memset(pstTag, 0x00, sizeof(app_tag_t));
+  pstTag->u08UidLength = APP_TAG_UID_MAX_SIZE;
+  memcpy(&pstTag->tu08Uid[0], &u32Sequence, sizeof(u32Sequence));
+  memcpy(&pstTag->tu08Uid[4], &u32Sequence, sizeof(u32Sequence));
+  pstTag->tu08Uid[8] = 0x5A;
+  pstTag->tu08Uid[9] = 0xC3;
+  pstTag->s64CaptureUs = u32Sequence;
+}
+
+static bool _test_ring_get_sequence(const app_tag_t *pstTag, uint32_t *pu32Sequence)
+{
+  uint32_t u32Copy;
+
+  memcpy(pu32Sequence, &pstTag->tu08Uid[0], sizeof(uint32_t));
+  memcpy(&u32Copy, &pstTag->tu08Uid[4], sizeof(uint32_t));
+  return (APP_TAG_UID_MAX_SIZE == pstTag->u08UidLength) &&
+         (u32Copy == *pu32Sequence) &&
+         (0x5A == pstTag->tu08Uid[8]) &&
+         (0xC3 == pstTag->tu08Uid[9]) &&
+         (pstTag->s64CaptureUs == *pu32Sequence);
+}
+
+static void _test_ring_fill(app_ring_t *pstRing, uint32_t u32First, uint32_t u32Count)
+{
+  app_tag_t stTag;
+  uint32_t u32Index;
+
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    _test_ring_make_tag(u32First + u32Index, &stTag);
+    app_ring_push(pstRing, &stTag);
+  }
+}
+
+static void _test_ring_expect(app_ring_t *pstRing, uint32_t u32First, uint32_t u32Count)
+{
+  app_tag_t stTag;
+  uint32_t u32Index;
+  uint32_t u32Sequence;
+
+  for(u32Index = 0; u32Index < u32Count; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_ring_pop(pstRing, &stTag));
+    TEST_ASSERT_TRUE(_test_ring_get_sequence(&stTag, &u32Sequence));
+    TEST_ASSERT_EQUAL_UINT32(u32First + u32Index, u32Sequence);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, app_ring_pop(pstRing, &stTag));
+}
+
+static void _test_ring_producer_task(void *pvArg)
+{
+  app_tag_t stTag;
+  uint32_t u32Sequence;
+
+  for(u32Sequence = 0; u32Sequence < TEST_RING_STRESS_EVENTS; u32Sequence++)
+  {
+    _test_ring_make_tag(u32Sequence, &stTag);
+    if(ESP_OK == app_ring_push(&stStress.stRing, &stTag))
+    {
+      stStress.u32Accepted++;
+      stStress.u64AcceptedSum += u32Sequence;
+    }
+    if(0 == (u32Sequence % TEST_RING_STRESS_BURST))
+    {
+      taskYIELD();
+    }
+  }
+  atomic_store(&stStress.bDone, true);
+}
+
+/* Pops while a second thread pushes as fast as it can: every event comes out
+   intact, in order and once, the ones missing are all counted as dropped */
+static void _test_ring_stress(app_ring_policy_t ePolicy, uint32_t *pu32Popped, uint64_t *pu64PoppedSum)
+{
+  bool bDone;
+  bool bFirst;
+  app_tag_t stTag;
+  uint32_t u32Last;
+  uint32_t u32Sequence;
+  int64_t s64StartUs;
+  app_ring_stats_t stStats;
+  char tcLine[128];
+
+  memset(&stStress, 0x00, sizeof(stStress));
+  app_ring_init(&stStress.stRing, ePolicy);
+  *pu32Popped = 0;
+  *pu64PoppedSum = 0;
+  bFirst = true;
+  u32Last = 0;
+  s64StartUs = esp_timer_get_time();
+  TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(_test_ring_producer_task, "producer", 4096, NULL, 6, NULL));
+  do
+  {
+    bDone = atomic_load(&stStress.bDone);
+    while(ESP_OK == app_ring_pop(&stStress.stRing, &stTag))
+    {
+      TEST_ASSERT_TRUE(_test_ring_get_sequence(&stTag, &u32Sequence));
+      TEST_ASSERT_TRUE(bFirst || (u32Sequence > u32Last));
+      bFirst = false;
+      u32Last = u32Sequence;
+      (*pu32Popped)++;
+      *pu64PoppedSum += u32Sequence;
+    }
+  }while(!bDone);
+  app_ring_get_stats(&stStress.stRing, &stStats);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%u events in %lld ms, popped %u, dropped %u, high water %u",
+           TEST_RING_STRESS_EVENTS,
+           (long long)((esp_timer_get_time() - s64StartUs) / 1000),
+           *pu32Popped,
+           stStats.u32DroppedOldest + stStats.u32DroppedNewest,
+           stStats.u32HighWater);
+  TEST_MESSAGE(tcLine);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_ring_fifo_order(void)
+{
+  app_ring_t stRing;
+  app_ring_stats_t stStats;
+
+  app_ring_init(&stRing, APP_RING_DROP_OLDEST);
+  TEST_ASSERT_EQUAL_UINT32(0, app_ring_count(&stRing));
+  _test_ring_fill(&stRing, 100, 3);
+  TEST_ASSERT_EQUAL_UINT32(3, app_ring_count(&stRing));
+  _test_ring_expect(&stRing, 100, 3);
+  app_ring_get_stats(&stRing, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32Pushed);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32Popped);
+  TEST_ASSERT_EQUAL_UINT32(3, stStats.u32HighWater);
+}
+
+/* Indexes run past the capacity many times without losing the order */
+static void test_ring_wraps_around(void)
+{
+  uint32_t u32Round;
+  app_ring_t stRing;
+
+  app_ring_init(&stRing, APP_RING_DROP_NEWEST);
+  for(u32Round = 0; u32Round < 10; u32Round++)
+  {
+    _test_ring_fill(&stRing, u32Round * 1000, APP_RING_CAPACITY - 1);
+    _test_ring_expect(&stRing, u32Round * 1000, APP_RING_CAPACITY - 1);
+  }
+}
+
+static void test_ring_drop_oldest(void)
+{
+  app_ring_t stRing;
+  app_ring_stats_t stStats;
+
+  app_ring_init(&stRing, APP_RING_DROP_OLDEST);
+  _test_ring_fill(&stRing, 0, APP_RING_CAPACITY + 5);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY, app_ring_count(&stRing));
+  app_ring_get_stats(&stRing, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY + 5, stStats.u32Pushed);
+  TEST_ASSERT_EQUAL_UINT32(5, stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32DroppedNewest);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY, stStats.u32HighWater);
+  _test_ring_expect(&stRing, 5, APP_RING_CAPACITY);
+}
+
+static void test_ring_drop_newest(void)
+{
+  app_tag_t stTag;
+  app_ring_t stRing;
+  app_ring_stats_t stStats;
+
+  app_ring_init(&stRing, APP_RING_DROP_NEWEST);
+  _test_ring_fill(&stRing, 0, APP_RING_CAPACITY);
+  _test_ring_make_tag(APP_RING_CAPACITY, &stTag);
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_ring_push(&stRing, &stTag));
+  _test_ring_fill(&stRing, APP_RING_CAPACITY + 1, 4);
+  app_ring_get_stats(&stRing, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(APP_RING_CAPACITY, stStats.u32Pushed);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32DroppedOldest);
+  TEST_ASSERT_EQUAL_UINT32(5, stStats.u32DroppedNewest);
+  _test_ring_expect(&stRing, 0, APP_RING_CAPACITY);
+}
+
+static void test_ring_invalid_args(void)
+{
+  app_tag_t stTag;
+  app_ring_t stRing;
+
+  app_ring_init(&stRing, APP_RING_DROP_OLDEST);
+  memset(&stTag, 0x00, sizeof(stTag));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_ring_push(NULL, &stTag));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_ring_push(&stRing, NULL));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_ring_pop(NULL, &stTag));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_ring_pop(&stRing, NULL));
+}
+
+static void test_ring_stress_drop_oldest(void)
+{
+  uint32_t u32Popped;
+  uint64_t u64PoppedSum;
+  app_ring_stats_t stStats;
+
+  _test_ring_stress(APP_RING_DROP_OLDEST, &u32Popped, &u64PoppedSum);
+  app_ring_get_stats(&stStress.stRing, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_STRESS_EVENTS, stStats.u32Pushed);
+  TEST_ASSERT_EQUAL_UINT32(u32Popped, stStats.u32Popped);
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_STRESS_EVENTS, u32Popped + stStats.u32DroppedOldest);
+}
+
+static void test_ring_stress_drop_newest(void)
+{
+  uint32_t u32Popped;
+  uint64_t u64PoppedSum;
+  app_ring_stats_t stStats;
+
+  _test_ring_stress(APP_RING_DROP_NEWEST, &u32Popped, &u64PoppedSum);
+  app_ring_get_stats(&stStress.stRing, &stStats);
+  TEST_ASSERT_EQUAL_UINT32(stStress.u32Accepted, u32Popped);
+  TEST_ASSERT_EQUAL_UINT64(stStress.u64AcceptedSum, u64PoppedSum);
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_STRESS_EVENTS, u32Popped + stStats.u32DroppedNewest);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_fifo_order);
+  RUN_TEST(test_ring_wraps_around);
+  RUN_TEST(test_ring_drop_oldest);
+  RUN_TEST(test_ring_drop_newest);
+  RUN_TEST(test_ring_invalid_args);
+  RUN_TEST(test_ring_stress_drop_oldest);
+  RUN_TEST(test_ring_stress_drop_newest);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "app_sched.h"
+#include "host_shims.h"
+
+/* Threads of the host ignore priorities and cores, these tests check what the
+   plan asks FreeRTOS for. The scan latency it buys needs the board */
+#define TEST_SCHED_PLANNED_TASKS                 APP_SCHED_TASK_MONITOR
+#define TEST_SCHED_WAIT_MAX_MS                   1000
+#define TEST_SCHED_MONITOR_WAIT_MS               (5 * APP_SCHED_MONITOR_PERIOD_MS)
+
+typedef struct
+{
+  atomic_bool bStarted;
+  atomic_bool bSpin;
+  atomic_int s32Core;
+  atomic_uint u32Priority;
+  TaskHandle_t pstHandle;
+}sched_test_task_t;
+
+static sched_test_task_t tstTasks[APP_SCHED_TASK_COUNT];
+
+#ifdef APP_SCHED_NO_PLAN
+static const int ts32Cores[TEST_SCHED_PLANNED_TASKS] = {0, 0, 0, 0, 0};
+static const uint32_t tu32Priorities[TEST_SCHED_PLANNED_TASKS] = {5, 4, 6, 3, 2};
+static const uint32_t tu32Demoted[TEST_SCHED_PLANNED_TASKS] = {5, 4, 6, 3, 2};
+#else
+static const int ts32Cores[TEST_SCHED_PLANNED_TASKS] = {1, 0, 0, 0, 0};
+static const uint32_t tu32Priorities[TEST_SCHED_PLANNED_TASKS] = {6, 5, 3, 3, 2};
+static const uint32_t tu32Demoted[TEST_SCHED_PLANNED_TASKS] = {6, 5, 1, 1, 1};
+#endif
+
+/* Reports where it runs, then spins while asked to or sleeps */
+static void _test_sched_task(void *pvParameter)
+{
+  sched_test_task_t *pstTask;
+
+  pstTask = pvParameter;
+  pstTask->pstHandle = xTaskGetCurrentTaskHandle();
+  atomic_store(&pstTask->s32Core, xPortGetCoreID());
+  atomic_store(&pstTask->u32Priority, uxTaskPriorityGet(NULL));
+  atomic_store(&pstTask->bStarted, true);
+  while(1)
+  {
+    if(!atomic_load(&pstTask->bSpin))
+    {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+  }
+}
+
+static void _test_sched_wait_started(sched_test_task_t *pstTask)
+{
+  uint32_t u32WaitMs;
+
+  for(u32WaitMs = 0; !atomic_load(&pstTask->bStarted) && (u32WaitMs < TEST_SCHED_WAIT_MAX_MS); u32WaitMs++)
+  {
+    usleep(1000);
+  }
+  TEST_ASSERT_TRUE(atomic_load(&pstTask->bStarted));
+}
+
+static void _test_sched_expect_priorities(const uint32_t *pu32Expected)
+{
+  uint32_t u32Task;
+
+  for(u32Task = 0; u32Task < TEST_SCHED_PLANNED_TASKS; u32Task++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(pu32Expected[u32Task], uxTaskPriorityGet(tstTasks[u32Task].pstHandle));
+  }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Reader on core 1, network and background work on core 0 under it */
+static void test_sched_plan(void)
+{
+  uint32_t u32Task;
+
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_sched_create(APP_SCHED_TASK_COUNT, _test_sched_task, NULL));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_sched_create(APP_SCHED_TASK_READER, NULL, NULL));
+  for(u32Task = 0; u32Task < TEST_SCHED_PLANNED_TASKS; u32Task++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_sched_create(u32Task, _test_sched_task, &tstTasks[u32Task]));
+    _test_sched_wait_started(&tstTasks[u32Task]);
+    TEST_ASSERT_EQUAL_INT(ts32Cores[u32Task], atomic_load(&tstTasks[u32Task].s32Core));
+    TEST_ASSERT_EQUAL_UINT32(tu32Priorities[u32Task], atomic_load(&tstTasks[u32Task].u32Priority));
+  }
+}
+
+/* Background tasks drop to priority 1 while scans are waiting and get their
+   planned priority back, only a change of state touches them */
+static void test_sched_busy(void)
+{
+  app_sched_set_busy(true);
+  _test_sched_expect_priorities(tu32Demoted);
+  /* Changed behind its back, busy again must leave it */
+  vTaskPrioritySet(tstTasks[APP_SCHED_TASK_OTA].pstHandle, 4);
+  app_sched_set_busy(true);
+  TEST_ASSERT_EQUAL_UINT32(4, uxTaskPriorityGet(tstTasks[APP_SCHED_TASK_OTA].pstHandle));
+  vTaskPrioritySet(tstTasks[APP_SCHED_TASK_OTA].pstHandle, tu32Demoted[APP_SCHED_TASK_OTA]);
+  app_sched_set_busy(false);
+  _test_sched_expect_priorities(tu32Priorities);
+  app_sched_set_busy(false);
+  _test_sched_expect_priorities(tu32Priorities);
+}
+
+/* The monitor reports the CPU share of each task over its last period and
+   the stack it was given, host threads don't use it */
+static void test_sched_stats(void)
+{
+  char tcLine[96];
+  app_sched_task_stats_t stReader;
+  app_sched_task_stats_t stFirestore;
+
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_sched_get_stats(APP_SCHED_TASK_COUNT, &stReader));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_sched_get_stats(APP_SCHED_TASK_READER, NULL));
+  atomic_store(&tstTasks[APP_SCHED_TASK_READER].bSpin, true);
+  app_sched_start();
+  usleep(TEST_SCHED_MONITOR_WAIT_MS * 1000);
+  TEST_ASSERT_EQUAL(ESP_OK, app_sched_get_stats(APP_SCHED_TASK_READER, &stReader));
+  TEST_ASSERT_EQUAL(ESP_OK, app_sched_get_stats(APP_SCHED_TASK_FIRESTORE, &stFirestore));
+  atomic_store(&tstTasks[APP_SCHED_TASK_READER].bSpin, false);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "spinning reader: cpu %u%%, sleeping firestore: cpu %u%%",
+           stReader.u32CpuPercent,
+           stFirestore.u32CpuPercent);
+  TEST_MESSAGE(tcLine);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(50, stReader.u32CpuPercent);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(110, stReader.u32CpuPercent);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(10, stFirestore.u32CpuPercent);
+  TEST_ASSERT_EQUAL_UINT32(CONFIG_RFID_READER_TASK_STACK_SIZE, stReader.u32StackHighWaterMark);
+  TEST_ASSERT_EQUAL_UINT32(CONFIG_RFID_UPLOAD_TASK_STACK_SIZE, stFirestore.u32StackHighWaterMark);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_sched_plan);
+  RUN_TEST(test_sched_busy);
+  RUN_TEST(test_sched_stats);
+  return UNITY_END();
+}
\ No newline at end of file
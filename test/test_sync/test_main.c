@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <nvs.h>
+
+#include "app_index.h"
+#include "app_sync.h"
+#include "host_shims.h"
+
+/* The mock Firestore keeps the authorized_tags collection ordered like the
+   query asks, by updatedAt then by name, and answers :runQuery past the
+   startAt cursor. Three documents share each second so the name breaks the
+   ties. A request takes a round trip and the transfer of its answer on the
+   manual clock, over a weak link */
+#define TEST_SYNC_MAX_DOCUMENTS                  512
+#define TEST_SYNC_TAGS                           250
+#define TEST_SYNC_PAGE_SIZE                      100
+#define TEST_SYNC_RTT_MS                         80
+#define TEST_SYNC_BYTES_PER_MS                   100
+#define TEST_SYNC_CHUNK_SIZE                     256
+#define TEST_SYNC_RESPONSE_MAX_SIZE              (TEST_SYNC_PAGE_SIZE * 400)
+#define TEST_SYNC_DATABASE                       "projects/rfid-test/databases/(default)/documents"
+#define TEST_SYNC_NAME_FORMAT                    TEST_SYNC_DATABASE "/authorized_tags/tag%04u"
+
+typedef struct
+{
+  uint32_t u32Number;
+  uint32_t u32UpdatedAt;
+  uint32_t u32Flags;
+  bool bRevoked;
+}sync_doc_t;
+
+typedef struct
+{
+  sync_doc_t tstDocs[TEST_SYNC_MAX_DOCUMENTS];
+  uint32_t u32Docs;
+  uint32_t u32Clock;
+  uint32_t u32Requests;
+  /* The request that gets a 503, 0 for none */
+  uint32_t u32FailAt;
+  char tcCursorTimestamp[40];
+  char tcCursorName[128];
+  char tcResponse[TEST_SYNC_RESPONSE_MAX_SIZE];
+}sync_backend_t;
+
+static sync_backend_t stBackend;
+
+/* Distinct 7 byte UIDs from a counter run through an LCG */
+static void _test_sync_make_uid(uint32_t u32Number, uint8_t *pu08Uid)
+{
+  uint32_t u32Value;
+
+  u32Value = u32Number * 1664525UL + 1013904223UL;
+  pu08Uid[0] = 0x04;
+  memcpy(&pu08Uid[1], &u32Value, sizeof(u32Value));
+  pu08Uid[5] = (uint8_t)(u32Number >> 24);
+  pu08Uid[6] = 0x5A;
+}
+
+static void _test_sync_format_timestamp(uint32_t u32UpdatedAt, char *pcTimestamp, uint32_t u32Size)
+{
+  snprintf(pcTimestamp,
+           u32Size,
+           "2026-03-01T%02u:%02u:%02u.000000Z",
+           (u32UpdatedAt / 3600) % 24,
+           (u32UpdatedAt / 60) % 60,
+           u32UpdatedAt % 60);
+}
+
+static int _test_sync_compare(const void *pvA, const void *pvB)
+{
+  const sync_doc_t *pstA;
+  const sync_doc_t *pstB;
+
+  pstA = pvA;
+  pstB = pvB;
+  return (pstA->u32UpdatedAt != pstB->u32UpdatedAt)?((pstA->u32UpdatedAt < pstB->u32UpdatedAt)?-1:1):
+                                                    ((pstA->u32Number < pstB->u32Number)?-1:1);
+}
+
+/* An added or changed document goes to the end of the collection order */
+static void _test_sync_touch(uint32_t u32Number, uint32_t u32Flags, bool bRevoked)
+{
+  uint32_t u32Index;
+  sync_doc_t *pstDoc;
+
+  pstDoc = NULL;
+  for(u32Index = 0; (u32Index < stBackend.u32Docs) && (NULL == pstDoc); u32Index++)
+  {
+    pstDoc = (stBackend.tstDocs[u32Index].u32Number == u32Number)?&stBackend.tstDocs[u32Index]:NULL;
+  }
+  if(NULL == pstDoc)
+  {
+    pstDoc = &stBackend.tstDocs[stBackend.u32Docs++];
+    pstDoc->u32Number = u32Number;
+  }
+  pstDoc->u32UpdatedAt = stBackend.u32Clock++ / 3;
+  pstDoc->u32Flags = u32Flags;
+  pstDoc->bRevoked = bRevoked;
+  qsort(stBackend.tstDocs, stBackend.u32Docs, sizeof(sync_doc_t), _test_sync_compare);
+}
+
+/* Later changes land in a later second than the watermark */
+static void _test_sync_next_second(void)
+{
+  stBackend.u32Clock += 3 - (stBackend.u32Clock % 3);
+}
+
+/* Copies the string value that follows pcKey in the query */
+static void _test_sync_get_value(const char *pcBody, const char *pcKey, char *pcValue, uint32_t u32Size)
+{
+  const char *pcStart;
+  const char *pcEnd;
+
+  pcValue[0] = '\0';
+  pcStart = strstr(pcBody, pcKey);
+  if(pcStart)
+  {
+    pcStart += strlen(pcKey);
+    pcEnd = strchr(pcStart, '"');
+    TEST_ASSERT_NOT_NULL(pcEnd);
+    TEST_ASSERT_LESS_THAN_UINT32(u32Size, pcEnd - pcStart);
+    memcpy(pcValue, pcStart, pcEnd - pcStart);
+    pcValue[pcEnd - pcStart] = '\0';
+  }
+}
+
+static int _test_sync_backend(esp_http_client_method_t eMethod,
+                              const char *pcPath,
+                              const char *pcBody,
+                              uint32_t u32Length,
+                              app_conn_data_cb_t pfDataCb,
+                              void *pvArg)
+{
+  int s32Status;
+  uint32_t u32Index;
+  uint32_t u32Limit;
+  uint32_t u32Sent;
+  uint32_t u32Size;
+  uint32_t u32Chunk;
+  char tcName[128];
+  char tcTimestamp[40];
+  const char *pcLimit;
+  const sync_doc_t *pstDoc;
+  uint8_t tu08Uid[7];
+
+  TEST_ASSERT_EQUAL(HTTP_METHOD_POST, eMethod);
+  TEST_ASSERT_EQUAL_STRING(":runQuery", pcPath);
+  TEST_ASSERT_NOT_NULL(strstr(pcBody, "\"collectionId\":\"authorized_tags\""));
+  stBackend.u32Requests++;
+  _test_sync_get_value(pcBody, "{\"timestampValue\":\"", stBackend.tcCursorTimestamp, sizeof(stBackend.tcCursorTimestamp));
+  _test_sync_get_value(pcBody, "{\"referenceValue\":\"", stBackend.tcCursorName, sizeof(stBackend.tcCursorName));
+  pcLimit = strstr(pcBody, "\"limit\":");
+  TEST_ASSERT_NOT_NULL(pcLimit);
+  u32Limit = strtoul(pcLimit + strlen("\"limit\":"), NULL, 10);
+  u32Size = 0;
+  u32Sent = 0;
+  if(stBackend.u32Requests == stBackend.u32FailAt)
+  {
+    s32Status = 503;
+  }
+  else
+  {
+    s32Status = 200;
+    u32Size += snprintf(&stBackend.tcResponse[u32Size], sizeof(stBackend.tcResponse) - u32Size, "[");
+    for(u32Index = 0; (u32Index < stBackend.u32Docs) && (u32Sent < u32Limit); u32Index++)
+    {
+      pstDoc = &stBackend.tstDocs[u32Index];
+      _test_sync_format_timestamp(pstDoc->u32UpdatedAt, tcTimestamp, sizeof(tcTimestamp));
+      snprintf(tcName, sizeof(tcName), TEST_SYNC_NAME_FORMAT, pstDoc->u32Number);
+      /* Strictly past the cursor */
+      if(stBackend.tcCursorName[0] &&
+         ((strcmp(tcTimestamp, stBackend.tcCursorTimestamp) < 0) ||
+          ((0 == strcmp(tcTimestamp, stBackend.tcCursorTimestamp)) && (strcmp(tcName, stBackend.tcCursorName) <= 0))))
+      {
+        continue;
+      }
+      _test_sync_make_uid(pstDoc->u32Number, tu08Uid);
+      u32Size += snprintf(&stBackend.tcResponse[u32Size],
+                          sizeof(stBackend.tcResponse) - u32Size,
+                          "%s{\"document\":{\"name\":\"%s\",\"fields\":{"
+                          "\"uid\":{\"stringValue\":\"%02X%02X%02X%02X%02X%02X%02X\"},"
+                          "\"flags\":{\"integerValue\":\"%u\"},"
+                          "\"revoked\":{\"booleanValue\":%s},"
+                          "\"updatedAt\":{\"timestampValue\":\"%s\"}},"
+                          "\"createTime\":\"2026-01-01T00:00:00.000000Z\",\"updateTime\":\"%s\"},"
+                          "\"readTime\":\"2026-03-02T00:00:00.000000Z\"}",
+                          u32Sent?",":"",
+                          tcName,
+                          tu08Uid[0], tu08Uid[1], tu08Uid[2], tu08Uid[3], tu08Uid[4], tu08Uid[5], tu08Uid[6],
+                          pstDoc->u32Flags,
+                          pstDoc->bRevoked?"true":"false",
+                          tcTimestamp,
+                          tcTimestamp);
+      u32Sent++;
+    }
+    if(0 == u32Sent)
+    {
+      u32Size += snprintf(&stBackend.tcResponse[u32Size],
+                          sizeof(stBackend.tcResponse) - u32Size,
+                          "{\"readTime\":\"2026-03-02T00:00:00.000000Z\"}");
+    }
+    u32Size += snprintf(&stBackend.tcResponse[u32Size], sizeof(stBackend.tcResponse) - u32Size, "]");
+    TEST_ASSERT_LESS_THAN_UINT32(sizeof(stBackend.tcResponse), u32Size);
+    for(u32Index = 0; u32Index < u32Size; u32Index += u32Chunk)
+    {
+      u32Chunk = ((u32Size - u32Index) < TEST_SYNC_CHUNK_SIZE)?(u32Size - u32Index):TEST_SYNC_CHUNK_SIZE;
+      pfDataCb(&stBackend.tcResponse[u32Index], u32Chunk, pvArg);
+    }
+  }
+  host_time_advance_us((TEST_SYNC_RTT_MS + (u32Length + u32Size) / TEST_SYNC_BYTES_PER_MS) * 1000LL);
+  return s32Status;
+}
+
+static bool _test_sync_has(uint32_t u32Number, uint32_t *pu32Flags)
+{
+  uint8_t tu08Uid[7];
+
+  _test_sync_make_uid(u32Number, tu08Uid);
+  return ESP_OK == app_index_lookup(tu08Uid, sizeof(tu08Uid), pu32Flags, 0);
+}
+
+/* Runs a sync and reports what it cost */
+static esp_err_t _test_sync_run(const char *pcName, uint32_t *pu32Documents)
+{
+  char tcLine[160];
+  esp_err_t s32RetVal;
+  app_sync_stats_t stBefore;
+  app_sync_stats_t stAfter;
+
+  app_sync_get_stats(&stBefore);
+  stBackend.u32Requests = 0;
+  s32RetVal = app_sync_run();
+  app_sync_get_stats(&stAfter);
+  *pu32Documents = stAfter.u32Documents - stBefore.u32Documents;
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-12s %3u documents in %u requests: %5u bytes sent, %6u bytes received, %5u ms",
+           pcName,
+           *pu32Documents,
+           stBackend.u32Requests,
+           stAfter.u32BytesSent - stBefore.u32BytesSent,
+           stAfter.u32BytesReceived - stBefore.u32BytesReceived,
+           stAfter.u32LastDurationMs);
+  TEST_MESSAGE(tcLine);
+  return s32RetVal;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Without an index the whole collection comes down page by page and the
+   last document is kept in NVS as the watermark */
+static void test_sync_full(void)
+{
+  uint32_t u32Index;
+  uint32_t u32Flags;
+  uint32_t u32Documents;
+  size_t u32Size;
+  char tcValue[128];
+  char tcExpected[128];
+  nvs_handle_t u32Handle;
+
+  host_flash_reset();
+  host_nvs_reset();
+  host_time_set_manual(0);
+  host_conn_set_handler(_test_sync_backend);
+  memset(&stBackend, 0x00, sizeof(stBackend));
+  for(u32Index = 0; u32Index < TEST_SYNC_TAGS; u32Index++)
+  {
+    _test_sync_touch(u32Index, u32Index % 4, false);
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_index_init());
+  TEST_ASSERT_EQUAL(ESP_OK, _test_sync_run("full", &u32Documents));
+  TEST_ASSERT_EQUAL_UINT32(TEST_SYNC_TAGS, u32Documents);
+  TEST_ASSERT_EQUAL_UINT32((TEST_SYNC_TAGS / TEST_SYNC_PAGE_SIZE) + 1, stBackend.u32Requests);
+  TEST_ASSERT_EQUAL_UINT32(TEST_SYNC_TAGS, app_index_get_count());
+  for(u32Index = 0; u32Index < TEST_SYNC_TAGS; u32Index++)
+  {
+    TEST_ASSERT_TRUE(_test_sync_has(u32Index, &u32Flags));
+    TEST_ASSERT_EQUAL_UINT32(u32Index % 4, u32Flags);
+  }
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_open("app_sync", NVS_READONLY, &u32Handle));
+  u32Size = sizeof(tcValue);
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_get_str(u32Handle, "name", tcValue, &u32Size));
+  snprintf(tcExpected, sizeof(tcExpected), TEST_SYNC_NAME_FORMAT, TEST_SYNC_TAGS - 1);
+  TEST_ASSERT_EQUAL_STRING(tcExpected, tcValue);
+  u32Size = sizeof(tcValue);
+  TEST_ASSERT_EQUAL(ESP_OK, nvs_get_str(u32Handle, "ts", tcValue, &u32Size));
+  _test_sync_format_timestamp((TEST_SYNC_TAGS - 1) / 3, tcExpected, sizeof(tcExpected));
+  TEST_ASSERT_EQUAL_STRING(tcExpected, tcValue);
+  nvs_close(u32Handle);
+}
+
+/* Only what changed past the watermark comes down: revoked tags leave the
+   index, changed flags and new tags are applied. Nothing is sent again when
+   nothing changed */
+static void test_sync_delta(void)
+{
+  uint32_t u32Flags;
+  uint32_t u32Documents;
+  char tcExpected[128];
+
+  _test_sync_next_second();
+  _test_sync_touch(3, 0, true);
+  _test_sync_touch(77, 0, true);
+  _test_sync_touch(10, 9, false);
+  _test_sync_touch(TEST_SYNC_TAGS, 1, false);
+  _test_sync_touch(TEST_SYNC_TAGS + 1, 2, false);
+  TEST_ASSERT_EQUAL(ESP_OK, _test_sync_run("delta", &u32Documents));
+  TEST_ASSERT_EQUAL_UINT32(5, u32Documents);
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Requests);
+  snprintf(tcExpected, sizeof(tcExpected), TEST_SYNC_NAME_FORMAT, TEST_SYNC_TAGS - 1);
+  TEST_ASSERT_EQUAL_STRING(tcExpected, stBackend.tcCursorName);
+  TEST_ASSERT_FALSE(_test_sync_has(3, NULL));
+  TEST_ASSERT_FALSE(_test_sync_has(77, NULL));
+  TEST_ASSERT_TRUE(_test_sync_has(10, &u32Flags));
+  TEST_ASSERT_EQUAL_UINT32(9, u32Flags);
+  TEST_ASSERT_TRUE(_test_sync_has(TEST_SYNC_TAGS + 1, &u32Flags));
+  TEST_ASSERT_EQUAL_UINT32(2, u32Flags);
+  TEST_ASSERT_EQUAL_UINT32(TEST_SYNC_TAGS, app_index_get_count());
+  TEST_ASSERT_EQUAL(ESP_OK, _test_sync_run("no change", &u32Documents));
+  TEST_ASSERT_EQUAL_UINT32(0, u32Documents);
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Requests);
+}
+
+/* A page that fails ends the run, the next one starts from the watermark of
+   the last page that went through instead of from the start */
+static void test_sync_resume(void)
+{
+  uint32_t u32Index;
+  uint32_t u32Documents;
+  char tcExpected[128];
+
+  _test_sync_next_second();
+  for(u32Index = 0; u32Index < 150; u32Index++)
+  {
+    _test_sync_touch(300 + u32Index, 0, false);
+  }
+  stBackend.u32FailAt = 2;
+  TEST_ASSERT_EQUAL(ESP_FAIL, _test_sync_run("interrupted", &u32Documents));
+  TEST_ASSERT_EQUAL_UINT32(TEST_SYNC_PAGE_SIZE, u32Documents);
+  TEST_ASSERT_TRUE(_test_sync_has(300 + TEST_SYNC_PAGE_SIZE - 1, NULL));
+  TEST_ASSERT_FALSE(_test_sync_has(300 + TEST_SYNC_PAGE_SIZE, NULL));
+  stBackend.u32FailAt = 0;
+  TEST_ASSERT_EQUAL(ESP_OK, _test_sync_run("resumed", &u32Documents));
+  TEST_ASSERT_EQUAL_UINT32(150 - TEST_SYNC_PAGE_SIZE, u32Documents);
+  TEST_ASSERT_EQUAL_UINT32(1, stBackend.u32Requests);
+  snprintf(tcExpected, sizeof(tcExpected), TEST_SYNC_NAME_FORMAT, 300 + TEST_SYNC_PAGE_SIZE - 1);
+  TEST_ASSERT_EQUAL_STRING(tcExpected, stBackend.tcCursorName);
+  TEST_ASSERT_TRUE(_test_sync_has(449, NULL));
+  TEST_ASSERT_EQUAL_UINT32(TEST_SYNC_TAGS + 150, app_index_get_count());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_sync_full);
+  RUN_TEST(test_sync_delta);
+  RUN_TEST(test_sync_resume);
+  return UNITY_END();
+}
\ No newline at end of file
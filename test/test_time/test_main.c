@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+
+#include "app_hist.h"
+#include "app_time.h"
+#include "host_shims.h"
+
+/* The service is started once for the whole file, the tests run in order:
+   never set, kept by the RTC, synced, resynced */
+#define TEST_TIME_BOOT_US                        1000000LL
+#define TEST_TIME_RTC_UNIX_US                    1700000000000000LL
+#define TEST_TIME_NTP_UNIX_US                    (TEST_TIME_RTC_UNIX_US + 2500000LL)
+#define TEST_TIME_GRACE_US                       (120 * 1000000LL)
+#define TEST_TIME_RESYNC_US                      (3600 * 1000000LL)
+#define TEST_TIME_BENCH_STAMPS                   100000
+#define TEST_TIME_MAX_STAMP_US                   100
+
+/* A stamp that waited for SNTP would have moved the manual clock, on the real
+   clock the stamping time is printed for each state */
+static void _test_time_bench(const char *pcState, esp_err_t s32Expected)
+{
+  uint32_t u32Index;
+  int64_t s64StartUs;
+  int64_t s64CaptureUs;
+  int64_t s64Timestamp;
+  char tcLine[128];
+  app_hist_t stLatency;
+
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < 1000; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(s32Expected, app_time_to_unix_ms(s64StartUs, &s64Timestamp));
+    app_time_is_pending();
+  }
+  TEST_ASSERT_EQUAL_INT64(s64StartUs, esp_timer_get_time());
+  host_time_set_real();
+  app_hist_reset(&stLatency);
+  s64StartUs = esp_timer_get_time();
+  for(u32Index = 0; u32Index < TEST_TIME_BENCH_STAMPS; u32Index++)
+  {
+    s64CaptureUs = esp_timer_get_time();
+    app_time_to_unix_ms(s64CaptureUs, &s64Timestamp);
+    app_time_is_pending();
+    app_hist_record(&stLatency, (uint32_t)(esp_timer_get_time() - s64CaptureUs));
+  }
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "%-8s stamp %3d ns on average, p99 %u us, max %u us",
+           pcState,
+           (int)(((esp_timer_get_time() - s64StartUs) * 1000) / TEST_TIME_BENCH_STAMPS),
+           app_hist_percentile(&stLatency, 99),
+           stLatency.u32Max);
+  TEST_MESSAGE(tcLine);
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_TIME_MAX_STAMP_US, app_hist_percentile(&stLatency, 99));
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Without a wall clock scans wait, but only during the grace period */
+static void test_time_never_set(void)
+{
+  int64_t s64Timestamp;
+
+  host_time_set_manual(TEST_TIME_BOOT_US);
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_time_to_unix_ms(TEST_TIME_BOOT_US, &s64Timestamp));
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_time_to_unix_ms(TEST_TIME_BOOT_US, NULL));
+  TEST_ASSERT_TRUE(app_time_is_pending());
+  host_time_advance_us(TEST_TIME_GRACE_US);
+  TEST_ASSERT_FALSE(app_time_is_pending());
+  _test_time_bench("unset", ESP_ERR_INVALID_STATE);
+}
+
+/* Starting never waits for the network, the clock the RTC kept across the
+   reset is used until the first sync */
+static void test_time_start_from_rtc(void)
+{
+  int64_t s64Timestamp;
+  app_time_stats_t stStats;
+
+  host_time_set_manual(TEST_TIME_BOOT_US);
+  host_rtc_set(TEST_TIME_RTC_UNIX_US);
+  app_time_start();
+  TEST_ASSERT_EQUAL_INT64(TEST_TIME_BOOT_US, esp_timer_get_time());
+  TEST_ASSERT_FALSE(app_time_is_pending());
+  host_time_advance_us(500000);
+  TEST_ASSERT_EQUAL(ESP_OK, app_time_to_unix_ms(TEST_TIME_BOOT_US + 500000, &s64Timestamp));
+  TEST_ASSERT_EQUAL_INT64((TEST_TIME_RTC_UNIX_US + 500000) / 1000, s64Timestamp);
+  app_time_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32Syncs);
+}
+
+/* Scans taken before the sync are stamped with the offset it measured */
+static void test_time_first_sync(void)
+{
+  int64_t s64CaptureUs;
+  int64_t s64Timestamp;
+  app_time_stats_t stStats;
+
+  host_time_set_manual(TEST_TIME_BOOT_US + 2000000);
+  s64CaptureUs = esp_timer_get_time();
+  host_time_advance_us(3000000);
+  host_sntp_sync(TEST_TIME_NTP_UNIX_US + 5000000);
+  TEST_ASSERT_EQUAL(ESP_OK, app_time_to_unix_ms(s64CaptureUs, &s64Timestamp));
+  TEST_ASSERT_EQUAL_INT64((TEST_TIME_NTP_UNIX_US + 2000000) / 1000, s64Timestamp);
+  app_time_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Syncs);
+  TEST_ASSERT_EQUAL_INT64(TEST_TIME_NTP_UNIX_US - TEST_TIME_BOOT_US, stStats.s64OffsetUs);
+  TEST_ASSERT_EQUAL_INT64(TEST_TIME_NTP_UNIX_US - TEST_TIME_RTC_UNIX_US, stStats.s64LastStepUs);
+  TEST_ASSERT_EQUAL_INT64(TEST_TIME_BOOT_US + 5000000, stStats.s64LastSyncUs);
+  TEST_ASSERT_EQUAL_INT32(0, stStats.s32DriftPpb);
+  _test_time_bench("synced", ESP_OK);
+}
+
+/* esp_timer running 10 ppm slow shows up as a step and a drift at the
+   hourly resync */
+static void test_time_resync_drift(void)
+{
+  int64_t s64SyncUs;
+  app_time_stats_t stBefore;
+  app_time_stats_t stAfter;
+
+  app_time_get_stats(&stBefore);
+  s64SyncUs = stBefore.s64LastSyncUs + TEST_TIME_RESYNC_US;
+  host_time_set_manual(s64SyncUs);
+  host_sntp_sync(s64SyncUs + stBefore.s64OffsetUs + (TEST_TIME_RESYNC_US / 100000));
+  app_time_get_stats(&stAfter);
+  TEST_ASSERT_EQUAL_UINT32(2, stAfter.u32Syncs);
+  TEST_ASSERT_EQUAL_INT64(TEST_TIME_RESYNC_US / 100000, stAfter.s64LastStepUs);
+  TEST_ASSERT_EQUAL_INT32(10000, stAfter.s32DriftPpb);
+  TEST_ASSERT_FALSE(app_time_is_pending());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_time_never_set);
+  RUN_TEST(test_time_start_from_rtc);
+  RUN_TEST(test_time_first_sync);
+  RUN_TEST(test_time_resync_drift);
+  return UNITY_END();
+}
\ No newline at end of file
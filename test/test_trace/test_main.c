@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include <unity.h>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+
+#include "app_hist.h"
+#include "app_trace.h"
+#include "host_shims.h"
+
+/* The trace task runs on the manual clock and is held inside its uploads, the
+   clock only moves with the test meanwhile */
+#define TEST_TRACE_CPU_MHZ                       240
+#define TEST_TRACE_RING_SIZE                     128
+#define TEST_TRACE_BLOB_MAX_SIZE                 1536
+#define TEST_TRACE_WAIT_MAX_MS                   10000
+#define TEST_TRACE_HEADER_SIZE                   17
+#define TEST_TRACE_POINT_HEADER_SIZE             10
+#define TEST_TRACE_BUCKET_SIZE                   5
+
+typedef struct
+{
+  uint32_t u32Count;
+  uint32_t u32Max;
+  app_hist_t stHist;
+}trace_point_t;
+
+/* Decoded the way tools/trace_decoder.py does */
+typedef struct
+{
+  uint32_t u32Magic;
+  uint8_t u08Version;
+  uint8_t u08SubBucketBits;
+  uint16_t u16CpuMhz;
+  uint32_t u32Dropped;
+  uint8_t u08PointCount;
+  trace_point_t tstPoints[APP_TRACE_POINT_COUNT];
+}trace_blob_t;
+
+typedef struct
+{
+  atomic_uint u32Uploads;
+  atomic_uint u32Released;
+  atomic_int s32HttpCode;
+  char tcPath[32];
+  char tcBase64[2 * TEST_TRACE_BLOB_MAX_SIZE];
+}trace_backend_t;
+
+static trace_backend_t stBackend;
+
+/* Keeps the base64 blob of the upload and holds the task until released */
+static int _test_trace_backend(esp_http_client_method_t eMethod,
+                               const char *pcPath,
+                               const char *pcBody,
+                               uint32_t u32BodyLength,
+                               app_conn_data_cb_t pfDataCb,
+                               void *pvArg)
+{
+  uint32_t u32Upload;
+  const char *pcStart;
+  const char *pcEnd;
+
+  snprintf(stBackend.tcPath, sizeof(stBackend.tcPath), "%s", pcPath);
+  pcStart = strstr(pcBody, "\"bytesValue\":\"");
+  pcStart = pcStart?(pcStart + strlen("\"bytesValue\":\"")):pcBody;
+  pcEnd = strchr(pcStart, '"');
+  pcEnd = pcEnd?pcEnd:pcStart;
+  snprintf(stBackend.tcBase64, sizeof(stBackend.tcBase64), "%.*s", (int)(pcEnd - pcStart), pcStart);
+  u32Upload = atomic_fetch_add(&stBackend.u32Uploads, 1) + 1;
+  while(atomic_load(&stBackend.u32Released) < u32Upload)
+  {
+    usleep(100);
+  }
+  return atomic_load(&stBackend.s32HttpCode);
+}
+
+static void _test_trace_wait_upload(uint32_t u32Upload)
+{
+  uint32_t u32WaitMs;
+
+  for(u32WaitMs = 0; (atomic_load(&stBackend.u32Uploads) < u32Upload) && (u32WaitMs < TEST_TRACE_WAIT_MAX_MS); u32WaitMs++)
+  {
+    usleep(1000);
+  }
+  TEST_ASSERT_LESS_THAN_UINT32(TEST_TRACE_WAIT_MAX_MS, u32WaitMs);
+}
+
+static uint32_t _test_trace_base64_decode(const char *pcText, uint8_t *pu08Data)
+{
+  uint32_t u32Length;
+  uint32_t u32Bits;
+  uint32_t u32Count;
+  const char *pcDigit;
+  static const char tcDigits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  u32Length = 0;
+  u32Bits = 0;
+  u32Count = 0;
+  for(; *pcText && ('=' != *pcText); pcText++)
+  {
+    pcDigit = strchr(tcDigits, *pcText);
+    TEST_ASSERT_NOT_NULL(pcDigit);
+    u32Bits = (u32Bits << 6) | (uint32_t)(pcDigit - tcDigits);
+    u32Count += 6;
+    if(u32Count >= 8)
+    {
+      u32Count -= 8;
+      pu08Data[u32Length++] = (uint8_t)(u32Bits >> u32Count);
+    }
+  }
+  return u32Length;
+}
+
+static uint32_t _test_trace_get(const uint8_t *pu08Blob, uint32_t *pu32Offset, uint32_t u32Size)
+{
+  uint32_t u32Value;
+
+  u32Value = 0;
+  memcpy(&u32Value, &pu08Blob[*pu32Offset], u32Size);
+  *pu32Offset += u32Size;
+  return u32Value;
+}
+
+static void _test_trace_decode(const char *pcBase64, trace_blob_t *pstBlob)
+{
+  uint32_t u32Length;
+  uint32_t u32Offset;
+  uint32_t u32Point;
+  uint32_t u32Bucket;
+  uint32_t u32Buckets;
+  uint8_t tu08Blob[TEST_TRACE_BLOB_MAX_SIZE];
+
+  memset(pstBlob, 0x00, sizeof(trace_blob_t));
+  u32Length = _test_trace_base64_decode(pcBase64, tu08Blob);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_TRACE_HEADER_SIZE, u32Length);
+  u32Offset = 0;
+  pstBlob->u32Magic = _test_trace_get(tu08Blob, &u32Offset, 4);
+  pstBlob->u08Version = _test_trace_get(tu08Blob, &u32Offset, 1);
+  pstBlob->u08SubBucketBits = _test_trace_get(tu08Blob, &u32Offset, 1);
+  pstBlob->u16CpuMhz = _test_trace_get(tu08Blob, &u32Offset, 2);
+  _test_trace_get(tu08Blob, &u32Offset, 4);
+  pstBlob->u32Dropped = _test_trace_get(tu08Blob, &u32Offset, 4);
+  pstBlob->u08PointCount = _test_trace_get(tu08Blob, &u32Offset, 1);
+  while(u32Offset < u32Length)
+  {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(u32Length, u32Offset + TEST_TRACE_POINT_HEADER_SIZE);
+    u32Point = _test_trace_get(tu08Blob, &u32Offset, 1);
+    TEST_ASSERT_LESS_THAN_UINT32(APP_TRACE_POINT_COUNT, u32Point);
+    pstBlob->tstPoints[u32Point].u32Count = _test_trace_get(tu08Blob, &u32Offset, 4);
+    pstBlob->tstPoints[u32Point].u32Max = _test_trace_get(tu08Blob, &u32Offset, 4);
+    pstBlob->tstPoints[u32Point].stHist.u32Count = pstBlob->tstPoints[u32Point].u32Count;
+    for(u32Buckets = _test_trace_get(tu08Blob, &u32Offset, 1); u32Buckets; u32Buckets--)
+    {
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(u32Length, u32Offset + TEST_TRACE_BUCKET_SIZE);
+      u32Bucket = _test_trace_get(tu08Blob, &u32Offset, 1);
+      pstBlob->tstPoints[u32Point].stHist.tu32Buckets[u32Bucket] = _test_trace_get(tu08Blob, &u32Offset, 4);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(u32Length, u32Offset);
+}
+
+/* The value must fall in a bucket whose limit is at most 25% above it */
+static void _test_trace_expect_value(const trace_point_t *pstPoint, uint32_t u32Cycles)
+{
+  uint32_t u32Limit;
+
+  TEST_ASSERT_EQUAL_UINT32(1, pstPoint->u32Count);
+  TEST_ASSERT_EQUAL_UINT32(u32Cycles, pstPoint->u32Max);
+  u32Limit = app_hist_percentile(&pstPoint->stHist, 100);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(u32Cycles, u32Limit);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(u32Cycles + (u32Cycles / 4), u32Limit);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* Every value lands in a bucket at most 25% wide, percentiles take the limit
+   of the bucket holding the rank */
+static void test_trace_hist_buckets(void)
+{
+  uint32_t u32Value;
+  uint32_t u32Limit;
+  app_hist_t stHist;
+
+  for(u32Value = 1; u32Value < 0x80000000; u32Value += (u32Value / 7) + 1)
+  {
+    app_hist_reset(&stHist);
+    app_hist_record(&stHist, u32Value);
+    u32Limit = app_hist_percentile(&stHist, 50);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(u32Value, u32Limit);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(u32Value + (u32Value / 4), u32Limit);
+  }
+  app_hist_reset(&stHist);
+  app_hist_record(&stHist, UINT32_MAX);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, app_hist_percentile(&stHist, 100));
+  app_hist_reset(&stHist);
+  TEST_ASSERT_EQUAL_UINT32(0, app_hist_percentile(&stHist, 99));
+  for(u32Value = 1; u32Value <= 1000; u32Value++)
+  {
+    app_hist_record(&stHist, u32Value);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000, stHist.u32Count);
+  TEST_ASSERT_EQUAL_UINT32(1000, stHist.u32Max);
+  TEST_ASSERT_UINT32_WITHIN(500 / 4, 500, app_hist_percentile(&stHist, 50));
+  TEST_ASSERT_UINT32_WITHIN(990 / 4, 990, app_hist_percentile(&stHist, 99));
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(990, app_hist_percentile(&stHist, 99));
+}
+
+/* Spans in cycles, durations from esp_timer, a span that moved to the other
+   core and a full ring all end up in the next upload */
+static void test_trace_upload(void)
+{
+  uint32_t u32Index;
+  char tcLine[2 * TEST_TRACE_BLOB_MAX_SIZE + 16];
+  trace_blob_t stBlob;
+  app_trace_span_t stSpan;
+
+  host_time_set_manual(1000000);
+  atomic_store(&stBackend.s32HttpCode, 200);
+  host_conn_set_handler(_test_trace_backend);
+  app_trace_start();
+  /* The first window is empty, the task is held in its upload */
+  _test_trace_wait_upload(1);
+  _test_trace_decode(stBackend.tcBase64, &stBlob);
+  TEST_ASSERT_EQUAL_STRING("/traces/rfid-node", stBackend.tcPath);
+  TEST_ASSERT_EQUAL_UINT32(0, stBlob.tstPoints[APP_TRACE_TAG_HANDLER].u32Count);
+  app_trace_begin(&stSpan);
+  host_time_advance_us(100);
+  app_trace_end(&stSpan, APP_TRACE_TAG_HANDLER);
+  host_time_advance_us(40);
+  app_trace_end(&stSpan, APP_TRACE_FORMAT);
+  app_trace_record_us(APP_TRACE_REQUEST, 30000);
+  app_trace_record_us(APP_TRACE_WAIT, 3600000000LL);
+  /* A span that ends on the other core is dropped, events of both cores are
+     drained */
+  app_trace_begin(&stSpan);
+  host_task_set_core(1);
+  app_trace_end(&stSpan, APP_TRACE_SEND);
+  app_trace_record_us(APP_TRACE_RECEIVE, 2000);
+  host_task_set_core(0);
+  for(u32Index = 0; u32Index < TEST_TRACE_RING_SIZE; u32Index++)
+  {
+    app_trace_record_us(APP_TRACE_QUEUE_DWELL, 10 + u32Index);
+  }
+  atomic_store(&stBackend.u32Released, 1);
+  _test_trace_wait_upload(2);
+  _test_trace_decode(stBackend.tcBase64, &stBlob);
+  TEST_ASSERT_EQUAL_HEX32(0x31435254, stBlob.u32Magic);
+  TEST_ASSERT_EQUAL_UINT8(1, stBlob.u08Version);
+  TEST_ASSERT_EQUAL_UINT8(APP_HIST_SUB_BUCKET_BITS, stBlob.u08SubBucketBits);
+  TEST_ASSERT_EQUAL_UINT16(TEST_TRACE_CPU_MHZ, stBlob.u16CpuMhz);
+  TEST_ASSERT_EQUAL_UINT8(APP_TRACE_POINT_COUNT, stBlob.u08PointCount);
+  _test_trace_expect_value(&stBlob.tstPoints[APP_TRACE_TAG_HANDLER], 100 * TEST_TRACE_CPU_MHZ);
+  _test_trace_expect_value(&stBlob.tstPoints[APP_TRACE_FORMAT], 40 * TEST_TRACE_CPU_MHZ);
+  _test_trace_expect_value(&stBlob.tstPoints[APP_TRACE_REQUEST], 30000 * TEST_TRACE_CPU_MHZ);
+  _test_trace_expect_value(&stBlob.tstPoints[APP_TRACE_RECEIVE], 2000 * TEST_TRACE_CPU_MHZ);
+  /* Saturated instead of wrapped */
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, stBlob.tstPoints[APP_TRACE_WAIT].u32Max);
+  TEST_ASSERT_EQUAL_UINT32(0, stBlob.tstPoints[APP_TRACE_SEND].u32Count);
+  /* Core 0 holds 4 events before the dwell times, the rest of the ring is
+     taken and the others are dropped */
+  TEST_ASSERT_EQUAL_UINT32(TEST_TRACE_RING_SIZE - 4, stBlob.tstPoints[APP_TRACE_QUEUE_DWELL].u32Count);
+  TEST_ASSERT_EQUAL_UINT32(4 + 1, stBlob.u32Dropped);
+  /* Same line as app_trace_dump(), tools/trace_decoder.py reads it from this output */
+  snprintf(tcLine, sizeof(tcLine), "TRACE:%s", stBackend.tcBase64);
+  TEST_MESSAGE(tcLine);
+  /* A failed upload keeps the window */
+  atomic_store(&stBackend.s32HttpCode, 500);
+  atomic_store(&stBackend.u32Released, 2);
+  _test_trace_wait_upload(3);
+  app_trace_record_us(APP_TRACE_CONNECT, 1);
+  atomic_store(&stBackend.u32Released, 3);
+  _test_trace_wait_upload(4);
+  _test_trace_decode(stBackend.tcBase64, &stBlob);
+  TEST_ASSERT_EQUAL_UINT32(1, stBlob.tstPoints[APP_TRACE_TAG_HANDLER].u32Count);
+  TEST_ASSERT_EQUAL_UINT32(1, stBlob.tstPoints[APP_TRACE_CONNECT].u32Count);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_trace_hist_buckets);
+  RUN_TEST(test_trace_upload);
+  return UNITY_END();
+}
\ No newline at end of file
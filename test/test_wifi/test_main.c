@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include <esp_timer.h>
+
+#include "app_wifi.h"
+#include "host_shims.h"
+
+/* The tests run in order on the manual clock and each one reboots the node,
+   NVS is only wiped by the first one */
+#define TEST_WIFI_SCAN_MS                        2500
+#define TEST_WIFI_PROBE_MS                       120
+#define TEST_WIFI_ASSOC_MS                       200
+#define TEST_WIFI_DHCP_MS                        600
+#define TEST_WIFI_STEP_US                        10000LL
+#define TEST_WIFI_MAX_CONNECT_MS                 60000
+#define TEST_WIFI_MAX_GAPS                       16
+
+/* DHCP after the first boot, the cached lease is reused as a static address */
+#if defined(APP_WIFI_STATIC_IP)
+#define TEST_WIFI_FIRST_DHCP_MS                  0
+#define TEST_WIFI_CACHED_DHCP_MS                 0
+#elif defined(APP_WIFI_REUSE_LEASE)
+#define TEST_WIFI_FIRST_DHCP_MS                  TEST_WIFI_DHCP_MS
+#define TEST_WIFI_CACHED_DHCP_MS                 0
+#else
+#define TEST_WIFI_FIRST_DHCP_MS                  TEST_WIFI_DHCP_MS
+#define TEST_WIFI_CACHED_DHCP_MS                 TEST_WIFI_DHCP_MS
+#endif
+
+static const host_wifi_timing_t stTiming =
+{
+  .u32ScanMs = TEST_WIFI_SCAN_MS,
+  .u32ProbeMs = TEST_WIFI_PROBE_MS,
+  .u32AssocMs = TEST_WIFI_ASSOC_MS,
+  .u32DhcpMs = TEST_WIFI_DHCP_MS,
+};
+static const uint8_t tu08ApA[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+static const uint8_t tu08ApB[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x61};
+static uint32_t u32Ups;
+static uint32_t u32Downs;
+static uint32_t u32FirstBootMs;
+static uint32_t u32CachedBootMs;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void _test_wifi_link(bool bUp)
+{
+  u32Ups += bUp?1:0;
+  u32Downs += bUp?0:1;
+}
+
+static void _test_wifi_boot(void)
+{
+  u32Ups = 0;
+  u32Downs = 0;
+  host_wifi_reset(&stTiming);
+  app_wifi_init();
+  TEST_ASSERT_EQUAL(ESP_OK, app_wifi_register_cb(_test_wifi_link));
+}
+
+/* Milliseconds on the manual clock until the node has an address */
+static uint32_t _test_wifi_run(void)
+{
+  int64_t s64StartUs;
+
+  s64StartUs = esp_timer_get_time();
+  while(!app_wifi_is_connected() && ((esp_timer_get_time() - s64StartUs) < (TEST_WIFI_MAX_CONNECT_MS * 1000LL)))
+  {
+    host_time_advance_us(TEST_WIFI_STEP_US);
+  }
+  TEST_ASSERT_TRUE(app_wifi_is_connected());
+  return (uint32_t)((esp_timer_get_time() - s64StartUs) / 1000LL);
+}
+
+/* Nothing cached: every channel is scanned, then the AP and lease are saved */
+static void test_wifi_first_boot(void)
+{
+  app_wifi_stats_t stStats;
+
+  host_nvs_reset();
+  host_time_set_manual(0);
+  host_wifi_set_ap(true, 6, tu08ApA);
+  _test_wifi_boot();
+  TEST_ASSERT_FALSE(app_wifi_is_connected());
+  u32FirstBootMs = _test_wifi_run();
+  app_wifi_wait();
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32FastConnects);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32CacheMisses);
+  TEST_ASSERT_EQUAL_UINT32(TEST_WIFI_SCAN_MS + TEST_WIFI_ASSOC_MS + TEST_WIFI_FIRST_DHCP_MS,
+                           stStats.u32LastConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(stStats.u32LastConnectMs, stStats.u32MaxConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(1, host_wifi_get_scans());
+  TEST_ASSERT_EQUAL_UINT32(1, host_nvs_get_writes());
+  TEST_ASSERT_EQUAL_UINT32(1, u32Ups);
+}
+
+/* The cached channel and BSSID are probed without a scan and the cache is
+   not written again */
+static void test_wifi_cached_boot(void)
+{
+  app_wifi_stats_t stStats;
+
+  _test_wifi_boot();
+  u32CachedBootMs = _test_wifi_run();
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32FastConnects);
+  TEST_ASSERT_EQUAL_UINT32(TEST_WIFI_PROBE_MS + TEST_WIFI_ASSOC_MS + TEST_WIFI_CACHED_DHCP_MS,
+                           stStats.u32LastConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(0, host_wifi_get_scans());
+  TEST_ASSERT_EQUAL_UINT32(1, host_wifi_get_attempts());
+  TEST_ASSERT_EQUAL_UINT32(1, host_nvs_get_writes());
+}
+
+/* The first retry is immediate and the next ones back off from 250 ms to 8 s,
+   the listeners see the link go down once and come back once */
+static void test_wifi_lost_ap(void)
+{
+  uint32_t u32Index;
+  uint32_t u32Gaps;
+  uint32_t u32Attempts;
+  int64_t s64LostUs;
+  int64_t s64AttemptUs;
+  uint32_t tu32GapMs[TEST_WIFI_MAX_GAPS];
+  app_wifi_stats_t stStats;
+  static const uint32_t tu32BackoffMs[] = {250, 500, 1000, 2000, 4000, 8000, 8000};
+
+  _test_wifi_boot();
+  _test_wifi_run();
+  host_wifi_set_ap(false, 6, tu08ApA);
+  s64LostUs = esp_timer_get_time();
+  host_wifi_drop();
+  TEST_ASSERT_FALSE(app_wifi_is_connected());
+  TEST_ASSERT_EQUAL_UINT32(1, u32Downs);
+  /* The cached AP is probed right away, after it every channel is scanned
+     right away too and then after each backoff */
+  TEST_ASSERT_EQUAL_UINT32(2, host_wifi_get_attempts());
+  u32Gaps = 0;
+  u32Attempts = host_wifi_get_attempts();
+  s64AttemptUs = esp_timer_get_time();
+  while(u32Gaps < TEST_WIFI_MAX_GAPS)
+  {
+    host_time_advance_us(TEST_WIFI_STEP_US);
+    if(u32Attempts != host_wifi_get_attempts())
+    {
+      u32Attempts = host_wifi_get_attempts();
+      tu32GapMs[u32Gaps++] = (uint32_t)((esp_timer_get_time() - s64AttemptUs) / 1000LL);
+      s64AttemptUs = esp_timer_get_time();
+    }
+  }
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32CacheMisses);
+  TEST_ASSERT_EQUAL_UINT32(TEST_WIFI_PROBE_MS, tu32GapMs[0]);
+  for(u32Index = 1; u32Index < u32Gaps; u32Index++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(TEST_WIFI_SCAN_MS + tu32BackoffMs[(u32Index < 7)?(u32Index - 1):6], tu32GapMs[u32Index]);
+  }
+  host_wifi_set_ap(true, 6, tu08ApA);
+  _test_wifi_run();
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(2, stStats.u32Connects);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32Disconnects);
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)((esp_timer_get_time() - s64LostUs) / 1000LL), stStats.u32LastConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(stStats.u32LastConnectMs, stStats.u32MaxConnectMs);
+  TEST_ASSERT_EQUAL_UINT32(2, u32Ups);
+  TEST_ASSERT_EQUAL_UINT32(1, u32Downs);
+  /* Same AP and lease, nothing to save */
+  TEST_ASSERT_EQUAL_UINT32(1, host_nvs_get_writes());
+}
+
+/* The AP moved to another channel: the probe fails, a scan finds it and the
+   cache follows, so the next boot is fast again */
+static void test_wifi_moved_ap(void)
+{
+  uint32_t u32MovedMs;
+  app_wifi_stats_t stStats;
+  char tcLine[160];
+
+  host_wifi_set_ap(true, 11, tu08ApB);
+  _test_wifi_boot();
+  u32MovedMs = _test_wifi_run();
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32CacheMisses);
+  TEST_ASSERT_EQUAL_UINT32(0, stStats.u32FastConnects);
+  TEST_ASSERT_EQUAL_UINT32(TEST_WIFI_PROBE_MS + TEST_WIFI_SCAN_MS + TEST_WIFI_ASSOC_MS + TEST_WIFI_CACHED_DHCP_MS,
+                           u32MovedMs);
+  TEST_ASSERT_EQUAL_UINT32(2, host_nvs_get_writes());
+  _test_wifi_boot();
+  TEST_ASSERT_EQUAL_UINT32(u32CachedBootMs, _test_wifi_run());
+  app_wifi_get_stats(&stStats);
+  TEST_ASSERT_EQUAL_UINT32(1, stStats.u32FastConnects);
+  snprintf(tcLine,
+           sizeof(tcLine),
+           "connect with a full scan %u ms, with the cached AP %u ms, after the AP moved %u ms",
+           u32FirstBootMs,
+           u32CachedBootMs,
+           u32MovedMs);
+  TEST_MESSAGE(tcLine);
+}
+
+static void test_wifi_register_cb(void)
+{
+  uint32_t u32Index;
+
+  _test_wifi_boot();
+  TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_wifi_register_cb(NULL));
+  for(u32Index = 1; u32Index < APP_WIFI_MAX_CALLBACKS; u32Index++)
+  {
+    TEST_ASSERT_EQUAL(ESP_OK, app_wifi_register_cb(_test_wifi_link));
+  }
+  TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, app_wifi_register_cb(_test_wifi_link));
+  _test_wifi_run();
+  TEST_ASSERT_EQUAL_UINT32(APP_WIFI_MAX_CALLBACKS, u32Ups);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_wifi_first_boot);
+  RUN_TEST(test_wifi_cached_boot);
+  RUN_TEST(test_wifi_lost_ap);
+  RUN_TEST(test_wifi_moved_ap);
+  RUN_TEST(test_wifi_register_cb);
+  return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Build a firmware update container applied by src/app_patch.c.
+
+A full image is simply compressed:
+
+    $ python tools/ota_patch.py full new.bin firmware.otap
+
+A delta is computed against the image currently running on the nodes, it
+only applies to nodes running exactly that image:
+
+    $ python tools/ota_patch.py delta old.bin new.bin firmware.otap
+
+Both commands decode the container again and compare it with new.bin before
+writing it, and report how many bytes a node would download.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = 0x5041544F  # "OTAP"
+VERSION = 1
+HEADER_FORMAT = '<IBBBBI32sI32s'
+TYPE_FULL = 0
+TYPE_DELTA = 1
+COMPRESSION_NONE = 0
+COMPRESSION_DEFLATE = 1
+OP_END = 0x00
+OP_COPY = 0x01
+OP_ADD = 0x02
+BLOCK_SIZE = 16
+INDEX_STRIDE = 4
+MIN_COPY_SIZE = 24
+
+
+def diff(old, new):
+    """Greedy matcher: 16 bytes blocks of the old image are indexed every 4
+    bytes and matches are extended forward and backward as far as they go."""
+    index = {}
+    for offset in range((len(old) - BLOCK_SIZE) & ~(INDEX_STRIDE - 1), -1, -INDEX_STRIDE):
+        index[old[offset:offset + BLOCK_SIZE]] = offset
+    ops = bytearray()
+    literal_start = 0
+    position = 0
+    while position + BLOCK_SIZE <= len(new):
+        offset = index.get(new[position:position + BLOCK_SIZE])
+        if offset is None:
+            position += 1
+            continue
+        end = position + BLOCK_SIZE
+        source_end = offset + BLOCK_SIZE
+        while end < len(new) and source_end < len(old) and new[end] == old[source_end]:
+            end += 1
+            source_end += 1
+        while position > literal_start and offset > 0 and new[position - 1] == old[offset - 1]:
+            position -= 1
+            offset -= 1
+        if end - position < MIN_COPY_SIZE:
+            position += 1
+            continue
+        if position > literal_start:
+            ops += struct.pack('<BI', OP_ADD, position - literal_start) + new[literal_start:position]
+        ops += struct.pack('<BII', OP_COPY, offset, end - position)
+        position = literal_start = end
+    if literal_start < len(new):
+        ops += struct.pack('<BI', OP_ADD, len(new) - literal_start) + new[literal_start:]
+    ops += struct.pack('<B', OP_END)
+    return bytes(ops)
+
+
+def apply(old, container):
+    """Reference decoder, mirrors src/app_patch.c"""
+    size = struct.calcsize(HEADER_FORMAT)
+    (magic, version, kind, compression, _, target_size, target_hash,
+     source_size, source_hash) = struct.unpack(HEADER_FORMAT, container[:size])
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a version {} container'.format(VERSION))
+    payload = container[size:]
+    if compression == COMPRESSION_DEFLATE:
+        payload = zlib.decompress(payload)
+    if kind == TYPE_FULL:
+        image = payload
+    else:
+        if hashlib.sha256(old[:source_size]).digest() != source_hash:
+            raise ValueError('delta was not made for this source image')
+        image = bytearray()
+        position = 0
+        while True:
+            op = payload[position]
+            position += 1
+            if op == OP_END:
+                break
+            if op == OP_COPY:
+                offset, length = struct.unpack_from('<II', payload, position)
+                position += 8
+                image += old[offset:offset + length]
+            elif op == OP_ADD:
+                length, = struct.unpack_from('<I', payload, position)
+                position += 4
+                image += payload[position:position + length]
+                position += length
+            else:
+                raise ValueError('unknown operation 0x{:02x}'.format(op))
+        image = bytes(image)
+    if len(image) != target_size or hashlib.sha256(image).digest() != target_hash:
+        raise ValueError('decoded image does not match')
+    return image
+
+
+def build(kind, old, new, compress):
+    payload = new if kind == TYPE_FULL else diff(old, new)
+    if compress:
+        payload = zlib.compress(payload, 9)
+    header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, kind,
+                         COMPRESSION_DEFLATE if compress else COMPRESSION_NONE, 0,
+                         len(new), hashlib.sha256(new).digest(),
+                         len(old), hashlib.sha256(old).digest())
+    return header + payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    subparsers = parser.add_subparsers(dest='command', required=True)
+    full = subparsers.add_parser('full', help='compressed full image')
+    full.add_argument('new', help='new application image')
+    full.add_argument('output', help='container to publish')
+    delta = subparsers.add_parser('delta', help='patch against the running image')
+    delta.add_argument('old', help='application image running on the nodes')
+    delta.add_argument('new', help='new application image')
+    delta.add_argument('output', help='container to publish')
+    for subparser in (full, delta):
+        subparser.add_argument('--no-compression', action='store_true', help='store the payload as is')
+    args = parser.parse_args()
+
+    old = b''
+    if args.command == 'delta':
+        with open(args.old, 'rb') as stream:
+            old = stream.read()
+    with open(args.new, 'rb') as stream:
+        new = stream.read()
+    kind = TYPE_DELTA if args.command == 'delta' else TYPE_FULL
+    container = build(kind, old, new, not args.no_compression)
+    if apply(old, container) != new:
+        sys.exit('container does not decode to the new image')
+    with open(args.output, 'wb') as stream:
+        stream.write(container)
+    print('{} bytes image, {} bytes to download ({:.1%})'
+          .format(len(new), len(container), len(container) / len(new)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""On-site gateway writing the packed scan records of RFID nodes to Firestore.
+
+Nodes built with APP_PIPELINE_UPLOAD_GATEWAY keep one TCP connection open to
+the gateway and send their scans in frames, little endian (see src/app_gw.c):
+
+    header  type (1 byte), count (1 byte), sequence (2 bytes)
+    hello   0x01, 0, 0, then version (1 byte) and station MAC (6 bytes)
+    scans   0x02, count, sequence, then count records of UNIX time in ms
+            (8 bytes), reader (1 byte), UID length (1 byte), UID (10 bytes)
+    ack     0x82, 0, sequence, then status (1 byte, 0 once stored)
+
+Each scans frame becomes one Firestore commit and is only acknowledged once
+the commit succeeded, so nodes journal the scans of a failed frame. The
+documents match the write models of src/app_pipeline.c:
+
+    $ export FIRESTORE_FIREBASE_PROJECT_ID=... FIRESTORE_FIREBASE_API_KEY=...
+    $ ./rfid_gateway.py --model tag
+"""
+
+import argparse
+import asyncio
+import json
+import logging
+import os
+import struct
+import urllib.error
+import urllib.request
+
+VERSION = 1
+FRAME_HELLO = 0x01
+FRAME_SCANS = 0x02
+FRAME_ACK = 0x82
+HEADER = struct.Struct('<BBH')
+HELLO = struct.Struct('<B6s')
+RECORD = struct.Struct('<qBB10s')
+UID_MAX_SIZE = 10
+STATUS_OK = 0
+STATUS_FAILED = 1
+
+BASE_URL = 'https://firestore.googleapis.com/v1/'
+COLLECTION_ID = 'devices'
+DOCUMENT_ID = 'rfid-node'
+TAG_COLLECTION_ID = 'tags'
+SHARDED_MASK = ['sn', 'reader', 'timestamp', 'node']
+
+log = logging.getLogger('rfid_gateway')
+
+
+class Firestore:
+    def __init__(self, project_id, api_key, model, dry_run):
+        self.database = 'projects/{}/databases/(default)/documents'.format(project_id)
+        self.url = '{}{}:commit?key={}'.format(BASE_URL, self.database, api_key)
+        self.model = model
+        self.dry_run = dry_run
+
+    def path(self, node, uid):
+        if self.model == 'node':
+            return '{}/{}'.format(COLLECTION_ID, node)
+        if self.model == 'tag':
+            return '{}/{}'.format(TAG_COLLECTION_ID, uid.hex().upper())
+        return '{}/{}'.format(COLLECTION_ID, DOCUMENT_ID)
+
+    def writes(self, node, scans):
+        """Same writes as the node would commit, scans of the sharded models
+        hitting the same document are coalesced into one write"""
+        updates = {}
+        for index, (timestamp, reader, uid) in enumerate(scans):
+            fields = {'sn': {'stringValue': uid.hex().upper()}, 'reader': {'integerValue': reader}}
+            if timestamp:
+                fields['timestamp'] = {'integerValue': timestamp}
+            path = self.path(node, uid)
+            update = {'name': '{}/{}'.format(self.database, path), 'fields': fields}
+            if self.model == 'single':
+                updates[index] = (update, 1)
+            else:
+                fields['node'] = {'stringValue': node}
+                updates[path] = (update, updates.pop(path, (None, 0))[1] + 1)
+        if self.model == 'single':
+            return [{'update': update} for update, _ in updates.values()]
+        return [{'update': update,
+                 'updateMask': {'fieldPaths': SHARDED_MASK},
+                 'updateTransforms': [
+                     {'fieldPath': 'lastSeen', 'setToServerValue': 'REQUEST_TIME'},
+                     {'fieldPath': 'scans', 'increment': {'integerValue': count}},
+                 ]} for update, count in updates.values()]
+
+    def commit(self, node, scans):
+        body = json.dumps({'writes': self.writes(node, scans)}, separators=(',', ':')).encode()
+        if self.dry_run:
+            log.info('%s: commit of %d bytes: %s', node, len(body), body.decode())
+            return True
+        request = urllib.request.Request(self.url, data=body, headers={'Content-Type': 'application/json'})
+        try:
+            with urllib.request.urlopen(request, timeout=10) as response:
+                return response.status == 200
+        except (urllib.error.URLError, OSError) as error:
+            log.error('%s: commit failed: %s', node, error)
+            return False
+
+
+class Gateway:
+    def __init__(self, firestore):
+        self.firestore = firestore
+        self.frames = 0
+        self.scans = 0
+        self.bytes = 0
+
+    async def handle(self, reader, writer):
+        peer = writer.get_extra_info('peername')
+        node = None
+        try:
+            while True:
+                header = await reader.readexactly(HEADER.size)
+                frame_type, count, sequence = HEADER.unpack(header)
+                if frame_type == FRAME_HELLO:
+                    version, mac = HELLO.unpack(await reader.readexactly(HELLO.size))
+                    if version != VERSION:
+                        log.error('%s: unsupported version %d', peer, version)
+                        break
+                    node = '{}-{}'.format(DOCUMENT_ID, mac[3:].hex().upper())
+                    log.info('%s: node %s connected', peer, node)
+                elif frame_type == FRAME_SCANS and node:
+                    payload = await reader.readexactly(count * RECORD.size)
+                    scans = []
+                    for timestamp, reader_id, length, uid in RECORD.iter_unpack(payload):
+                        # 0 when the node had no wall clock time, the field is then left out
+                        scans.append((timestamp, reader_id, uid[:min(length, UID_MAX_SIZE)]))
+                    ok = await asyncio.get_running_loop().run_in_executor(None, self.firestore.commit, node, scans)
+                    writer.write(HEADER.pack(FRAME_ACK, 0, sequence) + bytes([STATUS_OK if ok else STATUS_FAILED]))
+                    await writer.drain()
+                    self.frames += 1
+                    self.scans += count
+                    self.bytes += HEADER.size + len(payload)
+                    log.info('%s: %d scans in %d bytes, %.1f bytes per scan overall',
+                             node, count, HEADER.size + len(payload), self.bytes / self.scans)
+                else:
+                    log.error('%s: unexpected frame type 0x%02X', peer, frame_type)
+                    break
+        except asyncio.IncompleteReadError:
+            pass
+        finally:
+            log.info('%s: node %s disconnected', peer, node)
+            writer.close()
+
+
+async def serve(args):
+    firestore = Firestore(os.environ.get('FIRESTORE_FIREBASE_PROJECT_ID', ''),
+                          os.environ.get('FIRESTORE_FIREBASE_API_KEY', ''),
+                          args.model,
+                          args.dry_run)
+    gateway = Gateway(firestore)
+    server = await asyncio.start_server(gateway.handle, args.host, args.port)
+    log.info('Listening on %s:%d, write model: %s', args.host, args.port, args.model)
+    async with server:
+        await server.serve_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--host', default='0.0.0.0', help='address to listen on (default: 0.0.0.0)')
+    parser.add_argument('--port', type=int, default=7030, help='port to listen on (default: 7030)')
+    parser.add_argument('--model', choices=['single', 'node', 'tag'], default='single',
+                        help='document written for each scan, see APP_PIPELINE_FIRESTORE_WRITE_MODEL (default: single)')
+    parser.add_argument('--dry-run', action='store_true', help='log the commits instead of sending them')
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(message)s')
+    if not args.dry_run and not (os.environ.get('FIRESTORE_FIREBASE_PROJECT_ID') and
+                                 os.environ.get('FIRESTORE_FIREBASE_API_KEY')):
+        parser.error('FIRESTORE_FIREBASE_PROJECT_ID and FIRESTORE_FIREBASE_API_KEY must be set')
+    try:
+        asyncio.run(serve(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Build the authorized tag index flashed into the "tagindex" partition.
+
+Input is a text file with one hex UID per line, optionally followed by an
+integer flags value, e.g.:
+
+    72EA5F06C1
+    29578CBB49 1
+
+The output binary matches the layout read by src/app_index.c and can be
+flashed with:
+
+    $ parttool.py write_partition --partition-name=tagindex --input=tagindex.bin
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x58444954  # "TIDX"
+VERSION = 1
+HEADER_SIZE = 32
+SLOT_SIZE = 16
+UID_MAX_SIZE = 10
+STATE_VALID = 0xFE
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+PARTITION_SIZE = 448 * 1024
+
+
+def fnv1a(uid, seed):
+    value = FNV_OFFSET_BASIS ^ seed
+    for byte in uid:
+        value ^= byte
+        value = (value * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def read_uids(path):
+    entries = {}
+    with open(path) as stream:
+        for number, line in enumerate(stream, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            uid = bytes.fromhex(fields[0])
+            if not 0 < len(uid) <= UID_MAX_SIZE:
+                sys.exit('line {}: UID must be 1 to {} bytes'.format(number, UID_MAX_SIZE))
+            entries[uid] = int(fields[1], 0) if len(fields) > 1 else 0
+    return entries
+
+
+def build(entries, load_factor, seed, partition_size):
+    slot_count = 1
+    while slot_count * load_factor < len(entries) or slot_count < 2:
+        slot_count *= 2
+    if HEADER_SIZE + slot_count * SLOT_SIZE > partition_size:
+        sys.exit('{} UIDs need {} slots which do not fit in a {} bytes partition'
+                 .format(len(entries), slot_count, partition_size))
+    slots = [None] * slot_count
+    max_probes = 0
+    for uid, flags in entries.items():
+        index = fnv1a(uid, seed) & (slot_count - 1)
+        probes = 1
+        while slots[index] is not None:
+            index = (index + 1) & (slot_count - 1)
+            probes += 1
+        slots[index] = (uid, flags)
+        max_probes = max(max_probes, probes)
+    image = bytearray(struct.pack('<IHHIII12x', MAGIC, VERSION, SLOT_SIZE, slot_count, len(entries), seed))
+    for slot in slots:
+        if slot is None:
+            image += b'\xff' * SLOT_SIZE
+        else:
+            uid, flags = slot
+            image += struct.pack('<BB10sI', STATE_VALID, len(uid), uid.ljust(UID_MAX_SIZE, b'\xff'), flags)
+    return image, slot_count, max_probes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', help='text file with one hex UID per line')
+    parser.add_argument('output', help='binary image to flash')
+    parser.add_argument('--load-factor', type=float, default=0.5, help='maximum slot occupancy (default: 0.5)')
+    parser.add_argument('--seed', type=lambda value: int(value, 0), default=0, help='hash seed (default: 0)')
+    parser.add_argument('--partition-size', type=lambda value: int(value, 0), default=PARTITION_SIZE,
+                        help='size of the tagindex partition in bytes (default: {})'.format(PARTITION_SIZE))
+    args = parser.parse_args()
+
+    entries = read_uids(args.input)
+    image, slot_count, max_probes = build(entries, args.load_factor, args.seed, args.partition_size)
+    with open(args.output, 'wb') as stream:
+        stream.write(image)
+    print('{} UIDs, {} slots, {} bytes, longest probe sequence: {}'
+          .format(len(entries), slot_count, len(image), max_probes))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Decode the latency histograms recorded by src/app_trace.c.
+
+The input is either the "histograms" bytes value of the /traces/rfid-node
+document, a raw binary blob, or a serial log holding "TRACE:" lines as
+printed by app_trace_dump(), the last one is decoded:
+
+    $ python tools/trace_decoder.py monitor.log
+    $ python tools/trace_decoder.py --base64 'VFJDMQEC...'
+
+Values are reported in microseconds, percentiles are the upper limit of the
+bucket they fall in so they overestimate by at most 25%.
+"""
+
+import argparse
+import base64
+import binascii
+import re
+import struct
+import sys
+
+MAGIC = 0x31435254  # "TRC1"
+VERSION = 1
+HEADER_FORMAT = '<IBBHIIB'
+POINT_FORMAT = '<BIIB'
+BUCKET_FORMAT = '<BI'
+# Keep in sync with app_trace_point_t in include/app_trace.h
+POINTS = [
+    'tag_handler',
+    'queue_dwell',
+    'format',
+    'timestamp',
+    'connect',
+    'send',
+    'wait',
+    'receive',
+    'request',
+]
+PERCENTILES = (50, 90, 99)
+
+
+def bucket_limit(bucket, sub_bucket_bits):
+    sub_buckets = 1 << sub_bucket_bits
+    if bucket < sub_buckets:
+        return bucket
+    shift = bucket // sub_buckets - 1
+    return ((sub_buckets + bucket % sub_buckets + 1) << shift) - 1
+
+
+def percentile(buckets, count, percent, sub_bucket_bits):
+    rank = (count * percent + 99) // 100
+    total = 0
+    for bucket in sorted(buckets):
+        total += buckets[bucket]
+        if total >= rank:
+            return bucket_limit(bucket, sub_bucket_bits)
+    return 0
+
+
+def unpack(blob, offset, fmt):
+    size = struct.calcsize(fmt)
+    if offset + size > len(blob):
+        sys.exit('truncated trace at offset {}'.format(offset))
+    return struct.unpack_from(fmt, blob, offset), offset + size
+
+
+def decode(blob):
+    (magic, version, sub_bucket_bits, cpu_mhz, uptime, dropped, point_count), offset = \
+        unpack(blob, 0, HEADER_FORMAT)
+    if magic != MAGIC or version != VERSION:
+        sys.exit('not a version {} trace'.format(VERSION))
+    points = {}
+    while offset < len(blob):
+        (point, count, maximum, bucket_count), offset = unpack(blob, offset, POINT_FORMAT)
+        buckets = {}
+        for _ in range(bucket_count):
+            (bucket, bucket_total), offset = unpack(blob, offset, BUCKET_FORMAT)
+            buckets[bucket] = bucket_total
+        points[point] = (count, maximum, buckets)
+    return sub_bucket_bits, cpu_mhz, uptime, dropped, point_count, points
+
+
+def read_blob(args):
+    if args.base64:
+        return base64.b64decode(args.base64)
+    with open(args.input, 'rb') as stream:
+        data = stream.read()
+    if data[:4] == struct.pack('<I', MAGIC):
+        return data
+    lines = re.findall(rb'\bTRACE:([A-Za-z0-9+/=]+)', data)
+    text = lines[-1] if lines else data.strip()
+    try:
+        return base64.b64decode(text, validate=True)
+    except binascii.Error:
+        sys.exit('{} holds neither a trace nor a TRACE: line'.format(args.input))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('input', nargs='?', help='binary blob, base64 text or serial log')
+    parser.add_argument('--base64', help='base64 encoded blob given on the command line')
+    args = parser.parse_args()
+    if not args.input and not args.base64:
+        parser.error('an input file or --base64 is required')
+
+    sub_bucket_bits, cpu_mhz, uptime, dropped, point_count, points = decode(read_blob(args))
+    print('uptime: {} s, cpu: {} MHz, dropped events: {}'.format(uptime, cpu_mhz, dropped))
+    print('{:<12} {:>8} {:>10} {:>10} {:>10} {:>10}'.format('point', 'count', 'p50 us', 'p90 us', 'p99 us', 'max us'))
+    for point in range(point_count):
+        if point not in points:
+            continue
+        count, maximum, buckets = points[point]
+        values = [min(percentile(buckets, count, percent, sub_bucket_bits), maximum) for percent in PERCENTILES]
+        values.append(maximum)
+        name = POINTS[point] if point < len(POINTS) else 'point_{}'.format(point)
+        print('{:<12} {:>8} '.format(name, count) +
+              ' '.join('{:>10.1f}'.format(value / cpu_mhz) for value in values))
+
+
+if __name__ == '__main__':
+    main()